@@ -23,16 +23,20 @@ import androidx.annotation.Nullable;
 import androidx.annotation.VisibleForTesting;
 import com.google.android.exoplayer2.C;
 import com.google.android.exoplayer2.decoder.DecoderInputBuffer;
+import com.google.android.exoplayer2.decoder.NativeDecoder;
+import com.google.android.exoplayer2.decoder.NativeDecoderStats;
 import com.google.android.exoplayer2.decoder.SimpleDecoder;
 import com.google.android.exoplayer2.util.Util;
 import com.google.android.exoplayer2.video.VideoDecoderInputBuffer;
 import com.google.android.exoplayer2.video.VideoDecoderOutputBuffer;
 import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
 
 /** Gav1 decoder. */
 @VisibleForTesting(otherwise = PACKAGE_PRIVATE)
 public final class Gav1Decoder
-    extends SimpleDecoder<VideoDecoderInputBuffer, VideoDecoderOutputBuffer, Gav1DecoderException> {
+    extends SimpleDecoder<VideoDecoderInputBuffer, VideoDecoderOutputBuffer, Gav1DecoderException>
+    implements NativeDecoder {
 
   // LINT.IfChange
   private static final int GAV1_ERROR = 0;
@@ -40,6 +44,15 @@ public final class Gav1Decoder
   private static final int GAV1_DECODE_ONLY = 2;
   // LINT.ThenChange(../../../../../../../jni/gav1_jni.cc)
 
+  // LINT.IfChange
+  private static final int STATUS_SLOT_ERROR_STATUS = 0;
+  // LINT.ThenChange(../../../../../../../jni/gav1_jni.cc)
+
+  // The number of frame buffers libgav1 is expected to reference while decoding, in addition to the
+  // buffers of queued output frames: eight reference frames and the frame being decoded.
+  private static final int REFERENCE_FRAME_BUFFER_COUNT = 9;
+
+  private final int numOutputBuffers;
   private final long gav1DecoderContext;
 
   @C.VideoOutputMode private volatile int outputMode;
@@ -64,6 +77,7 @@ public final class Gav1Decoder
     if (!Gav1Library.isAvailable()) {
       throw new Gav1DecoderException("Failed to load decoder native library.");
     }
+    this.numOutputBuffers = numOutputBuffers;
 
     if (threads == Libgav1VideoRenderer.THREAD_COUNT_AUTODETECT) {
       // Try to get the optimal number of threads from the AV1 heuristic.
@@ -75,7 +89,7 @@ public final class Gav1Decoder
     }
 
     gav1DecoderContext = gav1Init(threads);
-    if (gav1DecoderContext == GAV1_ERROR || gav1CheckError(gav1DecoderContext) == GAV1_ERROR) {
+    if (gav1DecoderContext == GAV1_ERROR || getErrorStatus() == GAV1_ERROR) {
       throw new Gav1DecoderException(
           "Failed to initialize decoder. Error: " + gav1GetErrorMessage(gav1DecoderContext));
     }
@@ -179,6 +193,46 @@ public final class Gav1Decoder
     }
   }
 
+  /**
+   * Allocates the frame buffers that the decoder is expected to need for frames of the given size,
+   * so that they're not allocated while the first frames are being decoded. May be called from any
+   * thread, but must not be called after {@link #release()}.
+   *
+   * @param width The expected frame width.
+   * @param height The expected frame height.
+   */
+  public void reserveFrameBuffers(int width, int height) {
+    gav1ReserveFrameBuffers(
+        gav1DecoderContext, numOutputBuffers + REFERENCE_FRAME_BUFFER_COUNT, width, height);
+  }
+
+  @Override
+  public NativeDecoderStats getNativeStats() {
+    long[] snapshot = new long[NativeDecoderStats.SNAPSHOT_LENGTH];
+    gav1GetStats(gav1DecoderContext, snapshot);
+    return new NativeDecoderStats(snapshot);
+  }
+
+  @Override
+  public boolean startSessionRecording(String path) {
+    return gav1StartSessionRecording(gav1DecoderContext, path);
+  }
+
+  @Override
+  public void stopSessionRecording() {
+    gav1StopSessionRecording(gav1DecoderContext);
+  }
+
+  /**
+   * Returns {@link #GAV1_ERROR} if an error has occurred during initialization, and {@link
+   * #GAV1_OK} otherwise.
+   */
+  private int getErrorStatus() {
+    ByteBuffer statusBuffer =
+        gav1GetStatusBuffer(gav1DecoderContext).order(ByteOrder.nativeOrder());
+    return (int) statusBuffer.getLong(STATUS_SLOT_ERROR_STATUS * 8);
+  }
+
   /**
    * Initializes a libgav1 decoder.
    *
@@ -243,12 +297,48 @@ public final class Gav1Decoder
   private native String gav1GetErrorMessage(long context);
 
   /**
-   * Returns whether an error occurred.
+   * Returns the status block that the native decoder publishes its status to.
+   *
+   * @param context Decoder context.
+   * @return A direct {@link ByteBuffer} wrapping the status block.
+   */
+  private native ByteBuffer gav1GetStatusBuffer(long context);
+
+  /**
+   * Allocates free frame buffers for 8-bit 4:2:0 frames of the given size.
+   *
+   * @param context Decoder context.
+   * @param count The number of frame buffers to allocate, including those already allocated.
+   * @param width The frame width.
+   * @param height The frame height.
+   * @return The number of frame buffers that are allocated.
+   */
+  private native int gav1ReserveFrameBuffers(long context, int count, int width, int height);
+
+  /**
+   * Copies a snapshot of the decoder statistics.
+   *
+   * @param context Decoder context.
+   * @param stats Array of length {@link NativeDecoderStats#SNAPSHOT_LENGTH} to copy the snapshot
+   *     to.
+   */
+  private native void gav1GetStats(long context, long[] stats);
+
+  /**
+   * Starts recording the calls made to the decoder.
+   *
+   * @param context Decoder context.
+   * @param path The path of the file to record to.
+   * @return Whether recording was started.
+   */
+  private native boolean gav1StartSessionRecording(long context, String path);
+
+  /**
+   * Stops recording the calls made to the decoder.
    *
    * @param context Decoder context.
-   * @return {@link #GAV1_OK} if there was no error, {@link #GAV1_ERROR} if an error occurred.
    */
-  private native int gav1CheckError(long context);
+  private native void gav1StopSessionRecording(long context);
 
   /**
    * Returns the optimal number of threads to be used for AV1 decoding.
@@ -23,6 +23,7 @@ import androidx.annotation.Nullable;
 import com.google.android.exoplayer2.C;
 import com.google.android.exoplayer2.Format;
 import com.google.android.exoplayer2.RendererCapabilities;
+import com.google.android.exoplayer2.decoder.DecoderPrewarmer;
 import com.google.android.exoplayer2.decoder.DecoderReuseEvaluation;
 import com.google.android.exoplayer2.drm.ExoMediaCrypto;
 import com.google.android.exoplayer2.util.MimeTypes;
@@ -61,6 +62,7 @@ public class Libgav1VideoRenderer extends DecoderVideoRenderer {
   private final int numOutputBuffers;
 
   private final int threads;
+  private final DecoderPrewarmer<Gav1Decoder> decoderPrewarmer;
 
   @Nullable private Gav1Decoder decoder;
 
@@ -118,6 +120,27 @@ public class Libgav1VideoRenderer extends DecoderVideoRenderer {
     this.threads = threads;
     this.numInputBuffers = numInputBuffers;
     this.numOutputBuffers = numOutputBuffers;
+    decoderPrewarmer = new DecoderPrewarmer<>();
+  }
+
+  /**
+   * Creates a decoder for {@code format} on a background thread, and allocates its frame buffers
+   * if the format's dimensions are known, so that the decoder is ready when playback starts. The
+   * decoder is used if the renderer's next decoder is for a compatible format, and is released
+   * otherwise, or when the renderer is reset. May be called from any thread.
+   *
+   * @param format The anticipated format.
+   */
+  public void prewarmDecoder(Format format) {
+    decoderPrewarmer.prewarm(
+        format,
+        prewarmFormat -> {
+          Gav1Decoder decoder = newDecoder(prewarmFormat);
+          if (prewarmFormat.width != Format.NO_VALUE && prewarmFormat.height != Format.NO_VALUE) {
+            decoder.reserveFrameBuffers(prewarmFormat.width, prewarmFormat.height);
+          }
+          return decoder;
+        });
   }
 
   @Override
@@ -143,15 +166,21 @@ public class Libgav1VideoRenderer extends DecoderVideoRenderer {
   protected Gav1Decoder createDecoder(Format format, @Nullable ExoMediaCrypto mediaCrypto)
       throws Gav1DecoderException {
     TraceUtil.beginSection("createGav1Decoder");
-    int initialInputBufferSize =
-        format.maxInputSize != Format.NO_VALUE ? format.maxInputSize : DEFAULT_INPUT_BUFFER_SIZE;
-    Gav1Decoder decoder =
-        new Gav1Decoder(numInputBuffers, numOutputBuffers, initialInputBufferSize, threads);
+    @Nullable Gav1Decoder decoder = decoderPrewarmer.takeDecoder(format);
+    if (decoder == null) {
+      decoder = newDecoder(format);
+    }
     this.decoder = decoder;
     TraceUtil.endSection();
     return decoder;
   }
 
+  @Override
+  protected void onReset() {
+    super.onReset();
+    decoderPrewarmer.release();
+  }
+
   @Override
   protected void renderOutputBufferToSurface(VideoDecoderOutputBuffer outputBuffer, Surface surface)
       throws Gav1DecoderException {
@@ -180,4 +209,10 @@ public class Libgav1VideoRenderer extends DecoderVideoRenderer {
         REUSE_RESULT_YES_WITHOUT_RECONFIGURATION,
         /* discardReasons= */ 0);
   }
+
+  private Gav1Decoder newDecoder(Format format) throws Gav1DecoderException {
+    int initialInputBufferSize =
+        format.maxInputSize != Format.NO_VALUE ? format.maxInputSize : DEFAULT_INPUT_BUFFER_SIZE;
+    return new Gav1Decoder(numInputBuffers, numOutputBuffers, initialInputBufferSize, threads);
+  }
 }
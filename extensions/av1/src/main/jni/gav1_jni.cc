@@ -18,22 +18,22 @@
 #include <android/native_window.h>
 #include <android/native_window_jni.h>
 
-#include "cpu_features_macros.h"  // NOLINT
-#ifdef CPU_FEATURES_ARCH_ARM
-#include "cpuinfo_arm.h"  // NOLINT
-#endif                    // CPU_FEATURES_ARCH_ARM
-#ifdef CPU_FEATURES_COMPILED_ANY_ARM_NEON
-#include <arm_neon.h>
-#endif  // CPU_FEATURES_COMPILED_ANY_ARM_NEON
 #include <jni.h>
 
 #include <cstdint>
 #include <cstring>
-#include <mutex>  // NOLINT
 #include <new>
 
-#include "cpu_info.h"  // NOLINT
+#include "cpu_dispatch.h"       // NOLINT
+#include "cpu_info.h"           // NOLINT
+#include "decoder_stats_jni.h"  // NOLINT
+#include "frame_buffer_pool.h"  // NOLINT
 #include "gav1/decoder.h"
+#include "jni_registration.h"   // NOLINT
+#include "profile.h"            // NOLINT
+#include "session_recorder.h"   // NOLINT
+#include "status_block.h"       // NOLINT
+#include "trace.h"              // NOLINT
 
 #define LOG_TAG "gav1_jni"
 #define LOGE(...) \
@@ -41,19 +41,28 @@
 
 #define DECODER_FUNC(RETURN_TYPE, NAME, ...)                         \
   extern "C" {                                                       \
-  JNIEXPORT RETURN_TYPE                                              \
+  EXOPLAYER_JNI_EXPORT RETURN_TYPE                                   \
       Java_com_google_android_exoplayer2_ext_av1_Gav1Decoder_##NAME( \
           JNIEnv* env, jobject thiz, ##__VA_ARGS__);                 \
   }                                                                  \
-  JNIEXPORT RETURN_TYPE                                              \
+  EXOPLAYER_JNI_EXPORT RETURN_TYPE                                   \
       Java_com_google_android_exoplayer2_ext_av1_Gav1Decoder_##NAME( \
           JNIEnv* env, jobject thiz, ##__VA_ARGS__)
 
-jint JNI_OnLoad(JavaVM* vm, void* reserved) {
+namespace {
+bool InitJniReferences(JNIEnv* env);
+bool RegisterNativeMethods(JNIEnv* env);
+}  // namespace
+
+EXOPLAYER_JNI_ONLOAD(Gav1OnLoad) {
   JNIEnv* env;
   if (vm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_6) != JNI_OK) {
     return -1;
   }
+  if (!InitJniReferences(env) || !RegisterNativeMethods(env)) {
+    return -1;
+  }
+  exoplayer_jni::InitCpuDispatch();
   return JNI_VERSION_1_6;
 }
 
@@ -86,6 +95,15 @@ const int kStatusOk = 1;
 const int kStatusDecodeOnly = 2;
 // LINT.ThenChange(../java/com/google/android/exoplayer2/ext/av1/Gav1Decoder.java)
 
+// LINT.IfChange
+// Slots of the status block that is shared with Gav1Decoder.
+enum StatusSlot {
+  // kStatusOk if no error has occurred, kStatusError otherwise.
+  kStatusSlotErrorStatus = 0,
+  kStatusSlotCount = 1
+};
+// LINT.ThenChange(../java/com/google/android/exoplayer2/ext/av1/Gav1Decoder.java)
+
 // Status codes specific to the JNI wrapper code.
 enum JniStatusCode {
   kJniStatusOk = 0,
@@ -99,6 +117,37 @@ enum JniStatusCode {
   kJniStatusNeonNotSupported = -8
 };
 
+// JNI references, which are looked up once when the library is loaded rather
+// than each time a decoder is created.
+jfieldID decoder_private_field;
+jfieldID output_mode_field;
+jfieldID data_field;
+jmethodID init_for_private_frame_method;
+jmethodID init_for_yuv_frame_method;
+
+// Looks up the JNI references. Returns false, with an exception pending, if
+// any of them can't be found.
+bool InitJniReferences(JNIEnv* env) {
+  const jclass output_buffer_class = env->FindClass(
+      "com/google/android/exoplayer2/video/VideoDecoderOutputBuffer");
+  if (output_buffer_class == nullptr) {
+    return false;
+  }
+  decoder_private_field =
+      env->GetFieldID(output_buffer_class, "decoderPrivate", "I");
+  output_mode_field = env->GetFieldID(output_buffer_class, "mode", "I");
+  data_field =
+      env->GetFieldID(output_buffer_class, "data", "Ljava/nio/ByteBuffer;");
+  init_for_private_frame_method =
+      env->GetMethodID(output_buffer_class, "initForPrivateFrame", "(II)V");
+  init_for_yuv_frame_method =
+      env->GetMethodID(output_buffer_class, "initForYuvFrame", "(IIIII)Z");
+  env->DeleteLocalRef(output_buffer_class);
+  return decoder_private_field != nullptr && output_mode_field != nullptr &&
+         data_field != nullptr && init_for_private_frame_method != nullptr &&
+         init_for_yuv_frame_method != nullptr;
+}
+
 const char* GetJniErrorMessage(JniStatusCode error_code) {
   switch (error_code) {
     case kJniStatusOutOfMemory:
@@ -123,22 +172,9 @@ const char* GetJniErrorMessage(JniStatusCode error_code) {
   }
 }
 
-// Manages frame buffer and reference information.
+// Holds the frame data of a frame buffer that is output in surface YUV mode.
 class JniFrameBuffer {
  public:
-  explicit JniFrameBuffer(int id) : id_(id), reference_count_(0) {}
-  ~JniFrameBuffer() {
-    for (int plane_index = kPlaneY; plane_index < kMaxPlanes; plane_index++) {
-      delete[] raw_buffer_[plane_index];
-    }
-  }
-
-  // Not copyable or movable.
-  JniFrameBuffer(const JniFrameBuffer&) = delete;
-  JniFrameBuffer(JniFrameBuffer&&) = delete;
-  JniFrameBuffer& operator=(const JniFrameBuffer&) = delete;
-  JniFrameBuffer& operator=(JniFrameBuffer&&) = delete;
-
   void SetFrameData(const libgav1::DecoderBuffer& decoder_buffer) {
     for (int plane_index = kPlaneY; plane_index < decoder_buffer.NumPlanes();
          plane_index++) {
@@ -160,121 +196,55 @@ class JniFrameBuffer {
     return displayed_height_[plane_index];
   }
 
-  // Methods maintaining reference count are not thread-safe. They must be
-  // called with a lock held.
-  void AddReference() { ++reference_count_; }
-  void RemoveReference() { reference_count_--; }
-  bool InUse() const { return reference_count_ != 0; }
-
-  uint8_t* RawBuffer(int plane_index) const { return raw_buffer_[plane_index]; }
-  void* BufferPrivateData() const { return const_cast<int*>(&id_); }
-
-  // Attempts to reallocate data planes if the existing ones don't have enough
-  // capacity. Returns true if the allocation was successful or wasn't needed,
-  // false if the allocation failed.
-  bool MaybeReallocateGav1DataPlanes(int y_plane_min_size,
-                                     int uv_plane_min_size) {
-    for (int plane_index = kPlaneY; plane_index < kMaxPlanes; plane_index++) {
-      const int min_size =
-          (plane_index == kPlaneY) ? y_plane_min_size : uv_plane_min_size;
-      if (raw_buffer_size_[plane_index] >= min_size) continue;
-      delete[] raw_buffer_[plane_index];
-      raw_buffer_[plane_index] = new (std::nothrow) uint8_t[min_size];
-      if (!raw_buffer_[plane_index]) {
-        raw_buffer_size_[plane_index] = 0;
-        return false;
-      }
-      raw_buffer_size_[plane_index] = min_size;
-    }
-    return true;
-  }
-
  private:
   int stride_[kMaxPlanes];
   uint8_t* plane_[kMaxPlanes];
   int displayed_width_[kMaxPlanes];
   int displayed_height_[kMaxPlanes];
-  const int id_;
-  int reference_count_;
-  // Pointers to the raw buffers allocated for the data planes.
-  uint8_t* raw_buffer_[kMaxPlanes] = {};
-  // Sizes of the raw buffers in bytes.
-  size_t raw_buffer_size_[kMaxPlanes] = {};
 };
 
 // Manages frame buffers used by libgav1 decoder and ExoPlayer.
 // Handles synchronization between libgav1 and ExoPlayer threads.
 class JniBufferManager {
  public:
-  ~JniBufferManager() {
-    // This lock does not do anything since libgav1 has released all the frame
-    // buffers. It exists to merely be consistent with all other usage of
-    // |all_buffers_| and |all_buffer_count_|.
-    std::lock_guard<std::mutex> lock(mutex_);
-    while (all_buffer_count_--) {
-      delete all_buffers_[all_buffer_count_];
-    }
-  }
-
-  JniStatusCode GetBuffer(size_t y_plane_min_size, size_t uv_plane_min_size,
-                          JniFrameBuffer** jni_buffer) {
-    std::lock_guard<std::mutex> lock(mutex_);
-
-    JniFrameBuffer* output_buffer;
-    if (free_buffer_count_) {
-      output_buffer = free_buffers_[--free_buffer_count_];
-    } else if (all_buffer_count_ < kMaxFrames) {
-      output_buffer = new (std::nothrow) JniFrameBuffer(all_buffer_count_);
-      if (output_buffer == nullptr) return kJniStatusOutOfMemory;
-      all_buffers_[all_buffer_count_++] = output_buffer;
-    } else {
-      // Maximum number of buffers is being used.
-      return kJniStatusOutOfMemory;
-    }
-    if (!output_buffer->MaybeReallocateGav1DataPlanes(y_plane_min_size,
-                                                      uv_plane_min_size)) {
-      return kJniStatusOutOfMemory;
-    }
-
-    output_buffer->AddReference();
-    *jni_buffer = output_buffer;
-
+  explicit JniBufferManager(exoplayer_jni::DecoderStats* stats)
+      : pool_(stats) {}
+
+  // Acquires a buffer with one allocation for all three planes. The U and V
+  // planes are null if |uv_plane_size| is zero.
+  JniStatusCode GetBuffer(size_t y_plane_size, size_t uv_plane_size,
+                          uint8_t* planes[kMaxPlanes], void** private_data) {
+    const int id = pool_.Acquire(y_plane_size + 2 * uv_plane_size);
+    if (id < 0) return kJniStatusOutOfMemory;
+    uint8_t* const data = pool_.Data(id);
+    planes[kPlaneY] = data;
+    planes[kPlaneU] = uv_plane_size ? data + y_plane_size : nullptr;
+    planes[kPlaneV] =
+        uv_plane_size ? data + y_plane_size + uv_plane_size : nullptr;
+    *private_data = pool_.PrivateData(id);
     return kJniStatusOk;
   }
 
-  JniFrameBuffer* GetBuffer(int id) const { return all_buffers_[id]; }
+  JniFrameBuffer* GetBuffer(int id) { return &frames_[id]; }
 
-  void AddBufferReference(int id) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    all_buffers_[id]->AddReference();
-  }
+  int Reserve(int count, size_t size) { return pool_.Reserve(count, size); }
+
+  void AddBufferReference(int id) { pool_.AddReference(id); }
 
   JniStatusCode ReleaseBuffer(int id) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    JniFrameBuffer* buffer = all_buffers_[id];
-    if (!buffer->InUse()) {
-      return kJniStatusBufferAlreadyReleased;
-    }
-    buffer->RemoveReference();
-    if (!buffer->InUse()) {
-      free_buffers_[free_buffer_count_++] = buffer;
-    }
-    return kJniStatusOk;
+    return pool_.Release(id) ? kJniStatusOk : kJniStatusBufferAlreadyReleased;
   }
 
  private:
-  static const int kMaxFrames = 32;
-
-  JniFrameBuffer* all_buffers_[kMaxFrames];
-  int all_buffer_count_ = 0;
-
-  JniFrameBuffer* free_buffers_[kMaxFrames];
-  int free_buffer_count_ = 0;
-
-  std::mutex mutex_;
+  exoplayer_jni::FrameBufferPool pool_;
+  JniFrameBuffer frames_[exoplayer_jni::FrameBufferPool::kMaxBuffers];
 };
 
 struct JniContext {
+  JniContext()
+      : recorder(exoplayer_jni::session_format::kCodecAv1),
+        buffer_manager(&stats) {}
+
   ~JniContext() {
     if (native_window) {
       ANativeWindow_release(native_window);
@@ -300,11 +270,12 @@ struct JniContext {
     return true;
   }
 
-  jfieldID decoder_private_field;
-  jfieldID output_mode_field;
-  jfieldID data_field;
-  jmethodID init_for_private_frame_method;
-  jmethodID init_for_yuv_frame_method;
+  // Declared before |buffer_manager|, which updates it.
+  exoplayer_jni::DecoderStats stats;
+  exoplayer_jni::SessionRecorder recorder;
+  // Time spent in the last gav1Decode call, recorded as part of the decode time
+  // of the next frame that's dequeued.
+  int64_t enqueue_time_us = 0;
 
   JniBufferManager buffer_manager;
   // The libgav1 decoder instance has to be deleted before |buffer_manager| is
@@ -321,6 +292,17 @@ struct JniContext {
 
   Libgav1StatusCode libgav1_status_code = kLibgav1StatusOk;
   JniStatusCode jni_status_code = kJniStatusOk;
+
+  exoplayer_jni::StatusBlock<kStatusSlotCount> status;
+
+  // Publishes whether an error has occurred to the status block.
+  void PublishStatus() {
+    status.Set(kStatusSlotErrorStatus,
+               libgav1_status_code != kLibgav1StatusOk ||
+                       jni_status_code != kJniStatusOk
+                   ? kStatusError
+                   : kStatusOk);
+  }
 };
 
 Libgav1StatusCode Libgav1GetFrameBuffer(void* callback_private_data,
@@ -330,6 +312,7 @@ Libgav1StatusCode Libgav1GetFrameBuffer(void* callback_private_data,
                                         int right_border, int top_border,
                                         int bottom_border, int stride_alignment,
                                         libgav1::FrameBuffer* frame_buffer) {
+  EXO_TRACE_SCOPE("gav1:bufferAcquire");
   libgav1::FrameBufferInfo info;
   Libgav1StatusCode status = libgav1::ComputeFrameBufferInfo(
       bitdepth, image_format, width, height, left_border, right_border,
@@ -337,26 +320,23 @@ Libgav1StatusCode Libgav1GetFrameBuffer(void* callback_private_data,
   if (status != kLibgav1StatusOk) return status;
 
   JniContext* const context = static_cast<JniContext*>(callback_private_data);
-  JniFrameBuffer* jni_buffer;
+  uint8_t* planes[kMaxPlanes];
+  void* buffer_private_data;
   context->jni_status_code = context->buffer_manager.GetBuffer(
-      info.y_buffer_size, info.uv_buffer_size, &jni_buffer);
+      info.y_buffer_size, info.uv_buffer_size, planes, &buffer_private_data);
   if (context->jni_status_code != kJniStatusOk) {
     LOGE("%s", GetJniErrorMessage(context->jni_status_code));
     return kLibgav1StatusOutOfMemory;
   }
 
-  uint8_t* const y_buffer = jni_buffer->RawBuffer(0);
-  uint8_t* const u_buffer =
-      (info.uv_buffer_size != 0) ? jni_buffer->RawBuffer(1) : nullptr;
-  uint8_t* const v_buffer =
-      (info.uv_buffer_size != 0) ? jni_buffer->RawBuffer(2) : nullptr;
-
-  return libgav1::SetFrameBuffer(&info, y_buffer, u_buffer, v_buffer,
-                                 jni_buffer->BufferPrivateData(), frame_buffer);
+  return libgav1::SetFrameBuffer(&info, planes[kPlaneY], planes[kPlaneU],
+                                 planes[kPlaneV], buffer_private_data,
+                                 frame_buffer);
 }
 
 void Libgav1ReleaseFrameBuffer(void* callback_private_data,
                                void* buffer_private_data) {
+  EXO_TRACE_SCOPE("gav1:bufferRelease");
   JniContext* const context = static_cast<JniContext*>(callback_private_data);
   const int buffer_id = *static_cast<const int*>(buffer_private_data);
   context->jni_status_code = context->buffer_manager.ReleaseBuffer(buffer_id);
@@ -367,17 +347,9 @@ void Libgav1ReleaseFrameBuffer(void* callback_private_data,
 
 constexpr int AlignTo16(int value) { return (value + 15) & (~15); }
 
-void CopyPlane(const uint8_t* source, int source_stride, uint8_t* destination,
-               int destination_stride, int width, int height) {
-  while (height--) {
-    std::memcpy(destination, source, width);
-    source += source_stride;
-    destination += destination_stride;
-  }
-}
-
 void CopyFrameToDataBuffer(const libgav1::DecoderBuffer* decoder_buffer,
                            jbyte* data) {
+  EXO_TRACE_SCOPE("gav1:copy");
   for (int plane_index = kPlaneY; plane_index < decoder_buffer->NumPlanes();
        plane_index++) {
     const uint64_t length = decoder_buffer->stride[plane_index] *
@@ -389,123 +361,21 @@ void CopyFrameToDataBuffer(const libgav1::DecoderBuffer* decoder_buffer,
 
 void Convert10BitFrameTo8BitDataBuffer(
     const libgav1::DecoderBuffer* decoder_buffer, jbyte* data) {
+  EXO_TRACE_SCOPE("gav1:convert");
+  const exoplayer_jni::Convert10To8PlaneFunction convert_10_to_8_plane =
+      exoplayer_jni::GetKernels().convert_10_to_8_plane;
   for (int plane_index = kPlaneY; plane_index < decoder_buffer->NumPlanes();
        plane_index++) {
-    int sample = 0;
-    const uint8_t* source = decoder_buffer->plane[plane_index];
-    for (int i = 0; i < decoder_buffer->displayed_height[plane_index]; i++) {
-      const uint16_t* source_16 = reinterpret_cast<const uint16_t*>(source);
-      for (int j = 0; j < decoder_buffer->displayed_width[plane_index]; j++) {
-        // Lightweight dither. Carryover the remainder of each 10->8 bit
-        // conversion to the next pixel.
-        sample += source_16[j];
-        data[j] = sample >> 2;
-        sample &= 3;  // Remainder.
-      }
-      source += decoder_buffer->stride[plane_index];
-      data += decoder_buffer->stride[plane_index];
-    }
-  }
-}
-
-#ifdef CPU_FEATURES_COMPILED_ANY_ARM_NEON
-void Convert10BitFrameTo8BitDataBufferNeon(
-    const libgav1::DecoderBuffer* decoder_buffer, jbyte* data) {
-  uint32x2_t lcg_value = vdup_n_u32(random());
-  lcg_value = vset_lane_u32(random(), lcg_value, 1);
-  // LCG values recommended in "Numerical Recipes".
-  const uint32x2_t LCG_MULT = vdup_n_u32(1664525);
-  const uint32x2_t LCG_INCR = vdup_n_u32(1013904223);
-
-  for (int plane_index = kPlaneY; plane_index < kMaxPlanes; plane_index++) {
-    const uint8_t* source = decoder_buffer->plane[plane_index];
-
-    for (int i = 0; i < decoder_buffer->displayed_height[plane_index]; i++) {
-      const uint16_t* source_16 = reinterpret_cast<const uint16_t*>(source);
-      uint8_t* destination = reinterpret_cast<uint8_t*>(data);
-
-      // Each read consumes 4 2-byte samples, but to reduce branches and
-      // random steps we unroll to 4 rounds, so each loop consumes 16
-      // samples.
-      const int j_max = decoder_buffer->displayed_width[plane_index] & ~15;
-      int j;
-      for (j = 0; j < j_max; j += 16) {
-        // Run a round of the RNG.
-        lcg_value = vmla_u32(LCG_INCR, lcg_value, LCG_MULT);
-
-        // Round 1.
-        // The lower two bits of this LCG parameterization are garbage,
-        // leaving streaks on the image. We access the upper bits of each
-        // 16-bit lane by shifting. (We use this both as an 8- and 16-bit
-        // vector, so the choice of which one to keep it as is arbitrary.)
-        uint8x8_t randvec =
-            vreinterpret_u8_u16(vshr_n_u16(vreinterpret_u16_u32(lcg_value), 8));
-
-        // We retrieve the values and shift them so that the bits we'll
-        // shift out (after biasing) are in the upper 8 bits of each 16-bit
-        // lane.
-        uint16x4_t values = vshl_n_u16(vld1_u16(source_16), 6);
-        // We add the bias bits in the lower 8 to the shifted values to get
-        // the final values in the upper 8 bits.
-        uint16x4_t added_1 = vqadd_u16(values, vreinterpret_u16_u8(randvec));
-        source_16 += 4;
-
-        // Round 2.
-        // Shifting the randvec bits left by 2 bits, as an 8-bit vector,
-        // should leave us with enough bias to get the needed rounding
-        // operation.
-        randvec = vshl_n_u8(randvec, 2);
-
-        // Retrieve and sum the next 4 pixels.
-        values = vshl_n_u16(vld1_u16(source_16), 6);
-        uint16x4_t added_2 = vqadd_u16(values, vreinterpret_u16_u8(randvec));
-        source_16 += 4;
-
-        // Reinterpret the two added vectors as 8x8, zip them together, and
-        // discard the lower portions.
-        uint8x8_t zipped =
-            vuzp_u8(vreinterpret_u8_u16(added_1), vreinterpret_u8_u16(added_2))
-                .val[1];
-        vst1_u8(destination, zipped);
-        destination += 8;
-
-        // Run it again with the next two rounds using the remaining
-        // entropy in randvec.
-
-        // Round 3.
-        randvec = vshl_n_u8(randvec, 2);
-        values = vshl_n_u16(vld1_u16(source_16), 6);
-        added_1 = vqadd_u16(values, vreinterpret_u16_u8(randvec));
-        source_16 += 4;
-
-        // Round 4.
-        randvec = vshl_n_u8(randvec, 2);
-        values = vshl_n_u16(vld1_u16(source_16), 6);
-        added_2 = vqadd_u16(values, vreinterpret_u16_u8(randvec));
-        source_16 += 4;
-
-        zipped =
-            vuzp_u8(vreinterpret_u8_u16(added_1), vreinterpret_u8_u16(added_2))
-                .val[1];
-        vst1_u8(destination, zipped);
-        destination += 8;
-      }
-
-      uint32_t randval = 0;
-      // For the remaining pixels in each row - usually none, as most
-      // standard sizes are divisible by 32 - convert them "by hand".
-      for (; j < decoder_buffer->displayed_width[plane_index]; j++) {
-        if (!randval) randval = random();
-        destination[j] = (source_16[j] + (randval & 3)) >> 2;
-        randval >>= 2;
-      }
-
-      source += decoder_buffer->stride[plane_index];
-      data += decoder_buffer->stride[plane_index];
-    }
+    convert_10_to_8_plane(decoder_buffer->plane[plane_index],
+                          decoder_buffer->stride[plane_index],
+                          reinterpret_cast<uint8_t*>(data),
+                          decoder_buffer->stride[plane_index],
+                          decoder_buffer->displayed_width[plane_index],
+                          decoder_buffer->displayed_height[plane_index]);
+    data += decoder_buffer->stride[plane_index] *
+            decoder_buffer->displayed_height[plane_index];
   }
 }
-#endif  // CPU_FEATURES_COMPILED_ANY_ARM_NEON
 
 }  // namespace
 
@@ -515,20 +385,17 @@ DECODER_FUNC(jlong, gav1Init, jint threads) {
     return kStatusError;
   }
 
-#ifdef CPU_FEATURES_ARCH_ARM
+#if defined(__arm__)
   // Libgav1 requires NEON with arm ABIs.
-#ifdef CPU_FEATURES_COMPILED_ANY_ARM_NEON
-  const cpu_features::ArmFeatures arm_features =
-      cpu_features::GetArmInfo().features;
-  if (!arm_features.neon) {
+  if (!exoplayer_jni::GetCpuFeatures().neon) {
     context->jni_status_code = kJniStatusNeonNotSupported;
+    context->PublishStatus();
     return reinterpret_cast<jlong>(context);
   }
-#else
-  context->jni_status_code = kJniStatusNeonNotSupported;
-  return reinterpret_cast<jlong>(context);
-#endif  // CPU_FEATURES_COMPILED_ANY_ARM_NEON
-#endif  // CPU_FEATURES_ARCH_ARM
+#endif  // defined(__arm__)
+
+  const int64_t parameters[] = {threads};
+  context->recorder.SetInitParameters(parameters, 1, nullptr, 0);
 
   libgav1::DecoderSettings settings;
   settings.threads = threads;
@@ -538,39 +405,49 @@ DECODER_FUNC(jlong, gav1Init, jint threads) {
 
   context->libgav1_status_code = context->decoder.Init(&settings);
   if (context->libgav1_status_code != kLibgav1StatusOk) {
+    context->PublishStatus();
     return reinterpret_cast<jlong>(context);
   }
 
-  // Populate JNI References.
-  const jclass outputBufferClass = env->FindClass(
-      "com/google/android/exoplayer2/video/VideoDecoderOutputBuffer");
-  context->decoder_private_field =
-      env->GetFieldID(outputBufferClass, "decoderPrivate", "I");
-  context->output_mode_field = env->GetFieldID(outputBufferClass, "mode", "I");
-  context->data_field =
-      env->GetFieldID(outputBufferClass, "data", "Ljava/nio/ByteBuffer;");
-  context->init_for_private_frame_method =
-      env->GetMethodID(outputBufferClass, "initForPrivateFrame", "(II)V");
-  context->init_for_yuv_frame_method =
-      env->GetMethodID(outputBufferClass, "initForYuvFrame", "(IIIII)Z");
-
+  context->PublishStatus();
   return reinterpret_cast<jlong>(context);
 }
 
+DECODER_FUNC(jobject, gav1GetStatusBuffer, jlong jContext) {
+  JniContext* const context = reinterpret_cast<JniContext*>(jContext);
+  return context->status.NewByteBuffer(env);
+}
+
 DECODER_FUNC(void, gav1Close, jlong jContext) {
   JniContext* const context = reinterpret_cast<JniContext*>(jContext);
   delete context;
+  exoplayer_jni::FlushProfile();
 }
 
 DECODER_FUNC(jint, gav1Decode, jlong jContext, jobject encodedData,
              jint length) {
   JniContext* const context = reinterpret_cast<JniContext*>(jContext);
+  exoplayer_jni::ScopedNativeCallTimer call_timer(&context->stats);
   const uint8_t* const buffer = reinterpret_cast<const uint8_t*>(
       env->GetDirectBufferAddress(encodedData));
-  context->libgav1_status_code =
-      context->decoder.EnqueueFrame(buffer, length, /*user_private_data=*/0,
-                                    /*buffer_private_data=*/nullptr);
+  exoplayer_jni::ScopedSessionRecord record(
+      &context->recorder, exoplayer_jni::session_format::kRecordDecode, buffer,
+      length);
+  context->stats.Increment(exoplayer_jni::DecoderStats::kInputBufferCount);
+  context->stats.Increment(exoplayer_jni::DecoderStats::kInputByteCount,
+                           length);
+  const int64_t start_time_us = exoplayer_jni::GetMonotonicTimeUs();
+  {
+    EXO_TRACE_SCOPE("gav1:decode");
+    context->libgav1_status_code =
+        context->decoder.EnqueueFrame(buffer, length, /*user_private_data=*/0,
+                                      /*buffer_private_data=*/nullptr);
+  }
+  context->enqueue_time_us =
+      exoplayer_jni::GetMonotonicTimeUs() - start_time_us;
+  record.set_result(context->libgav1_status_code);
   if (context->libgav1_status_code != kLibgav1StatusOk) {
+    context->stats.Increment(exoplayer_jni::DecoderStats::kDecodeErrorCount);
     return kStatusError;
   }
   return kStatusOk;
@@ -579,29 +456,60 @@ DECODER_FUNC(jint, gav1Decode, jlong jContext, jobject encodedData,
 DECODER_FUNC(jint, gav1GetFrame, jlong jContext, jobject jOutputBuffer,
              jboolean decodeOnly) {
   JniContext* const context = reinterpret_cast<JniContext*>(jContext);
+  exoplayer_jni::ScopedNativeCallTimer call_timer(&context->stats);
+  // The recorded result is the outcome of dequeuing the frame, which doesn't
+  // include errors in producing the output.
+  exoplayer_jni::ScopedSessionRecord record(
+      &context->recorder, exoplayer_jni::session_format::kRecordGetFrame);
+  if (decodeOnly) {
+    record.set_flags(exoplayer_jni::session_format::kFlagDecodeOnly);
+  }
   const libgav1::DecoderBuffer* decoder_buffer;
-  context->libgav1_status_code = context->decoder.DequeueFrame(&decoder_buffer);
+  const int64_t start_time_us = exoplayer_jni::GetMonotonicTimeUs();
+  {
+    EXO_TRACE_SCOPE("gav1:decode");
+    context->libgav1_status_code =
+        context->decoder.DequeueFrame(&decoder_buffer);
+  }
+  // Libgav1 may decode in either EnqueueFrame or DequeueFrame, so the decode
+  // time includes both.
+  context->stats.RecordLatency(exoplayer_jni::DecoderStats::kDecodeTime,
+                               context->enqueue_time_us +
+                                   exoplayer_jni::GetMonotonicTimeUs() -
+                                   start_time_us);
   if (context->libgav1_status_code != kLibgav1StatusOk) {
+    context->stats.Increment(exoplayer_jni::DecoderStats::kDecodeErrorCount);
+    record.set_result(kStatusError);
     return kStatusError;
   }
 
   if (decodeOnly || decoder_buffer == nullptr) {
+    record.set_result(kStatusDecodeOnly);
     // This is not an error. The input data was decode-only or no displayable
     // frames are available.
+    if (decoder_buffer != nullptr) {
+      context->stats.Increment(
+          exoplayer_jni::DecoderStats::kSkippedOutputBufferCount);
+    }
     return kStatusDecodeOnly;
   }
 
-  const int output_mode =
-      env->GetIntField(jOutputBuffer, context->output_mode_field);
+  record.set_result(kStatusOk);
+  const int output_mode = env->GetIntField(jOutputBuffer, output_mode_field);
+  context->recorder.SetOutputMode(output_mode);
   if (output_mode == kOutputModeYuv) {
     // Resize the buffer if required. Default color conversion will be used as
     // libgav1::DecoderBuffer doesn't expose color space info.
-    const jboolean init_result = env->CallBooleanMethod(
-        jOutputBuffer, context->init_for_yuv_frame_method,
-        decoder_buffer->displayed_width[kPlaneY],
-        decoder_buffer->displayed_height[kPlaneY],
-        decoder_buffer->stride[kPlaneY], decoder_buffer->stride[kPlaneU],
-        kColorSpaceUnknown);
+    jboolean init_result;
+    {
+      exoplayer_jni::ScopedUpcallTimer upcall_timer(&context->stats);
+      init_result = env->CallBooleanMethod(
+          jOutputBuffer, init_for_yuv_frame_method,
+          decoder_buffer->displayed_width[kPlaneY],
+          decoder_buffer->displayed_height[kPlaneY],
+          decoder_buffer->stride[kPlaneY], decoder_buffer->stride[kPlaneU],
+          kColorSpaceUnknown);
+    }
     if (env->ExceptionCheck()) {
       // Exception is thrown in Java when returning from the native call.
       return kStatusError;
@@ -611,26 +519,30 @@ DECODER_FUNC(jint, gav1GetFrame, jlong jContext, jobject jOutputBuffer,
       return kStatusError;
     }
 
-    const jobject data_object =
-        env->GetObjectField(jOutputBuffer, context->data_field);
+    const jobject data_object = env->GetObjectField(jOutputBuffer, data_field);
     jbyte* const data =
         reinterpret_cast<jbyte*>(env->GetDirectBufferAddress(data_object));
 
+    exoplayer_jni::ScopedLatencyTimer convert_timer(
+        &context->stats, exoplayer_jni::DecoderStats::kConvertTime);
     switch (decoder_buffer->bitdepth) {
       case 8:
         CopyFrameToDataBuffer(decoder_buffer, data);
         break;
       case 10:
-#ifdef CPU_FEATURES_COMPILED_ANY_ARM_NEON
-        Convert10BitFrameTo8BitDataBufferNeon(decoder_buffer, data);
-#else
         Convert10BitFrameTo8BitDataBuffer(decoder_buffer, data);
-#endif  // CPU_FEATURES_COMPILED_ANY_ARM_NEON
         break;
       default:
         context->jni_status_code = kJniStatusBitDepth12NotSupportedWithYuv;
         return kStatusError;
     }
+    for (int plane_index = kPlaneY; plane_index < decoder_buffer->NumPlanes();
+         plane_index++) {
+      context->stats.Increment(
+          exoplayer_jni::DecoderStats::kOutputByteCount,
+          decoder_buffer->stride[plane_index] *
+              decoder_buffer->displayed_height[plane_index]);
+    }
   } else if (output_mode == kOutputModeSurfaceYuv) {
     if (decoder_buffer->bitdepth != 8) {
       context->jni_status_code =
@@ -645,28 +557,38 @@ DECODER_FUNC(jint, gav1GetFrame, jlong jContext, jobject jOutputBuffer,
 
     const int buffer_id =
         *static_cast<const int*>(decoder_buffer->buffer_private_data);
+    record.set_argument(buffer_id);
     context->buffer_manager.AddBufferReference(buffer_id);
     JniFrameBuffer* const jni_buffer =
         context->buffer_manager.GetBuffer(buffer_id);
     jni_buffer->SetFrameData(*decoder_buffer);
-    env->CallVoidMethod(jOutputBuffer, context->init_for_private_frame_method,
-                        decoder_buffer->displayed_width[kPlaneY],
-                        decoder_buffer->displayed_height[kPlaneY]);
+    {
+      exoplayer_jni::ScopedUpcallTimer upcall_timer(&context->stats);
+      env->CallVoidMethod(jOutputBuffer, init_for_private_frame_method,
+                          decoder_buffer->displayed_width[kPlaneY],
+                          decoder_buffer->displayed_height[kPlaneY]);
+    }
     if (env->ExceptionCheck()) {
       // Exception is thrown in Java when returning from the native call.
       return kStatusError;
     }
-    env->SetIntField(jOutputBuffer, context->decoder_private_field, buffer_id);
+    env->SetIntField(jOutputBuffer, decoder_private_field, buffer_id);
   }
 
+  context->stats.Increment(exoplayer_jni::DecoderStats::kOutputBufferCount);
   return kStatusOk;
 }
 
 DECODER_FUNC(jint, gav1RenderFrame, jlong jContext, jobject jSurface,
              jobject jOutputBuffer) {
   JniContext* const context = reinterpret_cast<JniContext*>(jContext);
-  const int buffer_id =
-      env->GetIntField(jOutputBuffer, context->decoder_private_field);
+  exoplayer_jni::ScopedNativeCallTimer call_timer(&context->stats);
+  exoplayer_jni::ScopedLatencyTimer render_timer(
+      &context->stats, exoplayer_jni::DecoderStats::kRenderTime);
+  exoplayer_jni::ScopedSessionRecord record(
+      &context->recorder, exoplayer_jni::session_format::kRecordRender);
+  const int buffer_id = env->GetIntField(jOutputBuffer, decoder_private_field);
+  record.set_argument(buffer_id);
   JniFrameBuffer* const jni_buffer =
       context->buffer_manager.GetBuffer(buffer_id);
 
@@ -687,50 +609,65 @@ DECODER_FUNC(jint, gav1RenderFrame, jlong jContext, jobject jSurface,
   }
 
   ANativeWindow_Buffer native_window_buffer;
-  if (ANativeWindow_lock(context->native_window, &native_window_buffer,
-                         /*inOutDirtyBounds=*/nullptr) ||
-      native_window_buffer.bits == nullptr) {
+  int lock_result;
+  {
+    EXO_TRACE_SCOPE("gav1:renderLock");
+    lock_result = ANativeWindow_lock(context->native_window,
+                                     &native_window_buffer,
+                                     /*inOutDirtyBounds=*/nullptr);
+  }
+  if (lock_result || native_window_buffer.bits == nullptr) {
     context->jni_status_code = kJniStatusANativeWindowError;
     return kStatusError;
   }
 
-  // Y plane
-  CopyPlane(jni_buffer->Plane(kPlaneY), jni_buffer->Stride(kPlaneY),
-            reinterpret_cast<uint8_t*>(native_window_buffer.bits),
-            native_window_buffer.stride, jni_buffer->DisplayedWidth(kPlaneY),
-            jni_buffer->DisplayedHeight(kPlaneY));
-
-  const int y_plane_size =
-      native_window_buffer.stride * native_window_buffer.height;
-  const int32_t native_window_buffer_uv_height =
-      (native_window_buffer.height + 1) / 2;
-  const int native_window_buffer_uv_stride =
-      AlignTo16(native_window_buffer.stride / 2);
-
-  // TODO(b/140606738): Handle monochrome videos.
-
-  // V plane
-  // Since the format for ANativeWindow is YV12, V plane is being processed
-  // before U plane.
-  const int v_plane_height = std::min(native_window_buffer_uv_height,
-                                      jni_buffer->DisplayedHeight(kPlaneV));
-  CopyPlane(
-      jni_buffer->Plane(kPlaneV), jni_buffer->Stride(kPlaneV),
-      reinterpret_cast<uint8_t*>(native_window_buffer.bits) + y_plane_size,
-      native_window_buffer_uv_stride, jni_buffer->DisplayedWidth(kPlaneV),
-      v_plane_height);
-
-  const int v_plane_size = v_plane_height * native_window_buffer_uv_stride;
-
-  // U plane
-  CopyPlane(jni_buffer->Plane(kPlaneU), jni_buffer->Stride(kPlaneU),
-            reinterpret_cast<uint8_t*>(native_window_buffer.bits) +
-                y_plane_size + v_plane_size,
-            native_window_buffer_uv_stride, jni_buffer->DisplayedWidth(kPlaneU),
-            std::min(native_window_buffer_uv_height,
-                     jni_buffer->DisplayedHeight(kPlaneU)));
-
-  if (ANativeWindow_unlockAndPost(context->native_window)) {
+  {
+    EXO_TRACE_SCOPE("gav1:copy");
+    // Y plane
+    exoplayer_jni::CopyPlane(
+        jni_buffer->Plane(kPlaneY), jni_buffer->Stride(kPlaneY),
+        reinterpret_cast<uint8_t*>(native_window_buffer.bits),
+        native_window_buffer.stride, jni_buffer->DisplayedWidth(kPlaneY),
+        jni_buffer->DisplayedHeight(kPlaneY));
+
+    const int y_plane_size =
+        native_window_buffer.stride * native_window_buffer.height;
+    const int32_t native_window_buffer_uv_height =
+        (native_window_buffer.height + 1) / 2;
+    const int native_window_buffer_uv_stride =
+        AlignTo16(native_window_buffer.stride / 2);
+
+    // TODO(b/140606738): Handle monochrome videos.
+
+    // V plane
+    // Since the format for ANativeWindow is YV12, V plane is being processed
+    // before U plane.
+    const int v_plane_height = std::min(native_window_buffer_uv_height,
+                                        jni_buffer->DisplayedHeight(kPlaneV));
+    exoplayer_jni::CopyPlane(
+        jni_buffer->Plane(kPlaneV), jni_buffer->Stride(kPlaneV),
+        reinterpret_cast<uint8_t*>(native_window_buffer.bits) + y_plane_size,
+        native_window_buffer_uv_stride, jni_buffer->DisplayedWidth(kPlaneV),
+        v_plane_height);
+
+    const int v_plane_size = v_plane_height * native_window_buffer_uv_stride;
+
+    // U plane
+    exoplayer_jni::CopyPlane(
+        jni_buffer->Plane(kPlaneU), jni_buffer->Stride(kPlaneU),
+        reinterpret_cast<uint8_t*>(native_window_buffer.bits) + y_plane_size +
+            v_plane_size,
+        native_window_buffer_uv_stride, jni_buffer->DisplayedWidth(kPlaneU),
+        std::min(native_window_buffer_uv_height,
+                 jni_buffer->DisplayedHeight(kPlaneU)));
+  }
+
+  int post_result;
+  {
+    EXO_TRACE_SCOPE("gav1:renderPost");
+    post_result = ANativeWindow_unlockAndPost(context->native_window);
+  }
+  if (post_result) {
     context->jni_status_code = kJniStatusANativeWindowError;
     return kStatusError;
   }
@@ -740,9 +677,13 @@ DECODER_FUNC(jint, gav1RenderFrame, jlong jContext, jobject jSurface,
 
 DECODER_FUNC(void, gav1ReleaseFrame, jlong jContext, jobject jOutputBuffer) {
   JniContext* const context = reinterpret_cast<JniContext*>(jContext);
-  const int buffer_id =
-      env->GetIntField(jOutputBuffer, context->decoder_private_field);
-  env->SetIntField(jOutputBuffer, context->decoder_private_field, -1);
+  exoplayer_jni::ScopedNativeCallTimer call_timer(&context->stats);
+  const int buffer_id = env->GetIntField(jOutputBuffer, decoder_private_field);
+  exoplayer_jni::ScopedSessionRecord record(
+      &context->recorder, exoplayer_jni::session_format::kRecordReleaseFrame);
+  record.set_argument(buffer_id);
+  env->SetIntField(jOutputBuffer, decoder_private_field, -1);
+  EXO_TRACE_SCOPE("gav1:bufferRelease");
   context->jni_status_code = context->buffer_manager.ReleaseBuffer(buffer_id);
   if (context->jni_status_code != kJniStatusOk) {
     LOGE("%s", GetJniErrorMessage(context->jni_status_code));
@@ -766,13 +707,42 @@ DECODER_FUNC(jstring, gav1GetErrorMessage, jlong jContext) {
   return env->NewStringUTF("None.");
 }
 
-DECODER_FUNC(jint, gav1CheckError, jlong jContext) {
+DECODER_FUNC(jint, gav1ReserveFrameBuffers, jlong jContext, jint count,
+             jint width, jint height) {
   JniContext* const context = reinterpret_cast<JniContext*>(jContext);
-  if (context->libgav1_status_code != kLibgav1StatusOk ||
-      context->jni_status_code != kJniStatusOk) {
-    return kStatusError;
+  // The borders and stride alignment that libgav1 requests for 8-bit frames.
+  libgav1::FrameBufferInfo info;
+  if (libgav1::ComputeFrameBufferInfo(
+          /*bitdepth=*/8, libgav1::kImageFormatYuv420, width, height,
+          /*left_border=*/64, /*right_border=*/64, /*top_border=*/64,
+          /*bottom_border=*/64, /*stride_alignment=*/16,
+          &info) != kLibgav1StatusOk) {
+    return 0;
+  }
+  return context->buffer_manager.Reserve(
+      count, info.y_buffer_size + 2 * info.uv_buffer_size);
+}
+
+DECODER_FUNC(void, gav1GetStats, jlong jContext, jlongArray jStats) {
+  JniContext* const context = reinterpret_cast<JniContext*>(jContext);
+  exoplayer_jni::GetStatsSnapshot(env, context->stats, jStats);
+}
+
+DECODER_FUNC(jboolean, gav1StartSessionRecording, jlong jContext,
+             jstring jPath) {
+  JniContext* const context = reinterpret_cast<JniContext*>(jContext);
+  const char* const path = env->GetStringUTFChars(jPath, nullptr);
+  const bool started = context->recorder.Start(path);
+  if (!started) {
+    LOGE("Failed to start session recording to %s.", path);
   }
-  return kStatusOk;
+  env->ReleaseStringUTFChars(jPath, path);
+  return started;
+}
+
+DECODER_FUNC(void, gav1StopSessionRecording, jlong jContext) {
+  JniContext* const context = reinterpret_cast<JniContext*>(jContext);
+  context->recorder.Stop();
 }
 
 DECODER_FUNC(jint, gav1GetThreads) {
@@ -781,3 +751,40 @@ DECODER_FUNC(jint, gav1GetThreads) {
 
 // TODO(b/139902005): Add functions for getting libgav1 version and build
 // configuration once libgav1 ABI provides this information.
+
+#define DECODER_METHOD(NAME, SIGNATURE) \
+  EXOPLAYER_JNI_METHOD(                 \
+      #NAME, SIGNATURE,                 \
+      Java_com_google_android_exoplayer2_ext_av1_Gav1Decoder_##NAME)
+
+namespace {
+
+bool RegisterNativeMethods(JNIEnv* env) {
+  static const JNINativeMethod kDecoderMethods[] = {
+      DECODER_METHOD(gav1Init, "(I)J"),
+      DECODER_METHOD(gav1Close, "(J)V"),
+      DECODER_METHOD(gav1Decode, "(JLjava/nio/ByteBuffer;I)I"),
+      DECODER_METHOD(
+          gav1GetFrame,
+          "(JLcom/google/android/exoplayer2/video/VideoDecoderOutputBuffer;"
+          "Z)I"),
+      DECODER_METHOD(
+          gav1RenderFrame,
+          "(JLandroid/view/Surface;"
+          "Lcom/google/android/exoplayer2/video/VideoDecoderOutputBuffer;)I"),
+      DECODER_METHOD(
+          gav1ReleaseFrame,
+          "(JLcom/google/android/exoplayer2/video/VideoDecoderOutputBuffer;)V"),
+      DECODER_METHOD(gav1GetErrorMessage, "(J)Ljava/lang/String;"),
+      DECODER_METHOD(gav1GetStatusBuffer, "(J)Ljava/nio/ByteBuffer;"),
+      DECODER_METHOD(gav1ReserveFrameBuffers, "(JIII)I"),
+      DECODER_METHOD(gav1GetStats, "(J[J)V"),
+      DECODER_METHOD(gav1StartSessionRecording, "(JLjava/lang/String;)Z"),
+      DECODER_METHOD(gav1StopSessionRecording, "(J)V"),
+      DECODER_METHOD(gav1GetThreads, "()I")};
+  return exoplayer_jni::RegisterNatives(
+      env, "com/google/android/exoplayer2/ext/av1/Gav1Decoder",
+      kDecoderMethods);
+}
+
+}  // namespace
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.google.android.exoplayer2.ext.ffmpeg;
+
+import static com.google.common.truth.Truth.assertThat;
+
+import androidx.annotation.Nullable;
+import androidx.test.ext.junit.runners.AndroidJUnit4;
+import androidx.test.platform.app.InstrumentationRegistry;
+import com.google.android.exoplayer2.util.Log;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+
+/**
+ * Measures the cost of loading the FFmpeg extension's native libraries, and of the first calls into
+ * them.
+ *
+ * <p>Libraries are loaded at most once per process, so this test must be run on its own, for
+ * example by passing its class name to {@code am instrument} with {@code -e class}. The libraries
+ * to load can be set with the {@code nativeLibraries} instrumentation argument, a comma-separated
+ * list of library names, for example to measure the combined extension library built by {@code
+ * extensions/jni_common/combined/Android.mk}.
+ */
+@RunWith(AndroidJUnit4.class)
+public final class FfmpegLibraryLoadBenchmarkTest {
+
+  private static final String TAG = "FfmpegLibraryLoadBench";
+
+  @Test
+  public void loadLibraries_reportsLoadAndFirstCallTime() throws Exception {
+    @Nullable
+    String libraries = InstrumentationRegistry.getArguments().getString("nativeLibraries");
+    if (libraries != null) {
+      FfmpegLibrary.setLibraries(libraries.split(","));
+    }
+
+    long startTimeNs = System.nanoTime();
+    assertThat(FfmpegLibrary.isAvailable()).isTrue();
+    long loadEndTimeNs = System.nanoTime();
+    assertThat(FfmpegLibrary.getVersion()).isNotNull();
+    long firstCallEndTimeNs = System.nanoTime();
+    assertThat(FfmpegLibrary.getVersion()).isNotNull();
+    long secondCallEndTimeNs = System.nanoTime();
+
+    Log.i(
+        TAG,
+        (libraries == null ? "extension libraries" : libraries)
+            + ": load "
+            + (loadEndTimeNs - startTimeNs) / 1000
+            + " us, first call "
+            + (firstCallEndTimeNs - loadEndTimeNs) / 1000
+            + " us, second call "
+            + (secondCallEndTimeNs - firstCallEndTimeNs) / 1000
+            + " us");
+  }
+}
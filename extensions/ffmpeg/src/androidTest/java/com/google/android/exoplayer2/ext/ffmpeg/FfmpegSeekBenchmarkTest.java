@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.google.android.exoplayer2.ext.ffmpeg;
+
+import static com.google.common.truth.Truth.assertThat;
+import static org.junit.Assert.fail;
+
+import android.content.Context;
+import android.net.Uri;
+import androidx.test.core.app.ApplicationProvider;
+import androidx.test.ext.junit.runners.AndroidJUnit4;
+import com.google.android.exoplayer2.C;
+import com.google.android.exoplayer2.Format;
+import com.google.android.exoplayer2.decoder.DecoderInputBuffer;
+import com.google.android.exoplayer2.decoder.SimpleOutputBuffer;
+import com.google.android.exoplayer2.extractor.SeekMap;
+import com.google.android.exoplayer2.extractor.mp3.Mp3Extractor;
+import com.google.android.exoplayer2.testutil.FakeExtractorOutput;
+import com.google.android.exoplayer2.testutil.FakeTrackOutput;
+import com.google.android.exoplayer2.testutil.TestUtil;
+import com.google.android.exoplayer2.upstream.DefaultDataSourceFactory;
+import com.google.android.exoplayer2.upstream.StatsDataSource;
+import com.google.android.exoplayer2.util.Assertions;
+import com.google.android.exoplayer2.util.Log;
+import com.google.android.exoplayer2.util.MimeTypes;
+import java.util.Arrays;
+import java.util.Random;
+import org.junit.Before;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+
+/**
+ * Measures the time from a seek to the first output sample with {@link FfmpegAudioDecoder}, for a
+ * sequence of seeks to random positions in MP3 streams, when the seek position is found using a
+ * Xing header and when it's computed from a constant bitrate.
+ *
+ * <p>The time is split into the extractor seek, which finds the frame at the seek position and
+ * reads it, the decode of that frame after the decoder is reset, and the decode of any following
+ * frames until the first sample is output.
+ */
+@RunWith(AndroidJUnit4.class)
+public final class FfmpegSeekBenchmarkTest {
+
+  private static final String TAG = "FfmpegSeekBenchmark";
+  private static final String TEST_FILE_XING = "media/mp3/bear-vbr-xing-header.mp3";
+  private static final String TEST_FILE_CONSTANT_BITRATE =
+      "media/mp3/bear-cbr-constant-frame-size-no-seek-table.mp3";
+  private static final int SEEK_COUNT = 100;
+
+  @Before
+  public void setUp() {
+    if (!FfmpegLibrary.isAvailable()) {
+      fail("Ffmpeg library not available.");
+    }
+    if (!FfmpegLibrary.supportsFormat(MimeTypes.AUDIO_MPEG)) {
+      fail("Ffmpeg library built without an MP3 decoder.");
+    }
+  }
+
+  @Test
+  public void randomSeeks_xing_reportsTimeToFirstSample() throws Exception {
+    benchmarkRandomSeeks(TEST_FILE_XING, /* extractorFlags= */ 0);
+  }
+
+  @Test
+  public void randomSeeks_constantBitrate_reportsTimeToFirstSample() throws Exception {
+    benchmarkRandomSeeks(
+        TEST_FILE_CONSTANT_BITRATE, Mp3Extractor.FLAG_ENABLE_CONSTANT_BITRATE_SEEKING);
+  }
+
+  private static void benchmarkRandomSeeks(String fileName, int extractorFlags)
+      throws Exception {
+    Context context = ApplicationProvider.getApplicationContext();
+    FakeTrackOutput expectedTrackOutput =
+        TestUtil.extractAllSamplesFromFile(new Mp3Extractor(extractorFlags), context, fileName)
+            .trackOutputs
+            .valueAt(0);
+    Uri fileUri = TestUtil.buildAssetUri(fileName);
+    Mp3Extractor extractor = new Mp3Extractor(extractorFlags);
+    FakeExtractorOutput extractorOutput = new FakeExtractorOutput();
+    StatsDataSource dataSource =
+        new StatsDataSource(new DefaultDataSourceFactory(context).createDataSource());
+    SeekMap seekMap = TestUtil.extractSeekMap(extractor, extractorOutput, dataSource, fileUri);
+    assertThat(seekMap.isSeekable()).isTrue();
+    FakeTrackOutput trackOutput = extractorOutput.trackOutputs.valueAt(0);
+    Format format = Assertions.checkNotNull(expectedTrackOutput.lastFormat);
+    FfmpegAudioDecoder decoder =
+        new FfmpegAudioDecoder(
+            format,
+            /* numInputBuffers= */ 1,
+            /* numOutputBuffers= */ 1,
+            format.maxInputSize,
+            /* outputFloat= */ false);
+    DecoderInputBuffer inputBuffer = decoder.createInputBuffer();
+    SimpleOutputBuffer outputBuffer = decoder.createOutputBuffer();
+
+    Random random = new Random(/* seed= */ 0);
+    long[] seekTimesNs = new long[SEEK_COUNT];
+    long[] resetTimesNs = new long[SEEK_COUNT];
+    long[] preRollTimesNs = new long[SEEK_COUNT];
+    long[] totalTimesNs = new long[SEEK_COUNT];
+    long preRollFrameCount = 0;
+    dataSource.resetBytesRead();
+    for (int i = 0; i < SEEK_COUNT; i++) {
+      // Frames near the end may not produce any output before the end of the stream, so seeks are
+      // made to positions in the first half of the stream.
+      long seekTimeUs = (long) (random.nextDouble() * seekMap.getDurationUs() / 2);
+      long startTimeNs = System.nanoTime();
+      int sampleIndex =
+          TestUtil.seekToTimeUs(extractor, seekMap, seekTimeUs, dataSource, trackOutput, fileUri);
+      long seekEndTimeNs = System.nanoTime();
+      assertThat(sampleIndex).isNotEqualTo(C.INDEX_UNSET);
+      boolean hasOutput =
+          decodeSample(
+              decoder, trackOutput, sampleIndex, /* reset= */ true, inputBuffer, outputBuffer);
+      long resetEndTimeNs = System.nanoTime();
+      // Constant bitrate seeks may land on any frame, so the following frames are taken from the
+      // samples extracted from the whole stream.
+      int preRollIndex =
+          getSampleIndex(expectedTrackOutput, trackOutput.getSampleTimeUs(sampleIndex));
+      int firstPreRollIndex = preRollIndex;
+      while (!hasOutput) {
+        preRollIndex++;
+        hasOutput =
+            decodeSample(
+                decoder,
+                expectedTrackOutput,
+                preRollIndex,
+                /* reset= */ false,
+                inputBuffer,
+                outputBuffer);
+      }
+      long endTimeNs = System.nanoTime();
+
+      seekTimesNs[i] = seekEndTimeNs - startTimeNs;
+      resetTimesNs[i] = resetEndTimeNs - seekEndTimeNs;
+      preRollTimesNs[i] = endTimeNs - resetEndTimeNs;
+      totalTimesNs[i] = endTimeNs - startTimeNs;
+      preRollFrameCount += preRollIndex - firstPreRollIndex;
+    }
+    decoder.release();
+
+    Log.i(
+        TAG,
+        fileName
+            + ": time to first sample p50 "
+            + getPercentileUs(totalTimesNs, 50)
+            + " us, p90 "
+            + getPercentileUs(totalTimesNs, 90)
+            + " us; seek p50 "
+            + getPercentileUs(seekTimesNs, 50)
+            + " us, reset and first decode p50 "
+            + getPercentileUs(resetTimesNs, 50)
+            + " us, pre-roll p50 "
+            + getPercentileUs(preRollTimesNs, 50)
+            + " us over "
+            + preRollFrameCount / (double) SEEK_COUNT
+            + " frames; "
+            + dataSource.getBytesRead() / SEEK_COUNT
+            + " bytes read per seek");
+  }
+
+  /**
+   * Decodes the sample at {@code index}, resetting the decoder first if {@code reset} is true.
+   * Returns whether any samples were output.
+   */
+  private static boolean decodeSample(
+      FfmpegAudioDecoder decoder,
+      FakeTrackOutput trackOutput,
+      int index,
+      boolean reset,
+      DecoderInputBuffer inputBuffer,
+      SimpleOutputBuffer outputBuffer) {
+    byte[] sampleData = trackOutput.getSampleData(index);
+    inputBuffer.clear();
+    inputBuffer.ensureSpaceForWrite(sampleData.length);
+    Assertions.checkNotNull(inputBuffer.data).put(sampleData);
+    inputBuffer.flip();
+    inputBuffer.timeUs = trackOutput.getSampleTimeUs(index);
+    outputBuffer.clear();
+    assertThat(decoder.decode(inputBuffer, outputBuffer, reset)).isNull();
+    return !outputBuffer.isDecodeOnly()
+        && Assertions.checkNotNull(outputBuffer.data).hasRemaining();
+  }
+
+  /** Returns the index of the last sample at or before {@code timeUs}, or 0 if there's none. */
+  private static int getSampleIndex(FakeTrackOutput trackOutput, long timeUs) {
+    int index = 0;
+    while (index + 1 < trackOutput.getSampleCount()
+        && trackOutput.getSampleTimeUs(index + 1) <= timeUs) {
+      index++;
+    }
+    return index;
+  }
+
+  private static long getPercentileUs(long[] timesNs, int percentile) {
+    long[] sortedTimesNs = Arrays.copyOf(timesNs, timesNs.length);
+    Arrays.sort(sortedTimesNs);
+    return sortedTimesNs[(sortedTimesNs.length - 1) * percentile / 100] / 1000;
+  }
+}
@@ -15,10 +15,15 @@
  */
 package com.google.android.exoplayer2.ext.ffmpeg;
 
+import androidx.annotation.GuardedBy;
 import androidx.annotation.Nullable;
 import com.google.android.exoplayer2.C;
 import com.google.android.exoplayer2.Format;
+import com.google.android.exoplayer2.audio.AudioChainConfig;
+import com.google.android.exoplayer2.audio.DecoderCrossfade;
 import com.google.android.exoplayer2.decoder.DecoderInputBuffer;
+import com.google.android.exoplayer2.decoder.NativeDecoder;
+import com.google.android.exoplayer2.decoder.NativeDecoderStats;
 import com.google.android.exoplayer2.decoder.SimpleDecoder;
 import com.google.android.exoplayer2.decoder.SimpleOutputBuffer;
 import com.google.android.exoplayer2.util.Assertions;
@@ -26,11 +31,13 @@ import com.google.android.exoplayer2.util.MimeTypes;
 import com.google.android.exoplayer2.util.ParsableByteArray;
 import com.google.android.exoplayer2.util.Util;
 import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
 import java.util.List;
 
 /** FFmpeg audio decoder. */
 /* package */ final class FfmpegAudioDecoder
-    extends SimpleDecoder<DecoderInputBuffer, SimpleOutputBuffer, FfmpegDecoderException> {
+    extends SimpleDecoder<DecoderInputBuffer, SimpleOutputBuffer, FfmpegDecoderException>
+    implements NativeDecoder {
 
   // Output buffer sizes when decoding PCM mu-law streams, which is the maximum FFmpeg outputs.
   private static final int OUTPUT_BUFFER_SIZE_16BIT = 65536;
@@ -39,15 +46,37 @@ import java.util.List;
   // LINT.IfChange
   private static final int AUDIO_DECODER_ERROR_INVALID_DATA = -1;
   private static final int AUDIO_DECODER_ERROR_OTHER = -2;
+  private static final int AUDIO_DECODER_NO_DECODE_AHEAD_OUTPUT = -3;
+  // LINT.ThenChange(../../../../../../../jni/ffmpeg_jni.cc)
+
+  // Slots of the status block that is published by the native decoder.
+  // LINT.IfChange
+  private static final int STATUS_CHANNEL_COUNT = 0;
+  private static final int STATUS_SAMPLE_RATE = 1;
+  private static final int STATUS_SKIPPED_SILENCE_FRAME_COUNT = 2;
+  private static final int STATUS_INTEGRATED_LOUDNESS = 3;
+  private static final int STATUS_DECODE_ONLY = 4;
+  private static final int STATUS_TIME_US = 5;
   // LINT.ThenChange(../../../../../../../jni/ffmpeg_jni.cc)
 
   private final String codecName;
   @Nullable private final byte[] extraData;
   @C.Encoding private final int encoding;
-  private final int outputBufferSize;
+  private final int formatChannelCount;
+  private final int formatSampleRate;
+  private final ByteBuffer statusBuffer;
+  private final Object releaseLock;
 
-  private long nativeContext; // May be reassigned on resetting the codec.
+  // Set to 0 if resetting the codec fails. Only changed while holding releaseLock.
+  private long nativeContext;
+  @GuardedBy("releaseLock")
+  private boolean released;
+  private int outputBufferSize;
+  @Nullable private AudioChainConfig audioChainConfig;
   private boolean hasOutputFormat;
+  private int decodeAheadMs;
+  private boolean decodingAhead;
+  @Nullable private DecoderCrossfade crossfade;
   private volatile int channelCount;
   private volatile int sampleRate;
 
@@ -67,14 +96,127 @@ import java.util.List;
     extraData = getExtraData(format.sampleMimeType, format.initializationData);
     encoding = outputFloat ? C.ENCODING_PCM_FLOAT : C.ENCODING_PCM_16BIT;
     outputBufferSize = outputFloat ? OUTPUT_BUFFER_SIZE_32BIT : OUTPUT_BUFFER_SIZE_16BIT;
+    formatChannelCount = format.channelCount;
+    formatSampleRate = format.sampleRate;
     nativeContext =
         ffmpegInitialize(codecName, extraData, outputFloat, format.sampleRate, format.channelCount);
     if (nativeContext == 0) {
       throw new FfmpegDecoderException("Initialization failed.");
     }
+    statusBuffer = ffmpegGetStatusBuffer(nativeContext).order(ByteOrder.nativeOrder());
+    releaseLock = new Object();
     setInitialInputBufferSize(initialInputBufferSize);
   }
 
+  /**
+   * Sets the processing that the native decoder applies to its output. May only be called once,
+   * before the first input buffer is queued. The channel count of the format that the decoder was
+   * created for must be known, and its sample rate must be known to convert the sample rate.
+   *
+   * @param audioChainConfig The configuration, or null to output the decoded samples unchanged.
+   * @throws FfmpegDecoderException If the configuration isn't supported for the format.
+   */
+  public void setAudioChainConfig(@Nullable AudioChainConfig audioChainConfig)
+      throws FfmpegDecoderException {
+    Assertions.checkState(this.audioChainConfig == null);
+    if (audioChainConfig == null) {
+      return;
+    }
+    boolean sampleRateKnown =
+        audioChainConfig.outputSampleRate == Format.NO_VALUE || formatSampleRate != Format.NO_VALUE;
+    if (!audioChainConfig.isApplicableTo(formatChannelCount)
+        || !sampleRateKnown
+        || !ffmpegSetAudioChainConfig(
+            nativeContext,
+            audioChainConfig.getChannelMap(),
+            audioChainConfig.gain,
+            audioChainConfig.speed,
+            audioChainConfig.pitch,
+            audioChainConfig.isSkippingSilence() ? audioChainConfig.minimumSilenceDurationUs : 0,
+            audioChainConfig.paddingSilenceUs,
+            audioChainConfig.getSilenceThreshold(),
+            audioChainConfig.measureLoudness,
+            audioChainConfig.waveformFramesPerPeak,
+            audioChainConfig.spectrumFftSize,
+            audioChainConfig.outputSampleRate,
+            audioChainConfig.outputEncoding)) {
+      throw new FfmpegDecoderException("Unsupported audio chain configuration.");
+    }
+    this.audioChainConfig = audioChainConfig;
+    // Output buffers must hold the processed output of the most samples FFmpeg outputs.
+    int maxFrameCount = outputBufferSize / Util.getPcmFrameSize(encoding, formatChannelCount);
+    outputBufferSize =
+        audioChainConfig.getMaxOutputSize(
+            maxFrameCount, encoding, formatChannelCount, formatSampleRate);
+  }
+
+  /**
+   * Sets the duration of output to keep decoded ahead on a native background thread, so that
+   * delays on the decode thread don't delay decoding. FFmpeg only reports the output format once
+   * it has decoded a frame, so input buffers are decoded on the decode thread until one produces
+   * output, and decoding moves to the background thread from the next one. Output buffers are then
+   * dequeued once enough output has been decoded, and the remaining output is drained at the end
+   * of the stream. May only be called once, after {@link #setAudioChainConfig(AudioChainConfig)}
+   * and before the first input buffer is queued.
+   *
+   * @param decodeAheadMs The duration of output to decode ahead, in milliseconds.
+   */
+  public void setDecodeAheadMs(int decodeAheadMs) {
+    Assertions.checkArgument(decodeAheadMs > 0);
+    Assertions.checkState(this.decodeAheadMs == 0);
+    this.decodeAheadMs = decodeAheadMs;
+  }
+
+  /**
+   * Crossfades the decoder's stream with the adjacent streams, as described in {@link
+   * DecoderCrossfade}. May only be called once, after {@link
+   * #setAudioChainConfig(AudioChainConfig)} and before the first input buffer is queued.
+   *
+   * @param durationUs The duration of the crossfade, in microseconds.
+   * @param curve The shape of the crossfade into this decoder's stream.
+   * @param previousDecoder The released decoder of the previous stream, whose held back output is
+   *     crossfaded into the start of this decoder's stream if it ended by crossfading into the next
+   *     stream, or null.
+   * @throws FfmpegDecoderException If the crossfade isn't supported.
+   */
+  public void setCrossfade(
+      long durationUs,
+      @DecoderCrossfade.Curve int curve,
+      @Nullable FfmpegAudioDecoder previousDecoder)
+      throws FfmpegDecoderException {
+    Assertions.checkState(crossfade == null);
+    crossfade =
+        DecoderCrossfade.create(
+            new CrossfadeMixer(),
+            durationUs,
+            curve,
+            getOutputSpeed(),
+            previousDecoder != null ? previousDecoder.crossfade : null);
+    if (crossfade == null) {
+      throw new FfmpegDecoderException("Unsupported crossfade.");
+    }
+  }
+
+  /**
+   * Keeps the output that's held back at the end of the stream for the next decoder. See {@link
+   * DecoderCrossfade#crossfadeIntoNextStream()}.
+   */
+  public void crossfadeIntoNextStream() {
+    if (crossfade != null) {
+      crossfade.crossfadeIntoNextStream();
+    }
+  }
+
+  /**
+   * Releases the output that's held back for the next decoder, if it wasn't passed on to it. See
+   * {@link DecoderCrossfade#releaseHeldOutput()}.
+   */
+  public void releaseCrossfade() {
+    if (crossfade != null) {
+      crossfade.releaseHeldOutput();
+    }
+  }
+
   @Override
   public String getName() {
     return "ffmpeg" + FfmpegLibrary.getVersion() + "-" + codecName;
@@ -102,18 +244,95 @@ import java.util.List;
   protected FfmpegDecoderException decode(
       DecoderInputBuffer inputBuffer, SimpleOutputBuffer outputBuffer, boolean reset) {
     if (reset) {
-      nativeContext = ffmpegReset(nativeContext, extraData);
+      synchronized (releaseLock) {
+        // Resetting the context frees it if recreating the codec fails.
+        nativeContext = ffmpegReset(nativeContext, extraData);
+      }
       if (nativeContext == 0) {
         return new FfmpegDecoderException("Error resetting (see logcat).");
       }
+      if (crossfade != null) {
+        crossfade.flush();
+      }
     }
     ByteBuffer inputData = Util.castNonNull(inputBuffer.data);
     int inputSize = inputData.limit();
     ByteBuffer outputData = outputBuffer.init(inputBuffer.timeUs, outputBufferSize);
+    if (decodingAhead) {
+      int result =
+          ffmpegDecodeAhead(
+              nativeContext,
+              inputBuffer.timeUs,
+              inputBuffer.isDecodeOnly(),
+              inputData,
+              inputSize,
+              outputData);
+      return processOutput(result, outputBuffer);
+    }
     int result = ffmpegDecode(nativeContext, inputData, inputSize, outputData, outputBufferSize);
+    @Nullable FfmpegDecoderException exception = processOutput(result, outputBuffer);
+    if (exception == null && hasOutputFormat && decodeAheadMs > 0) {
+      exception = startDecodeAhead();
+    }
+    return exception;
+  }
+
+  @Override
+  protected boolean hasPendingOutput() {
+    if (decodingAhead && ffmpegHasDecodeAheadOutput(nativeContext)) {
+      return true;
+    }
+    return crossfade != null && crossfade.hasPendingOutput();
+  }
+
+  @Override
+  @Nullable
+  protected FfmpegDecoderException decodePendingOutput(SimpleOutputBuffer outputBuffer) {
+    if (decodingAhead && ffmpegHasDecodeAheadOutput(nativeContext)) {
+      // The timestamp is set to that of the decoded input buffer.
+      ByteBuffer outputData = outputBuffer.init(/* timeUs= */ 0, outputBufferSize);
+      return processOutput(ffmpegDrainDecodeAhead(nativeContext, outputData), outputBuffer);
+    }
+    Util.castNonNull(crossfade).drain(outputBuffer);
+    return null;
+  }
+
+  /**
+   * Handles the result of a native decode call, and passes the output through the crossfade
+   * mixer.
+   *
+   * @param result The result of the call, which is the size of the output or an error code.
+   * @param outputBuffer The output buffer that the call decoded into.
+   * @return A decoder exception if an error occurred, or null otherwise.
+   */
+  @Nullable
+  private FfmpegDecoderException processOutput(int result, SimpleOutputBuffer outputBuffer) {
+    if (result == AUDIO_DECODER_NO_DECODE_AHEAD_OUTPUT) {
+      setNoOutput();
+      return null;
+    }
     if (result == AUDIO_DECODER_ERROR_OTHER) {
       return new FfmpegDecoderException("Error decoding (see logcat).");
-    } else if (result == AUDIO_DECODER_ERROR_INVALID_DATA) {
+    }
+    if (decodingAhead) {
+      // The output is of an earlier input buffer, which may have been decode-only.
+      outputBuffer.timeUs = statusBuffer.getLong(STATUS_TIME_US * 8);
+      if (statusBuffer.getLong(STATUS_DECODE_ONLY * 8) != 0) {
+        outputBuffer.addFlag(C.BUFFER_FLAG_DECODE_ONLY);
+      } else {
+        outputBuffer.clearFlag(C.BUFFER_FLAG_DECODE_ONLY);
+      }
+    }
+    ByteBuffer outputData = Util.castNonNull(outputBuffer.data);
+    long skippedSilenceFrameCount = statusBuffer.getLong(STATUS_SKIPPED_SILENCE_FRAME_COUNT * 8);
+    if (skippedSilenceFrameCount > 0) {
+      // Reported even if the silence was the packet's only output.
+      outputBuffer.skippedSilenceDurationUs =
+          skippedSilenceFrameCount
+              * C.MICROS_PER_SECOND
+              / statusBuffer.getLong(STATUS_SAMPLE_RATE * 8);
+    }
+    if (result == AUDIO_DECODER_ERROR_INVALID_DATA) {
       // Treat invalid data errors as non-fatal to match the behavior of MediaCodec. No output will
       // be produced for this buffer, so mark it as decode-only to ensure that the audio sink's
       // position is reset when more audio is produced.
@@ -125,8 +344,8 @@ import java.util.List;
       return null;
     }
     if (!hasOutputFormat) {
-      channelCount = ffmpegGetChannelCount(nativeContext);
-      sampleRate = ffmpegGetSampleRate(nativeContext);
+      channelCount = (int) statusBuffer.getLong(STATUS_CHANNEL_COUNT * 8);
+      sampleRate = (int) statusBuffer.getLong(STATUS_SAMPLE_RATE * 8);
       if (sampleRate == 0 && "alac".equals(codecName)) {
         Assertions.checkNotNull(extraData);
         // ALAC decoder did not set the sample rate in earlier versions of FFmpeg. See
@@ -139,14 +358,63 @@ import java.util.List;
     }
     outputData.position(0);
     outputData.limit(result);
+    if (crossfade != null && !outputBuffer.isDecodeOnly()) {
+      int mixedSize = crossfade.apply(outputBuffer, channelCount, sampleRate, getEncoding());
+      if (mixedSize < 0) {
+        return new FfmpegDecoderException("Error crossfading.");
+      } else if (mixedSize == 0) {
+        setNoOutput();
+      }
+    }
+    return null;
+  }
+
+  @Nullable
+  private FfmpegDecoderException startDecodeAhead() {
+    int aheadSizeMs = decodeAheadMs;
+    decodeAheadMs = 0;
+    long aheadSize =
+        (long) aheadSizeMs * sampleRate / 1000 * Util.getPcmFrameSize(getEncoding(), channelCount);
+    if (aheadSize <= 0) {
+      // The output format is invalid, so decoding stays on the decode thread.
+      return null;
+    }
+    if (aheadSize > Integer.MAX_VALUE
+        || !ffmpegStartDecodeAhead(nativeContext, (int) aheadSize, outputBufferSize)) {
+      return new FfmpegDecoderException("Failed to start decoding ahead.");
+    }
+    decodingAhead = true;
     return null;
   }
 
   @Override
   public void release() {
     super.release();
+    synchronized (releaseLock) {
+      released = true;
+    }
     ffmpegRelease(nativeContext);
     nativeContext = 0;
+    if (crossfade != null) {
+      crossfade.release();
+    }
+  }
+
+  @Override
+  public NativeDecoderStats getNativeStats() {
+    long[] snapshot = new long[NativeDecoderStats.SNAPSHOT_LENGTH];
+    ffmpegGetStats(nativeContext, snapshot);
+    return new NativeDecoderStats(snapshot);
+  }
+
+  @Override
+  public boolean startSessionRecording(String path) {
+    return ffmpegStartSessionRecording(nativeContext, path);
+  }
+
+  @Override
+  public void stopSessionRecording() {
+    ffmpegStopSessionRecording(nativeContext);
   }
 
   /** Returns the channel count of output audio. */
@@ -162,7 +430,46 @@ import java.util.List;
   /** Returns the encoding of output audio. */
   @C.Encoding
   public int getEncoding() {
-    return encoding;
+    return audioChainConfig != null ? audioChainConfig.getOutputEncoding(encoding) : encoding;
+  }
+
+  /** Returns the factor by which the decoder's output is sped up relative to its input. */
+  public float getOutputSpeed() {
+    return audioChainConfig != null ? audioChainConfig.speed : 1f;
+  }
+
+  /**
+   * Returns the integrated loudness of the audio decoded so far, in LUFS. See {@link
+   * AudioChainConfig.Builder#setLoudnessMeasurementEnabled(boolean)}.
+   */
+  public double getIntegratedLoudnessLufs() {
+    long loudness = statusBuffer.getLong(STATUS_INTEGRATED_LOUDNESS * 8);
+    return loudness == Long.MIN_VALUE ? Double.NEGATIVE_INFINITY : loudness / 1000.0;
+  }
+
+  /**
+   * Completes the last waveform peak at the end of the stream, if the decoder is reducing its
+   * output to a waveform. See {@link AudioChainConfig.Builder#setWaveformFramesPerPeak(int)}.
+   *
+   * @param peaks The array to write the remaining peaks to.
+   * @return The number of peaks written.
+   */
+  public int finishWaveform(float[] peaks) {
+    Assertions.checkState(audioChainConfig != null && audioChainConfig.isReducingToWaveform());
+    return ffmpegFinishWaveform(nativeContext, peaks);
+  }
+
+  /**
+   * Computes the levels of the frequency bands of the most recently decoded audio. See {@link
+   * AudioChainConfig.Builder#setSpectrumFftSize(int)}.
+   *
+   * @param bands The array to write the level of each band to.
+   * @return Whether the levels were written.
+   */
+  public boolean getSpectrum(float[] bands) {
+    synchronized (releaseLock) {
+      return !released && nativeContext != 0 && ffmpegGetSpectrum(nativeContext, bands);
+    }
   }
 
   /**
@@ -216,6 +523,52 @@ import java.util.List;
     return extraData;
   }
 
+  /** The crossfade mixer functions of the FFmpeg extension. */
+  private final class CrossfadeMixer implements DecoderCrossfade.NativeMixer {
+
+    @Override
+    public long setCrossfade(long mixer, long durationUs, @DecoderCrossfade.Curve int curve) {
+      return ffmpegSetCrossfade(mixer, durationUs, curve);
+    }
+
+    @Override
+    public int crossfade(
+        long mixer,
+        ByteBuffer data,
+        int offset,
+        int size,
+        int channelCount,
+        int sampleRate,
+        @C.PcmEncoding int encoding) {
+      return ffmpegCrossfade(mixer, data, offset, size, channelCount, sampleRate, encoding);
+    }
+
+    @Override
+    public int getCrossfadeDrainSize(long mixer) {
+      return ffmpegGetCrossfadeDrainSize(mixer);
+    }
+
+    @Override
+    public int drainCrossfade(long mixer, ByteBuffer output, int capacity) {
+      return ffmpegDrainCrossfade(mixer, output, capacity);
+    }
+
+    @Override
+    public void endCrossfadeStream(long mixer) {
+      ffmpegEndCrossfadeStream(mixer);
+    }
+
+    @Override
+    public void flushCrossfade(long mixer) {
+      ffmpegFlushCrossfade(mixer);
+    }
+
+    @Override
+    public void releaseCrossfade(long mixer) {
+      ffmpegReleaseCrossfade(mixer);
+    }
+  }
+
   private native long ffmpegInitialize(
       String codecName,
       @Nullable byte[] extraData,
@@ -226,11 +579,69 @@ import java.util.List;
   private native int ffmpegDecode(
       long context, ByteBuffer inputData, int inputSize, ByteBuffer outputData, int outputSize);
 
-  private native int ffmpegGetChannelCount(long context);
+  private native boolean ffmpegStartDecodeAhead(long context, int aheadSize, int outputSize);
+
+  private native int ffmpegDecodeAhead(
+      long context,
+      long timeUs,
+      boolean decodeOnly,
+      ByteBuffer inputData,
+      int inputSize,
+      ByteBuffer outputData);
 
-  private native int ffmpegGetSampleRate(long context);
+  private native boolean ffmpegHasDecodeAheadOutput(long context);
+
+  private native int ffmpegDrainDecodeAhead(long context, ByteBuffer outputData);
+
+  private native ByteBuffer ffmpegGetStatusBuffer(long context);
 
   private native long ffmpegReset(long context, @Nullable byte[] extraData);
 
   private native void ffmpegRelease(long context);
+
+  private native boolean ffmpegSetAudioChainConfig(
+      long context,
+      @Nullable int[] channelMap,
+      float gain,
+      float speed,
+      float pitch,
+      long minimumSilenceDurationUs,
+      long paddingSilenceUs,
+      float silenceThreshold,
+      boolean measureLoudness,
+      int waveformFramesPerPeak,
+      int spectrumFftSize,
+      int outputSampleRate,
+      @C.PcmEncoding int outputEncoding);
+
+  private native int ffmpegFinishWaveform(long context, float[] peaks);
+
+  private native boolean ffmpegGetSpectrum(long context, float[] bands);
+
+  private native void ffmpegGetStats(long context, long[] stats);
+
+  private native boolean ffmpegStartSessionRecording(long context, String path);
+
+  private native void ffmpegStopSessionRecording(long context);
+
+  private native long ffmpegSetCrossfade(long mixer, long durationUs, int curve);
+
+  private native int ffmpegCrossfade(
+      long mixer,
+      ByteBuffer data,
+      int offset,
+      int size,
+      int channelCount,
+      int sampleRate,
+      @C.Encoding int encoding);
+
+  private native int ffmpegGetCrossfadeDrainSize(long mixer);
+
+  private native int ffmpegDrainCrossfade(long mixer, ByteBuffer output, int capacity);
+
+  private native void ffmpegEndCrossfadeStream(long mixer);
+
+  private native void ffmpegFlushCrossfade(long mixer);
+
+  private native void ffmpegReleaseCrossfade(long mixer);
 }
@@ -22,13 +22,18 @@ import static com.google.android.exoplayer2.audio.AudioSink.SINK_FORMAT_UNSUPPOR
 import android.os.Handler;
 import androidx.annotation.Nullable;
 import com.google.android.exoplayer2.C;
+import com.google.android.exoplayer2.ExoPlaybackException;
 import com.google.android.exoplayer2.Format;
+import com.google.android.exoplayer2.audio.AudioChainConfig;
 import com.google.android.exoplayer2.audio.AudioProcessor;
 import com.google.android.exoplayer2.audio.AudioRendererEventListener;
 import com.google.android.exoplayer2.audio.AudioSink;
 import com.google.android.exoplayer2.audio.AudioSink.SinkFormatSupport;
 import com.google.android.exoplayer2.audio.DecoderAudioRenderer;
+import com.google.android.exoplayer2.audio.DecoderCrossfade;
 import com.google.android.exoplayer2.audio.DefaultAudioSink;
+import com.google.android.exoplayer2.decoder.DecoderPrewarmer;
+import com.google.android.exoplayer2.decoder.DecoderReuseEvaluation;
 import com.google.android.exoplayer2.drm.ExoMediaCrypto;
 import com.google.android.exoplayer2.util.Assertions;
 import com.google.android.exoplayer2.util.MimeTypes;
@@ -45,6 +50,16 @@ public final class FfmpegAudioRenderer extends DecoderAudioRenderer<FfmpegAudioD
   /** The default input buffer size. */
   private static final int DEFAULT_INPUT_BUFFER_SIZE = 960 * 6;
 
+  private final DecoderPrewarmer<FfmpegAudioDecoder> decoderPrewarmer = new DecoderPrewarmer<>();
+
+  @Nullable private volatile AudioChainConfig audioChainConfig;
+  private volatile int decodeAheadMs;
+  private volatile int crossfadeDurationMs;
+  @DecoderCrossfade.Curve private volatile int crossfadeCurve;
+  @Nullable private volatile FfmpegAudioDecoder currentDecoder;
+  private boolean streamChanged;
+  private boolean crossfadeIntoNextDecoder;
+
   public FfmpegAudioRenderer() {
     this(/* eventHandler= */ null, /* eventListener= */ null);
   }
@@ -90,6 +105,71 @@ public final class FfmpegAudioRenderer extends DecoderAudioRenderer<FfmpegAudioD
     return TAG;
   }
 
+  /**
+   * Creates a decoder for {@code format} on a background thread, so that the decoder is ready when
+   * playback starts. The decoder is used if the renderer's next decoder is for a compatible format
+   * and has the same output encoding, and is released otherwise, or when the renderer is reset.
+   *
+   * @param format The anticipated format.
+   */
+  public void prewarmDecoder(Format format) {
+    boolean outputFloat = shouldOutputFloat(format);
+    decoderPrewarmer.prewarm(format, prewarmFormat -> newDecoder(prewarmFormat, outputFloat));
+  }
+
+  /**
+   * Sets the processing that the native decoder applies to its output before it's passed to the
+   * audio sink, replacing the equivalent {@link AudioProcessor AudioProcessors}. Applies to
+   * decoders created after the call, for formats with a known channel count. The gain in each
+   * format's loudness tags is applied as described by {@link AudioChainConfig#forMetadata}.
+   *
+   * @param audioChainConfig The configuration, or null to output the decoded samples unchanged.
+   */
+  public void setAudioChainConfig(@Nullable AudioChainConfig audioChainConfig) {
+    this.audioChainConfig = audioChainConfig;
+  }
+
+  /**
+   * Sets the duration of output that the native decoder decodes ahead on a background thread, or 0
+   * to decode on the decoder's thread. Applies to decoders created after the call. See {@link
+   * FfmpegAudioDecoder#setDecodeAheadMs(int)}.
+   *
+   * @param decodeAheadMs The duration of output to decode ahead, in milliseconds, or 0.
+   */
+  public void setDecodeAheadMs(int decodeAheadMs) {
+    Assertions.checkArgument(decodeAheadMs >= 0);
+    this.decodeAheadMs = decodeAheadMs;
+  }
+
+  /**
+   * Sets the duration of the {@link DecoderCrossfade crossfades} that the native decoders mix
+   * between consecutive streams, or 0 to play them one after the other. Applies to decoders created
+   * after the call. Streams are crossfaded if they have the same channel count and sample rate.
+   *
+   * @param crossfadeDurationMs The duration of the crossfades, in milliseconds, or 0.
+   * @param crossfadeCurve The shape of the crossfades.
+   */
+  public void setCrossfade(int crossfadeDurationMs, @DecoderCrossfade.Curve int crossfadeCurve) {
+    Assertions.checkArgument(crossfadeDurationMs >= 0);
+    this.crossfadeCurve = crossfadeCurve;
+    this.crossfadeDurationMs = crossfadeDurationMs;
+  }
+
+  /**
+   * Computes the levels of the frequency bands of the audio most recently decoded by the renderer's
+   * current decoder. See {@link FfmpegAudioDecoder#getSpectrum(float[])}. May be called from any
+   * thread, for example once per display frame by a visualizer, including while the renderer
+   * replaces or releases its decoder.
+   *
+   * @param bands The array to write the level of each band to.
+   * @return Whether the levels were written, which they aren't if the renderer has no decoder or
+   *     the decoder didn't write them.
+   */
+  public boolean getSpectrum(float[] bands) {
+    @Nullable FfmpegAudioDecoder currentDecoder = this.currentDecoder;
+    return currentDecoder != null && currentDecoder.getSpectrum(bands);
+  }
+
   @Override
   @C.FormatSupport
   protected int supportsFormatInternal(Format format) {
@@ -117,15 +197,94 @@ public final class FfmpegAudioRenderer extends DecoderAudioRenderer<FfmpegAudioD
   protected FfmpegAudioDecoder createDecoder(Format format, @Nullable ExoMediaCrypto mediaCrypto)
       throws FfmpegDecoderException {
     TraceUtil.beginSection("createFfmpegAudioDecoder");
-    int initialInputBufferSize =
-        format.maxInputSize != Format.NO_VALUE ? format.maxInputSize : DEFAULT_INPUT_BUFFER_SIZE;
-    FfmpegAudioDecoder decoder =
-        new FfmpegAudioDecoder(
-            format, NUM_BUFFERS, NUM_BUFFERS, initialInputBufferSize, shouldOutputFloat(format));
+    boolean outputFloat = shouldOutputFloat(format);
+    @Nullable FfmpegAudioDecoder decoder = decoderPrewarmer.takeDecoder(format);
+    if (decoder != null
+        && decoder.getEncoding() != (outputFloat ? C.ENCODING_PCM_FLOAT : C.ENCODING_PCM_16BIT)) {
+      decoder.release();
+      decoder = null;
+    }
+    if (decoder == null) {
+      decoder = newDecoder(format, outputFloat);
+    }
+    try {
+      decoder.setAudioChainConfig(
+          audioChainConfig != null ? audioChainConfig.forMetadata(format.metadata) : null);
+      // The previous decoder holds the end of its stream if it's crossfaded into this one.
+      @Nullable FfmpegAudioDecoder previousDecoder = currentDecoder;
+      int crossfadeDurationMs = this.crossfadeDurationMs;
+      if (crossfadeDurationMs > 0) {
+        decoder.setCrossfade(
+            crossfadeDurationMs * 1000L,
+            crossfadeCurve,
+            crossfadeIntoNextDecoder ? previousDecoder : null);
+      }
+      if (previousDecoder != null) {
+        previousDecoder.releaseCrossfade();
+      }
+    } catch (FfmpegDecoderException e) {
+      decoder.release();
+      throw e;
+    }
+    int decodeAheadMs = this.decodeAheadMs;
+    if (decodeAheadMs > 0) {
+      decoder.setDecodeAheadMs(decodeAheadMs);
+    }
+    currentDecoder = decoder;
+    streamChanged = false;
+    crossfadeIntoNextDecoder = false;
     TraceUtil.endSection();
     return decoder;
   }
 
+  @Override
+  protected void onReset() {
+    super.onReset();
+    decoderPrewarmer.release();
+  }
+
+  @Override
+  protected void onStreamChanged(Format[] formats, long startPositionUs, long offsetUs)
+      throws ExoPlaybackException {
+    super.onStreamChanged(formats, startPositionUs, offsetUs);
+    streamChanged = true;
+  }
+
+  @Override
+  protected DecoderReuseEvaluation canReuseDecoder(
+      String decoderName, Format oldFormat, Format newFormat) {
+    @Nullable FfmpegAudioDecoder currentDecoder = this.currentDecoder;
+    if (streamChanged
+        && currentDecoder != null
+        && crossfadeDurationMs > 0
+        && oldFormat.channelCount == newFormat.channelCount
+        && oldFormat.sampleRate == newFormat.sampleRate) {
+      // The decoder is released at the end of its stream, and the end of its output is mixed into
+      // the start of the next decoder's.
+      currentDecoder.crossfadeIntoNextStream();
+      crossfadeIntoNextDecoder = true;
+    }
+    streamChanged = false;
+    return super.canReuseDecoder(decoderName, oldFormat, newFormat);
+  }
+
+  @Override
+  protected void onPositionReset(long positionUs, boolean joining) throws ExoPlaybackException {
+    // A stream isn't crossfaded into the stream that plays after a seek.
+    crossfadeIntoNextDecoder = false;
+    super.onPositionReset(positionUs, joining);
+  }
+
+  @Override
+  protected void onDisabled() {
+    @Nullable FfmpegAudioDecoder currentDecoder = this.currentDecoder;
+    this.currentDecoder = null;
+    super.onDisabled();
+    if (currentDecoder != null) {
+      currentDecoder.releaseCrossfade();
+    }
+  }
+
   @Override
   public Format getOutputFormat(FfmpegAudioDecoder decoder) {
     Assertions.checkNotNull(decoder);
@@ -137,6 +296,19 @@ public final class FfmpegAudioRenderer extends DecoderAudioRenderer<FfmpegAudioD
         .build();
   }
 
+  @Override
+  protected float getOutputSpeed(FfmpegAudioDecoder decoder) {
+    return decoder.getOutputSpeed();
+  }
+
+  private static FfmpegAudioDecoder newDecoder(Format format, boolean outputFloat)
+      throws FfmpegDecoderException {
+    int initialInputBufferSize =
+        format.maxInputSize != Format.NO_VALUE ? format.maxInputSize : DEFAULT_INPUT_BUFFER_SIZE;
+    return new FfmpegAudioDecoder(
+        format, NUM_BUFFERS, NUM_BUFFERS, initialInputBufferSize, outputFloat);
+  }
+
   /**
    * Returns whether the renderer's {@link AudioSink} supports the PCM format that will be output
    * from the decoder for the given input format and requested output encoding.
@@ -15,8 +15,12 @@
  */
 #include <jni.h>
 #include <stdlib.h>
+#include <string.h>
 #include <android/log.h>
 
+#include <memory>
+#include <vector>
+
 extern "C" {
 #ifdef __cplusplus
 #define __STDC_CONSTANT_MACROS
@@ -32,27 +36,37 @@ extern "C" {
 #include <libswresample/swresample.h>
 }
 
+#include "audio_chain_jni.h"  // NOLINT
+#include "cpu_dispatch.h"  // NOLINT
+#include "decode_ahead.h"  // NOLINT
+#include "decoder_stats_jni.h"  // NOLINT
+#include "jni_registration.h"  // NOLINT
+#include "profile.h"  // NOLINT
+#include "session_recorder.h"  // NOLINT
+#include "status_block.h"  // NOLINT
+#include "trace.h"  // NOLINT
+
 #define LOG_TAG "ffmpeg_jni"
 #define LOGE(...) ((void)__android_log_print(ANDROID_LOG_ERROR, LOG_TAG, \
                    __VA_ARGS__))
 
 #define LIBRARY_FUNC(RETURN_TYPE, NAME, ...)                              \
   extern "C" {                                                            \
-  JNIEXPORT RETURN_TYPE                                                   \
+  EXOPLAYER_JNI_EXPORT RETURN_TYPE                                        \
       Java_com_google_android_exoplayer2_ext_ffmpeg_FfmpegLibrary_##NAME( \
           JNIEnv *env, jobject thiz, ##__VA_ARGS__);                      \
   }                                                                       \
-  JNIEXPORT RETURN_TYPE                                                   \
+  EXOPLAYER_JNI_EXPORT RETURN_TYPE                                        \
       Java_com_google_android_exoplayer2_ext_ffmpeg_FfmpegLibrary_##NAME( \
           JNIEnv *env, jobject thiz, ##__VA_ARGS__)
 
 #define AUDIO_DECODER_FUNC(RETURN_TYPE, NAME, ...)                             \
   extern "C" {                                                                 \
-  JNIEXPORT RETURN_TYPE                                                        \
+  EXOPLAYER_JNI_EXPORT RETURN_TYPE                                             \
       Java_com_google_android_exoplayer2_ext_ffmpeg_FfmpegAudioDecoder_##NAME( \
           JNIEnv *env, jobject thiz, ##__VA_ARGS__);                           \
   }                                                                            \
-  JNIEXPORT RETURN_TYPE                                                        \
+  EXOPLAYER_JNI_EXPORT RETURN_TYPE                                             \
       Java_com_google_android_exoplayer2_ext_ffmpeg_FfmpegAudioDecoder_##NAME( \
           JNIEnv *env, jobject thiz, ##__VA_ARGS__)
 
@@ -66,8 +80,61 @@ static const AVSampleFormat OUTPUT_FORMAT_PCM_FLOAT = AV_SAMPLE_FMT_FLT;
 // LINT.IfChange
 static const int AUDIO_DECODER_ERROR_INVALID_DATA = -1;
 static const int AUDIO_DECODER_ERROR_OTHER = -2;
+// Returned by the decode-ahead methods when no output is ready.
+static const int AUDIO_DECODER_NO_DECODE_AHEAD_OUTPUT = -3;
+// LINT.ThenChange(../java/com/google/android/exoplayer2/ext/ffmpeg/FfmpegAudioDecoder.java)
+
+// The size of the ring that input is queued in when decoding ahead, which holds
+// a few seconds of packets at the bitrates of most codecs.
+static const size_t DECODE_AHEAD_INPUT_CAPACITY = 1024 * 1024;
+// The flag that input is queued with when it's decode-only.
+static const int32_t DECODE_AHEAD_FLAG_DECODE_ONLY = 1;
+
+// Slots of the status block that is shared with FfmpegAudioDecoder.
+// LINT.IfChange
+enum StatusSlot {
+  STATUS_CHANNEL_COUNT = 0,
+  STATUS_SAMPLE_RATE = 1,
+  STATUS_SKIPPED_SILENCE_FRAME_COUNT = 2,
+  STATUS_INTEGRATED_LOUDNESS = 3,
+  STATUS_DECODE_ONLY = 4,
+  STATUS_TIME_US = 5,
+  STATUS_SLOT_COUNT = 6
+};
 // LINT.ThenChange(../java/com/google/android/exoplayer2/ext/ffmpeg/FfmpegAudioDecoder.java)
 
+// In an unnamed namespace, since other extensions' contexts are linked into the
+// same library when it's combined.
+namespace {
+
+/**
+ * The native state of a decoder instance. The codec context may be recreated
+ * when the decoder is reset, but the JniContext is kept for the lifetime of the
+ * decoder.
+ */
+struct JniContext {
+  JniContext() : recorder(exoplayer_jni::session_format::kCodecFfmpeg) {}
+
+  AVCodecContext *codecContext = NULL;
+  SwrContext *resampleContext = NULL;
+  // Processes the resampled output if an AudioChainConfig has been set and
+  // changes it, in which case it's resampled into chainInput first.
+  exoplayer_jni::AudioChain audioChain;
+  std::vector<uint8_t> chainInput;
+  exoplayer_jni::DecoderStats stats;
+  exoplayer_jni::SessionRecorder recorder;
+  exoplayer_jni::StatusBlock<STATUS_SLOT_COUNT> status;
+  // The padded copy of the packet that's being decoded ahead.
+  std::vector<uint8_t> decodeAheadPacket;
+  // Decodes on a background thread if decoding ahead has been started, in
+  // which case it's the only thread that uses the codec, resampling and audio
+  // chain state other than while it's flushed. Destroyed first, since it uses
+  // the other members.
+  std::unique_ptr<exoplayer_jni::DecodeAheadThread> decodeAhead;
+};
+
+}  // namespace
+
 /**
  * Returns the AVCodec with the specified name, or NULL if it is not available.
  */
@@ -82,13 +149,41 @@ AVCodecContext *createContext(JNIEnv *env, AVCodec *codec, jbyteArray extraData,
                               jboolean outputFloat, jint rawSampleRate,
                               jint rawChannelCount);
 
+/**
+ * Decodes inputSize bytes of inputBuffer, which must be followed by
+ * AV_INPUT_BUFFER_PADDING_SIZE bytes of padding, into the output buffer, and
+ * writes the values of the status slots before STATUS_DECODE_ONLY to status.
+ * Returns the number of bytes written, or a negative AUDIO_DECODER_ERROR
+ * constant value in the case of an error.
+ */
+int decodeInput(JniContext *jniContext, uint8_t *inputBuffer, int inputSize,
+                uint8_t *outputBuffer, int outputSize, int64_t *status);
+
 /**
  * Decodes the packet into the output buffer, returning the number of bytes
  * written, or a negative AUDIO_DECODER_ERROR constant value in the case of an
- * error.
+ * error. Adds the number of frames of silence skipped by the audio chain to
+ * status[STATUS_SKIPPED_SILENCE_FRAME_COUNT].
  */
-int decodePacket(AVCodecContext *context, AVPacket *packet,
-                 uint8_t *outputBuffer, int outputSize);
+int decodePacket(JniContext *jniContext, AVPacket *packet,
+                 uint8_t *outputBuffer, int outputSize, int64_t *status);
+
+/**
+ * Copies the oldest block decoded ahead into the output buffer, which must
+ * have space for the maximum output size passed to ffmpegStartDecodeAhead,
+ * and publishes its status values, if a block is ready or drain is true and
+ * any block has been decoded. Returns the number of bytes of output, a
+ * negative AUDIO_DECODER_ERROR constant value, or
+ * AUDIO_DECODER_NO_DECODE_AHEAD_OUTPUT if there's no block.
+ */
+int takeDecodeAheadBlock(JniContext *jniContext, uint8_t *outputBuffer,
+                         bool drain);
+
+/**
+ * Returns the encoding of the samples output by the resampler, which is the
+ * input encoding of the audio chain.
+ */
+exoplayer_jni::PcmEncoding getResampledEncoding(AVCodecContext *context);
 
 /**
  * Outputs a log message describing the avcodec error number.
@@ -100,12 +195,26 @@ void logError(const char *functionName, int errorNumber);
  */
 void releaseContext(AVCodecContext *context);
 
-jint JNI_OnLoad(JavaVM *vm, void *reserved) {
+/**
+ * Releases the resampling context of the specified JniContext, if any.
+ */
+void releaseResampleContext(JniContext *jniContext);
+
+/**
+ * Registers the native methods of FfmpegLibrary and FfmpegAudioDecoder.
+ */
+static bool registerNativeMethods(JNIEnv *env);
+
+EXOPLAYER_JNI_ONLOAD(FfmpegOnLoad) {
   JNIEnv *env;
   if (vm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_6) != JNI_OK) {
     return -1;
   }
+  if (!registerNativeMethods(env)) {
+    return -1;
+  }
   avcodec_register_all();
+  exoplayer_jni::InitCpuDispatch();
   return JNI_VERSION_1_6;
 }
 
@@ -129,8 +238,24 @@ AUDIO_DECODER_FUNC(jlong, ffmpegInitialize, jstring codecName,
     LOGE("Codec not found.");
     return 0L;
   }
-  return (jlong)createContext(env, codec, extraData, outputFloat, rawSampleRate,
-                              rawChannelCount);
+  AVCodecContext *codecContext = createContext(
+      env, codec, extraData, outputFloat, rawSampleRate, rawChannelCount);
+  if (!codecContext) {
+    return 0L;
+  }
+  JniContext *jniContext = new JniContext();
+  jniContext->codecContext = codecContext;
+  // The initialization data of a recording is the codec name followed by the
+  // extra data.
+  const size_t codecNameLength = strlen(codec->name);
+  std::vector<uint8_t> initData(codec->name, codec->name + codecNameLength);
+  initData.insert(initData.end(), codecContext->extradata,
+                  codecContext->extradata + codecContext->extradata_size);
+  const int64_t parameters[] = {outputFloat, rawSampleRate, rawChannelCount,
+                                (int64_t) codecNameLength};
+  jniContext->recorder.SetInitParameters(parameters, 4, initData.data(),
+                                         initData.size());
+  return (jlong) jniContext;
 }
 
 AUDIO_DECODER_FUNC(jint, ffmpegDecode, jlong context, jobject inputData,
@@ -151,64 +276,236 @@ AUDIO_DECODER_FUNC(jint, ffmpegDecode, jlong context, jobject inputData,
     LOGE("Invalid output buffer length: %d", outputSize);
     return -1;
   }
+  JniContext *jniContext = (JniContext *) context;
+  exoplayer_jni::ScopedNativeCallTimer callTimer(&jniContext->stats);
   uint8_t *inputBuffer = (uint8_t *) env->GetDirectBufferAddress(inputData);
   uint8_t *outputBuffer = (uint8_t *) env->GetDirectBufferAddress(outputData);
-  AVPacket packet;
-  av_init_packet(&packet);
-  packet.data = inputBuffer;
-  packet.size = inputSize;
-  return decodePacket((AVCodecContext *) context, &packet, outputBuffer,
-                      outputSize);
+  int64_t status[STATUS_DECODE_ONLY];
+  const int result = decodeInput(jniContext, inputBuffer, inputSize,
+                                 outputBuffer, outputSize, status);
+  for (int i = 0; i < STATUS_DECODE_ONLY; i++) {
+    jniContext->status.Set(i, status[i]);
+  }
+  return result;
 }
 
-AUDIO_DECODER_FUNC(jint, ffmpegGetChannelCount, jlong context) {
-  if (!context) {
-    LOGE("Context must be non-NULL.");
-    return -1;
+AUDIO_DECODER_FUNC(jboolean, ffmpegStartDecodeAhead, jlong context,
+                   jint aheadSize, jint outputSize) {
+  JniContext *jniContext = (JniContext *) context;
+  if (jniContext->decodeAhead || aheadSize <= 0 || outputSize <= 0) {
+    return false;
   }
-  return ((AVCodecContext *) context)->channels;
+  static_assert(
+      STATUS_DECODE_ONLY <= exoplayer_jni::DecodeAheadBlock::kMaxStatusCount,
+      "Too many status slots to decode ahead");
+  jniContext->decodeAhead.reset(new exoplayer_jni::DecodeAheadThread(
+      [jniContext, outputSize](const uint8_t *input, size_t inputSize,
+                               uint8_t *output, int64_t *status) {
+        // FFmpeg may read past the end of the packet, so it's copied into a
+        // buffer that's followed by zeroed padding.
+        std::vector<uint8_t> &packet = jniContext->decodeAheadPacket;
+        packet.assign(input, input + inputSize);
+        packet.resize(inputSize + AV_INPUT_BUFFER_PADDING_SIZE, 0);
+        return decodeInput(jniContext, packet.data(), (int) inputSize, output,
+                           outputSize, status);
+      },
+      outputSize, aheadSize, DECODE_AHEAD_INPUT_CAPACITY));
+  return true;
+}
+
+AUDIO_DECODER_FUNC(jint, ffmpegDecodeAhead, jlong context, jlong timeUs,
+                   jboolean decodeOnly, jobject inputData, jint inputSize,
+                   jobject outputData) {
+  JniContext *jniContext = (JniContext *) context;
+  exoplayer_jni::ScopedNativeCallTimer callTimer(&jniContext->stats);
+  const uint8_t *inputBuffer =
+      (const uint8_t *) env->GetDirectBufferAddress(inputData);
+  uint8_t *outputBuffer = (uint8_t *) env->GetDirectBufferAddress(outputData);
+  // Output is taken first, so that the worker can make space for the input if
+  // it's waiting for output to be taken.
+  const int result =
+      takeDecodeAheadBlock(jniContext, outputBuffer, /* drain= */ false);
+  if (!jniContext->decodeAhead->Queue(
+          timeUs, decodeOnly ? DECODE_AHEAD_FLAG_DECODE_ONLY : 0, inputBuffer,
+          inputSize)) {
+    LOGE("Failed to queue input to decode ahead.");
+    return AUDIO_DECODER_ERROR_OTHER;
+  }
+  return result;
+}
+
+AUDIO_DECODER_FUNC(jboolean, ffmpegHasDecodeAheadOutput, jlong context) {
+  JniContext *jniContext = (JniContext *) context;
+  return jniContext->decodeAhead->WaitForOutput();
 }
 
-AUDIO_DECODER_FUNC(jint, ffmpegGetSampleRate, jlong context) {
+AUDIO_DECODER_FUNC(jint, ffmpegDrainDecodeAhead, jlong context,
+                   jobject outputData) {
+  JniContext *jniContext = (JniContext *) context;
+  exoplayer_jni::ScopedNativeCallTimer callTimer(&jniContext->stats);
+  uint8_t *outputBuffer = (uint8_t *) env->GetDirectBufferAddress(outputData);
+  return takeDecodeAheadBlock(jniContext, outputBuffer, /* drain= */ true);
+}
+
+AUDIO_DECODER_FUNC(jobject, ffmpegGetStatusBuffer, jlong context) {
   if (!context) {
     LOGE("Context must be non-NULL.");
-    return -1;
+    return NULL;
   }
-  return ((AVCodecContext *) context)->sample_rate;
+  return ((JniContext *) context)->status.NewByteBuffer(env);
 }
 
 AUDIO_DECODER_FUNC(jlong, ffmpegReset, jlong jContext, jbyteArray extraData) {
-  AVCodecContext *context = (AVCodecContext *) jContext;
-  if (!context) {
+  JniContext *jniContext = (JniContext *) jContext;
+  if (!jniContext) {
     LOGE("Tried to reset without a context.");
     return 0L;
   }
 
+  // Stop the decode-ahead thread first, so that the reset is recorded after
+  // the decodes it made, and doesn't race with them.
+  if (jniContext->decodeAhead) {
+    jniContext->decodeAhead->Flush();
+  }
+  const int64_t startTimeNs = exoplayer_jni::GetMonotonicTimeNs();
+  jniContext->audioChain.Reset();
+  AVCodecContext *context = jniContext->codecContext;
   AVCodecID codecId = context->codec_id;
   if (codecId == AV_CODEC_ID_TRUEHD) {
     // Release and recreate the context if the codec is TrueHD.
     // TODO: Figure out why flushing doesn't work for this codec.
+    jboolean outputFloat =
+        (jboolean)(context->request_sample_fmt == OUTPUT_FORMAT_PCM_FLOAT);
+    releaseResampleContext(jniContext);
     releaseContext(context);
+    jniContext->codecContext = NULL;
     AVCodec *codec = avcodec_find_decoder(codecId);
     if (!codec) {
       LOGE("Unexpected error finding codec %d.", codecId);
+      delete jniContext;
       return 0L;
     }
-    jboolean outputFloat =
-        (jboolean)(context->request_sample_fmt == OUTPUT_FORMAT_PCM_FLOAT);
-    return (jlong)createContext(env, codec, extraData, outputFloat,
-                                /* rawSampleRate= */ -1,
-                                /* rawChannelCount= */ -1);
+    context = createContext(env, codec, extraData, outputFloat,
+                            /* rawSampleRate= */ -1,
+                            /* rawChannelCount= */ -1);
+    if (!context) {
+      delete jniContext;
+      return 0L;
+    }
+    jniContext->codecContext = context;
+    jniContext->recorder.Record(exoplayer_jni::session_format::kRecordReset,
+                                startTimeNs, /* argument= */ -1,
+                                /* result= */ 0, /* flags= */ 0, NULL, 0);
+    return (jlong) jniContext;
   }
 
   avcodec_flush_buffers(context);
-  return (jlong) context;
+  jniContext->recorder.Record(exoplayer_jni::session_format::kRecordReset,
+                              startTimeNs, /* argument= */ -1,
+                              /* result= */ 0, /* flags= */ 0, NULL, 0);
+  return (jlong) jniContext;
 }
 
 AUDIO_DECODER_FUNC(void, ffmpegRelease, jlong context) {
   if (context) {
-    releaseContext((AVCodecContext *) context);
+    JniContext *jniContext = (JniContext *) context;
+    jniContext->decodeAhead.reset();
+    releaseResampleContext(jniContext);
+    releaseContext(jniContext->codecContext);
+    delete jniContext;
+  }
+  exoplayer_jni::FlushProfile();
+}
+
+AUDIO_DECODER_FUNC(jboolean, ffmpegSetAudioChainConfig, jlong context,
+                   jintArray channelMap, jfloat gain, jfloat speed,
+                   jfloat pitch, jlong minSilenceUs, jlong silencePaddingUs,
+                   jfloat silenceThreshold, jboolean measureLoudness,
+                   jint waveformFramesPerPeak, jint spectrumFftSize,
+                   jint outputSampleRate, jint outputEncoding) {
+  JniContext *jniContext = (JniContext *) context;
+  // The chain is configured when the first frame is decoded, once the channel
+  // count and sample rate are known.
+  if (!exoplayer_jni::SetAudioChainConfig(env, channelMap, gain, speed, pitch,
+                                          minSilenceUs, silencePaddingUs,
+                                          silenceThreshold, measureLoudness,
+                                          waveformFramesPerPeak,
+                                          spectrumFftSize, outputSampleRate,
+                                          outputEncoding,
+                                          &jniContext->audioChain)) {
+    LOGE("Unsupported audio chain configuration.");
+    return false;
   }
+  return true;
+}
+
+AUDIO_DECODER_FUNC(jint, ffmpegFinishWaveform, jlong context,
+                   jfloatArray peaks) {
+  JniContext *jniContext = (JniContext *) context;
+  return exoplayer_jni::FinishWaveform(env, jniContext->audioChain.waveform(),
+                                       peaks);
+}
+
+AUDIO_DECODER_FUNC(jboolean, ffmpegGetSpectrum, jlong context,
+                   jfloatArray bands) {
+  JniContext *jniContext = (JniContext *) context;
+  return exoplayer_jni::GetSpectrum(env, jniContext->audioChain.spectrum(),
+                                    bands);
+}
+
+AUDIO_DECODER_FUNC(void, ffmpegGetStats, jlong context, jlongArray stats) {
+  JniContext *jniContext = (JniContext *) context;
+  exoplayer_jni::GetStatsSnapshot(env, jniContext->stats, stats);
+}
+
+AUDIO_DECODER_FUNC(jboolean, ffmpegStartSessionRecording, jlong context,
+                   jstring path) {
+  JniContext *jniContext = (JniContext *) context;
+  const char *pathChars = env->GetStringUTFChars(path, NULL);
+  const bool started = jniContext->recorder.Start(pathChars);
+  if (!started) {
+    LOGE("Failed to start session recording to %s.", pathChars);
+  }
+  env->ReleaseStringUTFChars(path, pathChars);
+  return started;
+}
+
+AUDIO_DECODER_FUNC(void, ffmpegStopSessionRecording, jlong context) {
+  JniContext *jniContext = (JniContext *) context;
+  jniContext->recorder.Stop();
+}
+
+AUDIO_DECODER_FUNC(jlong, ffmpegSetCrossfade, jlong mixer, jlong durationUs,
+                   jint curve) {
+  return exoplayer_jni::SetCrossfade(mixer, durationUs, curve);
+}
+
+AUDIO_DECODER_FUNC(jint, ffmpegCrossfade, jlong mixer, jobject data,
+                   jint offset, jint size, jint channelCount, jint sampleRate,
+                   jint encoding) {
+  return exoplayer_jni::Crossfade(env, mixer, data, offset, size, channelCount,
+                                  sampleRate, encoding);
+}
+
+AUDIO_DECODER_FUNC(jint, ffmpegGetCrossfadeDrainSize, jlong mixer) {
+  return ((exoplayer_jni::CrossfadeMixer *) mixer)->GetDrainSize();
+}
+
+AUDIO_DECODER_FUNC(jint, ffmpegDrainCrossfade, jlong mixer, jobject output,
+                   jint capacity) {
+  return exoplayer_jni::DrainCrossfade(env, mixer, output, capacity);
+}
+
+AUDIO_DECODER_FUNC(void, ffmpegEndCrossfadeStream, jlong mixer) {
+  ((exoplayer_jni::CrossfadeMixer *) mixer)->EndStream();
+}
+
+AUDIO_DECODER_FUNC(void, ffmpegFlushCrossfade, jlong mixer) {
+  ((exoplayer_jni::CrossfadeMixer *) mixer)->Flush();
+}
+
+AUDIO_DECODER_FUNC(void, ffmpegReleaseCrossfade, jlong mixer) {
+  delete (exoplayer_jni::CrossfadeMixer *) mixer;
 }
 
 AVCodec *getCodecByName(JNIEnv* env, jstring codecName) {
@@ -259,11 +556,59 @@ AVCodecContext *createContext(JNIEnv *env, AVCodec *codec, jbyteArray extraData,
   return context;
 }
 
-int decodePacket(AVCodecContext *context, AVPacket *packet,
-                 uint8_t *outputBuffer, int outputSize) {
+int decodeInput(JniContext *jniContext, uint8_t *inputBuffer, int inputSize,
+                uint8_t *outputBuffer, int outputSize, int64_t *status) {
+  exoplayer_jni::ScopedSessionRecord record(
+      &jniContext->recorder, exoplayer_jni::session_format::kRecordDecode,
+      inputBuffer, inputSize);
+  AVPacket packet;
+  av_init_packet(&packet);
+  packet.data = inputBuffer;
+  packet.size = inputSize;
+  jniContext->stats.Increment(exoplayer_jni::DecoderStats::kInputBufferCount);
+  jniContext->stats.Increment(exoplayer_jni::DecoderStats::kInputByteCount,
+                              inputSize);
+  // Counted over all the frames decoded from the packet.
+  status[STATUS_SKIPPED_SILENCE_FRAME_COUNT] = 0;
+  int result =
+      decodePacket(jniContext, &packet, outputBuffer, outputSize, status);
+  record.set_result(result);
+  AVCodecContext *codecContext = jniContext->codecContext;
+  exoplayer_jni::AudioChain &audioChain = jniContext->audioChain;
+  if (audioChain.IsConfiguredFor(codecContext->channels,
+                                 codecContext->sample_rate,
+                                 getResampledEncoding(codecContext))) {
+    status[STATUS_CHANNEL_COUNT] = audioChain.output_channel_count();
+    status[STATUS_SAMPLE_RATE] = audioChain.output_sample_rate();
+  } else {
+    status[STATUS_CHANNEL_COUNT] = codecContext->channels;
+    status[STATUS_SAMPLE_RATE] = codecContext->sample_rate;
+  }
+  status[STATUS_INTEGRATED_LOUDNESS] =
+      exoplayer_jni::GetLoudnessStatus(audioChain);
+  if (result < 0) {
+    jniContext->stats.Increment(
+        exoplayer_jni::DecoderStats::kDecodeErrorCount);
+  } else {
+    jniContext->stats.Increment(
+        exoplayer_jni::DecoderStats::kOutputBufferCount);
+    jniContext->stats.Increment(exoplayer_jni::DecoderStats::kOutputByteCount,
+                                result);
+  }
+  return result;
+}
+
+int decodePacket(JniContext *jniContext, AVPacket *packet,
+                 uint8_t *outputBuffer, int outputSize, int64_t *status) {
+  AVCodecContext *context = jniContext->codecContext;
   int result = 0;
-  // Queue input data.
-  result = avcodec_send_packet(context, packet);
+  // Queue input data. The decode time excludes the time spent resampling.
+  int64_t decodeTimeUs = 0;
+  int64_t startTimeUs = exoplayer_jni::GetMonotonicTimeUs();
+  {
+    EXO_TRACE_SCOPE("ffmpeg:decode");
+    result = avcodec_send_packet(context, packet);
+  }
   if (result) {
     logError("avcodec_send_packet", result);
     return result == AVERROR_INVALIDDATA ? AUDIO_DECODER_ERROR_INVALID_DATA
@@ -278,10 +623,16 @@ int decodePacket(AVCodecContext *context, AVPacket *packet,
       LOGE("Failed to allocate output frame.");
       return -1;
     }
-    result = avcodec_receive_frame(context, frame);
+    {
+      EXO_TRACE_SCOPE("ffmpeg:decode");
+      result = avcodec_receive_frame(context, frame);
+    }
+    decodeTimeUs += exoplayer_jni::GetMonotonicTimeUs() - startTimeUs;
     if (result) {
       av_frame_free(&frame);
       if (result == AVERROR(EAGAIN)) {
+        jniContext->stats.RecordLatency(
+            exoplayer_jni::DecoderStats::kDecodeTime, decodeTimeUs);
         break;
       }
       logError("avcodec_receive_frame", result);
@@ -297,8 +648,8 @@ int decodePacket(AVCodecContext *context, AVPacket *packet,
     int dataSize = av_samples_get_buffer_size(NULL, channelCount, sampleCount,
                                               sampleFormat, 1);
     SwrContext *resampleContext;
-    if (context->opaque) {
-      resampleContext = (SwrContext *)context->opaque;
+    if (jniContext->resampleContext) {
+      resampleContext = jniContext->resampleContext;
     } else {
       resampleContext = swr_alloc();
       av_opt_set_int(resampleContext, "in_channel_layout",  channelLayout, 0);
@@ -315,20 +666,56 @@ int decodePacket(AVCodecContext *context, AVPacket *packet,
         av_frame_free(&frame);
         return -1;
       }
-      context->opaque = resampleContext;
+      jniContext->resampleContext = resampleContext;
     }
+    exoplayer_jni::AudioChain &audioChain = jniContext->audioChain;
+    if (audioChain.has_config()) {
+      const exoplayer_jni::PcmEncoding encoding =
+          getResampledEncoding(context);
+      if (!audioChain.IsConfiguredFor(channelCount, sampleRate, encoding) &&
+          !audioChain.Configure(channelCount, sampleRate, encoding)) {
+        LOGE("Unsupported audio chain configuration for %d channels at %d Hz.",
+             channelCount, sampleRate);
+        av_frame_free(&frame);
+        return AUDIO_DECODER_ERROR_OTHER;
+      }
+    }
+    const bool useAudioChain = !audioChain.IsPassthrough();
     int inSampleSize = av_get_bytes_per_sample(sampleFormat);
     int outSampleSize = av_get_bytes_per_sample(context->request_sample_fmt);
     int outSamples = swr_get_out_samples(resampleContext, sampleCount);
     int bufferOutSize = outSampleSize * channelCount * outSamples;
-    if (outSize + bufferOutSize > outputSize) {
+    int requiredOutSize = useAudioChain
+                              ? audioChain.GetMaxOutputSize(outSamples)
+                              : bufferOutSize;
+    if (outSize + requiredOutSize > outputSize) {
       LOGE("Output buffer size (%d) too small for output data (%d).",
-           outputSize, outSize + bufferOutSize);
+           outputSize, outSize + requiredOutSize);
       av_frame_free(&frame);
       return -1;
     }
-    result = swr_convert(resampleContext, &outputBuffer, bufferOutSize,
-                         (const uint8_t **)frame->data, frame->nb_samples);
+    uint8_t *convertBuffer = outputBuffer;
+    if (useAudioChain) {
+      if (jniContext->chainInput.size() < (size_t) bufferOutSize) {
+        jniContext->chainInput.resize(bufferOutSize);
+      }
+      convertBuffer = jniContext->chainInput.data();
+    }
+    int64_t convertStartTimeUs = exoplayer_jni::GetMonotonicTimeUs();
+    {
+      EXO_TRACE_SCOPE("ffmpeg:convert");
+      result = swr_convert(resampleContext, &convertBuffer, bufferOutSize,
+                           (const uint8_t **)frame->data, frame->nb_samples);
+      if (result > 0 && useAudioChain) {
+        bufferOutSize = audioChain.Process(convertBuffer, result, outputBuffer,
+                                           outputSize - outSize);
+        status[STATUS_SKIPPED_SILENCE_FRAME_COUNT] +=
+            audioChain.skipped_frame_count();
+      }
+    }
+    jniContext->stats.RecordLatency(
+        exoplayer_jni::DecoderStats::kConvertTime,
+        exoplayer_jni::GetMonotonicTimeUs() - convertStartTimeUs);
     av_frame_free(&frame);
     if (result < 0) {
       logError("swr_convert", result);
@@ -342,10 +729,32 @@ int decodePacket(AVCodecContext *context, AVPacket *packet,
     }
     outputBuffer += bufferOutSize;
     outSize += bufferOutSize;
+    startTimeUs = exoplayer_jni::GetMonotonicTimeUs();
   }
   return outSize;
 }
 
+int takeDecodeAheadBlock(JniContext *jniContext, uint8_t *outputBuffer,
+                         bool drain) {
+  const exoplayer_jni::DecodeAheadBlock *block =
+      jniContext->decodeAhead->Peek(drain);
+  if (!block) {
+    return AUDIO_DECODER_NO_DECODE_AHEAD_OUTPUT;
+  }
+  for (int i = 0; i < STATUS_DECODE_ONLY; i++) {
+    jniContext->status.Set(i, block->status[i]);
+  }
+  jniContext->status.Set(
+      STATUS_DECODE_ONLY, (block->flags & DECODE_AHEAD_FLAG_DECODE_ONLY) != 0);
+  jniContext->status.Set(STATUS_TIME_US, block->time_us);
+  const int result = block->result;
+  if (result > 0) {
+    memcpy(outputBuffer, block->data(), result);
+  }
+  jniContext->decodeAhead->Pop();
+  return result;
+}
+
 void logError(const char *functionName, int errorNumber) {
   char *buffer = (char *) malloc(ERROR_STRING_BUFFER_LENGTH * sizeof(char));
   av_strerror(errorNumber, buffer, ERROR_STRING_BUFFER_LENGTH);
@@ -353,15 +762,71 @@ void logError(const char *functionName, int errorNumber) {
   free(buffer);
 }
 
+exoplayer_jni::PcmEncoding getResampledEncoding(AVCodecContext *context) {
+  return context->request_sample_fmt == OUTPUT_FORMAT_PCM_FLOAT
+             ? exoplayer_jni::kPcmEncodingFloat
+             : exoplayer_jni::kPcmEncoding16Bit;
+}
+
 void releaseContext(AVCodecContext *context) {
   if (!context) {
     return;
   }
-  SwrContext *swrContext;
-  if ((swrContext = (SwrContext *)context->opaque)) {
-    swr_free(&swrContext);
-    context->opaque = NULL;
-  }
   avcodec_free_context(&context);
 }
 
+void releaseResampleContext(JniContext *jniContext) {
+  if (jniContext->resampleContext) {
+    swr_free(&jniContext->resampleContext);
+  }
+}
+
+#define LIBRARY_METHOD(NAME, SIGNATURE) \
+  EXOPLAYER_JNI_METHOD(                 \
+      #NAME, SIGNATURE,                 \
+      Java_com_google_android_exoplayer2_ext_ffmpeg_FfmpegLibrary_##NAME)
+
+#define AUDIO_DECODER_METHOD(NAME, SIGNATURE) \
+  EXOPLAYER_JNI_METHOD(                       \
+      #NAME, SIGNATURE,                       \
+      Java_com_google_android_exoplayer2_ext_ffmpeg_FfmpegAudioDecoder_##NAME)
+
+static bool registerNativeMethods(JNIEnv *env) {
+  static const JNINativeMethod libraryMethods[] = {
+      LIBRARY_METHOD(ffmpegGetVersion, "()Ljava/lang/String;"),
+      LIBRARY_METHOD(ffmpegGetInputBufferPaddingSize, "()I"),
+      LIBRARY_METHOD(ffmpegHasDecoder, "(Ljava/lang/String;)Z")};
+  static const JNINativeMethod audioDecoderMethods[] = {
+      AUDIO_DECODER_METHOD(ffmpegInitialize, "(Ljava/lang/String;[BZII)J"),
+      AUDIO_DECODER_METHOD(ffmpegDecode,
+                           "(JLjava/nio/ByteBuffer;ILjava/nio/ByteBuffer;I)I"),
+      AUDIO_DECODER_METHOD(ffmpegStartDecodeAhead, "(JII)Z"),
+      AUDIO_DECODER_METHOD(ffmpegDecodeAhead,
+                           "(JJZLjava/nio/ByteBuffer;ILjava/nio/ByteBuffer;)I"),
+      AUDIO_DECODER_METHOD(ffmpegHasDecodeAheadOutput, "(J)Z"),
+      AUDIO_DECODER_METHOD(ffmpegDrainDecodeAhead,
+                           "(JLjava/nio/ByteBuffer;)I"),
+      AUDIO_DECODER_METHOD(ffmpegGetStatusBuffer, "(J)Ljava/nio/ByteBuffer;"),
+      AUDIO_DECODER_METHOD(ffmpegReset, "(J[B)J"),
+      AUDIO_DECODER_METHOD(ffmpegRelease, "(J)V"),
+      AUDIO_DECODER_METHOD(ffmpegSetAudioChainConfig, "(J[IFFFJJFZIIII)Z"),
+      AUDIO_DECODER_METHOD(ffmpegFinishWaveform, "(J[F)I"),
+      AUDIO_DECODER_METHOD(ffmpegGetSpectrum, "(J[F)Z"),
+      AUDIO_DECODER_METHOD(ffmpegGetStats, "(J[J)V"),
+      AUDIO_DECODER_METHOD(ffmpegStartSessionRecording,
+                           "(JLjava/lang/String;)Z"),
+      AUDIO_DECODER_METHOD(ffmpegStopSessionRecording, "(J)V"),
+      AUDIO_DECODER_METHOD(ffmpegSetCrossfade, "(JJI)J"),
+      AUDIO_DECODER_METHOD(ffmpegCrossfade, "(JLjava/nio/ByteBuffer;IIIII)I"),
+      AUDIO_DECODER_METHOD(ffmpegGetCrossfadeDrainSize, "(J)I"),
+      AUDIO_DECODER_METHOD(ffmpegDrainCrossfade, "(JLjava/nio/ByteBuffer;I)I"),
+      AUDIO_DECODER_METHOD(ffmpegEndCrossfadeStream, "(J)V"),
+      AUDIO_DECODER_METHOD(ffmpegFlushCrossfade, "(J)V"),
+      AUDIO_DECODER_METHOD(ffmpegReleaseCrossfade, "(J)V")};
+  return exoplayer_jni::RegisterNatives(
+             env, "com/google/android/exoplayer2/ext/ffmpeg/FfmpegLibrary",
+             libraryMethods) &&
+         exoplayer_jni::RegisterNatives(
+             env, "com/google/android/exoplayer2/ext/ffmpeg/FfmpegAudioDecoder",
+             audioDecoderMethods);
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.google.android.exoplayer2.ext.flac;
+
+import static com.google.common.truth.Truth.assertThat;
+import static org.junit.Assert.fail;
+
+import androidx.test.core.app.ApplicationProvider;
+import androidx.test.ext.junit.runners.AndroidJUnit4;
+import com.google.android.exoplayer2.extractor.FlacStreamMetadata;
+import com.google.android.exoplayer2.testutil.TestUtil;
+import com.google.android.exoplayer2.upstream.DataSource;
+import com.google.android.exoplayer2.upstream.DataSpec;
+import com.google.android.exoplayer2.upstream.DefaultDataSourceFactory;
+import com.google.android.exoplayer2.util.Util;
+import java.io.ByteArrayOutputStream;
+import java.nio.ByteBuffer;
+import java.util.Arrays;
+import org.junit.Before;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+
+/** Tests for {@link FlacDecoderJni#seekToSample(long, long)}. */
+@RunWith(AndroidJUnit4.class)
+public final class FlacDecoderJniSeekTest {
+
+  private static final String TEST_FILE_SEEK_TABLE = "media/flac/bear.flac";
+  private static final String TEST_FILE_BINARY_SEARCH = "media/flac/bear_one_metadata_block.flac";
+
+  @Before
+  public void setUp() {
+    if (!FlacLibrary.isAvailable()) {
+      fail("Flac library not available.");
+    }
+  }
+
+  @Test
+  public void seekToSample_seekTable_insideFrame_matchesLinearDecode() throws Exception {
+    assertSeeksMatchLinearDecode(TEST_FILE_SEEK_TABLE);
+  }
+
+  @Test
+  public void seekToSample_binarySearch_insideFrame_matchesLinearDecode() throws Exception {
+    assertSeeksMatchLinearDecode(TEST_FILE_BINARY_SEARCH);
+  }
+
+  private static void assertSeeksMatchLinearDecode(String fileName) throws Exception {
+    byte[] linearOutput = decodeLinearly(fileName);
+    DataSource dataSource = createDataSource();
+    FlacDecoderJni decoderJni = new FlacDecoderJni();
+    try {
+      DataSpec dataSpec = new DataSpec(TestUtil.buildAssetUri(fileName));
+      long length = dataSource.open(dataSpec);
+      decoderJni.setData(dataSource, dataSpec);
+      FlacStreamMetadata streamMetadata = decoderJni.decodeStreamMetadata();
+      int bytesPerFrame = streamMetadata.channels * streamMetadata.bitsPerSample / 8;
+      int blockSize = streamMetadata.maxBlockSizeSamples;
+      ByteBuffer output = ByteBuffer.allocateDirect(streamMetadata.getMaxDecodedFrameSize());
+      // Targets inside frames, rather than on their boundaries, in a non-monotonic order.
+      long[] sampleIndices = {blockSize * 3L + 1, blockSize / 3, blockSize * 7L + blockSize - 1};
+      for (long sampleIndex : sampleIndices) {
+        assertThat(decoderJni.seekToSample(sampleIndex, length)).isTrue();
+        decoderJni.decodeSample(output);
+
+        assertThat(decoderJni.getLastFrameFirstSampleIndex()).isEqualTo(sampleIndex);
+        // The trimmed frame ends on the boundary of the frame containing the target.
+        assertThat(output.limit())
+            .isEqualTo((blockSize - sampleIndex % blockSize) * bytesPerFrame);
+        byte[] decoded = new byte[output.limit()];
+        output.get(decoded);
+        int offset = (int) (sampleIndex * bytesPerFrame);
+        assertThat(decoded)
+            .isEqualTo(Arrays.copyOfRange(linearOutput, offset, offset + decoded.length));
+      }
+    } finally {
+      decoderJni.release();
+      Util.closeQuietly(dataSource);
+    }
+  }
+
+  /** Returns the interleaved samples of the whole stream, decoded from its start. */
+  private static byte[] decodeLinearly(String fileName) throws Exception {
+    DataSource dataSource = createDataSource();
+    FlacDecoderJni decoderJni = new FlacDecoderJni();
+    try {
+      DataSpec dataSpec = new DataSpec(TestUtil.buildAssetUri(fileName));
+      dataSource.open(dataSpec);
+      decoderJni.setData(dataSource, dataSpec);
+      FlacStreamMetadata streamMetadata = decoderJni.decodeStreamMetadata();
+      ByteBuffer output = ByteBuffer.allocateDirect(streamMetadata.getMaxDecodedFrameSize());
+      ByteArrayOutputStream linearOutput = new ByteArrayOutputStream();
+      while (true) {
+        decoderJni.decodeSample(output);
+        if (output.limit() == 0) {
+          return linearOutput.toByteArray();
+        }
+        byte[] frame = new byte[output.limit()];
+        output.get(frame);
+        linearOutput.write(frame);
+      }
+    } finally {
+      decoderJni.release();
+      Util.closeQuietly(dataSource);
+    }
+  }
+
+  private static DataSource createDataSource() {
+    return new DefaultDataSourceFactory(ApplicationProvider.getApplicationContext())
+        .createDataSource();
+  }
+}
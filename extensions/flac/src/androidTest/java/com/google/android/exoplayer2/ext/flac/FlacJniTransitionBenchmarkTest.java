@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.google.android.exoplayer2.ext.flac;
+
+import static com.google.common.truth.Truth.assertThat;
+import static org.junit.Assert.fail;
+
+import androidx.test.core.app.ApplicationProvider;
+import androidx.test.ext.junit.runners.AndroidJUnit4;
+import com.google.android.exoplayer2.decoder.NativeDecoderStats;
+import com.google.android.exoplayer2.extractor.FlacStreamMetadata;
+import com.google.android.exoplayer2.testutil.FakeExtractorInput;
+import com.google.android.exoplayer2.testutil.TestUtil;
+import com.google.android.exoplayer2.util.Log;
+import java.nio.ByteBuffer;
+import org.junit.Before;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+
+/**
+ * Counts and measures the JNI transitions made by {@link FlacDecoderJni} when decoding a file in
+ * the same way as {@link FlacExtractor}.
+ *
+ * <p>Per-frame state such as positions and timestamps is read from a status block that's shared
+ * with native code. Before the status block was introduced, each read was a separate JNI call, so
+ * the number of transitions that would have been made previously is the number of native calls
+ * plus the number of status reads.
+ *
+ * <p>Input is read through upcalls from native code to {@link FlacDecoderJni#read}, so the cost of
+ * each decode call is split into the time spent in native code, excluding upcalls, the time spent
+ * in upcalls, and the remainder, which is the cost of the transitions into and out of native code
+ * plus the Java side of the call.
+ */
+@RunWith(AndroidJUnit4.class)
+public final class FlacJniTransitionBenchmarkTest {
+
+  private static final String TAG = "FlacJniTransitionBench";
+  private static final String TEST_FILE = "media/flac/bear.flac";
+
+  @Before
+  public void setUp() {
+    if (!FlacLibrary.isAvailable()) {
+      fail("Flac library not available.");
+    }
+  }
+
+  @Test
+  public void decodeFile_makesOneNativeCallPerFrame() throws Exception {
+    byte[] data = TestUtil.getByteArray(ApplicationProvider.getApplicationContext(), TEST_FILE);
+    FakeExtractorInput input = new FakeExtractorInput.Builder().setData(data).build();
+    FlacDecoderJni decoderJni = new FlacDecoderJni();
+    decoderJni.setData(input);
+    FlacStreamMetadata streamMetadata = decoderJni.decodeStreamMetadata();
+    ByteBuffer output = ByteBuffer.allocate(streamMetadata.getMaxDecodedFrameSize());
+    int setupCallCount = decoderJni.getNativeCallCount();
+
+    int frameCount = 0;
+    int statusReadCount = 0;
+    long lastTimestampUs = -1;
+    while (true) {
+      long decodePosition = decoderJni.getDecodePosition();
+      decoderJni.decodeSampleWithBacktrackPosition(output, decodePosition);
+      statusReadCount++;
+      if (output.limit() == 0) {
+        // End of input. The decoder read the end of input status when no frame was decoded.
+        statusReadCount++;
+        break;
+      }
+      long timestampUs = decoderJni.getLastFrameTimestamp();
+      statusReadCount++;
+      assertThat(timestampUs).isGreaterThan(lastTimestampUs);
+      lastTimestampUs = timestampUs;
+      frameCount++;
+      if (decoderJni.isEndOfData()) {
+        break;
+      }
+    }
+    int frameCallCount = decoderJni.getNativeCallCount() - setupCallCount;
+    decoderJni.release();
+
+    Log.i(
+        TAG,
+        "Decoded "
+            + frameCount
+            + " frames with "
+            + frameCallCount
+            + " native calls (previously "
+            + (frameCallCount + statusReadCount)
+            + ")");
+    assertThat(frameCount).isGreaterThan(0);
+    assertThat(frameCallCount).isAtMost(frameCount + 1);
+  }
+
+  @Test
+  public void decodeFile_reportsBoundaryCostPerCall() throws Exception {
+    byte[] data = TestUtil.getByteArray(ApplicationProvider.getApplicationContext(), TEST_FILE);
+    FakeExtractorInput input = new FakeExtractorInput.Builder().setData(data).build();
+    FlacDecoderJni decoderJni = new FlacDecoderJni();
+    decoderJni.setData(input);
+    FlacStreamMetadata streamMetadata = decoderJni.decodeStreamMetadata();
+    ByteBuffer output = ByteBuffer.allocateDirect(streamMetadata.getMaxDecodedFrameSize());
+    NativeDecoderStats statsBefore = decoderJni.getNativeStats();
+
+    int decodeCount = 0;
+    long javaTimeNs = 0;
+    while (true) {
+      long startTimeNs = System.nanoTime();
+      decoderJni.decodeSample(output);
+      javaTimeNs += System.nanoTime() - startTimeNs;
+      decodeCount++;
+      if (output.limit() == 0 || decoderJni.isEndOfData()) {
+        break;
+      }
+    }
+    NativeDecoderStats statsAfter = decoderJni.getNativeStats();
+    decoderJni.release();
+
+    long nativeCallCount = statsAfter.nativeCallCount - statsBefore.nativeCallCount;
+    long nativeTimeNs = statsAfter.nativeCallTimeNs - statsBefore.nativeCallTimeNs;
+    long upcallCount = statsAfter.upcallCount - statsBefore.upcallCount;
+    long upcallTimeNs = statsAfter.upcallTimeNs - statsBefore.upcallTimeNs;
+    Log.i(
+        TAG,
+        "Per decode call: total "
+            + javaTimeNs / decodeCount
+            + " ns, native work "
+            + (nativeTimeNs - upcallTimeNs) / decodeCount
+            + " ns, "
+            + upcallCount / (double) decodeCount
+            + " upcalls "
+            + upcallTimeNs / decodeCount
+            + " ns, transitions and Java "
+            + (javaTimeNs - nativeTimeNs) / decodeCount
+            + " ns");
+    assertThat(nativeCallCount).isEqualTo(decodeCount);
+    assertThat(upcallCount).isGreaterThan(0);
+    assertThat(nativeTimeNs).isAtMost(javaTimeNs);
+  }
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.google.android.exoplayer2.ext.flac;
+
+import static com.google.common.truth.Truth.assertThat;
+import static org.junit.Assert.fail;
+
+import android.net.Uri;
+import androidx.test.core.app.ApplicationProvider;
+import androidx.test.ext.junit.runners.AndroidJUnit4;
+import com.google.android.exoplayer2.C;
+import com.google.android.exoplayer2.extractor.FlacStreamMetadata;
+import com.google.android.exoplayer2.extractor.SeekMap;
+import com.google.android.exoplayer2.testutil.FakeExtractorOutput;
+import com.google.android.exoplayer2.testutil.FakeTrackOutput;
+import com.google.android.exoplayer2.testutil.TestUtil;
+import com.google.android.exoplayer2.upstream.DataSpec;
+import com.google.android.exoplayer2.upstream.DefaultDataSourceFactory;
+import com.google.android.exoplayer2.upstream.StatsDataSource;
+import com.google.android.exoplayer2.util.Log;
+import com.google.android.exoplayer2.util.Util;
+import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.util.Arrays;
+import java.util.Random;
+import org.junit.Before;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+
+/**
+ * Measures the time from a seek to the first decoded sample with {@link FlacExtractor}, for a
+ * sequence of seeks to random positions, when the stream has a seek table and when it has to be
+ * binary searched, and with {@link FlacDecoderJni#seekToSample(long, long)}, which bisects the
+ * stream in native code.
+ *
+ * <p>{@link FlacExtractor} outputs decoded samples, so the time includes finding the frame that
+ * contains the seek position, reading it and decoding it.
+ */
+@RunWith(AndroidJUnit4.class)
+public final class FlacSeekBenchmarkTest {
+
+  private static final String TAG = "FlacSeekBenchmark";
+  private static final String TEST_FILE_SEEK_TABLE = "media/flac/bear.flac";
+  private static final String TEST_FILE_BINARY_SEARCH = "media/flac/bear_one_metadata_block.flac";
+  private static final int SEEK_COUNT = 100;
+
+  @Before
+  public void setUp() {
+    if (!FlacLibrary.isAvailable()) {
+      fail("Flac library not available.");
+    }
+  }
+
+  @Test
+  public void randomSeeks_seekTable_reportsTimeToFirstSample() throws IOException {
+    benchmarkRandomSeeks(TEST_FILE_SEEK_TABLE);
+  }
+
+  @Test
+  public void randomSeeks_binarySearch_reportsTimeToFirstSample() throws IOException {
+    benchmarkRandomSeeks(TEST_FILE_BINARY_SEARCH);
+  }
+
+  @Test
+  public void randomSeeks_nativeSeek_reportsTimeToFirstSample() throws Exception {
+    Uri fileUri = TestUtil.buildAssetUri(TEST_FILE_BINARY_SEARCH);
+    StatsDataSource dataSource =
+        new StatsDataSource(
+            new DefaultDataSourceFactory(ApplicationProvider.getApplicationContext())
+                .createDataSource());
+    FlacDecoderJni decoderJni = new FlacDecoderJni();
+    try {
+      DataSpec dataSpec = new DataSpec(fileUri);
+      long length = dataSource.open(dataSpec);
+      decoderJni.setData(dataSource, dataSpec);
+      FlacStreamMetadata streamMetadata = decoderJni.decodeStreamMetadata();
+      ByteBuffer output = ByteBuffer.allocateDirect(streamMetadata.getMaxDecodedFrameSize());
+
+      Random random = new Random(/* seed= */ 0);
+      long[] timesNs = new long[SEEK_COUNT];
+      dataSource.resetBytesRead();
+      for (int i = 0; i < SEEK_COUNT; i++) {
+        long sampleIndex = (long) (random.nextDouble() * streamMetadata.totalSamples);
+        long startTimeNs = System.nanoTime();
+        boolean sought = decoderJni.seekToSample(sampleIndex, length);
+        decoderJni.decodeSample(output);
+        timesNs[i] = System.nanoTime() - startTimeNs;
+        assertThat(sought).isTrue();
+        // The first decoded frame starts at the exact sample.
+        assertThat(decoderJni.getLastFrameFirstSampleIndex()).isEqualTo(sampleIndex);
+        assertThat(output.limit()).isGreaterThan(0);
+      }
+      Arrays.sort(timesNs);
+
+      Log.i(
+          TAG,
+          TEST_FILE_BINARY_SEARCH
+              + " (native seek): time to first sample p50 "
+              + timesNs[(SEEK_COUNT - 1) / 2] / 1000
+              + " us, p90 "
+              + timesNs[(SEEK_COUNT - 1) * 90 / 100] / 1000
+              + " us; "
+              + dataSource.getBytesRead() / SEEK_COUNT
+              + " bytes read per seek");
+    } finally {
+      decoderJni.release();
+      Util.closeQuietly(dataSource);
+    }
+  }
+
+  private static void benchmarkRandomSeeks(String fileName) throws IOException {
+    Uri fileUri = TestUtil.buildAssetUri(fileName);
+    FlacExtractor extractor = new FlacExtractor();
+    FakeExtractorOutput extractorOutput = new FakeExtractorOutput();
+    StatsDataSource dataSource =
+        new StatsDataSource(
+            new DefaultDataSourceFactory(ApplicationProvider.getApplicationContext())
+                .createDataSource());
+    SeekMap seekMap = TestUtil.extractSeekMap(extractor, extractorOutput, dataSource, fileUri);
+    assertThat(seekMap.isSeekable()).isTrue();
+    FakeTrackOutput trackOutput = extractorOutput.trackOutputs.get(0);
+
+    Random random = new Random(/* seed= */ 0);
+    long[] timesNs = new long[SEEK_COUNT];
+    dataSource.resetBytesRead();
+    for (int i = 0; i < SEEK_COUNT; i++) {
+      long seekTimeUs = (long) (random.nextDouble() * seekMap.getDurationUs());
+      long startTimeNs = System.nanoTime();
+      int sampleIndex =
+          TestUtil.seekToTimeUs(extractor, seekMap, seekTimeUs, dataSource, trackOutput, fileUri);
+      timesNs[i] = System.nanoTime() - startTimeNs;
+      assertThat(sampleIndex).isNotEqualTo(C.INDEX_UNSET);
+      assertThat(trackOutput.getSampleTimeUs(sampleIndex)).isAtMost(seekTimeUs);
+    }
+    Arrays.sort(timesNs);
+
+    Log.i(
+        TAG,
+        fileName
+            + ": time to first sample p50 "
+            + timesNs[(SEEK_COUNT - 1) / 2] / 1000
+            + " us, p90 "
+            + timesNs[(SEEK_COUNT - 1) * 90 / 100] / 1000
+            + " us; "
+            + dataSource.getBytesRead() / SEEK_COUNT
+            + " bytes read per seek");
+  }
+}
@@ -19,12 +19,18 @@ import static androidx.annotation.VisibleForTesting.PACKAGE_PRIVATE;
 
 import androidx.annotation.Nullable;
 import androidx.annotation.VisibleForTesting;
+import com.google.android.exoplayer2.C;
 import com.google.android.exoplayer2.Format;
 import com.google.android.exoplayer2.ParserException;
+import com.google.android.exoplayer2.audio.AudioChainConfig;
+import com.google.android.exoplayer2.audio.DecoderCrossfade;
 import com.google.android.exoplayer2.decoder.DecoderInputBuffer;
+import com.google.android.exoplayer2.decoder.NativeDecoder;
+import com.google.android.exoplayer2.decoder.NativeDecoderStats;
 import com.google.android.exoplayer2.decoder.SimpleDecoder;
 import com.google.android.exoplayer2.decoder.SimpleOutputBuffer;
 import com.google.android.exoplayer2.extractor.FlacStreamMetadata;
+import com.google.android.exoplayer2.util.Assertions;
 import com.google.android.exoplayer2.util.Util;
 import java.io.IOException;
 import java.nio.ByteBuffer;
@@ -33,11 +39,18 @@ import java.util.List;
 /** Flac decoder. */
 @VisibleForTesting(otherwise = PACKAGE_PRIVATE)
 public final class FlacDecoder
-    extends SimpleDecoder<DecoderInputBuffer, SimpleOutputBuffer, FlacDecoderException> {
+    extends SimpleDecoder<DecoderInputBuffer, SimpleOutputBuffer, FlacDecoderException>
+    implements NativeDecoder {
 
   private final FlacStreamMetadata streamMetadata;
   private final FlacDecoderJni decoderJni;
 
+  @Nullable private AudioChainConfig audioChainConfig;
+  private boolean pcm16Output;
+  private int outputBufferSize;
+  @Nullable private DecoderCrossfade crossfade;
+  @Nullable private Format crossfadeFormat;
+
   /**
    * Creates a Flac decoder.
    *
@@ -73,6 +86,161 @@ public final class FlacDecoder
     int initialInputBufferSize =
         maxInputBufferSize != Format.NO_VALUE ? maxInputBufferSize : streamMetadata.maxFrameSize;
     setInitialInputBufferSize(initialInputBufferSize);
+    outputBufferSize = streamMetadata.getMaxDecodedFrameSize();
+  }
+
+  /**
+   * Sets the processing that the native decoder applies to its output. May only be called once,
+   * before the first input buffer is queued.
+   *
+   * @param audioChainConfig The configuration, or null to output the decoded samples unchanged.
+   * @throws FlacDecoderException If the configuration isn't supported for the stream.
+   */
+  public void setAudioChainConfig(@Nullable AudioChainConfig audioChainConfig)
+      throws FlacDecoderException {
+    Assertions.checkState(this.audioChainConfig == null);
+    if (audioChainConfig == null) {
+      return;
+    }
+    Assertions.checkState(!pcm16Output);
+    @C.PcmEncoding int encoding = getDecodedEncoding(streamMetadata);
+    // The chain doesn't process 8-bit samples.
+    if (encoding == C.ENCODING_PCM_8BIT
+        || encoding == C.ENCODING_INVALID
+        || !audioChainConfig.isApplicableTo(streamMetadata.channels)
+        || !decoderJni.setAudioChainConfig(audioChainConfig)) {
+      throw new FlacDecoderException("Unsupported audio chain configuration");
+    }
+    this.audioChainConfig = audioChainConfig;
+    outputBufferSize =
+        audioChainConfig.getMaxOutputSize(
+            streamMetadata.maxBlockSizeSamples,
+            encoding,
+            streamMetadata.channels,
+            streamMetadata.sampleRate);
+  }
+
+  /**
+   * Makes the decoder output 16-bit samples for a stream with more than 16 bits per sample,
+   * requantized with triangular (TPDF) dither rather than truncated. Has no effect for streams with
+   * 16 bits per sample or fewer, or on big endian devices. May only be called before the first
+   * input buffer is queued, and not together with {@link #setAudioChainConfig(AudioChainConfig)},
+   * which has its own output encoding.
+   *
+   * @param noiseShaping Whether to feed the requantization error back, which moves the noise
+   *     towards high frequencies where it's less audible, but raises its total level.
+   */
+  public void setPcm16Output(boolean noiseShaping) {
+    Assertions.checkState(audioChainConfig == null);
+    if (streamMetadata.bitsPerSample <= 16 || !decoderJni.setPcm16Output(noiseShaping)) {
+      return;
+    }
+    pcm16Output = true;
+    outputBufferSize = streamMetadata.maxBlockSizeSamples * streamMetadata.channels * 2;
+  }
+
+  /**
+   * Crossfades the decoder's stream with the adjacent streams, as described in {@link
+   * DecoderCrossfade}, unless its output is 8-bit. May only be called once, after {@link
+   * #setAudioChainConfig(AudioChainConfig)} and before the first input buffer is queued.
+   *
+   * @param durationUs The duration of the crossfade, in microseconds.
+   * @param curve The shape of the crossfade into this decoder's stream.
+   * @param previousDecoder The released decoder of the previous stream, whose held back output is
+   *     crossfaded into the start of this decoder's stream if it ended by crossfading into the next
+   *     stream, or null.
+   * @throws FlacDecoderException If the crossfade isn't supported.
+   */
+  public void setCrossfade(
+      long durationUs, @DecoderCrossfade.Curve int curve, @Nullable FlacDecoder previousDecoder)
+      throws FlacDecoderException {
+    Assertions.checkState(crossfade == null);
+    Format outputFormat = getOutputFormat();
+    // The mixer doesn't mix 8-bit samples.
+    if (outputFormat.pcmEncoding == C.ENCODING_PCM_8BIT
+        || outputFormat.pcmEncoding == C.ENCODING_INVALID) {
+      return;
+    }
+    crossfade =
+        DecoderCrossfade.create(
+            decoderJni,
+            durationUs,
+            curve,
+            getOutputSpeed(),
+            previousDecoder != null ? previousDecoder.crossfade : null);
+    if (crossfade == null) {
+      throw new FlacDecoderException("Unsupported crossfade");
+    }
+    crossfadeFormat = outputFormat;
+  }
+
+  /**
+   * Keeps the output that's held back at the end of the stream for the next decoder. See {@link
+   * DecoderCrossfade#crossfadeIntoNextStream()}.
+   */
+  public void crossfadeIntoNextStream() {
+    if (crossfade != null) {
+      crossfade.crossfadeIntoNextStream();
+    }
+  }
+
+  /**
+   * Releases the output that's held back for the next decoder, if it wasn't passed on to it. See
+   * {@link DecoderCrossfade#releaseHeldOutput()}.
+   */
+  public void releaseCrossfade() {
+    if (crossfade != null) {
+      crossfade.releaseHeldOutput();
+    }
+  }
+
+  /** Returns the format of the decoder's output. */
+  public Format getOutputFormat() {
+    return pcm16Output
+        ? Util.getPcmFormat(
+            C.ENCODING_PCM_16BIT, streamMetadata.channels, streamMetadata.sampleRate)
+        : getOutputFormat(streamMetadata, audioChainConfig);
+  }
+
+  /** Returns the factor by which the decoder's output is sped up relative to its input. */
+  public float getOutputSpeed() {
+    return audioChainConfig != null ? audioChainConfig.speed : 1f;
+  }
+
+  /**
+   * Returns the integrated loudness of the audio decoded so far, in LUFS. See {@link
+   * AudioChainConfig.Builder#setLoudnessMeasurementEnabled(boolean)}.
+   */
+  public double getIntegratedLoudnessLufs() {
+    long loudness = decoderJni.getIntegratedLoudness();
+    return loudness == Long.MIN_VALUE ? Double.NEGATIVE_INFINITY : loudness / 1000.0;
+  }
+
+  /**
+   * Computes the levels of the frequency bands of the most recently decoded audio. See {@link
+   * AudioChainConfig.Builder#setSpectrumFftSize(int)}.
+   *
+   * @param bands The array to write the level of each band to.
+   * @return Whether the levels were written.
+   */
+  public boolean getSpectrum(float[] bands) {
+    return decoderJni.getSpectrum(bands);
+  }
+
+  /**
+   * Returns the format of the output of a decoder for a stream.
+   *
+   * @param streamMetadata The stream's metadata.
+   * @param audioChainConfig The decoder's {@link AudioChainConfig}, or null if it has none.
+   * @return The output format.
+   */
+  public static Format getOutputFormat(
+      FlacStreamMetadata streamMetadata, @Nullable AudioChainConfig audioChainConfig) {
+    @C.PcmEncoding int encoding = getDecodedEncoding(streamMetadata);
+    return audioChainConfig != null
+        ? audioChainConfig.getOutputFormat(
+            encoding, streamMetadata.channels, streamMetadata.sampleRate)
+        : Util.getPcmFormat(encoding, streamMetadata.channels, streamMetadata.sampleRate);
   }
 
   @Override
@@ -101,10 +269,12 @@ public final class FlacDecoder
       DecoderInputBuffer inputBuffer, SimpleOutputBuffer outputBuffer, boolean reset) {
     if (reset) {
       decoderJni.flush();
+      if (crossfade != null) {
+        crossfade.flush();
+      }
     }
     decoderJni.setData(Util.castNonNull(inputBuffer.data));
-    ByteBuffer outputData =
-        outputBuffer.init(inputBuffer.timeUs, streamMetadata.getMaxDecodedFrameSize());
+    ByteBuffer outputData = outputBuffer.init(inputBuffer.timeUs, outputBufferSize);
     try {
       decoderJni.decodeSample(outputData);
     } catch (FlacDecoderJni.FlacFrameDecodeException e) {
@@ -113,6 +283,35 @@ public final class FlacDecoder
       // Never happens.
       throw new IllegalStateException(e);
     }
+    if (audioChainConfig != null && audioChainConfig.isSkippingSilence()) {
+      outputBuffer.skippedSilenceDurationUs =
+          decoderJni.getSkippedSilenceFrameCount()
+              * C.MICROS_PER_SECOND
+              / audioChainConfig.getOutputSampleRate(streamMetadata.sampleRate);
+    }
+    if (crossfade != null && !outputBuffer.isDecodeOnly()) {
+      Format format = Util.castNonNull(crossfadeFormat);
+      int mixedSize =
+          crossfade.apply(
+              outputBuffer, format.channelCount, format.sampleRate, format.pcmEncoding);
+      if (mixedSize < 0) {
+        return new FlacDecoderException("Crossfade error");
+      } else if (mixedSize == 0) {
+        setNoOutput();
+      }
+    }
+    return null;
+  }
+
+  @Override
+  protected boolean hasPendingOutput() {
+    return crossfade != null && crossfade.hasPendingOutput();
+  }
+
+  @Override
+  @Nullable
+  protected FlacDecoderException decodePendingOutput(SimpleOutputBuffer outputBuffer) {
+    Util.castNonNull(crossfade).drain(outputBuffer);
     return null;
   }
 
@@ -120,10 +319,33 @@ public final class FlacDecoder
   public void release() {
     super.release();
     decoderJni.release();
+    if (crossfade != null) {
+      crossfade.release();
+    }
   }
 
   /** Returns the {@link FlacStreamMetadata} decoded from the initialization data. */
   public FlacStreamMetadata getStreamMetadata() {
     return streamMetadata;
   }
+
+  @Override
+  public NativeDecoderStats getNativeStats() {
+    return decoderJni.getNativeStats();
+  }
+
+  @Override
+  public boolean startSessionRecording(String path) {
+    return decoderJni.startSessionRecording(path);
+  }
+
+  @Override
+  public void stopSessionRecording() {
+    decoderJni.stopSessionRecording();
+  }
+
+  @C.PcmEncoding
+  private static int getDecodedEncoding(FlacStreamMetadata streamMetadata) {
+    return Util.getPcmEncoding(streamMetadata.bitsPerSample);
+  }
 }
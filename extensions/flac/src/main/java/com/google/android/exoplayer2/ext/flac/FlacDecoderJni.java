@@ -17,21 +17,30 @@ package com.google.android.exoplayer2.ext.flac;
 
 import static java.lang.Math.min;
 
+import androidx.annotation.GuardedBy;
 import androidx.annotation.Nullable;
+import androidx.annotation.VisibleForTesting;
 import com.google.android.exoplayer2.C;
 import com.google.android.exoplayer2.ParserException;
+import com.google.android.exoplayer2.audio.AudioChainConfig;
+import com.google.android.exoplayer2.audio.DecoderCrossfade;
+import com.google.android.exoplayer2.decoder.NativeDecoderStats;
 import com.google.android.exoplayer2.extractor.ExtractorInput;
 import com.google.android.exoplayer2.extractor.FlacStreamMetadata;
 import com.google.android.exoplayer2.extractor.SeekMap;
 import com.google.android.exoplayer2.extractor.SeekPoint;
+import com.google.android.exoplayer2.upstream.DataSource;
+import com.google.android.exoplayer2.upstream.DataSpec;
+import com.google.android.exoplayer2.util.Assertions;
 import com.google.android.exoplayer2.util.Util;
 import java.io.IOException;
 import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
 
 /**
  * JNI wrapper for the libflac Flac decoder.
  */
-/* package */ final class FlacDecoderJni {
+/* package */ final class FlacDecoderJni implements DecoderCrossfade.NativeMixer {
 
   /** Exception to be thrown if {@link #decodeSample(ByteBuffer)} fails to decode a frame. */
   public static final class FlacFrameDecodeException extends Exception {
@@ -46,12 +55,33 @@ import java.nio.ByteBuffer;
 
   private static final int TEMP_BUFFER_SIZE = 8192; // The same buffer size as libflac.
 
+  // Slots of the status block that is published by the native decoder.
+  // LINT.IfChange
+  private static final int STATUS_DECODE_POSITION = 0;
+  private static final int STATUS_LAST_FRAME_TIMESTAMP = 1;
+  private static final int STATUS_LAST_FRAME_FIRST_SAMPLE_INDEX = 2;
+  private static final int STATUS_NEXT_FRAME_FIRST_SAMPLE_INDEX = 3;
+  private static final int STATUS_DECODER_AT_END_OF_STREAM = 4;
+  private static final int STATUS_SKIPPED_SILENCE_FRAME_COUNT = 5;
+  private static final int STATUS_INTEGRATED_LOUDNESS = 6;
+  // LINT.ThenChange(../../../../../../../jni/flac_jni.cc)
+
   private final long nativeDecoderContext;
+  private final ByteBuffer statusBuffer;
+  private final Object releaseLock;
 
   @Nullable private ByteBuffer byteBufferData;
   @Nullable private ExtractorInput extractorInput;
+  @Nullable private DataSource dataSource;
+  @Nullable private DataSpec dataSpec;
   @Nullable private byte[] tempBuffer;
   private boolean endOfExtractorInput;
+  private long dataSourcePosition;
+  private boolean endOfDataSource;
+  private int nativeCallCount;
+
+  @GuardedBy("releaseLock")
+  private boolean released;
 
   public FlacDecoderJni() throws FlacDecoderException {
     if (!FlacLibrary.isAvailable()) {
@@ -61,6 +91,9 @@ import java.nio.ByteBuffer;
     if (nativeDecoderContext == 0) {
       throw new FlacDecoderException("Failed to initialize decoder");
     }
+    statusBuffer = flacGetStatusBuffer(nativeDecoderContext).order(ByteOrder.nativeOrder());
+    releaseLock = new Object();
+    nativeCallCount = 2;
   }
 
   /**
@@ -71,6 +104,7 @@ import java.nio.ByteBuffer;
   public void setData(ByteBuffer byteBufferData) {
     this.byteBufferData = byteBufferData;
     this.extractorInput = null;
+    this.dataSource = null;
   }
 
   /**
@@ -81,12 +115,34 @@ import java.nio.ByteBuffer;
   public void setData(ExtractorInput extractorInput) {
     this.byteBufferData = null;
     this.extractorInput = extractorInput;
+    this.dataSource = null;
     endOfExtractorInput = false;
     if (tempBuffer == null) {
       tempBuffer = new byte[TEMP_BUFFER_SIZE];
     }
   }
 
+  /**
+   * Sets the data to be parsed, which is read from a data source that's reopened whenever the
+   * native decoder reads from a different position, so that it can seek within the stream with
+   * {@link #seekToSample(long, long)}. Positions are relative to the position of {@code dataSpec}.
+   * The caller remains responsible for closing the data source.
+   *
+   * @param dataSource Source {@link DataSource}, which must have been opened with {@code dataSpec}.
+   * @param dataSpec The {@link DataSpec} of the stream.
+   */
+  public void setData(DataSource dataSource, DataSpec dataSpec) {
+    this.byteBufferData = null;
+    this.extractorInput = null;
+    this.dataSource = dataSource;
+    this.dataSpec = dataSpec;
+    dataSourcePosition = 0;
+    endOfDataSource = false;
+    if (tempBuffer == null) {
+      tempBuffer = new byte[TEMP_BUFFER_SIZE];
+    }
+  }
+
   /**
    * Returns whether the end of the data to be parsed has been reached, or true if no data was set.
    */
@@ -95,6 +151,8 @@ import java.nio.ByteBuffer;
       return byteBufferData.remaining() == 0;
     } else if (extractorInput != null) {
       return endOfExtractorInput;
+    } else if (dataSource != null) {
+      return endOfDataSource;
     } else {
       return true;
     }
@@ -104,6 +162,7 @@ import java.nio.ByteBuffer;
   public void clearData() {
     byteBufferData = null;
     extractorInput = null;
+    dataSource = null;
   }
 
   /**
@@ -113,11 +172,14 @@ import java.nio.ByteBuffer;
    * detected or an exception is thrown.
    *
    * @param target A target {@link ByteBuffer} into which data should be written.
+   * @param position The position in the stream to read from. Only data sources set with {@link
+   *     #setData(DataSource, DataSpec)} are repositioned. Other sources are read sequentially, and
+   *     are positioned by their callers.
    * @return Returns the number of bytes read, or -1 on failure. If all of the data has already been
    *     read from the source, then 0 is returned.
    */
   @SuppressWarnings("unused") // Called from native code.
-  public int read(ByteBuffer target) throws IOException {
+  public int read(ByteBuffer target, long position) throws IOException {
     int byteCount = target.remaining();
     if (byteBufferData != null) {
       byteCount = min(byteCount, byteBufferData.remaining());
@@ -140,6 +202,23 @@ import java.nio.ByteBuffer;
       }
       byteCount = read;
       target.put(tempBuffer, 0, byteCount);
+    } else if (dataSource != null) {
+      DataSource dataSource = this.dataSource;
+      byte[] tempBuffer = Util.castNonNull(this.tempBuffer);
+      if (position != dataSourcePosition) {
+        dataSource.close();
+        dataSource.open(Util.castNonNull(dataSpec).subrange(position));
+        dataSourcePosition = position;
+        endOfDataSource = false;
+      }
+      int read = dataSource.read(tempBuffer, /* offset= */ 0, min(byteCount, TEMP_BUFFER_SIZE));
+      if (read == C.RESULT_END_OF_INPUT) {
+        endOfDataSource = true;
+        return 0;
+      }
+      dataSourcePosition += read;
+      byteCount = read;
+      target.put(tempBuffer, 0, byteCount);
     } else {
       return -1;
     }
@@ -148,6 +227,7 @@ import java.nio.ByteBuffer;
 
   /** Decodes and consumes the metadata from the FLAC stream. */
   public FlacStreamMetadata decodeStreamMetadata() throws IOException {
+    nativeCallCount++;
     FlacStreamMetadata streamMetadata = flacDecodeMetadata(nativeDecoderContext);
     if (streamMetadata == null) {
       throw new ParserException("Failed to decode stream metadata");
@@ -181,6 +261,7 @@ import java.nio.ByteBuffer;
   @SuppressWarnings("ByteBufferBackingArray")
   public void decodeSample(ByteBuffer output) throws IOException, FlacFrameDecodeException {
     output.clear();
+    nativeCallCount++;
     int frameSize =
         output.isDirect()
             ? flacDecodeToBuffer(nativeDecoderContext, output)
@@ -200,22 +281,38 @@ import java.nio.ByteBuffer;
    * Returns the position of the next data to be decoded, or -1 in case of error.
    */
   public long getDecodePosition() {
-    return flacGetDecodePosition(nativeDecoderContext);
+    return getStatus(STATUS_DECODE_POSITION);
   }
 
   /** Returns the timestamp for the first sample in the last decoded frame. */
   public long getLastFrameTimestamp() {
-    return flacGetLastFrameTimestamp(nativeDecoderContext);
+    return getStatus(STATUS_LAST_FRAME_TIMESTAMP);
   }
 
   /** Returns the first sample index of the last extracted frame. */
   public long getLastFrameFirstSampleIndex() {
-    return flacGetLastFrameFirstSampleIndex(nativeDecoderContext);
+    return getStatus(STATUS_LAST_FRAME_FIRST_SAMPLE_INDEX);
   }
 
   /** Returns the first sample index of the frame to be extracted next. */
   public long getNextFrameFirstSampleIndex() {
-    return flacGetNextFrameFirstSampleIndex(nativeDecoderContext);
+    return getStatus(STATUS_NEXT_FRAME_FIRST_SAMPLE_INDEX);
+  }
+
+  /**
+   * Returns the number of output frames of silence that the audio chain skipped while decoding the
+   * last sample.
+   */
+  public long getSkippedSilenceFrameCount() {
+    return getStatus(STATUS_SKIPPED_SILENCE_FRAME_COUNT);
+  }
+
+  /**
+   * Returns the integrated loudness measured by the audio chain in thousandths of LUFS, or {@link
+   * Long#MIN_VALUE} if there's no measurement.
+   */
+  public long getIntegratedLoudness() {
+    return getStatus(STATUS_INTEGRATED_LOUDNESS);
   }
 
   /**
@@ -229,6 +326,7 @@ import java.nio.ByteBuffer;
   @Nullable
   public SeekMap.SeekPoints getSeekPoints(long timeUs) {
     long[] seekPoints = new long[4];
+    nativeCallCount++;
     if (!flacGetSeekPoints(nativeDecoderContext, timeUs, seekPoints)) {
       return null;
     }
@@ -240,16 +338,38 @@ import java.nio.ByteBuffer;
     return new SeekMap.SeekPoints(firstSeekPoint, secondSeekPoint);
   }
 
+  /**
+   * Seeks to a sample in native code, where libFLAC bisects the stream, reading it at the positions
+   * it needs, and positions the decoder on the exact sample. The next decoded sample starts at the
+   * target sample. The data must have been set with {@link #setData(DataSource, DataSpec)}, and the
+   * stream metadata must have been decoded.
+   *
+   * @param sampleIndex The index of the sample to seek to.
+   * @param streamLength The length of the stream in bytes, or {@link C#LENGTH_UNSET} if unknown,
+   *     in which case only samples that are bracketed by the stream's seek table can be sought.
+   * @return Whether the seek succeeded. If it didn't, the decoder must be {@link #reset(long)
+   *     reset} before decoding continues.
+   * @throws IOException If an error occurs reading from the stream.
+   */
+  public boolean seekToSample(long sampleIndex, long streamLength) throws IOException {
+    Assertions.checkState(dataSource != null);
+    nativeCallCount++;
+    return flacSeekAbsolute(
+        nativeDecoderContext, sampleIndex, streamLength == C.LENGTH_UNSET ? 0 : streamLength);
+  }
+
   public String getStateString() {
+    nativeCallCount++;
     return flacGetStateString(nativeDecoderContext);
   }
 
   /** Returns whether the decoder has read to the end of the input. */
   public boolean isDecoderAtEndOfInput() {
-    return flacIsDecoderAtEndOfStream(nativeDecoderContext);
+    return getStatus(STATUS_DECODER_AT_END_OF_STREAM) != 0;
   }
 
   public void flush() {
+    nativeCallCount++;
     flacFlush(nativeDecoderContext);
   }
 
@@ -259,13 +379,186 @@ import java.nio.ByteBuffer;
    * @param newPosition Stream's new position.
    */
   public void reset(long newPosition) {
+    nativeCallCount++;
     flacReset(nativeDecoderContext, newPosition);
   }
 
+  /**
+   * Sets the processing that the native decoder applies to decoded samples before they're written
+   * to the output. Must be called after the stream metadata has been decoded.
+   *
+   * @param audioChainConfig The configuration.
+   * @return Whether the configuration is supported for the stream.
+   */
+  public boolean setAudioChainConfig(AudioChainConfig audioChainConfig) {
+    nativeCallCount++;
+    return flacSetAudioChainConfig(
+        nativeDecoderContext,
+        audioChainConfig.getChannelMap(),
+        audioChainConfig.gain,
+        audioChainConfig.speed,
+        audioChainConfig.pitch,
+        audioChainConfig.isSkippingSilence() ? audioChainConfig.minimumSilenceDurationUs : 0,
+        audioChainConfig.paddingSilenceUs,
+        audioChainConfig.getSilenceThreshold(),
+        audioChainConfig.measureLoudness,
+        audioChainConfig.waveformFramesPerPeak,
+        audioChainConfig.spectrumFftSize,
+        audioChainConfig.outputSampleRate,
+        audioChainConfig.outputEncoding);
+  }
+
+  /**
+   * Makes the native decoder output 16-bit samples, requantized with triangular dither, for a
+   * stream with more than 16 bits per sample. Must be called after the stream metadata has been
+   * decoded.
+   *
+   * @param noiseShaping Whether the requantization error is fed back to shape the noise.
+   * @return Whether 16-bit output is supported for the stream.
+   */
+  public boolean setPcm16Output(boolean noiseShaping) {
+    nativeCallCount++;
+    return flacSetPcm16Output(nativeDecoderContext, noiseShaping);
+  }
+
+  /**
+   * Restricts the waveform peaks decoded by {@link #decodeWaveform(float[])} to the frames with
+   * indices in {@code [startFrame, endFrame)}, and discards peaks that haven't been returned. The
+   * audio chain must be reducing to a waveform, and the decoder must be positioned at or before
+   * {@code startFrame}.
+   *
+   * @param startFrame The index of the first frame, which should be a multiple of the frames per
+   *     peak for the peaks to be aligned to the start of the stream.
+   * @param endFrame The index of the frame after the last frame, or {@link Long#MAX_VALUE} to
+   *     decode to the end of the stream.
+   */
+  public void setWaveformRange(long startFrame, long endFrame) {
+    nativeCallCount++;
+    flacSetWaveformRange(nativeDecoderContext, startFrame, endFrame);
+  }
+
+  /**
+   * Decodes frames and reduces them to waveform peaks in native code, until the peaks fill {@code
+   * peaks} or the end of the range set by {@link #setWaveformRange(long, long)} or the stream is
+   * reached. The audio chain must be reducing to a waveform.
+   *
+   * @param peaks The array to write the peaks to, as {@link
+   *     AudioChainConfig#WAVEFORM_VALUES_PER_PEAK} values each.
+   * @return The number of peaks written, which is less than {@code peaks} holds only at the end of
+   *     the range or stream.
+   */
+  public int decodeWaveform(float[] peaks) throws IOException, FlacFrameDecodeException {
+    nativeCallCount++;
+    int peakCount = flacDecodeWaveform(nativeDecoderContext, peaks);
+    if (peakCount < 0) {
+      throw new FlacFrameDecodeException("Cannot decode FLAC frame", peakCount);
+    }
+    return peakCount;
+  }
+
+  /** See {@link FlacDecoder#getSpectrum(float[])}. */
+  public boolean getSpectrum(float[] bands) {
+    synchronized (releaseLock) {
+      return !released && flacGetSpectrum(nativeDecoderContext, bands);
+    }
+  }
+
+  /** See {@link FlacDecoder#getNativeStats()}. */
+  public NativeDecoderStats getNativeStats() {
+    long[] snapshot = new long[NativeDecoderStats.SNAPSHOT_LENGTH];
+    flacGetStats(nativeDecoderContext, snapshot);
+    return new NativeDecoderStats(snapshot);
+  }
+
+  /**
+   * See {@link FlacDecoder#startSessionRecording(String)}. The recording includes the input that
+   * the native decoder reads.
+   */
+  public boolean startSessionRecording(String path) {
+    return flacStartSessionRecording(nativeDecoderContext, path);
+  }
+
+  /** See {@link FlacDecoder#stopSessionRecording()}. */
+  public void stopSessionRecording() {
+    flacStopSessionRecording(nativeDecoderContext);
+  }
+
+  // DecoderCrossfade.NativeMixer implementation. The mixers are independent of the decoder, so
+  // these methods may be called after release().
+
+  @Override
+  public long setCrossfade(long mixer, long durationUs, @DecoderCrossfade.Curve int curve) {
+    nativeCallCount++;
+    return flacSetCrossfade(mixer, durationUs, curve);
+  }
+
+  @Override
+  public int crossfade(
+      long mixer,
+      ByteBuffer data,
+      int offset,
+      int size,
+      int channelCount,
+      int sampleRate,
+      @C.PcmEncoding int encoding) {
+    nativeCallCount++;
+    return flacCrossfade(mixer, data, offset, size, channelCount, sampleRate, encoding);
+  }
+
+  @Override
+  public int getCrossfadeDrainSize(long mixer) {
+    nativeCallCount++;
+    return flacGetCrossfadeDrainSize(mixer);
+  }
+
+  @Override
+  public int drainCrossfade(long mixer, ByteBuffer output, int capacity) {
+    nativeCallCount++;
+    return flacDrainCrossfade(mixer, output, capacity);
+  }
+
+  @Override
+  public void endCrossfadeStream(long mixer) {
+    nativeCallCount++;
+    flacEndCrossfadeStream(mixer);
+  }
+
+  @Override
+  public void flushCrossfade(long mixer) {
+    nativeCallCount++;
+    flacFlushCrossfade(mixer);
+  }
+
+  @Override
+  public void releaseCrossfade(long mixer) {
+    nativeCallCount++;
+    flacReleaseCrossfade(mixer);
+  }
+
   public void release() {
+    synchronized (releaseLock) {
+      released = true;
+    }
     flacRelease(nativeDecoderContext);
   }
 
+  /**
+   * Returns the number of calls that have been made from Java into native code, excluding calls to
+   * {@link #getNativeStats()}, {@link #release()} and the session recording methods.
+   */
+  @VisibleForTesting
+  /* package */ int getNativeCallCount() {
+    return nativeCallCount;
+  }
+
+  /**
+   * Returns a value from the status block. The native decoder publishes its state to the status
+   * block whenever it changes, so reading it doesn't require a JNI call.
+   */
+  private long getStatus(int slot) {
+    return statusBuffer.getLong(slot * 8);
+  }
+
   private int readFromExtractorInput(
       ExtractorInput extractorInput, byte[] tempBuffer, int offset, int length) throws IOException {
     int read = extractorInput.read(tempBuffer, offset, length);
@@ -278,30 +571,75 @@ import java.nio.ByteBuffer;
 
   private native long flacInit();
 
+  private native ByteBuffer flacGetStatusBuffer(long context);
+
   private native FlacStreamMetadata flacDecodeMetadata(long context) throws IOException;
 
   private native int flacDecodeToBuffer(long context, ByteBuffer outputBuffer) throws IOException;
 
   private native int flacDecodeToArray(long context, byte[] outputArray) throws IOException;
 
-  private native long flacGetDecodePosition(long context);
+  private native boolean flacGetSeekPoints(long context, long timeUs, long[] outSeekPoints);
 
-  private native long flacGetLastFrameTimestamp(long context);
+  private native boolean flacSeekAbsolute(long context, long sampleIndex, long streamLength)
+      throws IOException;
 
-  private native long flacGetLastFrameFirstSampleIndex(long context);
+  private native String flacGetStateString(long context);
 
-  private native long flacGetNextFrameFirstSampleIndex(long context);
+  private native void flacFlush(long context);
 
-  private native boolean flacGetSeekPoints(long context, long timeUs, long[] outSeekPoints);
+  private native void flacReset(long context, long newPosition);
 
-  private native String flacGetStateString(long context);
+  private native boolean flacSetAudioChainConfig(
+      long context,
+      @Nullable int[] channelMap,
+      float gain,
+      float speed,
+      float pitch,
+      long minimumSilenceDurationUs,
+      long paddingSilenceUs,
+      float silenceThreshold,
+      boolean measureLoudness,
+      int waveformFramesPerPeak,
+      int spectrumFftSize,
+      int outputSampleRate,
+      @C.PcmEncoding int outputEncoding);
 
-  private native boolean flacIsDecoderAtEndOfStream(long context);
+  private native boolean flacSetPcm16Output(long context, boolean noiseShaping);
 
-  private native void flacFlush(long context);
+  private native void flacSetWaveformRange(long context, long startFrame, long endFrame);
 
-  private native void flacReset(long context, long newPosition);
+  private native int flacDecodeWaveform(long context, float[] peaks) throws IOException;
+
+  private native boolean flacGetSpectrum(long context, float[] bands);
+
+  private native void flacGetStats(long context, long[] stats);
+
+  private native boolean flacStartSessionRecording(long context, String path);
+
+  private native void flacStopSessionRecording(long context);
 
   private native void flacRelease(long context);
 
+  private native long flacSetCrossfade(long mixer, long durationUs, int curve);
+
+  private native int flacCrossfade(
+      long mixer,
+      ByteBuffer data,
+      int offset,
+      int size,
+      int channelCount,
+      int sampleRate,
+      @C.PcmEncoding int encoding);
+
+  private native int flacGetCrossfadeDrainSize(long mixer);
+
+  private native int flacDrainCrossfade(long mixer, ByteBuffer output, int capacity);
+
+  private native void flacEndCrossfadeStream(long mixer);
+
+  private native void flacFlushCrossfade(long mixer);
+
+  private native void flacReleaseCrossfade(long mixer);
+
 }
@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.google.android.exoplayer2.ext.flac;
+
+import static java.lang.Math.max;
+
+import android.net.Uri;
+import androidx.annotation.Nullable;
+import com.google.android.exoplayer2.C;
+import com.google.android.exoplayer2.audio.AudioChainConfig;
+import com.google.android.exoplayer2.extractor.FlacStreamMetadata;
+import com.google.android.exoplayer2.extractor.SeekMap;
+import com.google.android.exoplayer2.upstream.DataSource;
+import com.google.android.exoplayer2.upstream.DataSpec;
+import com.google.android.exoplayer2.util.Assertions;
+import com.google.android.exoplayer2.util.Util;
+import java.io.IOException;
+import java.util.ArrayList;
+import java.util.Arrays;
+import java.util.List;
+import java.util.concurrent.ExecutionException;
+import java.util.concurrent.ExecutorService;
+import java.util.concurrent.Future;
+
+/**
+ * Generates the waveform of a FLAC stream, as drawn by waveform views and scrub bars, by decoding
+ * it and reducing the decoded audio to the minimum, maximum and RMS of each run of frames in
+ * native code. The decoded audio is never returned to Java.
+ *
+ * <p>Streams with a known number of samples, and a seek table or a known length in bytes, are split
+ * into segments that are decoded in parallel, each with its own decoder and {@link DataSource}.
+ * Each segment's decoder seeks to its first frame in native code, with {@link
+ * FlacDecoderJni#seekToSample(long, long)}. Other streams are decoded in a single segment.
+ */
+public final class FlacWaveformGenerator {
+
+  private static final int PEAKS_PER_DECODE = 1024;
+
+  private final DataSource.Factory dataSourceFactory;
+  private final ExecutorService executorService;
+  private final int maxSegmentCount;
+
+  /**
+   * Creates a generator.
+   *
+   * @param dataSourceFactory Creates the data sources that streams are read from.
+   * @param executorService The executor that segments are decoded on.
+   * @param maxSegmentCount The maximum number of segments that are decoded in parallel.
+   */
+  public FlacWaveformGenerator(
+      DataSource.Factory dataSourceFactory, ExecutorService executorService, int maxSegmentCount) {
+    Assertions.checkArgument(maxSegmentCount > 0);
+    this.dataSourceFactory = dataSourceFactory;
+    this.executorService = executorService;
+    this.maxSegmentCount = maxSegmentCount;
+  }
+
+  /**
+   * Generates the waveform of the stream at {@code uri}. Blocks until it's generated.
+   *
+   * @param uri The URI of the stream.
+   * @param framesPerPeak The number of frames per peak.
+   * @return The peaks, as {@link AudioChainConfig#WAVEFORM_VALUES_PER_PEAK} values each: the
+   *     minimum sample, the maximum sample and the RMS of the samples of all channels in each run
+   *     of {@code framesPerPeak} frames from the start of the stream.
+   * @throws IOException If the stream couldn't be read.
+   * @throws FlacDecoderException If the stream couldn't be decoded.
+   * @throws InterruptedException If the thread was interrupted while waiting for the segments.
+   */
+  public float[] generate(Uri uri, int framesPerPeak)
+      throws IOException, FlacDecoderException, InterruptedException {
+    Assertions.checkArgument(framesPerPeak > 0);
+    long[] segmentStartFrames = getSegmentStartFrames(uri, framesPerPeak);
+    List<Future<float[]>> segments = new ArrayList<>();
+    for (int i = 0; i < segmentStartFrames.length; i++) {
+      long startFrame = segmentStartFrames[i];
+      long endFrame =
+          i + 1 < segmentStartFrames.length ? segmentStartFrames[i + 1] : C.LENGTH_UNSET;
+      segments.add(
+          executorService.submit(() -> decodeSegment(uri, framesPerPeak, startFrame, endFrame)));
+    }
+    float[][] segmentPeaks = new float[segments.size()][];
+    int valueCount = 0;
+    try {
+      for (int i = 0; i < segments.size(); i++) {
+        segmentPeaks[i] = segments.get(i).get();
+        valueCount += segmentPeaks[i].length;
+      }
+    } catch (ExecutionException e) {
+      Throwable cause = e.getCause();
+      if (cause instanceof IOException) {
+        throw (IOException) cause;
+      } else if (cause instanceof FlacDecoderException) {
+        throw (FlacDecoderException) cause;
+      }
+      throw new IllegalStateException(cause);
+    } finally {
+      for (Future<float[]> segment : segments) {
+        segment.cancel(/* mayInterruptIfRunning= */ false);
+      }
+    }
+    float[] peaks = new float[valueCount];
+    int offset = 0;
+    for (float[] segment : segmentPeaks) {
+      System.arraycopy(segment, 0, peaks, offset, segment.length);
+      offset += segment.length;
+    }
+    return peaks;
+  }
+
+  /**
+   * Reads the stream's metadata and returns the first frame of each segment. Segments have the
+   * same length, which is a multiple of {@code framesPerPeak}, so that the segments' peaks can be
+   * concatenated.
+   */
+  private long[] getSegmentStartFrames(Uri uri, int framesPerPeak)
+      throws IOException, FlacDecoderException {
+    FlacDecoderJni decoderJni = new FlacDecoderJni();
+    DataSource dataSource = dataSourceFactory.createDataSource();
+    try {
+      long length = openData(decoderJni, dataSource, uri);
+      FlacStreamMetadata streamMetadata = decoderJni.decodeStreamMetadata();
+      // Without a seek table or a length, libFLAC has no upper bound to bisect the stream with.
+      boolean seekable =
+          length != C.LENGTH_UNSET || decoderJni.getSeekPoints(/* timeUs= */ 0) != null;
+      if (!seekable || streamMetadata.totalSamples <= 0 || maxSegmentCount == 1) {
+        return new long[] {0};
+      }
+      long peakCount = Util.ceilDivide(streamMetadata.totalSamples, framesPerPeak);
+      // Segments that are shorter than a block would mostly decode the same frames.
+      long segmentPeakCount =
+          max(
+              Util.ceilDivide(peakCount, maxSegmentCount),
+              Util.ceilDivide(streamMetadata.maxBlockSizeSamples, framesPerPeak));
+      long segmentFrames = segmentPeakCount * framesPerPeak;
+      int segmentCount = (int) Util.ceilDivide(streamMetadata.totalSamples, segmentFrames);
+      long[] startFrames = new long[segmentCount];
+      for (int i = 0; i < segmentCount; i++) {
+        startFrames[i] = i * segmentFrames;
+      }
+      return startFrames;
+    } finally {
+      decoderJni.release();
+      Util.closeQuietly(dataSource);
+    }
+  }
+
+  /**
+   * Decodes the frames with indices in {@code [startFrame, endFrame)}, or from {@code startFrame}
+   * to the end of the stream if {@code endFrame} is {@link C#LENGTH_UNSET}, and returns their
+   * peaks.
+   */
+  private float[] decodeSegment(Uri uri, int framesPerPeak, long startFrame, long endFrame)
+      throws IOException, FlacDecoderException {
+    FlacDecoderJni decoderJni = new FlacDecoderJni();
+    DataSource dataSource = dataSourceFactory.createDataSource();
+    try {
+      long length = openData(decoderJni, dataSource, uri);
+      FlacStreamMetadata streamMetadata = decoderJni.decodeStreamMetadata();
+      if (!decoderJni.setAudioChainConfig(
+          new AudioChainConfig.Builder().setWaveformFramesPerPeak(framesPerPeak).build())) {
+        throw new FlacDecoderException("Unsupported stream for waveform generation");
+      }
+      if (startFrame > 0 && !decoderJni.seekToSample(startFrame, length)) {
+        // Continue from the seek point at or before the segment's first frame instead. The frames
+        // before it are decoded, but not reduced.
+        @Nullable
+        SeekMap.SeekPoints seekPoints =
+            decoderJni.getSeekPoints(startFrame * C.MICROS_PER_SECOND / streamMetadata.sampleRate);
+        if (seekPoints == null) {
+          throw new FlacDecoderException("Failed to seek to segment at frame " + startFrame);
+        }
+        decoderJni.reset(seekPoints.first.position);
+      }
+      decoderJni.setWaveformRange(
+          startFrame, endFrame == C.LENGTH_UNSET ? Long.MAX_VALUE : endFrame);
+      float[] buffer = new float[PEAKS_PER_DECODE * AudioChainConfig.WAVEFORM_VALUES_PER_PEAK];
+      float[] peaks = new float[0];
+      int valueCount = 0;
+      int peakCount;
+      do {
+        peakCount = decoderJni.decodeWaveform(buffer);
+        int decodedValueCount = peakCount * AudioChainConfig.WAVEFORM_VALUES_PER_PEAK;
+        if (valueCount + decodedValueCount > peaks.length) {
+          peaks = Arrays.copyOf(peaks, max(peaks.length * 2, valueCount + decodedValueCount));
+        }
+        System.arraycopy(buffer, 0, peaks, valueCount, decodedValueCount);
+        valueCount += decodedValueCount;
+      } while (peakCount == PEAKS_PER_DECODE);
+      return Arrays.copyOf(peaks, valueCount);
+    } catch (FlacDecoderJni.FlacFrameDecodeException e) {
+      throw new FlacDecoderException("Frame decoding failed", e);
+    } finally {
+      decoderJni.release();
+      Util.closeQuietly(dataSource);
+    }
+  }
+
+  /**
+   * Opens {@code dataSource} and sets it as the data of {@code decoderJni}, which reopens it at the
+   * positions it reads from. Returns the length of the stream, or {@link C#LENGTH_UNSET} if it's
+   * unknown.
+   */
+  private static long openData(FlacDecoderJni decoderJni, DataSource dataSource, Uri uri)
+      throws IOException {
+    DataSpec dataSpec = new DataSpec(uri);
+    long length = dataSource.open(dataSpec);
+    decoderJni.setData(dataSource, dataSpec);
+    return length;
+  }
+}
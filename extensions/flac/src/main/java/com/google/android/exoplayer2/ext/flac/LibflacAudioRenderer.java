@@ -18,13 +18,19 @@ package com.google.android.exoplayer2.ext.flac;
 import android.os.Handler;
 import androidx.annotation.Nullable;
 import com.google.android.exoplayer2.C;
+import com.google.android.exoplayer2.ExoPlaybackException;
 import com.google.android.exoplayer2.Format;
+import com.google.android.exoplayer2.audio.AudioChainConfig;
 import com.google.android.exoplayer2.audio.AudioProcessor;
 import com.google.android.exoplayer2.audio.AudioRendererEventListener;
 import com.google.android.exoplayer2.audio.AudioSink;
 import com.google.android.exoplayer2.audio.DecoderAudioRenderer;
+import com.google.android.exoplayer2.audio.DecoderCrossfade;
+import com.google.android.exoplayer2.decoder.DecoderPrewarmer;
+import com.google.android.exoplayer2.decoder.DecoderReuseEvaluation;
 import com.google.android.exoplayer2.drm.ExoMediaCrypto;
 import com.google.android.exoplayer2.extractor.FlacStreamMetadata;
+import com.google.android.exoplayer2.util.Assertions;
 import com.google.android.exoplayer2.util.FlacConstants;
 import com.google.android.exoplayer2.util.MimeTypes;
 import com.google.android.exoplayer2.util.TraceUtil;
@@ -36,6 +42,17 @@ public final class LibflacAudioRenderer extends DecoderAudioRenderer<FlacDecoder
   private static final String TAG = "LibflacAudioRenderer";
   private static final int NUM_BUFFERS = 16;
 
+  private final DecoderPrewarmer<FlacDecoder> decoderPrewarmer = new DecoderPrewarmer<>();
+
+  @Nullable private volatile AudioChainConfig audioChainConfig;
+  private volatile boolean pcm16Output;
+  private volatile boolean noiseShaping;
+  private volatile int crossfadeDurationMs;
+  @DecoderCrossfade.Curve private volatile int crossfadeCurve;
+  @Nullable private volatile FlacDecoder currentDecoder;
+  private boolean streamChanged;
+  private boolean crossfadeIntoNextDecoder;
+
   public LibflacAudioRenderer() {
     this(/* eventHandler= */ null, /* eventListener= */ null);
   }
@@ -78,6 +95,73 @@ public final class LibflacAudioRenderer extends DecoderAudioRenderer<FlacDecoder
     return TAG;
   }
 
+  /**
+   * Creates a decoder for {@code format} on a background thread, so that the decoder is ready when
+   * playback starts. The decoder is used if the renderer's next decoder is for a compatible format,
+   * and is released otherwise, or when the renderer is reset. May be called from any thread.
+   *
+   * @param format The anticipated format.
+   */
+  public void prewarmDecoder(Format format) {
+    decoderPrewarmer.prewarm(format, LibflacAudioRenderer::newDecoder);
+  }
+
+  /**
+   * Sets the processing that the native decoder applies to its output before it's passed to the
+   * audio sink, replacing the equivalent {@link AudioProcessor AudioProcessors}. Applies to
+   * decoders created after the call. The gain in each format's loudness tags is applied as
+   * described by {@link AudioChainConfig#forMetadata}.
+   *
+   * @param audioChainConfig The configuration, or null to output the decoded samples unchanged.
+   */
+  public void setAudioChainConfig(@Nullable AudioChainConfig audioChainConfig) {
+    this.audioChainConfig = audioChainConfig;
+  }
+
+  /**
+   * Sets whether streams with more than 16 bits per sample are output as 16-bit samples, which
+   * are requantized with triangular (TPDF) dither in native code, for audio sinks and devices that
+   * don't support higher bit depths. Doesn't apply to decoders with an {@link AudioChainConfig},
+   * which has its own output encoding. Applies to decoders created after the call.
+   *
+   * @param pcm16Output Whether to output 16-bit samples.
+   * @param noiseShaping Whether to shape the requantization noise towards high frequencies.
+   */
+  public void setPcm16Output(boolean pcm16Output, boolean noiseShaping) {
+    this.pcm16Output = pcm16Output;
+    this.noiseShaping = noiseShaping;
+  }
+
+  /**
+   * Sets the duration of the {@link DecoderCrossfade crossfades} that the native decoders mix
+   * between consecutive streams, or 0 to play them one after the other. Applies to decoders created
+   * after the call. Streams are crossfaded if they have the same channel count, sample rate and
+   * bits per sample, which isn't 8.
+   *
+   * @param crossfadeDurationMs The duration of the crossfades, in milliseconds, or 0.
+   * @param crossfadeCurve The shape of the crossfades.
+   */
+  public void setCrossfade(int crossfadeDurationMs, @DecoderCrossfade.Curve int crossfadeCurve) {
+    Assertions.checkArgument(crossfadeDurationMs >= 0);
+    this.crossfadeCurve = crossfadeCurve;
+    this.crossfadeDurationMs = crossfadeDurationMs;
+  }
+
+  /**
+   * Computes the levels of the frequency bands of the audio most recently decoded by the renderer's
+   * current decoder. See {@link FlacDecoder#getSpectrum(float[])}. May be called from any thread,
+   * for example once per display frame by a visualizer, including while the renderer replaces or
+   * releases its decoder.
+   *
+   * @param bands The array to write the level of each band to.
+   * @return Whether the levels were written, which they aren't if the renderer has no decoder or
+   *     the decoder didn't write them.
+   */
+  public boolean getSpectrum(float[] bands) {
+    @Nullable FlacDecoder currentDecoder = this.currentDecoder;
+    return currentDecoder != null && currentDecoder.getSpectrum(bands);
+  }
+
   @Override
   @C.FormatSupport
   protected int supportsFormatInternal(Format format) {
@@ -95,11 +179,12 @@ public final class LibflacAudioRenderer extends DecoderAudioRenderer<FlacDecoder
       outputFormat =
           Util.getPcmFormat(C.ENCODING_PCM_16BIT, format.channelCount, format.sampleRate);
     } else {
-      int streamMetadataOffset =
-          FlacConstants.STREAM_MARKER_SIZE + FlacConstants.METADATA_BLOCK_HEADER_SIZE;
-      FlacStreamMetadata streamMetadata =
-          new FlacStreamMetadata(format.initializationData.get(0), streamMetadataOffset);
-      outputFormat = getOutputFormat(streamMetadata);
+      FlacStreamMetadata streamMetadata = getStreamMetadata(format);
+      outputFormat =
+          pcm16Output && audioChainConfig == null && streamMetadata.bitsPerSample > 16
+              ? Util.getPcmFormat(
+                  C.ENCODING_PCM_16BIT, streamMetadata.channels, streamMetadata.sampleRate)
+              : FlacDecoder.getOutputFormat(streamMetadata, /* audioChainConfig= */ null);
     }
     if (!sinkSupportsFormat(outputFormat)) {
       return C.FORMAT_UNSUPPORTED_SUBTYPE;
@@ -114,21 +199,109 @@ public final class LibflacAudioRenderer extends DecoderAudioRenderer<FlacDecoder
   protected FlacDecoder createDecoder(Format format, @Nullable ExoMediaCrypto mediaCrypto)
       throws FlacDecoderException {
     TraceUtil.beginSection("createFlacDecoder");
-    FlacDecoder decoder =
-        new FlacDecoder(NUM_BUFFERS, NUM_BUFFERS, format.maxInputSize, format.initializationData);
+    @Nullable FlacDecoder decoder = decoderPrewarmer.takeDecoder(format);
+    if (decoder == null) {
+      decoder = newDecoder(format);
+    }
+    try {
+      @Nullable AudioChainConfig audioChainConfig = this.audioChainConfig;
+      if (audioChainConfig != null) {
+        decoder.setAudioChainConfig(audioChainConfig.forMetadata(format.metadata));
+      } else if (pcm16Output) {
+        decoder.setPcm16Output(noiseShaping);
+      }
+      // The previous decoder holds the end of its stream if it's crossfaded into this one.
+      @Nullable FlacDecoder previousDecoder = currentDecoder;
+      int crossfadeDurationMs = this.crossfadeDurationMs;
+      if (crossfadeDurationMs > 0) {
+        decoder.setCrossfade(
+            crossfadeDurationMs * 1000L,
+            crossfadeCurve,
+            crossfadeIntoNextDecoder ? previousDecoder : null);
+      }
+      if (previousDecoder != null) {
+        previousDecoder.releaseCrossfade();
+      }
+    } catch (FlacDecoderException e) {
+      decoder.release();
+      throw e;
+    }
+    currentDecoder = decoder;
+    streamChanged = false;
+    crossfadeIntoNextDecoder = false;
     TraceUtil.endSection();
     return decoder;
   }
 
+  @Override
+  protected void onReset() {
+    super.onReset();
+    decoderPrewarmer.release();
+  }
+
+  @Override
+  protected void onStreamChanged(Format[] formats, long startPositionUs, long offsetUs)
+      throws ExoPlaybackException {
+    super.onStreamChanged(formats, startPositionUs, offsetUs);
+    streamChanged = true;
+  }
+
+  @Override
+  protected DecoderReuseEvaluation canReuseDecoder(
+      String decoderName, Format oldFormat, Format newFormat) {
+    @Nullable FlacDecoder currentDecoder = this.currentDecoder;
+    if (streamChanged
+        && currentDecoder != null
+        && crossfadeDurationMs > 0
+        && oldFormat.channelCount == newFormat.channelCount
+        && oldFormat.sampleRate == newFormat.sampleRate
+        && !newFormat.initializationData.isEmpty()
+        && getStreamMetadata(newFormat).bitsPerSample
+            == currentDecoder.getStreamMetadata().bitsPerSample) {
+      // The decoder is released at the end of its stream, and the end of its output is mixed into
+      // the start of the next decoder's.
+      currentDecoder.crossfadeIntoNextStream();
+      crossfadeIntoNextDecoder = true;
+    }
+    streamChanged = false;
+    return super.canReuseDecoder(decoderName, oldFormat, newFormat);
+  }
+
+  @Override
+  protected void onPositionReset(long positionUs, boolean joining) throws ExoPlaybackException {
+    // A stream isn't crossfaded into the stream that plays after a seek.
+    crossfadeIntoNextDecoder = false;
+    super.onPositionReset(positionUs, joining);
+  }
+
+  @Override
+  protected void onDisabled() {
+    @Nullable FlacDecoder currentDecoder = this.currentDecoder;
+    this.currentDecoder = null;
+    super.onDisabled();
+    if (currentDecoder != null) {
+      currentDecoder.releaseCrossfade();
+    }
+  }
+
   @Override
   protected Format getOutputFormat(FlacDecoder decoder) {
-    return getOutputFormat(decoder.getStreamMetadata());
+    return decoder.getOutputFormat();
+  }
+
+  @Override
+  protected float getOutputSpeed(FlacDecoder decoder) {
+    return decoder.getOutputSpeed();
+  }
+
+  private static FlacStreamMetadata getStreamMetadata(Format format) {
+    int streamMetadataOffset =
+        FlacConstants.STREAM_MARKER_SIZE + FlacConstants.METADATA_BLOCK_HEADER_SIZE;
+    return new FlacStreamMetadata(format.initializationData.get(0), streamMetadataOffset);
   }
 
-  private static Format getOutputFormat(FlacStreamMetadata streamMetadata) {
-    return Util.getPcmFormat(
-        Util.getPcmEncoding(streamMetadata.bitsPerSample),
-        streamMetadata.channels,
-        streamMetadata.sampleRate);
+  private static FlacDecoder newDecoder(Format format) throws FlacDecoderException {
+    return new FlacDecoder(
+        NUM_BUFFERS, NUM_BUFFERS, format.maxInputSize, format.initializationData);
   }
 }
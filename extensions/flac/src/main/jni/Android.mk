@@ -16,6 +16,9 @@
 
 WORKING_DIR := $(call my-dir)
 
+# build libexoplayerjnicommon.a
+include $(WORKING_DIR)/../../../../jni_common/jni_common.mk
+
 # build libflacJNI.so
 include $(CLEAR_VARS)
 include $(WORKING_DIR)/flac_sources.mk
@@ -35,4 +38,5 @@ LOCAL_CFLAGS += -D_REENTRANT -DPIC -DU_COMMON_IMPLEMENTATION -fPIC -DHAVE_SYS_PA
 LOCAL_CFLAGS += -O3 -funroll-loops -finline-functions -DFLAC__NO_ASM '-DFLAC__HAS_OGG=0'
 
 LOCAL_LDLIBS := -llog -lz -lm
+LOCAL_STATIC_LIBRARIES := exoplayerjnicommon
 include $(BUILD_SHARED_LIBRARY)
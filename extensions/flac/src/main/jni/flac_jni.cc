@@ -17,11 +17,20 @@
 #include <android/log.h>
 #include <jni.h>
 
+#include <algorithm>
 #include <array>
 #include <cstdlib>
 #include <cstring>
+#include <vector>
 
+#include "audio_chain_jni.h"    // NOLINT
+#include "cpu_dispatch.h"       // NOLINT
+#include "decoder_stats_jni.h"  // NOLINT
 #include "include/flac_parser.h"
+#include "jni_registration.h"   // NOLINT
+#include "profile.h"            // NOLINT
+#include "session_recorder.h"   // NOLINT
+#include "status_block.h"       // NOLINT
 
 #define LOG_TAG "flac_jni"
 #define ALOGE(...) \
@@ -31,52 +40,150 @@
 
 #define DECODER_FUNC(RETURN_TYPE, NAME, ...)                               \
   extern "C" {                                                             \
-  JNIEXPORT RETURN_TYPE                                                    \
+  EXOPLAYER_JNI_EXPORT RETURN_TYPE                                         \
       Java_com_google_android_exoplayer2_ext_flac_FlacDecoderJni_##NAME( \
           JNIEnv *env, jobject thiz, ##__VA_ARGS__);                       \
   }                                                                        \
-  JNIEXPORT RETURN_TYPE                                                    \
+  EXOPLAYER_JNI_EXPORT RETURN_TYPE                                         \
       Java_com_google_android_exoplayer2_ext_flac_FlacDecoderJni_##NAME( \
           JNIEnv *env, jobject thiz, ##__VA_ARGS__)
 
+// JNI references, which are looked up once when the library is loaded rather
+// than each time a stream's metadata is decoded.
+static jmethodID readMethod;
+static jclass arrayListClass;
+static jmethodID arrayListConstructor;
+static jmethodID arrayListAddMethod;
+static jclass pictureFrameClass;
+static jmethodID pictureFrameConstructor;
+static jclass flacStreamMetadataClass;
+static jmethodID flacStreamMetadataConstructor;
+
+static bool initJniReferences(JNIEnv *env);
+static bool registerNativeMethods(JNIEnv *env);
+
+EXOPLAYER_JNI_ONLOAD(FlacOnLoad) {
+  JNIEnv *env;
+  if (vm->GetEnv(reinterpret_cast<void **>(&env), JNI_VERSION_1_6) != JNI_OK) {
+    return -1;
+  }
+  if (!initJniReferences(env) || !registerNativeMethods(env)) {
+    return -1;
+  }
+  exoplayer_jni::InitCpuDispatch();
+  return JNI_VERSION_1_6;
+}
+
+// Slots of the status block that is shared with FlacDecoderJni.
+// LINT.IfChange
+enum StatusSlot {
+  kStatusDecodePosition = 0,
+  kStatusLastFrameTimestamp = 1,
+  kStatusLastFrameFirstSampleIndex = 2,
+  kStatusNextFrameFirstSampleIndex = 3,
+  kStatusDecoderAtEndOfStream = 4,
+  kStatusSkippedSilenceFrameCount = 5,
+  kStatusIntegratedLoudness = 6,
+  kStatusSlotCount = 7
+};
+// LINT.ThenChange(../java/com/google/android/exoplayer2/ext/flac/FlacDecoderJni.java)
+
 class JavaDataSource : public DataSource {
  public:
+  JavaDataSource(exoplayer_jni::DecoderStats *stats,
+                 exoplayer_jni::SessionRecorder *recorder)
+      : stats(stats), recorder(recorder) {}
+
   void setFlacDecoderJni(JNIEnv *env, jobject flacDecoderJni) {
     this->env = env;
     this->flacDecoderJni = flacDecoderJni;
-    if (mid == NULL) {
-      jclass cls = env->GetObjectClass(flacDecoderJni);
-      mid = env->GetMethodID(cls, "read", "(Ljava/nio/ByteBuffer;)I");
-      env->DeleteLocalRef(cls);
-    }
   }
 
   ssize_t readAt(off64_t offset, void *const data, size_t size) {
+    exoplayer_jni::ScopedSessionRecord record(
+        recorder, exoplayer_jni::session_format::kRecordRead);
     jobject byteBuffer = env->NewDirectByteBuffer(data, size);
-    int result = env->CallIntMethod(flacDecoderJni, mid, byteBuffer);
+    int result;
+    {
+      exoplayer_jni::ScopedUpcallTimer upcallTimer(stats);
+      result = env->CallIntMethod(flacDecoderJni, readMethod, byteBuffer,
+                                  static_cast<jlong>(offset));
+    }
     if (env->ExceptionCheck()) {
       // Exception is thrown in Java when returning from the native call.
       result = -1;
     }
     env->DeleteLocalRef(byteBuffer);
+    if (result > 0) {
+      stats->Increment(exoplayer_jni::DecoderStats::kInputByteCount, result);
+      record.set_data(static_cast<const uint8_t *>(data), result);
+    }
+    record.set_result(result);
     return result;
   }
 
  private:
   JNIEnv *env;
   jobject flacDecoderJni;
-  jmethodID mid;
+  exoplayer_jni::DecoderStats *const stats;
+  exoplayer_jni::SessionRecorder *const recorder;
 };
 
 struct Context {
+  exoplayer_jni::DecoderStats stats;
+  exoplayer_jni::SessionRecorder recorder;
+  exoplayer_jni::StatusBlock<kStatusSlotCount> status;
+  exoplayer_jni::AudioChain audioChain;
+  // Waveform peaks that have been decoded but not yet copied to Java.
+  std::vector<float> waveformPeaks;
   JavaDataSource *source;
   FLACParser *parser;
 
-  Context() {
-    source = new JavaDataSource();
+  Context() : recorder(exoplayer_jni::session_format::kCodecFlac) {
+    source = new JavaDataSource(&stats, &recorder);
     parser = new FLACParser(source);
   }
 
+  // Decodes a frame into outputBuffer, recording stats.
+  int decodeFrame(void *outputBuffer, size_t outputSize) {
+    exoplayer_jni::ScopedSessionRecord record(
+        &recorder, exoplayer_jni::session_format::kRecordDecode);
+    stats.Increment(exoplayer_jni::DecoderStats::kInputBufferCount);
+    const int64_t startTimeUs = exoplayer_jni::GetMonotonicTimeUs();
+    const int count = parser->readBuffer(outputBuffer, outputSize);
+    stats.RecordLatency(exoplayer_jni::DecoderStats::kDecodeTime,
+                        exoplayer_jni::GetMonotonicTimeUs() - startTimeUs);
+    if (count >= 0) {
+      stats.Increment(exoplayer_jni::DecoderStats::kOutputBufferCount);
+      stats.Increment(exoplayer_jni::DecoderStats::kOutputByteCount, count);
+    } else if (!parser->isDecoderAtEndOfStream()) {
+      stats.Increment(exoplayer_jni::DecoderStats::kDecodeErrorCount);
+    }
+    // The audio chain is only used for frames that produce output.
+    status.Set(kStatusSkippedSilenceFrameCount,
+               count > 0 ? audioChain.skipped_frame_count() : 0);
+    status.Set(kStatusIntegratedLoudness,
+               exoplayer_jni::GetLoudnessStatus(audioChain));
+    publishStatus();
+    record.set_result(count);
+    return count;
+  }
+
+  // Publishes the parser's current state to the status block. Must be called
+  // whenever the parser's position may have changed.
+  void publishStatus() {
+    status.Set(kStatusDecodePosition, parser->getDecodePosition());
+    // The timestamp can't be computed until the sample rate is known.
+    status.Set(kStatusLastFrameTimestamp,
+               parser->getSampleRate() == 0 ? 0
+                                            : parser->getLastFrameTimestamp());
+    status.Set(kStatusLastFrameFirstSampleIndex,
+               parser->getLastFrameFirstSampleIndex());
+    status.Set(kStatusNextFrameFirstSampleIndex,
+               parser->getNextFrameFirstSampleIndex());
+    status.Set(kStatusDecoderAtEndOfStream, parser->isDecoderAtEndOfStream());
+  }
+
   ~Context() {
     delete parser;
     delete source;
@@ -89,22 +196,25 @@ DECODER_FUNC(jlong, flacInit) {
     delete context;
     return 0;
   }
+  context->publishStatus();
   return reinterpret_cast<intptr_t>(context);
 }
 
+DECODER_FUNC(jobject, flacGetStatusBuffer, jlong jContext) {
+  Context *context = reinterpret_cast<Context *>(jContext);
+  return context->status.NewByteBuffer(env);
+}
+
 DECODER_FUNC(jobject, flacDecodeMetadata, jlong jContext) {
   Context *context = reinterpret_cast<Context *>(jContext);
   context->source->setFlacDecoderJni(env, thiz);
-  if (!context->parser->decodeMetadata()) {
+  bool metadataDecoded = context->parser->decodeMetadata();
+  context->publishStatus();
+  if (!metadataDecoded) {
     return NULL;
   }
 
-  jclass arrayListClass = env->FindClass("java/util/ArrayList");
-  jmethodID arrayListConstructor =
-      env->GetMethodID(arrayListClass, "<init>", "()V");
   jobject commentList = env->NewObject(arrayListClass, arrayListConstructor);
-  jmethodID arrayListAddMethod =
-      env->GetMethodID(arrayListClass, "add", "(Ljava/lang/Object;)Z");
 
   if (context->parser->areVorbisCommentsValid()) {
     std::vector<std::string> vorbisComments =
@@ -122,11 +232,6 @@ DECODER_FUNC(jobject, flacDecodeMetadata, jlong jContext) {
   bool picturesValid = context->parser->arePicturesValid();
   if (picturesValid) {
     std::vector<FlacPicture> pictures = context->parser->getPictures();
-    jclass pictureFrameClass = env->FindClass(
-        "com/google/android/exoplayer2/metadata/flac/PictureFrame");
-    jmethodID pictureFrameConstructor =
-        env->GetMethodID(pictureFrameClass, "<init>",
-                         "(ILjava/lang/String;Ljava/lang/String;IIII[B)V");
     for (std::vector<FlacPicture>::const_iterator picture = pictures.begin();
          picture != pictures.end(); ++picture) {
       jstring mimeType = env->NewStringUTF(picture->mimeType.c_str());
@@ -148,13 +253,6 @@ DECODER_FUNC(jobject, flacDecodeMetadata, jlong jContext) {
   const FLAC__StreamMetadata_StreamInfo &streamInfo =
       context->parser->getStreamInfo();
 
-  jclass flacStreamMetadataClass = env->FindClass(
-      "com/google/android/exoplayer2/extractor/"
-      "FlacStreamMetadata");
-  jmethodID flacStreamMetadataConstructor =
-      env->GetMethodID(flacStreamMetadataClass, "<init>",
-                       "(IIIIIIIJLjava/util/ArrayList;Ljava/util/ArrayList;)V");
-
   return env->NewObject(flacStreamMetadataClass, flacStreamMetadataConstructor,
                         streamInfo.min_blocksize, streamInfo.max_blocksize,
                         streamInfo.min_framesize, streamInfo.max_framesize,
@@ -165,75 +263,324 @@ DECODER_FUNC(jobject, flacDecodeMetadata, jlong jContext) {
 
 DECODER_FUNC(jint, flacDecodeToBuffer, jlong jContext, jobject jOutputBuffer) {
   Context *context = reinterpret_cast<Context *>(jContext);
+  exoplayer_jni::ScopedNativeCallTimer callTimer(&context->stats);
   context->source->setFlacDecoderJni(env, thiz);
   void *outputBuffer = env->GetDirectBufferAddress(jOutputBuffer);
   jint outputSize = env->GetDirectBufferCapacity(jOutputBuffer);
-  return context->parser->readBuffer(outputBuffer, outputSize);
+  return context->decodeFrame(outputBuffer, outputSize);
 }
 
 DECODER_FUNC(jint, flacDecodeToArray, jlong jContext, jbyteArray jOutputArray) {
   Context *context = reinterpret_cast<Context *>(jContext);
+  exoplayer_jni::ScopedNativeCallTimer callTimer(&context->stats);
   context->source->setFlacDecoderJni(env, thiz);
   jbyte *outputBuffer = env->GetByteArrayElements(jOutputArray, NULL);
   jint outputSize = env->GetArrayLength(jOutputArray);
-  int count = context->parser->readBuffer(outputBuffer, outputSize);
+  int count = context->decodeFrame(outputBuffer, outputSize);
   env->ReleaseByteArrayElements(jOutputArray, outputBuffer, 0);
   return count;
 }
 
-DECODER_FUNC(jlong, flacGetDecodePosition, jlong jContext) {
+DECODER_FUNC(jboolean, flacGetSeekPoints, jlong jContext, jlong timeUs,
+             jlongArray outSeekPoints) {
   Context *context = reinterpret_cast<Context *>(jContext);
-  return context->parser->getDecodePosition();
+  std::array<int64_t, 4> result;
+  bool success = context->parser->getSeekPositions(timeUs, result);
+  if (success) {
+    env->SetLongArrayRegion(outSeekPoints, 0, result.size(), result.data());
+  }
+  return success;
 }
 
-DECODER_FUNC(jlong, flacGetLastFrameTimestamp, jlong jContext) {
+DECODER_FUNC(jboolean, flacSeekAbsolute, jlong jContext, jlong sampleIndex,
+             jlong streamLength) {
   Context *context = reinterpret_cast<Context *>(jContext);
-  return context->parser->getLastFrameTimestamp();
+  exoplayer_jni::ScopedNativeCallTimer callTimer(&context->stats);
+  context->source->setFlacDecoderJni(env, thiz);
+  const bool success = context->parser->seekAbsolute(sampleIndex, streamLength);
+  context->publishStatus();
+  return success;
+}
+
+DECODER_FUNC(jstring, flacGetStateString, jlong jContext) {
+  Context *context = reinterpret_cast<Context *>(jContext);
+  const char *str = context->parser->getDecoderStateString();
+  return env->NewStringUTF(str);
 }
 
-DECODER_FUNC(jlong, flacGetLastFrameFirstSampleIndex, jlong jContext) {
+DECODER_FUNC(void, flacFlush, jlong jContext) {
   Context *context = reinterpret_cast<Context *>(jContext);
-  return context->parser->getLastFrameFirstSampleIndex();
+  exoplayer_jni::ScopedNativeCallTimer callTimer(&context->stats);
+  exoplayer_jni::ScopedSessionRecord record(
+      &context->recorder, exoplayer_jni::session_format::kRecordFlush);
+  context->parser->flush();
+  context->publishStatus();
 }
 
-DECODER_FUNC(jlong, flacGetNextFrameFirstSampleIndex, jlong jContext) {
+DECODER_FUNC(void, flacReset, jlong jContext, jlong newPosition) {
   Context *context = reinterpret_cast<Context *>(jContext);
-  return context->parser->getNextFrameFirstSampleIndex();
+  exoplayer_jni::ScopedNativeCallTimer callTimer(&context->stats);
+  exoplayer_jni::ScopedSessionRecord record(
+      &context->recorder, exoplayer_jni::session_format::kRecordReset);
+  record.set_argument(newPosition);
+  context->parser->reset(newPosition);
+  context->publishStatus();
 }
 
-DECODER_FUNC(jboolean, flacGetSeekPoints, jlong jContext, jlong timeUs,
-             jlongArray outSeekPoints) {
+DECODER_FUNC(jboolean, flacSetAudioChainConfig, jlong jContext,
+             jintArray jChannelMap, jfloat gain, jfloat speed, jfloat pitch,
+             jlong minSilenceUs, jlong silencePaddingUs,
+             jfloat silenceThreshold, jboolean measureLoudness,
+             jint waveformFramesPerPeak, jint spectrumFftSize,
+             jint outputSampleRate, jint outputEncoding) {
   Context *context = reinterpret_cast<Context *>(jContext);
-  std::array<int64_t, 4> result;
-  bool success = context->parser->getSeekPositions(timeUs, result);
-  if (success) {
-    env->SetLongArrayRegion(outSeekPoints, 0, result.size(), result.data());
+  FLACParser *parser = context->parser;
+  // The encoding that readBuffer outputs without the chain.
+  exoplayer_jni::PcmEncoding encoding;
+  switch (parser->getBitsPerSample()) {
+    case 16:
+      encoding = exoplayer_jni::kPcmEncoding16Bit;
+      break;
+    case 24:
+      encoding = exoplayer_jni::kPcmEncoding24Bit;
+      break;
+    case 32:
+      encoding = exoplayer_jni::kPcmEncoding32Bit;
+      break;
+    default:
+      encoding = exoplayer_jni::kPcmEncodingInvalid;
+      break;
   }
-  return success;
+  if (!exoplayer_jni::SetAudioChainConfig(env, jChannelMap, gain, speed, pitch,
+                                          minSilenceUs, silencePaddingUs,
+                                          silenceThreshold, measureLoudness,
+                                          waveformFramesPerPeak,
+                                          spectrumFftSize, outputSampleRate,
+                                          outputEncoding,
+                                          &context->audioChain) ||
+      !context->audioChain.Configure(parser->getChannels(),
+                                     parser->getSampleRate(), encoding)) {
+    ALOGE("Unsupported audio chain configuration for %u bits per sample",
+          parser->getBitsPerSample());
+    return false;
+  }
+  parser->setAudioChain(&context->audioChain);
+  return true;
 }
 
-DECODER_FUNC(jstring, flacGetStateString, jlong jContext) {
+DECODER_FUNC(jboolean, flacSetPcm16Output, jlong jContext,
+             jboolean noiseShaping) {
   Context *context = reinterpret_cast<Context *>(jContext);
-  const char *str = context->parser->getDecoderStateString();
-  return env->NewStringUTF(str);
+  return context->parser->setPcm16Output(noiseShaping);
 }
 
-DECODER_FUNC(jboolean, flacIsDecoderAtEndOfStream, jlong jContext) {
+DECODER_FUNC(void, flacSetWaveformRange, jlong jContext, jlong startFrame,
+             jlong endFrame) {
   Context *context = reinterpret_cast<Context *>(jContext);
-  return context->parser->isDecoderAtEndOfStream();
+  context->audioChain.waveform()->SetRange(startFrame, endFrame);
+  context->waveformPeaks.clear();
 }
 
-DECODER_FUNC(void, flacFlush, jlong jContext) {
+DECODER_FUNC(jint, flacDecodeWaveform, jlong jContext, jfloatArray jPeaks) {
   Context *context = reinterpret_cast<Context *>(jContext);
-  context->parser->flush();
+  exoplayer_jni::ScopedNativeCallTimer callTimer(&context->stats);
+  context->source->setFlacDecoderJni(env, thiz);
+  if (!context->audioChain.IsReducingToWaveform()) {
+    ALOGE("The audio chain isn't configured to reduce to a waveform");
+    return -1;
+  }
+  // Frames are decoded and reduced without returning to Java until the peaks
+  // fill the array or the range or stream ends. Each frame outputs the peaks
+  // it completes, which are kept until they've been copied to the array.
+  exoplayer_jni::WaveformBuilder *waveform = context->audioChain.waveform();
+  std::vector<float> &pendingPeaks = context->waveformPeaks;
+  const size_t capacity = env->GetArrayLength(jPeaks);
+  const size_t maxFrameOutputSize = context->audioChain.GetMaxOutputSize(
+      context->parser->getMaxBlockSize());
+  bool ended = false;
+  while (!ended && pendingPeaks.size() < capacity) {
+    if (waveform->reached_range_end()) {
+      ended = true;
+      continue;
+    }
+    const size_t offset = pendingPeaks.size();
+    pendingPeaks.resize(offset + maxFrameOutputSize / sizeof(float));
+    const int count =
+        context->decodeFrame(&pendingPeaks[offset], maxFrameOutputSize);
+    pendingPeaks.resize(offset + std::max(count, 0) / sizeof(float));
+    if (count < 0) {
+      if (env->ExceptionCheck() || !context->parser->isDecoderAtEndOfStream()) {
+        return -1;
+      }
+      ended = true;
+    }
+  }
+  if (ended) {
+    waveform->Finish();
+    pendingPeaks.insert(pendingPeaks.end(), waveform->peaks(),
+                        waveform->peaks() + waveform->peak_count() *
+                            exoplayer_jni::WaveformBuilder::kValuesPerPeak);
+    waveform->RemovePeaks(waveform->peak_count());
+  }
+  const size_t valueCount = std::min(pendingPeaks.size(), capacity);
+  env->SetFloatArrayRegion(jPeaks, 0, valueCount, pendingPeaks.data());
+  pendingPeaks.erase(pendingPeaks.begin(), pendingPeaks.begin() + valueCount);
+  return valueCount / exoplayer_jni::WaveformBuilder::kValuesPerPeak;
 }
 
-DECODER_FUNC(void, flacReset, jlong jContext, jlong newPosition) {
+DECODER_FUNC(jboolean, flacGetSpectrum, jlong jContext, jfloatArray jBands) {
   Context *context = reinterpret_cast<Context *>(jContext);
-  context->parser->reset(newPosition);
+  return exoplayer_jni::GetSpectrum(env, context->audioChain.spectrum(),
+                                    jBands);
+}
+
+DECODER_FUNC(void, flacGetStats, jlong jContext, jlongArray jStats) {
+  Context *context = reinterpret_cast<Context *>(jContext);
+  exoplayer_jni::GetStatsSnapshot(env, context->stats, jStats);
+}
+
+DECODER_FUNC(jboolean, flacStartSessionRecording, jlong jContext,
+             jstring jPath) {
+  Context *context = reinterpret_cast<Context *>(jContext);
+  const char *path = env->GetStringUTFChars(jPath, NULL);
+  const bool started = context->recorder.Start(path);
+  if (!started) {
+    ALOGE("Failed to start session recording to %s", path);
+  }
+  env->ReleaseStringUTFChars(jPath, path);
+  return started;
+}
+
+DECODER_FUNC(void, flacStopSessionRecording, jlong jContext) {
+  Context *context = reinterpret_cast<Context *>(jContext);
+  context->recorder.Stop();
 }
 
 DECODER_FUNC(void, flacRelease, jlong jContext) {
   Context *context = reinterpret_cast<Context *>(jContext);
   delete context;
+  exoplayer_jni::FlushProfile();
+}
+
+DECODER_FUNC(jlong, flacSetCrossfade, jlong jMixer, jlong durationUs,
+             jint curve) {
+  return exoplayer_jni::SetCrossfade(jMixer, durationUs, curve);
+}
+
+DECODER_FUNC(jint, flacCrossfade, jlong jMixer, jobject jData, jint offset,
+             jint size, jint channelCount, jint sampleRate, jint encoding) {
+  return exoplayer_jni::Crossfade(env, jMixer, jData, offset, size,
+                                  channelCount, sampleRate, encoding);
+}
+
+DECODER_FUNC(jint, flacGetCrossfadeDrainSize, jlong jMixer) {
+  return reinterpret_cast<exoplayer_jni::CrossfadeMixer *>(jMixer)
+      ->GetDrainSize();
+}
+
+DECODER_FUNC(jint, flacDrainCrossfade, jlong jMixer, jobject jOutput,
+             jint capacity) {
+  return exoplayer_jni::DrainCrossfade(env, jMixer, jOutput, capacity);
+}
+
+DECODER_FUNC(void, flacEndCrossfadeStream, jlong jMixer) {
+  reinterpret_cast<exoplayer_jni::CrossfadeMixer *>(jMixer)->EndStream();
+}
+
+DECODER_FUNC(void, flacFlushCrossfade, jlong jMixer) {
+  reinterpret_cast<exoplayer_jni::CrossfadeMixer *>(jMixer)->Flush();
+}
+
+DECODER_FUNC(void, flacReleaseCrossfade, jlong jMixer) {
+  delete reinterpret_cast<exoplayer_jni::CrossfadeMixer *>(jMixer);
+}
+
+#define DECODER_METHOD(NAME, SIGNATURE) \
+  EXOPLAYER_JNI_METHOD(                 \
+      #NAME, SIGNATURE,                 \
+      Java_com_google_android_exoplayer2_ext_flac_FlacDecoderJni_##NAME)
+
+// Returns a global reference to the class |name|, or NULL, with an exception
+// pending, if it can't be found.
+static jclass findGlobalClass(JNIEnv *env, const char *name) {
+  jclass localClass = env->FindClass(name);
+  if (localClass == NULL) {
+    return NULL;
+  }
+  jclass globalClass = reinterpret_cast<jclass>(env->NewGlobalRef(localClass));
+  env->DeleteLocalRef(localClass);
+  return globalClass;
+}
+
+// Looks up the JNI references. Returns false, with an exception pending, if any
+// of them can't be found.
+static bool initJniReferences(JNIEnv *env) {
+  jclass decoderJniClass =
+      env->FindClass("com/google/android/exoplayer2/ext/flac/FlacDecoderJni");
+  if (decoderJniClass == NULL) {
+    return false;
+  }
+  readMethod =
+      env->GetMethodID(decoderJniClass, "read", "(Ljava/nio/ByteBuffer;J)I");
+  env->DeleteLocalRef(decoderJniClass);
+  if (readMethod == NULL) {
+    return false;
+  }
+
+  arrayListClass = findGlobalClass(env, "java/util/ArrayList");
+  pictureFrameClass = findGlobalClass(
+      env, "com/google/android/exoplayer2/metadata/flac/PictureFrame");
+  flacStreamMetadataClass = findGlobalClass(
+      env, "com/google/android/exoplayer2/extractor/FlacStreamMetadata");
+  if (arrayListClass == NULL || pictureFrameClass == NULL ||
+      flacStreamMetadataClass == NULL) {
+    return false;
+  }
+  arrayListConstructor = env->GetMethodID(arrayListClass, "<init>", "()V");
+  arrayListAddMethod =
+      env->GetMethodID(arrayListClass, "add", "(Ljava/lang/Object;)Z");
+  pictureFrameConstructor =
+      env->GetMethodID(pictureFrameClass, "<init>",
+                       "(ILjava/lang/String;Ljava/lang/String;IIII[B)V");
+  flacStreamMetadataConstructor =
+      env->GetMethodID(flacStreamMetadataClass, "<init>",
+                       "(IIIIIIIJLjava/util/ArrayList;Ljava/util/ArrayList;)V");
+  return arrayListConstructor != NULL && arrayListAddMethod != NULL &&
+         pictureFrameConstructor != NULL &&
+         flacStreamMetadataConstructor != NULL;
+}
+
+static bool registerNativeMethods(JNIEnv *env) {
+  static const JNINativeMethod decoderMethods[] = {
+      DECODER_METHOD(flacInit, "()J"),
+      DECODER_METHOD(flacGetStatusBuffer, "(J)Ljava/nio/ByteBuffer;"),
+      DECODER_METHOD(
+          flacDecodeMetadata,
+          "(J)Lcom/google/android/exoplayer2/extractor/FlacStreamMetadata;"),
+      DECODER_METHOD(flacDecodeToBuffer, "(JLjava/nio/ByteBuffer;)I"),
+      DECODER_METHOD(flacDecodeToArray, "(J[B)I"),
+      DECODER_METHOD(flacGetSeekPoints, "(JJ[J)Z"),
+      DECODER_METHOD(flacSeekAbsolute, "(JJJ)Z"),
+      DECODER_METHOD(flacGetStateString, "(J)Ljava/lang/String;"),
+      DECODER_METHOD(flacFlush, "(J)V"),
+      DECODER_METHOD(flacReset, "(JJ)V"),
+      DECODER_METHOD(flacSetAudioChainConfig, "(J[IFFFJJFZIIII)Z"),
+      DECODER_METHOD(flacSetPcm16Output, "(JZ)Z"),
+      DECODER_METHOD(flacSetWaveformRange, "(JJJ)V"),
+      DECODER_METHOD(flacDecodeWaveform, "(J[F)I"),
+      DECODER_METHOD(flacGetSpectrum, "(J[F)Z"),
+      DECODER_METHOD(flacGetStats, "(J[J)V"),
+      DECODER_METHOD(flacStartSessionRecording, "(JLjava/lang/String;)Z"),
+      DECODER_METHOD(flacStopSessionRecording, "(J)V"),
+      DECODER_METHOD(flacRelease, "(J)V"),
+      DECODER_METHOD(flacSetCrossfade, "(JJI)J"),
+      DECODER_METHOD(flacCrossfade, "(JLjava/nio/ByteBuffer;IIIII)I"),
+      DECODER_METHOD(flacGetCrossfadeDrainSize, "(J)I"),
+      DECODER_METHOD(flacDrainCrossfade, "(JLjava/nio/ByteBuffer;I)I"),
+      DECODER_METHOD(flacEndCrossfadeStream, "(J)V"),
+      DECODER_METHOD(flacFlushCrossfade, "(J)V"),
+      DECODER_METHOD(flacReleaseCrossfade, "(J)V")};
+  return exoplayer_jni::RegisterNatives(
+      env, "com/google/android/exoplayer2/ext/flac/FlacDecoderJni",
+      decoderMethods);
 }
@@ -20,10 +20,14 @@
 
 #include <android/log.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cstdlib>
 #include <cstring>
 
+#include "cpu_dispatch.h"  // NOLINT
+#include "trace.h"         // NOLINT
+
 #define LOG_TAG "FLACParser"
 #define ALOGE(...) \
   ((void)__android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__))
@@ -139,7 +143,11 @@ FLAC__StreamDecoderTellStatus FLACParser::tellCallback(
 
 FLAC__StreamDecoderLengthStatus FLACParser::lengthCallback(
     FLAC__uint64 *stream_length) {
-  return FLAC__STREAM_DECODER_LENGTH_STATUS_UNSUPPORTED;
+  if (mStreamLength <= 0) {
+    return FLAC__STREAM_DECODER_LENGTH_STATUS_UNSUPPORTED;
+  }
+  *stream_length = mStreamLength;
+  return FLAC__STREAM_DECODER_LENGTH_STATUS_OK;
 }
 
 FLAC__bool FLACParser::eofCallback() { return mEOF; }
@@ -148,9 +156,12 @@ FLAC__StreamDecoderWriteStatus FLACParser::writeCallback(
     const FLAC__Frame *frame, const FLAC__int32 *const buffer[]) {
   if (mWriteRequested) {
     mWriteRequested = false;
-    // FLAC parser doesn't free or realloc buffer until next frame or finish
+    // FLAC parser doesn't free or realloc buffer until next frame or finish,
+    // but when a seek lands inside a frame, the array of channel pointers to
+    // the trimmed samples is on libFLAC's stack, so the pointers are copied.
     mWriteHeader = frame->header;
-    mWriteBuffer = buffer;
+    std::copy(buffer, buffer + frame->header.channels, mWriteChannels);
+    mWriteBuffer = mWriteChannels;
     mWriteCompleted = true;
     return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
   } else {
@@ -220,39 +231,6 @@ void FLACParser::errorCallback(FLAC__StreamDecoderErrorStatus status) {
   mErrorStatus = status;
 }
 
-// Copy samples from FLAC native 32-bit non-interleaved to
-// correct bit-depth (non-zero padded), interleaved.
-// These are candidates for optimization if needed.
-static void copyToByteArrayBigEndian(int8_t *dst, const int *const *src,
-                                     unsigned bytesPerSample, unsigned nSamples,
-                                     unsigned nChannels) {
-  for (unsigned i = 0; i < nSamples; ++i) {
-    for (unsigned c = 0; c < nChannels; ++c) {
-      // point to the first byte of the source address
-      // and then skip the first few bytes (most significant bytes)
-      // depending on the bit depth
-      const int8_t *byteSrc =
-          reinterpret_cast<const int8_t *>(&src[c][i]) + 4 - bytesPerSample;
-      memcpy(dst, byteSrc, bytesPerSample);
-      dst = dst + bytesPerSample;
-    }
-  }
-}
-
-static void copyToByteArrayLittleEndian(int8_t *dst, const int *const *src,
-                                        unsigned bytesPerSample,
-                                        unsigned nSamples, unsigned nChannels) {
-  for (unsigned i = 0; i < nSamples; ++i) {
-    for (unsigned c = 0; c < nChannels; ++c) {
-      // with little endian, the most significant bytes will be at the end
-      // copy the bytes in little endian will remove the most significant byte
-      // so we are good here.
-      memcpy(dst, &(src[c][i]), bytesPerSample);
-      dst = dst + bytesPerSample;
-    }
-  }
-}
-
 static void copyTrespass(int8_t * /* dst */, const int *const * /* src */,
                          unsigned /* bytesPerSample */, unsigned /* nSamples */,
                          unsigned /* nChannels */) {
@@ -264,9 +242,12 @@ static void copyTrespass(int8_t * /* dst */, const int *const * /* src */,
 FLACParser::FLACParser(DataSource *source)
     : mDataSource(source),
       mCopy(copyTrespass),
+      mAudioChain(NULL),
+      mDitherPcm16(NULL),
       mDecoder(NULL),
       mCurrentPos(0LL),
       mEOF(false),
+      mStreamLength(0LL),
       mStreamInfoValid(false),
       mSeekTable(NULL),
       firstFrameOffset(0LL),
@@ -275,6 +256,7 @@ FLACParser::FLACParser(DataSource *source)
       mWriteRequested(false),
       mWriteCompleted(false),
       mWriteBuffer(NULL),
+      mSeekFrameReady(false),
       mErrorStatus((FLAC__StreamDecoderErrorStatus)-1) {
   ALOGV("FLACParser::FLACParser");
   memset(&mStreamInfo, 0, sizeof(mStreamInfo));
@@ -351,9 +333,9 @@ bool FLACParser::decodeMetadata() {
     }
     // configure the appropriate copy function based on device endianness.
     if (isBigEndian()) {
-      mCopy = copyToByteArrayBigEndian;
+      mCopy = exoplayer_jni::InterleavePcmBigEndian;
     } else {
-      mCopy = copyToByteArrayLittleEndian;
+      mCopy = exoplayer_jni::GetKernels().interleave_pcm;
     }
   } else {
     ALOGE("missing STREAMINFO");
@@ -362,22 +344,42 @@ bool FLACParser::decodeMetadata() {
   return true;
 }
 
+bool FLACParser::setPcm16Output(bool noiseShaping) {
+  if (getBitsPerSample() <= 16 || isBigEndian()) {
+    return false;
+  }
+  exoplayer_jni::InitDitherState(&mDitherState, noiseShaping);
+  mDitherPcm16 = exoplayer_jni::GetKernels().dither_pcm16;
+  return true;
+}
+
 size_t FLACParser::readBuffer(void *output, size_t output_size) {
-  mWriteRequested = true;
-  mWriteCompleted = false;
+  if (mSeekFrameReady) {
+    // libFLAC wrote the frame containing the seek target during the seek,
+    // starting at the target sample, so it's output without decoding.
+    mSeekFrameReady = false;
+  } else {
+    mWriteRequested = true;
+    mWriteCompleted = false;
 
-  if (!FLAC__stream_decoder_process_single(mDecoder)) {
-    ALOGE("FLACParser::readBuffer process_single failed. Status: %s",
-          getDecoderStateString());
-    return -1;
-  }
-  if (!mWriteCompleted) {
-    if (FLAC__stream_decoder_get_state(mDecoder) !=
-        FLAC__STREAM_DECODER_END_OF_STREAM) {
-      ALOGE("FLACParser::readBuffer write did not complete. Status: %s",
+    bool processed;
+    {
+      EXO_TRACE_SCOPE("flac:decode");
+      processed = FLAC__stream_decoder_process_single(mDecoder);
+    }
+    if (!processed) {
+      ALOGE("FLACParser::readBuffer process_single failed. Status: %s",
             getDecoderStateString());
+      return -1;
+    }
+    if (!mWriteCompleted) {
+      if (FLAC__stream_decoder_get_state(mDecoder) !=
+          FLAC__STREAM_DECODER_END_OF_STREAM) {
+        ALOGE("FLACParser::readBuffer write did not complete. Status: %s",
+              getDecoderStateString());
+      }
+      return -1;
     }
-    return -1;
   }
 
   // verify that block header keeps the promises made by STREAMINFO
@@ -398,7 +400,25 @@ size_t FLACParser::readBuffer(void *output, size_t output_size) {
     return -1;
   }
 
-  unsigned bytesPerSample = getBitsPerSample() >> 3;
+  if (mAudioChain != NULL && !mAudioChain->IsPassthrough()) {
+    EXO_TRACE_SCOPE("flac:audioChain");
+    if (mAudioChain->IsReducingToWaveform()) {
+      // Frames carry their first sample's index, which keeps the waveform's
+      // peaks aligned after seeks.
+      mAudioChain->waveform()->set_position(mWriteHeader.number.sample_number);
+    }
+    int outputSize = mAudioChain->ProcessPlanar(
+        mWriteBuffer, getBitsPerSample(), blocksize, output, output_size);
+    if (outputSize < 0) {
+      ALOGE("FLACParser::readBuffer audio chain failed for %u samples",
+            blocksize);
+      return -1;
+    }
+    return outputSize;
+  }
+
+  unsigned bytesPerSample =
+      mDitherPcm16 != NULL ? sizeof(int16_t) : getBitsPerSample() >> 3;
   size_t bufferSize = blocksize * getChannels() * bytesPerSample;
   if (bufferSize > output_size) {
     ALOGE(
@@ -408,9 +428,17 @@ size_t FLACParser::readBuffer(void *output, size_t output_size) {
     return -1;
   }
 
-  // copy PCM from FLAC write buffer to our media buffer, with interleaving.
-  (*mCopy)(reinterpret_cast<int8_t *>(output), mWriteBuffer, bytesPerSample,
-           blocksize, getChannels());
+  if (mDitherPcm16 != NULL) {
+    EXO_TRACE_SCOPE("flac:dither");
+    (*mDitherPcm16)(reinterpret_cast<int16_t *>(output), mWriteBuffer,
+                    getBitsPerSample(), blocksize, getChannels(),
+                    &mDitherState);
+  } else {
+    // copy PCM from FLAC write buffer to our media buffer, with interleaving.
+    EXO_TRACE_SCOPE("flac:convert");
+    (*mCopy)(reinterpret_cast<int8_t *>(output), mWriteBuffer, bytesPerSample,
+             blocksize, getChannels());
+  }
 
   // fill in buffer metadata
   CHECK(mWriteHeader.number_type == FLAC__FRAME_NUMBER_TYPE_SAMPLE_NUMBER);
@@ -418,6 +446,38 @@ size_t FLACParser::readBuffer(void *output, size_t output_size) {
   return bufferSize;
 }
 
+bool FLACParser::seekAbsolute(int64_t sampleIndex, int64_t streamLength) {
+  mStreamLength = streamLength;
+  mEOF = false;
+  mSeekFrameReady = false;
+  if (mAudioChain != NULL) {
+    mAudioChain->Reset();
+  }
+  if (mDitherPcm16 != NULL) {
+    exoplayer_jni::InitDitherState(&mDitherState, mDitherState.noise_shaping);
+  }
+  // libFLAC only writes the frame containing the target sample, and only once
+  // it has found it.
+  mWriteRequested = true;
+  mWriteCompleted = false;
+  bool sought;
+  {
+    EXO_TRACE_SCOPE("flac:seek");
+    sought = FLAC__stream_decoder_seek_absolute(mDecoder, sampleIndex);
+  }
+  mWriteRequested = false;
+  if (!sought || !mWriteCompleted) {
+    ALOGE("FLACParser::seekAbsolute to sample %lld failed. Status: %s",
+          static_cast<long long>(sampleIndex), getDecoderStateString());
+    // A failed seek leaves libFLAC in FLAC__STREAM_DECODER_SEEK_ERROR, which a
+    // flush recovers from.
+    FLAC__stream_decoder_flush(mDecoder);
+    return false;
+  }
+  mSeekFrameReady = true;
+  return true;
+}
+
 bool FLACParser::getSeekPositions(int64_t timeUs,
                                   std::array<int64_t, 4> &result) {
   if (!mSeekTable) {
@@ -27,6 +27,8 @@
 // libFLAC parser
 #include "FLAC/stream_decoder.h"
 
+#include "audio_chain.h"  // NOLINT
+#include "audio_kernels.h"  // NOLINT
 #include "include/data_source.h"
 
 typedef int status_t;
@@ -87,6 +89,31 @@ class FLACParser {
 
   bool getSeekPositions(int64_t timeUs, std::array<int64_t, 4> &result);
 
+  // Seeks to the sample with index |sampleIndex| with libFLAC, which bisects
+  // the stream, reading it at the offsets it needs through the data source, and
+  // positions the decoder on the exact sample. |streamLength| is the length of
+  // the stream in bytes, or 0 if it's unknown, in which case only streams with
+  // a seek table can be seeked. The next readBuffer call outputs the frame
+  // containing the sample, from that sample. Must be called after
+  // decodeMetadata. Returns false if the seek failed, in which case the decoder
+  // is flushed and must be reset to a known position.
+  bool seekAbsolute(int64_t sampleIndex, int64_t streamLength);
+
+  // Sets the chain that processes decoded blocks before they're written to the
+  // output, or NULL to write them unchanged. The chain must be configured for
+  // the stream and outlive the parser.
+  void setAudioChain(exoplayer_jni::AudioChain *audioChain) {
+    mAudioChain = audioChain;
+  }
+
+  // Makes readBuffer output 16-bit samples for streams of more than 16 bits
+  // per sample, requantized with TPDF dither and optionally noise shaped,
+  // instead of samples at the stream's bit depth. Blocks are processed by the
+  // audio chain instead, if one is set. Must be called after decodeMetadata.
+  // Returns false if the stream has 16 bits per sample or fewer, or the device
+  // is big endian.
+  bool setPcm16Output(bool noiseShaping);
+
   void flush() {
     reset(mCurrentPos);
   }
@@ -95,6 +122,15 @@ class FLACParser {
     if (mDecoder != NULL) {
       mCurrentPos = newPosition;
       mEOF = false;
+      mSeekFrameReady = false;
+      if (mAudioChain != NULL) {
+        mAudioChain->Reset();
+      }
+      if (mDitherPcm16 != NULL) {
+        // The shaped error of the previous block doesn't apply after a seek.
+        exoplayer_jni::InitDitherState(&mDitherState,
+                                       mDitherState.noise_shaping);
+      }
       if (newPosition == 0) {
         mStreamInfoValid = false;
         mVorbisCommentsValid = false;
@@ -132,12 +168,21 @@ class FLACParser {
   void (*mCopy)(int8_t *dst, const int *const *src, unsigned bytesPerSample,
                 unsigned nSamples, unsigned nChannels);
 
+  // processes decoded blocks in place of mCopy, if set
+  exoplayer_jni::AudioChain *mAudioChain;
+
+  // requantizes blocks to 16 bits in place of mCopy, if set
+  exoplayer_jni::DitherPcm16Function mDitherPcm16;
+  exoplayer_jni::DitherState mDitherState;
+
   // handle to underlying libFLAC parser
   FLAC__StreamDecoder *mDecoder;
 
   // current position within the data source
   off64_t mCurrentPos;
   bool mEOF;
+  // length of the data source for libFLAC's seeks, or 0 if unknown
+  off64_t mStreamLength;
 
   // cached when the STREAMINFO metadata is parsed by libFLAC
   FLAC__StreamMetadata_StreamInfo mStreamInfo;
@@ -159,6 +204,10 @@ class FLACParser {
   bool mWriteCompleted;
   FLAC__FrameHeader mWriteHeader;
   const FLAC__int32 *const *mWriteBuffer;
+  // the channel pointers of the written block, which mWriteBuffer points to
+  const FLAC__int32 *mWriteChannels[FLAC__MAX_CHANNELS];
+  // whether seekAbsolute has left the frame to output in the write buffer
+  bool mSeekFrameReady;
 
   // most recent error reported by libFLAC parser
   FLAC__StreamDecoderErrorStatus mErrorStatus;
@@ -0,0 +1,629 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "audio_chain.h"  // NOLINT
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "cpu_dispatch.h"  // NOLINT
+
+namespace exoplayer_jni {
+namespace {
+
+const int64_t kResampleOne = INT64_C(1) << 32;
+
+// Reads a sample in |kEncoding| as a float, without normalizing it. 24-bit
+// samples are read into the most significant bits of a 32-bit integer, so they
+// have the same scale as 32-bit samples.
+template <PcmEncoding kEncoding>
+float ReadSample(const uint8_t* sample);
+
+template <>
+inline float ReadSample<kPcmEncoding16Bit>(const uint8_t* sample) {
+  int16_t value;
+  std::memcpy(&value, sample, sizeof(value));
+  return value;
+}
+
+template <>
+inline float ReadSample<kPcmEncoding24Bit>(const uint8_t* sample) {
+  const uint32_t value = static_cast<uint32_t>(sample[0]) << 8 |
+                         static_cast<uint32_t>(sample[1]) << 16 |
+                         static_cast<uint32_t>(sample[2]) << 24;
+  return static_cast<int32_t>(value);
+}
+
+template <>
+inline float ReadSample<kPcmEncoding32Bit>(const uint8_t* sample) {
+  int32_t value;
+  std::memcpy(&value, sample, sizeof(value));
+  return static_cast<float>(value);
+}
+
+template <>
+inline float ReadSample<kPcmEncodingFloat>(const uint8_t* sample) {
+  float value;
+  std::memcpy(&value, sample, sizeof(value));
+  return value;
+}
+
+// Reads |frame_count| interleaved frames into |block|, reading output channel c
+// from input channel |channel_map[c]| and multiplying every sample by |scale|.
+template <PcmEncoding kEncoding, int kBytesPerSample>
+void UnpackMapped(const uint8_t* input, int input_channel_count,
+                  const int* channel_map, int output_channel_count,
+                  int frame_count, float scale, float* block) {
+  const int frame_size = input_channel_count * kBytesPerSample;
+  for (int i = 0; i < frame_count; i++) {
+    const uint8_t* frame = input + i * frame_size;
+    for (int c = 0; c < output_channel_count; c++) {
+      block[c] =
+          ReadSample<kEncoding>(frame + channel_map[c] * kBytesPerSample) *
+          scale;
+    }
+    block += output_channel_count;
+  }
+}
+
+// Scales |sample| by |scale| and clamps it to [-scale, maximum], rounding half
+// away from zero as ConvertFloatToPcm16C does. Doubles are used so that 24-bit
+// and 32-bit samples are rounded exactly.
+inline int32_t ToInteger(float sample, double scale, double maximum) {
+  double value = sample * scale;
+  value = std::max(-scale, std::min(maximum, value));
+  return static_cast<int32_t>(value + (value < 0 ? -0.5 : 0.5));
+}
+
+}  // namespace
+
+int GetBytesPerSample(PcmEncoding encoding) {
+  switch (encoding) {
+    case kPcmEncoding16Bit:
+      return 2;
+    case kPcmEncoding24Bit:
+      return 3;
+    case kPcmEncoding32Bit:
+    case kPcmEncodingFloat:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+void UnpackPcm(const uint8_t* input, PcmEncoding encoding, int sample_count,
+               float* output) {
+  switch (encoding) {
+    case kPcmEncoding16Bit:
+      GetKernels().convert_pcm16_to_float(
+          reinterpret_cast<const int16_t*>(input), output, sample_count,
+          1.0f / 32768.0f);
+      break;
+    case kPcmEncoding24Bit:
+      for (int i = 0; i < sample_count; i++) {
+        output[i] =
+            ReadSample<kPcmEncoding24Bit>(input + 3 * i) / 2147483648.0f;
+      }
+      break;
+    case kPcmEncoding32Bit:
+      for (int i = 0; i < sample_count; i++) {
+        output[i] =
+            ReadSample<kPcmEncoding32Bit>(input + 4 * i) / 2147483648.0f;
+      }
+      break;
+    case kPcmEncodingFloat:
+      std::memcpy(output, input, sample_count * sizeof(float));
+      break;
+    default:
+      break;
+  }
+}
+
+size_t PackPcm(const float* input, PcmEncoding encoding, int sample_count,
+               uint8_t* output) {
+  switch (encoding) {
+    case kPcmEncoding16Bit:
+      GetKernels().convert_float_to_pcm16(
+          input, reinterpret_cast<int16_t*>(output), sample_count);
+      break;
+    case kPcmEncoding24Bit:
+      for (int i = 0; i < sample_count; i++) {
+        const int32_t sample = ToInteger(input[i], 8388608.0, 8388607.0);
+        output[3 * i] = static_cast<uint8_t>(sample);
+        output[3 * i + 1] = static_cast<uint8_t>(sample >> 8);
+        output[3 * i + 2] = static_cast<uint8_t>(sample >> 16);
+      }
+      break;
+    case kPcmEncoding32Bit:
+      for (int i = 0; i < sample_count; i++) {
+        const int32_t sample = ToInteger(input[i], 2147483648.0, 2147483647.0);
+        std::memcpy(output + 4 * i, &sample, sizeof(sample));
+      }
+      break;
+    case kPcmEncodingFloat:
+      std::memcpy(output, input, sample_count * sizeof(float));
+      break;
+    default:
+      return 0;
+  }
+  return static_cast<size_t>(sample_count) * GetBytesPerSample(encoding);
+}
+
+const int AudioChain::kBlockFrames;
+
+AudioChain::AudioChain()
+    : has_config_(false),
+      input_channel_count_(0),
+      input_sample_rate_(0),
+      input_encoding_(kPcmEncodingInvalid),
+      output_channel_count_(0),
+      output_sample_rate_(0),
+      output_encoding_(kPcmEncodingInvalid),
+      input_scale_(1),
+      identity_map_(true),
+      passthrough_(true),
+      stretching_(false),
+      resampling_(false),
+      skipping_silence_(false),
+      measuring_loudness_(false),
+      reducing_to_waveform_(false),
+      analyzing_spectrum_(false),
+      resample_position_(0),
+      resample_step_(0),
+      min_silence_frames_(0),
+      padding_frames_(0),
+      silent_frame_count_(0),
+      skipped_frame_count_(0) {
+  Reset();
+}
+
+void AudioChain::SetConfig(const AudioChainConfig& config) {
+  config_ = config;
+  has_config_ = true;
+  // Forces the next call to IsConfiguredFor() to return false.
+  input_channel_count_ = 0;
+}
+
+bool AudioChain::Configure(int channel_count, int sample_rate,
+                           PcmEncoding encoding) {
+  input_channel_count_ = 0;
+  passthrough_ = true;
+  if (!has_config_ || channel_count <= 0 ||
+      channel_count > AudioChainConfig::kMaxChannels || sample_rate <= 0 ||
+      GetBytesPerSample(encoding) == 0) {
+    return false;
+  }
+  const int output_channel_count =
+      config_.channel_count > 0 ? config_.channel_count : channel_count;
+  if (output_channel_count > AudioChainConfig::kMaxChannels) {
+    return false;
+  }
+  bool identity_map = output_channel_count == channel_count;
+  for (int c = 0; c < output_channel_count; c++) {
+    const int input_channel =
+        config_.channel_count > 0 ? config_.channel_map[c] : c;
+    if (input_channel < 0 || input_channel >= channel_count) {
+      return false;
+    }
+    channel_map_[c] = input_channel;
+    identity_map = identity_map && input_channel == c;
+  }
+  if (config_.measure_loudness &&
+      !loudness_meter_.Configure(output_channel_count, sample_rate)) {
+    return false;
+  }
+  if (config_.waveform_frames_per_peak > 0 &&
+      !waveform_.Configure(output_channel_count,
+                           config_.waveform_frames_per_peak)) {
+    return false;
+  }
+  if (config_.spectrum_fft_size > 0 &&
+      !spectrum_.Configure(output_channel_count, sample_rate,
+                           config_.spectrum_fft_size)) {
+    return false;
+  }
+  // The audio is stretched by the pitch, and resampled back to its duration.
+  const bool stretching = config_.speed != 1 || config_.pitch != 1;
+  if (stretching &&
+      !time_stretcher_.Configure(output_channel_count, sample_rate,
+                                 static_cast<double>(config_.pitch) /
+                                     config_.speed)) {
+    return false;
+  }
+
+  input_channel_count_ = channel_count;
+  input_sample_rate_ = sample_rate;
+  input_encoding_ = encoding;
+  output_channel_count_ = output_channel_count;
+  output_sample_rate_ =
+      config_.sample_rate > 0 ? config_.sample_rate : sample_rate;
+  output_encoding_ =
+      GetBytesPerSample(config_.encoding) > 0 ? config_.encoding : encoding;
+  identity_map_ = identity_map;
+  stretching_ = stretching;
+  resampling_ =
+      output_sample_rate_ != input_sample_rate_ || config_.pitch != 1;
+  min_silence_frames_ =
+      std::max<int64_t>(0, config_.min_silence_us) * output_sample_rate_ /
+      1000000;
+  padding_frames_ = std::min(
+      min_silence_frames_,
+      std::max<int64_t>(0, config_.silence_padding_us) * output_sample_rate_ /
+          1000000);
+  skipping_silence_ = min_silence_frames_ > 0;
+  measuring_loudness_ = config_.measure_loudness;
+  reducing_to_waveform_ = config_.waveform_frames_per_peak > 0;
+  analyzing_spectrum_ = config_.spectrum_fft_size > 0;
+  passthrough_ = identity_map && config_.gain == 1 && !stretching_ &&
+                 !resampling_ && !skipping_silence_ && !measuring_loudness_ &&
+                 !reducing_to_waveform_ && !analyzing_spectrum_ &&
+                 output_encoding_ == input_encoding_;
+  switch (encoding) {
+    case kPcmEncoding16Bit:
+      input_scale_ = config_.gain / 32768.0f;
+      break;
+    case kPcmEncoding24Bit:
+    case kPcmEncoding32Bit:
+      input_scale_ = config_.gain / 2147483648.0f;
+      break;
+    default:
+      input_scale_ = config_.gain;
+      break;
+  }
+
+  if (config_.pitch == 1) {
+    resample_step_ =
+        (static_cast<int64_t>(input_sample_rate_) << 32) / output_sample_rate_;
+  } else {
+    // Raising the pitch plays the stretched audio faster.
+    resample_step_ = static_cast<int64_t>(
+        static_cast<double>(input_sample_rate_) * config_.pitch /
+        output_sample_rate_ * kResampleOne);
+  }
+  block_.resize(kBlockFrames * output_channel_count_);
+  int unresampled_frames = kBlockFrames;
+  if (stretching_) {
+    unresampled_frames = time_stretcher_.GetMaxOutputFrameCount(kBlockFrames);
+    stretched_block_.resize(unresampled_frames * output_channel_count_);
+  } else {
+    stretched_block_.clear();
+  }
+  if (resampling_) {
+    resampled_block_.resize(GetMaxResampledFrameCount(unresampled_frames) *
+                            output_channel_count_);
+  } else {
+    resampled_block_.clear();
+  }
+  if (skipping_silence_) {
+    held_silence_.reserve(static_cast<size_t>(min_silence_frames_) *
+                          output_channel_count_ *
+                          GetBytesPerSample(output_encoding_));
+  }
+  Reset();
+  return true;
+}
+
+bool AudioChain::IsConfiguredFor(int channel_count, int sample_rate,
+                                 PcmEncoding encoding) const {
+  return input_channel_count_ > 0 && channel_count == input_channel_count_ &&
+         sample_rate == input_sample_rate_ && encoding == input_encoding_;
+}
+
+size_t AudioChain::GetMaxOutputSize(int frame_count) const {
+  if (reducing_to_waveform_) {
+    // The frames complete at most one more peak than they hold, together with
+    // the frames of the incomplete peak.
+    return static_cast<size_t>(frame_count / config_.waveform_frames_per_peak +
+                               1) *
+           WaveformBuilder::kValuesPerPeak * sizeof(float);
+  }
+  int64_t output_frames = frame_count;
+  if (stretching_) {
+    output_frames = time_stretcher_.GetMaxOutputFrameCount(frame_count);
+  }
+  if (resampling_) {
+    output_frames = GetMaxResampledFrameCount(output_frames);
+  }
+  if (skipping_silence_) {
+    // At most |min_silence_frames_| frames of silence are held back.
+    output_frames += min_silence_frames_;
+  }
+  return static_cast<size_t>(output_frames) * output_channel_count_ *
+         GetBytesPerSample(output_encoding_);
+}
+
+int AudioChain::Process(const void* input, int frame_count, void* output,
+                        size_t output_size) {
+  if (output_size < GetMaxOutputSize(frame_count)) {
+    return -1;
+  }
+  const uint8_t* input_bytes = static_cast<const uint8_t*>(input);
+  uint8_t* const output_start = static_cast<uint8_t*>(output);
+  uint8_t* output_bytes = output_start;
+  skipped_frame_count_ = 0;
+  for (int first_frame = 0; first_frame < frame_count;
+       first_frame += kBlockFrames) {
+    const int block_frames = std::min(kBlockFrames, frame_count - first_frame);
+    float* const block = GetBlock(output_bytes);
+    UnpackInterleaved(input_bytes, first_frame, block_frames, block);
+    if (measuring_loudness_) {
+      loudness_meter_.Process(block, block_frames);
+    }
+    if (analyzing_spectrum_) {
+      spectrum_.Add(block, block_frames);
+    }
+    if (reducing_to_waveform_) {
+      waveform_.Add(block, block_frames);
+    } else {
+      output_bytes += FinishBlock(block, block_frames, output_bytes);
+    }
+  }
+  if (reducing_to_waveform_) {
+    output_bytes += TakeWaveformPeaks(output_bytes);
+  }
+  return static_cast<int>(output_bytes - output_start);
+}
+
+int AudioChain::ProcessPlanar(const int32_t* const* input,
+                              int bits_per_sample, int frame_count,
+                              void* output, size_t output_size) {
+  if (output_size < GetMaxOutputSize(frame_count) || bits_per_sample < 1 ||
+      bits_per_sample > 32) {
+    return -1;
+  }
+  uint8_t* const output_start = static_cast<uint8_t*>(output);
+  uint8_t* output_bytes = output_start;
+  skipped_frame_count_ = 0;
+  for (int first_frame = 0; first_frame < frame_count;
+       first_frame += kBlockFrames) {
+    const int block_frames = std::min(kBlockFrames, frame_count - first_frame);
+    float* const block = GetBlock(output_bytes);
+    UnpackPlanar(input, bits_per_sample, first_frame, block_frames, block);
+    if (measuring_loudness_) {
+      loudness_meter_.Process(block, block_frames);
+    }
+    if (analyzing_spectrum_) {
+      spectrum_.Add(block, block_frames);
+    }
+    if (reducing_to_waveform_) {
+      waveform_.Add(block, block_frames);
+    } else {
+      output_bytes += FinishBlock(block, block_frames, output_bytes);
+    }
+  }
+  if (reducing_to_waveform_) {
+    output_bytes += TakeWaveformPeaks(output_bytes);
+  }
+  return static_cast<int>(output_bytes - output_start);
+}
+
+double AudioChain::GetIntegratedLoudness() const {
+  const double loudness = loudness_meter_.integrated_loudness();
+  if (!measuring_loudness_ || std::isinf(loudness) || config_.gain <= 0) {
+    return -std::numeric_limits<double>::infinity();
+  }
+  // The gain was applied when the samples were unpacked.
+  return loudness - 20 * std::log10(static_cast<double>(config_.gain));
+}
+
+void AudioChain::Reset() {
+  time_stretcher_.Reset();
+  loudness_meter_.ResetFilters();
+  resample_position_ = 0;
+  std::fill(last_frame_, last_frame_ + AudioChainConfig::kMaxChannels, 0.0f);
+  silent_frame_count_ = 0;
+  skipped_frame_count_ = 0;
+  held_silence_.clear();
+  spectrum_.Reset();
+}
+
+size_t AudioChain::TakeWaveformPeaks(uint8_t* output) {
+  const size_t size = static_cast<size_t>(waveform_.peak_count()) *
+                      WaveformBuilder::kValuesPerPeak * sizeof(float);
+  std::memcpy(output, waveform_.peaks(), size);
+  waveform_.RemovePeaks(waveform_.peak_count());
+  return size;
+}
+
+float* AudioChain::GetBlock(uint8_t* output) {
+  // Float output that isn't stretched, resampled or checked for silence is
+  // unpacked in place, saving a copy.
+  return output_encoding_ == kPcmEncodingFloat && !stretching_ &&
+                 !resampling_ && !skipping_silence_ && !reducing_to_waveform_
+             ? reinterpret_cast<float*>(output)
+             : block_.data();
+}
+
+int64_t AudioChain::GetMaxResampledFrameCount(int64_t frame_count) const {
+  if (config_.pitch == 1) {
+    // Each call outputs at most one frame more than the sample rate ratio
+    // implies, plus one for the rounding of the fixed point step.
+    return (frame_count * output_sample_rate_ + input_sample_rate_ - 1) /
+               input_sample_rate_ +
+           2;
+  }
+  // One more frame is allowed for the rounding of the pitch.
+  const double ratio =
+      static_cast<double>(output_sample_rate_) /
+      (static_cast<double>(input_sample_rate_) * config_.pitch);
+  return static_cast<int64_t>(std::ceil(frame_count * ratio)) + 3;
+}
+
+void AudioChain::UnpackInterleaved(const uint8_t* input, int first_frame,
+                                   int frame_count, float* block) const {
+  const uint8_t* frames = input + static_cast<size_t>(first_frame) *
+                                      input_channel_count_ *
+                                      GetBytesPerSample(input_encoding_);
+  if (identity_map_ && input_encoding_ == kPcmEncoding16Bit) {
+    GetKernels().convert_pcm16_to_float(
+        reinterpret_cast<const int16_t*>(frames), block,
+        frame_count * input_channel_count_, input_scale_);
+    return;
+  }
+  switch (input_encoding_) {
+    case kPcmEncoding16Bit:
+      UnpackMapped<kPcmEncoding16Bit, 2>(
+          frames, input_channel_count_, channel_map_, output_channel_count_,
+          frame_count, input_scale_, block);
+      break;
+    case kPcmEncoding24Bit:
+      UnpackMapped<kPcmEncoding24Bit, 3>(
+          frames, input_channel_count_, channel_map_, output_channel_count_,
+          frame_count, input_scale_, block);
+      break;
+    case kPcmEncoding32Bit:
+      UnpackMapped<kPcmEncoding32Bit, 4>(
+          frames, input_channel_count_, channel_map_, output_channel_count_,
+          frame_count, input_scale_, block);
+      break;
+    case kPcmEncodingFloat:
+      UnpackMapped<kPcmEncodingFloat, 4>(
+          frames, input_channel_count_, channel_map_, output_channel_count_,
+          frame_count, input_scale_, block);
+      break;
+    default:
+      break;
+  }
+}
+
+void AudioChain::UnpackPlanar(const int32_t* const* input, int bits_per_sample,
+                              int first_frame, int frame_count,
+                              float* block) const {
+  const float scale = std::ldexp(config_.gain, 1 - bits_per_sample);
+  // Each channel is read sequentially, which is friendlier to the prefetcher
+  // than reading every channel for each frame.
+  for (int c = 0; c < output_channel_count_; c++) {
+    const int32_t* source = input[channel_map_[c]] + first_frame;
+    float* destination = block + c;
+    for (int i = 0; i < frame_count; i++) {
+      *destination = source[i] * scale;
+      destination += output_channel_count_;
+    }
+  }
+}
+
+int AudioChain::Resample(const float* block, int frame_count, float* output) {
+  const int channel_count = output_channel_count_;
+  int64_t position = resample_position_;
+  int output_frame_count = 0;
+  // Output frames are interpolated between input frames floor(position) and
+  // floor(position) + 1, so the last input frame is only used as the left
+  // frame once the next block is available.
+  while ((position >> 32) + 1 < frame_count) {
+    const int64_t index = position >> 32;
+    const float fraction = static_cast<float>(position & (kResampleOne - 1)) *
+                           (1.0f / 4294967296.0f);
+    const float* left = index < 0 ? last_frame_ : block + index * channel_count;
+    const float* right = block + (index + 1) * channel_count;
+    for (int c = 0; c < channel_count; c++) {
+      output[c] = left[c] + (right[c] - left[c]) * fraction;
+    }
+    output += channel_count;
+    output_frame_count++;
+    position += resample_step_;
+  }
+  std::memcpy(last_frame_, block + (frame_count - 1) * channel_count,
+              channel_count * sizeof(float));
+  resample_position_ = position - frame_count * kResampleOne;
+  return output_frame_count;
+}
+
+size_t AudioChain::Pack(const float* block, int frame_count,
+                        uint8_t* output) const {
+  return PackPcm(block, output_encoding_, frame_count * output_channel_count_,
+                 output);
+}
+
+size_t AudioChain::FinishBlock(const float* block, int frame_count,
+                               uint8_t* output) {
+  float* const output_float = reinterpret_cast<float*>(output);
+  if (stretching_) {
+    frame_count = time_stretcher_.Process(block, frame_count,
+                                          stretched_block_.data());
+    block = stretched_block_.data();
+  }
+  if (frame_count == 0) {
+    // The time stretcher buffered the whole block.
+    return 0;
+  }
+  if (resampling_) {
+    // Float output is resampled directly into the output, unless silence may
+    // need to be held back.
+    float* const resampled =
+        output_encoding_ == kPcmEncodingFloat && !skipping_silence_
+            ? output_float
+            : resampled_block_.data();
+    frame_count = Resample(block, frame_count, resampled);
+    block = resampled;
+  }
+  if (block == output_float) {
+    return static_cast<size_t>(frame_count) * output_channel_count_ *
+           sizeof(float);
+  }
+  if (skipping_silence_) {
+    return PackSkippingSilence(block, frame_count, output);
+  }
+  return Pack(block, frame_count, output);
+}
+
+size_t AudioChain::PackSkippingSilence(const float* block, int frame_count,
+                                       uint8_t* output) {
+  const size_t frame_size =
+      output_channel_count_ * GetBytesPerSample(output_encoding_);
+  const float peak =
+      GetKernels().find_peak(block, frame_count * output_channel_count_);
+  if (peak > config_.silence_threshold) {
+    // The run of silence, if any, has ended. What's left of it is output
+    // before the block.
+    const size_t held_size = held_silence_.size();
+    if (held_size > 0) {
+      std::memcpy(output, held_silence_.data(), held_size);
+      held_silence_.clear();
+    }
+    silent_frame_count_ = 0;
+    return held_size + Pack(block, frame_count, output + held_size);
+  }
+  // The leading padding of the run is output directly, and the rest is held
+  // back.
+  const int direct_frames = static_cast<int>(std::max<int64_t>(
+      0, std::min<int64_t>(frame_count,
+                           padding_frames_ - silent_frame_count_)));
+  silent_frame_count_ += frame_count;
+  const size_t written = Pack(block, direct_frames, output);
+  const int held_frames = frame_count - direct_frames;
+  if (held_frames > 0) {
+    const size_t held_size = held_silence_.size();
+    held_silence_.resize(held_size + held_frames * frame_size);
+    Pack(block + direct_frames * output_channel_count_, held_frames,
+         held_silence_.data() + held_size);
+  }
+  if (silent_frame_count_ >= min_silence_frames_) {
+    // Only the trailing padding is kept.
+    const size_t kept_size = static_cast<size_t>(padding_frames_) * frame_size;
+    const size_t held_size = held_silence_.size();
+    if (held_size > kept_size) {
+      held_silence_.erase(held_silence_.begin(),
+                          held_silence_.begin() + (held_size - kept_size));
+      skipped_frame_count_ +=
+          static_cast<int>((held_size - kept_size) / frame_size);
+    }
+  }
+  return written;
+}
+
+}  // namespace exoplayer_jni
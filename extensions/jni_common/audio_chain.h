@@ -0,0 +1,295 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_AUDIO_CHAIN_H_
+#define EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_AUDIO_CHAIN_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "loudness_meter.h"  // NOLINT
+#include "spectrum_analyzer.h"  // NOLINT
+#include "time_stretcher.h"  // NOLINT
+#include "waveform_builder.h"  // NOLINT
+
+namespace exoplayer_jni {
+
+// Sample formats of the PCM that an AudioChain reads and writes. Samples are in
+// native byte order, and 24-bit samples are packed into three bytes.
+enum PcmEncoding {
+  kPcmEncodingInvalid = 0,
+  kPcmEncoding16Bit = 1,
+  kPcmEncoding24Bit = 2,
+  kPcmEncoding32Bit = 3,
+  kPcmEncodingFloat = 4
+};
+
+// Returns the number of bytes per sample of |encoding|, or 0 if it's invalid.
+int GetBytesPerSample(PcmEncoding encoding);
+
+// Reads |sample_count| samples in |encoding| from |input| into |output| as
+// floats, normalized so that integer samples are in [-1, 1).
+void UnpackPcm(const uint8_t* input, PcmEncoding encoding, int sample_count,
+               float* output);
+
+// Writes |sample_count| float samples from |input| to |output| in |encoding|,
+// clamping and rounding integer samples as an AudioChain's output is. Returns
+// the number of bytes written.
+size_t PackPcm(const float* input, PcmEncoding encoding, int sample_count,
+               uint8_t* output);
+
+// The output that an AudioChain produces from the decoder's output.
+struct AudioChainConfig {
+  static const int kMaxChannels = 8;
+
+  // The number of output channels, or 0 to output the input channels
+  // unchanged.
+  int channel_count = 0;
+  // For each output channel, the index of the input channel it's read from.
+  int channel_map[kMaxChannels] = {};
+  // The gain applied to every sample, as a linear factor.
+  float gain = 1;
+  // The factor by which playback is sped up, without changing the pitch.
+  float speed = 1;
+  // The factor by which the pitch is raised, without changing the duration.
+  float pitch = 1;
+  // The output sample rate, or 0 to keep the input sample rate.
+  int sample_rate = 0;
+  // The output encoding, or kPcmEncodingInvalid to keep the input encoding.
+  PcmEncoding encoding = kPcmEncodingInvalid;
+  // The level at or below which output samples are silent, as a linear
+  // magnitude.
+  float silence_threshold = 0;
+  // The duration of silence after which the rest of the silence is skipped, or
+  // 0 to output silence unchanged.
+  int64_t min_silence_us = 0;
+  // The duration of silence kept at each end of a skipped run of silence. At
+  // most |min_silence_us|.
+  int64_t silence_padding_us = 0;
+  // Whether to measure the integrated loudness of the decoded audio.
+  bool measure_loudness = false;
+  // The number of frames per waveform peak, or 0 to output audio. If positive,
+  // the audio is reduced to waveform peaks instead of being output.
+  int waveform_frames_per_peak = 0;
+  // The number of frames in each spectrum of the spectrum tap, or 0 if the
+  // spectrum isn't analyzed.
+  int spectrum_fft_size = 0;
+};
+
+// Processes the PCM output by an audio decoder before it's returned to Java,
+// so that channel mapping, gain, time stretching, sample rate conversion and
+// sample format conversion don't each need a pass over the buffer in an
+// AudioProcessor.
+//
+// The stages are fused: the input is processed in blocks that fit in the L1
+// cache, and each block is read once, remapped, scaled and converted to float,
+// time stretched if the speed or pitch changes, resampled if the sample rate
+// or pitch changes, and written once in the output encoding. The 16-bit
+// conversions use the SIMD kernels from GetKernels(). Sample rates are
+// converted by linear interpolation, as Sonic does. The pitch is changed by
+// stretching the audio by the pitch and resampling it back to its duration.
+//
+// If silence skipping is enabled, the peak of each output block is measured
+// with GetKernels().find_peak while the block is in the cache, and runs of
+// silence longer than the minimum duration are shortened to the padding at
+// each end, as SilenceSkippingAudioProcessor does, without another pass over
+// the output. Silence that may be skipped is held back until the run either
+// ends or becomes long enough to skip, so it's output by a later call, and is
+// dropped at the end of the stream.
+//
+// If loudness measurement is enabled, each block is also fed to a
+// LoudnessMeter after it's unpacked, at the input sample rate and with the
+// output channels.
+//
+// If the spectrum tap is enabled, each block is also added to a
+// SpectrumAnalyzer after it's unpacked, from which visualizers on other threads
+// compute spectra of the latest audio.
+//
+// If waveform peaks are requested, each unpacked block is reduced by a
+// WaveformBuilder instead of being stretched, resampled and packed, and the
+// peaks completed by each call are output as WaveformBuilder::kValuesPerPeak
+// floats each instead of the audio, so that a waveform can be drawn from the
+// decoded audio without returning the audio to Java. The speed, pitch, sample
+// rate, encoding and silence settings don't apply.
+//
+// Not thread-safe. Each decoder owns its chain and uses it on its decoding
+// thread.
+class AudioChain {
+ public:
+  AudioChain();
+
+  // Not copyable or movable.
+  AudioChain(const AudioChain&) = delete;
+  AudioChain& operator=(const AudioChain&) = delete;
+
+  // Sets the output to produce. Takes effect at the next call to Configure().
+  void SetConfig(const AudioChainConfig& config);
+
+  // Returns whether a configuration has been set.
+  bool has_config() const { return has_config_; }
+
+  // Configures the chain for input with |channel_count| channels at
+  // |sample_rate|, with samples in |encoding|, and resets it. Returns false if
+  // the configuration can't be applied to the input, for example because the
+  // channel map refers to a channel that the input doesn't have.
+  bool Configure(int channel_count, int sample_rate, PcmEncoding encoding);
+
+  // Returns whether the chain was configured for input in this format, in
+  // which case it doesn't need to be configured again.
+  bool IsConfiguredFor(int channel_count, int sample_rate,
+                       PcmEncoding encoding) const;
+
+  // Returns whether processing copies the input unchanged, in which case the
+  // decoder should write its output directly instead.
+  bool IsPassthrough() const { return passthrough_; }
+
+  int output_channel_count() const { return output_channel_count_; }
+  int output_sample_rate() const { return output_sample_rate_; }
+  PcmEncoding output_encoding() const { return output_encoding_; }
+
+  // Returns whether the audio is reduced to waveform peaks instead of being
+  // output.
+  bool IsReducingToWaveform() const { return reducing_to_waveform_; }
+  // Returns the builder that the audio is reduced by. Decoders use it to set
+  // the frame range and position, and to complete the last peak at the end of
+  // the stream.
+  WaveformBuilder* waveform() { return &waveform_; }
+  // Returns the analyzer that the spectrum tap adds the audio to. Unlike the
+  // chain, it may be used from any thread.
+  SpectrumAnalyzer* spectrum() { return &spectrum_; }
+  // Returns the maximum number of bytes that processing |frame_count| input
+  // frames can output, including silence held back by previous calls.
+  size_t GetMaxOutputSize(int frame_count) const;
+
+  // Returns the number of output frames of silence that the last call to
+  // Process() or ProcessPlanar() skipped.
+  int skipped_frame_count() const { return skipped_frame_count_; }
+
+  // Returns the integrated loudness in LUFS of the audio processed since the
+  // chain was configured, before the gain was applied, or -infinity if it's
+  // not measured or no audio was loud enough to be measured.
+  double GetIntegratedLoudness() const;
+
+  // Processes |frame_count| interleaved input frames, writing the output to
+  // |output|, which mustn't overlap the input. Returns the number of bytes
+  // written, or -1 if |output_size| is less than
+  // GetMaxOutputSize(frame_count).
+  int Process(const void* input, int frame_count, void* output,
+              size_t output_size);
+
+  // As Process(), for planar input of 32-bit samples holding |bits_per_sample|
+  // significant bits, as decoded by libFLAC. The encoding passed to
+  // Configure() is the encoding the decoder outputs without the chain, which
+  // is only used if the configuration keeps the input encoding.
+  int ProcessPlanar(const int32_t* const* input, int bits_per_sample,
+                    int frame_count, void* output, size_t output_size);
+
+  // Resets the time stretcher's and sample rate converter's state, and discards
+  // held back silence and the spectrum tap's audio. Called when the decoder is
+  // flushed, so that samples from before a seek aren't mixed with samples after
+  // it. The loudness measured so far is kept.
+  void Reset();
+
+ private:
+  // The number of frames in each block.
+  static const int kBlockFrames = 256;
+
+  // Reads |frame_count| frames starting at |first_frame| into |block| as
+  // float, in the output channel order and with the gain applied.
+  void UnpackInterleaved(const uint8_t* input, int first_frame,
+                         int frame_count, float* block) const;
+  void UnpackPlanar(const int32_t* const* input, int bits_per_sample,
+                    int first_frame, int frame_count, float* block) const;
+  // Returns the maximum number of frames that resampling |frame_count| frames
+  // can output, in one call to Resample() or split over several.
+  int64_t GetMaxResampledFrameCount(int64_t frame_count) const;
+  // Resamples |frame_count| frames in |block| into |output|, returning the
+  // number of output frames.
+  int Resample(const float* block, int frame_count, float* output);
+  // Writes |frame_count| frames from |block| to |output| in the output
+  // encoding, returning the number of bytes written.
+  size_t Pack(const float* block, int frame_count, uint8_t* output) const;
+  // Time stretches, resamples and packs |frame_count| unpacked frames in
+  // |block|, returning the number of bytes written to |output|. |block| may
+  // point to |output| if the output is float and neither the duration nor the
+  // sample rate is changed.
+  size_t FinishBlock(const float* block, int frame_count, uint8_t* output);
+  // Packs |frame_count| frames from |block| to |output|, skipping silence.
+  // Returns the number of bytes written, which may include held back silence.
+  size_t PackSkippingSilence(const float* block, int frame_count,
+                             uint8_t* output);
+  // Writes the completed waveform peaks to |output| and removes them from the
+  // builder, returning the number of bytes written.
+  size_t TakeWaveformPeaks(uint8_t* output);
+  // Returns where the next block should be unpacked, given that its output is
+  // written to |output|.
+  float* GetBlock(uint8_t* output);
+
+  bool has_config_;
+  AudioChainConfig config_;
+
+  int input_channel_count_;
+  int input_sample_rate_;
+  PcmEncoding input_encoding_;
+  int output_channel_count_;
+  int output_sample_rate_;
+  PcmEncoding output_encoding_;
+  int channel_map_[AudioChainConfig::kMaxChannels];
+  // The factor that interleaved input samples are multiplied by, which
+  // normalizes integer samples to [-1, 1) and applies the gain.
+  float input_scale_;
+  bool identity_map_;
+  bool passthrough_;
+  bool stretching_;
+  bool resampling_;
+  bool skipping_silence_;
+  bool measuring_loudness_;
+  bool reducing_to_waveform_;
+  bool analyzing_spectrum_;
+
+  TimeStretcher time_stretcher_;
+  LoudnessMeter loudness_meter_;
+  WaveformBuilder waveform_;
+  SpectrumAnalyzer spectrum_;
+
+  // Linear interpolation state. The position of the next output frame, in
+  // input frames relative to the start of the next block, as 32.32 fixed
+  // point. A position of -1 refers to |last_frame_|, the last frame of the
+  // previous block.
+  int64_t resample_position_;
+  int64_t resample_step_;
+  float last_frame_[AudioChainConfig::kMaxChannels];
+
+  // Silence skipping state, in output frames. |silent_frame_count_| is the
+  // length of the current run of silence, whose frames after the leading
+  // padding are held back in |held_silence_| in the output encoding until it
+  // ends or is long enough to skip.
+  int64_t min_silence_frames_;
+  int64_t padding_frames_;
+  int64_t silent_frame_count_;
+  int skipped_frame_count_;
+  std::vector<uint8_t> held_silence_;
+
+  std::vector<float> block_;
+  std::vector<float> stretched_block_;
+  std::vector<float> resampled_block_;
+};
+
+}  // namespace exoplayer_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_AUDIO_CHAIN_H_
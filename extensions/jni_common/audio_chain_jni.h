@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_AUDIO_CHAIN_JNI_H_
+#define EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_AUDIO_CHAIN_JNI_H_
+
+#include <jni.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "audio_chain.h"      // NOLINT
+#include "crossfade_mixer.h"  // NOLINT
+
+namespace exoplayer_jni {
+
+// PCM encoding constants of com.google.android.exoplayer2.C.
+// LINT.IfChange
+const jint kJavaEncodingInvalid = 0;
+const jint kJavaEncodingPcm16Bit = 2;
+const jint kJavaEncodingPcmFloat = 4;
+const jint kJavaEncodingPcm24Bit = 0x20000000;
+const jint kJavaEncodingPcm32Bit = 0x30000000;
+// LINT.ThenChange(../../library/common/src/main/java/com/google/android/exoplayer2/C.java)
+
+// Returns the PcmEncoding of a C.ENCODING_* constant, or kPcmEncodingInvalid if
+// it isn't supported.
+inline PcmEncoding GetPcmEncoding(jint encoding) {
+  switch (encoding) {
+    case kJavaEncodingPcm16Bit:
+      return kPcmEncoding16Bit;
+    case kJavaEncodingPcm24Bit:
+      return kPcmEncoding24Bit;
+    case kJavaEncodingPcm32Bit:
+      return kPcmEncoding32Bit;
+    case kJavaEncodingPcmFloat:
+      return kPcmEncodingFloat;
+    default:
+      return kPcmEncodingInvalid;
+  }
+}
+
+// Sets the configuration of |chain| from the fields of an AudioChainConfig, as
+// passed to a decoder's native setAudioChainConfig method. |channel_map| is
+// null to keep the input channels, and |sample_rate| and |encoding| are
+// Format.NO_VALUE and C.ENCODING_INVALID to keep the input's. A
+// |min_silence_us| of 0 disables silence skipping, a
+// |waveform_frames_per_peak| of 0 outputs audio rather than waveform peaks, and
+// a |spectrum_fft_size| of 0 disables the spectrum tap. Returns false if the
+// configuration isn't supported.
+inline bool SetAudioChainConfig(JNIEnv* env, jintArray channel_map,
+                                jfloat gain, jfloat speed, jfloat pitch,
+                                jlong min_silence_us, jlong silence_padding_us,
+                                jfloat silence_threshold,
+                                jboolean measure_loudness,
+                                jint waveform_frames_per_peak,
+                                jint spectrum_fft_size, jint sample_rate,
+                                jint encoding, AudioChain* chain) {
+  AudioChainConfig config;
+  if (channel_map != NULL) {
+    config.channel_count = env->GetArrayLength(channel_map);
+    if (config.channel_count <= 0 ||
+        config.channel_count > AudioChainConfig::kMaxChannels) {
+      return false;
+    }
+    env->GetIntArrayRegion(channel_map, 0, config.channel_count,
+                           reinterpret_cast<jint*>(config.channel_map));
+  }
+  config.gain = gain;
+  config.speed = speed;
+  config.pitch = pitch;
+  config.silence_threshold = silence_threshold;
+  config.min_silence_us = min_silence_us;
+  config.silence_padding_us = silence_padding_us;
+  config.measure_loudness = measure_loudness;
+  config.waveform_frames_per_peak = waveform_frames_per_peak;
+  config.spectrum_fft_size = spectrum_fft_size;
+  config.sample_rate = sample_rate > 0 ? sample_rate : 0;
+  config.encoding = GetPcmEncoding(encoding);
+  if (encoding != kJavaEncodingInvalid &&
+      config.encoding == kPcmEncodingInvalid) {
+    return false;
+  }
+  chain->SetConfig(config);
+  return true;
+}
+
+// Returns the integrated loudness measured by |chain| as it's published in the
+// decoders' status blocks, in thousandths of LUFS, or INT64_MIN if it's not
+// measured or nothing was loud enough to be measured.
+inline int64_t GetLoudnessStatus(const AudioChain& chain) {
+  const double loudness = chain.GetIntegratedLoudness();
+  return std::isinf(loudness) ? INT64_MIN
+                              : static_cast<int64_t>(std::lround(
+                                    loudness * 1000));
+}
+
+// Completes the last peak of |waveform| at the end of the stream, and moves as
+// many of its remaining peaks as fit to |peaks|, as passed to a decoder's
+// native finishWaveform method. Earlier peaks are output by the decoder with
+// each output buffer. Returns the number of peaks moved.
+inline jint FinishWaveform(JNIEnv* env, WaveformBuilder* waveform,
+                           jfloatArray peaks) {
+  waveform->Finish();
+  const int capacity =
+      env->GetArrayLength(peaks) / WaveformBuilder::kValuesPerPeak;
+  const jint peak_count = std::min(waveform->peak_count(), capacity);
+  env->SetFloatArrayRegion(peaks, 0,
+                           peak_count * WaveformBuilder::kValuesPerPeak,
+                           waveform->peaks());
+  waveform->RemovePeaks(peak_count);
+  return peak_count;
+}
+
+// Computes the levels of the recent audio analyzed by |spectrum| into |bands|,
+// as passed to a decoder's native getSpectrum method. Returns false, leaving
+// |bands| unchanged, if the spectrum tap is disabled or hasn't analyzed enough
+// audio since the last reset.
+inline jboolean GetSpectrum(JNIEnv* env, SpectrumAnalyzer* spectrum,
+                            jfloatArray bands) {
+  const int band_count = env->GetArrayLength(bands);
+  std::vector<float> levels(band_count);
+  if (!spectrum->ComputeBands(levels.data(), band_count)) {
+    return false;
+  }
+  env->SetFloatArrayRegion(bands, 0, band_count, levels.data());
+  return true;
+}
+
+// Implements a decoder's native setCrossfade method. Sets the duration and
+// curve of the CrossfadeMixer at |mixer|, creating a mixer if it's 0. Returns
+// the mixer, or 0 if the arguments are invalid.
+inline jlong SetCrossfade(jlong mixer, jlong duration_us, jint curve) {
+  CrossfadeMixer* crossfade_mixer = reinterpret_cast<CrossfadeMixer*>(mixer);
+  std::unique_ptr<CrossfadeMixer> new_mixer;
+  if (crossfade_mixer == NULL) {
+    new_mixer.reset(new CrossfadeMixer());
+    crossfade_mixer = new_mixer.get();
+  }
+  if (!crossfade_mixer->Configure(duration_us,
+                                  static_cast<CrossfadeCurve>(curve))) {
+    return 0;
+  }
+  new_mixer.release();
+  return reinterpret_cast<intptr_t>(crossfade_mixer);
+}
+
+// Implements a decoder's native crossfade method, which processes |size|
+// bytes of output from |offset| in the direct buffer |data|. See
+// CrossfadeMixer::Process.
+inline jint Crossfade(JNIEnv* env, jlong mixer, jobject data, jint offset,
+                      jint size, jint channel_count, jint sample_rate,
+                      jint encoding) {
+  uint8_t* buffer = static_cast<uint8_t*>(env->GetDirectBufferAddress(data));
+  if (buffer == NULL || offset < 0 || size < 0 ||
+      offset > env->GetDirectBufferCapacity(data) - size) {
+    return -1;
+  }
+  return reinterpret_cast<CrossfadeMixer*>(mixer)->Process(
+      buffer + offset, size, channel_count, sample_rate,
+      GetPcmEncoding(encoding));
+}
+
+// Implements a decoder's native drainCrossfade method, which drains up to
+// |capacity| bytes into the direct buffer |output|. See CrossfadeMixer::Drain.
+inline jint DrainCrossfade(JNIEnv* env, jlong mixer, jobject output,
+                           jint capacity) {
+  uint8_t* buffer = static_cast<uint8_t*>(env->GetDirectBufferAddress(output));
+  if (buffer == NULL || capacity > env->GetDirectBufferCapacity(output)) {
+    return -1;
+  }
+  return reinterpret_cast<CrossfadeMixer*>(mixer)->Drain(buffer, capacity);
+}
+
+}  // namespace exoplayer_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_AUDIO_CHAIN_JNI_H_
@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "audio_kernels.h"  // NOLINT
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace exoplayer_jni {
+
+void InterleavePcmC(int8_t* destination, const int32_t* const* source,
+                    unsigned bytes_per_sample, unsigned sample_count,
+                    unsigned channel_count) {
+  if (bytes_per_sample == 2) {
+    int16_t* destination_16 = reinterpret_cast<int16_t*>(destination);
+    for (unsigned i = 0; i < sample_count; ++i) {
+      for (unsigned c = 0; c < channel_count; ++c) {
+        *destination_16++ = static_cast<int16_t>(source[c][i]);
+      }
+    }
+    return;
+  }
+  for (unsigned i = 0; i < sample_count; ++i) {
+    for (unsigned c = 0; c < channel_count; ++c) {
+      // With little endian, the most significant bytes are at the end, so
+      // copying the first bytes drops the unused most significant bytes.
+      std::memcpy(destination, &source[c][i], bytes_per_sample);
+      destination += bytes_per_sample;
+    }
+  }
+}
+
+void ConvertPcm16ToFloatC(const int16_t* source, float* destination,
+                          unsigned sample_count, float scale) {
+  for (unsigned i = 0; i < sample_count; ++i) {
+    destination[i] = source[i] * scale;
+  }
+}
+
+void ConvertFloatToPcm16C(const float* source, int16_t* destination,
+                          unsigned sample_count) {
+  for (unsigned i = 0; i < sample_count; ++i) {
+    float sample = source[i] * 32768.0f;
+    sample = sample < -32768.0f ? -32768.0f : sample;
+    sample = sample > 32767.0f ? 32767.0f : sample;
+    // Adding a half with the sample's sign and truncating rounds half away
+    // from zero, which the SIMD implementations can do in the same way.
+    destination[i] =
+        static_cast<int16_t>(sample + (std::signbit(sample) ? -0.5f : 0.5f));
+  }
+}
+
+float DotProductC(const float* a, const float* b, unsigned sample_count) {
+  float sums[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  const unsigned i_max = sample_count & ~7u;
+  unsigned i;
+  for (i = 0; i < i_max; i += 8) {
+    for (unsigned j = 0; j < 8; ++j) {
+      sums[j] += a[i + j] * b[i + j];
+    }
+  }
+  float sum = ((sums[0] + sums[4]) + (sums[2] + sums[6])) +
+              ((sums[1] + sums[5]) + (sums[3] + sums[7]));
+  for (; i < sample_count; ++i) {
+    sum += a[i] * b[i];
+  }
+  return sum;
+}
+
+float FindPeakC(const float* samples, unsigned sample_count) {
+  float peak = 0;
+  for (unsigned i = 0; i < sample_count; ++i) {
+    peak = std::max(peak, std::fabs(samples[i]));
+  }
+  return peak;
+}
+
+SampleSummary SummarizeSamplesC(const float* samples, unsigned sample_count) {
+  if (sample_count == 0) {
+    return {0, 0, 0};
+  }
+  float min = samples[0];
+  float max = samples[0];
+  float sums[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  const unsigned i_max = sample_count & ~7u;
+  unsigned i;
+  for (i = 0; i < i_max; i += 8) {
+    for (unsigned j = 0; j < 8; ++j) {
+      const float sample = samples[i + j];
+      min = std::min(min, sample);
+      max = std::max(max, sample);
+      sums[j] += sample * sample;
+    }
+  }
+  float sum = ((sums[0] + sums[4]) + (sums[2] + sums[6])) +
+              ((sums[1] + sums[5]) + (sums[3] + sums[7]));
+  for (; i < sample_count; ++i) {
+    min = std::min(min, samples[i]);
+    max = std::max(max, samples[i]);
+    sum += samples[i] * samples[i];
+  }
+  return {min, max, sum};
+}
+
+void FftStageC(float* real, float* imag, const float* twiddle_real,
+               const float* twiddle_imag, unsigned size, unsigned half_size) {
+  for (unsigned start = 0; start < size; start += 2 * half_size) {
+    float* const real_low = real + start;
+    float* const imag_low = imag + start;
+    float* const real_high = real_low + half_size;
+    float* const imag_high = imag_low + half_size;
+    for (unsigned j = 0; j < half_size; ++j) {
+      const float product_real =
+          twiddle_real[j] * real_high[j] - twiddle_imag[j] * imag_high[j];
+      const float product_imag =
+          twiddle_real[j] * imag_high[j] + twiddle_imag[j] * real_high[j];
+      real_high[j] = real_low[j] - product_real;
+      imag_high[j] = imag_low[j] - product_imag;
+      real_low[j] += product_real;
+      imag_low[j] += product_imag;
+    }
+  }
+}
+
+void InitDitherState(DitherState* state, bool noise_shaping) {
+  // Arbitrary nonzero seeds, since a xorshift generator never leaves zero.
+  state->random[0] = 0x9e3779b9u;
+  state->random[1] = 0x7f4a7c15u;
+  state->random[2] = 0xf39cc060u;
+  state->random[3] = 0x5cedc834u;
+  state->noise_shaping = noise_shaping;
+  std::fill(state->error, state->error + DitherState::kMaxChannels, 0);
+}
+
+void DitherPcm16C(int16_t* destination, const int32_t* const* source,
+                  unsigned bits_per_sample, unsigned sample_count,
+                  unsigned channel_count, DitherState* state) {
+  // A 16-bit step is 1 << shift source units. The dither is the sum of two
+  // uniform values in [0, step), less half a step so that the arithmetic shift
+  // rounds to nearest on average.
+  const unsigned shift = bits_per_sample - 16;
+  const int64_t step = int64_t{1} << shift;
+  const int64_t half_step = step >> 1;
+  unsigned k = 0;
+  for (unsigned i = 0; i < sample_count; ++i) {
+    for (unsigned c = 0; c < channel_count; ++c, ++k) {
+      uint32_t random = state->random[k % 4];
+      random ^= random << 13;
+      random ^= random >> 17;
+      random ^= random << 5;
+      state->random[k % 4] = random;
+      const int64_t dither = static_cast<int64_t>(
+                                 ((random & 0xffff) >> (16 - shift)) +
+                                 (random >> (32 - shift))) -
+                             half_step;
+      int64_t sample = source[c][i];
+      if (state->noise_shaping) {
+        sample -= state->error[c];
+      }
+      const int64_t requantized = (sample + dither) >> shift;
+      if (state->noise_shaping) {
+        // The error is fed back before clamping, so that clipping doesn't
+        // accumulate in it.
+        state->error[c] = static_cast<int32_t>(requantized * step - sample);
+      }
+      *destination++ = static_cast<int16_t>(
+          std::min<int64_t>(std::max<int64_t>(requantized, -32768), 32767));
+    }
+  }
+}
+
+void InterleavePcmBigEndian(int8_t* destination, const int32_t* const* source,
+                            unsigned bytes_per_sample, unsigned sample_count,
+                            unsigned channel_count) {
+  for (unsigned i = 0; i < sample_count; ++i) {
+    for (unsigned c = 0; c < channel_count; ++c) {
+      // With big endian, the most significant bytes are at the start, so the
+      // unused most significant bytes are skipped.
+      const int8_t* source_bytes =
+          reinterpret_cast<const int8_t*>(&source[c][i]) + 4 - bytes_per_sample;
+      std::memcpy(destination, source_bytes, bytes_per_sample);
+      destination += bytes_per_sample;
+    }
+  }
+}
+
+}  // namespace exoplayer_jni
@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_AUDIO_KERNELS_H_
+#define EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_AUDIO_KERNELS_H_
+
+#include <cstdint>
+
+namespace exoplayer_jni {
+
+// Interleaves |sample_count| samples from each of the |channel_count| planar
+// 32-bit channels in |source| into |destination|, as little endian samples of
+// |bytes_per_sample| bytes. The source samples must fit in |bytes_per_sample|.
+typedef void (*InterleavePcmFunction)(int8_t* destination,
+                                      const int32_t* const* source,
+                                      unsigned bytes_per_sample,
+                                      unsigned sample_count,
+                                      unsigned channel_count);
+
+// Converts |sample_count| 16-bit samples in |source| to floats in
+// |destination|, multiplying each by |scale|.
+typedef void (*ConvertPcm16ToFloatFunction)(const int16_t* source,
+                                            float* destination,
+                                            unsigned sample_count,
+                                            float scale);
+
+// Converts |sample_count| float samples in |source|, nominally in [-1, 1), to
+// 16-bit samples in |destination|. Samples are scaled by 32768, clamped to the
+// 16-bit range and rounded half away from zero, so that every implementation
+// produces the same output.
+typedef void (*ConvertFloatToPcm16Function)(const float* source,
+                                            int16_t* destination,
+                                            unsigned sample_count);
+
+// Returns the dot product of |sample_count| samples in |a| and |b|. Products
+// are summed in eight interleaved partial sums, which are combined as
+// ((s0 + s4) + (s2 + s6)) + ((s1 + s5) + (s3 + s7)) before the products of the
+// last sample_count % 8 samples are added in order, so that the SIMD
+// implementations sum in the same order as the portable one. Results may still
+// differ in the last bits where the compiler fuses multiplies and adds.
+typedef float (*DotProductFunction)(const float* a, const float* b,
+                                    unsigned sample_count);
+
+// Returns the largest magnitude of |sample_count| float samples, or 0 if
+// |sample_count| is 0. Used to detect silence in decoded audio. The result is
+// exact, so all implementations return the same value for samples that aren't
+// NaN.
+typedef float (*FindPeakFunction)(const float* samples, unsigned sample_count);
+
+// The range and energy of a run of float samples.
+struct SampleSummary {
+  float min;
+  float max;
+  float sum_squares;
+};
+
+// Returns the smallest and largest of |sample_count| float samples and the sum
+// of their squares, or zeros if |sample_count| is 0. Used to reduce decoded
+// audio to waveform peaks. The minimum and maximum are exact, and the squares
+// are summed in the order that DotProductFunction sums products, so the SIMD
+// implementations only differ from the portable one where the compiler fuses
+// multiplies and adds.
+typedef SampleSummary (*SummarizeSamplesFunction)(const float* samples,
+                                                  unsigned sample_count);
+
+// Applies one radix-2 decimation in time stage to a complex FFT of |size|
+// points, whose real and imaginary parts are in |real| and |imag|. Each run of
+// 2 * |half_size| points is combined from its two halves with the stage's
+// |half_size| twiddle factors. The butterflies are independent, so the SIMD
+// implementations compute the same products and sums as the portable one, and
+// only differ where the compiler fuses multiplies and adds.
+typedef void (*FftStageFunction)(float* real, float* imag,
+                                 const float* twiddle_real,
+                                 const float* twiddle_imag, unsigned size,
+                                 unsigned half_size);
+
+// The state of a DitherPcm16Function, which carries over from one block to the
+// next. Initialized with InitDitherState().
+struct DitherState {
+  static const unsigned kMaxChannels = 8;
+
+  // Four xorshift32 generators. Sample k of each call's interleaved output
+  // takes its dither from generator k % 4, which it advances once, so that the
+  // SIMD implementations can advance the generators four lanes at a time.
+  uint32_t random[4];
+  // Whether the requantization error is fed back, shaping the noise.
+  bool noise_shaping;
+  // The requantization error of each channel's previous sample, in source
+  // units, if |noise_shaping| is true.
+  int32_t error[kMaxChannels];
+};
+
+// Initializes |state| with fixed seeds, and no error to feed back.
+void InitDitherState(DitherState* state, bool noise_shaping);
+
+// Interleaves |sample_count| samples from each of the |channel_count| planar
+// 32-bit channels in |source|, which hold |bits_per_sample|-bit samples, into
+// |destination| as 16-bit samples. Samples are requantized with triangular
+// (TPDF) dither of plus or minus one 16-bit step, and rounded. If the state's
+// |noise_shaping| is set, each channel's previous requantization error is also
+// subtracted, which moves the noise towards high frequencies. Results are
+// clamped to the 16-bit range. |bits_per_sample| must be between 17 and 32 and
+// |channel_count| at most DitherState::kMaxChannels. The dither is generated as
+// DitherState describes, so every implementation produces the same output.
+typedef void (*DitherPcm16Function)(int16_t* destination,
+                                    const int32_t* const* source,
+                                    unsigned bits_per_sample,
+                                    unsigned sample_count,
+                                    unsigned channel_count,
+                                    DitherState* state);
+
+// Portable implementations.
+void InterleavePcmC(int8_t* destination, const int32_t* const* source,
+                    unsigned bytes_per_sample, unsigned sample_count,
+                    unsigned channel_count);
+void ConvertPcm16ToFloatC(const int16_t* source, float* destination,
+                          unsigned sample_count, float scale);
+void ConvertFloatToPcm16C(const float* source, int16_t* destination,
+                          unsigned sample_count);
+float DotProductC(const float* a, const float* b, unsigned sample_count);
+float FindPeakC(const float* samples, unsigned sample_count);
+SampleSummary SummarizeSamplesC(const float* samples, unsigned sample_count);
+void FftStageC(float* real, float* imag, const float* twiddle_real,
+               const float* twiddle_imag, unsigned size, unsigned half_size);
+void DitherPcm16C(int16_t* destination, const int32_t* const* source,
+                  unsigned bits_per_sample, unsigned sample_count,
+                  unsigned channel_count, DitherState* state);
+
+// Big endian variant of InterleavePcmFunction, for big endian devices. The
+// output samples are big endian, and the source samples are in native (big
+// endian) byte order.
+void InterleavePcmBigEndian(int8_t* destination, const int32_t* const* source,
+                            unsigned bytes_per_sample, unsigned sample_count,
+                            unsigned channel_count);
+
+#if defined(__arm__) || defined(__aarch64__)
+// NEON implementation of the 16-bit mono and stereo cases. Other cases are
+// delegated to InterleavePcmC.
+void InterleavePcmNeon(int8_t* destination, const int32_t* const* source,
+                       unsigned bytes_per_sample, unsigned sample_count,
+                       unsigned channel_count);
+// NEON implementations of the 16-bit and float conversions.
+void ConvertPcm16ToFloatNeon(const int16_t* source, float* destination,
+                             unsigned sample_count, float scale);
+void ConvertFloatToPcm16Neon(const float* source, int16_t* destination,
+                             unsigned sample_count);
+// NEON implementation of the dot product.
+float DotProductNeon(const float* a, const float* b, unsigned sample_count);
+// NEON implementation of the peak search.
+float FindPeakNeon(const float* samples, unsigned sample_count);
+// NEON implementation of the sample summary.
+SampleSummary SummarizeSamplesNeon(const float* samples, unsigned sample_count);
+// NEON implementation of the FFT stage. Stages with fewer than four twiddle
+// factors are delegated to FftStageC.
+void FftStageNeon(float* real, float* imag, const float* twiddle_real,
+                  const float* twiddle_imag, unsigned size, unsigned half_size);
+// NEON implementation of the dithered 16-bit conversion of mono and stereo
+// samples of up to 24 bits, without noise shaping. Other cases are delegated to
+// DitherPcm16C.
+void DitherPcm16Neon(int16_t* destination, const int32_t* const* source,
+                     unsigned bits_per_sample, unsigned sample_count,
+                     unsigned channel_count, DitherState* state);
+#endif  // defined(__arm__) || defined(__aarch64__)
+
+#if defined(__i386__) || defined(__x86_64__)
+// SSE2 implementation of the 16-bit mono and stereo cases. Other cases are
+// delegated to InterleavePcmC.
+void InterleavePcmSse2(int8_t* destination, const int32_t* const* source,
+                       unsigned bytes_per_sample, unsigned sample_count,
+                       unsigned channel_count);
+// SSE2 implementations of the 16-bit and float conversions.
+void ConvertPcm16ToFloatSse2(const int16_t* source, float* destination,
+                             unsigned sample_count, float scale);
+void ConvertFloatToPcm16Sse2(const float* source, int16_t* destination,
+                             unsigned sample_count);
+// SSE2 implementation of the dot product.
+float DotProductSse2(const float* a, const float* b, unsigned sample_count);
+// SSE2 implementation of the peak search.
+float FindPeakSse2(const float* samples, unsigned sample_count);
+// SSE2 implementation of the sample summary.
+SampleSummary SummarizeSamplesSse2(const float* samples, unsigned sample_count);
+// SSE2 implementation of the FFT stage. Stages with fewer than four twiddle
+// factors are delegated to FftStageC.
+void FftStageSse2(float* real, float* imag, const float* twiddle_real,
+                  const float* twiddle_imag, unsigned size, unsigned half_size);
+// SSE2 implementation of the dithered 16-bit conversion of mono and stereo
+// samples of up to 24 bits, without noise shaping. Other cases are delegated to
+// DitherPcm16C.
+void DitherPcm16Sse2(int16_t* destination, const int32_t* const* source,
+                     unsigned bits_per_sample, unsigned sample_count,
+                     unsigned channel_count, DitherState* state);
+// SSSE3 implementation of the 24-bit mono and stereo cases. Other cases are
+// delegated to InterleavePcmSse2.
+void InterleavePcmSsse3(int8_t* destination, const int32_t* const* source,
+                        unsigned bytes_per_sample, unsigned sample_count,
+                        unsigned channel_count);
+#endif  // defined(__i386__) || defined(__x86_64__)
+
+}  // namespace exoplayer_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_AUDIO_KERNELS_H_
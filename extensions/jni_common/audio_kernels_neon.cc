@@ -0,0 +1,318 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "audio_kernels.h"  // NOLINT
+
+#if defined(__arm__) || defined(__aarch64__)
+
+#include <arm_neon.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace exoplayer_jni {
+
+void InterleavePcmNeon(int8_t* destination, const int32_t* const* source,
+                       unsigned bytes_per_sample, unsigned sample_count,
+                       unsigned channel_count) {
+  if (bytes_per_sample != 2 || channel_count > 2) {
+    InterleavePcmC(destination, source, bytes_per_sample, sample_count,
+                   channel_count);
+    return;
+  }
+  int16_t* destination_16 = reinterpret_cast<int16_t*>(destination);
+  const unsigned i_max = sample_count & ~7u;
+  unsigned i;
+  if (channel_count == 1) {
+    const int32_t* mono = source[0];
+    for (i = 0; i < i_max; i += 8) {
+      // Narrowing keeps the low 16 bits, which hold the whole sample.
+      const int16x8_t samples =
+          vcombine_s16(vmovn_s32(vld1q_s32(mono + i)),
+                       vmovn_s32(vld1q_s32(mono + i + 4)));
+      vst1q_s16(destination_16 + i, samples);
+    }
+    for (; i < sample_count; ++i) {
+      destination_16[i] = static_cast<int16_t>(mono[i]);
+    }
+    return;
+  }
+  const int32_t* left = source[0];
+  const int32_t* right = source[1];
+  for (i = 0; i < i_max; i += 8) {
+    int16x8x2_t samples;
+    samples.val[0] = vcombine_s16(vmovn_s32(vld1q_s32(left + i)),
+                                  vmovn_s32(vld1q_s32(left + i + 4)));
+    samples.val[1] = vcombine_s16(vmovn_s32(vld1q_s32(right + i)),
+                                  vmovn_s32(vld1q_s32(right + i + 4)));
+    // Stores the two vectors interleaved.
+    vst2q_s16(destination_16 + 2 * i, samples);
+  }
+  for (; i < sample_count; ++i) {
+    destination_16[2 * i] = static_cast<int16_t>(left[i]);
+    destination_16[2 * i + 1] = static_cast<int16_t>(right[i]);
+  }
+}
+
+void ConvertPcm16ToFloatNeon(const int16_t* source, float* destination,
+                             unsigned sample_count, float scale) {
+  const unsigned i_max = sample_count & ~7u;
+  unsigned i;
+  for (i = 0; i < i_max; i += 8) {
+    const int16x8_t samples = vld1q_s16(source + i);
+    vst1q_f32(destination + i,
+              vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(samples))),
+                          scale));
+    vst1q_f32(destination + i + 4,
+              vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(samples))),
+                          scale));
+  }
+  ConvertPcm16ToFloatC(source + i, destination + i, sample_count - i, scale);
+}
+
+namespace {
+
+// Converts four float samples to 16-bit samples, as ConvertFloatToPcm16C
+// does.
+inline int16x4_t ConvertFloatToPcm16x4(const float* source) {
+  float32x4_t samples = vmulq_n_f32(vld1q_f32(source), 32768.0f);
+  samples = vmaxq_f32(samples, vdupq_n_f32(-32768.0f));
+  samples = vminq_f32(samples, vdupq_n_f32(32767.0f));
+  const uint32x4_t sign =
+      vandq_u32(vreinterpretq_u32_f32(samples), vdupq_n_u32(0x80000000u));
+  const float32x4_t half = vreinterpretq_f32_u32(
+      vorrq_u32(vreinterpretq_u32_f32(vdupq_n_f32(0.5f)), sign));
+  // The conversion truncates, so adding the signed half rounds half away from
+  // zero.
+  return vmovn_s32(vcvtq_s32_f32(vaddq_f32(samples, half)));
+}
+
+}  // namespace
+
+void ConvertFloatToPcm16Neon(const float* source, int16_t* destination,
+                             unsigned sample_count) {
+  const unsigned i_max = sample_count & ~7u;
+  unsigned i;
+  for (i = 0; i < i_max; i += 8) {
+    vst1q_s16(destination + i,
+              vcombine_s16(ConvertFloatToPcm16x4(source + i),
+                           ConvertFloatToPcm16x4(source + i + 4)));
+  }
+  ConvertFloatToPcm16C(source + i, destination + i, sample_count - i);
+}
+
+float DotProductNeon(const float* a, const float* b, unsigned sample_count) {
+  float32x4_t sums_low = vdupq_n_f32(0);
+  float32x4_t sums_high = vdupq_n_f32(0);
+  const unsigned i_max = sample_count & ~7u;
+  unsigned i;
+  for (i = 0; i < i_max; i += 8) {
+    sums_low = vmlaq_f32(sums_low, vld1q_f32(a + i), vld1q_f32(b + i));
+    sums_high =
+        vmlaq_f32(sums_high, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+  }
+  // Combines the partial sums in the order that DotProductC does.
+  const float32x4_t sums = vaddq_f32(sums_low, sums_high);
+  const float32x2_t pairs = vadd_f32(vget_low_f32(sums), vget_high_f32(sums));
+  float sum = vget_lane_f32(pairs, 0) + vget_lane_f32(pairs, 1);
+  for (; i < sample_count; ++i) {
+    sum += a[i] * b[i];
+  }
+  return sum;
+}
+
+float FindPeakNeon(const float* samples, unsigned sample_count) {
+  float32x4_t peaks_low = vdupq_n_f32(0);
+  float32x4_t peaks_high = vdupq_n_f32(0);
+  const unsigned i_max = sample_count & ~7u;
+  unsigned i;
+  for (i = 0; i < i_max; i += 8) {
+    peaks_low = vmaxq_f32(peaks_low, vabsq_f32(vld1q_f32(samples + i)));
+    peaks_high = vmaxq_f32(peaks_high, vabsq_f32(vld1q_f32(samples + i + 4)));
+  }
+  const float32x4_t peaks = vmaxq_f32(peaks_low, peaks_high);
+  const float32x2_t pairs =
+      vpmax_f32(vget_low_f32(peaks), vget_high_f32(peaks));
+  float peak = std::max(vget_lane_f32(pairs, 0), vget_lane_f32(pairs, 1));
+  for (; i < sample_count; ++i) {
+    peak = std::max(peak, std::fabs(samples[i]));
+  }
+  return peak;
+}
+
+SampleSummary SummarizeSamplesNeon(const float* samples,
+                                   unsigned sample_count) {
+  if (sample_count == 0) {
+    return {0, 0, 0};
+  }
+  const float32x4_t first = vdupq_n_f32(samples[0]);
+  float32x4_t mins_low = first;
+  float32x4_t mins_high = first;
+  float32x4_t maxs_low = first;
+  float32x4_t maxs_high = first;
+  float32x4_t sums_low = vdupq_n_f32(0);
+  float32x4_t sums_high = vdupq_n_f32(0);
+  const unsigned i_max = sample_count & ~7u;
+  unsigned i;
+  for (i = 0; i < i_max; i += 8) {
+    const float32x4_t low = vld1q_f32(samples + i);
+    const float32x4_t high = vld1q_f32(samples + i + 4);
+    mins_low = vminq_f32(mins_low, low);
+    mins_high = vminq_f32(mins_high, high);
+    maxs_low = vmaxq_f32(maxs_low, low);
+    maxs_high = vmaxq_f32(maxs_high, high);
+    sums_low = vmlaq_f32(sums_low, low, low);
+    sums_high = vmlaq_f32(sums_high, high, high);
+  }
+  const float32x4_t mins = vminq_f32(mins_low, mins_high);
+  const float32x2_t min_pairs =
+      vpmin_f32(vget_low_f32(mins), vget_high_f32(mins));
+  const float32x4_t maxs = vmaxq_f32(maxs_low, maxs_high);
+  const float32x2_t max_pairs =
+      vpmax_f32(vget_low_f32(maxs), vget_high_f32(maxs));
+  // Combines the partial sums in the order that SummarizeSamplesC does.
+  const float32x4_t sums = vaddq_f32(sums_low, sums_high);
+  const float32x2_t pairs = vadd_f32(vget_low_f32(sums), vget_high_f32(sums));
+  float min =
+      std::min(vget_lane_f32(min_pairs, 0), vget_lane_f32(min_pairs, 1));
+  float max =
+      std::max(vget_lane_f32(max_pairs, 0), vget_lane_f32(max_pairs, 1));
+  float sum = vget_lane_f32(pairs, 0) + vget_lane_f32(pairs, 1);
+  for (; i < sample_count; ++i) {
+    min = std::min(min, samples[i]);
+    max = std::max(max, samples[i]);
+    sum += samples[i] * samples[i];
+  }
+  return {min, max, sum};
+}
+
+void FftStageNeon(float* real, float* imag, const float* twiddle_real,
+                  const float* twiddle_imag, unsigned size,
+                  unsigned half_size) {
+  if (half_size < 4) {
+    FftStageC(real, imag, twiddle_real, twiddle_imag, size, half_size);
+    return;
+  }
+  // Stage sizes are powers of two, so each half holds whole vectors.
+  for (unsigned start = 0; start < size; start += 2 * half_size) {
+    float* const real_low = real + start;
+    float* const imag_low = imag + start;
+    float* const real_high = real_low + half_size;
+    float* const imag_high = imag_low + half_size;
+    for (unsigned j = 0; j < half_size; j += 4) {
+      const float32x4_t w_real = vld1q_f32(twiddle_real + j);
+      const float32x4_t w_imag = vld1q_f32(twiddle_imag + j);
+      const float32x4_t high_real = vld1q_f32(real_high + j);
+      const float32x4_t high_imag = vld1q_f32(imag_high + j);
+      const float32x4_t product_real =
+          vmlsq_f32(vmulq_f32(w_real, high_real), w_imag, high_imag);
+      const float32x4_t product_imag =
+          vmlaq_f32(vmulq_f32(w_real, high_imag), w_imag, high_real);
+      const float32x4_t low_real = vld1q_f32(real_low + j);
+      const float32x4_t low_imag = vld1q_f32(imag_low + j);
+      vst1q_f32(real_high + j, vsubq_f32(low_real, product_real));
+      vst1q_f32(imag_high + j, vsubq_f32(low_imag, product_imag));
+      vst1q_f32(real_low + j, vaddq_f32(low_real, product_real));
+      vst1q_f32(imag_low + j, vaddq_f32(low_imag, product_imag));
+    }
+  }
+}
+
+namespace {
+
+// Advances four xorshift32 generators, as DitherPcm16C does.
+inline uint32x4_t NextRandom(uint32x4_t random) {
+  random = veorq_u32(random, vshlq_n_u32(random, 13));
+  random = veorq_u32(random, vshrq_n_u32(random, 17));
+  return veorq_u32(random, vshlq_n_u32(random, 5));
+}
+
+// Requantizes four samples with the dither generated from |random|, as
+// DitherPcm16C does without noise shaping, and narrows them with saturation.
+// The shifts are negative, so that they shift right.
+inline int16x4_t DitherPcm16x4(int32x4_t samples, uint32x4_t random,
+                               int32x4_t shift, int32x4_t low_shift,
+                               int32x4_t high_shift, int32x4_t half_step) {
+  const uint32x4_t low =
+      vshlq_u32(vandq_u32(random, vdupq_n_u32(0xffff)), low_shift);
+  const uint32x4_t high = vshlq_u32(random, high_shift);
+  const int32x4_t dither =
+      vsubq_s32(vreinterpretq_s32_u32(vaddq_u32(low, high)), half_step);
+  return vqmovn_s32(vshlq_s32(vaddq_s32(samples, dither), shift));
+}
+
+}  // namespace
+
+void DitherPcm16Neon(int16_t* destination, const int32_t* const* source,
+                     unsigned bits_per_sample, unsigned sample_count,
+                     unsigned channel_count, DitherState* state) {
+  // Noise shaping feeds each sample's error into the next one, so it isn't
+  // vectorized. Samples of up to 24 bits can be dithered in 32 bits.
+  if (bits_per_sample > 24 || channel_count > 2 || state->noise_shaping) {
+    DitherPcm16C(destination, source, bits_per_sample, sample_count,
+                 channel_count, state);
+    return;
+  }
+  const int shift = static_cast<int>(bits_per_sample) - 16;
+  const int32x4_t shift_count = vdupq_n_s32(-shift);
+  const int32x4_t low_shift = vdupq_n_s32(shift - 16);
+  const int32x4_t high_shift = vdupq_n_s32(shift - 32);
+  const int32x4_t half_step = vdupq_n_s32(1 << (shift - 1));
+  uint32x4_t random = vld1q_u32(state->random);
+  // Each iteration outputs eight samples, so the tail starts with generator 0.
+  const unsigned frames_per_iteration = 8 / channel_count;
+  const unsigned i_max = sample_count - sample_count % frames_per_iteration;
+  unsigned i;
+  if (channel_count == 1) {
+    const int32_t* mono = source[0];
+    for (i = 0; i < i_max; i += 8) {
+      random = NextRandom(random);
+      const int16x4_t low = DitherPcm16x4(vld1q_s32(mono + i), random,
+                                          shift_count, low_shift, high_shift,
+                                          half_step);
+      random = NextRandom(random);
+      const int16x4_t high = DitherPcm16x4(vld1q_s32(mono + i + 4), random,
+                                           shift_count, low_shift, high_shift,
+                                           half_step);
+      vst1q_s16(destination + i, vcombine_s16(low, high));
+    }
+  } else {
+    const int32_t* left = source[0];
+    const int32_t* right = source[1];
+    for (i = 0; i < i_max; i += 4) {
+      const int32x4x2_t interleaved =
+          vzipq_s32(vld1q_s32(left + i), vld1q_s32(right + i));
+      random = NextRandom(random);
+      const int16x4_t low = DitherPcm16x4(interleaved.val[0], random,
+                                          shift_count, low_shift, high_shift,
+                                          half_step);
+      random = NextRandom(random);
+      const int16x4_t high = DitherPcm16x4(interleaved.val[1], random,
+                                           shift_count, low_shift, high_shift,
+                                           half_step);
+      vst1q_s16(destination + 2 * i, vcombine_s16(low, high));
+    }
+  }
+  vst1q_u32(state->random, random);
+  const int32_t* tail_source[2] = {source[0] + i,
+                                   source[channel_count - 1] + i};
+  DitherPcm16C(destination + i * channel_count, tail_source, bits_per_sample,
+               sample_count - i, channel_count, state);
+}
+
+}  // namespace exoplayer_jni
+
+#endif  // defined(__arm__) || defined(__aarch64__)
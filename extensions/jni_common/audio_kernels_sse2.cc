@@ -0,0 +1,338 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "audio_kernels.h"  // NOLINT
+
+#if defined(__i386__) || defined(__x86_64__)
+
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace exoplayer_jni {
+
+void InterleavePcmSse2(int8_t* destination, const int32_t* const* source,
+                       unsigned bytes_per_sample, unsigned sample_count,
+                       unsigned channel_count) {
+  if (bytes_per_sample != 2 || channel_count > 2) {
+    InterleavePcmC(destination, source, bytes_per_sample, sample_count,
+                   channel_count);
+    return;
+  }
+  int16_t* destination_16 = reinterpret_cast<int16_t*>(destination);
+  const unsigned i_max = sample_count & ~7u;
+  unsigned i;
+  if (channel_count == 1) {
+    const int32_t* mono = source[0];
+    for (i = 0; i < i_max; i += 8) {
+      // The samples fit in 16 bits, so the saturating pack doesn't change them.
+      const __m128i samples = _mm_packs_epi32(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(mono + i)),
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(mono + i + 4)));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(destination_16 + i), samples);
+    }
+    for (; i < sample_count; ++i) {
+      destination_16[i] = static_cast<int16_t>(mono[i]);
+    }
+    return;
+  }
+  const int32_t* left = source[0];
+  const int32_t* right = source[1];
+  for (i = 0; i < i_max; i += 8) {
+    const __m128i left_samples = _mm_packs_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(left + i)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(left + i + 4)));
+    const __m128i right_samples = _mm_packs_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(right + i)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(right + i + 4)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(destination_16 + 2 * i),
+                     _mm_unpacklo_epi16(left_samples, right_samples));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(destination_16 + 2 * i + 8),
+                     _mm_unpackhi_epi16(left_samples, right_samples));
+  }
+  for (; i < sample_count; ++i) {
+    destination_16[2 * i] = static_cast<int16_t>(left[i]);
+    destination_16[2 * i + 1] = static_cast<int16_t>(right[i]);
+  }
+}
+
+void ConvertPcm16ToFloatSse2(const int16_t* source, float* destination,
+                             unsigned sample_count, float scale) {
+  const __m128 scale_4 = _mm_set1_ps(scale);
+  const unsigned i_max = sample_count & ~7u;
+  unsigned i;
+  for (i = 0; i < i_max; i += 8) {
+    const __m128i samples =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+    // Sign extends each half to 32 bits by unpacking the samples into the
+    // upper halves and shifting them back down.
+    const __m128i low =
+        _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+    const __m128i high =
+        _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+    _mm_storeu_ps(destination + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scale_4));
+    _mm_storeu_ps(destination + i + 4,
+                  _mm_mul_ps(_mm_cvtepi32_ps(high), scale_4));
+  }
+  ConvertPcm16ToFloatC(source + i, destination + i, sample_count - i, scale);
+}
+
+namespace {
+
+// Converts four float samples to 32-bit integers in the 16-bit range, as
+// ConvertFloatToPcm16C does.
+inline __m128i ConvertFloatToPcm16x4(const float* source) {
+  const __m128 sign_mask = _mm_set1_ps(-0.0f);
+  __m128 samples = _mm_mul_ps(_mm_loadu_ps(source), _mm_set1_ps(32768.0f));
+  samples = _mm_max_ps(samples, _mm_set1_ps(-32768.0f));
+  samples = _mm_min_ps(samples, _mm_set1_ps(32767.0f));
+  const __m128 half =
+      _mm_or_ps(_mm_set1_ps(0.5f), _mm_and_ps(samples, sign_mask));
+  return _mm_cvttps_epi32(_mm_add_ps(samples, half));
+}
+
+}  // namespace
+
+void ConvertFloatToPcm16Sse2(const float* source, int16_t* destination,
+                             unsigned sample_count) {
+  const unsigned i_max = sample_count & ~7u;
+  unsigned i;
+  for (i = 0; i < i_max; i += 8) {
+    // The values are already in the 16-bit range, so the saturating pack
+    // doesn't change them.
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i),
+                     _mm_packs_epi32(ConvertFloatToPcm16x4(source + i),
+                                     ConvertFloatToPcm16x4(source + i + 4)));
+  }
+  ConvertFloatToPcm16C(source + i, destination + i, sample_count - i);
+}
+
+float DotProductSse2(const float* a, const float* b, unsigned sample_count) {
+  __m128 sums_low = _mm_setzero_ps();
+  __m128 sums_high = _mm_setzero_ps();
+  const unsigned i_max = sample_count & ~7u;
+  unsigned i;
+  for (i = 0; i < i_max; i += 8) {
+    sums_low = _mm_add_ps(
+        sums_low, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    sums_high = _mm_add_ps(sums_high, _mm_mul_ps(_mm_loadu_ps(a + i + 4),
+                                                 _mm_loadu_ps(b + i + 4)));
+  }
+  // Combines the partial sums in the order that DotProductC does.
+  const __m128 sums = _mm_add_ps(sums_low, sums_high);
+  const __m128 pairs = _mm_add_ps(sums, _mm_movehl_ps(sums, sums));
+  float sum = _mm_cvtss_f32(
+      _mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, _MM_SHUFFLE(1, 1, 1, 1))));
+  for (; i < sample_count; ++i) {
+    sum += a[i] * b[i];
+  }
+  return sum;
+}
+
+float FindPeakSse2(const float* samples, unsigned sample_count) {
+  // Clearing the sign bit gives the magnitude.
+  const __m128 magnitude_mask =
+      _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  __m128 peaks_low = _mm_setzero_ps();
+  __m128 peaks_high = _mm_setzero_ps();
+  const unsigned i_max = sample_count & ~7u;
+  unsigned i;
+  for (i = 0; i < i_max; i += 8) {
+    peaks_low = _mm_max_ps(
+        peaks_low, _mm_and_ps(_mm_loadu_ps(samples + i), magnitude_mask));
+    peaks_high = _mm_max_ps(
+        peaks_high, _mm_and_ps(_mm_loadu_ps(samples + i + 4), magnitude_mask));
+  }
+  __m128 peaks = _mm_max_ps(peaks_low, peaks_high);
+  peaks = _mm_max_ps(peaks, _mm_movehl_ps(peaks, peaks));
+  peaks = _mm_max_ss(peaks,
+                     _mm_shuffle_ps(peaks, peaks, _MM_SHUFFLE(1, 1, 1, 1)));
+  float peak = _mm_cvtss_f32(peaks);
+  for (; i < sample_count; ++i) {
+    peak = std::max(peak, std::fabs(samples[i]));
+  }
+  return peak;
+}
+
+SampleSummary SummarizeSamplesSse2(const float* samples,
+                                   unsigned sample_count) {
+  if (sample_count == 0) {
+    return {0, 0, 0};
+  }
+  const __m128 first = _mm_set1_ps(samples[0]);
+  __m128 mins_low = first;
+  __m128 mins_high = first;
+  __m128 maxs_low = first;
+  __m128 maxs_high = first;
+  __m128 sums_low = _mm_setzero_ps();
+  __m128 sums_high = _mm_setzero_ps();
+  const unsigned i_max = sample_count & ~7u;
+  unsigned i;
+  for (i = 0; i < i_max; i += 8) {
+    const __m128 low = _mm_loadu_ps(samples + i);
+    const __m128 high = _mm_loadu_ps(samples + i + 4);
+    mins_low = _mm_min_ps(mins_low, low);
+    mins_high = _mm_min_ps(mins_high, high);
+    maxs_low = _mm_max_ps(maxs_low, low);
+    maxs_high = _mm_max_ps(maxs_high, high);
+    sums_low = _mm_add_ps(sums_low, _mm_mul_ps(low, low));
+    sums_high = _mm_add_ps(sums_high, _mm_mul_ps(high, high));
+  }
+  __m128 mins = _mm_min_ps(mins_low, mins_high);
+  mins = _mm_min_ps(mins, _mm_movehl_ps(mins, mins));
+  mins = _mm_min_ss(mins, _mm_shuffle_ps(mins, mins, _MM_SHUFFLE(1, 1, 1, 1)));
+  __m128 maxs = _mm_max_ps(maxs_low, maxs_high);
+  maxs = _mm_max_ps(maxs, _mm_movehl_ps(maxs, maxs));
+  maxs = _mm_max_ss(maxs, _mm_shuffle_ps(maxs, maxs, _MM_SHUFFLE(1, 1, 1, 1)));
+  // Combines the partial sums in the order that SummarizeSamplesC does.
+  const __m128 sums = _mm_add_ps(sums_low, sums_high);
+  const __m128 pairs = _mm_add_ps(sums, _mm_movehl_ps(sums, sums));
+  float min = _mm_cvtss_f32(mins);
+  float max = _mm_cvtss_f32(maxs);
+  float sum = _mm_cvtss_f32(
+      _mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, _MM_SHUFFLE(1, 1, 1, 1))));
+  for (; i < sample_count; ++i) {
+    min = std::min(min, samples[i]);
+    max = std::max(max, samples[i]);
+    sum += samples[i] * samples[i];
+  }
+  return {min, max, sum};
+}
+
+void FftStageSse2(float* real, float* imag, const float* twiddle_real,
+                  const float* twiddle_imag, unsigned size,
+                  unsigned half_size) {
+  if (half_size < 4) {
+    FftStageC(real, imag, twiddle_real, twiddle_imag, size, half_size);
+    return;
+  }
+  // Stage sizes are powers of two, so each half holds whole vectors.
+  for (unsigned start = 0; start < size; start += 2 * half_size) {
+    float* const real_low = real + start;
+    float* const imag_low = imag + start;
+    float* const real_high = real_low + half_size;
+    float* const imag_high = imag_low + half_size;
+    for (unsigned j = 0; j < half_size; j += 4) {
+      const __m128 w_real = _mm_loadu_ps(twiddle_real + j);
+      const __m128 w_imag = _mm_loadu_ps(twiddle_imag + j);
+      const __m128 high_real = _mm_loadu_ps(real_high + j);
+      const __m128 high_imag = _mm_loadu_ps(imag_high + j);
+      const __m128 product_real = _mm_sub_ps(_mm_mul_ps(w_real, high_real),
+                                             _mm_mul_ps(w_imag, high_imag));
+      const __m128 product_imag = _mm_add_ps(_mm_mul_ps(w_real, high_imag),
+                                             _mm_mul_ps(w_imag, high_real));
+      const __m128 low_real = _mm_loadu_ps(real_low + j);
+      const __m128 low_imag = _mm_loadu_ps(imag_low + j);
+      _mm_storeu_ps(real_high + j, _mm_sub_ps(low_real, product_real));
+      _mm_storeu_ps(imag_high + j, _mm_sub_ps(low_imag, product_imag));
+      _mm_storeu_ps(real_low + j, _mm_add_ps(low_real, product_real));
+      _mm_storeu_ps(imag_low + j, _mm_add_ps(low_imag, product_imag));
+    }
+  }
+}
+
+namespace {
+
+// Advances four xorshift32 generators, as DitherPcm16C does.
+inline __m128i NextRandom(__m128i random) {
+  random = _mm_xor_si128(random, _mm_slli_epi32(random, 13));
+  random = _mm_xor_si128(random, _mm_srli_epi32(random, 17));
+  return _mm_xor_si128(random, _mm_slli_epi32(random, 5));
+}
+
+// Requantizes four samples with the dither generated from |random|, as
+// DitherPcm16C does without noise shaping. The results aren't clamped.
+inline __m128i DitherPcm16x4(__m128i samples, __m128i random, __m128i shift,
+                             __m128i low_shift, __m128i high_shift,
+                             __m128i half_step) {
+  const __m128i dither = _mm_sub_epi32(
+      _mm_add_epi32(
+          _mm_srl_epi32(_mm_and_si128(random, _mm_set1_epi32(0xffff)),
+                        low_shift),
+          _mm_srl_epi32(random, high_shift)),
+      half_step);
+  return _mm_sra_epi32(_mm_add_epi32(samples, dither), shift);
+}
+
+}  // namespace
+
+void DitherPcm16Sse2(int16_t* destination, const int32_t* const* source,
+                     unsigned bits_per_sample, unsigned sample_count,
+                     unsigned channel_count, DitherState* state) {
+  // Noise shaping feeds each sample's error into the next one, so it isn't
+  // vectorized. Samples of up to 24 bits can be dithered in 32 bits.
+  if (bits_per_sample > 24 || channel_count > 2 || state->noise_shaping) {
+    DitherPcm16C(destination, source, bits_per_sample, sample_count,
+                 channel_count, state);
+    return;
+  }
+  const unsigned shift = bits_per_sample - 16;
+  const __m128i shift_count = _mm_cvtsi32_si128(shift);
+  const __m128i low_shift = _mm_cvtsi32_si128(16 - shift);
+  const __m128i high_shift = _mm_cvtsi32_si128(32 - shift);
+  const __m128i half_step = _mm_set1_epi32(1 << (shift - 1));
+  __m128i random =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(state->random));
+  // Each iteration outputs eight samples, so the tail starts with generator 0.
+  const unsigned frames_per_iteration = 8 / channel_count;
+  const unsigned i_max = sample_count - sample_count % frames_per_iteration;
+  unsigned i;
+  if (channel_count == 1) {
+    const int32_t* mono = source[0];
+    for (i = 0; i < i_max; i += 8) {
+      random = NextRandom(random);
+      const __m128i low = DitherPcm16x4(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(mono + i)), random,
+          shift_count, low_shift, high_shift, half_step);
+      random = NextRandom(random);
+      const __m128i high = DitherPcm16x4(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(mono + i + 4)),
+          random, shift_count, low_shift, high_shift, half_step);
+      // The saturating pack clamps to the 16-bit range.
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i),
+                       _mm_packs_epi32(low, high));
+    }
+  } else {
+    const int32_t* left = source[0];
+    const int32_t* right = source[1];
+    for (i = 0; i < i_max; i += 4) {
+      const __m128i left_samples =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(left + i));
+      const __m128i right_samples =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(right + i));
+      random = NextRandom(random);
+      const __m128i low =
+          DitherPcm16x4(_mm_unpacklo_epi32(left_samples, right_samples),
+                        random, shift_count, low_shift, high_shift, half_step);
+      random = NextRandom(random);
+      const __m128i high =
+          DitherPcm16x4(_mm_unpackhi_epi32(left_samples, right_samples),
+                        random, shift_count, low_shift, high_shift, half_step);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + 2 * i),
+                       _mm_packs_epi32(low, high));
+    }
+  }
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(state->random), random);
+  const int32_t* tail_source[2] = {source[0] + i,
+                                   source[channel_count - 1] + i};
+  DitherPcm16C(destination + i * channel_count, tail_source, bits_per_sample,
+               sample_count - i, channel_count, state);
+}
+
+}  // namespace exoplayer_jni
+
+#endif  // defined(__i386__) || defined(__x86_64__)
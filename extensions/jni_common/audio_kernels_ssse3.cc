@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "audio_kernels.h"  // NOLINT
+
+#if defined(__i386__) || defined(__x86_64__)
+
+#include <tmmintrin.h>
+
+#include <cstring>
+
+namespace exoplayer_jni {
+namespace {
+
+// Stores the 12 low bytes of |value|.
+__attribute__((target("ssse3"))) inline void Store12Bytes(int8_t* destination,
+                                                         __m128i value) {
+  _mm_storel_epi64(reinterpret_cast<__m128i*>(destination), value);
+  const int32_t last_bytes = _mm_cvtsi128_si32(_mm_srli_si128(value, 8));
+  std::memcpy(destination + 8, &last_bytes, sizeof(last_bytes));
+}
+
+}  // namespace
+
+// Android's x86 ABIs guarantee SSSE3 but host builds may not, so this function
+// is compiled for SSSE3 individually.
+__attribute__((target("ssse3"))) void InterleavePcmSsse3(
+    int8_t* destination, const int32_t* const* source,
+    unsigned bytes_per_sample, unsigned sample_count, unsigned channel_count) {
+  if (bytes_per_sample != 3 || channel_count > 2) {
+    InterleavePcmSse2(destination, source, bytes_per_sample, sample_count,
+                      channel_count);
+    return;
+  }
+  // Drops the most significant byte of each of the four 32-bit samples.
+  const __m128i pack_24_mask =
+      _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+  const unsigned i_max = sample_count & ~3u;
+  unsigned i;
+  if (channel_count == 1) {
+    const int32_t* mono = source[0];
+    for (i = 0; i < i_max; i += 4) {
+      const __m128i samples =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(mono + i));
+      Store12Bytes(destination, _mm_shuffle_epi8(samples, pack_24_mask));
+      destination += 12;
+    }
+    for (; i < sample_count; ++i) {
+      std::memcpy(destination, &mono[i], 3);
+      destination += 3;
+    }
+    return;
+  }
+  const int32_t* left = source[0];
+  const int32_t* right = source[1];
+  for (i = 0; i < i_max; i += 4) {
+    const __m128i left_samples =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(left + i));
+    const __m128i right_samples =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(right + i));
+    const __m128i low_samples = _mm_unpacklo_epi32(left_samples, right_samples);
+    const __m128i high_samples =
+        _mm_unpackhi_epi32(left_samples, right_samples);
+    Store12Bytes(destination, _mm_shuffle_epi8(low_samples, pack_24_mask));
+    Store12Bytes(destination + 12,
+                 _mm_shuffle_epi8(high_samples, pack_24_mask));
+    destination += 24;
+  }
+  for (; i < sample_count; ++i) {
+    std::memcpy(destination, &left[i], 3);
+    std::memcpy(destination + 3, &right[i], 3);
+    destination += 6;
+  }
+}
+
+}  // namespace exoplayer_jni
+
+#endif  // defined(__i386__) || defined(__x86_64__)
@@ -0,0 +1,158 @@
+#
+# Copyright (C) 2021 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# Builds libexoplayerJNI.so, a single library containing the native code of
+# the extensions listed in EXOPLAYER_COMBINED_EXTENSIONS, and their
+# dependencies. By default it contains all of the extensions it supports:
+#
+#   EXOPLAYER_COMBINED_EXTENSIONS := vp9 opus flac ffmpeg
+#
+# Each extension's dependencies must first be fetched, and for FFmpeg built, as
+# described in the extension's README. The AV1 extension isn't supported, since
+# libgav1 is only built with CMake.
+#
+# Compared with loading the extensions' own libraries, the C++ runtime and the
+# shared native code are linked in once, and the libraries' native methods are
+# registered by a single JNI_OnLoad rather than being looked up by name when
+# they're first called. JNI_OnLoad is the library's only exported symbol.
+
+COMBINED_PATH := $(call my-dir)
+EXTENSIONS_PATH := $(COMBINED_PATH)/../..
+EXOPLAYER_COMBINED_EXTENSIONS ?= vp9 opus flac ffmpeg
+
+# Flags for the extensions' sources, which hide everything they define.
+COMBINED_CFLAGS := -DEXOPLAYER_JNI_COMBINED -fvisibility=hidden \
+                   -ffunction-sections -fdata-sections
+# Defines for combined_jni.cc, naming the extensions to load.
+COMBINED_EXTENSION_CFLAGS :=
+COMBINED_STATIC_LIBRARIES :=
+COMBINED_SHARED_LIBRARIES :=
+
+# build libexoplayerjnicommon.a
+include $(COMBINED_PATH)/../jni_common.mk
+
+ifneq ($(filter vp9,$(EXOPLAYER_COMBINED_EXTENSIONS)),)
+# build libvpx.so
+include $(EXTENSIONS_PATH)/vp9/src/main/jni/libvpx.mk
+
+include $(CLEAR_VARS)
+LOCAL_PATH := $(EXTENSIONS_PATH)/vp9/src/main/jni
+LOCAL_MODULE := vpxcombined
+LOCAL_ARM_MODE := arm
+LOCAL_CPP_EXTENSION := .cc
+LOCAL_SRC_FILES := vpx_jni.cc
+LOCAL_CFLAGS := $(COMBINED_CFLAGS)
+LOCAL_SHARED_LIBRARIES := libvpx
+LOCAL_STATIC_LIBRARIES := exoplayerjnicommon
+include $(BUILD_STATIC_LIBRARY)
+
+COMBINED_EXTENSION_CFLAGS += -DEXOPLAYER_COMBINED_VP9
+COMBINED_STATIC_LIBRARIES += vpxcombined
+COMBINED_SHARED_LIBRARIES += libvpx
+endif
+
+ifneq ($(filter opus,$(EXOPLAYER_COMBINED_EXTENSIONS)),)
+# build libopus.a
+include $(EXTENSIONS_PATH)/opus/src/main/jni/libopus.mk
+
+include $(CLEAR_VARS)
+LOCAL_PATH := $(EXTENSIONS_PATH)/opus/src/main/jni
+LOCAL_MODULE := opuscombined
+LOCAL_ARM_MODE := arm
+LOCAL_CPP_EXTENSION := .cc
+LOCAL_SRC_FILES := opus_jni.cc
+LOCAL_CFLAGS := $(COMBINED_CFLAGS)
+LOCAL_STATIC_LIBRARIES := libopus exoplayerjnicommon
+include $(BUILD_STATIC_LIBRARY)
+
+COMBINED_EXTENSION_CFLAGS += -DEXOPLAYER_COMBINED_OPUS
+COMBINED_STATIC_LIBRARIES += opuscombined libopus
+endif
+
+ifneq ($(filter flac,$(EXOPLAYER_COMBINED_EXTENSIONS)),)
+# The flags are the same as in flac/src/main/jni/Android.mk.
+include $(CLEAR_VARS)
+include $(EXTENSIONS_PATH)/flac/src/main/jni/flac_sources.mk
+LOCAL_PATH := $(EXTENSIONS_PATH)/flac/src/main/jni
+LOCAL_MODULE := flaccombined
+LOCAL_ARM_MODE := arm
+LOCAL_CPP_EXTENSION := .cc
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/flac/include \
+    $(LOCAL_PATH)/flac/src/libFLAC/include
+LOCAL_SRC_FILES := $(FLAC_SOURCES)
+LOCAL_CFLAGS := $(COMBINED_CFLAGS)
+LOCAL_CFLAGS += '-DPACKAGE_VERSION="1.3.2"' -DFLAC__NO_MD5 -DFLAC__INTEGER_ONLY_LIBRARY
+LOCAL_CFLAGS += -D_REENTRANT -DPIC -DU_COMMON_IMPLEMENTATION -fPIC -DHAVE_SYS_PARAM_H
+LOCAL_CFLAGS += -O3 -funroll-loops -finline-functions -DFLAC__NO_ASM '-DFLAC__HAS_OGG=0'
+LOCAL_STATIC_LIBRARIES := exoplayerjnicommon
+include $(BUILD_STATIC_LIBRARY)
+
+COMBINED_EXTENSION_CFLAGS += -DEXOPLAYER_COMBINED_FLAC
+COMBINED_STATIC_LIBRARIES += flaccombined
+endif
+
+ifneq ($(filter ffmpeg,$(EXOPLAYER_COMBINED_EXTENSIONS)),)
+# The FFmpeg libraries built by ffmpeg/src/main/jni/build_ffmpeg.sh.
+FFMPEG_PATH := $(EXTENSIONS_PATH)/ffmpeg/src/main/jni/ffmpeg
+
+include $(CLEAR_VARS)
+LOCAL_PATH := $(FFMPEG_PATH)/android-libs/$(TARGET_ARCH_ABI)
+LOCAL_MODULE := avutil
+LOCAL_SRC_FILES := libavutil.a
+include $(PREBUILT_STATIC_LIBRARY)
+
+include $(CLEAR_VARS)
+LOCAL_PATH := $(FFMPEG_PATH)/android-libs/$(TARGET_ARCH_ABI)
+LOCAL_MODULE := swresample
+LOCAL_SRC_FILES := libswresample.a
+include $(PREBUILT_STATIC_LIBRARY)
+
+include $(CLEAR_VARS)
+LOCAL_PATH := $(FFMPEG_PATH)/android-libs/$(TARGET_ARCH_ABI)
+LOCAL_MODULE := avcodec
+LOCAL_SRC_FILES := libavcodec.a
+include $(PREBUILT_STATIC_LIBRARY)
+
+include $(CLEAR_VARS)
+LOCAL_PATH := $(EXTENSIONS_PATH)/ffmpeg/src/main/jni
+LOCAL_MODULE := ffmpegcombined
+LOCAL_ARM_MODE := arm
+LOCAL_CPP_EXTENSION := .cc
+LOCAL_SRC_FILES := ffmpeg_jni.cc
+LOCAL_C_INCLUDES := $(FFMPEG_PATH)
+LOCAL_CFLAGS := $(COMBINED_CFLAGS)
+LOCAL_STATIC_LIBRARIES := exoplayerjnicommon
+include $(BUILD_STATIC_LIBRARY)
+
+COMBINED_EXTENSION_CFLAGS += -DEXOPLAYER_COMBINED_FFMPEG
+COMBINED_STATIC_LIBRARIES += ffmpegcombined swresample avcodec avutil
+endif
+
+# build libexoplayerJNI.so
+include $(CLEAR_VARS)
+LOCAL_PATH := $(COMBINED_PATH)
+LOCAL_MODULE := libexoplayerJNI
+LOCAL_ARM_MODE := arm
+LOCAL_CPP_EXTENSION := .cc
+LOCAL_SRC_FILES := combined_jni.cc
+LOCAL_CFLAGS := $(COMBINED_CFLAGS) $(COMBINED_EXTENSION_CFLAGS)
+LOCAL_LDFLAGS := -Wl,--version-script=$(LOCAL_PATH)/exports.map \
+                 -Wl,--gc-sections
+LOCAL_LDLIBS := -llog -lz -lm -landroid
+LOCAL_SHARED_LIBRARIES := $(COMBINED_SHARED_LIBRARIES)
+LOCAL_STATIC_LIBRARIES := $(COMBINED_STATIC_LIBRARIES) exoplayerjnicommon
+include $(BUILD_SHARED_LIBRARY)
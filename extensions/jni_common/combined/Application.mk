@@ -0,0 +1,23 @@
+#
+# Copyright (C) 2021 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# The highest API level and the same C++ runtime as the extensions' own
+# libraries. The runtime is linked statically, once for all of the extensions.
+APP_OPTIM := release
+APP_STL := c++_static
+APP_CPPFLAGS := -frtti
+APP_PLATFORM := android-16
+include $(call my-dir)/../optimization.mk
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <jni.h>
+
+#include "jni_registration.h"  // NOLINT
+
+// The combined extension library's only exported symbol. Calls the load
+// function of each extension built into the library, which registers the
+// extension's native methods. Fails if any of them fails, which is the case if
+// the Java classes of an extension that's built into the library aren't in the
+// app.
+extern "C" JNIEXPORT jint JNI_OnLoad(JavaVM* vm, void* reserved) {
+#ifdef EXOPLAYER_COMBINED_VP9
+  if (exoplayer_jni::VpxOnLoad(vm, reserved) < 0) {
+    return -1;
+  }
+#endif
+#ifdef EXOPLAYER_COMBINED_OPUS
+  if (exoplayer_jni::OpusOnLoad(vm, reserved) < 0) {
+    return -1;
+  }
+#endif
+#ifdef EXOPLAYER_COMBINED_FLAC
+  if (exoplayer_jni::FlacOnLoad(vm, reserved) < 0) {
+    return -1;
+  }
+#endif
+#ifdef EXOPLAYER_COMBINED_FFMPEG
+  if (exoplayer_jni::FfmpegOnLoad(vm, reserved) < 0) {
+    return -1;
+  }
+#endif
+  return JNI_VERSION_1_6;
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cpu_dispatch.h"  // NOLINT
+
+#if !defined(EXOPLAYER_JNI_NO_CPU_FEATURES)
+#include "cpu_features_macros.h"  // NOLINT
+#if defined(CPU_FEATURES_ARCH_X86)
+#include "cpuinfo_x86.h"  // NOLINT
+#elif defined(CPU_FEATURES_ARCH_ARM)
+#include "cpuinfo_arm.h"  // NOLINT
+#elif defined(CPU_FEATURES_ARCH_AARCH64)
+#include "cpuinfo_aarch64.h"  // NOLINT
+#endif
+#endif  // !defined(EXOPLAYER_JNI_NO_CPU_FEATURES)
+
+namespace exoplayer_jni {
+namespace {
+
+CpuFeatures detected_cpu_features = {};
+
+// Kernels start out pointing to the portable implementations, so that they are
+// safe to use even if InitCpuDispatch() hasn't been called.
+Kernels resolved_kernels = {Convert10To8PlaneC, InterleavePcmC,
+                             ConvertPcm16ToFloatC, ConvertFloatToPcm16C,
+                             DotProductC, FindPeakC, SummarizeSamplesC,
+                             FftStageC, DitherPcm16C};
+
+CpuFeatures DetectCpuFeatures() {
+  CpuFeatures features = {};
+#if defined(EXOPLAYER_JNI_NO_CPU_FEATURES)
+  // Host builds without cpu_features. Only used for benchmarks and tests.
+#if defined(__i386__) || defined(__x86_64__)
+  __builtin_cpu_init();
+  features.sse2 = __builtin_cpu_supports("sse2");
+  features.ssse3 = __builtin_cpu_supports("ssse3");
+  features.avx2 = __builtin_cpu_supports("avx2");
+#elif defined(__aarch64__)
+  // Advanced SIMD is mandatory on AArch64.
+  features.neon = true;
+#endif
+#elif defined(CPU_FEATURES_ARCH_X86)
+  const cpu_features::X86Features x86_features =
+      cpu_features::GetX86Info().features;
+  features.sse2 = x86_features.sse2;
+  features.ssse3 = x86_features.ssse3;
+  features.avx2 = x86_features.avx2;
+#elif defined(CPU_FEATURES_ARCH_ARM)
+  // Devices using armeabi-v7a are not required to support NEON.
+  features.neon = cpu_features::GetArmInfo().features.neon;
+#elif defined(CPU_FEATURES_ARCH_AARCH64)
+  const cpu_features::Aarch64Features aarch64_features =
+      cpu_features::GetAarch64Info().features;
+  features.neon = aarch64_features.asimd;
+  features.dotprod = aarch64_features.asimddp;
+#endif
+  return features;
+}
+
+Kernels ResolveKernels(const CpuFeatures& features) {
+  Kernels kernels = {Convert10To8PlaneC, InterleavePcmC, ConvertPcm16ToFloatC,
+                     ConvertFloatToPcm16C, DotProductC, FindPeakC,
+                     SummarizeSamplesC, FftStageC, DitherPcm16C};
+#if defined(__arm__) || defined(__aarch64__)
+  if (features.neon) {
+    kernels.convert_10_to_8_plane = Convert10To8PlaneNeon;
+    kernels.interleave_pcm = InterleavePcmNeon;
+    kernels.convert_pcm16_to_float = ConvertPcm16ToFloatNeon;
+    kernels.convert_float_to_pcm16 = ConvertFloatToPcm16Neon;
+    kernels.dot_product = DotProductNeon;
+    kernels.find_peak = FindPeakNeon;
+    kernels.summarize_samples = SummarizeSamplesNeon;
+    kernels.fft_stage = FftStageNeon;
+    kernels.dither_pcm16 = DitherPcm16Neon;
+  }
+#endif  // defined(__arm__) || defined(__aarch64__)
+#if defined(__i386__) || defined(__x86_64__)
+  if (features.sse2) {
+    kernels.convert_10_to_8_plane = Convert10To8PlaneSse2;
+    kernels.interleave_pcm = InterleavePcmSse2;
+    kernels.convert_pcm16_to_float = ConvertPcm16ToFloatSse2;
+    kernels.convert_float_to_pcm16 = ConvertFloatToPcm16Sse2;
+    kernels.dot_product = DotProductSse2;
+    kernels.find_peak = FindPeakSse2;
+    kernels.summarize_samples = SummarizeSamplesSse2;
+    kernels.fft_stage = FftStageSse2;
+    kernels.dither_pcm16 = DitherPcm16Sse2;
+  }
+  if (features.ssse3) {
+    kernels.interleave_pcm = InterleavePcmSsse3;
+  }
+  if (features.avx2) {
+    kernels.convert_10_to_8_plane = Convert10To8PlaneAvx2;
+  }
+#endif  // defined(__i386__) || defined(__x86_64__)
+  return kernels;
+}
+
+}  // namespace
+
+void InitCpuDispatch() {
+  detected_cpu_features = DetectCpuFeatures();
+  resolved_kernels = ResolveKernels(detected_cpu_features);
+}
+
+const CpuFeatures& GetCpuFeatures() { return detected_cpu_features; }
+
+const Kernels& GetKernels() { return resolved_kernels; }
+
+}  // namespace exoplayer_jni
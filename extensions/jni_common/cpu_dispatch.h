@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_CPU_DISPATCH_H_
+#define EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_CPU_DISPATCH_H_
+
+#include "audio_kernels.h"  // NOLINT
+#include "video_kernels.h"  // NOLINT
+
+namespace exoplayer_jni {
+
+// SIMD features of the CPU the process is running on. Only the features that
+// are relevant to the kernels in this directory are detected.
+struct CpuFeatures {
+  bool sse2;
+  bool ssse3;
+  bool avx2;
+  bool neon;
+  // The Armv8.2 dot product instructions (SDOT/UDOT).
+  bool dotprod;
+};
+
+// The hot kernels shared by the extensions. Each entry points to the fastest
+// implementation supported by the CPU, or to the portable C implementation
+// until InitCpuDispatch() has been called.
+struct Kernels {
+  Convert10To8PlaneFunction convert_10_to_8_plane;
+  InterleavePcmFunction interleave_pcm;
+  ConvertPcm16ToFloatFunction convert_pcm16_to_float;
+  ConvertFloatToPcm16Function convert_float_to_pcm16;
+  DotProductFunction dot_product;
+  FindPeakFunction find_peak;
+  SummarizeSamplesFunction summarize_samples;
+  FftStageFunction fft_stage;
+  DitherPcm16Function dither_pcm16;
+};
+
+// Detects the CPU features and resolves the kernels. Must be called from
+// JNI_OnLoad, before any kernel is used. Calling it more than once is harmless.
+void InitCpuDispatch();
+
+// Returns the CPU features detected by InitCpuDispatch().
+const CpuFeatures& GetCpuFeatures();
+
+// Returns the kernels resolved by InitCpuDispatch().
+const Kernels& GetKernels();
+
+}  // namespace exoplayer_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_CPU_DISPATCH_H_
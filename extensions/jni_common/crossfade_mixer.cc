@@ -0,0 +1,308 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "crossfade_mixer.h"  // NOLINT
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace exoplayer_jni {
+namespace {
+
+const double kPi = 3.14159265358979323846;
+// The number of frames mixed at a time, so that the unpacked samples of both
+// streams fit on the stack.
+const int kBlockFrames = 128;
+const int kMaxBlockSamples = kBlockFrames * AudioChainConfig::kMaxChannels;
+
+// Writes the gains of the outgoing and incoming streams at |frame_count|
+// frames from |position| of a crossfade of |duration| frames.
+void ComputeGains(CrossfadeCurve curve, int64_t position, int64_t duration,
+                  int frame_count, float* outgoing_gains,
+                  float* incoming_gains) {
+  const double step = 1.0 / duration;
+  for (int i = 0; i < frame_count; i++) {
+    const double t = (position + i) * step;
+    if (curve == kCrossfadeCurveEqualPower) {
+      outgoing_gains[i] = static_cast<float>(std::cos(t * kPi / 2));
+      incoming_gains[i] = static_cast<float>(std::sin(t * kPi / 2));
+    } else {
+      outgoing_gains[i] = static_cast<float>(1 - t);
+      incoming_gains[i] = static_cast<float>(t);
+    }
+  }
+}
+
+}  // namespace
+
+bool MixCrossfade(const uint8_t* outgoing, const uint8_t* incoming,
+                  uint8_t* output, int frame_count, int channel_count,
+                  PcmEncoding encoding, CrossfadeCurve curve, int64_t position,
+                  int64_t duration) {
+  const int bytes_per_sample = GetBytesPerSample(encoding);
+  if ((outgoing == nullptr && incoming == nullptr) || output == nullptr ||
+      frame_count < 0 ||
+      channel_count <= 0 || channel_count > AudioChainConfig::kMaxChannels ||
+      bytes_per_sample == 0 ||
+      (curve != kCrossfadeCurveLinear && curve != kCrossfadeCurveEqualPower) ||
+      position < 0 || duration <= 0 || position + frame_count > duration) {
+    return false;
+  }
+  const size_t frame_size =
+      static_cast<size_t>(channel_count) * bytes_per_sample;
+  float outgoing_samples[kMaxBlockSamples];
+  float incoming_samples[kMaxBlockSamples];
+  float outgoing_gains[kBlockFrames];
+  float incoming_gains[kBlockFrames];
+  for (int first_frame = 0; first_frame < frame_count;
+       first_frame += kBlockFrames) {
+    const int block_frames = std::min(kBlockFrames, frame_count - first_frame);
+    const int block_samples = block_frames * channel_count;
+    const size_t offset = first_frame * frame_size;
+    ComputeGains(curve, position + first_frame, duration, block_frames,
+                 outgoing_gains, incoming_gains);
+    // Both streams are unpacked before the block is written, so that |output|
+    // can be either of them.
+    if (incoming != nullptr) {
+      UnpackPcm(incoming + offset, encoding, block_samples, incoming_samples);
+    } else {
+      std::fill(incoming_samples, incoming_samples + block_samples, 0.0f);
+    }
+    if (outgoing != nullptr) {
+      UnpackPcm(outgoing + offset, encoding, block_samples, outgoing_samples);
+      for (int i = 0; i < block_frames; i++) {
+        float* incoming_frame = incoming_samples + i * channel_count;
+        const float* outgoing_frame = outgoing_samples + i * channel_count;
+        for (int c = 0; c < channel_count; c++) {
+          incoming_frame[c] = incoming_frame[c] * incoming_gains[i] +
+                              outgoing_frame[c] * outgoing_gains[i];
+        }
+      }
+    } else {
+      for (int i = 0; i < block_frames; i++) {
+        float* incoming_frame = incoming_samples + i * channel_count;
+        for (int c = 0; c < channel_count; c++) {
+          incoming_frame[c] *= incoming_gains[i];
+        }
+      }
+    }
+    PackPcm(incoming_samples, encoding, block_samples, output + offset);
+  }
+  return true;
+}
+
+const int64_t CrossfadeMixer::kMaxDurationUs;
+
+CrossfadeMixer::CrossfadeMixer()
+    : duration_us_(0),
+      curve_(kCrossfadeCurveLinear),
+      channel_count_(0),
+      sample_rate_(0),
+      encoding_(kPcmEncodingInvalid),
+      frame_size_(0),
+      stream_curve_(kCrossfadeCurveLinear),
+      ring_capacity_(0),
+      ring_start_(0),
+      ring_frame_count_(0),
+      tail_channel_count_(0),
+      tail_sample_rate_(0),
+      tail_encoding_(kPcmEncodingInvalid),
+      tail_frame_count_(0),
+      tail_position_(0) {}
+
+bool CrossfadeMixer::Configure(int64_t duration_us, CrossfadeCurve curve) {
+  if (duration_us < 0 || duration_us > kMaxDurationUs ||
+      (curve != kCrossfadeCurveLinear && curve != kCrossfadeCurveEqualPower)) {
+    return false;
+  }
+  duration_us_ = duration_us;
+  curve_ = curve;
+  return true;
+}
+
+int CrossfadeMixer::Process(uint8_t* data, int size, int channel_count,
+                            int sample_rate, PcmEncoding encoding) {
+  const int bytes_per_sample = GetBytesPerSample(encoding);
+  if ((data == nullptr && size != 0) || size < 0 || channel_count <= 0 ||
+      channel_count > AudioChainConfig::kMaxChannels || sample_rate <= 0 ||
+      bytes_per_sample == 0 || size % (channel_count * bytes_per_sample) != 0) {
+    return -1;
+  }
+  if (channel_count != channel_count_ || sample_rate != sample_rate_ ||
+      encoding != encoding_) {
+    StartStream(channel_count, sample_rate, encoding);
+  }
+  const int frame_count = size / frame_size_;
+  if (tail_position_ < tail_frame_count_) {
+    const int mix_frame_count =
+        std::min(frame_count, tail_frame_count_ - tail_position_);
+    MixCrossfade(tail_.data() + static_cast<size_t>(tail_position_) *
+                                    frame_size_,
+                 data, data, mix_frame_count, channel_count_, encoding_,
+                 stream_curve_, tail_position_, tail_frame_count_);
+    tail_position_ += mix_frame_count;
+  }
+  if (ring_capacity_ == 0) {
+    return size;
+  }
+  // The ring is filled first, and once it's full each new frame is swapped
+  // with the oldest held back frame, which is then moved to the front.
+  const int fill_frame_count =
+      std::min(frame_count, ring_capacity_ - ring_frame_count_);
+  AppendToRing(data, fill_frame_count);
+  const int output_frame_count = frame_count - fill_frame_count;
+  uint8_t* swap_data = data + static_cast<size_t>(fill_frame_count) *
+                                  frame_size_;
+  int swap_frame_count = output_frame_count;
+  while (swap_frame_count > 0) {
+    const int segment_frame_count =
+        std::min(swap_frame_count, ring_capacity_ - ring_start_);
+    const size_t segment_size =
+        static_cast<size_t>(segment_frame_count) * frame_size_;
+    std::swap_ranges(swap_data, swap_data + segment_size,
+                     ring_.data() + static_cast<size_t>(ring_start_) *
+                                        frame_size_);
+    ring_start_ = (ring_start_ + segment_frame_count) % ring_capacity_;
+    swap_data += segment_size;
+    swap_frame_count -= segment_frame_count;
+  }
+  const int output_size = output_frame_count * frame_size_;
+  if (fill_frame_count > 0) {
+    memmove(data, data + static_cast<size_t>(fill_frame_count) * frame_size_,
+            output_size);
+  }
+  return output_size;
+}
+
+void CrossfadeMixer::EndStream() {
+  if (channel_count_ == 0) {
+    // The stream had no output, so the previous stream's end is kept for the
+    // next one.
+    return;
+  }
+  FinishTail();
+  tail_.resize(static_cast<size_t>(ring_frame_count_) * frame_size_);
+  tail_channel_count_ = channel_count_;
+  tail_sample_rate_ = sample_rate_;
+  tail_encoding_ = encoding_;
+  tail_frame_count_ = ring_frame_count_;
+  tail_position_ = 0;
+  TakeFromRing(tail_.data(), ring_frame_count_);
+  channel_count_ = 0;
+  sample_rate_ = 0;
+  encoding_ = kPcmEncodingInvalid;
+}
+
+int CrossfadeMixer::Drain(uint8_t* output, int capacity) {
+  if (channel_count_ == 0) {
+    if (tail_position_ == tail_frame_count_) {
+      return 0;
+    }
+    // The last stream had no output, so the previous stream's end is faded
+    // out on its own.
+    StartStream(tail_channel_count_, tail_sample_rate_, tail_encoding_);
+  }
+  FinishTail();
+  const int frame_count = std::min(ring_frame_count_, capacity / frame_size_);
+  TakeFromRing(output, frame_count);
+  return frame_count * frame_size_;
+}
+
+void CrossfadeMixer::Flush() {
+  ring_start_ = 0;
+  ring_frame_count_ = 0;
+  tail_frame_count_ = 0;
+  tail_position_ = 0;
+}
+
+int CrossfadeMixer::GetDrainSize() const {
+  return (ring_frame_count_ + tail_frame_count_ - tail_position_) *
+         frame_size_;
+}
+
+void CrossfadeMixer::StartStream(int channel_count, int sample_rate,
+                                 PcmEncoding encoding) {
+  channel_count_ = channel_count;
+  sample_rate_ = sample_rate;
+  encoding_ = encoding;
+  frame_size_ = channel_count * GetBytesPerSample(encoding);
+  stream_curve_ = curve_;
+  if (channel_count != tail_channel_count_ ||
+      sample_rate != tail_sample_rate_ || encoding != tail_encoding_) {
+    tail_frame_count_ = 0;
+    tail_position_ = 0;
+  }
+  // The ring holds at least the previous stream's end, so that its end can be
+  // faded out into the ring if this stream is shorter.
+  ring_capacity_ = std::max(
+      static_cast<int>(duration_us_ * sample_rate / 1000000),
+      tail_frame_count_);
+  ring_.resize(static_cast<size_t>(ring_capacity_) * frame_size_);
+  ring_start_ = 0;
+  ring_frame_count_ = 0;
+}
+
+void CrossfadeMixer::FinishTail() {
+  // The current stream is shorter than the previous stream's end, so all of
+  // its output is held back, and the rest of the end fits after it.
+  while (tail_position_ < tail_frame_count_) {
+    const int ring_end = (ring_start_ + ring_frame_count_) % ring_capacity_;
+    const int frame_count = std::min(tail_frame_count_ - tail_position_,
+                                     ring_capacity_ - ring_end);
+    MixCrossfade(tail_.data() + static_cast<size_t>(tail_position_) *
+                                    frame_size_,
+                 nullptr,
+                 ring_.data() + static_cast<size_t>(ring_end) * frame_size_,
+                 frame_count, channel_count_, encoding_, stream_curve_,
+                 tail_position_, tail_frame_count_);
+    ring_frame_count_ += frame_count;
+    tail_position_ += frame_count;
+  }
+}
+
+void CrossfadeMixer::AppendToRing(const uint8_t* data, int frame_count) {
+  while (frame_count > 0) {
+    const int ring_end = (ring_start_ + ring_frame_count_) % ring_capacity_;
+    const int segment_frame_count =
+        std::min(frame_count, ring_capacity_ - ring_end);
+    const size_t segment_size =
+        static_cast<size_t>(segment_frame_count) * frame_size_;
+    memcpy(ring_.data() + static_cast<size_t>(ring_end) * frame_size_, data,
+           segment_size);
+    ring_frame_count_ += segment_frame_count;
+    data += segment_size;
+    frame_count -= segment_frame_count;
+  }
+}
+
+void CrossfadeMixer::TakeFromRing(uint8_t* output, int frame_count) {
+  while (frame_count > 0) {
+    const int segment_frame_count =
+        std::min(frame_count, ring_capacity_ - ring_start_);
+    const size_t segment_size =
+        static_cast<size_t>(segment_frame_count) * frame_size_;
+    memcpy(output, ring_.data() + static_cast<size_t>(ring_start_) *
+                                      frame_size_,
+           segment_size);
+    ring_start_ = (ring_start_ + segment_frame_count) % ring_capacity_;
+    ring_frame_count_ -= segment_frame_count;
+    output += segment_size;
+    frame_count -= segment_frame_count;
+  }
+}
+
+}  // namespace exoplayer_jni
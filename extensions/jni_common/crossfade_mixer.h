@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_CROSSFADE_MIXER_H_
+#define EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_CROSSFADE_MIXER_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "audio_chain.h"  // NOLINT
+
+namespace exoplayer_jni {
+
+// The shapes of the gains of the two streams of a crossfade, as functions of
+// the fraction t of the crossfade that has elapsed.
+enum CrossfadeCurve {
+  // The incoming stream's gain is t and the outgoing stream's is 1 - t, so
+  // their sum is constant. Suits correlated audio, such as gapless tracks that
+  // continue each other.
+  kCrossfadeCurveLinear = 0,
+  // The incoming stream's gain is sin(t * pi / 2) and the outgoing stream's is
+  // cos(t * pi / 2), so the sum of their squares is constant. Keeps the
+  // loudness of uncorrelated audio constant.
+  kCrossfadeCurveEqualPower = 1
+};
+
+// Mixes |frame_count| interleaved frames of the end of an outgoing stream,
+// which fades out, with the start of an incoming stream, which fades in, into
+// |output|. |position| is the index in the crossfade of the first frame, and
+// the crossfade lasts |duration| frames. Both streams must have
+// |channel_count| channels in |encoding|. |outgoing| is null once the outgoing
+// stream has ended, in which case the incoming stream keeps fading in over
+// silence, and |incoming| is null if the incoming stream has ended, in which
+// case the outgoing stream keeps fading out over silence. |output| may be the
+// same buffer as |incoming| or |outgoing|.
+//
+// Returns false if the arguments are invalid, in which case nothing is written.
+bool MixCrossfade(const uint8_t* outgoing, const uint8_t* incoming,
+                  uint8_t* output, int frame_count, int channel_count,
+                  PcmEncoding encoding, CrossfadeCurve curve, int64_t position,
+                  int64_t duration);
+
+// Crossfades consecutive streams that are decoded one after the other, such as
+// the items of a playlist, in the output of their decoders. While a stream is
+// decoded, the mixer holds back the last crossfade duration of its output, so
+// its output lags its input by up to that duration. When the stream ends, the
+// held back output is either drained, or kept and mixed into the start of the
+// next stream, which may be decoded by another decoder that the mixer is
+// handed to. Not thread-safe.
+class CrossfadeMixer {
+ public:
+  // The longest crossfade that can be configured.
+  static const int64_t kMaxDurationUs = 60 * 1000 * 1000;
+
+  CrossfadeMixer();
+
+  // Sets the duration of the output that's held back to crossfade into the
+  // next stream, and the curve of crossfades into streams that start after the
+  // call. Returns false if the arguments are invalid.
+  bool Configure(int64_t duration_us, CrossfadeCurve curve);
+
+  // Processes |size| bytes of output of the current stream, which has
+  // |channel_count| interleaved channels of |encoding| at |sample_rate|, in
+  // place. If it's the first output since the previous stream ended, the
+  // current stream starts, and its start is mixed with the end of the previous
+  // stream if they have the same format. Holds back the end of the output,
+  // writes the output that was held back earlier and no longer needs to be to
+  // the start of |data|, and returns its size, which is at most |size|. The
+  // written output starts held_frame_count() frames, as returned before the
+  // call, before the start of the processed output. If the format changed
+  // during the stream, output held back in the old format is discarded.
+  // Returns -1 if the arguments are invalid.
+  int Process(uint8_t* data, int size, int channel_count, int sample_rate,
+              PcmEncoding encoding);
+
+  // Ends the current stream, keeping the output that's held back to mix into
+  // the start of the next stream.
+  void EndStream();
+
+  // Writes up to |capacity| bytes of the output that's held back at the end
+  // of the last stream to |output|, followed by the rest of the previous
+  // stream's end, faded out, if the last stream was shorter than the
+  // crossfade. Returns the number of bytes written.
+  int Drain(uint8_t* output, int capacity);
+
+  // Discards the output that's held back, and the end of the previous stream,
+  // after a seek in the current stream.
+  void Flush();
+
+  // Returns the number of frames of the current stream's output that are held
+  // back.
+  int held_frame_count() const { return ring_frame_count_; }
+
+  // Returns the size in bytes of the output that Drain would write.
+  int GetDrainSize() const;
+
+ private:
+  // Starts a stream of the given format, discarding the end of the previous
+  // stream if it has a different format.
+  void StartStream(int channel_count, int sample_rate, PcmEncoding encoding);
+
+  // Appends the rest of the previous stream's end to the held back output,
+  // faded out over silence.
+  void FinishTail();
+
+  // Copies |frame_count| frames into the held back output after the frames
+  // that are already held back.
+  void AppendToRing(const uint8_t* data, int frame_count);
+
+  // Copies the oldest |frame_count| held back frames to |output| and stops
+  // holding them back.
+  void TakeFromRing(uint8_t* output, int frame_count);
+
+  int64_t duration_us_;
+  CrossfadeCurve curve_;
+
+  // The format of the current stream, whose channel count is 0 if no stream
+  // has started since the previous one ended.
+  int channel_count_;
+  int sample_rate_;
+  PcmEncoding encoding_;
+  int frame_size_;
+  CrossfadeCurve stream_curve_;
+
+  // The held back output of the current stream, as a ring of
+  // |ring_capacity_| frames, of which |ring_frame_count_| from
+  // |ring_start_| are held back.
+  std::vector<uint8_t> ring_;
+  int ring_capacity_;
+  int ring_start_;
+  int ring_frame_count_;
+
+  // The end of the previous stream, which has |tail_frame_count_| frames in
+  // the format of the stream, and is mixed with the current stream from
+  // |tail_position_|.
+  std::vector<uint8_t> tail_;
+  int tail_channel_count_;
+  int tail_sample_rate_;
+  PcmEncoding tail_encoding_;
+  int tail_frame_count_;
+  int tail_position_;
+};
+
+}  // namespace exoplayer_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_CROSSFADE_MIXER_H_
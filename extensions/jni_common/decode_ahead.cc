@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "decode_ahead.h"  // NOLINT
+
+#include <algorithm>
+#include <utility>
+
+namespace exoplayer_jni {
+namespace {
+
+// Orders a thread's preceding stores before its following loads. When two
+// threads each store to one location and then load the other's, with this
+// between, at least one of them sees the other's store. The threads use this
+// to check whether the other is sleeping after changing a ring, while the
+// other publishes that it's sleeping before checking the rings one last time.
+inline void StoreLoadFence() {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+}  // namespace
+
+DecodeAheadThread::DecodeAheadThread(DecodeFunction decode,
+                                     size_t max_output_size, size_t ahead_size,
+                                     size_t input_capacity)
+    : decode_(std::move(decode)),
+      max_output_size_(max_output_size),
+      ahead_size_(ahead_size),
+      input_(input_capacity),
+      // Leaves room for the output that's decoded past |ahead_size| to make
+      // space for queued input, and for a record that's skipped at the end of
+      // the ring.
+      output_(2 * ahead_size +
+              2 * SpscRing::GetRecordSize(sizeof(DecodeAheadBlock) +
+                                          max_output_size)),
+      ready_size_(0),
+      worker_sleeping_(false),
+      consumer_sleeping_(false),
+      decoding_(false),
+      output_full_(false),
+      queue_waiting_(false),
+      flushing_(false),
+      stopping_(false) {
+  thread_ = std::thread(&DecodeAheadThread::Run, this);
+}
+
+DecodeAheadThread::~DecodeAheadThread() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_.store(true, std::memory_order_relaxed);
+  }
+  condition_.notify_all();
+  thread_.join();
+}
+
+bool DecodeAheadThread::Queue(int64_t time_us, int32_t flags,
+                              const uint8_t* input, size_t size) {
+  const size_t record_size = sizeof(InputHeader) + size;
+  uint8_t* record = input_.BeginWrite(record_size);
+  if (record == nullptr) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    // Lets the worker decode past |ahead_size_| until the input fits. It wakes
+    // this thread after decoding each input, or when the output ring is full.
+    queue_waiting_.store(true, std::memory_order_relaxed);
+    consumer_sleeping_.store(true, std::memory_order_relaxed);
+    StoreLoadFence();
+    condition_.notify_all();
+    condition_.wait(lock, [this, record_size, &record] {
+      // If the worker decoded all of the input, the input doesn't fit in the
+      // ring at all.
+      const bool input_empty = input_.IsEmpty();
+      record = input_.BeginWrite(record_size);
+      return record != nullptr || input_empty ||
+             output_full_.load(std::memory_order_relaxed);
+    });
+    consumer_sleeping_.store(false, std::memory_order_relaxed);
+    queue_waiting_.store(false, std::memory_order_relaxed);
+    if (record == nullptr) {
+      return false;
+    }
+  }
+  InputHeader* header = reinterpret_cast<InputHeader*>(record);
+  header->time_us = time_us;
+  header->flags = flags;
+  header->reserved = 0;
+  std::copy(input, input + size, record + sizeof(InputHeader));
+  input_.EndWrite(record_size);
+  MaybeWakeWorker(/* took_output= */ false);
+  return true;
+}
+
+const DecodeAheadBlock* DecodeAheadThread::Peek(bool drain) {
+  size_t size;
+  const uint8_t* record = output_.Peek(&size);
+  if (record == nullptr) {
+    return nullptr;
+  }
+  const DecodeAheadBlock* block =
+      reinterpret_cast<const DecodeAheadBlock*>(record);
+  // Errors are returned as soon as the output before them has been taken.
+  if (!drain && block->result >= 0 && ready_size() < ahead_size_) {
+    return nullptr;
+  }
+  return block;
+}
+
+void DecodeAheadThread::Pop() {
+  size_t size;
+  output_.Peek(&size);
+  ready_size_.fetch_sub(size - sizeof(DecodeAheadBlock),
+                        std::memory_order_acq_rel);
+  output_.Pop();
+  MaybeWakeWorker(/* took_output= */ true);
+}
+
+bool DecodeAheadThread::WaitForOutput() {
+  if (!output_.IsEmpty()) {
+    return true;
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  consumer_sleeping_.store(true, std::memory_order_relaxed);
+  StoreLoadFence();
+  // The worker only frees each input after publishing its output, so no more
+  // output is coming once the input ring is empty.
+  condition_.wait(lock,
+                  [this] { return input_.IsEmpty() || !output_.IsEmpty(); });
+  consumer_sleeping_.store(false, std::memory_order_relaxed);
+  return !output_.IsEmpty();
+}
+
+void DecodeAheadThread::Flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  flushing_.store(true, std::memory_order_relaxed);
+  consumer_sleeping_.store(true, std::memory_order_relaxed);
+  // The worker checks |flushing_| after setting |decoding_|, before it uses
+  // the rings, so either it sees |flushing_| or this thread waits for it.
+  StoreLoadFence();
+  condition_.wait(
+      lock, [this] { return !decoding_.load(std::memory_order_relaxed); });
+  consumer_sleeping_.store(false, std::memory_order_relaxed);
+  input_.Clear();
+  output_.Clear();
+  ready_size_.store(0, std::memory_order_release);
+  output_full_.store(false, std::memory_order_relaxed);
+  flushing_.store(false, std::memory_order_relaxed);
+  lock.unlock();
+  condition_.notify_all();
+}
+
+bool DecodeAheadThread::HasInputToDecode() const {
+  return !input_.IsEmpty() &&
+         (queue_waiting_.load(std::memory_order_relaxed) ||
+          ready_size() < ahead_size_);
+}
+
+void DecodeAheadThread::MaybeWakeWorker(bool took_output) {
+  StoreLoadFence();
+  if (!worker_sleeping_.load(std::memory_order_relaxed)) {
+    return;
+  }
+  {
+    // The worker holds the lock from when it publishes that it's sleeping
+    // until it waits, so the notification can't be missed.
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (took_output) {
+      output_full_.store(false, std::memory_order_relaxed);
+    }
+  }
+  condition_.notify_all();
+}
+
+void DecodeAheadThread::MaybeWakeConsumer() {
+  StoreLoadFence();
+  if (consumer_sleeping_.load(std::memory_order_relaxed)) {
+    { std::lock_guard<std::mutex> lock(mutex_); }
+    condition_.notify_all();
+  }
+}
+
+void DecodeAheadThread::Run() {
+  const size_t max_record_size = sizeof(DecodeAheadBlock) + max_output_size_;
+  while (true) {
+    decoding_.store(true, std::memory_order_relaxed);
+    StoreLoadFence();
+    uint8_t* record = nullptr;
+    if (!stopping_.load(std::memory_order_relaxed) &&
+        !flushing_.load(std::memory_order_relaxed) && HasInputToDecode()) {
+      record = output_.BeginWrite(max_record_size);
+    }
+    if (record == nullptr) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      decoding_.store(false, std::memory_order_relaxed);
+      worker_sleeping_.store(true, std::memory_order_relaxed);
+      StoreLoadFence();
+      if (consumer_sleeping_.load(std::memory_order_relaxed)) {
+        // Flush may be waiting for the worker to stop using the rings.
+        condition_.notify_all();
+      }
+      while (true) {
+        if (stopping_.load(std::memory_order_relaxed)) {
+          return;
+        }
+        if (!flushing_.load(std::memory_order_relaxed) && HasInputToDecode()) {
+          record = output_.BeginWrite(max_record_size);
+          if (record != nullptr) {
+            break;
+          }
+          if (!output_full_.load(std::memory_order_relaxed)) {
+            // Lets Queue fail rather than wait for space that the worker can't
+            // make until output is taken.
+            output_full_.store(true, std::memory_order_relaxed);
+            condition_.notify_all();
+          }
+        }
+        condition_.wait(lock);
+      }
+      worker_sleeping_.store(false, std::memory_order_relaxed);
+      decoding_.store(true, std::memory_order_relaxed);
+    }
+
+    size_t input_size;
+    const uint8_t* input = input_.Peek(&input_size);
+    const InputHeader* header = reinterpret_cast<const InputHeader*>(input);
+    DecodeAheadBlock* block = reinterpret_cast<DecodeAheadBlock*>(record);
+    block->time_us = header->time_us;
+    block->flags = header->flags;
+    std::fill(block->status, block->status + DecodeAheadBlock::kMaxStatusCount,
+              0);
+    block->result = decode_(input + sizeof(InputHeader),
+                            input_size - sizeof(InputHeader),
+                            record + sizeof(DecodeAheadBlock), block->status);
+    const size_t output_size =
+        block->result > 0 ? static_cast<size_t>(block->result) : 0;
+    // Counted before the block is published, so that the consumer can't take
+    // it first.
+    ready_size_.fetch_add(output_size, std::memory_order_acq_rel);
+    output_.EndWrite(sizeof(DecodeAheadBlock) + output_size);
+    input_.Pop();
+    MaybeWakeConsumer();
+  }
+}
+
+}  // namespace exoplayer_jni
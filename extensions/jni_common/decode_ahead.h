@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_DECODE_AHEAD_H_
+#define EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_DECODE_AHEAD_H_
+
+#include <atomic>
+#include <condition_variable>  // NOLINT
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
+
+#include "spsc_ring.h"  // NOLINT
+
+namespace exoplayer_jni {
+
+// A block of output decoded ahead, followed by |result| bytes of samples if
+// decoding succeeded.
+struct DecodeAheadBlock {
+  static const int kMaxStatusCount = 4;
+
+  // The timestamp and flags that the input was queued with.
+  int64_t time_us;
+  int32_t flags;
+  // The number of bytes of output, or a negative error code.
+  int32_t result;
+  // Values that the decode function published for the input, which the
+  // consumer publishes in the decoder's status block.
+  int64_t status[kMaxStatusCount];
+
+  const uint8_t* data() const {
+    return reinterpret_cast<const uint8_t*>(this + 1);
+  }
+};
+
+// Decodes queued input on a background thread, keeping a target amount of
+// output decoded ahead of the thread that consumes it, so that a late or slow
+// call on the consuming thread doesn't delay decoding.
+//
+// The decoding thread, which calls Queue and takes output, and the worker
+// thread pass input and output through lock-free single producer, single
+// consumer rings. A mutex and condition variable are only used when one of the
+// threads has to sleep, because there's nothing to decode or enough output
+// decoded ahead, or the input ring is full, and to wake it up. Each thread
+// publishes that it's sleeping in an atomic flag, which the other thread checks
+// after changing a ring, so neither takes the lock for each packet while the
+// other is running.
+//
+// All methods must be called on the same thread, other than the decode
+// function, which is called on the worker thread.
+class DecodeAheadThread {
+ public:
+  // Decodes |input_size| bytes of |input| into |output|, which has space for
+  // the |max_output_size| passed to the constructor, and writes the status
+  // values of the input to |status|. Returns the number of bytes of output, or
+  // a negative error code.
+  typedef std::function<int(const uint8_t* input, size_t input_size,
+                            uint8_t* output, int64_t* status)>
+      DecodeFunction;
+
+  // Starts a worker thread that decodes input with |decode|, producing at most
+  // |max_output_size| bytes of output for each input, and keeping at least
+  // |ahead_size| bytes of output decoded ahead once there's enough input.
+  // |input_capacity| is the size of the input ring, which must hold the input
+  // that's queued before enough output has been decoded.
+  DecodeAheadThread(DecodeFunction decode, size_t max_output_size,
+                    size_t ahead_size, size_t input_capacity);
+  // Stops and joins the worker thread.
+  ~DecodeAheadThread();
+
+  // Not copyable or movable.
+  DecodeAheadThread(const DecodeAheadThread&) = delete;
+  DecodeAheadThread& operator=(const DecodeAheadThread&) = delete;
+
+  // Queues |size| bytes of |input| for decoding, waiting for space in the input
+  // ring while the worker is decoding. Returns false if the input doesn't fit
+  // and the worker can't make space for it, because the output ring is full.
+  bool Queue(int64_t time_us, int32_t flags, const uint8_t* input,
+             size_t size);
+
+  // Returns the oldest decoded block if at least |ahead_size| bytes of output
+  // have been decoded, or any decoded block if |drain| is true, without
+  // waiting. Returns null otherwise. The block is valid until Pop is called.
+  const DecodeAheadBlock* Peek(bool drain);
+  // Frees the block returned by the last Peek call.
+  void Pop();
+
+  // Waits until there's decoded output, or all queued input has been decoded
+  // without producing any. Returns whether there's decoded output.
+  bool WaitForOutput();
+
+  // Discards queued input and decoded output, waiting for the worker to finish
+  // decoding if it's decoding.
+  void Flush();
+
+  // Returns the number of bytes of output that have been decoded and not taken.
+  size_t ready_size() const {
+    return ready_size_.load(std::memory_order_acquire);
+  }
+
+ private:
+  // The header of an input record.
+  struct InputHeader {
+    int64_t time_us;
+    int32_t flags;
+    int32_t reserved;
+  };
+
+  // Returns whether there's input that the worker may decode, if there's space
+  // for its output.
+  bool HasInputToDecode() const;
+  // Wakes the worker if it's sleeping, after the decoding thread queued input
+  // or, if |took_output|, took output.
+  void MaybeWakeWorker(bool took_output);
+  // Wakes the decoding thread if it's sleeping, after the worker decoded input.
+  void MaybeWakeConsumer();
+  void Run();
+
+  const DecodeFunction decode_;
+  const size_t max_output_size_;
+  const size_t ahead_size_;
+  SpscRing input_;
+  SpscRing output_;
+  // The number of bytes of output in |output_|.
+  std::atomic<size_t> ready_size_;
+
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  // The flags below are only changed while holding |mutex_|, other than
+  // |decoding_|, which the worker sets without it before each decode.
+
+  // Whether the worker and the decoding thread are sleeping, or about to.
+  std::atomic<bool> worker_sleeping_;
+  std::atomic<bool> consumer_sleeping_;
+  // Whether the worker may be using the rings.
+  std::atomic<bool> decoding_;
+  // Whether the worker is sleeping because the output ring is full.
+  std::atomic<bool> output_full_;
+  // Whether Queue is waiting for the worker to decode past |ahead_size_| to
+  // make space for input.
+  std::atomic<bool> queue_waiting_;
+  // Whether Flush is waiting for the worker to stop using the rings.
+  std::atomic<bool> flushing_;
+  std::atomic<bool> stopping_;
+
+  std::thread thread_;
+};
+
+}  // namespace exoplayer_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_DECODE_AHEAD_H_
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "decoder_stats.h"  // NOLINT
+
+#include <time.h>
+
+namespace exoplayer_jni {
+
+int64_t GetMonotonicTimeUs() { return GetMonotonicTimeNs() / 1000; }
+
+int64_t GetMonotonicTimeNs() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+void LatencyHistogram::Reset() {
+  for (int i = 0; i < kBucketCount; i++) {
+    counts_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+void LatencyHistogram::Snapshot(int64_t* destination) const {
+  for (int i = 0; i < kBucketCount; i++) {
+    destination[i] = counts_[i].load(std::memory_order_relaxed);
+  }
+}
+
+int LatencyHistogram::GetBucketIndex(int64_t value_us) {
+  if (value_us < kSubBucketCount) {
+    return value_us < 0 ? 0 : static_cast<int>(value_us);
+  }
+  if (value_us >= (INT64_C(1) << kMaxValueBits)) {
+    return kBucketCount - 1;
+  }
+  // The position of the most significant bit selects the power of two range,
+  // and the kSubBucketBits bits below it select the sub-bucket.
+  const uint32_t value = static_cast<uint32_t>(value_us);
+  const int most_significant_bit = 31 - __builtin_clz(value);
+  const int shift = most_significant_bit - kSubBucketBits;
+  return (shift + 1) * kSubBucketCount +
+         static_cast<int>((value >> shift) - kSubBucketCount);
+}
+
+int64_t LatencyHistogram::GetBucketLowerBound(int index) {
+  if (index < kSubBucketCount) {
+    return index;
+  }
+  const int shift = index / kSubBucketCount - 1;
+  return static_cast<int64_t>(kSubBucketCount + index % kSubBucketCount)
+         << shift;
+}
+
+void DecoderStats::SetFrameBuffersInUse(int64_t count) {
+  counters_[kFrameBuffersInUse].store(count, std::memory_order_relaxed);
+  std::atomic<int64_t>& peak = counters_[kPeakFrameBuffersInUse];
+  int64_t current_peak = peak.load(std::memory_order_relaxed);
+  while (count > current_peak &&
+         !peak.compare_exchange_weak(current_peak, count,
+                                     std::memory_order_relaxed)) {
+  }
+}
+
+void DecoderStats::Reset() {
+  for (int i = 0; i < kCounterCount; i++) {
+    counters_[i].store(0, std::memory_order_relaxed);
+  }
+  for (int i = 0; i < kHistogramCount; i++) {
+    histograms_[i].Reset();
+  }
+}
+
+void DecoderStats::Snapshot(int64_t* destination) const {
+  for (int i = 0; i < kCounterCount; i++) {
+    destination[i] = counters_[i].load(std::memory_order_relaxed);
+  }
+  destination += kCounterCount;
+  for (int i = 0; i < kHistogramCount; i++) {
+    histograms_[i].Snapshot(destination);
+    destination += LatencyHistogram::kBucketCount;
+  }
+}
+
+}  // namespace exoplayer_jni
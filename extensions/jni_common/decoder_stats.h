@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_DECODER_STATS_H_
+#define EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_DECODER_STATS_H_
+
+#include <atomic>
+#include <cstdint>
+
+namespace exoplayer_jni {
+
+// Returns the value of a monotonic clock, in microseconds.
+int64_t GetMonotonicTimeUs();
+
+// Returns the value of a monotonic clock, in nanoseconds.
+int64_t GetMonotonicTimeNs();
+
+// A histogram of latencies in microseconds, with logarithmic buckets that are
+// each split into linear sub-buckets in the style of HdrHistogram. Values below
+// kSubBucketCount have their own bucket and larger values are recorded with a
+// relative error of at most 1 / kSubBucketCount.
+//
+// Recording is wait-free. Counts are updated with relaxed atomic operations, so
+// the histogram can be read from another thread while it's being recorded to.
+class LatencyHistogram {
+ public:
+  // LINT.IfChange
+  static const int kSubBucketBits = 3;
+  static const int kSubBucketCount = 1 << kSubBucketBits;
+  // Values of 2^kMaxValueBits microseconds (about 134 seconds) or more are
+  // recorded in the last bucket.
+  static const int kMaxValueBits = 27;
+  static const int kBucketCount =
+      (kMaxValueBits - kSubBucketBits + 1) * kSubBucketCount;
+  // LINT.ThenChange(../../library/core/src/main/java/com/google/android/exoplayer2/decoder/NativeDecoderStats.java)
+
+  LatencyHistogram() { Reset(); }
+
+  // Not copyable or movable.
+  LatencyHistogram(const LatencyHistogram&) = delete;
+  LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+  // Records a latency. Negative values are recorded as zero.
+  void Record(int64_t value_us) {
+    counts_[GetBucketIndex(value_us)].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Clears all recorded values. Must not be called concurrently with Record().
+  void Reset();
+
+  // Copies the kBucketCount bucket counts to |destination|.
+  void Snapshot(int64_t* destination) const;
+
+  // Returns the index of the bucket that |value_us| is recorded in.
+  static int GetBucketIndex(int64_t value_us);
+
+  // Returns the smallest value recorded in the bucket at |index|.
+  static int64_t GetBucketLowerBound(int index);
+
+ private:
+  std::atomic<int64_t> counts_[kBucketCount];
+};
+
+// Statistics for a single native decoder instance. The decoder updates them
+// on its own threads, and they can be snapshot from any thread in a single JNI
+// call. Each value in a snapshot is accurate, but values may be updated while
+// the snapshot is being taken so they are not guaranteed to be consistent with
+// each other.
+class DecoderStats {
+ public:
+  // LINT.IfChange
+  enum Counter {
+    // Number of input buffers (packets or frames) queued to the decoder.
+    kInputBufferCount = 0,
+    // Number of bytes of encoded input.
+    kInputByteCount = 1,
+    // Number of decoded output buffers (video or audio frames).
+    kOutputBufferCount = 2,
+    // Number of bytes of decoded output, after any conversion.
+    kOutputByteCount = 3,
+    // Number of output buffers that were decoded but not output because they
+    // were decode-only.
+    kSkippedOutputBufferCount = 4,
+    // Number of failed decode calls.
+    kDecodeErrorCount = 5,
+    // Number of frame buffers currently referenced by the decoder or the
+    // application.
+    kFrameBuffersInUse = 6,
+    // Peak value of kFrameBuffersInUse.
+    kPeakFrameBuffersInUse = 7,
+    // Number of native allocations made for frame buffers.
+    kFrameBufferAllocationCount = 8,
+    // Number of calls to the decoder's per-buffer JNI entry points, such as
+    // decode, get frame, render and reset calls.
+    kNativeCallCount = 9,
+    // Time spent in those entry points, in nanoseconds. This includes upcalls,
+    // but not the transitions into and out of native code.
+    kNativeCallTimeNs = 10,
+    // Number of calls from the decoder's native code to Java methods.
+    kUpcallCount = 11,
+    // Time spent in upcalls, in nanoseconds, including the transitions.
+    kUpcallTimeNs = 12,
+    // Number of bytes currently allocated for frame buffers, whether or not
+    // they're in use.
+    kFrameBufferBytes = 13,
+    kCounterCount = 14
+  };
+
+  enum Histogram {
+    // Time spent in the codec library, decoding an input buffer.
+    kDecodeTime = 0,
+    // Time spent converting or copying decoded output into the output buffer.
+    kConvertTime = 1,
+    // Time spent rendering decoded output to a surface.
+    kRenderTime = 2,
+    kHistogramCount = 3
+  };
+
+  // Length of a snapshot: the counters, followed by the bucket counts of each
+  // histogram.
+  static const int kSnapshotLength =
+      kCounterCount + kHistogramCount * LatencyHistogram::kBucketCount;
+  // LINT.ThenChange(../../library/core/src/main/java/com/google/android/exoplayer2/decoder/NativeDecoderStats.java)
+
+  DecoderStats() { Reset(); }
+
+  // Not copyable or movable.
+  DecoderStats(const DecoderStats&) = delete;
+  DecoderStats& operator=(const DecoderStats&) = delete;
+
+  void Increment(Counter counter, int64_t delta = 1) {
+    counters_[counter].fetch_add(delta, std::memory_order_relaxed);
+  }
+
+  void RecordLatency(Histogram histogram, int64_t duration_us) {
+    histograms_[histogram].Record(duration_us);
+  }
+
+  // Sets kFrameBuffersInUse, updating kPeakFrameBuffersInUse if necessary.
+  void SetFrameBuffersInUse(int64_t count);
+
+  // Clears all counters and histograms. Must not be called concurrently with
+  // any other method.
+  void Reset();
+
+  // Copies kSnapshotLength values to |destination|.
+  void Snapshot(int64_t* destination) const;
+
+ private:
+  std::atomic<int64_t> counters_[kCounterCount];
+  LatencyHistogram histograms_[kHistogramCount];
+};
+
+// Records the time between its construction and destruction in a histogram of
+// |stats|, if |stats| is non-null.
+class ScopedLatencyTimer {
+ public:
+  ScopedLatencyTimer(DecoderStats* stats, DecoderStats::Histogram histogram)
+      : stats_(stats),
+        histogram_(histogram),
+        start_time_us_(stats ? GetMonotonicTimeUs() : 0) {}
+
+  ~ScopedLatencyTimer() {
+    if (stats_) {
+      stats_->RecordLatency(histogram_, GetMonotonicTimeUs() - start_time_us_);
+    }
+  }
+
+  // Not copyable or movable.
+  ScopedLatencyTimer(const ScopedLatencyTimer&) = delete;
+  ScopedLatencyTimer& operator=(const ScopedLatencyTimer&) = delete;
+
+ private:
+  DecoderStats* const stats_;
+  const DecoderStats::Histogram histogram_;
+  const int64_t start_time_us_;
+};
+
+// Increments a call counter of |stats| on construction, and adds the time
+// between its construction and destruction to a time counter in nanoseconds.
+class ScopedCallTimer {
+ public:
+  ScopedCallTimer(DecoderStats* stats, DecoderStats::Counter count_counter,
+                  DecoderStats::Counter time_counter)
+      : stats_(stats),
+        time_counter_(time_counter),
+        start_time_ns_(GetMonotonicTimeNs()) {
+    stats_->Increment(count_counter);
+  }
+
+  ~ScopedCallTimer() {
+    stats_->Increment(time_counter_, GetMonotonicTimeNs() - start_time_ns_);
+  }
+
+  // Not copyable or movable.
+  ScopedCallTimer(const ScopedCallTimer&) = delete;
+  ScopedCallTimer& operator=(const ScopedCallTimer&) = delete;
+
+ private:
+  DecoderStats* const stats_;
+  const DecoderStats::Counter time_counter_;
+  const int64_t start_time_ns_;
+};
+
+// Records a call to a per-buffer JNI entry point. Should be declared at the
+// start of the entry point, once the decoder's context is available.
+class ScopedNativeCallTimer : public ScopedCallTimer {
+ public:
+  explicit ScopedNativeCallTimer(DecoderStats* stats)
+      : ScopedCallTimer(stats, DecoderStats::kNativeCallCount,
+                        DecoderStats::kNativeCallTimeNs) {}
+};
+
+// Records an upcall from native code to a Java method. Should be declared in a
+// scope that contains only the upcall.
+class ScopedUpcallTimer : public ScopedCallTimer {
+ public:
+  explicit ScopedUpcallTimer(DecoderStats* stats)
+      : ScopedCallTimer(stats, DecoderStats::kUpcallCount,
+                        DecoderStats::kUpcallTimeNs) {}
+};
+
+}  // namespace exoplayer_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_DECODER_STATS_H_
@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_DECODER_STATS_JNI_H_
+#define EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_DECODER_STATS_JNI_H_
+
+#include <jni.h>
+
+#include "decoder_stats.h"  // NOLINT
+
+namespace exoplayer_jni {
+
+// Copies a snapshot of |stats| to |destination|, which must have a length of at
+// least DecoderStats::kSnapshotLength.
+inline void GetStatsSnapshot(JNIEnv* env, const DecoderStats& stats,
+                             jlongArray destination) {
+  jlong snapshot[DecoderStats::kSnapshotLength];
+  stats.Snapshot(snapshot);
+  env->SetLongArrayRegion(destination, 0, DecoderStats::kSnapshotLength,
+                          snapshot);
+}
+
+}  // namespace exoplayer_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_DECODER_STATS_JNI_H_
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fft.h"  // NOLINT
+
+#include <cmath>
+
+#include "cpu_dispatch.h"  // NOLINT
+
+namespace exoplayer_jni {
+namespace {
+
+const double kPi = 3.14159265358979323846;
+
+}  // namespace
+
+RealFft::RealFft() : size_(0) {}
+
+bool RealFft::Configure(int size) {
+  if (size < kMinSize || size > kMaxSize || (size & (size - 1)) != 0) {
+    return false;
+  }
+  size_ = size;
+  const int half_size = size / 2;
+  int bits = 0;
+  while ((1 << bits) < half_size) {
+    bits++;
+  }
+  bit_reversed_indices_.resize(half_size);
+  for (int i = 0; i < half_size; i++) {
+    int reversed = 0;
+    for (int bit = 0; bit < bits; bit++) {
+      if ((i >> bit) & 1) {
+        reversed |= 1 << (bits - 1 - bit);
+      }
+    }
+    bit_reversed_indices_[i] = reversed;
+  }
+  twiddle_real_.resize(half_size - 1);
+  twiddle_imag_.resize(half_size - 1);
+  for (int stage_half_size = 1; stage_half_size < half_size;
+       stage_half_size *= 2) {
+    float* const stage_real = &twiddle_real_[stage_half_size - 1];
+    float* const stage_imag = &twiddle_imag_[stage_half_size - 1];
+    for (int j = 0; j < stage_half_size; j++) {
+      const double angle = -kPi * j / stage_half_size;
+      stage_real[j] = static_cast<float>(std::cos(angle));
+      stage_imag[j] = static_cast<float>(std::sin(angle));
+    }
+  }
+  split_real_.resize(half_size + 1);
+  split_imag_.resize(half_size + 1);
+  for (int k = 0; k <= half_size; k++) {
+    const double angle = -2 * kPi * k / size;
+    split_real_[k] = static_cast<float>(std::cos(angle));
+    split_imag_[k] = static_cast<float>(std::sin(angle));
+  }
+  real_.resize(half_size);
+  imag_.resize(half_size);
+  return true;
+}
+
+void RealFft::ComputePowerSpectrum(const float* samples, float* power) {
+  const int half_size = size_ / 2;
+  // Even samples are the real parts and odd samples the imaginary parts.
+  for (int i = 0; i < half_size; i++) {
+    const int pair = bit_reversed_indices_[i];
+    real_[i] = samples[2 * pair];
+    imag_[i] = samples[2 * pair + 1];
+  }
+  const FftStageFunction fft_stage = GetKernels().fft_stage;
+  for (int stage_half_size = 1; stage_half_size < half_size;
+       stage_half_size *= 2) {
+    fft_stage(real_.data(), imag_.data(), &twiddle_real_[stage_half_size - 1],
+              &twiddle_imag_[stage_half_size - 1], half_size, stage_half_size);
+  }
+  // Bin k of the real spectrum is E + W^k * O, where E and O are the
+  // spectra of the even and odd samples, which are the conjugate symmetric and
+  // antisymmetric parts of the complex spectrum Z:
+  // E = (Z[k] + Z*[N/2 - k]) / 2 and O = (Z[k] - Z*[N/2 - k]) / 2i.
+  for (int k = 0; k <= half_size; k++) {
+    const int i = k % half_size;
+    const int mirror = (half_size - k) % half_size;
+    const float even_real = (real_[i] + real_[mirror]) * 0.5f;
+    const float even_imag = (imag_[i] - imag_[mirror]) * 0.5f;
+    const float odd_real = (real_[i] - real_[mirror]) * 0.5f;
+    const float odd_imag = (imag_[i] + imag_[mirror]) * 0.5f;
+    const float w_real = split_real_[k];
+    const float w_imag = split_imag_[k];
+    const float bin_real = even_real + w_imag * odd_real + w_real * odd_imag;
+    const float bin_imag = even_imag + w_imag * odd_imag - w_real * odd_real;
+    power[k] = bin_real * bin_real + bin_imag * bin_imag;
+  }
+}
+
+}  // namespace exoplayer_jni
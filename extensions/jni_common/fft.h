@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_FFT_H_
+#define EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_FFT_H_
+
+#include <vector>
+
+namespace exoplayer_jni {
+
+// An FFT of real samples, for sizes that are powers of two. The samples are
+// packed into a complex sequence of half the size, whose FFT is computed in
+// place by radix-2 decimation in time stages with GetKernels().fft_stage, and
+// split into the spectrum of the real samples. Not thread-safe, as the
+// transform uses the instance's buffers.
+class RealFft {
+ public:
+  static const int kMinSize = 16;
+  static const int kMaxSize = 16384;
+
+  RealFft();
+
+  // Not copyable or movable.
+  RealFft(const RealFft&) = delete;
+  RealFft& operator=(const RealFft&) = delete;
+
+  // Configures the FFT for |size| samples. Returns false if |size| isn't a
+  // power of two between kMinSize and kMaxSize.
+  bool Configure(int size);
+
+  // Returns the number of samples, or 0 if the FFT isn't configured.
+  int size() const { return size_; }
+
+  // Computes the spectrum of size() samples in |samples|, and writes the power
+  // (the squared magnitude) of bins 0 to size() / 2 to |power|.
+  void ComputePowerSpectrum(const float* samples, float* power);
+
+ private:
+  int size_;
+  // For each point of the half size FFT, the point whose sample pair it's
+  // loaded from, so that the stages output the bins in order.
+  std::vector<int> bit_reversed_indices_;
+  // The twiddle factors of each stage, with the |half_size| factors of a stage
+  // starting at index |half_size| - 1.
+  std::vector<float> twiddle_real_;
+  std::vector<float> twiddle_imag_;
+  // The factors that split the half size FFT into the real spectrum.
+  std::vector<float> split_real_;
+  std::vector<float> split_imag_;
+  std::vector<float> real_;
+  std::vector<float> imag_;
+};
+
+}  // namespace exoplayer_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_FFT_H_
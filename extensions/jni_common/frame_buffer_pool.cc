@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "frame_buffer_pool.h"  // NOLINT
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace exoplayer_jni {
+
+FrameBufferPool::FrameBufferPool(DecoderStats* stats) : stats_(stats) {}
+
+FrameBufferPool::~FrameBufferPool() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (int i = 0; i < buffer_count_; i++) {
+    free(buffers_[i].data);
+  }
+  stats_->Increment(DecoderStats::kFrameBufferBytes,
+                    -static_cast<int64_t>(allocated_bytes_));
+}
+
+int FrameBufferPool::Acquire(size_t min_size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Buffer* buffer;
+  if (free_count_) {
+    buffer = &buffers_[free_ids_[--free_count_]];
+  } else if (buffer_count_ < kMaxBuffers) {
+    buffer = &buffers_[buffer_count_];
+    buffer->id = buffer_count_++;
+    buffer->reference_count = 0;
+    buffer->data = nullptr;
+    buffer->capacity = 0;
+  } else {
+    // Maximum number of buffers is being used.
+    return -1;
+  }
+  if (buffer->capacity < min_size ||
+      buffer->capacity / kShrinkFactor > min_size) {
+    if (buffer->capacity > min_size) {
+      // The frame size has decreased, so other free buffers are likely to be
+      // too big as well.
+      ShrinkFreeBuffers(min_size);
+    }
+    if (!Reallocate(buffer, min_size)) {
+      free_ids_[free_count_++] = buffer->id;
+      return -1;
+    }
+  }
+  buffer->reference_count = 1;
+  UpdateBuffersInUse();
+  return buffer->id;
+}
+
+int FrameBufferPool::Reserve(int count, size_t size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  count = std::min(count, static_cast<int>(kMaxBuffers));
+  while (buffer_count_ < count) {
+    Buffer* const buffer = &buffers_[buffer_count_];
+    buffer->id = buffer_count_++;
+    buffer->reference_count = 0;
+    buffer->data = nullptr;
+    buffer->capacity = 0;
+    free_ids_[free_count_++] = buffer->id;
+  }
+  for (int i = 0; i < free_count_; i++) {
+    Buffer* const buffer = &buffers_[free_ids_[i]];
+    if (buffer->capacity >= size && buffer->capacity / kShrinkFactor <= size) {
+      continue;
+    }
+    if (!Reallocate(buffer, size)) {
+      break;
+    }
+    memset(buffer->data, 0, size);
+  }
+  return buffer_count_;
+}
+
+bool FrameBufferPool::AddReference(int id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (id < 0 || id >= buffer_count_ || !buffers_[id].reference_count) {
+    return false;
+  }
+  buffers_[id].reference_count++;
+  return true;
+}
+
+bool FrameBufferPool::Release(int id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (id < 0 || id >= buffer_count_ || !buffers_[id].reference_count) {
+    return false;
+  }
+  if (!--buffers_[id].reference_count) {
+    free_ids_[free_count_++] = id;
+    UpdateBuffersInUse();
+  }
+  return true;
+}
+
+bool FrameBufferPool::IsValid(int id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return id >= 0 && id < buffer_count_;
+}
+
+size_t FrameBufferPool::AllocatedBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return allocated_bytes_;
+}
+
+int FrameBufferPool::BufferCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return buffer_count_;
+}
+
+bool FrameBufferPool::Reallocate(Buffer* buffer, size_t size) {
+  free(buffer->data);
+  buffer->data = static_cast<uint8_t*>(malloc(size));
+  const size_t capacity = buffer->data ? size : 0;
+  stats_->Increment(DecoderStats::kFrameBufferBytes,
+                    static_cast<int64_t>(capacity) -
+                        static_cast<int64_t>(buffer->capacity));
+  allocated_bytes_ += capacity - buffer->capacity;
+  buffer->capacity = capacity;
+  stats_->Increment(DecoderStats::kFrameBufferAllocationCount);
+  return buffer->data != nullptr;
+}
+
+void FrameBufferPool::ShrinkFreeBuffers(size_t size) {
+  for (int i = 0; i < free_count_; i++) {
+    Buffer* const buffer = &buffers_[free_ids_[i]];
+    if (buffer->capacity / kShrinkFactor > size) {
+      free(buffer->data);
+      buffer->data = nullptr;
+      stats_->Increment(DecoderStats::kFrameBufferBytes,
+                        -static_cast<int64_t>(buffer->capacity));
+      allocated_bytes_ -= buffer->capacity;
+      buffer->capacity = 0;
+    }
+  }
+}
+
+void FrameBufferPool::UpdateBuffersInUse() {
+  stats_->SetFrameBuffersInUse(buffer_count_ - free_count_);
+}
+
+}  // namespace exoplayer_jni
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_FRAME_BUFFER_POOL_H_
+#define EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_FRAME_BUFFER_POOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>  // NOLINT
+
+#include "decoder_stats.h"  // NOLINT
+
+namespace exoplayer_jni {
+
+// A pool of reference counted frame buffers, which codec libraries decode into
+// through their frame buffer callbacks. Buffers are referenced by the codec
+// library while it uses them as reference frames, and by the application while
+// output frames are queued or rendered.
+//
+// A buffer's memory is reused for as long as it's big enough. When the frame
+// size decreases, for example after a switch to a lower resolution, buffers
+// that are more than kShrinkFactor times bigger than needed are reallocated
+// when they're next acquired, and the memory of free buffers that are that big
+// is released, so that the pool doesn't hold on to memory for the largest frame
+// size that was ever decoded.
+//
+// All methods are thread-safe.
+class FrameBufferPool {
+ public:
+  static const int kMaxBuffers = 32;
+  static const int kShrinkFactor = 2;
+
+  // Creates a pool that updates the frame buffer counters of |stats|.
+  explicit FrameBufferPool(DecoderStats* stats);
+  // Frees all buffers. The codec library must have released its references.
+  ~FrameBufferPool();
+
+  // Not copyable or movable.
+  FrameBufferPool(const FrameBufferPool&) = delete;
+  FrameBufferPool& operator=(const FrameBufferPool&) = delete;
+
+  // Acquires a free buffer of at least |min_size| bytes, holding one reference
+  // to it. Returns the buffer's id, or -1 if all kMaxBuffers buffers are in use
+  // or the allocation failed. The buffer's contents are undefined.
+  int Acquire(size_t min_size);
+
+  // Allocates free buffers of |size| bytes until the pool has |count| buffers,
+  // and writes to them so that their memory is mapped. Used to move the cost of
+  // allocating buffers out of the first decode calls. Free buffers that aren't
+  // big enough are reallocated. Returns the number of buffers in the pool.
+  int Reserve(int count, size_t size);
+
+  // Adds a reference to the buffer with |id|. Returns false if |id| is invalid.
+  bool AddReference(int id);
+
+  // Removes a reference to the buffer with |id|, which is returned to the pool
+  // once it has no references. Returns false if |id| is invalid or the buffer
+  // isn't in use.
+  bool Release(int id);
+
+  // Returns the memory of the buffer with |id|. The memory is valid until the
+  // buffer is released.
+  uint8_t* Data(int id) const { return buffers_[id].data; }
+
+  // Returns a pointer to the id of the buffer with |id|, which remains valid
+  // for the lifetime of the pool. Codec libraries pass it back to the release
+  // callback as the buffer's private data.
+  void* PrivateData(int id) { return &buffers_[id].id; }
+
+  // Returns whether |id| is the id of a buffer that has been acquired.
+  bool IsValid(int id) const;
+
+  // Returns the number of bytes allocated for buffers.
+  size_t AllocatedBytes() const;
+
+  // Returns the number of buffers that have been created.
+  int BufferCount() const;
+
+ private:
+  struct Buffer {
+    int id;
+    int reference_count;
+    uint8_t* data;
+    size_t capacity;
+  };
+
+  // Frees and reallocates the memory of |buffer|, updating the statistics.
+  // Returns false if the allocation failed. Must be called with |mutex_| held.
+  bool Reallocate(Buffer* buffer, size_t size);
+  // Frees the memory of free buffers that are over kShrinkFactor times bigger
+  // than |size|. Must be called with |mutex_| held.
+  void ShrinkFreeBuffers(size_t size);
+  // Updates the number of buffers in use in the statistics. Must be called with
+  // |mutex_| held.
+  void UpdateBuffersInUse();
+
+  Buffer buffers_[kMaxBuffers];
+  int buffer_count_ = 0;
+  // Ids of the buffers without references, most recently released last.
+  int free_ids_[kMaxBuffers];
+  int free_count_ = 0;
+  size_t allocated_bytes_ = 0;
+
+  DecoderStats* const stats_;
+
+  mutable std::mutex mutex_;
+};
+
+}  // namespace exoplayer_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_FRAME_BUFFER_POOL_H_
@@ -0,0 +1,480 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks the AudioChain that the audio extensions run on their decoded output:
+// channel remapping, gain, sample format conversion, sample rate conversion,
+// and that processing a stream in differently sized calls, as decoders do with
+// their variable frame sizes, produces the same output as a single call, and
+// that long runs of silence are shortened to their padding.
+//
+// Usage: audio_chain_test
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "audio_chain.h"   // NOLINT
+#include "cpu_dispatch.h"  // NOLINT
+#include "test_data.h"     // NOLINT
+
+namespace exoplayer_jni {
+namespace {
+
+const double kPi = 3.14159265358979323846;
+
+// Configures |chain| with |config| for the given input, reporting a failure.
+bool Configure(AudioChain* chain, const AudioChainConfig& config,
+               int channel_count, int sample_rate, PcmEncoding encoding,
+               std::string* error) {
+  chain->SetConfig(config);
+  if (!chain->Configure(channel_count, sample_rate, encoding)) {
+    *error = "Configure(" + std::to_string(channel_count) + ", " +
+             std::to_string(sample_rate) + ", " + std::to_string(encoding) +
+             ") failed";
+    return false;
+  }
+  return true;
+}
+
+// Processes |frame_count| interleaved frames in a single call, returning the
+// output, or an empty vector if processing failed.
+std::vector<uint8_t> Process(AudioChain* chain, const void* input,
+                             int frame_count) {
+  std::vector<uint8_t> output(chain->GetMaxOutputSize(frame_count));
+  const int size =
+      chain->Process(input, frame_count, output.data(), output.size());
+  output.resize(size < 0 ? 0 : size);
+  return output;
+}
+
+bool TestRemapAndGain(std::string* error) {
+  const int frame_count = 1000;
+  Random random(1);
+  std::vector<int16_t> input(frame_count * 2);
+  for (int16_t& sample : input) {
+    sample = static_cast<int16_t>(random.Next());
+  }
+  AudioChainConfig config;
+  config.channel_count = 3;
+  config.channel_map[0] = 1;
+  config.channel_map[1] = 0;
+  config.channel_map[2] = 0;
+  config.gain = 0.5f;
+  AudioChain chain;
+  if (!Configure(&chain, config, 2, 48000, kPcmEncoding16Bit, error)) {
+    return false;
+  }
+  if (chain.IsPassthrough() || chain.output_channel_count() != 3 ||
+      chain.output_encoding() != kPcmEncoding16Bit ||
+      chain.output_sample_rate() != 48000) {
+    *error = "unexpected output format after remapping";
+    return false;
+  }
+  const std::vector<uint8_t> output = Process(&chain, input.data(),
+                                              frame_count);
+  if (output.size() != frame_count * 3 * sizeof(int16_t)) {
+    *error = "remapped output has " + std::to_string(output.size()) + " bytes";
+    return false;
+  }
+  const int16_t* samples = reinterpret_cast<const int16_t*>(output.data());
+  for (int i = 0; i < frame_count; i++) {
+    const int16_t* frame = &input[i * 2];
+    const int16_t* output_frame = &samples[i * 3];
+    // Halving rounds half away from zero.
+    const int expected[] = {
+        static_cast<int>(std::round(frame[1] * 0.5)),
+        static_cast<int>(std::round(frame[0] * 0.5)),
+        static_cast<int>(std::round(frame[0] * 0.5))};
+    for (int c = 0; c < 3; c++) {
+      if (output_frame[c] != expected[c]) {
+        *error = "remapped sample " + std::to_string(c) + " of frame " +
+                 std::to_string(i) + " is " + std::to_string(output_frame[c]) +
+                 ", expected " + std::to_string(expected[c]);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool TestPassthrough(std::string* error) {
+  AudioChain chain;
+  AudioChainConfig config;
+  if (!Configure(&chain, config, 6, 44100, kPcmEncoding24Bit, error)) {
+    return false;
+  }
+  if (!chain.IsPassthrough() || !chain.IsConfiguredFor(6, 44100,
+                                                       kPcmEncoding24Bit)) {
+    *error = "default configuration isn't passthrough";
+    return false;
+  }
+  config.channel_count = 6;
+  for (int c = 0; c < 6; c++) {
+    config.channel_map[c] = c;
+  }
+  config.encoding = kPcmEncoding24Bit;
+  config.sample_rate = 44100;
+  if (!Configure(&chain, config, 6, 44100, kPcmEncoding24Bit, error)) {
+    return false;
+  }
+  if (!chain.IsPassthrough()) {
+    *error = "identity configuration isn't passthrough";
+    return false;
+  }
+  config.gain = 0.99f;
+  if (!Configure(&chain, config, 6, 44100, kPcmEncoding24Bit, error)) {
+    return false;
+  }
+  if (chain.IsPassthrough()) {
+    *error = "configuration with gain is passthrough";
+    return false;
+  }
+  config.channel_map[5] = 6;
+  chain.SetConfig(config);
+  if (chain.Configure(6, 44100, kPcmEncoding24Bit) ||
+      chain.IsConfiguredFor(6, 44100, kPcmEncoding24Bit)) {
+    *error = "channel map referring to a missing channel was accepted";
+    return false;
+  }
+  return true;
+}
+
+bool TestEncodingConversions(std::string* error) {
+  // Full scale 24-bit samples, and samples with their low bits set.
+  const int32_t values[] = {-8388608, 8388607, -1, 1, 0, 4660, -4661, 123456};
+  const int frame_count = sizeof(values) / sizeof(values[0]);
+  std::vector<uint8_t> input(frame_count * 3);
+  for (int i = 0; i < frame_count; i++) {
+    input[3 * i] = static_cast<uint8_t>(values[i]);
+    input[3 * i + 1] = static_cast<uint8_t>(values[i] >> 8);
+    input[3 * i + 2] = static_cast<uint8_t>(values[i] >> 16);
+  }
+
+  AudioChain chain;
+  AudioChainConfig config;
+  config.encoding = kPcmEncodingFloat;
+  if (!Configure(&chain, config, 1, 96000, kPcmEncoding24Bit, error)) {
+    return false;
+  }
+  const std::vector<uint8_t> float_output =
+      Process(&chain, input.data(), frame_count);
+  if (float_output.size() != frame_count * sizeof(float)) {
+    *error = "24-bit to float output has the wrong size";
+    return false;
+  }
+  const float* floats = reinterpret_cast<const float*>(float_output.data());
+  for (int i = 0; i < frame_count; i++) {
+    if (floats[i] != values[i] / 8388608.0f) {
+      *error = "24-bit sample " + std::to_string(values[i]) +
+               " converted to " + std::to_string(floats[i]);
+      return false;
+    }
+  }
+
+  // Float back to 24-bit and 32-bit is exact.
+  config.encoding = kPcmEncoding24Bit;
+  if (!Configure(&chain, config, 1, 96000, kPcmEncodingFloat, error)) {
+    return false;
+  }
+  if (Process(&chain, floats, frame_count) != input) {
+    *error = "float to 24-bit conversion isn't exact";
+    return false;
+  }
+  config.encoding = kPcmEncoding32Bit;
+  if (!Configure(&chain, config, 1, 96000, kPcmEncodingFloat, error)) {
+    return false;
+  }
+  const std::vector<uint8_t> output_32 = Process(&chain, floats, frame_count);
+  const int32_t* samples_32 = reinterpret_cast<const int32_t*>(
+      output_32.data());
+  for (int i = 0; i < frame_count; i++) {
+    if (output_32.size() != frame_count * sizeof(int32_t) ||
+        samples_32[i] != values[i] * 256) {
+      *error = "float to 32-bit conversion isn't exact";
+      return false;
+    }
+  }
+
+  // Out of range float samples are clamped.
+  const float loud[] = {1.5f, -1.5f, 1.0f, -1.0f};
+  config.encoding = kPcmEncoding16Bit;
+  if (!Configure(&chain, config, 1, 96000, kPcmEncodingFloat, error)) {
+    return false;
+  }
+  const std::vector<uint8_t> output_16 = Process(&chain, loud, 4);
+  const int16_t expected_16[] = {32767, -32768, 32767, -32768};
+  if (output_16.size() != sizeof(expected_16) ||
+      memcmp(output_16.data(), expected_16, sizeof(expected_16)) != 0) {
+    *error = "float to 16-bit conversion doesn't clamp";
+    return false;
+  }
+  return true;
+}
+
+bool TestPlanar(std::string* error) {
+  const int frame_count = 700;
+  const int channel_count = 6;
+  Random random(2);
+  std::vector<std::vector<int32_t>> channels(channel_count);
+  std::vector<const int32_t*> planes(channel_count);
+  for (int c = 0; c < channel_count; c++) {
+    channels[c].resize(frame_count);
+    for (int i = 0; i < frame_count; i++) {
+      // Sign extended 8-bit samples, as libFLAC decodes them.
+      channels[c][i] = static_cast<int8_t>(random.Next());
+    }
+    planes[c] = channels[c].data();
+  }
+  // Downmixes to the front channels, keeping the 16-bit output the extension
+  // uses for 8-bit streams.
+  AudioChainConfig config;
+  config.channel_count = 2;
+  config.channel_map[0] = 0;
+  config.channel_map[1] = 1;
+  AudioChain chain;
+  if (!Configure(&chain, config, channel_count, 44100, kPcmEncoding16Bit,
+                 error)) {
+    return false;
+  }
+  std::vector<uint8_t> output(chain.GetMaxOutputSize(frame_count));
+  const int size = chain.ProcessPlanar(planes.data(), 8, frame_count,
+                                       output.data(), output.size());
+  if (size != frame_count * 2 * static_cast<int>(sizeof(int16_t))) {
+    *error = "planar output has " + std::to_string(size) + " bytes";
+    return false;
+  }
+  const int16_t* samples = reinterpret_cast<const int16_t*>(output.data());
+  for (int i = 0; i < frame_count; i++) {
+    for (int c = 0; c < 2; c++) {
+      if (samples[i * 2 + c] != channels[c][i] * 256) {
+        *error = "planar sample " + std::to_string(c) + " of frame " +
+                 std::to_string(i) + " doesn't match";
+        return false;
+      }
+    }
+  }
+  if (chain.ProcessPlanar(planes.data(), 8, frame_count, output.data(),
+                          output.size() - 1) != -1) {
+    *error = "output buffer that's too small was accepted";
+    return false;
+  }
+  return true;
+}
+
+bool TestResampledSine(std::string* error) {
+  const int input_rate = 44100;
+  const int output_rate = 48000;
+  const int frame_count = input_rate;
+  const double frequency = 1000;
+  std::vector<float> input(frame_count);
+  for (int i = 0; i < frame_count; i++) {
+    input[i] = static_cast<float>(0.5 * sin(2 * kPi * frequency * i /
+                                            input_rate));
+  }
+  AudioChainConfig config;
+  config.sample_rate = output_rate;
+  AudioChain chain;
+  if (!Configure(&chain, config, 1, input_rate, kPcmEncodingFloat, error)) {
+    return false;
+  }
+  const std::vector<uint8_t> output =
+      Process(&chain, input.data(), frame_count);
+  const int output_frame_count = static_cast<int>(output.size() /
+                                                  sizeof(float));
+  const int expected_frame_count =
+      static_cast<int>(static_cast<int64_t>(frame_count) * output_rate /
+                       input_rate);
+  if (std::abs(output_frame_count - expected_frame_count) > 1) {
+    *error = "resampled " + std::to_string(frame_count) + " frames to " +
+             std::to_string(output_frame_count) + ", expected " +
+             std::to_string(expected_frame_count);
+    return false;
+  }
+  // Linear interpolation of a 1 kHz tone at 44.1 kHz is accurate to within
+  // (2 * pi * 1000 / 44100)^2 / 8 of the amplitude.
+  const float* samples = reinterpret_cast<const float*>(output.data());
+  double max_error = 0;
+  for (int i = 0; i < output_frame_count; i++) {
+    const double expected =
+        0.5 * sin(2 * kPi * frequency * i / output_rate);
+    max_error = std::max(max_error, std::fabs(samples[i] - expected));
+  }
+  if (max_error > 0.002) {
+    *error = "resampled sine has a maximum error of " +
+             std::to_string(max_error);
+    return false;
+  }
+  return true;
+}
+
+bool TestSplitProcessing(std::string* error) {
+  const int frame_count = 20000;
+  const int channel_count = 2;
+  Random random(3);
+  std::vector<int16_t> input(frame_count * channel_count);
+  for (int16_t& sample : input) {
+    sample = static_cast<int16_t>(random.Next());
+  }
+  AudioChainConfig config;
+  config.gain = 0.8f;
+  config.sample_rate = 48000;
+  AudioChain chain;
+  if (!Configure(&chain, config, channel_count, 44100, kPcmEncoding16Bit,
+                 error)) {
+    return false;
+  }
+  const std::vector<uint8_t> single_call =
+      Process(&chain, input.data(), frame_count);
+
+  // Call sizes around the block size, and the sizes of AAC, MP3 and Opus
+  // frames.
+  const int call_sizes[] = {1, 255, 256, 257, 1024, 1152, 960, 37, 513};
+  const int call_size_count = sizeof(call_sizes) / sizeof(call_sizes[0]);
+  chain.Reset();
+  std::vector<uint8_t> split_calls;
+  for (int first_frame = 0, call = 0; first_frame < frame_count; call++) {
+    const int call_frames = std::min(call_sizes[call % call_size_count],
+                                     frame_count - first_frame);
+    std::vector<uint8_t> output(chain.GetMaxOutputSize(call_frames));
+    const int size =
+        chain.Process(&input[first_frame * channel_count], call_frames,
+                      output.data(), output.size());
+    if (size < 0) {
+      *error = "processing " + std::to_string(call_frames) + " frames failed";
+      return false;
+    }
+    split_calls.insert(split_calls.end(), output.begin(),
+                       output.begin() + size);
+    first_frame += call_frames;
+  }
+  if (split_calls != single_call) {
+    *error = "output of split calls doesn't match a single call";
+    return false;
+  }
+  return true;
+}
+
+// Appends |frame_count| frames of a tone, or of quiet noise below the silence
+// threshold, to |samples|.
+void AppendSegment(bool silent, int frame_count, Random* random,
+                   std::vector<int16_t>* samples) {
+  for (int i = 0; i < frame_count; i++) {
+    samples->push_back(
+        silent ? static_cast<int16_t>(static_cast<int>(random->Next() % 201) -
+                                      100)
+               : static_cast<int16_t>(10000 * sin(2 * kPi * 440 * i / 48000)));
+  }
+}
+
+bool TestSilenceSkipping(std::string* error) {
+  // Segments are whole blocks, so that no block mixes tone and silence. The
+  // long silence is skipped down to its padding, and the short one is kept.
+  const int tone_frames = 19 * 256;
+  const int long_silence_frames = 188 * 256;
+  const int short_silence_frames = 19 * 256;
+  const int padding_frames = 960;
+  Random random(4);
+  std::vector<int16_t> input;
+  AppendSegment(/* silent= */ false, tone_frames, &random, &input);
+  AppendSegment(/* silent= */ true, long_silence_frames, &random, &input);
+  AppendSegment(/* silent= */ false, tone_frames, &random, &input);
+  AppendSegment(/* silent= */ true, short_silence_frames, &random, &input);
+  AppendSegment(/* silent= */ false, tone_frames, &random, &input);
+  const int frame_count = static_cast<int>(input.size());
+
+  AudioChainConfig config;
+  config.silence_threshold = 1024 / 32768.0f;
+  config.min_silence_us = 150000;
+  config.silence_padding_us = 20000;
+  AudioChain chain;
+  if (!Configure(&chain, config, 1, 48000, kPcmEncoding16Bit, error)) {
+    return false;
+  }
+  if (chain.IsPassthrough()) {
+    *error = "silence skipping configuration is passthrough";
+    return false;
+  }
+  std::vector<int16_t> output;
+  int skipped_frame_count = 0;
+  const int call_frames = 1024;
+  for (int first_frame = 0; first_frame < frame_count;
+       first_frame += call_frames) {
+    const int frames = std::min(call_frames, frame_count - first_frame);
+    std::vector<int16_t> call_output(chain.GetMaxOutputSize(frames) /
+                                     sizeof(int16_t));
+    const int size =
+        chain.Process(&input[first_frame], frames, call_output.data(),
+                      call_output.size() * sizeof(int16_t));
+    if (size < 0) {
+      *error = "processing " + std::to_string(frames) + " frames failed";
+      return false;
+    }
+    output.insert(output.end(), call_output.begin(),
+                  call_output.begin() + size / sizeof(int16_t));
+    skipped_frame_count += chain.skipped_frame_count();
+  }
+
+  const int expected_skipped_frame_count =
+      long_silence_frames - 2 * padding_frames;
+  if (skipped_frame_count != expected_skipped_frame_count ||
+      static_cast<int>(output.size()) !=
+          frame_count - expected_skipped_frame_count) {
+    *error = "skipped " + std::to_string(skipped_frame_count) +
+             " frames and output " + std::to_string(output.size()) +
+             ", expected to skip " +
+             std::to_string(expected_skipped_frame_count);
+    return false;
+  }
+  // The output is the input without the middle of the long silence.
+  const int skip_start = tone_frames + padding_frames;
+  std::vector<int16_t> expected(input.begin(), input.begin() + skip_start);
+  expected.insert(expected.end(),
+                  input.begin() + skip_start + expected_skipped_frame_count,
+                  input.end());
+  if (output != expected) {
+    *error = "output with skipped silence doesn't match the input";
+    return false;
+  }
+  return true;
+}
+
+int Main(int argc, char** argv) {
+  if (argc != 1) {
+    fprintf(stderr, "Usage: %s\n", argv[0]);
+    return 2;
+  }
+  InitCpuDispatch();
+  std::string error;
+  const bool passed = TestRemapAndGain(&error) && TestPassthrough(&error) &&
+                      TestEncodingConversions(&error) && TestPlanar(&error) &&
+                      TestResampledSine(&error) &&
+                      TestSplitProcessing(&error) &&
+                      TestSilenceSkipping(&error);
+  if (!passed) {
+    fprintf(stderr, "FAILED: %s\n", error.c_str());
+    return 1;
+  }
+  printf("PASSED\n");
+  return 0;
+}
+
+}  // namespace
+}  // namespace exoplayer_jni
+
+int main(int argc, char** argv) { return exoplayer_jni::Main(argc, argv); }
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_HOST_AUDIO_QUALITY_H_
+#define EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_HOST_AUDIO_QUALITY_H_
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace exoplayer_jni {
+
+// Returns |frame_count| interleaved frames of a tone with a fundamental of
+// |frequency| and its first three overtones, at a peak amplitude of at most
+// 0.5. Each channel's phase is offset so that the channels differ.
+inline std::vector<float> HarmonicTone(int frame_count, int channel_count,
+                                       int sample_rate, double frequency) {
+  const double kPi = 3.14159265358979323846;
+  std::vector<float> samples(static_cast<size_t>(frame_count) *
+                             channel_count);
+  for (int i = 0; i < frame_count; i++) {
+    for (int c = 0; c < channel_count; c++) {
+      double sample = 0;
+      for (int harmonic = 1; harmonic <= 4; harmonic++) {
+        sample += 0.24 / harmonic *
+                  sin(2 * kPi * frequency * harmonic * i / sample_rate +
+                      c * 0.5 * harmonic);
+      }
+      samples[static_cast<size_t>(i) * channel_count + c] =
+          static_cast<float>(sample);
+    }
+  }
+  return samples;
+}
+
+// Returns the fundamental frequency of the first channel of |frame_count|
+// interleaved frames, between 50 Hz and 2 kHz, estimated from the shortest lag
+// at which the normalized autocorrelation is close to its maximum. Returns 0 if
+// there are too few frames.
+inline double EstimateFrequency(const float* samples, int channel_count,
+                                int frame_count, int sample_rate) {
+  const int min_lag = sample_rate / 2000;
+  const int max_lag = sample_rate / 50;
+  const int length = frame_count - max_lag - 1;
+  if (length <= 0) {
+    return 0;
+  }
+  std::vector<double> correlations(max_lag + 2);
+  double max_correlation = 0;
+  for (int lag = min_lag - 1; lag <= max_lag + 1; lag++) {
+    double dot = 0;
+    double energy_a = 0;
+    double energy_b = 0;
+    for (int i = 0; i < length; i++) {
+      const double a = samples[static_cast<size_t>(i) * channel_count];
+      const double b =
+          samples[static_cast<size_t>(i + lag) * channel_count];
+      dot += a * b;
+      energy_a += a * a;
+      energy_b += b * b;
+    }
+    const double energy = sqrt(energy_a * energy_b);
+    correlations[lag] = energy > 0 ? dot / energy : 0;
+    if (lag >= min_lag && lag <= max_lag) {
+      max_correlation = std::max(max_correlation, correlations[lag]);
+    }
+  }
+  for (int lag = min_lag; lag <= max_lag; lag++) {
+    const double correlation = correlations[lag];
+    if (correlation >= 0.95 * max_correlation &&
+        correlation >= correlations[lag - 1] &&
+        correlation >= correlations[lag + 1]) {
+      // Interpolate the peak with a parabola through its neighbours.
+      const double previous = correlations[lag - 1];
+      const double next = correlations[lag + 1];
+      const double denominator = previous - 2 * correlation + next;
+      const double offset =
+          denominator != 0 ? 0.5 * (previous - next) / denominator : 0;
+      return sample_rate / (lag + offset);
+    }
+  }
+  return 0;
+}
+
+// Returns the difference in cents between |frequency| and |reference|.
+inline double GetCents(double frequency, double reference) {
+  return 1200 * log2(frequency / reference);
+}
+
+// Returns the ratio in dB between the highest and lowest RMS level of the
+// first channel over consecutive windows of |window_frame_count| frames. For a
+// periodic signal whose period divides the window, this is 0 when the
+// amplitude is steady.
+inline double GetEnvelopeRippleDb(const float* samples, int channel_count,
+                                  int frame_count, int window_frame_count) {
+  double min_level = 0;
+  double max_level = 0;
+  bool first = true;
+  for (int start = 0; start + window_frame_count <= frame_count;
+       start += window_frame_count) {
+    double energy = 0;
+    for (int i = start; i < start + window_frame_count; i++) {
+      const double sample = samples[static_cast<size_t>(i) * channel_count];
+      energy += sample * sample;
+    }
+    const double level = sqrt(energy / window_frame_count);
+    min_level = first ? level : std::min(min_level, level);
+    max_level = first ? level : std::max(max_level, level);
+    first = false;
+  }
+  return min_level > 0 ? 20 * log10(max_level / min_level) : 0;
+}
+
+}  // namespace exoplayer_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_HOST_AUDIO_QUALITY_H_
@@ -0,0 +1,487 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks that MixCrossfade applies the gains of each crossfade curve across
+// calls of different sizes, in every PCM encoding and in place, and fades in
+// or out over silence once either stream has ended. Checks that CrossfadeMixer
+// delays a stream's output by the crossfade duration, mixes the end of each
+// stream into the start of the next, and fades out the end of a stream that's
+// followed by a shorter one.
+//
+// Usage: crossfade_mixer_test
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "audio_chain.h"      // NOLINT
+#include "cpu_dispatch.h"     // NOLINT
+#include "crossfade_mixer.h"  // NOLINT
+
+namespace exoplayer_jni {
+namespace {
+
+const double kPi = 3.14159265358979323846;
+const int kChannelCount = 2;
+// A crossfade of more than a block, which is mixed in calls of these sizes.
+const int kDuration = 1000;
+const int kCallFrameCounts[] = {1, 127, 300, 572};
+// The levels of the outgoing and incoming streams, which are constant so that
+// the output is the sum of the gains weighted by them.
+const float kOutgoingLevel = 0.5f;
+const float kIncomingLevel = -0.25f;
+
+// Returns the expected output at |position| of a crossfade, where
+// |outgoing_level| is 0 for silence.
+double GetExpectedSample(CrossfadeCurve curve, int64_t position,
+                         double outgoing_level) {
+  const double t = static_cast<double>(position) / kDuration;
+  if (curve == kCrossfadeCurveEqualPower) {
+    return outgoing_level * std::cos(t * kPi / 2) +
+           kIncomingLevel * std::sin(t * kPi / 2);
+  }
+  return outgoing_level * (1 - t) + kIncomingLevel * t;
+}
+
+// Returns |frame_count| frames of |level| in |encoding|.
+std::vector<uint8_t> CreateConstant(PcmEncoding encoding, int frame_count,
+                                    float level) {
+  const std::vector<float> samples(frame_count * kChannelCount, level);
+  std::vector<uint8_t> data(samples.size() * GetBytesPerSample(encoding));
+  PackPcm(samples.data(), encoding, samples.size(), data.data());
+  return data;
+}
+
+// Mixes a whole crossfade in calls of kCallFrameCounts frames, in place in the
+// incoming stream's buffer, and checks the output. The outgoing stream ends
+// after |outgoing_frame_count| frames.
+bool CheckCrossfade(PcmEncoding encoding, CrossfadeCurve curve,
+                    int outgoing_frame_count, std::string* error) {
+  const std::string name = "encoding " + std::to_string(encoding) +
+                           " curve " + std::to_string(curve) + " outgoing " +
+                           std::to_string(outgoing_frame_count);
+  const std::vector<uint8_t> outgoing =
+      CreateConstant(encoding, outgoing_frame_count, kOutgoingLevel);
+  std::vector<uint8_t> incoming =
+      CreateConstant(encoding, kDuration, kIncomingLevel);
+  const size_t frame_size = kChannelCount * GetBytesPerSample(encoding);
+  int position = 0;
+  for (int frame_count : kCallFrameCounts) {
+    // Calls are split where the outgoing stream ends, as the Java mixer does.
+    while (frame_count > 0) {
+      const bool outgoing_ended = position >= outgoing_frame_count;
+      const int mix_frame_count =
+          outgoing_ended
+              ? frame_count
+              : std::min(frame_count, outgoing_frame_count - position);
+      const uint8_t* outgoing_frames =
+          outgoing_ended ? nullptr : outgoing.data() + position * frame_size;
+      uint8_t* incoming_frames = incoming.data() + position * frame_size;
+      if (!MixCrossfade(outgoing_frames, incoming_frames, incoming_frames,
+                        mix_frame_count, kChannelCount, encoding, curve,
+                        position, kDuration)) {
+        *error = name + ": failed to mix";
+        return false;
+      }
+      position += mix_frame_count;
+      frame_count -= mix_frame_count;
+    }
+  }
+  // Integer encodings are compared with a tolerance of one 16-bit level, and
+  // floats with a tolerance for the gains' rounding.
+  const double tolerance =
+      encoding == kPcmEncoding16Bit ? 1.0 / 32768 : 1e-6;
+  std::vector<float> output(kDuration * kChannelCount);
+  UnpackPcm(incoming.data(), encoding, output.size(), output.data());
+  for (int i = 0; i < kDuration; i++) {
+    const double expected = GetExpectedSample(
+        curve, i, i < outgoing_frame_count ? kOutgoingLevel : 0);
+    for (int c = 0; c < kChannelCount; c++) {
+      if (std::fabs(output[i * kChannelCount + c] - expected) > tolerance) {
+        char message[128];
+        snprintf(message, sizeof(message),
+                 ": frame %d has sample %.7f, expected %.7f", i,
+                 output[i * kChannelCount + c], expected);
+        *error = name + message;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool TestCrossfades(std::string* error) {
+  const PcmEncoding kEncodings[] = {kPcmEncoding16Bit, kPcmEncoding24Bit,
+                                    kPcmEncoding32Bit, kPcmEncodingFloat};
+  const CrossfadeCurve kCurves[] = {kCrossfadeCurveLinear,
+                                    kCrossfadeCurveEqualPower};
+  for (PcmEncoding encoding : kEncodings) {
+    for (CrossfadeCurve curve : kCurves) {
+      // An outgoing stream that lasts the whole crossfade, and one that ends
+      // part way through a call.
+      if (!CheckCrossfade(encoding, curve, kDuration, error) ||
+          !CheckCrossfade(encoding, curve, 200, error)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool TestFadeOut(std::string* error) {
+  std::vector<uint8_t> buffer =
+      CreateConstant(kPcmEncodingFloat, kDuration, kOutgoingLevel);
+  if (!MixCrossfade(buffer.data(), nullptr, buffer.data(), kDuration,
+                    kChannelCount, kPcmEncodingFloat,
+                    kCrossfadeCurveEqualPower, 0, kDuration)) {
+    *error = "failed to fade out";
+    return false;
+  }
+  std::vector<float> output(kDuration * kChannelCount);
+  UnpackPcm(buffer.data(), kPcmEncodingFloat, output.size(), output.data());
+  for (int i = 0; i < kDuration; i++) {
+    const double expected =
+        kOutgoingLevel * std::cos(static_cast<double>(i) / kDuration * kPi / 2);
+    if (std::fabs(output[i * kChannelCount] - expected) > 1e-6) {
+      *error = "fade out frame " + std::to_string(i) + " is wrong";
+      return false;
+    }
+  }
+  return true;
+}
+
+bool TestInvalidArguments(std::string* error) {
+  std::vector<uint8_t> buffer = CreateConstant(kPcmEncodingFloat, 16, 0.5f);
+  const std::vector<uint8_t> original = buffer;
+  const bool mixed =
+      MixCrossfade(nullptr, buffer.data(), buffer.data(), 16, kChannelCount,
+                   kPcmEncodingFloat, kCrossfadeCurveLinear,
+                   /* position= */ 10, /* duration= */ 20) ||
+      MixCrossfade(nullptr, buffer.data(), buffer.data(), 16, kChannelCount,
+                   kPcmEncodingInvalid, kCrossfadeCurveLinear, 0, 20) ||
+      MixCrossfade(nullptr, buffer.data(), buffer.data(), 16,
+                   AudioChainConfig::kMaxChannels + 1, kPcmEncodingFloat,
+                   kCrossfadeCurveLinear, 0, 20) ||
+      MixCrossfade(nullptr, buffer.data(), buffer.data(), 16, kChannelCount,
+                   kPcmEncodingFloat, static_cast<CrossfadeCurve>(2), 0, 20) ||
+      MixCrossfade(nullptr, nullptr, buffer.data(), 16, kChannelCount,
+                   kPcmEncodingFloat, kCrossfadeCurveLinear, 0, 20);
+  if (mixed || buffer != original) {
+    *error = "mixed with invalid arguments";
+    return false;
+  }
+  return true;
+}
+
+// The mixer's streams are at a low sample rate, so that a crossfade of
+// kMixerDurationUs is kMixerFrames frames.
+const int kMixerSampleRate = 1000;
+const int64_t kMixerDurationUs = 100000;
+const int kMixerFrames = 100;
+// The sizes of the calls that streams are processed in, which are smaller
+// and larger than the crossfade and wrap around the mixer's ring.
+const int kMixerCallFrameCounts[] = {7, 1, 64, 150, 33, 0, 99, 250};
+
+// Returns |frame_count| frames of a stream whose samples are |level| plus a
+// ramp, so that misplaced frames are detected.
+std::vector<float> CreateStream(int frame_count, float level) {
+  std::vector<float> samples(frame_count * kChannelCount);
+  for (int i = 0; i < frame_count; i++) {
+    for (int c = 0; c < kChannelCount; c++) {
+      samples[i * kChannelCount + c] = level + (i * kChannelCount + c) * 1e-5f;
+    }
+  }
+  return samples;
+}
+
+// Processes |input| through |mixer| in calls of kMixerCallFrameCounts frames,
+// as float samples, and appends the output to |output|. Checks that each
+// call's output starts the number of held back frames before its input.
+bool ProcessStream(CrossfadeMixer* mixer, const std::vector<float>& input,
+                   std::vector<float>* output, std::string* error) {
+  const int frame_size = kChannelCount * sizeof(float);
+  const int frame_count = input.size() / kChannelCount;
+  int input_frame = 0;
+  int output_frame = 0;
+  for (int i = 0; input_frame < frame_count; i++) {
+    const int call_frame_count =
+        std::min(kMixerCallFrameCounts[i % 8], frame_count - input_frame);
+    std::vector<uint8_t> data(call_frame_count * frame_size);
+    memcpy(data.data(), input.data() + input_frame * kChannelCount,
+           data.size());
+    const int held_frame_count = mixer->held_frame_count();
+    const int size =
+        mixer->Process(data.data(), data.size(), kChannelCount,
+                       kMixerSampleRate, kPcmEncodingFloat);
+    if (size < 0 || size % frame_size != 0) {
+      *error = "failed to process";
+      return false;
+    }
+    if (size > 0 && input_frame - held_frame_count != output_frame) {
+      *error = "output at frame " + std::to_string(output_frame) +
+               " was delayed by " + std::to_string(held_frame_count);
+      return false;
+    }
+    const float* samples = reinterpret_cast<const float*>(data.data());
+    output->insert(output->end(), samples, samples + size / sizeof(float));
+    input_frame += call_frame_count;
+    output_frame += size / frame_size;
+  }
+  return true;
+}
+
+// Drains |mixer| and appends the output to |output|.
+bool DrainStream(CrossfadeMixer* mixer, std::vector<float>* output,
+                 std::string* error) {
+  const int drain_size = mixer->GetDrainSize();
+  std::vector<uint8_t> data(drain_size + 64);
+  if (mixer->Drain(data.data(), data.size()) != drain_size ||
+      mixer->GetDrainSize() != 0) {
+    *error = "drained the wrong size";
+    return false;
+  }
+  const float* samples = reinterpret_cast<const float*>(data.data());
+  output->insert(output->end(), samples, samples + drain_size / sizeof(float));
+  return true;
+}
+
+// Checks that |actual| matches |expected| from frame |first_frame|, within
+// the rounding of the gains, and sets |error| to |name| and the first
+// mismatch if it doesn't.
+bool CheckFrames(const std::string& name, const std::vector<float>& actual,
+                 const std::vector<double>& expected, std::string* error) {
+  if (actual.size() != expected.size()) {
+    *error = name + ": output " + std::to_string(actual.size()) +
+             " samples, expected " + std::to_string(expected.size());
+    return false;
+  }
+  for (size_t i = 0; i < actual.size(); i++) {
+    if (std::fabs(actual[i] - expected[i]) > 1e-6) {
+      char message[128];
+      snprintf(message, sizeof(message),
+               ": sample %zu is %.7f, expected %.7f", i, actual[i],
+               expected[i]);
+      *error = name + message;
+      return false;
+    }
+  }
+  return true;
+}
+
+// Returns the linear crossfade from |outgoing| to |incoming| at |position| of
+// a crossfade of |duration| frames.
+double Crossfade(double outgoing, double incoming, int position,
+                 int duration) {
+  const double t = static_cast<double>(position) / duration;
+  return outgoing * (1 - t) + incoming * t;
+}
+
+bool TestDelay(std::string* error) {
+  CrossfadeMixer mixer;
+  mixer.Configure(kMixerDurationUs, kCrossfadeCurveLinear);
+  const std::vector<float> input = CreateStream(1000, 0.1f);
+  std::vector<float> output;
+  if (!ProcessStream(&mixer, input, &output, error) ||
+      mixer.held_frame_count() != kMixerFrames ||
+      !DrainStream(&mixer, &output, error)) {
+    return false;
+  }
+  // The output is the input, delayed without being changed.
+  return CheckFrames("delay", output,
+                     std::vector<double>(input.begin(), input.end()), error);
+}
+
+// Crossfades a stream of |first_frame_count| frames into one of
+// |second_frame_count| frames, and checks the output.
+bool CheckTransition(int first_frame_count, int second_frame_count,
+                     std::string* error) {
+  const std::string name = "transition " +
+                           std::to_string(first_frame_count) + " to " +
+                           std::to_string(second_frame_count);
+  CrossfadeMixer mixer;
+  mixer.Configure(kMixerDurationUs, kCrossfadeCurveLinear);
+  const std::vector<float> first = CreateStream(first_frame_count, 0.5f);
+  const std::vector<float> second = CreateStream(second_frame_count, -0.25f);
+  std::vector<float> output;
+  if (!ProcessStream(&mixer, first, &output, error)) {
+    return false;
+  }
+  mixer.EndStream();
+  if (mixer.held_frame_count() != 0 ||
+      !ProcessStream(&mixer, second, &output, error) ||
+      !DrainStream(&mixer, &output, error)) {
+    return false;
+  }
+  // The end of the first stream, which is as long as the crossfade or the
+  // whole stream, overlaps the start of the second, and fades out over
+  // silence if the second stream is shorter.
+  const int tail_frame_count = std::min(first_frame_count, kMixerFrames);
+  const int tail_start = first_frame_count - tail_frame_count;
+  std::vector<double> expected(first.begin(), first.begin() +
+                                                  tail_start * kChannelCount);
+  for (int i = 0; i < std::max(tail_frame_count, second_frame_count); i++) {
+    for (int c = 0; c < kChannelCount; c++) {
+      const double outgoing =
+          i < tail_frame_count ? first[(tail_start + i) * kChannelCount + c]
+                               : 0;
+      const double incoming =
+          i < second_frame_count ? second[i * kChannelCount + c] : 0;
+      expected.push_back(i < tail_frame_count
+                             ? Crossfade(outgoing, incoming, i,
+                                         tail_frame_count)
+                             : incoming);
+    }
+  }
+  return CheckFrames(name, output, expected, error);
+}
+
+bool TestTransitions(std::string* error) {
+  // Streams longer and shorter than the crossfade, in both orders.
+  return CheckTransition(450, 400, error) && CheckTransition(40, 400, error) &&
+         CheckTransition(450, 30, error) && CheckTransition(450, 100, error);
+}
+
+bool TestShortStreamBetweenStreams(std::string* error) {
+  // The end of the short middle stream includes the rest of the first
+  // stream's end, faded out, which is crossfaded into the third stream.
+  CrossfadeMixer mixer;
+  mixer.Configure(kMixerDurationUs, kCrossfadeCurveLinear);
+  const std::vector<float> first = CreateStream(300, 0.5f);
+  const std::vector<float> second = CreateStream(30, -0.25f);
+  const std::vector<float> third = CreateStream(300, 0.125f);
+  std::vector<float> output;
+  if (!ProcessStream(&mixer, first, &output, error)) {
+    return false;
+  }
+  mixer.EndStream();
+  if (!ProcessStream(&mixer, second, &output, error)) {
+    return false;
+  }
+  mixer.EndStream();
+  // A stream without output keeps the end of the stream before it.
+  mixer.EndStream();
+  if (!ProcessStream(&mixer, third, &output, error) ||
+      !DrainStream(&mixer, &output, error)) {
+    return false;
+  }
+  std::vector<double> expected(first.begin(),
+                               first.begin() + 200 * kChannelCount);
+  for (int i = 0; i < 300; i++) {
+    for (int c = 0; c < kChannelCount; c++) {
+      const int sample = i * kChannelCount + c;
+      double value = third[sample];
+      if (i < kMixerFrames) {
+        const double first_end = first[200 * kChannelCount + sample];
+        const double second_end =
+            i < 30 ? Crossfade(first_end, second[sample], i, kMixerFrames)
+                   : Crossfade(first_end, 0, i, kMixerFrames);
+        value = Crossfade(second_end, value, i, kMixerFrames);
+      }
+      expected.push_back(value);
+    }
+  }
+  return CheckFrames("short stream between streams", output, expected, error);
+}
+
+bool TestFormatChange(std::string* error) {
+  // The end of a stream isn't mixed into a stream of another sample rate.
+  CrossfadeMixer mixer;
+  mixer.Configure(kMixerDurationUs, kCrossfadeCurveLinear);
+  std::vector<uint8_t> data(400 * kChannelCount * sizeof(float));
+  if (mixer.Process(data.data(), data.size(), kChannelCount,
+                    kMixerSampleRate * 2, kPcmEncodingFloat) < 0) {
+    *error = "failed to process";
+    return false;
+  }
+  mixer.EndStream();
+  const std::vector<float> second = CreateStream(400, -0.25f);
+  std::vector<float> output;
+  if (!ProcessStream(&mixer, second, &output, error) ||
+      !DrainStream(&mixer, &output, error)) {
+    return false;
+  }
+  return CheckFrames("format change", output,
+                     std::vector<double>(second.begin(), second.end()), error);
+}
+
+bool TestFlush(std::string* error) {
+  // A flush discards the held back output and the previous stream's end.
+  CrossfadeMixer mixer;
+  mixer.Configure(kMixerDurationUs, kCrossfadeCurveLinear);
+  std::vector<float> output;
+  if (!ProcessStream(&mixer, CreateStream(300, 0.5f), &output, error)) {
+    return false;
+  }
+  mixer.EndStream();
+  if (!ProcessStream(&mixer, CreateStream(50, -0.25f), &output, error)) {
+    return false;
+  }
+  mixer.Flush();
+  output.clear();
+  const std::vector<float> input = CreateStream(300, 0.125f);
+  if (mixer.held_frame_count() != 0 || mixer.GetDrainSize() != 0 ||
+      !ProcessStream(&mixer, input, &output, error) ||
+      !DrainStream(&mixer, &output, error)) {
+    return false;
+  }
+  return CheckFrames("flush", output,
+                     std::vector<double>(input.begin(), input.end()), error);
+}
+
+bool TestMixerInvalidArguments(std::string* error) {
+  CrossfadeMixer mixer;
+  std::vector<uint8_t> data(kChannelCount * sizeof(float) + 1);
+  if (mixer.Configure(-1, kCrossfadeCurveLinear) ||
+      mixer.Configure(CrossfadeMixer::kMaxDurationUs + 1,
+                      kCrossfadeCurveLinear) ||
+      mixer.Configure(kMixerDurationUs, static_cast<CrossfadeCurve>(2)) ||
+      mixer.Process(data.data(), data.size(), kChannelCount,
+                    kMixerSampleRate, kPcmEncodingFloat) != -1 ||
+      mixer.Process(data.data(), 0, kChannelCount, 0, kPcmEncodingFloat) !=
+          -1) {
+    *error = "mixer accepted invalid arguments";
+    return false;
+  }
+  return true;
+}
+
+int Main(int argc, char** argv) {
+  if (argc != 1) {
+    fprintf(stderr, "Usage: %s\n", argv[0]);
+    return 2;
+  }
+  InitCpuDispatch();
+  std::string error;
+  if (!TestCrossfades(&error) || !TestFadeOut(&error) ||
+      !TestInvalidArguments(&error) || !TestDelay(&error) ||
+      !TestTransitions(&error) || !TestShortStreamBetweenStreams(&error) ||
+      !TestFormatChange(&error) || !TestFlush(&error) ||
+      !TestMixerInvalidArguments(&error)) {
+    fprintf(stderr, "FAILED: %s\n", error.c_str());
+    return 1;
+  }
+  printf("PASSED\n");
+  return 0;
+}
+
+}  // namespace
+}  // namespace exoplayer_jni
+
+int main(int argc, char** argv) { return exoplayer_jni::Main(argc, argv); }
@@ -0,0 +1,285 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks that SpscRing passes variable size records between threads in order
+// and intact across wraps, and that DecodeAheadThread outputs every queued
+// input in order, keeps the target amount of output decoded ahead, discards
+// input and output when flushed, drains at the end of the stream and fails
+// instead of deadlocking when its rings are full.
+//
+// Usage: decode_ahead_test
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "cpu_dispatch.h"  // NOLINT
+#include "decode_ahead.h"  // NOLINT
+#include "spsc_ring.h"     // NOLINT
+
+namespace exoplayer_jni {
+namespace {
+
+const int kRecordCount = 100000;
+const size_t kRingCapacity = 1024;
+const int kInputCount = 2000;
+const size_t kMaxOutputSize = 256;
+const size_t kAheadSize = 4096;
+const size_t kInputCapacity = 1024;
+// The input that the fake decoder fails to decode.
+const int32_t kErrorIndex = 1500;
+const int kErrorCode = -5;
+
+// Returns the size of record |index|, which varies so that records wrap at
+// different offsets.
+size_t GetRecordSize(int index) { return (index * 7) % 61; }
+
+// Returns the size of the output that the fake decoder produces for input
+// |index|.
+size_t GetOutputSize(int index) { return 16 * (index % 16 + 1); }
+
+// A decoder that outputs GetOutputSize(index) bytes of the low byte of each
+// input's index, and publishes the index as its first status value.
+int FakeDecode(const uint8_t* input, size_t input_size, uint8_t* output,
+               int64_t* status) {
+  int32_t index;
+  if (input_size != sizeof(index)) {
+    return -1;
+  }
+  memcpy(&index, input, sizeof(index));
+  status[0] = index;
+  if (index == kErrorIndex) {
+    return kErrorCode;
+  }
+  const size_t output_size = GetOutputSize(index);
+  memset(output, index & 0xFF, output_size);
+  if (index % 64 == 0) {
+    // Gives the consumer a chance to catch up.
+    std::this_thread::yield();
+  }
+  return static_cast<int>(output_size);
+}
+
+bool Queue(DecodeAheadThread* thread, int32_t index) {
+  return thread->Queue(/* time_us= */ index * 1000, /* flags= */ index & 1,
+                       reinterpret_cast<const uint8_t*>(&index),
+                       sizeof(index));
+}
+
+// Checks that |block| is the output of input |index|.
+bool CheckBlock(const DecodeAheadBlock& block, int32_t index,
+                std::string* error) {
+  const int expected_result =
+      index == kErrorIndex ? kErrorCode
+                           : static_cast<int>(GetOutputSize(index));
+  if (block.time_us != index * 1000 || block.flags != (index & 1) ||
+      block.status[0] != index || block.result != expected_result) {
+    *error = "block " + std::to_string(index) + " has the wrong header";
+    return false;
+  }
+  for (int i = 0; i < block.result; i++) {
+    if (block.data()[i] != (index & 0xFF)) {
+      *error = "block " + std::to_string(index) + " has the wrong output";
+      return false;
+    }
+  }
+  return true;
+}
+
+bool TestRing(std::string* error) {
+  SpscRing ring(kRingCapacity);
+  if (ring.BeginWrite(kRingCapacity) != nullptr) {
+    *error = "wrote a record that doesn't fit";
+    return false;
+  }
+  std::thread producer([&ring] {
+    for (int i = 0; i < kRecordCount; i++) {
+      const size_t size = GetRecordSize(i);
+      uint8_t* record;
+      while ((record = ring.BeginWrite(size + 8)) == nullptr) {
+        std::this_thread::yield();
+      }
+      memset(record, i & 0xFF, size);
+      ring.EndWrite(size);
+    }
+  });
+  bool passed = true;
+  for (int i = 0; i < kRecordCount && passed; i++) {
+    size_t size;
+    const uint8_t* record;
+    while ((record = ring.Peek(&size)) == nullptr) {
+      std::this_thread::yield();
+    }
+    if (size != GetRecordSize(i)) {
+      *error = "record " + std::to_string(i) + " has the wrong size";
+      passed = false;
+    }
+    for (size_t j = 0; j < size && passed; j++) {
+      if (record[j] != (i & 0xFF)) {
+        *error = "record " + std::to_string(i) + " is corrupt";
+        passed = false;
+      }
+    }
+    ring.Pop();
+  }
+  if (!passed) {
+    // Lets the producer finish.
+    ring.Clear();
+    while (true) {
+      size_t size;
+      if (ring.Peek(&size) != nullptr) {
+        ring.Pop();
+      } else if (ring.IsEmpty()) {
+        break;
+      }
+    }
+  }
+  producer.join();
+  if (passed && !ring.IsEmpty()) {
+    *error = "ring isn't empty after taking every record";
+    passed = false;
+  }
+  return passed;
+}
+
+bool TestDecodeAhead(std::string* error) {
+  DecodeAheadThread thread(FakeDecode, kMaxOutputSize, kAheadSize,
+                           kInputCapacity);
+  int32_t next_output = 0;
+  // Like the decoder, queues an input and takes at most one block per call.
+  for (int32_t index = 0; index < kInputCount; index++) {
+    if (!Queue(&thread, index)) {
+      *error = "failed to queue input " + std::to_string(index);
+      return false;
+    }
+    const size_t ready_size = thread.ready_size();
+    const DecodeAheadBlock* block = thread.Peek(/* drain= */ false);
+    if (block == nullptr) {
+      continue;
+    }
+    if (block->result >= 0 && ready_size < kAheadSize &&
+        thread.ready_size() < kAheadSize) {
+      *error = "took output before enough was decoded ahead";
+      return false;
+    }
+    if (!CheckBlock(*block, next_output++, error)) {
+      return false;
+    }
+    thread.Pop();
+  }
+  if (next_output == 0) {
+    *error = "no output was taken before the end of the stream";
+    return false;
+  }
+  // Drains the output at the end of the stream.
+  while (thread.WaitForOutput()) {
+    const DecodeAheadBlock* block = thread.Peek(/* drain= */ true);
+    if (!CheckBlock(*block, next_output++, error)) {
+      return false;
+    }
+    thread.Pop();
+  }
+  if (next_output != kInputCount) {
+    *error = "drained " + std::to_string(next_output) + " blocks";
+    return false;
+  }
+  return true;
+}
+
+bool TestFlush(std::string* error) {
+  DecodeAheadThread thread(FakeDecode, kMaxOutputSize, kAheadSize,
+                           kInputCapacity);
+  for (int32_t index = 0; index < 100; index++) {
+    Queue(&thread, index);
+  }
+  thread.Flush();
+  if (thread.ready_size() != 0 || thread.Peek(/* drain= */ true) != nullptr) {
+    *error = "output remains after flushing";
+    return false;
+  }
+  // Only input queued after the flush is decoded.
+  for (int32_t index = 200; index < 210; index++) {
+    Queue(&thread, index);
+  }
+  for (int32_t index = 200; index < 210; index++) {
+    if (!thread.WaitForOutput()) {
+      *error = "no output after flushing";
+      return false;
+    }
+    if (!CheckBlock(*thread.Peek(/* drain= */ true), index, error)) {
+      return false;
+    }
+    thread.Pop();
+  }
+  if (thread.WaitForOutput()) {
+    *error = "unexpected output after flushing";
+    return false;
+  }
+  return true;
+}
+
+bool TestFullRings(std::string* error) {
+  // Input is only queued, so the worker decodes past the target to make room
+  // for it until the output ring is full.
+  DecodeAheadThread thread(FakeDecode, kMaxOutputSize, /* ahead_size= */ 64,
+                           /* input_capacity= */ 64);
+  int32_t index = 0;
+  while (Queue(&thread, index)) {
+    if (++index == kInputCount) {
+      *error = "queued input without taking output";
+      return false;
+    }
+  }
+  // Taking output makes room for the input again.
+  bool queued = false;
+  int32_t output_count = 0;
+  while (thread.WaitForOutput()) {
+    if (!CheckBlock(*thread.Peek(/* drain= */ true), output_count++, error)) {
+      return false;
+    }
+    thread.Pop();
+    queued = queued || Queue(&thread, index);
+  }
+  if (!queued || output_count != index + 1) {
+    *error = "failed to queue input after taking output";
+    return false;
+  }
+  return true;
+}
+
+int Main(int argc, char** argv) {
+  if (argc != 1) {
+    fprintf(stderr, "Usage: %s\n", argv[0]);
+    return 2;
+  }
+  InitCpuDispatch();
+  std::string error;
+  if (!TestRing(&error) || !TestDecodeAhead(&error) || !TestFlush(&error) ||
+      !TestFullRings(&error)) {
+    fprintf(stderr, "FAILED: %s\n", error.c_str());
+    return 1;
+  }
+  printf("PASSED\n");
+  return 0;
+}
+
+}  // namespace
+}  // namespace exoplayer_jni
+
+int main(int argc, char** argv) { return exoplayer_jni::Main(argc, argv); }
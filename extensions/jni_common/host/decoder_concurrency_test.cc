@@ -0,0 +1,488 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Runs N simulated decoder instances at once, each on its own thread, for each
+// N from 1 to --max_instances, and checks that they don't interfere with each
+// other.
+//
+// Each instance owns the state that an extension keeps in its native context,
+// DecoderStats and output buffers, and processes frames through the same shared
+// native code as the extensions, with the kernels selected by
+// InitCpuDispatch(). Video instances alternate between copying 8-bit frames
+// and converting 10-bit frames to 8-bit, like the VP9 and AV1 extensions, and
+// audio instances interleave 16-bit stereo blocks, like the FLAC extension.
+// Every instance has its own input. The checksum of each output frame must
+// match the checksum computed by the instance before the threads are started,
+// dithered 10-bit conversions must be within the dither's bound of their
+// input, and each instance's statistics must match the frames it processed.
+// Any mismatch is reported, and fails the test.
+//
+// For each N, the aggregate throughput, per-frame latency percentiles across
+// all instances, and the scaling efficiency relative to a single instance are
+// reported.
+//
+// Usage: decoder_concurrency_test [--frames=F] [--max_instances=N]
+
+#include <algorithm>
+#include <cinttypes>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cpu_dispatch.h"   // NOLINT
+#include "decoder_stats.h"  // NOLINT
+#include "test_data.h"      // NOLINT
+
+namespace exoplayer_jni {
+namespace {
+
+// Frame size of the VP9 and AV1 test streams.
+const int kVideoWidth = 640;
+const int kVideoHeight = 360;
+// A FLAC block of 16-bit stereo samples.
+const unsigned kAudioSampleCount = 4096;
+const unsigned kAudioChannelCount = 2;
+const unsigned kAudioBytesPerSample = 2;
+// The number of distinct input frames of each instance, which are processed
+// in turn.
+const int kInputFrameCount = 4;
+
+enum Workload { kVideo, kAudio };
+
+const char* GetWorkloadName(Workload workload) {
+  return workload == kVideo ? "video" : "audio";
+}
+
+// The three planes of a 4:2:0 frame.
+struct Frame {
+  Plane planes[3];
+
+  Frame(int width, int height, int bytes_per_sample)
+      : planes{Plane(width, height, bytes_per_sample, /*stride_alignment=*/32),
+               Plane((width + 1) / 2, (height + 1) / 2, bytes_per_sample,
+                     /*stride_alignment=*/32),
+               Plane((width + 1) / 2, (height + 1) / 2, bytes_per_sample,
+                     /*stride_alignment=*/32)} {}
+
+  int64_t GetSampleCount() const {
+    int64_t sample_count = 0;
+    for (const Plane& plane : planes) {
+      sample_count += static_cast<int64_t>(plane.width) * plane.height;
+    }
+    return sample_count;
+  }
+
+  uint64_t Checksum() const {
+    uint64_t hash = kChecksumInit;
+    for (const Plane& plane : planes) {
+      hash ^= plane.Checksum(/*bytes_per_sample=*/1);
+      hash *= UINT64_C(0x100000001b3);
+    }
+    return hash;
+  }
+};
+
+// A simulated decoder instance.
+class Instance {
+ public:
+  Instance(Workload workload, int id) : workload_(workload), id_(id) {
+    Random random(static_cast<uint32_t>(id * 7919 + workload));
+    for (int i = 0; i < kInputFrameCount; i++) {
+      if (workload == kVideo) {
+        // Even frames are 8-bit and odd frames are 10-bit.
+        const int bytes_per_sample = i % 2 == 0 ? 1 : 2;
+        video_input_.emplace_back(
+            new Frame(kVideoWidth, kVideoHeight, bytes_per_sample));
+        for (Plane& plane : video_input_.back()->planes) {
+          for (int y = 0; y < plane.height; y++) {
+            uint8_t* row = plane.Row(y);
+            for (int x = 0; x < plane.width; x++) {
+              if (bytes_per_sample == 1) {
+                row[x] = static_cast<uint8_t>(random.Next());
+              } else {
+                reinterpret_cast<uint16_t*>(row)[x] =
+                    static_cast<uint16_t>(random.Next() & 0x3ff);
+              }
+            }
+          }
+        }
+      } else {
+        audio_input_.emplace_back(kAudioChannelCount);
+        for (std::vector<int32_t>& channel : audio_input_.back()) {
+          channel.resize(kAudioSampleCount);
+          for (int32_t& sample : channel) {
+            sample = static_cast<int16_t>(random.Next());
+          }
+        }
+      }
+    }
+    if (workload == kVideo) {
+      video_output_.reset(
+          new Frame(kVideoWidth, kVideoHeight, /*bytes_per_sample=*/1));
+    } else {
+      audio_output_.resize(kAudioSampleCount * kAudioChannelCount *
+                           kAudioBytesPerSample);
+    }
+    // Compute the expected checksums before any other instance is running.
+    for (int i = 0; i < kInputFrameCount; i++) {
+      expected_checksums_.push_back(ProcessInput(i));
+    }
+    stats_.Reset();
+  }
+
+  // Processes a frame, returning whether its output is as expected. If not,
+  // |error| is set to a description of the mismatch.
+  bool ProcessFrame(int frame_index, std::string* error) {
+    const int input_index = frame_index % kInputFrameCount;
+    const int64_t start_time_ns = GetMonotonicTimeNs();
+    uint64_t checksum;
+    {
+      ScopedLatencyTimer timer(&stats_, DecoderStats::kConvertTime);
+      stats_.Increment(DecoderStats::kInputBufferCount);
+      checksum = ProcessInput(input_index);
+      stats_.Increment(DecoderStats::kOutputBufferCount);
+      stats_.Increment(DecoderStats::kOutputByteCount,
+                       GetOutputByteCount(input_index));
+    }
+    frame_latencies_ns_.push_back(GetMonotonicTimeNs() - start_time_ns);
+    char message[256];
+    if (checksum != expected_checksums_[input_index]) {
+      snprintf(message, sizeof(message),
+               "%s instance %d frame %d: checksum %016" PRIx64
+               ", expected %016" PRIx64,
+               GetWorkloadName(workload_), id_, frame_index, checksum,
+               expected_checksums_[input_index]);
+      *error = message;
+      return false;
+    }
+    if (workload_ == kVideo && IsTenBitInput(input_index)) {
+      int plane_index;
+      int x;
+      int y;
+      if (!CheckConvertedFrame(input_index, &plane_index, &x, &y)) {
+        snprintf(message, sizeof(message),
+                 "%s instance %d frame %d: converted sample (%d, %d) of plane "
+                 "%d is outside the dither's bound",
+                 GetWorkloadName(workload_), id_, frame_index, x, y,
+                 plane_index);
+        *error = message;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Returns whether the instance's statistics match |frame_count| processed
+  // frames. If not, |error| is set to a description of the mismatch.
+  bool CheckStats(int frame_count, std::string* error) const {
+    std::vector<int64_t> snapshot(DecoderStats::kSnapshotLength);
+    stats_.Snapshot(snapshot.data());
+    int64_t expected_output_bytes = 0;
+    for (int i = 0; i < frame_count; i++) {
+      expected_output_bytes += GetOutputByteCount(i % kInputFrameCount);
+    }
+    int64_t latency_count = 0;
+    for (int i = 0; i < LatencyHistogram::kBucketCount; i++) {
+      latency_count +=
+          snapshot[DecoderStats::kCounterCount +
+                   DecoderStats::kConvertTime * LatencyHistogram::kBucketCount +
+                   i];
+    }
+    if (snapshot[DecoderStats::kInputBufferCount] != frame_count ||
+        snapshot[DecoderStats::kOutputBufferCount] != frame_count ||
+        snapshot[DecoderStats::kOutputByteCount] != expected_output_bytes ||
+        latency_count != frame_count) {
+      char message[256];
+      snprintf(message, sizeof(message),
+               "%s instance %d: stats recorded %" PRId64 " inputs, %" PRId64
+               " outputs, %" PRId64 " bytes and %" PRId64
+               " latencies for %d frames of %" PRId64 " bytes",
+               GetWorkloadName(workload_), id_,
+               snapshot[DecoderStats::kInputBufferCount],
+               snapshot[DecoderStats::kOutputBufferCount],
+               snapshot[DecoderStats::kOutputByteCount], latency_count,
+               frame_count, expected_output_bytes);
+      *error = message;
+      return false;
+    }
+    return true;
+  }
+
+  // Returns the number of bytes read and written when processing |frame_count|
+  // frames.
+  int64_t GetProcessedByteCount(int frame_count) const {
+    int64_t byte_count = 0;
+    for (int i = 0; i < frame_count; i++) {
+      const int input_index = i % kInputFrameCount;
+      if (workload_ == kAudio) {
+        // Each 32-bit input sample is written as kAudioBytesPerSample bytes.
+        byte_count += GetOutputByteCount(input_index) / kAudioBytesPerSample *
+                      (sizeof(int32_t) + kAudioBytesPerSample);
+      } else {
+        const int bytes_per_input_sample = IsTenBitInput(input_index) ? 2 : 1;
+        byte_count +=
+            GetOutputByteCount(input_index) * (1 + bytes_per_input_sample);
+      }
+    }
+    return byte_count;
+  }
+
+  const std::vector<int64_t>& frame_latencies_ns() const {
+    return frame_latencies_ns_;
+  }
+
+ private:
+  static bool IsTenBitInput(int input_index) { return input_index % 2 == 1; }
+
+  int64_t GetOutputByteCount(int input_index) const {
+    if (workload_ == kVideo) {
+      return video_input_[input_index]->GetSampleCount();
+    }
+    return kAudioSampleCount * kAudioChannelCount * kAudioBytesPerSample;
+  }
+
+  // Processes an input frame and returns the checksum of the output. The
+  // checksum of converted 10-bit frames doesn't cover the output, which is
+  // dithered, but CheckConvertedFrame() can be used to check it.
+  uint64_t ProcessInput(int input_index) {
+    if (workload_ == kAudio) {
+      const std::vector<std::vector<int32_t>>& input =
+          audio_input_[input_index];
+      const int32_t* source[kAudioChannelCount];
+      for (unsigned i = 0; i < kAudioChannelCount; i++) {
+        source[i] = input[i].data();
+      }
+      GetKernels().interleave_pcm(
+          reinterpret_cast<int8_t*>(audio_output_.data()), source,
+          kAudioBytesPerSample, kAudioSampleCount, kAudioChannelCount);
+      return Checksum(audio_output_.data(), audio_output_.size(),
+                      kChecksumInit);
+    }
+    const Frame& input = *video_input_[input_index];
+    for (int i = 0; i < 3; i++) {
+      const Plane& source = input.planes[i];
+      Plane& destination = video_output_->planes[i];
+      if (IsTenBitInput(input_index)) {
+        GetKernels().convert_10_to_8_plane(
+            source.data.data(), source.stride, destination.data.data(),
+            destination.stride, source.width, source.height);
+      } else {
+        CopyPlane(source.data.data(), source.stride, destination.data.data(),
+                  destination.stride, source.width, source.height);
+      }
+    }
+    return IsTenBitInput(input_index) ? kChecksumInit
+                                      : video_output_->Checksum();
+  }
+
+  // Returns whether each sample of the output converted from a 10-bit input
+  // frame is the input sample with its two low bits dropped, or the next level
+  // up. If not, the position of the first mismatch is returned.
+  bool CheckConvertedFrame(int input_index, int* plane_index, int* x,
+                           int* y) const {
+    const Frame& input = *video_input_[input_index];
+    for (int i = 0; i < 3; i++) {
+      const Plane& source = input.planes[i];
+      const Plane& destination = video_output_->planes[i];
+      for (int row = 0; row < source.height; row++) {
+        const uint16_t* source_row =
+            reinterpret_cast<const uint16_t*>(source.Row(row));
+        const uint8_t* destination_row = destination.Row(row);
+        for (int column = 0; column < source.width; column++) {
+          const int level = source_row[column] >> 2;
+          const int value = destination_row[column];
+          if (value != level && value != std::min(level + 1, 255)) {
+            *plane_index = i;
+            *x = column;
+            *y = row;
+            return false;
+          }
+        }
+      }
+    }
+    return true;
+  }
+
+  const Workload workload_;
+  const int id_;
+  std::vector<std::unique_ptr<Frame>> video_input_;
+  std::vector<std::vector<std::vector<int32_t>>> audio_input_;
+  std::unique_ptr<Frame> video_output_;
+  std::vector<uint8_t> audio_output_;
+  std::vector<uint64_t> expected_checksums_;
+  std::vector<int64_t> frame_latencies_ns_;
+  DecoderStats stats_;
+};
+
+// Releases all waiting threads at once, so that instances run concurrently
+// from their first frame.
+class StartGate {
+ public:
+  StartGate() : open_(false) {}
+
+  void Wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    condition_.wait(lock, [this] { return open_; });
+  }
+
+  void Open() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      open_ = true;
+    }
+    condition_.notify_all();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  bool open_;
+};
+
+struct RunResult {
+  double elapsed_seconds;
+  int64_t processed_bytes;
+  int64_t p50_latency_ns;
+  int64_t p99_latency_ns;
+  std::vector<std::string> errors;
+};
+
+// Runs |instance_count| instances of |workload| concurrently, each processing
+// |frame_count| frames.
+RunResult Run(Workload workload, int instance_count, int frame_count) {
+  std::vector<std::unique_ptr<Instance>> instances;
+  for (int i = 0; i < instance_count; i++) {
+    instances.emplace_back(new Instance(workload, i));
+  }
+  std::vector<std::string> errors(instance_count);
+  StartGate start_gate;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < instance_count; i++) {
+    threads.emplace_back([&, i] {
+      start_gate.Wait();
+      for (int frame = 0; frame < frame_count; frame++) {
+        // Keep processing after a mismatch, so that the statistics still
+        // match the number of frames.
+        std::string error;
+        if (!instances[i]->ProcessFrame(frame, &error) && errors[i].empty()) {
+          errors[i] = error;
+        }
+      }
+    });
+  }
+  const int64_t start_time_ns = GetMonotonicTimeNs();
+  start_gate.Open();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  RunResult result;
+  result.elapsed_seconds = (GetMonotonicTimeNs() - start_time_ns) / 1e9;
+  result.processed_bytes = 0;
+  std::vector<int64_t> latencies_ns;
+  for (int i = 0; i < instance_count; i++) {
+    const Instance& instance = *instances[i];
+    result.processed_bytes += instance.GetProcessedByteCount(frame_count);
+    latencies_ns.insert(latencies_ns.end(),
+                        instance.frame_latencies_ns().begin(),
+                        instance.frame_latencies_ns().end());
+    std::string stats_error;
+    if (!errors[i].empty()) {
+      result.errors.push_back(errors[i]);
+    }
+    if (!instance.CheckStats(frame_count, &stats_error)) {
+      result.errors.push_back(stats_error);
+    }
+  }
+  std::sort(latencies_ns.begin(), latencies_ns.end());
+  result.p50_latency_ns = latencies_ns[(latencies_ns.size() - 1) / 2];
+  result.p99_latency_ns = latencies_ns[(latencies_ns.size() - 1) * 99 / 100];
+  return result;
+}
+
+bool ParseIntFlag(const char* arg, const char* name, int* value) {
+  const size_t length = strlen(name);
+  if (strncmp(arg, name, length) != 0 || arg[length] != '=') {
+    return false;
+  }
+  *value = atoi(arg + length + 1);
+  return true;
+}
+
+int Main(int argc, char** argv) {
+  int frame_count = 120;
+  int max_instance_count = 16;
+  for (int i = 1; i < argc; i++) {
+    if (!ParseIntFlag(argv[i], "--frames", &frame_count) &&
+        !ParseIntFlag(argv[i], "--max_instances", &max_instance_count)) {
+      fprintf(stderr,
+              "Usage: %s [--frames=F] [--max_instances=N]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (frame_count < 1 || max_instance_count < 1) {
+    fprintf(stderr, "--frames and --max_instances must be positive\n");
+    return 2;
+  }
+  InitCpuDispatch();
+
+  printf("%u hardware threads, %d frames per instance\n",
+         std::thread::hardware_concurrency(), frame_count);
+  printf("%-8s %9s %10s %10s %10s %10s %10s\n", "workload", "instances",
+         "frames/s", "MB/s", "p50_us", "p99_us", "efficiency");
+  int failure_count = 0;
+  for (Workload workload : {kVideo, kAudio}) {
+    double single_instance_frame_rate = 0;
+    for (int instance_count = 1; instance_count <= max_instance_count;
+         instance_count++) {
+      const RunResult result = Run(workload, instance_count, frame_count);
+      const double frame_rate =
+          instance_count * frame_count / result.elapsed_seconds;
+      if (instance_count == 1) {
+        single_instance_frame_rate = frame_rate;
+      }
+      printf("%-8s %9d %10.0f %10.1f %10.1f %10.1f %10.2f\n",
+             GetWorkloadName(workload), instance_count, frame_rate,
+             result.processed_bytes / result.elapsed_seconds / 1e6,
+             result.p50_latency_ns / 1e3, result.p99_latency_ns / 1e3,
+             frame_rate / (instance_count * single_instance_frame_rate));
+      fflush(stdout);
+      for (const std::string& error : result.errors) {
+        fprintf(stderr, "FAILED: %s\n", error.c_str());
+        failure_count++;
+      }
+    }
+  }
+  if (failure_count > 0) {
+    fprintf(stderr,
+            "FAILED: %d instances interfered with each other or produced "
+            "unexpected output\n",
+            failure_count);
+    return 1;
+  }
+  printf("PASSED\n");
+  return 0;
+}
+
+}  // namespace
+}  // namespace exoplayer_jni
+
+int main(int argc, char** argv) { return exoplayer_jni::Main(argc, argv); }
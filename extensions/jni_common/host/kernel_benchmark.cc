@@ -0,0 +1,398 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Benchmarks the kernels on the extensions' per-frame hot paths, with one
+// decoded frame processed per iteration, across representative frame sizes,
+// strides, bit depths and channel counts. Throughput is reported as the bytes
+// read plus the bytes written per second, and each kernel has a memcpy
+// baseline that moves the same number of bytes. Set EXOPLAYER_PERF_COUNTERS=1
+// to report hardware performance counters per frame.
+
+#include "kernel_benchmark.h"  // NOLINT
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "audio_chain.h"    // NOLINT
+#include "cpu_dispatch.h"   // NOLINT
+#include "perf_counters.h"  // NOLINT
+
+namespace exoplayer_jni {
+
+void MemcpyBaseline(benchmark::State& state, int64_t size) {
+  std::vector<uint8_t> source(size, 1);
+  std::vector<uint8_t> destination(size);
+  const int64_t bytes_per_iteration = 2 * size;
+  {
+    ScopedBenchmarkPerfCounters perf_counters(&state, bytes_per_iteration);
+    for (auto _ : state) {
+      memcpy(destination.data(), source.data(), size);
+      benchmark::ClobberMemory();
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * bytes_per_iteration);
+}
+
+namespace {
+
+// The instruction sets that kernel implementations are written for.
+enum Isa {
+  kIsaC,
+  kIsaSse2,
+  kIsaSsse3,
+  kIsaAvx2,
+  kIsaNeon,
+};
+
+bool IsIsaSupported(Isa isa) {
+  InitCpuDispatch();
+  const CpuFeatures& features = GetCpuFeatures();
+  switch (isa) {
+    case kIsaSse2:
+      return features.sse2;
+    case kIsaSsse3:
+      return features.ssse3;
+    case kIsaAvx2:
+      return features.avx2;
+    case kIsaNeon:
+      return features.neon;
+    default:
+      return true;
+  }
+}
+
+// The frame sizes that the video benchmarks are run with.
+const int kFrameSizes[][2] = {
+    {640, 360}, {1280, 720}, {1920, 1080}, {3840, 2160}};
+
+// Adds frame size and stride arguments for the video benchmarks. Strides are
+// either packed, or padded as decoders commonly do.
+void FrameArguments(benchmark::internal::Benchmark* benchmark) {
+  for (const auto& size : kFrameSizes) {
+    for (int stride_padding : {0, 64}) {
+      benchmark->Args({size[0], size[1], stride_padding});
+    }
+  }
+  benchmark->ArgNames({"width", "height", "stride_padding"});
+}
+
+// Adds frame size arguments for the memcpy baselines.
+void FrameSizeArguments(benchmark::internal::Benchmark* benchmark) {
+  for (const auto& size : kFrameSizes) {
+    benchmark->Args({size[0], size[1]});
+  }
+  benchmark->ArgNames({"width", "height"});
+}
+
+// Adds bit depth and channel count arguments for the audio benchmarks.
+void PcmBlockArguments(benchmark::internal::Benchmark* benchmark) {
+  for (int bytes_per_sample : {1, 2, 3, 4}) {
+    for (int channel_count : {1, 2, 6, 8}) {
+      benchmark->Args({bytes_per_sample, channel_count});
+    }
+  }
+  benchmark->ArgNames({"bytes_per_sample", "channels"});
+}
+
+// Returns the number of samples in a 4:2:0 frame.
+int64_t GetFrameSampleCount(int width, int height) {
+  const int64_t uv_sample_count =
+      static_cast<int64_t>((width + 1) / 2) * ((height + 1) / 2);
+  return static_cast<int64_t>(width) * height + 2 * uv_sample_count;
+}
+
+// A 4:2:0 frame with planes of |bytes_per_sample| bytes per sample, with
+// |stride_padding| bytes at the end of each row.
+class Frame {
+ public:
+  Frame(int width, int height, int bytes_per_sample, int stride_padding) {
+    const int uv_width = (width + 1) / 2;
+    const int uv_height = (height + 1) / 2;
+    widths_[0] = width;
+    heights_[0] = height;
+    widths_[1] = widths_[2] = uv_width;
+    heights_[1] = heights_[2] = uv_height;
+    for (int i = 0; i < kPlaneCount; i++) {
+      strides_[i] = widths_[i] * bytes_per_sample + stride_padding;
+      planes_[i].resize(static_cast<size_t>(strides_[i]) * heights_[i]);
+      for (size_t j = 0; j < planes_[i].size(); j++) {
+        // Keep 16-bit samples within 10 bits.
+        planes_[i][j] = static_cast<uint8_t>(j % 2 == 1 ? j % 4 : j);
+      }
+    }
+  }
+
+  static constexpr int kPlaneCount = 3;
+
+  uint8_t* Plane(int index) { return planes_[index].data(); }
+  int Stride(int index) const { return strides_[index]; }
+  int Width(int index) const { return widths_[index]; }
+  int Height(int index) const { return heights_[index]; }
+
+ private:
+  std::vector<uint8_t> planes_[kPlaneCount];
+  int strides_[kPlaneCount];
+  int widths_[kPlaneCount];
+  int heights_[kPlaneCount];
+};
+
+constexpr int Frame::kPlaneCount;
+
+// Converts a 10-bit frame to 8 bits, as done by vpxGetFrame and gav1GetFrame
+// (Convert10BitFrameTo8BitDataBuffer).
+void BM_Convert10To8Frame(benchmark::State& state,
+                          Convert10To8PlaneFunction convert, Isa isa) {
+  if (!IsIsaSupported(isa)) {
+    state.SkipWithError("Not supported by the CPU");
+    return;
+  }
+  const int width = static_cast<int>(state.range(0));
+  const int height = static_cast<int>(state.range(1));
+  const int stride_padding = static_cast<int>(state.range(2));
+  Frame source(width, height, /*bytes_per_sample=*/2, stride_padding);
+  Frame destination(width, height, /*bytes_per_sample=*/1, stride_padding);
+  // Two bytes are read and one is written per sample.
+  const int64_t bytes_per_frame = 3 * GetFrameSampleCount(width, height);
+  {
+    ScopedBenchmarkPerfCounters perf_counters(&state, bytes_per_frame);
+    for (auto _ : state) {
+      for (int i = 0; i < Frame::kPlaneCount; i++) {
+        convert(source.Plane(i), source.Stride(i), destination.Plane(i),
+                destination.Stride(i), source.Width(i), source.Height(i));
+      }
+      benchmark::ClobberMemory();
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * bytes_per_frame);
+}
+BENCHMARK_CAPTURE(BM_Convert10To8Frame, C, Convert10To8PlaneC, kIsaC)
+    ->Apply(FrameArguments);
+#if defined(__i386__) || defined(__x86_64__)
+BENCHMARK_CAPTURE(BM_Convert10To8Frame, Sse2, Convert10To8PlaneSse2, kIsaSse2)
+    ->Apply(FrameArguments);
+BENCHMARK_CAPTURE(BM_Convert10To8Frame, Avx2, Convert10To8PlaneAvx2, kIsaAvx2)
+    ->Apply(FrameArguments);
+#endif  // defined(__i386__) || defined(__x86_64__)
+#if defined(__arm__) || defined(__aarch64__)
+BENCHMARK_CAPTURE(BM_Convert10To8Frame, Neon, Convert10To8PlaneNeon, kIsaNeon)
+    ->Apply(FrameArguments);
+#endif  // defined(__arm__) || defined(__aarch64__)
+
+// Moves the same number of bytes as BM_Convert10To8Frame.
+void BM_Convert10To8FrameMemcpyBaseline(benchmark::State& state) {
+  const int width = static_cast<int>(state.range(0));
+  const int height = static_cast<int>(state.range(1));
+  MemcpyBaseline(state, 3 * GetFrameSampleCount(width, height) / 2);
+}
+BENCHMARK(BM_Convert10To8FrameMemcpyBaseline)->Apply(FrameSizeArguments);
+
+// Copies an 8-bit frame into a window buffer row by row, as done by
+// gav1RenderFrame and vpxRenderFrame.
+void BM_CopyFrame(benchmark::State& state) {
+  const int width = static_cast<int>(state.range(0));
+  const int height = static_cast<int>(state.range(1));
+  const int stride_padding = static_cast<int>(state.range(2));
+  Frame source(width, height, /*bytes_per_sample=*/1, stride_padding);
+  // Window buffer strides are aligned independently of the decoder's.
+  Frame destination(width, height, /*bytes_per_sample=*/1,
+                    /*stride_padding=*/0);
+  const int64_t bytes_per_frame = 2 * GetFrameSampleCount(width, height);
+  {
+    ScopedBenchmarkPerfCounters perf_counters(&state, bytes_per_frame);
+    for (auto _ : state) {
+      for (int i = 0; i < Frame::kPlaneCount; i++) {
+        CopyPlane(source.Plane(i), source.Stride(i), destination.Plane(i),
+                  destination.Stride(i), source.Width(i), source.Height(i));
+      }
+      benchmark::ClobberMemory();
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * bytes_per_frame);
+}
+BENCHMARK(BM_CopyFrame)->Apply(FrameArguments);
+
+// Copies whole 8-bit planes including their padding, as done by gav1GetFrame
+// (CopyFrameToDataBuffer).
+void BM_CopyFrameToDataBuffer(benchmark::State& state) {
+  const int width = static_cast<int>(state.range(0));
+  const int height = static_cast<int>(state.range(1));
+  const int stride_padding = static_cast<int>(state.range(2));
+  Frame source(width, height, /*bytes_per_sample=*/1, stride_padding);
+  std::vector<uint8_t> destination;
+  int64_t bytes_per_frame = 0;
+  for (int i = 0; i < Frame::kPlaneCount; i++) {
+    bytes_per_frame += 2 * static_cast<int64_t>(source.Stride(i)) *
+                       source.Height(i);
+  }
+  destination.resize(bytes_per_frame / 2);
+  {
+    ScopedBenchmarkPerfCounters perf_counters(&state, bytes_per_frame);
+    for (auto _ : state) {
+      uint8_t* data = destination.data();
+      for (int i = 0; i < Frame::kPlaneCount; i++) {
+        const size_t length =
+            static_cast<size_t>(source.Stride(i)) * source.Height(i);
+        memcpy(data, source.Plane(i), length);
+        data += length;
+      }
+      benchmark::ClobberMemory();
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * bytes_per_frame);
+}
+BENCHMARK(BM_CopyFrameToDataBuffer)->Apply(FrameArguments);
+
+// Moves the same number of bytes as BM_CopyFrame.
+void BM_CopyFrameMemcpyBaseline(benchmark::State& state) {
+  const int width = static_cast<int>(state.range(0));
+  const int height = static_cast<int>(state.range(1));
+  MemcpyBaseline(state, GetFrameSampleCount(width, height));
+}
+BENCHMARK(BM_CopyFrameMemcpyBaseline)->Apply(FrameSizeArguments);
+
+// The block size used by most FLAC encoders.
+const unsigned kPcmBlockSampleCount = 4096;
+
+// Interleaves a block of decoded PCM, as done by FLACParser::readBuffer.
+void BM_InterleavePcmBlock(benchmark::State& state,
+                           InterleavePcmFunction interleave, Isa isa) {
+  if (!IsIsaSupported(isa)) {
+    state.SkipWithError("Not supported by the CPU");
+    return;
+  }
+  const unsigned bytes_per_sample = static_cast<unsigned>(state.range(0));
+  const unsigned channel_count = static_cast<unsigned>(state.range(1));
+  const int64_t max_sample = (INT64_C(1) << (bytes_per_sample * 8 - 1)) - 1;
+  std::vector<std::vector<int32_t>> channels(channel_count);
+  std::vector<const int32_t*> source(channel_count);
+  for (unsigned i = 0; i < channel_count; i++) {
+    channels[i].resize(kPcmBlockSampleCount);
+    for (unsigned j = 0; j < kPcmBlockSampleCount; j++) {
+      channels[i][j] = static_cast<int32_t>((j * 7919 + i) % max_sample);
+    }
+    source[i] = channels[i].data();
+  }
+  std::vector<int8_t> destination(kPcmBlockSampleCount * channel_count *
+                                  bytes_per_sample);
+  const int64_t bytes_per_block =
+      kPcmBlockSampleCount * channel_count * sizeof(int32_t) +
+      destination.size();
+  {
+    ScopedBenchmarkPerfCounters perf_counters(&state, bytes_per_block);
+    for (auto _ : state) {
+      interleave(destination.data(), source.data(), bytes_per_sample,
+                 kPcmBlockSampleCount, channel_count);
+      benchmark::ClobberMemory();
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * bytes_per_block);
+}
+BENCHMARK_CAPTURE(BM_InterleavePcmBlock, C, InterleavePcmC, kIsaC)
+    ->Apply(PcmBlockArguments);
+#if defined(__i386__) || defined(__x86_64__)
+BENCHMARK_CAPTURE(BM_InterleavePcmBlock, Sse2, InterleavePcmSse2, kIsaSse2)
+    ->Apply(PcmBlockArguments);
+BENCHMARK_CAPTURE(BM_InterleavePcmBlock, Ssse3, InterleavePcmSsse3, kIsaSsse3)
+    ->Apply(PcmBlockArguments);
+#endif  // defined(__i386__) || defined(__x86_64__)
+#if defined(__arm__) || defined(__aarch64__)
+BENCHMARK_CAPTURE(BM_InterleavePcmBlock, Neon, InterleavePcmNeon, kIsaNeon)
+    ->Apply(PcmBlockArguments);
+#endif  // defined(__arm__) || defined(__aarch64__)
+// Used on big endian devices. Benchmarked on little endian hosts too, since the
+// cost doesn't depend on the host's byte order.
+BENCHMARK_CAPTURE(BM_InterleavePcmBlock, BigEndian, InterleavePcmBigEndian,
+                  kIsaC)
+    ->Apply(PcmBlockArguments);
+
+// Moves the same number of bytes as BM_InterleavePcmBlock.
+void BM_InterleavePcmBlockMemcpyBaseline(benchmark::State& state) {
+  const int64_t bytes_per_sample = state.range(0);
+  const int64_t channel_count = state.range(1);
+  // Each 4-byte source sample is read and |bytes_per_sample| bytes are
+  // written.
+  MemcpyBaseline(state, kPcmBlockSampleCount * channel_count *
+                            (sizeof(int32_t) + bytes_per_sample) / 2);
+}
+BENCHMARK(BM_InterleavePcmBlockMemcpyBaseline)->Apply(PcmBlockArguments);
+
+// The number of frames in an AAC frame at 44.1 kHz, or in 20 ms of Opus.
+const int kAudioChainFrameCount = 1024;
+
+// Adds channel count, output encoding and output sample rate arguments for
+// 16-bit input at 48 kHz. An output sample rate of 0 keeps the input rate.
+void AudioChainArguments(benchmark::internal::Benchmark* benchmark) {
+  for (int channel_count : {2, 6, 8}) {
+    for (int encoding : {kPcmEncoding16Bit, kPcmEncodingFloat}) {
+      for (int sample_rate : {0, 44100}) {
+        benchmark->Args({channel_count, encoding, sample_rate});
+      }
+    }
+  }
+  benchmark->ArgNames({"channels", "encoding", "sample_rate"});
+}
+
+// Processes a decoded frame through an AudioChain that swaps the first two
+// channels and applies a gain, as a decoder does before returning its output.
+void BM_AudioChain(benchmark::State& state) {
+  InitCpuDispatch();
+  const int channel_count = static_cast<int>(state.range(0));
+  AudioChainConfig config;
+  config.channel_count = channel_count;
+  for (int c = 0; c < channel_count; c++) {
+    config.channel_map[c] = c < 2 ? 1 - c : c;
+  }
+  config.gain = 0.5f;
+  config.encoding = static_cast<PcmEncoding>(state.range(1));
+  config.sample_rate = static_cast<int>(state.range(2));
+  AudioChain chain;
+  chain.SetConfig(config);
+  chain.Configure(channel_count, 48000, kPcmEncoding16Bit);
+  std::vector<int16_t> input(kAudioChainFrameCount * channel_count);
+  for (size_t i = 0; i < input.size(); i++) {
+    input[i] = static_cast<int16_t>(i * 7919);
+  }
+  std::vector<uint8_t> output(chain.GetMaxOutputSize(kAudioChainFrameCount));
+  int64_t bytes_per_frame = 0;
+  {
+    ScopedBenchmarkPerfCounters perf_counters(&state,
+                                              input.size() * sizeof(int16_t));
+    for (auto _ : state) {
+      bytes_per_frame = chain.Process(input.data(), kAudioChainFrameCount,
+                                      output.data(), output.size());
+      benchmark::ClobberMemory();
+    }
+  }
+  bytes_per_frame += input.size() * sizeof(int16_t);
+  state.SetBytesProcessed(state.iterations() * bytes_per_frame);
+}
+BENCHMARK(BM_AudioChain)->Apply(AudioChainArguments);
+
+// Moves the same number of bytes as BM_AudioChain without resampling.
+void BM_AudioChainMemcpyBaseline(benchmark::State& state) {
+  const int64_t channel_count = state.range(0);
+  const int64_t bytes_per_sample =
+      state.range(1) == kPcmEncodingFloat ? sizeof(float) : sizeof(int16_t);
+  MemcpyBaseline(state, kAudioChainFrameCount * channel_count *
+                            (sizeof(int16_t) + bytes_per_sample) / 2);
+}
+BENCHMARK(BM_AudioChainMemcpyBaseline)->Apply(AudioChainArguments);
+
+}  // namespace
+}  // namespace exoplayer_jni
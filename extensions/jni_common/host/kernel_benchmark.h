@@ -0,0 +1,32 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_HOST_KERNEL_BENCHMARK_H_
+#define EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_HOST_KERNEL_BENCHMARK_H_
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+
+namespace exoplayer_jni {
+
+// Copies |size| bytes per iteration with memcpy, as a baseline for the kernels
+// that read and write a total of 2 * |size| bytes per iteration.
+void MemcpyBaseline(benchmark::State& state, int64_t size);
+
+}  // namespace exoplayer_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_HOST_KERNEL_BENCHMARK_H_
@@ -0,0 +1,877 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks the output of every kernel implementation against golden checksums,
+// so that new fast paths can be validated before they're used by the
+// extensions.
+//
+// Each kernel is run over deterministic input in the formats and sizes of the
+// test streams. Checksums cover the exact bytes written to the output, not
+// including padding. Implementations that are expected to be bit exact must
+// match the golden checksum of the portable implementation. The SSE2 and AVX2
+// 10-bit to 8-bit conversions carry the remainder of each sample over to the
+// next as the portable implementation does, so their output must match its
+// output exactly, including for narrow planes that only exercise their tail
+// handling. The NEON conversion uses a random dither, so its output must
+// instead have a PSNR of at least kMinDitheredPsnrDb relative to the portable
+// output. The SIMD dot products sum in the same order as the portable
+// implementation, but may fuse multiply-adds, so they're compared to it with a
+// relative tolerance of kMaxDotProductError. Peak searches are exact, so every
+// implementation must return the portable implementation's result. Sample
+// summaries must match the portable minimum and maximum exactly, and its sum of
+// squares with the dot product tolerance. FFT stages are compared to the
+// portable stage with a tolerance of kMaxFftStageError relative to the largest
+// output magnitude, since fused multiply-adds round differently. Dithered
+// 16-bit downconversions use a deterministic dither, so they must be bit exact,
+// and without noise shaping each output must be within one level of the rounded
+// input.
+//
+// Usage: kernel_golden_test [--update] GOLDEN_FILE
+//
+// With --update, the golden checksums are rewritten instead of checked.
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "cpu_dispatch.h"  // NOLINT
+#include "test_data.h"   // NOLINT
+
+namespace exoplayer_jni {
+namespace {
+
+// The minimum PSNR of dithered output relative to the portable implementation.
+// Dithering changes each sample by at most one level, which on its own gives a
+// PSNR of at least 48 dB.
+const double kMinDitheredPsnrDb = 45;
+
+// The maximum difference between the SIMD and portable dot products, relative
+// to the sum of the magnitudes of the products.
+const double kMaxDotProductError = 1e-6;
+
+// The maximum difference between the SIMD and portable FFT stage outputs,
+// relative to the largest output magnitude.
+const double kMaxFftStageError = 1e-6;
+
+const double kPi = 3.14159265358979323846;
+
+// Frame sizes of the VP9 and AV1 test streams, and an odd size to exercise the
+// kernels' tail handling.
+const int kFrameSizes[][2] = {{640, 360}, {641, 361}, {1280, 720}};
+
+// Bit depths and channel counts of the FLAC test streams, and more.
+const unsigned kBytesPerSample[] = {1, 2, 3, 4};
+const unsigned kChannelCounts[] = {1, 2, 6, 8};
+// A full FLAC block, and a block with an odd length to exercise the kernels'
+// tail handling.
+const unsigned kSampleCounts[] = {4096, 4093};
+
+// Returns a plane of 10-bit samples with gradients and noise, so that the
+// conversion's rounding and dither are exercised.
+Plane Make10BitPlane(int width, int height) {
+  // Decoders commonly align strides to 32 bytes.
+  Plane plane(width, height, /*bytes_per_sample=*/2, /*stride_alignment=*/32);
+  Random random(width * 31 + height);
+  for (int y = 0; y < height; y++) {
+    uint16_t* row = reinterpret_cast<uint16_t*>(plane.Row(y));
+    for (int x = 0; x < width; x++) {
+      row[x] = static_cast<uint16_t>((x * 3 + y * 2 + random.Next() % 16) &
+                                     0x3ff);
+    }
+  }
+  return plane;
+}
+
+// Returns a plane of 8-bit samples.
+Plane Make8BitPlane(int width, int height) {
+  Plane plane(width, height, /*bytes_per_sample=*/1, /*stride_alignment=*/32);
+  Random random(width * 17 + height);
+  for (int y = 0; y < height; y++) {
+    uint8_t* row = plane.Row(y);
+    for (int x = 0; x < width; x++) {
+      row[x] = static_cast<uint8_t>(random.Next());
+    }
+  }
+  return plane;
+}
+
+double Psnr(const Plane& a, const Plane& b) {
+  double squared_error = 0;
+  for (int y = 0; y < a.height; y++) {
+    for (int x = 0; x < a.width; x++) {
+      const double difference = a.Row(y)[x] - b.Row(y)[x];
+      squared_error += difference * difference;
+    }
+  }
+  if (squared_error == 0) {
+    return INFINITY;
+  }
+  const double mean_squared_error =
+      squared_error / (static_cast<double>(a.width) * a.height);
+  return 10 * log10(255.0 * 255.0 / mean_squared_error);
+}
+
+// A kernel implementation, and whether it's supported by the CPU.
+template <typename Function>
+struct Implementation {
+  const char* name;
+  Function function;
+  bool supported;
+};
+
+// The 10-bit to 8-bit conversions that are bit exact with Convert10To8PlaneC.
+std::vector<Implementation<Convert10To8PlaneFunction>>
+GetConvert10To8Implementations() {
+  const CpuFeatures& features = GetCpuFeatures();
+  (void)features;
+  std::vector<Implementation<Convert10To8PlaneFunction>> implementations;
+#if defined(__i386__) || defined(__x86_64__)
+  implementations.push_back({"Sse2", Convert10To8PlaneSse2, features.sse2});
+  implementations.push_back({"Avx2", Convert10To8PlaneAvx2, features.avx2});
+#endif  // defined(__i386__) || defined(__x86_64__)
+  return implementations;
+}
+
+// The 10-bit to 8-bit conversions that use a random dither.
+std::vector<Implementation<Convert10To8PlaneFunction>>
+GetDitheredConvert10To8Implementations() {
+  const CpuFeatures& features = GetCpuFeatures();
+  (void)features;
+  std::vector<Implementation<Convert10To8PlaneFunction>> implementations;
+#if defined(__arm__) || defined(__aarch64__)
+  implementations.push_back({"Neon", Convert10To8PlaneNeon, features.neon});
+#endif  // defined(__arm__) || defined(__aarch64__)
+  return implementations;
+}
+
+std::vector<Implementation<InterleavePcmFunction>>
+GetInterleavePcmImplementations() {
+  const CpuFeatures& features = GetCpuFeatures();
+  (void)features;
+  std::vector<Implementation<InterleavePcmFunction>> implementations;
+#if defined(__i386__) || defined(__x86_64__)
+  implementations.push_back({"Sse2", InterleavePcmSse2, features.sse2});
+  implementations.push_back({"Ssse3", InterleavePcmSsse3, features.ssse3});
+#endif  // defined(__i386__) || defined(__x86_64__)
+#if defined(__arm__) || defined(__aarch64__)
+  implementations.push_back({"Neon", InterleavePcmNeon, features.neon});
+#endif  // defined(__arm__) || defined(__aarch64__)
+  return implementations;
+}
+
+std::vector<Implementation<ConvertPcm16ToFloatFunction>>
+GetConvertPcm16ToFloatImplementations() {
+  const CpuFeatures& features = GetCpuFeatures();
+  (void)features;
+  std::vector<Implementation<ConvertPcm16ToFloatFunction>> implementations;
+#if defined(__i386__) || defined(__x86_64__)
+  implementations.push_back({"Sse2", ConvertPcm16ToFloatSse2, features.sse2});
+#endif  // defined(__i386__) || defined(__x86_64__)
+#if defined(__arm__) || defined(__aarch64__)
+  implementations.push_back({"Neon", ConvertPcm16ToFloatNeon, features.neon});
+#endif  // defined(__arm__) || defined(__aarch64__)
+  return implementations;
+}
+
+std::vector<Implementation<ConvertFloatToPcm16Function>>
+GetConvertFloatToPcm16Implementations() {
+  const CpuFeatures& features = GetCpuFeatures();
+  (void)features;
+  std::vector<Implementation<ConvertFloatToPcm16Function>> implementations;
+#if defined(__i386__) || defined(__x86_64__)
+  implementations.push_back({"Sse2", ConvertFloatToPcm16Sse2, features.sse2});
+#endif  // defined(__i386__) || defined(__x86_64__)
+#if defined(__arm__) || defined(__aarch64__)
+  implementations.push_back({"Neon", ConvertFloatToPcm16Neon, features.neon});
+#endif  // defined(__arm__) || defined(__aarch64__)
+  return implementations;
+}
+
+std::vector<Implementation<DotProductFunction>>
+GetDotProductImplementations() {
+  const CpuFeatures& features = GetCpuFeatures();
+  (void)features;
+  std::vector<Implementation<DotProductFunction>> implementations;
+#if defined(__i386__) || defined(__x86_64__)
+  implementations.push_back({"Sse2", DotProductSse2, features.sse2});
+#endif  // defined(__i386__) || defined(__x86_64__)
+#if defined(__arm__) || defined(__aarch64__)
+  implementations.push_back({"Neon", DotProductNeon, features.neon});
+#endif  // defined(__arm__) || defined(__aarch64__)
+  return implementations;
+}
+
+std::vector<Implementation<FindPeakFunction>> GetFindPeakImplementations() {
+  const CpuFeatures& features = GetCpuFeatures();
+  (void)features;
+  std::vector<Implementation<FindPeakFunction>> implementations;
+#if defined(__i386__) || defined(__x86_64__)
+  implementations.push_back({"Sse2", FindPeakSse2, features.sse2});
+#endif  // defined(__i386__) || defined(__x86_64__)
+#if defined(__arm__) || defined(__aarch64__)
+  implementations.push_back({"Neon", FindPeakNeon, features.neon});
+#endif  // defined(__arm__) || defined(__aarch64__)
+  return implementations;
+}
+
+std::vector<Implementation<SummarizeSamplesFunction>>
+GetSummarizeSamplesImplementations() {
+  const CpuFeatures& features = GetCpuFeatures();
+  (void)features;
+  std::vector<Implementation<SummarizeSamplesFunction>> implementations;
+#if defined(__i386__) || defined(__x86_64__)
+  implementations.push_back({"Sse2", SummarizeSamplesSse2, features.sse2});
+#endif  // defined(__i386__) || defined(__x86_64__)
+#if defined(__arm__) || defined(__aarch64__)
+  implementations.push_back({"Neon", SummarizeSamplesNeon, features.neon});
+#endif  // defined(__arm__) || defined(__aarch64__)
+  return implementations;
+}
+
+std::vector<Implementation<FftStageFunction>> GetFftStageImplementations() {
+  const CpuFeatures& features = GetCpuFeatures();
+  (void)features;
+  std::vector<Implementation<FftStageFunction>> implementations;
+#if defined(__i386__) || defined(__x86_64__)
+  implementations.push_back({"Sse2", FftStageSse2, features.sse2});
+#endif  // defined(__i386__) || defined(__x86_64__)
+#if defined(__arm__) || defined(__aarch64__)
+  implementations.push_back({"Neon", FftStageNeon, features.neon});
+#endif  // defined(__arm__) || defined(__aarch64__)
+  return implementations;
+}
+
+std::vector<Implementation<DitherPcm16Function>>
+GetDitherPcm16Implementations() {
+  const CpuFeatures& features = GetCpuFeatures();
+  (void)features;
+  std::vector<Implementation<DitherPcm16Function>> implementations;
+#if defined(__i386__) || defined(__x86_64__)
+  implementations.push_back({"Sse2", DitherPcm16Sse2, features.sse2});
+#endif  // defined(__i386__) || defined(__x86_64__)
+#if defined(__arm__) || defined(__aarch64__)
+  implementations.push_back({"Neon", DitherPcm16Neon, features.neon});
+#endif  // defined(__arm__) || defined(__aarch64__)
+  return implementations;
+}
+
+class GoldenChecker {
+ public:
+  GoldenChecker(std::map<std::string, uint64_t>* goldens, bool update)
+      : goldens_(goldens), update_(update), failure_count_(0) {}
+
+  int failure_count() const { return failure_count_; }
+
+  // Checks |checksum| against the golden checksum for |name|, or records it
+  // when updating.
+  void CheckGolden(const std::string& name, uint64_t checksum) {
+    if (update_) {
+      (*goldens_)[name] = checksum;
+      return;
+    }
+    std::map<std::string, uint64_t>::const_iterator golden =
+        goldens_->find(name);
+    if (golden == goldens_->end()) {
+      Fail(name, "no golden checksum, run with --update to add it");
+    } else if (golden->second != checksum) {
+      char message[128];
+      snprintf(message, sizeof(message),
+               "checksum %016" PRIx64 " doesn't match golden %016" PRIx64,
+               checksum, golden->second);
+      Fail(name, message);
+    }
+  }
+
+  void CheckPsnr(const std::string& name, double psnr) {
+    if (psnr < kMinDitheredPsnrDb) {
+      char message[128];
+      snprintf(message, sizeof(message), "PSNR %.2f dB is less than %.2f dB",
+               psnr, kMinDitheredPsnrDb);
+      Fail(name, message);
+    }
+  }
+
+  void Fail(const std::string& name, const char* message) {
+    fprintf(stderr, "FAILED %s: %s\n", name.c_str(), message);
+    failure_count_++;
+  }
+
+ private:
+  std::map<std::string, uint64_t>* const goldens_;
+  const bool update_;
+  int failure_count_;
+};
+
+void CheckVideoKernels(GoldenChecker* checker) {
+  for (const auto& size : kFrameSizes) {
+    const int width = size[0];
+    const int height = size[1];
+    std::ostringstream suffix;
+    suffix << "/" << width << "x" << height;
+
+    // 10-bit to 8-bit conversion. Output planes are packed, as they are in
+    // the output buffers of gav1GetFrame and vpxGetFrame.
+    const Plane source_10 = Make10BitPlane(width, height);
+    Plane reference(width, height, /*bytes_per_sample=*/1,
+                    /*stride_alignment=*/1);
+    Convert10To8PlaneC(source_10.data.data(), source_10.stride,
+                       reference.data.data(), reference.stride, width, height);
+    checker->CheckGolden("Convert10To8Plane/C" + suffix.str(),
+                         reference.Checksum(1));
+    for (const auto& implementation : GetConvert10To8Implementations()) {
+      if (!implementation.supported) {
+        continue;
+      }
+      Plane output(width, height, /*bytes_per_sample=*/1,
+                   /*stride_alignment=*/1);
+      implementation.function(source_10.data.data(), source_10.stride,
+                              output.data.data(), output.stride, width,
+                              height);
+      if (output.data != reference.data) {
+        checker->Fail(std::string("Convert10To8Plane/") + implementation.name +
+                          suffix.str(),
+                      "output doesn't match Convert10To8PlaneC");
+      }
+    }
+    for (const auto& implementation :
+         GetDitheredConvert10To8Implementations()) {
+      if (!implementation.supported) {
+        continue;
+      }
+      Plane output(width, height, /*bytes_per_sample=*/1,
+                   /*stride_alignment=*/1);
+      implementation.function(source_10.data.data(), source_10.stride,
+                              output.data.data(), output.stride, width,
+                              height);
+      checker->CheckPsnr(
+          std::string("Convert10To8Plane/") + implementation.name +
+              suffix.str(),
+          Psnr(output, reference));
+    }
+
+    // Plane copy. Window buffer strides are aligned to 16 bytes.
+    const Plane source_8 = Make8BitPlane(width, height);
+    Plane copy(width, height, /*bytes_per_sample=*/1, /*stride_alignment=*/16);
+    CopyPlane(source_8.data.data(), source_8.stride, copy.data.data(),
+              copy.stride, width, height);
+    checker->CheckGolden("CopyPlane" + suffix.str(), copy.Checksum(1));
+  }
+
+  // Planes narrower than the SIMD blocks, or with a partial block at the end
+  // of each row, where the carried remainder passes between the SIMD and tail
+  // loops and between rows.
+  for (int width = 1; width <= 80; width++) {
+    const int height = 3;
+    const Plane source_10 = Make10BitPlane(width, height);
+    Plane reference(width, height, /*bytes_per_sample=*/1,
+                    /*stride_alignment=*/1);
+    Convert10To8PlaneC(source_10.data.data(), source_10.stride,
+                       reference.data.data(), reference.stride, width, height);
+    for (const auto& implementation : GetConvert10To8Implementations()) {
+      if (!implementation.supported) {
+        continue;
+      }
+      Plane output(width, height, /*bytes_per_sample=*/1,
+                   /*stride_alignment=*/1);
+      implementation.function(source_10.data.data(), source_10.stride,
+                              output.data.data(), output.stride, width,
+                              height);
+      if (output.data != reference.data) {
+        std::ostringstream name;
+        name << "Convert10To8Plane/" << implementation.name << "/" << width
+             << "x" << height;
+        checker->Fail(name.str(), "output doesn't match Convert10To8PlaneC");
+      }
+    }
+  }
+}
+
+void CheckAudioKernels(GoldenChecker* checker) {
+  for (unsigned bytes_per_sample : kBytesPerSample) {
+    for (unsigned channel_count : kChannelCounts) {
+      for (unsigned sample_count : kSampleCounts) {
+        std::ostringstream suffix;
+        suffix << "/" << bytes_per_sample << "/" << channel_count << "/"
+               << sample_count;
+
+        // Samples that use the full range of |bytes_per_sample| bytes.
+        Random random(bytes_per_sample * 131 + channel_count * 17 +
+                      sample_count);
+        const unsigned shift = 32 - bytes_per_sample * 8;
+        std::vector<std::vector<int32_t>> channels(channel_count);
+        std::vector<const int32_t*> source(channel_count);
+        for (unsigned c = 0; c < channel_count; c++) {
+          channels[c].resize(sample_count);
+          for (unsigned i = 0; i < sample_count; i++) {
+            const uint32_t bits = (random.Next() << 8) ^ random.Next();
+            // Sign extend from |bytes_per_sample| bytes.
+            channels[c][i] = static_cast<int32_t>(bits << shift) >> shift;
+          }
+          source[c] = channels[c].data();
+        }
+        const size_t output_size =
+            sample_count * channel_count * bytes_per_sample;
+
+        std::vector<int8_t> output(output_size);
+        InterleavePcmC(output.data(), source.data(), bytes_per_sample,
+                       sample_count, channel_count);
+        const std::string golden_name = "InterleavePcm" + suffix.str();
+        const uint64_t checksum =
+            Checksum(reinterpret_cast<const uint8_t*>(output.data()),
+                     output_size, kChecksumInit);
+        checker->CheckGolden(golden_name, checksum);
+        for (const auto& implementation : GetInterleavePcmImplementations()) {
+          if (!implementation.supported) {
+            continue;
+          }
+          std::vector<int8_t> simd_output(output_size);
+          implementation.function(simd_output.data(), source.data(),
+                                  bytes_per_sample, sample_count,
+                                  channel_count);
+          if (simd_output != output) {
+            checker->Fail(std::string("InterleavePcm/") + implementation.name +
+                              suffix.str(),
+                          "output doesn't match InterleavePcmC");
+          }
+        }
+
+        InterleavePcmBigEndian(output.data(), source.data(), bytes_per_sample,
+                               sample_count, channel_count);
+        checker->CheckGolden(
+            "InterleavePcmBigEndian" + suffix.str(),
+            Checksum(reinterpret_cast<const uint8_t*>(output.data()),
+                     output_size, kChecksumInit));
+      }
+    }
+  }
+}
+
+// The 16-bit and float conversions used by AudioChain. The SIMD
+// implementations must be bit exact.
+void CheckAudioConversionKernels(GoldenChecker* checker) {
+  for (unsigned channel_count : kChannelCounts) {
+    for (unsigned sample_count : kSampleCounts) {
+      std::ostringstream suffix;
+      suffix << "/" << channel_count << "/" << sample_count;
+      const unsigned total_sample_count = sample_count * channel_count;
+
+      Random random(channel_count * 17 + sample_count);
+      std::vector<int16_t> pcm16_source(total_sample_count);
+      for (unsigned i = 0; i < total_sample_count; i++) {
+        pcm16_source[i] = static_cast<int16_t>(random.Next());
+      }
+      std::vector<float> float_output(total_sample_count);
+      ConvertPcm16ToFloatC(pcm16_source.data(), float_output.data(),
+                           total_sample_count, 0.75f / 32768);
+      checker->CheckGolden(
+          "ConvertPcm16ToFloat" + suffix.str(),
+          Checksum(reinterpret_cast<const uint8_t*>(float_output.data()),
+                   total_sample_count * sizeof(float), kChecksumInit));
+      for (const auto& implementation :
+           GetConvertPcm16ToFloatImplementations()) {
+        if (!implementation.supported) {
+          continue;
+        }
+        std::vector<float> simd_output(total_sample_count);
+        implementation.function(pcm16_source.data(), simd_output.data(),
+                                total_sample_count, 0.75f / 32768);
+        if (simd_output != float_output) {
+          checker->Fail(std::string("ConvertPcm16ToFloat/") +
+                            implementation.name + suffix.str(),
+                        "output doesn't match ConvertPcm16ToFloatC");
+        }
+      }
+
+      // Samples up to 1.25 in magnitude, so that clamping is exercised, and
+      // every fourth sample exactly halfway between two 16-bit levels, so that
+      // rounding is exercised.
+      std::vector<float> float_source(total_sample_count);
+      for (unsigned i = 0; i < total_sample_count; i++) {
+        const int32_t bits = static_cast<int32_t>(random.Next() << 8);
+        float_source[i] = i % 4 == 0
+                              ? ((bits >> 16) + 0.5f) / 32768
+                              : bits * (1.25f / 2147483648.0f);
+      }
+      std::vector<int16_t> pcm16_output(total_sample_count);
+      ConvertFloatToPcm16C(float_source.data(), pcm16_output.data(),
+                           total_sample_count);
+      checker->CheckGolden(
+          "ConvertFloatToPcm16" + suffix.str(),
+          Checksum(reinterpret_cast<const uint8_t*>(pcm16_output.data()),
+                   total_sample_count * sizeof(int16_t), kChecksumInit));
+      for (const auto& implementation :
+           GetConvertFloatToPcm16Implementations()) {
+        if (!implementation.supported) {
+          continue;
+        }
+        std::vector<int16_t> simd_output(total_sample_count);
+        implementation.function(float_source.data(), simd_output.data(),
+                                total_sample_count);
+        if (simd_output != pcm16_output) {
+          checker->Fail(std::string("ConvertFloatToPcm16/") +
+                            implementation.name + suffix.str(),
+                        "output doesn't match ConvertFloatToPcm16C");
+        }
+      }
+    }
+  }
+}
+
+void CheckDotProductKernels(GoldenChecker* checker) {
+  // Sizes around the vector widths, and the hop sizes of the time stretcher.
+  const unsigned kDotProductSampleCounts[] = {1, 7, 8, 9, 15, 16, 17, 441, 480};
+  for (unsigned sample_count : kDotProductSampleCounts) {
+    const std::string suffix = "/" + std::to_string(sample_count);
+    Random random(sample_count);
+    std::vector<float> a(sample_count);
+    std::vector<float> b(sample_count);
+    double magnitude = 0;
+    for (unsigned i = 0; i < sample_count; i++) {
+      a[i] = static_cast<int32_t>(random.Next() << 8) / 2147483648.0f;
+      b[i] = static_cast<int32_t>(random.Next() << 8) / 2147483648.0f;
+      magnitude += std::fabs(static_cast<double>(a[i]) * b[i]);
+    }
+    const float result = DotProductC(a.data(), b.data(), sample_count);
+    checker->CheckGolden(
+        "DotProduct" + suffix,
+        Checksum(reinterpret_cast<const uint8_t*>(&result), sizeof(result),
+                 kChecksumInit));
+    for (const auto& implementation : GetDotProductImplementations()) {
+      if (!implementation.supported) {
+        continue;
+      }
+      const float simd_result =
+          implementation.function(a.data(), b.data(), sample_count);
+      if (std::fabs(simd_result - result) > kMaxDotProductError * magnitude) {
+        checker->Fail(
+            std::string("DotProduct/") + implementation.name + suffix,
+            "output doesn't match DotProductC");
+      }
+    }
+  }
+}
+
+void CheckFindPeakKernels(GoldenChecker* checker) {
+  // Sizes around the vector widths, and the sizes of mono and 7.1 blocks of the
+  // audio chain.
+  const unsigned kFindPeakSampleCounts[] = {0, 1, 7, 8, 9, 15, 16, 17, 256,
+                                            2048};
+  for (unsigned sample_count : kFindPeakSampleCounts) {
+    const std::string suffix = "/" + std::to_string(sample_count);
+    Random random(sample_count + 1);
+    std::vector<float> samples(sample_count);
+    for (unsigned i = 0; i < sample_count; i++) {
+      samples[i] = static_cast<int32_t>(random.Next() << 8) / 2147483648.0f;
+    }
+    const float result = FindPeakC(samples.data(), sample_count);
+    checker->CheckGolden(
+        "FindPeak" + suffix,
+        Checksum(reinterpret_cast<const uint8_t*>(&result), sizeof(result),
+                 kChecksumInit));
+    for (const auto& implementation : GetFindPeakImplementations()) {
+      if (!implementation.supported) {
+        continue;
+      }
+      if (implementation.function(samples.data(), sample_count) != result) {
+        checker->Fail(std::string("FindPeak/") + implementation.name + suffix,
+                      "output doesn't match FindPeakC");
+      }
+    }
+  }
+}
+
+void CheckSummarizeSamplesKernels(GoldenChecker* checker) {
+  // Sizes around the vector widths, and the sizes of mono and 7.1 blocks of the
+  // audio chain.
+  const unsigned kSummarizeSampleCounts[] = {0, 1, 7, 8, 9, 15, 16, 17, 256,
+                                             2048};
+  for (unsigned sample_count : kSummarizeSampleCounts) {
+    const std::string suffix = "/" + std::to_string(sample_count);
+    Random random(sample_count + 2);
+    std::vector<float> samples(sample_count);
+    for (unsigned i = 0; i < sample_count; i++) {
+      samples[i] = static_cast<int32_t>(random.Next() << 8) / 2147483648.0f;
+    }
+    const SampleSummary result =
+        SummarizeSamplesC(samples.data(), sample_count);
+    const float values[] = {result.min, result.max, result.sum_squares};
+    checker->CheckGolden(
+        "SummarizeSamples" + suffix,
+        Checksum(reinterpret_cast<const uint8_t*>(values), sizeof(values),
+                 kChecksumInit));
+    for (const auto& implementation : GetSummarizeSamplesImplementations()) {
+      if (!implementation.supported) {
+        continue;
+      }
+      const SampleSummary simd_result =
+          implementation.function(samples.data(), sample_count);
+      if (simd_result.min != result.min || simd_result.max != result.max ||
+          std::fabs(simd_result.sum_squares - result.sum_squares) >
+              kMaxDotProductError * result.sum_squares) {
+        checker->Fail(
+            std::string("SummarizeSamples/") + implementation.name + suffix,
+            "output doesn't match SummarizeSamplesC");
+      }
+    }
+  }
+}
+
+void CheckFftStageKernels(GoldenChecker* checker) {
+  // The smallest and a typical FFT size of the spectrum tap, and every stage
+  // of each, so that the scalar fallback of the first stages is covered.
+  const unsigned kFftSizes[] = {16, 1024};
+  for (unsigned size : kFftSizes) {
+    for (unsigned half_size = 1; half_size < size; half_size *= 2) {
+      const std::string suffix =
+          "/" + std::to_string(size) + "/" + std::to_string(half_size);
+      Random random(size + half_size);
+      std::vector<float> real(size);
+      std::vector<float> imag(size);
+      for (unsigned i = 0; i < size; i++) {
+        real[i] = static_cast<int32_t>(random.Next() << 8) / 2147483648.0f;
+        imag[i] = static_cast<int32_t>(random.Next() << 8) / 2147483648.0f;
+      }
+      std::vector<float> twiddle_real(half_size);
+      std::vector<float> twiddle_imag(half_size);
+      for (unsigned j = 0; j < half_size; j++) {
+        const double angle = -kPi * j / half_size;
+        twiddle_real[j] = static_cast<float>(std::cos(angle));
+        twiddle_imag[j] = static_cast<float>(std::sin(angle));
+      }
+      std::vector<float> reference_real = real;
+      std::vector<float> reference_imag = imag;
+      FftStageC(reference_real.data(), reference_imag.data(),
+                twiddle_real.data(), twiddle_imag.data(), size, half_size);
+      uint64_t checksum = Checksum(
+          reinterpret_cast<const uint8_t*>(reference_real.data()),
+          size * sizeof(float), kChecksumInit);
+      checksum =
+          Checksum(reinterpret_cast<const uint8_t*>(reference_imag.data()),
+                   size * sizeof(float), checksum);
+      checker->CheckGolden("FftStage" + suffix, checksum);
+      float magnitude = 0;
+      for (unsigned i = 0; i < size; i++) {
+        magnitude = std::max(magnitude, std::fabs(reference_real[i]));
+        magnitude = std::max(magnitude, std::fabs(reference_imag[i]));
+      }
+      for (const auto& implementation : GetFftStageImplementations()) {
+        if (!implementation.supported) {
+          continue;
+        }
+        std::vector<float> simd_real = real;
+        std::vector<float> simd_imag = imag;
+        implementation.function(simd_real.data(), simd_imag.data(),
+                                twiddle_real.data(), twiddle_imag.data(), size,
+                                half_size);
+        for (unsigned i = 0; i < size; i++) {
+          if (std::fabs(simd_real[i] - reference_real[i]) >
+                  kMaxFftStageError * magnitude ||
+              std::fabs(simd_imag[i] - reference_imag[i]) >
+                  kMaxFftStageError * magnitude) {
+            checker->Fail(
+                std::string("FftStage/") + implementation.name + suffix,
+                "output doesn't match FftStageC");
+            break;
+          }
+        }
+      }
+    }
+  }
+}
+
+// Dithers |sample_count| samples in two calls, so that the state carried from
+// one block to the next is covered.
+std::vector<int16_t> DitherPcm16(
+    DitherPcm16Function function,
+    const std::vector<std::vector<int32_t>>& source, unsigned bits_per_sample,
+    unsigned sample_count, bool noise_shaping) {
+  const unsigned channel_count = static_cast<unsigned>(source.size());
+  const unsigned first_sample_count = 1001;
+  DitherState state;
+  InitDitherState(&state, noise_shaping);
+  std::vector<int16_t> output(sample_count * channel_count);
+  std::vector<const int32_t*> channels(channel_count);
+  for (unsigned c = 0; c < channel_count; c++) {
+    channels[c] = source[c].data();
+  }
+  function(output.data(), channels.data(), bits_per_sample, first_sample_count,
+           channel_count, &state);
+  for (unsigned c = 0; c < channel_count; c++) {
+    channels[c] += first_sample_count;
+  }
+  function(output.data() + first_sample_count * channel_count, channels.data(),
+           bits_per_sample, sample_count - first_sample_count, channel_count,
+           &state);
+  return output;
+}
+
+void CheckDitherPcm16Kernels(GoldenChecker* checker) {
+  // The FLAC bit depths above 16 bits.
+  const unsigned kBitsPerSample[] = {24, 32};
+  for (unsigned bits_per_sample : kBitsPerSample) {
+    for (unsigned channel_count : kChannelCounts) {
+      for (unsigned sample_count : kSampleCounts) {
+        // Samples that use the full range, so that clamping is exercised.
+        Random random(bits_per_sample * 131 + channel_count * 17 +
+                      sample_count);
+        const unsigned shift = 32 - bits_per_sample;
+        std::vector<std::vector<int32_t>> source(channel_count);
+        for (unsigned c = 0; c < channel_count; c++) {
+          source[c].resize(sample_count);
+          for (unsigned i = 0; i < sample_count; i++) {
+            const uint32_t bits = (random.Next() << 8) ^ random.Next();
+            source[c][i] = static_cast<int32_t>(bits << shift) >> shift;
+          }
+        }
+        for (bool noise_shaping : {false, true}) {
+          std::ostringstream suffix;
+          suffix << "/" << bits_per_sample << "/" << channel_count << "/"
+                 << sample_count << (noise_shaping ? "/Shaped" : "");
+          const std::vector<int16_t> output =
+              DitherPcm16(DitherPcm16C, source, bits_per_sample, sample_count,
+                          noise_shaping);
+          checker->CheckGolden(
+              "DitherPcm16" + suffix.str(),
+              Checksum(reinterpret_cast<const uint8_t*>(output.data()),
+                       output.size() * sizeof(int16_t), kChecksumInit));
+          if (!noise_shaping) {
+            const double step = std::ldexp(1.0, bits_per_sample - 16);
+            for (unsigned i = 0; i < output.size(); i++) {
+              const double rounded = std::max(
+                  -32768.0,
+                  std::min(32767.0,
+                           std::floor(source[i % channel_count]
+                                             [i / channel_count] /
+                                          step +
+                                      0.5)));
+              if (std::fabs(output[i] - rounded) > 1) {
+                checker->Fail("DitherPcm16/C" + suffix.str(),
+                              "dither exceeds one level");
+                break;
+              }
+            }
+          }
+          for (const auto& implementation : GetDitherPcm16Implementations()) {
+            if (!implementation.supported) {
+              continue;
+            }
+            if (DitherPcm16(implementation.function, source, bits_per_sample,
+                            sample_count, noise_shaping) != output) {
+              checker->Fail(std::string("DitherPcm16/") + implementation.name +
+                                suffix.str(),
+                            "output doesn't match DitherPcm16C");
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+bool ReadGoldens(const char* path, std::map<std::string, uint64_t>* goldens) {
+  std::ifstream file(path);
+  if (!file) {
+    return false;
+  }
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::istringstream fields(line);
+    std::string name;
+    std::string checksum;
+    if (fields >> name >> checksum) {
+      (*goldens)[name] = strtoull(checksum.c_str(), nullptr, 16);
+    }
+  }
+  return true;
+}
+
+bool WriteGoldens(const char* path,
+                  const std::map<std::string, uint64_t>& goldens) {
+  FILE* file = fopen(path, "w");
+  if (file == nullptr) {
+    return false;
+  }
+  fprintf(file,
+          "# Golden kernel output checksums. Generated by kernel_golden_test "
+          "--update.\n");
+  for (const auto& golden : goldens) {
+    fprintf(file, "%s %016" PRIx64 "\n", golden.first.c_str(), golden.second);
+  }
+  return fclose(file) == 0;
+}
+
+int Run(int argc, char** argv) {
+  bool update = false;
+  const char* path = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--update") == 0) {
+      update = true;
+    } else {
+      path = argv[i];
+    }
+  }
+  if (path == nullptr) {
+    fprintf(stderr, "Usage: %s [--update] GOLDEN_FILE\n", argv[0]);
+    return 2;
+  }
+
+  std::map<std::string, uint64_t> goldens;
+  if (!update && !ReadGoldens(path, &goldens)) {
+    fprintf(stderr, "Failed to read %s\n", path);
+    return 2;
+  }
+
+  InitCpuDispatch();
+  GoldenChecker checker(&goldens, update);
+  CheckVideoKernels(&checker);
+  CheckAudioKernels(&checker);
+  CheckAudioConversionKernels(&checker);
+  CheckDotProductKernels(&checker);
+  CheckFindPeakKernels(&checker);
+  CheckSummarizeSamplesKernels(&checker);
+  CheckFftStageKernels(&checker);
+  CheckDitherPcm16Kernels(&checker);
+
+  if (update) {
+    if (!WriteGoldens(path, goldens)) {
+      fprintf(stderr, "Failed to write %s\n", path);
+      return 2;
+    }
+    printf("Wrote %zu golden checksums to %s\n", goldens.size(), path);
+    return 0;
+  }
+  if (checker.failure_count() > 0) {
+    fprintf(stderr, "%d checks failed\n", checker.failure_count());
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
+
+}  // namespace
+}  // namespace exoplayer_jni
+
+int main(int argc, char** argv) { return exoplayer_jni::Run(argc, argv); }
@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks the LoudnessMeter that the AudioChain uses to measure integrated
+// loudness against the test signals of EBU Tech 3341, which exercise the
+// K-weighting and the absolute and relative gates, and checks that the
+// loudness the AudioChain reports excludes its gain.
+//
+// Usage: loudness_meter_test
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "audio_chain.h"     // NOLINT
+#include "cpu_dispatch.h"    // NOLINT
+#include "loudness_meter.h"  // NOLINT
+
+namespace exoplayer_jni {
+namespace {
+
+const double kPi = 3.14159265358979323846;
+const int kSampleRate = 48000;
+// The tolerance of EBU Tech 3341 for integrated loudness.
+const double kMaxErrorLu = 0.1;
+
+// Appends |seconds| of a 1 kHz stereo tone whose peak is |level_dbfs| to
+// |samples|.
+void AppendTone(double level_dbfs, double seconds,
+                std::vector<float>* samples) {
+  const double amplitude = std::pow(10.0, level_dbfs / 20);
+  const int frame_count = static_cast<int>(seconds * kSampleRate);
+  for (int i = 0; i < frame_count; i++) {
+    const float sample =
+        static_cast<float>(amplitude * sin(2 * kPi * 1000 * i / kSampleRate));
+    samples->push_back(sample);
+    samples->push_back(sample);
+  }
+}
+
+// Measures stereo |samples| in calls of varying sizes, returning the
+// integrated loudness.
+double Measure(const std::vector<float>& samples) {
+  LoudnessMeter meter;
+  meter.Configure(/* channel_count= */ 2, kSampleRate);
+  const int frame_count = static_cast<int>(samples.size() / 2);
+  const int call_sizes[] = {256, 960, 37, 4096};
+  for (int first_frame = 0, call = 0; first_frame < frame_count; call++) {
+    const int call_frames =
+        std::min(call_sizes[call % 4], frame_count - first_frame);
+    meter.Process(&samples[first_frame * 2], call_frames);
+    first_frame += call_frames;
+  }
+  return meter.integrated_loudness();
+}
+
+bool CheckLoudness(const char* name, double loudness, double expected,
+                   std::string* error) {
+  if (!(std::fabs(loudness - expected) <= kMaxErrorLu)) {
+    *error = std::string(name) + " measured " + std::to_string(loudness) +
+             " LUFS, expected " + std::to_string(expected);
+    return false;
+  }
+  return true;
+}
+
+bool TestSteadyTones(std::string* error) {
+  std::vector<float> samples;
+  AppendTone(-23, 20, &samples);
+  if (!CheckLoudness("-23 dBFS tone", Measure(samples), -23, error)) {
+    return false;
+  }
+  samples.clear();
+  AppendTone(-33, 20, &samples);
+  return CheckLoudness("-33 dBFS tone", Measure(samples), -33, error);
+}
+
+bool TestRelativeGate(std::string* error) {
+  // Test signals 3 and 5 of EBU Tech 3341.
+  std::vector<float> samples;
+  AppendTone(-36, 10, &samples);
+  AppendTone(-23, 60, &samples);
+  AppendTone(-36, 10, &samples);
+  if (!CheckLoudness("-36/-23/-36 dBFS tones", Measure(samples), -23, error)) {
+    return false;
+  }
+  samples.clear();
+  AppendTone(-26, 20, &samples);
+  AppendTone(-20, 20.1, &samples);
+  AppendTone(-26, 20, &samples);
+  return CheckLoudness("-26/-20/-26 dBFS tones", Measure(samples), -23, error);
+}
+
+bool TestAbsoluteGate(std::string* error) {
+  // Test signal 4 of EBU Tech 3341, in which the -72 dBFS tones are gated out
+  // by the absolute gate.
+  std::vector<float> samples;
+  AppendTone(-72, 10, &samples);
+  AppendTone(-36, 10, &samples);
+  AppendTone(-23, 60, &samples);
+  AppendTone(-36, 10, &samples);
+  AppendTone(-72, 10, &samples);
+  if (!CheckLoudness("tones with -72 dBFS tones", Measure(samples), -23,
+                     error)) {
+    return false;
+  }
+  samples.assign(kSampleRate * 2 * 5, 0.0f);
+  const double loudness = Measure(samples);
+  if (!std::isinf(loudness) || loudness > 0) {
+    *error = "silence measured " + std::to_string(loudness) + " LUFS";
+    return false;
+  }
+  return true;
+}
+
+bool TestAudioChainExcludesGain(std::string* error) {
+  std::vector<float> samples;
+  AppendTone(-23, 10, &samples);
+  AudioChainConfig config;
+  config.gain = 0.5f;
+  config.measure_loudness = true;
+  AudioChain chain;
+  chain.SetConfig(config);
+  if (!chain.Configure(/* channel_count= */ 2, kSampleRate,
+                       kPcmEncodingFloat) ||
+      chain.IsPassthrough()) {
+    *error = "loudness measurement configuration failed or is passthrough";
+    return false;
+  }
+  const int frame_count = static_cast<int>(samples.size() / 2);
+  std::vector<uint8_t> output(chain.GetMaxOutputSize(frame_count));
+  if (chain.Process(samples.data(), frame_count, output.data(),
+                    output.size()) < 0) {
+    *error = "processing failed";
+    return false;
+  }
+  return CheckLoudness("AudioChain with gain", chain.GetIntegratedLoudness(),
+                       -23, error);
+}
+
+int Main(int argc, char** argv) {
+  if (argc != 1) {
+    fprintf(stderr, "Usage: %s\n", argv[0]);
+    return 2;
+  }
+  InitCpuDispatch();
+  std::string error;
+  const bool passed = TestSteadyTones(&error) && TestRelativeGate(&error) &&
+                      TestAbsoluteGate(&error) &&
+                      TestAudioChainExcludesGain(&error);
+  if (!passed) {
+    fprintf(stderr, "FAILED: %s\n", error.c_str());
+    return 1;
+  }
+  printf("PASSED\n");
+  return 0;
+}
+
+}  // namespace
+}  // namespace exoplayer_jni
+
+int main(int argc, char** argv) { return exoplayer_jni::Main(argc, argv); }
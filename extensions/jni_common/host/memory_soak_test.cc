@@ -0,0 +1,465 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Simulates hours of video playback through the FrameBufferPool that the VP9
+// and AV1 extensions decode into, and tracks memory usage over time.
+//
+// A simulated decoder acquires a buffer for each frame, sized like the frame
+// buffers libvpx and libgav1 request, including their borders and alignment
+// padding. It keeps references to buffers in reference frame slots, like the
+// codec libraries do, and to the last few output frames, like the application
+// does while frames are queued for rendering. Playback runs at 30 frames per
+// second, and at random intervals switches to another rung of an adaptive
+// bitrate ladder, seeks, which releases all references, or recreates the
+// decoder and its pool, alternating between VP9 and AV1 frame layouts. Each
+// new decoder is prewarmed by reserving buffers for the current frame size.
+// Each frame's pages are written to, so that the pool's memory is resident.
+//
+// At each report interval of simulated time, the pool's size and allocation
+// rate are reported along with the process RSS and malloc statistics: the heap
+// in use, the free memory held in the heap, the memory in separate mmap()ed
+// chunks and the heap's fragmentation, the proportion of the heap that's free.
+// The test fails if the pool's statistics don't match its buffers, if the pool
+// holds on to more than kShrinkFactor times the memory its buffers need for the
+// current frame size, if a prewarmed decoder allocates a buffer for its first
+// frame, or if memory in use isn't returned once all decoders are destroyed.
+//
+// Usage: memory_soak_test [--minutes=M] [--report_minutes=R] [--seed=S]
+
+#include <malloc.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+
+#include "decoder_stats.h"      // NOLINT
+#include "frame_buffer_pool.h"  // NOLINT
+#include "test_data.h"          // NOLINT
+
+namespace exoplayer_jni {
+namespace {
+
+const int kFramesPerSecond = 30;
+const int kFramesPerMinute = 60 * kFramesPerSecond;
+const int kKeyFrameInterval = 2 * kFramesPerSecond;
+// Reference frame slots of VP9 and AV1.
+const int kReferenceSlotCount = 8;
+// Output frames held by the application.
+const int kOutputQueueLength = 4;
+// Buffers reserved when a decoder is prewarmed.
+const int kPrewarmBufferCount = kOutputQueueLength + 4;
+// The allowed growth of the heap in use after all decoders are destroyed, for
+// allocations made by the C library.
+const size_t kLeakTolerance = 64 * 1024;
+const size_t kPageSize = 4096;
+const double kMegabyte = 1024 * 1024;
+
+// Frame buffer layout of a codec library.
+struct Codec {
+  const char* name;
+  int border;
+  int stride_alignment;
+};
+
+// Approximations of the frame buffers that libvpx and libgav1 request.
+const Codec kCodecs[] = {{"vp9", 32, 32}, {"av1", 64, 16}};
+
+// A rung of an adaptive bitrate ladder.
+struct Rung {
+  int width;
+  int height;
+  int bytes_per_sample;
+};
+
+const Rung kLadder[] = {{426, 240, 1},  {640, 360, 1},   {854, 480, 1},
+                        {1280, 720, 1}, {1920, 1080, 1}, {1920, 1080, 2}};
+const int kRungCount = sizeof(kLadder) / sizeof(kLadder[0]);
+
+int Align(int value, int alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+// Returns the size of a 4:2:0 frame buffer of |codec| for |rung|.
+size_t GetFrameBufferSize(const Codec& codec, const Rung& rung) {
+  const int width = Align(rung.width, 8);
+  const int height = Align(rung.height, 8);
+  const int uv_border = codec.border / 2;
+  const size_t y_stride =
+      Align((width + 2 * codec.border) * rung.bytes_per_sample,
+            codec.stride_alignment);
+  const size_t uv_stride = Align(
+      (width / 2 + 2 * uv_border) * rung.bytes_per_sample,
+      codec.stride_alignment);
+  const size_t y_size =
+      y_stride * (height + 2 * codec.border) + codec.stride_alignment;
+  const size_t uv_size =
+      uv_stride * (height / 2 + 2 * uv_border) + codec.stride_alignment;
+  return y_size + 2 * uv_size;
+}
+
+// Returns a random number of frames between |min_seconds| and |max_seconds|.
+int64_t RandomFrameCount(Random* random, int min_seconds, int max_seconds) {
+  return (min_seconds + random->Next() % (max_seconds - min_seconds + 1)) *
+         static_cast<int64_t>(kFramesPerSecond);
+}
+
+struct MemoryInfo {
+  size_t rss_bytes;
+  // Memory allocated from the heap.
+  size_t heap_in_use_bytes;
+  // Free memory held in the heap.
+  size_t heap_free_bytes;
+  // Memory allocated in separate mmap()ed chunks.
+  size_t mmapped_bytes;
+};
+
+MemoryInfo GetMemoryInfo() {
+  MemoryInfo info = {};
+  FILE* statm = fopen("/proc/self/statm", "r");
+  if (statm) {
+    unsigned long size_pages;      // NOLINT
+    unsigned long resident_pages;  // NOLINT
+    if (fscanf(statm, "%lu %lu", &size_pages, &resident_pages) == 2) {
+      info.rss_bytes = resident_pages * sysconf(_SC_PAGESIZE);
+    }
+    fclose(statm);
+  }
+#if defined(__GLIBC__) && \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  const struct mallinfo2 malloc_info = mallinfo2();
+#else
+  const struct mallinfo malloc_info = mallinfo();
+#endif
+  info.heap_in_use_bytes = malloc_info.uordblks;
+  info.heap_free_bytes = malloc_info.fordblks;
+  info.mmapped_bytes = malloc_info.hblkhd;
+  return info;
+}
+
+// A decoder that references frame buffers like libvpx and libgav1, and an
+// application that holds its most recent output frames.
+class Decoder {
+ public:
+  explicit Decoder(const Codec* codec) : codec_(codec), pool_(&stats_) {
+    for (int i = 0; i < kReferenceSlotCount; i++) {
+      reference_ids_[i] = -1;
+    }
+  }
+
+  ~Decoder() { Flush(); }
+
+  // Not copyable or movable.
+  Decoder(const Decoder&) = delete;
+  Decoder& operator=(const Decoder&) = delete;
+
+  // Decodes a frame of |rung|, which refreshes all reference slots if it's a
+  // key frame and one random slot otherwise. Returns false if no buffer could
+  // be acquired.
+  bool DecodeFrame(const Rung& rung, bool key_frame, Random* random) {
+    const size_t size = GetFrameBufferSize(*codec_, rung);
+    const int id = pool_.Acquire(size);
+    if (id < 0) {
+      return false;
+    }
+    uint8_t* const data = pool_.Data(id);
+    for (size_t offset = 0; offset < size; offset += kPageSize) {
+      data[offset] = static_cast<uint8_t>(offset);
+    }
+    if (key_frame) {
+      for (int i = 0; i < kReferenceSlotCount; i++) {
+        SetReference(i, id);
+      }
+    } else {
+      SetReference(random->Next() % kReferenceSlotCount, id);
+    }
+    // The reference taken by Acquire() is held by the application.
+    output_ids_.push_back(id);
+    if (static_cast<int>(output_ids_.size()) > kOutputQueueLength) {
+      pool_.Release(output_ids_.front());
+      output_ids_.pop_front();
+    }
+    return true;
+  }
+
+  // Reserves buffers for frames of |rung|, as when a decoder is prewarmed.
+  void Prewarm(const Rung& rung) {
+    pool_.Reserve(kPrewarmBufferCount, GetFrameBufferSize(*codec_, rung));
+  }
+
+  // Releases all references, as when seeking.
+  void Flush() {
+    for (int i = 0; i < kReferenceSlotCount; i++) {
+      SetReference(i, -1);
+    }
+    for (int id : output_ids_) {
+      pool_.Release(id);
+    }
+    output_ids_.clear();
+  }
+
+  // Returns the number of distinct buffers that are referenced.
+  int GetBuffersInUse() const {
+    bool in_use[FrameBufferPool::kMaxBuffers] = {};
+    int count = 0;
+    for (int i = 0; i < kReferenceSlotCount; i++) {
+      if (reference_ids_[i] >= 0 && !in_use[reference_ids_[i]]) {
+        in_use[reference_ids_[i]] = true;
+        count++;
+      }
+    }
+    for (int id : output_ids_) {
+      if (!in_use[id]) {
+        in_use[id] = true;
+        count++;
+      }
+    }
+    return count;
+  }
+
+  // Checks that the pool's statistics match its buffers, and that the pool
+  // holds at most kShrinkFactor times the memory its buffers need for |rung|.
+  bool CheckPool(const Rung& rung, bool check_size, std::string* error) const {
+    int64_t snapshot[DecoderStats::kSnapshotLength];
+    stats_.Snapshot(snapshot);
+    const size_t allocated_bytes = pool_.AllocatedBytes();
+    char message[256];
+    if (snapshot[DecoderStats::kFrameBufferBytes] !=
+        static_cast<int64_t>(allocated_bytes)) {
+      snprintf(message, sizeof(message),
+               "frame buffer bytes %" PRId64 ", expected %zu",
+               snapshot[DecoderStats::kFrameBufferBytes], allocated_bytes);
+      *error = message;
+      return false;
+    }
+    if (snapshot[DecoderStats::kFrameBuffersInUse] != GetBuffersInUse()) {
+      snprintf(message, sizeof(message),
+               "frame buffers in use %" PRId64 ", expected %d",
+               snapshot[DecoderStats::kFrameBuffersInUse], GetBuffersInUse());
+      *error = message;
+      return false;
+    }
+    const size_t max_bytes = static_cast<size_t>(pool_.BufferCount()) *
+                             FrameBufferPool::kShrinkFactor *
+                             GetFrameBufferSize(*codec_, rung);
+    if (check_size && allocated_bytes > max_bytes) {
+      snprintf(message, sizeof(message),
+               "pool holds %zu bytes for %d buffers of %dx%d frames, "
+               "expected at most %zu",
+               allocated_bytes, pool_.BufferCount(), rung.width, rung.height,
+               max_bytes);
+      *error = message;
+      return false;
+    }
+    return true;
+  }
+
+  const Codec& codec() const { return *codec_; }
+  const FrameBufferPool& pool() const { return pool_; }
+
+  int64_t GetAllocationCount() const {
+    int64_t snapshot[DecoderStats::kSnapshotLength];
+    stats_.Snapshot(snapshot);
+    return snapshot[DecoderStats::kFrameBufferAllocationCount];
+  }
+
+ private:
+  void SetReference(int slot, int id) {
+    if (id >= 0) {
+      pool_.AddReference(id);
+    }
+    if (reference_ids_[slot] >= 0) {
+      pool_.Release(reference_ids_[slot]);
+    }
+    reference_ids_[slot] = id;
+  }
+
+  const Codec* const codec_;
+  // Declared before |pool_|, which updates it.
+  DecoderStats stats_;
+  FrameBufferPool pool_;
+  int reference_ids_[kReferenceSlotCount];
+  std::deque<int> output_ids_;
+};
+
+bool ParseIntFlag(const char* arg, const char* name, int* value) {
+  const size_t length = strlen(name);
+  if (strncmp(arg, name, length) != 0 || arg[length] != '=') {
+    return false;
+  }
+  *value = atoi(arg + length + 1);
+  return true;
+}
+
+int Main(int argc, char** argv) {
+  int minutes = 240;
+  int report_minutes = 10;
+  int seed = 1;
+  for (int i = 1; i < argc; i++) {
+    if (!ParseIntFlag(argv[i], "--minutes", &minutes) &&
+        !ParseIntFlag(argv[i], "--report_minutes", &report_minutes) &&
+        !ParseIntFlag(argv[i], "--seed", &seed)) {
+      fprintf(stderr,
+              "Usage: %s [--minutes=M] [--report_minutes=R] [--seed=S]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+  if (minutes < 1 || report_minutes < 1) {
+    fprintf(stderr, "--minutes and --report_minutes must be positive\n");
+    return 2;
+  }
+
+  printf("%d minutes of playback at %d frames/s, seed %d\n", minutes,
+         kFramesPerSecond, seed);
+  printf("%7s %5s %9s %7s %7s %7s %10s %8s %8s %9s %8s %6s\n", "minute",
+         "codec", "rung", "buffers", "in_use", "pool_MB", "allocs/min",
+         "rss_MB", "heap_MB", "heap_free", "mmap_MB", "frag%");
+  fflush(stdout);
+  const MemoryInfo baseline = GetMemoryInfo();
+
+  Random random(static_cast<uint32_t>(seed));
+  int codec_index = 0;
+  int rung_index = 1;
+  std::unique_ptr<Decoder> decoder(new Decoder(&kCodecs[codec_index]));
+  int64_t finished_allocation_count = 0;
+  int64_t reported_allocation_count = 0;
+  int decoder_count = 1;
+  int switch_count = 0;
+  int seek_count = 0;
+  int64_t frames_since_switch = 0;
+  int64_t next_switch_frame = RandomFrameCount(&random, 10, 60);
+  int64_t next_seek_frame = RandomFrameCount(&random, 30, 120);
+  int64_t next_recreate_frame = RandomFrameCount(&random, 300, 900);
+  size_t peak_rss_bytes = 0;
+  int failure_count = 0;
+  bool prewarm = true;
+
+  const int64_t frame_count = static_cast<int64_t>(minutes) * kFramesPerMinute;
+  const int64_t report_frame_count =
+      static_cast<int64_t>(report_minutes) * kFramesPerMinute;
+  for (int64_t frame = 0; frame < frame_count; frame++) {
+    bool key_frame = frame % kKeyFrameInterval == 0;
+    if (frame == next_recreate_frame) {
+      finished_allocation_count += decoder->GetAllocationCount();
+      decoder.reset();
+      codec_index = (codec_index + 1) % 2;
+      decoder.reset(new Decoder(&kCodecs[codec_index]));
+      decoder_count++;
+      prewarm = true;
+      key_frame = true;
+      next_recreate_frame += RandomFrameCount(&random, 300, 900);
+    }
+    if (frame == next_seek_frame) {
+      decoder->Flush();
+      seek_count++;
+      key_frame = true;
+      next_seek_frame += RandomFrameCount(&random, 30, 120);
+    }
+    if (frame == next_switch_frame) {
+      rung_index = (rung_index + 1 + random.Next() % (kRungCount - 1)) %
+                   kRungCount;
+      switch_count++;
+      frames_since_switch = 0;
+      key_frame = true;
+      next_switch_frame += RandomFrameCount(&random, 10, 60);
+    }
+    int64_t prewarm_allocation_count = -1;
+    if (prewarm) {
+      decoder->Prewarm(kLadder[rung_index]);
+      prewarm_allocation_count = decoder->GetAllocationCount();
+      prewarm = false;
+    }
+    if (!decoder->DecodeFrame(kLadder[rung_index], key_frame, &random)) {
+      fprintf(stderr, "FAILED: no frame buffer at frame %" PRId64 "\n", frame);
+      return 1;
+    }
+    if (prewarm_allocation_count >= 0 &&
+        decoder->GetAllocationCount() != prewarm_allocation_count) {
+      fprintf(stderr,
+              "FAILED: first frame after prewarming allocated at frame %" PRId64
+              "\n",
+              frame);
+      failure_count++;
+    }
+    frames_since_switch++;
+
+    if ((frame + 1) % report_frame_count != 0) {
+      continue;
+    }
+    const MemoryInfo info = GetMemoryInfo();
+    peak_rss_bytes = std::max(peak_rss_bytes, info.rss_bytes);
+    const int64_t allocation_count =
+        finished_allocation_count + decoder->GetAllocationCount();
+    const Rung& rung = kLadder[rung_index];
+    const size_t heap_bytes = info.heap_in_use_bytes + info.heap_free_bytes;
+    char rung_name[16];
+    snprintf(rung_name, sizeof(rung_name), "%dp%s", rung.height,
+             rung.bytes_per_sample == 2 ? "10" : "");
+    printf("%7" PRId64 " %5s %9s %7d %7d %7.1f %10.1f %8.1f %8.1f %9.1f "
+           "%8.1f %6.1f\n",
+           (frame + 1) / kFramesPerMinute, decoder->codec().name, rung_name,
+           decoder->pool().BufferCount(), decoder->GetBuffersInUse(),
+           decoder->pool().AllocatedBytes() / kMegabyte,
+           static_cast<double>(allocation_count - reported_allocation_count) /
+               report_minutes,
+           info.rss_bytes / kMegabyte, info.heap_in_use_bytes / kMegabyte,
+           info.heap_free_bytes / kMegabyte, info.mmapped_bytes / kMegabyte,
+           heap_bytes ? 100.0 * info.heap_free_bytes / heap_bytes : 0.0);
+    fflush(stdout);
+    reported_allocation_count = allocation_count;
+    // Buffers referenced since before the last switch may not have been
+    // reallocated yet.
+    std::string error;
+    if (!decoder->CheckPool(rung, frames_since_switch > kKeyFrameInterval,
+                            &error)) {
+      fprintf(stderr, "FAILED: minute %" PRId64 ": %s\n",
+              (frame + 1) / kFramesPerMinute, error.c_str());
+      failure_count++;
+    }
+  }
+
+  decoder.reset();
+  const MemoryInfo info = GetMemoryInfo();
+  const size_t baseline_in_use =
+      baseline.heap_in_use_bytes + baseline.mmapped_bytes;
+  const size_t in_use = info.heap_in_use_bytes + info.mmapped_bytes;
+  printf("%d decoders, %d switches, %d seeks, peak RSS %.1f MB, final RSS "
+         "%.1f MB, memory in use %zu bytes before and %zu bytes after\n",
+         decoder_count, switch_count, seek_count, peak_rss_bytes / kMegabyte,
+         info.rss_bytes / kMegabyte, baseline_in_use, in_use);
+  if (in_use > baseline_in_use + kLeakTolerance) {
+    fprintf(stderr,
+            "FAILED: %zu bytes still in use after destroying all decoders\n",
+            in_use - baseline_in_use);
+    failure_count++;
+  }
+  if (failure_count > 0) {
+    return 1;
+  }
+  printf("PASSED\n");
+  return 0;
+}
+
+}  // namespace
+}  // namespace exoplayer_jni
+
+int main(int argc, char** argv) { return exoplayer_jni::Main(argc, argv); }
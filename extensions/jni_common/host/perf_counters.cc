@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "perf_counters.h"  // NOLINT
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace exoplayer_jni {
+namespace {
+
+// The event that each counter is opened with.
+const uint64_t kCounterEvents[PerfCounters::kCounterCount] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+// The names that each counter is reported with.
+const char* const kCounterNames[PerfCounters::kCounterCount] = {
+    "cycles",
+    "instructions",
+    "cache_misses",
+    "branch_misses",
+};
+
+int OpenCounter(uint64_t event, int group_fd) {
+  perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = event;
+  // The group is enabled and disabled through its leader.
+  attr.disabled = group_fd == -1 ? 1 : 0;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                     PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return static_cast<int>(syscall(SYS_perf_event_open, &attr, /*pid=*/0,
+                                  /*cpu=*/-1, group_fd, /*flags=*/0));
+}
+
+}  // namespace
+
+PerfCounters::PerfCounters() : group_fd_(-1), fds_(), values_() {
+  for (int i = 0; i < kCounterCount; i++) {
+    fds_[i] = OpenCounter(kCounterEvents[i], group_fd_);
+    if (fds_[i] == -1) {
+      for (int j = 0; j < i; j++) {
+        close(fds_[j]);
+      }
+      group_fd_ = -1;
+      return;
+    }
+    if (i == 0) {
+      group_fd_ = fds_[0];
+    }
+  }
+}
+
+PerfCounters::~PerfCounters() {
+  if (!IsAvailable()) {
+    return;
+  }
+  for (int i = 0; i < kCounterCount; i++) {
+    close(fds_[i]);
+  }
+}
+
+void PerfCounters::Start() {
+  if (!IsAvailable()) {
+    return;
+  }
+  ioctl(group_fd_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(group_fd_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+void PerfCounters::Stop() {
+  if (!IsAvailable()) {
+    return;
+  }
+  ioctl(group_fd_, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+  // See the PERF_FORMAT_GROUP read format in perf_event_open(2).
+  struct {
+    uint64_t counter_count;
+    uint64_t time_enabled;
+    uint64_t time_running;
+    uint64_t values[kCounterCount];
+  } data;
+  if (read(group_fd_, &data, sizeof(data)) != sizeof(data) ||
+      data.counter_count != kCounterCount || data.time_running == 0) {
+    memset(values_, 0, sizeof(values_));
+    return;
+  }
+  const double scale =
+      static_cast<double>(data.time_enabled) / data.time_running;
+  for (int i = 0; i < kCounterCount; i++) {
+    values_[i] = static_cast<uint64_t>(data.values[i] * scale);
+  }
+}
+
+bool ArePerfCountersRequested() {
+  static const bool requested = [] {
+    const char* value = getenv("EXOPLAYER_PERF_COUNTERS");
+    return value != nullptr && strcmp(value, "1") == 0;
+  }();
+  return requested;
+}
+
+ScopedBenchmarkPerfCounters::ScopedBenchmarkPerfCounters(
+    benchmark::State* state, int64_t bytes_per_iteration)
+    : state_(state), bytes_per_iteration_(bytes_per_iteration) {
+  if (!ArePerfCountersRequested()) {
+    return;
+  }
+  counters_.reset(new PerfCounters());
+  if (!counters_->IsAvailable()) {
+    static bool warned = false;
+    if (!warned) {
+      fprintf(stderr,
+              "Hardware performance counters are not available. Check "
+              "/proc/sys/kernel/perf_event_paranoid.\n");
+      warned = true;
+    }
+    counters_.reset();
+    return;
+  }
+  counters_->Start();
+}
+
+ScopedBenchmarkPerfCounters::~ScopedBenchmarkPerfCounters() {
+  if (!counters_) {
+    return;
+  }
+  counters_->Stop();
+  for (int i = 0; i < PerfCounters::kCounterCount; i++) {
+    state_->counters[kCounterNames[i]] = benchmark::Counter(
+        static_cast<double>(
+            counters_->Get(static_cast<PerfCounters::Counter>(i))),
+        benchmark::Counter::kAvgIterations);
+  }
+  const double cycles = counters_->Get(PerfCounters::kCycles);
+  if (cycles == 0) {
+    return;
+  }
+  state_->counters["IPC"] =
+      counters_->Get(PerfCounters::kInstructions) / cycles;
+  state_->counters["bytes_per_cycle"] =
+      bytes_per_iteration_ * static_cast<double>(state_->iterations()) /
+      cycles;
+}
+
+}  // namespace exoplayer_jni
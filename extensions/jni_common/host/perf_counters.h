@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_HOST_PERF_COUNTERS_H_
+#define EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_HOST_PERF_COUNTERS_H_
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <memory>
+
+namespace exoplayer_jni {
+
+// Hardware performance counters for the calling thread, read with
+// perf_event_open. The counters are opened as a group, so that they're
+// scheduled onto the PMU together and can be compared with each other.
+class PerfCounters {
+ public:
+  enum Counter {
+    kCycles,
+    kInstructions,
+    kCacheMisses,
+    kBranchMisses,
+    kCounterCount,
+  };
+
+  // Opens the counters. Check IsAvailable() before using them, since opening
+  // them fails on machines without a PMU, such as most virtual machines, and
+  // when /proc/sys/kernel/perf_event_paranoid is too restrictive.
+  PerfCounters();
+  ~PerfCounters();
+
+  // Not copyable or movable, since the counters own file descriptors.
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  bool IsAvailable() const { return group_fd_ != -1; }
+
+  // Resets the counters to zero and starts counting.
+  void Start();
+
+  // Stops counting.
+  void Stop();
+
+  // Returns the value of a counter. If the counters had to share the PMU with
+  // other events, the value is scaled up to estimate the full count.
+  uint64_t Get(Counter counter) const { return values_[counter]; }
+
+ private:
+  int group_fd_;
+  int fds_[kCounterCount];
+  uint64_t values_[kCounterCount];
+};
+
+// Returns whether hardware performance counters have been requested, by setting
+// the EXOPLAYER_PERF_COUNTERS environment variable to 1.
+bool ArePerfCountersRequested();
+
+// Collects hardware performance counters over the timed loop of a benchmark,
+// if they've been requested and are available, and reports them per iteration
+// when destroyed. Along with the raw counters, the instructions per cycle and
+// the bytes processed per cycle are reported, where a low IPC and a high cache
+// miss count indicate a memory-bound kernel.
+//
+// Construct it immediately before the timed loop:
+//
+//   for (auto _ : state) ...
+//
+// and with the number of bytes that each iteration reads and writes.
+class ScopedBenchmarkPerfCounters {
+ public:
+  ScopedBenchmarkPerfCounters(benchmark::State* state,
+                              int64_t bytes_per_iteration);
+  ~ScopedBenchmarkPerfCounters();
+
+  ScopedBenchmarkPerfCounters(const ScopedBenchmarkPerfCounters&) = delete;
+  ScopedBenchmarkPerfCounters& operator=(const ScopedBenchmarkPerfCounters&) =
+      delete;
+
+ private:
+  benchmark::State* const state_;
+  const int64_t bytes_per_iteration_;
+  std::unique_ptr<PerfCounters> counters_;
+};
+
+}  // namespace exoplayer_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_HOST_PERF_COUNTERS_H_
@@ -0,0 +1,102 @@
+#!/bin/bash
+#
+# Copyright (C) 2021 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# Builds the host project with and without profile-guided optimization (PGO)
+# and link-time optimization (LTO), and reports the speedup of each benchmark in
+# kernel_benchmark. Arguments after the build directory are passed to
+# kernel_benchmark, for example --benchmark_filter=Convert.
+#
+# The instrumented build is trained by running the host tests and benchmarks.
+# With Clang, its profiles are merged into ${build_dir}/pgo/exoplayer.profdata,
+# which can also be used to build the extensions (see ../README.md). With GCC,
+# the profiles can only be used by the build that generated them.
+
+set -e
+
+if [ $# -lt 1 ]; then
+  echo "Usage: ${0} <build_dir> [kernel_benchmark arguments...]"
+  exit 1
+fi
+
+host_dir="$(cd "$(dirname "${0}")" && pwd)"
+mkdir -p "${1}"
+build_dir="$(cd "${1}" && pwd)"
+shift
+baseline_dir="${build_dir}/baseline"
+pgo_dir="${build_dir}/pgo"
+profile_dir="${pgo_dir}/profile"
+jobs="$(nproc)"
+
+echo "Building baseline"
+cmake -S "${host_dir}" -B "${baseline_dir}" -DCMAKE_BUILD_TYPE=Release \
+  > /dev/null
+cmake --build "${baseline_dir}" -j "${jobs}" > /dev/null
+
+# GCC finds profiles using the paths of the object files, so the optimized build
+# reuses the instrumented build's directory.
+echo "Building with profile instrumentation"
+rm -rf "${profile_dir}"
+cmake -S "${host_dir}" -B "${pgo_dir}" -DCMAKE_BUILD_TYPE=Release \
+  -DEXOPLAYER_JNI_PGO=generate -DEXOPLAYER_JNI_PROFILE="${profile_dir}" \
+  -DEXOPLAYER_JNI_LTO=OFF > /dev/null
+cmake --build "${pgo_dir}" -j "${jobs}" > /dev/null
+
+echo "Training"
+(cd "${pgo_dir}" && ctest > /dev/null)
+"${pgo_dir}/kernel_benchmark" --benchmark_min_time=0.05 > /dev/null 2>&1
+
+if ls "${profile_dir}"/*.profraw > /dev/null 2>&1; then
+  profile="${pgo_dir}/exoplayer.profdata"
+  llvm-profdata merge -output="${profile}" "${profile_dir}"/*.profraw
+else
+  profile="${profile_dir}"
+fi
+
+echo "Building with PGO and LTO"
+cmake -S "${host_dir}" -B "${pgo_dir}" -DEXOPLAYER_JNI_PGO=use \
+  -DEXOPLAYER_JNI_PROFILE="${profile}" -DEXOPLAYER_JNI_LTO=ON > /dev/null
+cmake --build "${pgo_dir}" -j "${jobs}" > /dev/null
+
+echo "Benchmarking"
+"${baseline_dir}/kernel_benchmark" --benchmark_format=csv "$@" \
+  > "${build_dir}/baseline.csv" 2> /dev/null
+"${pgo_dir}/kernel_benchmark" --benchmark_format=csv "$@" \
+  > "${build_dir}/pgo.csv" 2> /dev/null
+
+# Joins the results on the benchmark name, and compares their CPU times.
+awk -F, '
+  BEGIN {
+    printf "%-64s %12s %12s %8s\n", "Benchmark", "Baseline", "PGO+LTO",
+        "Speedup"
+  }
+  $1 == "name" { next }
+  FNR == NR { baseline[$1] = $4; next }
+  ($1 in baseline) && $4 > 0 {
+    name = $1
+    gsub(/"/, "", name)
+    speedup = baseline[$1] / $4
+    printf "%-64s %9.0f %s %9.0f %s %7.3fx\n", name, baseline[$1], $5, $4, $5,
+        speedup
+    log_sum += log(speedup)
+    count++
+  }
+  END {
+    if (count > 0) {
+      printf "Geometric mean speedup over %d benchmarks: %.3fx\n", count,
+          exp(log_sum / count)
+    }
+  }' "${build_dir}/baseline.csv" "${build_dir}/pgo.csv"
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Benchmarks the sample format conversion done by the FFmpeg extension's
+// decodePacket with libswresample. Only built if libswresample is installed on
+// the host.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <vector>
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+#include <libavutil/opt.h>
+#include <libavutil/samplefmt.h>
+#include <libswresample/swresample.h>
+}
+
+#include "kernel_benchmark.h"  // NOLINT
+#include "perf_counters.h"     // NOLINT
+
+namespace exoplayer_jni {
+namespace {
+
+// The number of samples per channel in an AAC frame.
+const int kResampleSampleCount = 1024;
+
+// Adds input format, output format and channel count arguments. The input
+// formats are the planar formats that FFmpeg's audio decoders output, and the
+// output formats are those that the extension requests.
+void ResampleArguments(benchmark::internal::Benchmark* benchmark) {
+  for (int input_format :
+       {AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_S16P, AV_SAMPLE_FMT_S32P}) {
+    for (int output_format : {AV_SAMPLE_FMT_S16, AV_SAMPLE_FMT_FLT}) {
+      for (int channel_count : {1, 2, 6, 8}) {
+        benchmark->Args({input_format, output_format, channel_count});
+      }
+    }
+  }
+  benchmark->ArgNames({"input_format", "output_format", "channels"});
+}
+
+// Converts a decoded frame to the requested output format, configured in the
+// same way as in decodePacket.
+void BM_ResampleFrame(benchmark::State& state) {
+  const AVSampleFormat input_format =
+      static_cast<AVSampleFormat>(state.range(0));
+  const AVSampleFormat output_format =
+      static_cast<AVSampleFormat>(state.range(1));
+  const int channel_count = static_cast<int>(state.range(2));
+  const int64_t channel_layout = av_get_default_channel_layout(channel_count);
+  const int sample_rate = 48000;
+  SwrContext* context = swr_alloc();
+  av_opt_set_int(context, "in_channel_layout", channel_layout, 0);
+  av_opt_set_int(context, "out_channel_layout", channel_layout, 0);
+  av_opt_set_int(context, "in_sample_rate", sample_rate, 0);
+  av_opt_set_int(context, "out_sample_rate", sample_rate, 0);
+  av_opt_set_int(context, "in_sample_fmt", input_format, 0);
+  av_opt_set_int(context, "out_sample_fmt", output_format, 0);
+  if (swr_init(context) < 0) {
+    swr_free(&context);
+    state.SkipWithError("swr_init failed");
+    return;
+  }
+
+  const int input_sample_size = av_get_bytes_per_sample(input_format);
+  const int output_sample_size = av_get_bytes_per_sample(output_format);
+  std::vector<std::vector<uint8_t>> input_planes(channel_count);
+  std::vector<const uint8_t*> input(channel_count);
+  for (int i = 0; i < channel_count; i++) {
+    // Zero is silence in all of the input formats.
+    input_planes[i].resize(kResampleSampleCount * input_sample_size);
+    input[i] = input_planes[i].data();
+  }
+  std::vector<uint8_t> output_buffer(kResampleSampleCount * channel_count *
+                                     output_sample_size);
+  uint8_t* output = output_buffer.data();
+  const int64_t bytes_per_frame =
+      kResampleSampleCount * channel_count *
+      static_cast<int64_t>(input_sample_size + output_sample_size);
+  {
+    ScopedBenchmarkPerfCounters perf_counters(&state, bytes_per_frame);
+    for (auto _ : state) {
+      const int result = swr_convert(context, &output, kResampleSampleCount,
+                                     input.data(), kResampleSampleCount);
+      benchmark::DoNotOptimize(result);
+      benchmark::ClobberMemory();
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * bytes_per_frame);
+  swr_free(&context);
+}
+BENCHMARK(BM_ResampleFrame)->Apply(ResampleArguments);
+
+// Moves the same number of bytes as BM_ResampleFrame.
+void BM_ResampleFrameMemcpyBaseline(benchmark::State& state) {
+  const int input_sample_size =
+      av_get_bytes_per_sample(static_cast<AVSampleFormat>(state.range(0)));
+  const int output_sample_size =
+      av_get_bytes_per_sample(static_cast<AVSampleFormat>(state.range(1)));
+  const int64_t channel_count = state.range(2);
+  MemcpyBaseline(state, kResampleSampleCount * channel_count *
+                            (input_sample_size + output_sample_size) / 2);
+}
+BENCHMARK(BM_ResampleFrameMemcpyBaseline)->Apply(ResampleArguments);
+
+}  // namespace
+}  // namespace exoplayer_jni
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_HOST_SESSION_READER_H_
+#define EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_HOST_SESSION_READER_H_
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "session_recorder.h"  // NOLINT
+
+namespace exoplayer_jni {
+
+// A record read from a session recording.
+struct SessionRecord {
+  session_format::RecordHeader header;
+  std::vector<uint8_t> data;
+};
+
+// Reads the session recording at |path| into |codec| and |records|. A truncated
+// last record, which is written if the device runs out of storage while
+// recording, is ignored. Returns false, setting |error|, if the file can't be
+// read or isn't a recording.
+inline bool ReadSession(const char* path, uint32_t* codec,
+                        std::vector<SessionRecord>* records,
+                        std::string* error) {
+  FILE* file = fopen(path, "rb");
+  if (!file) {
+    *error = std::string("Can't open ") + path;
+    return false;
+  }
+  session_format::FileHeader file_header;
+  if (fread(&file_header, sizeof(file_header), 1, file) != 1 ||
+      memcmp(file_header.magic, session_format::kMagic,
+             sizeof(file_header.magic)) != 0) {
+    *error = std::string(path) + " isn't a session recording";
+    fclose(file);
+    return false;
+  }
+  if (file_header.version != session_format::kVersion) {
+    *error = std::string(path) + " has unsupported version " +
+             std::to_string(file_header.version);
+    fclose(file);
+    return false;
+  }
+  *codec = file_header.codec;
+  records->clear();
+  SessionRecord record;
+  while (fread(&record.header, sizeof(record.header), 1, file) == 1) {
+    record.data.resize(record.header.size);
+    if (record.header.size &&
+        fread(record.data.data(), record.header.size, 1, file) != 1) {
+      break;
+    }
+    records->push_back(record);
+  }
+  fclose(file);
+  if (records->empty() ||
+      records->front().header.type != session_format::kRecordInit) {
+    *error = std::string(path) + " doesn't start with an init record";
+    return false;
+  }
+  return true;
+}
+
+// Returns the name of |codec|, or nullptr if it isn't known.
+inline const char* GetCodecName(uint32_t codec) {
+  switch (codec) {
+    case session_format::kCodecVp9:
+      return "vp9";
+    case session_format::kCodecAv1:
+      return "av1";
+    case session_format::kCodecOpus:
+      return "opus";
+    case session_format::kCodecFlac:
+      return "flac";
+    case session_format::kCodecFfmpeg:
+      return "ffmpeg";
+    default:
+      return nullptr;
+  }
+}
+
+// Returns the name of a record |type|, or nullptr if it isn't known.
+inline const char* GetRecordTypeName(uint32_t type) {
+  switch (type) {
+    case session_format::kRecordInit:
+      return "init";
+    case session_format::kRecordDecode:
+      return "decode";
+    case session_format::kRecordGetFrame:
+      return "getFrame";
+    case session_format::kRecordRender:
+      return "render";
+    case session_format::kRecordReleaseFrame:
+      return "releaseFrame";
+    case session_format::kRecordReset:
+      return "reset";
+    case session_format::kRecordFlush:
+      return "flush";
+    case session_format::kRecordOutputMode:
+      return "outputMode";
+    case session_format::kRecordRead:
+      return "read";
+    default:
+      return nullptr;
+  }
+}
+
+}  // namespace exoplayer_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_HOST_SESSION_READER_H_
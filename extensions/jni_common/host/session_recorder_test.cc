@@ -0,0 +1,371 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks that SessionRecorder writes recordings that session_replay reads back
+// unchanged: that calls are only recorded while recording, that each recording
+// starts with the decoder's parameters and output mode, that records made from
+// several threads aren't interleaved, and that a recording truncated by a full
+// disk can still be read.
+//
+// The last check records a simulated FLAC session, in which each decode call is
+// preceded by the reads it made. With --output, that recording is kept at the
+// given path, for session_replay to be run on.
+//
+// Usage: session_recorder_test [--output=PATH]
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "session_reader.h"    // NOLINT
+#include "session_recorder.h"  // NOLINT
+#include "test_data.h"         // NOLINT
+
+namespace exoplayer_jni {
+namespace {
+
+const int kThreadCount = 4;
+const int kRecordsPerThread = 1000;
+const int kSimulatedFrameCount = 200;
+
+// Reads the recording at |path|, checking its codec.
+bool ReadRecording(const std::string& path, session_format::Codec codec,
+                   std::vector<SessionRecord>* records, std::string* error) {
+  uint32_t read_codec;
+  if (!ReadSession(path.c_str(), &read_codec, records, error)) {
+    return false;
+  }
+  if (read_codec != codec) {
+    *error = path + " has codec " + std::to_string(read_codec);
+    return false;
+  }
+  return true;
+}
+
+// Checks that a record has the given type and argument.
+bool CheckRecord(const SessionRecord& record, session_format::RecordType type,
+                 int64_t argument, std::string* error) {
+  if (record.header.type != type || record.header.argument != argument) {
+    *error = std::string("expected a ") + GetRecordTypeName(type) +
+             " record with argument " + std::to_string(argument) +
+             ", got type " + std::to_string(record.header.type) +
+             " with argument " + std::to_string(record.header.argument);
+    return false;
+  }
+  return true;
+}
+
+bool TestRecordsOnlyWhileRecording(const std::string& path,
+                                   std::string* error) {
+  SessionRecorder recorder(session_format::kCodecVp9);
+  const int64_t parameters[] = {0, 1, 4};
+  recorder.SetInitParameters(parameters, 3, nullptr, 0);
+  const uint8_t data[] = {1, 2, 3, 4, 5};
+  { ScopedSessionRecord record(&recorder, session_format::kRecordDecode); }
+  if (!recorder.Start(path.c_str())) {
+    *error = "can't create " + path;
+    return false;
+  }
+  {
+    ScopedSessionRecord record(&recorder, session_format::kRecordDecode, data,
+                               sizeof(data));
+    record.set_result(-3);
+  }
+  {
+    ScopedSessionRecord record(&recorder, session_format::kRecordGetFrame);
+    record.set_argument(7);
+    record.set_flags(session_format::kFlagDecodeOnly);
+  }
+  recorder.Stop();
+  { ScopedSessionRecord record(&recorder, session_format::kRecordFlush); }
+
+  std::vector<SessionRecord> records;
+  if (!ReadRecording(path, session_format::kCodecVp9, &records, error)) {
+    return false;
+  }
+  if (records.size() != 3) {
+    *error = "expected 3 records, got " + std::to_string(records.size());
+    return false;
+  }
+  if (!CheckRecord(records[0], session_format::kRecordInit, 3, error) ||
+      !CheckRecord(records[1], session_format::kRecordDecode, -1, error) ||
+      !CheckRecord(records[2], session_format::kRecordGetFrame, 7, error)) {
+    return false;
+  }
+  if (records[0].data.size() != sizeof(parameters) ||
+      memcmp(records[0].data.data(), parameters, sizeof(parameters)) != 0) {
+    *error = "init record doesn't contain the parameters";
+    return false;
+  }
+  if (records[1].data.size() != sizeof(data) ||
+      memcmp(records[1].data.data(), data, sizeof(data)) != 0 ||
+      records[1].header.result != -3) {
+    *error = "decode record doesn't match the call";
+    return false;
+  }
+  if (records[2].header.flags != session_format::kFlagDecodeOnly ||
+      records[2].header.time_ns < records[1].header.time_ns ||
+      records[2].header.duration_ns < 0) {
+    *error = "getFrame record doesn't match the call";
+    return false;
+  }
+  return true;
+}
+
+bool TestOutputModeRecords(const std::string& path, std::string* error) {
+  SessionRecorder recorder(session_format::kCodecOpus);
+  const uint8_t stream_map[] = {0, 1};
+  const int64_t parameters[] = {48000, 2, 1, 1, 0};
+  recorder.SetInitParameters(parameters, 5, stream_map, sizeof(stream_map));
+  // Set before recording, so it's written at the start of the recording.
+  recorder.SetOutputMode(1);
+  if (!recorder.Start(path.c_str())) {
+    *error = "can't create " + path;
+    return false;
+  }
+  // Unchanged, so not recorded.
+  recorder.SetOutputMode(1);
+  recorder.SetOutputMode(0);
+  recorder.Stop();
+
+  std::vector<SessionRecord> records;
+  if (!ReadRecording(path, session_format::kCodecOpus, &records, error)) {
+    return false;
+  }
+  if (records.size() != 3) {
+    *error = "expected 3 records, got " + std::to_string(records.size());
+    return false;
+  }
+  if (!CheckRecord(records[0], session_format::kRecordInit, 5, error) ||
+      !CheckRecord(records[1], session_format::kRecordOutputMode, 1, error) ||
+      !CheckRecord(records[2], session_format::kRecordOutputMode, 0, error)) {
+    return false;
+  }
+  const size_t parameters_size = sizeof(parameters);
+  if (records[0].data.size() != parameters_size + sizeof(stream_map) ||
+      memcmp(records[0].data.data() + parameters_size, stream_map,
+             sizeof(stream_map)) != 0) {
+    *error = "init record doesn't contain the initialization data";
+    return false;
+  }
+
+  // Restarting writes the parameters and the current output mode again.
+  if (!recorder.Start(path.c_str())) {
+    *error = "can't create " + path;
+    return false;
+  }
+  recorder.Stop();
+  if (!ReadRecording(path, session_format::kCodecOpus, &records, error)) {
+    return false;
+  }
+  if (records.size() != 2) {
+    *error = "expected 2 records after restarting, got " +
+             std::to_string(records.size());
+    return false;
+  }
+  return CheckRecord(records[0], session_format::kRecordInit, 5, error) &&
+         CheckRecord(records[1], session_format::kRecordOutputMode, 0, error);
+}
+
+bool TestConcurrentRecords(const std::string& path, std::string* error) {
+  SessionRecorder recorder(session_format::kCodecAv1);
+  if (!recorder.Start(path.c_str())) {
+    *error = "can't create " + path;
+    return false;
+  }
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreadCount; i++) {
+    threads.emplace_back([&recorder, i]() {
+      for (int j = 0; j < kRecordsPerThread; j++) {
+        // Each thread's records contain its index, repeated a varying number
+        // of times.
+        const std::vector<uint8_t> data(j % 64, static_cast<uint8_t>(i));
+        ScopedSessionRecord record(&recorder, session_format::kRecordDecode,
+                                   data.data(), data.size());
+        record.set_argument(i);
+        record.set_result(j);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  recorder.Stop();
+
+  std::vector<SessionRecord> records;
+  if (!ReadRecording(path, session_format::kCodecAv1, &records, error)) {
+    return false;
+  }
+  const size_t expected_count = 1 + kThreadCount * kRecordsPerThread;
+  if (records.size() != expected_count) {
+    *error = "expected " + std::to_string(expected_count) + " records, got " +
+             std::to_string(records.size());
+    return false;
+  }
+  std::vector<int> next_results(kThreadCount);
+  for (size_t i = 1; i < records.size(); i++) {
+    const session_format::RecordHeader& header = records[i].header;
+    if (header.argument < 0 || header.argument >= kThreadCount ||
+        header.result != next_results[header.argument]) {
+      *error = "record " + std::to_string(i) + " is out of order";
+      return false;
+    }
+    next_results[header.argument]++;
+    const std::vector<uint8_t> expected_data(
+        header.result % 64, static_cast<uint8_t>(header.argument));
+    if (records[i].data != expected_data) {
+      *error = "record " + std::to_string(i) + " has corrupt data";
+      return false;
+    }
+  }
+  return true;
+}
+
+// Records a simulated FLAC session, whose decode calls each read a frame of
+// random data through the data source callback.
+bool RecordSimulatedSession(const std::string& path, std::string* error) {
+  SessionRecorder recorder(session_format::kCodecFlac);
+  recorder.SetInitParameters(nullptr, 0, nullptr, 0);
+  if (!recorder.Start(path.c_str())) {
+    *error = "can't create " + path;
+    return false;
+  }
+  Random random(1);
+  std::vector<uint8_t> frame;
+  for (int i = 0; i < kSimulatedFrameCount; i++) {
+    if (i == kSimulatedFrameCount / 2) {
+      ScopedSessionRecord record(&recorder, session_format::kRecordReset);
+      record.set_argument(0);
+    }
+    ScopedSessionRecord decode(&recorder, session_format::kRecordDecode);
+    {
+      ScopedSessionRecord read(&recorder, session_format::kRecordRead);
+      frame.resize(1024 + random.Next() % 4096);
+      for (uint8_t& value : frame) {
+        value = static_cast<uint8_t>(random.Next());
+      }
+      read.set_data(frame.data(), frame.size());
+      read.set_result(static_cast<int32_t>(frame.size()));
+    }
+    decode.set_result(4096);
+  }
+  recorder.Stop();
+  return true;
+}
+
+bool TestTruncatedRecord(const std::string& path, std::string* error) {
+  std::vector<SessionRecord> records;
+  if (!ReadRecording(path, session_format::kCodecFlac, &records, error)) {
+    return false;
+  }
+  const size_t record_count = records.size();
+  if (record_count != 2 + 2 * kSimulatedFrameCount) {
+    *error = "expected " + std::to_string(2 + 2 * kSimulatedFrameCount) +
+             " records, got " + std::to_string(record_count);
+    return false;
+  }
+  // Truncate the file part way through the last record's data, like a write to
+  // a full disk.
+  const std::string truncated_path = path + ".truncated";
+  FILE* source = fopen(path.c_str(), "rb");
+  FILE* destination = fopen(truncated_path.c_str(), "wb");
+  if (!source || !destination) {
+    *error = "can't copy " + path;
+    if (source) {
+      fclose(source);
+    }
+    if (destination) {
+      fclose(destination);
+    }
+    return false;
+  }
+  fseek(source, 0, SEEK_END);
+  std::vector<uint8_t> contents(ftell(source));
+  fseek(source, 0, SEEK_SET);
+  const bool copied =
+      fread(contents.data(), contents.size(), 1, source) == 1 &&
+      fwrite(contents.data(), contents.size() - 1, 1, destination) == 1;
+  fclose(source);
+  fclose(destination);
+  if (!copied) {
+    *error = "can't copy " + path;
+    return false;
+  }
+  const bool read = ReadRecording(truncated_path, session_format::kCodecFlac,
+                                  &records, error);
+  unlink(truncated_path.c_str());
+  if (!read) {
+    return false;
+  }
+  if (records.size() != record_count - 1) {
+    *error = "expected " + std::to_string(record_count - 1) +
+             " records after truncation, got " +
+             std::to_string(records.size());
+    return false;
+  }
+  return true;
+}
+
+bool ParseStringFlag(const char* arg, const char* name, std::string* value) {
+  const size_t length = strlen(name);
+  if (strncmp(arg, name, length) != 0 || arg[length] != '=') {
+    return false;
+  }
+  *value = arg + length + 1;
+  return true;
+}
+
+int Main(int argc, char** argv) {
+  std::string output_path;
+  for (int i = 1; i < argc; i++) {
+    if (!ParseStringFlag(argv[i], "--output", &output_path)) {
+      fprintf(stderr, "Usage: %s [--output=PATH]\n", argv[0]);
+      return 2;
+    }
+  }
+  const std::string path =
+      "session_recorder_test_" + std::to_string(getpid()) + ".rec";
+  const std::string simulated_session_path =
+      output_path.empty() ? path + ".flac" : output_path;
+
+  std::string error;
+  const bool passed =
+      TestRecordsOnlyWhileRecording(path, &error) &&
+      TestOutputModeRecords(path, &error) &&
+      TestConcurrentRecords(path, &error) &&
+      RecordSimulatedSession(simulated_session_path, &error) &&
+      TestTruncatedRecord(simulated_session_path, &error);
+  unlink(path.c_str());
+  if (output_path.empty()) {
+    unlink(simulated_session_path.c_str());
+  }
+  if (!passed) {
+    fprintf(stderr, "FAILED: %s\n", error.c_str());
+    return 1;
+  }
+  printf("PASSED\n");
+  return 0;
+}
+
+}  // namespace
+}  // namespace exoplayer_jni
+
+int main(int argc, char** argv) { return exoplayer_jni::Main(argc, argv); }
@@ -0,0 +1,584 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Replays a session recording made with a decoder's startSessionRecording(),
+// re-executing the recorded calls against the host build of the codec library,
+// and reports their timing alongside the recorded timing, together with the
+// decoder statistics collected during the replay.
+//
+// VP9 recordings are replayed with libvpx and Opus recordings with libopus, if
+// they were found when the host project was configured. As in the extensions,
+// VP9 frames are decoded into a FrameBufferPool and output through the kernels
+// selected by InitCpuDispatch(). Rendering to a surface can't be replayed, so
+// render calls only have their recorded timing reported. Recordings of other
+// codecs, or of codecs whose library wasn't found, have only their recorded
+// timing reported.
+//
+// By default the calls are made back to back, which measures the decoder's
+// throughput on the recorded input. With --paced, each call is made at the time
+// it was recorded, and calls that return after the next call was due are
+// counted as late, which is what causes a decoder that can't keep up to drop
+// frames. Calls whose success differs from the recording, for example because
+// recording started in the middle of a stream, are counted as mismatches.
+//
+// Usage: session_replay [--paced] [--repeat=N] RECORDING
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "cpu_dispatch.h"       // NOLINT
+#include "decoder_stats.h"      // NOLINT
+#include "frame_buffer_pool.h"  // NOLINT
+#include "session_reader.h"     // NOLINT
+#include "session_recorder.h"   // NOLINT
+
+#if defined(EXOPLAYER_REPLAY_VPX)
+#define VPX_CODEC_DISABLE_COMPAT 1
+#include "vpx/vp8dx.h"
+#include "vpx/vpx_decoder.h"
+#endif
+#if defined(EXOPLAYER_REPLAY_OPUS)
+#include "opus.h"              // NOLINT
+#include "opus_multistream.h"  // NOLINT
+#endif
+
+namespace exoplayer_jni {
+namespace {
+
+// LINT.IfChange
+const int kOutputModeYuv = 0;
+const int kOutputModeSurfaceYuv = 1;
+// LINT.ThenChange(../../../library/common/src/main/java/com/google/android/exoplayer2/C.java)
+
+// Re-executes recorded calls against a codec library. Each call returns a
+// result that's comparable to the recorded one.
+class ReplayDecoder {
+ public:
+  virtual ~ReplayDecoder() {}
+
+  // Creates the codec library's decoder. Returns false if it can't be created.
+  virtual bool Init(const int64_t* parameters, int parameter_count,
+                    const uint8_t* data, size_t size) = 0;
+  virtual int Decode(const uint8_t* data, size_t size) = 0;
+  // Gets a decoded frame. In surface mode, |buffer_id| is set to the id of
+  // the frame's buffer, which is referenced until it's released.
+  virtual int GetFrame(int32_t /* flags */, int* /* buffer_id */) { return 0; }
+  virtual void ReleaseFrame(int /* buffer_id */) {}
+  virtual void Reset(int64_t /* argument */) {}
+  virtual void SetOutputMode(int64_t /* mode */) {}
+
+  DecoderStats* stats() { return &stats_; }
+
+ protected:
+  DecoderStats stats_;
+};
+
+#if defined(EXOPLAYER_REPLAY_VPX)
+
+// Replays calls to the VP9 extension's vpx_jni.cc.
+class VpxReplayDecoder : public ReplayDecoder {
+ public:
+  VpxReplayDecoder() : pool_(&stats_), initialized_(false), output_mode_(0) {}
+
+  ~VpxReplayDecoder() override {
+    if (initialized_) {
+      vpx_codec_destroy(&decoder_);
+    }
+  }
+
+  bool Init(const int64_t* parameters, int parameter_count,
+            const uint8_t* data, size_t size) override {
+    if (parameter_count < 3) {
+      return false;
+    }
+    vpx_codec_dec_cfg_t cfg = {0, 0, 0};
+    cfg.threads = static_cast<unsigned int>(parameters[2]);
+    if (vpx_codec_dec_init(&decoder_, &vpx_codec_vp9_dx_algo, &cfg, 0)) {
+      return false;
+    }
+    initialized_ = true;
+#ifdef VPX_CTRL_VP9_DECODE_SET_ROW_MT
+    vpx_codec_control(&decoder_, VP9D_SET_ROW_MT,
+                      static_cast<int>(parameters[1]));
+#endif
+    if (parameters[0]) {
+      vpx_codec_control(&decoder_, VP9_SET_SKIP_LOOP_FILTER, true);
+#ifdef VPX_CTRL_VP9_SET_LOOP_FILTER_OPT
+    } else {
+      vpx_codec_control(&decoder_, VP9D_SET_LOOP_FILTER_OPT, true);
+#endif
+    }
+    return vpx_codec_set_frame_buffer_functions(
+               &decoder_, GetFrameBuffer, ReleaseFrameBuffer, &pool_) ==
+           VPX_CODEC_OK;
+  }
+
+  int Decode(const uint8_t* data, size_t size) override {
+    stats_.Increment(DecoderStats::kInputBufferCount);
+    stats_.Increment(DecoderStats::kInputByteCount, size);
+    vpx_codec_err_t status;
+    {
+      ScopedLatencyTimer timer(&stats_, DecoderStats::kDecodeTime);
+      status = vpx_codec_decode(&decoder_, data,
+                                static_cast<unsigned int>(size), nullptr, 0);
+    }
+    if (status != VPX_CODEC_OK) {
+      stats_.Increment(DecoderStats::kDecodeErrorCount);
+    }
+    return status;
+  }
+
+  int GetFrame(int32_t flags, int* buffer_id) override {
+    vpx_codec_iter_t iter = nullptr;
+    const vpx_image_t* const img = vpx_codec_get_frame(&decoder_, &iter);
+    if (img == nullptr) {
+      return 1;
+    }
+    if (output_mode_ == kOutputModeYuv) {
+      const int uv_height = (img->d_h + 1) / 2;
+      const size_t y_length =
+          static_cast<size_t>(img->stride[VPX_PLANE_Y]) * img->d_h;
+      const size_t uv_length =
+          static_cast<size_t>(img->stride[VPX_PLANE_U]) * uv_height;
+      output_.resize(y_length + 2 * uv_length);
+      ScopedLatencyTimer timer(&stats_, DecoderStats::kConvertTime);
+      stats_.Increment(DecoderStats::kOutputByteCount,
+                       y_length + 2 * uv_length);
+      uint8_t* const dst = output_.data();
+      if (img->fmt == VPX_IMG_FMT_I42016) {
+        const Convert10To8PlaneFunction convert_10_to_8_plane =
+            GetKernels().convert_10_to_8_plane;
+        const int uv_width = (img->d_w + 1) / 2;
+        convert_10_to_8_plane(img->planes[VPX_PLANE_Y],
+                              img->stride[VPX_PLANE_Y], dst,
+                              img->stride[VPX_PLANE_Y], img->d_w, img->d_h);
+        convert_10_to_8_plane(img->planes[VPX_PLANE_U],
+                              img->stride[VPX_PLANE_U], dst + y_length,
+                              img->stride[VPX_PLANE_U], uv_width, uv_height);
+        convert_10_to_8_plane(img->planes[VPX_PLANE_V],
+                              img->stride[VPX_PLANE_V],
+                              dst + y_length + uv_length,
+                              img->stride[VPX_PLANE_V], uv_width, uv_height);
+      } else {
+        memcpy(dst, img->planes[VPX_PLANE_Y], y_length);
+        memcpy(dst + y_length, img->planes[VPX_PLANE_U], uv_length);
+        memcpy(dst + y_length + uv_length, img->planes[VPX_PLANE_V],
+               uv_length);
+      }
+    } else if (output_mode_ == kOutputModeSurfaceYuv) {
+      if (img->fmt & VPX_IMG_FMT_HIGHBITDEPTH) {
+        return -1;
+      }
+      *buffer_id = *static_cast<const int*>(img->fb_priv);
+      pool_.AddReference(*buffer_id);
+    }
+    stats_.Increment(DecoderStats::kOutputBufferCount);
+    return 0;
+  }
+
+  void ReleaseFrame(int buffer_id) override { pool_.Release(buffer_id); }
+
+  void SetOutputMode(int64_t mode) override {
+    output_mode_ = static_cast<int>(mode);
+  }
+
+ private:
+  static int GetFrameBuffer(void* priv, size_t min_size,
+                            vpx_codec_frame_buffer_t* fb) {
+    FrameBufferPool* const pool = static_cast<FrameBufferPool*>(priv);
+    const int id = pool->Acquire(min_size);
+    if (id < 0) {
+      return -1;
+    }
+    fb->data = pool->Data(id);
+    fb->size = min_size;
+    fb->priv = pool->PrivateData(id);
+    memset(fb->data, 0, fb->size);
+    return 0;
+  }
+
+  static int ReleaseFrameBuffer(void* priv, vpx_codec_frame_buffer_t* fb) {
+    FrameBufferPool* const pool = static_cast<FrameBufferPool*>(priv);
+    return pool->Release(*static_cast<int*>(fb->priv)) ? 0 : -1;
+  }
+
+  // Declared before |decoder_|, which must be destroyed first.
+  FrameBufferPool pool_;
+  vpx_codec_ctx_t decoder_;
+  bool initialized_;
+  int output_mode_;
+  std::vector<uint8_t> output_;
+};
+
+#endif  // defined(EXOPLAYER_REPLAY_VPX)
+
+#if defined(EXOPLAYER_REPLAY_OPUS)
+
+// Replays calls to the Opus extension's opus_jni.cc.
+class OpusReplayDecoder : public ReplayDecoder {
+ public:
+  // The maximum number of samples per channel in a packet.
+  static const int kMaxPacketSampleCount = 960 * 6;
+
+  OpusReplayDecoder()
+      : decoder_(nullptr), channel_count_(0), output_float_(false) {}
+
+  ~OpusReplayDecoder() override {
+    if (decoder_) {
+      opus_multistream_decoder_destroy(decoder_);
+    }
+  }
+
+  bool Init(const int64_t* parameters, int parameter_count,
+            const uint8_t* data, size_t size) override {
+    if (parameter_count < 5) {
+      return false;
+    }
+    channel_count_ = static_cast<int>(parameters[1]);
+    if (size < static_cast<size_t>(channel_count_)) {
+      return false;
+    }
+    int status = OPUS_INVALID_STATE;
+    decoder_ = opus_multistream_decoder_create(
+        static_cast<int>(parameters[0]), channel_count_,
+        static_cast<int>(parameters[2]), static_cast<int>(parameters[3]), data,
+        &status);
+    if (!decoder_ || status != OPUS_OK) {
+      return false;
+    }
+    opus_multistream_decoder_ctl(
+        decoder_, OPUS_SET_GAIN(static_cast<int>(parameters[4])));
+    output_.resize(kMaxPacketSampleCount * channel_count_ * sizeof(float));
+    return true;
+  }
+
+  int Decode(const uint8_t* data, size_t size) override {
+    stats_.Increment(DecoderStats::kInputBufferCount);
+    stats_.Increment(DecoderStats::kInputByteCount, size);
+    int sample_count;
+    {
+      ScopedLatencyTimer timer(&stats_, DecoderStats::kDecodeTime);
+      if (output_float_) {
+        sample_count = opus_multistream_decode_float(
+            decoder_, data, static_cast<int>(size),
+            reinterpret_cast<float*>(output_.data()), kMaxPacketSampleCount,
+            0);
+      } else {
+        sample_count = opus_multistream_decode(
+            decoder_, data, static_cast<int>(size),
+            reinterpret_cast<int16_t*>(output_.data()), kMaxPacketSampleCount,
+            0);
+      }
+    }
+    if (sample_count < 0) {
+      stats_.Increment(DecoderStats::kDecodeErrorCount);
+      return sample_count;
+    }
+    stats_.Increment(DecoderStats::kOutputBufferCount);
+    stats_.Increment(DecoderStats::kOutputByteCount,
+                     sample_count * channel_count_ *
+                         (output_float_ ? sizeof(float) : sizeof(int16_t)));
+    return sample_count;
+  }
+
+  void Reset(int64_t argument) override {
+    opus_multistream_decoder_ctl(decoder_, OPUS_RESET_STATE);
+  }
+
+  void SetOutputMode(int64_t mode) override { output_float_ = mode == 1; }
+
+ private:
+  OpusMSDecoder* decoder_;
+  int channel_count_;
+  bool output_float_;
+  std::vector<uint8_t> output_;
+};
+
+#endif  // defined(EXOPLAYER_REPLAY_OPUS)
+
+// Returns a new decoder to replay recordings of |codec| with, or nullptr if
+// this build can't replay them.
+std::unique_ptr<ReplayDecoder> CreateReplayDecoder(uint32_t codec) {
+  switch (codec) {
+#if defined(EXOPLAYER_REPLAY_VPX)
+    case session_format::kCodecVp9:
+      return std::unique_ptr<ReplayDecoder>(new VpxReplayDecoder());
+#endif
+#if defined(EXOPLAYER_REPLAY_OPUS)
+    case session_format::kCodecOpus:
+      return std::unique_ptr<ReplayDecoder>(new OpusReplayDecoder());
+#endif
+    default:
+      return nullptr;
+  }
+}
+
+// Durations of the calls of a record type.
+struct CallTimes {
+  std::vector<int64_t> recorded_ns;
+  std::vector<int64_t> replayed_ns;
+};
+
+// Returns the |percentile| of |values| in microseconds, sorting them.
+double GetPercentileUs(std::vector<int64_t>* values, int percentile) {
+  if (values->empty()) {
+    return 0;
+  }
+  std::sort(values->begin(), values->end());
+  return (*values)[(values->size() - 1) * percentile / 100] / 1000.0;
+}
+
+// The outcome of replaying a recording once.
+struct ReplayResult {
+  int late_call_count = 0;
+  int mismatch_count = 0;
+  int64_t duration_ns = 0;
+};
+
+// Replays |records| with |decoder|, adding the duration of each call to
+// |call_times|. Returns false if the decoder can't be created.
+bool Replay(const std::vector<SessionRecord>& records, bool paced,
+            ReplayDecoder* decoder, std::map<uint32_t, CallTimes>* call_times,
+            ReplayResult* result) {
+  const SessionRecord& init = records.front();
+  const int parameter_count = static_cast<int>(init.header.argument);
+  const size_t parameters_size = parameter_count * sizeof(int64_t);
+  if (parameter_count < 0 || init.data.size() < parameters_size) {
+    return false;
+  }
+  std::vector<int64_t> parameters(parameter_count);
+  if (parameter_count > 0) {
+    memcpy(parameters.data(), init.data.data(), parameters_size);
+  }
+  if (!decoder->Init(parameters.data(), parameter_count,
+                     init.data.data() + parameters_size,
+                     init.data.size() - parameters_size)) {
+    return false;
+  }
+
+  // Maps the ids of buffers output in surface mode in the recording to their
+  // ids in the replay.
+  std::map<int64_t, int> buffer_ids;
+  const int64_t start_time_ns = GetMonotonicTimeNs();
+  for (size_t i = 1; i < records.size(); i++) {
+    const session_format::RecordHeader& header = records[i].header;
+    if (paced) {
+      const int64_t delay_ns =
+          start_time_ns + header.time_ns - GetMonotonicTimeNs();
+      if (delay_ns > 0) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(delay_ns));
+      }
+    }
+    const int64_t call_start_time_ns = GetMonotonicTimeNs();
+    bool replayed = true;
+    int call_result = 0;
+    switch (header.type) {
+      case session_format::kRecordDecode:
+        call_result =
+            decoder->Decode(records[i].data.data(), records[i].data.size());
+        break;
+      case session_format::kRecordGetFrame: {
+        int buffer_id = -1;
+        call_result = decoder->GetFrame(header.flags, &buffer_id);
+        if (buffer_id != -1) {
+          buffer_ids[header.argument] = buffer_id;
+        }
+        break;
+      }
+      case session_format::kRecordReleaseFrame: {
+        const auto it = buffer_ids.find(header.argument);
+        if (it != buffer_ids.end()) {
+          decoder->ReleaseFrame(it->second);
+          buffer_ids.erase(it);
+        }
+        break;
+      }
+      case session_format::kRecordReset:
+      case session_format::kRecordFlush:
+        decoder->Reset(header.argument);
+        break;
+      case session_format::kRecordOutputMode:
+        decoder->SetOutputMode(header.argument);
+        break;
+      default:
+        replayed = false;
+        break;
+    }
+    const int64_t call_end_time_ns = GetMonotonicTimeNs();
+    if (!replayed) {
+      continue;
+    }
+    (*call_times)[header.type].replayed_ns.push_back(call_end_time_ns -
+                                                     call_start_time_ns);
+    if ((call_result < 0) != (header.result < 0)) {
+      result->mismatch_count++;
+    }
+    if (paced && i + 1 < records.size() &&
+        call_end_time_ns - start_time_ns > records[i + 1].header.time_ns) {
+      result->late_call_count++;
+    }
+  }
+  result->duration_ns = GetMonotonicTimeNs() - start_time_ns;
+  // Release buffers still held by the application at the end of the recording.
+  for (const auto& entry : buffer_ids) {
+    decoder->ReleaseFrame(entry.second);
+  }
+  return true;
+}
+
+bool ParseIntFlag(const char* arg, const char* name, int* value) {
+  const size_t length = strlen(name);
+  if (strncmp(arg, name, length) != 0 || arg[length] != '=') {
+    return false;
+  }
+  *value = atoi(arg + length + 1);
+  return true;
+}
+
+int Main(int argc, char** argv) {
+  bool paced = false;
+  int repeat = 1;
+  const char* path = nullptr;
+  bool valid_arguments = true;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--paced") == 0) {
+      paced = true;
+    } else if (ParseIntFlag(argv[i], "--repeat", &repeat)) {
+      continue;
+    } else if (argv[i][0] != '-' && !path) {
+      path = argv[i];
+    } else {
+      valid_arguments = false;
+    }
+  }
+  if (!valid_arguments || !path || repeat < 1) {
+    fprintf(stderr, "Usage: %s [--paced] [--repeat=N] RECORDING\n", argv[0]);
+    return 2;
+  }
+  InitCpuDispatch();
+
+  uint32_t codec;
+  std::vector<SessionRecord> records;
+  std::string error;
+  if (!ReadSession(path, &codec, &records, &error)) {
+    fprintf(stderr, "FAILED: %s\n", error.c_str());
+    return 1;
+  }
+  const char* codec_name = GetCodecName(codec);
+  if (!codec_name) {
+    fprintf(stderr, "FAILED: %s has unknown codec %" PRIu32 "\n", path, codec);
+    return 1;
+  }
+
+  std::map<uint32_t, CallTimes> call_times;
+  int64_t input_byte_count = 0;
+  for (const SessionRecord& record : records) {
+    if (!GetRecordTypeName(record.header.type)) {
+      fprintf(stderr, "FAILED: %s has unknown record type %" PRIu32 "\n", path,
+              record.header.type);
+      return 1;
+    }
+    if (record.header.type != session_format::kRecordInit &&
+        record.header.type != session_format::kRecordOutputMode) {
+      call_times[record.header.type].recorded_ns.push_back(
+          record.header.duration_ns);
+    }
+    if (record.header.type == session_format::kRecordDecode ||
+        record.header.type == session_format::kRecordRead) {
+      input_byte_count += record.data.size();
+    }
+  }
+  const int64_t recorded_duration_ns = records.back().header.time_ns +
+                                       records.back().header.duration_ns;
+  printf("%s: %s, %zu records over %.3f s, %" PRId64 " input bytes (%.1f "
+         "kbit/s)\n",
+         path, codec_name, records.size(), recorded_duration_ns / 1e9,
+         input_byte_count,
+         recorded_duration_ns > 0
+             ? input_byte_count * 8e6 / recorded_duration_ns
+             : 0.0);
+
+  std::unique_ptr<ReplayDecoder> decoder = CreateReplayDecoder(codec);
+  if (!decoder) {
+    printf("This build can't replay %s recordings, so only the recorded "
+           "timing is reported\n",
+           codec_name);
+  }
+  ReplayResult total;
+  for (int i = 0; decoder && i < repeat; i++) {
+    if (i > 0) {
+      decoder = CreateReplayDecoder(codec);
+    }
+    ReplayResult result;
+    if (!Replay(records, paced, decoder.get(), &call_times, &result)) {
+      fprintf(stderr, "FAILED: couldn't create a %s decoder with the recorded "
+              "parameters\n", codec_name);
+      return 1;
+    }
+    printf("replay %d: %.3f s, %d late calls, %d mismatched results\n", i + 1,
+           result.duration_ns / 1e9, result.late_call_count,
+           result.mismatch_count);
+    total.late_call_count += result.late_call_count;
+    total.mismatch_count += result.mismatch_count;
+  }
+
+  printf("%-12s %7s %11s %11s %11s %11s %11s %11s\n", "call", "count",
+         "rec_p50_us", "rec_p99_us", "rec_max_us", "p50_us", "p99_us",
+         "max_us");
+  for (auto& entry : call_times) {
+    CallTimes& times = entry.second;
+    printf("%-12s %7zu %11.1f %11.1f %11.1f", GetRecordTypeName(entry.first),
+           times.recorded_ns.size(), GetPercentileUs(&times.recorded_ns, 50),
+           GetPercentileUs(&times.recorded_ns, 99),
+           GetPercentileUs(&times.recorded_ns, 100));
+    if (times.replayed_ns.empty()) {
+      printf(" %11s %11s %11s\n", "-", "-", "-");
+    } else {
+      printf(" %11.1f %11.1f %11.1f\n", GetPercentileUs(&times.replayed_ns, 50),
+             GetPercentileUs(&times.replayed_ns, 99),
+             GetPercentileUs(&times.replayed_ns, 100));
+    }
+  }
+  if (decoder) {
+    int64_t snapshot[DecoderStats::kSnapshotLength];
+    decoder->stats()->Snapshot(snapshot);
+    printf("last replay: %" PRId64 " input buffers, %" PRId64 " output "
+           "buffers, %" PRId64 " output bytes, %" PRId64 " decode errors, "
+           "%" PRId64 " frame buffer allocations, peak %" PRId64 " frame "
+           "buffers in use\n",
+           snapshot[DecoderStats::kInputBufferCount],
+           snapshot[DecoderStats::kOutputBufferCount],
+           snapshot[DecoderStats::kOutputByteCount],
+           snapshot[DecoderStats::kDecodeErrorCount],
+           snapshot[DecoderStats::kFrameBufferAllocationCount],
+           snapshot[DecoderStats::kPeakFrameBuffersInUse]);
+  }
+  return 0;
+}
+
+}  // namespace
+}  // namespace exoplayer_jni
+
+int main(int argc, char** argv) { return exoplayer_jni::Main(argc, argv); }
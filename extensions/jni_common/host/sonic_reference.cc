@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sonic_reference.h"  // NOLINT
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace exoplayer_jni {
+namespace {
+
+const int kMinimumPitch = 65;
+const int kMaximumPitch = 400;
+const int kAmdfFrequency = 4000;
+
+}  // namespace
+
+SonicReference::SonicReference(int sample_rate, int channel_count,
+                               float speed)
+    : sample_rate_(sample_rate),
+      channel_count_(channel_count),
+      speed_(speed),
+      min_period_(sample_rate / kMaximumPitch),
+      max_period_(sample_rate / kMinimumPitch),
+      max_required_frame_count_(2 * max_period_),
+      down_sample_buffer_(max_required_frame_count_),
+      remaining_input_to_copy_frame_count_(0),
+      prev_period_(0),
+      prev_min_diff_(0),
+      min_diff_(0),
+      max_diff_(0) {}
+
+void SonicReference::Process(const int16_t* input, int frame_count,
+                             std::vector<int16_t>* output) {
+  input_.insert(input_.end(), input, input + frame_count * channel_count_);
+  const int input_frame_count = static_cast<int>(input_.size()) /
+                                channel_count_;
+  if (input_frame_count < max_required_frame_count_) {
+    return;
+  }
+  int position = 0;
+  do {
+    if (remaining_input_to_copy_frame_count_ > 0) {
+      const int copy_frame_count = std::min(
+          max_required_frame_count_, remaining_input_to_copy_frame_count_);
+      output->insert(output->end(), &input_[position * channel_count_],
+                     &input_[(position + copy_frame_count) * channel_count_]);
+      remaining_input_to_copy_frame_count_ -= copy_frame_count;
+      position += copy_frame_count;
+    } else {
+      const int period = FindPitchPeriod(position);
+      if (speed_ > 1.0f) {
+        position += period + SkipPitchPeriod(position, period, output);
+      } else {
+        position += InsertPitchPeriod(position, period, output);
+      }
+    }
+  } while (position + max_required_frame_count_ <= input_frame_count);
+  input_.erase(input_.begin(), input_.begin() + position * channel_count_);
+}
+
+void SonicReference::DownSampleInput(int position, int skip) {
+  const int frame_count = max_required_frame_count_ / skip;
+  const int samples_per_value = channel_count_ * skip;
+  const int16_t* samples = &input_[position * channel_count_];
+  for (int i = 0; i < frame_count; i++) {
+    int value = 0;
+    for (int j = 0; j < samples_per_value; j++) {
+      value += samples[i * samples_per_value + j];
+    }
+    down_sample_buffer_[i] = static_cast<int16_t>(value / samples_per_value);
+  }
+}
+
+int SonicReference::FindPitchPeriodInRange(const int16_t* samples,
+                                           int position, int channel_count,
+                                           int min_period, int max_period) {
+  int best_period = 0;
+  int worst_period = 255;
+  int min_diff = 1;
+  int max_diff = 0;
+  samples += position * channel_count;
+  for (int period = min_period; period <= max_period; period++) {
+    int diff = 0;
+    for (int i = 0; i < period; i++) {
+      diff += std::abs(samples[i] - samples[period + i]);
+    }
+    if (diff * best_period < min_diff * period) {
+      min_diff = diff;
+      best_period = period;
+    }
+    if (diff * worst_period > max_diff * period) {
+      max_diff = diff;
+      worst_period = period;
+    }
+  }
+  min_diff_ = min_diff / best_period;
+  max_diff_ = max_diff / worst_period;
+  return best_period;
+}
+
+bool SonicReference::PreviousPeriodBetter(int min_diff, int max_diff) const {
+  if (min_diff == 0 || prev_period_ == 0) {
+    return false;
+  }
+  if (max_diff > min_diff * 3) {
+    return false;
+  }
+  if (min_diff * 2 <= prev_min_diff_ * 3) {
+    return false;
+  }
+  return true;
+}
+
+int SonicReference::FindPitchPeriod(int position) {
+  const int skip =
+      sample_rate_ > kAmdfFrequency ? sample_rate_ / kAmdfFrequency : 1;
+  int period;
+  if (channel_count_ == 1 && skip == 1) {
+    period = FindPitchPeriodInRange(input_.data(), position, channel_count_,
+                                    min_period_, max_period_);
+  } else {
+    DownSampleInput(position, skip);
+    period = FindPitchPeriodInRange(down_sample_buffer_.data(), 0,
+                                    /*channel_count=*/1, min_period_ / skip,
+                                    max_period_ / skip);
+    if (skip != 1) {
+      period *= skip;
+      const int min_p = std::max(min_period_, period - skip * 4);
+      const int max_p = std::min(max_period_, period + skip * 4);
+      if (channel_count_ == 1) {
+        period = FindPitchPeriodInRange(input_.data(), position,
+                                        channel_count_, min_p, max_p);
+      } else {
+        DownSampleInput(position, 1);
+        period = FindPitchPeriodInRange(down_sample_buffer_.data(), 0,
+                                        /*channel_count=*/1, min_p, max_p);
+      }
+    }
+  }
+  const int result =
+      PreviousPeriodBetter(min_diff_, max_diff_) ? prev_period_ : period;
+  prev_min_diff_ = min_diff_;
+  prev_period_ = period;
+  return result;
+}
+
+int SonicReference::SkipPitchPeriod(int position, int period,
+                                    std::vector<int16_t>* output) {
+  int new_frame_count;
+  if (speed_ >= 2.0f) {
+    new_frame_count = static_cast<int>(period / (speed_ - 1.0f));
+  } else {
+    new_frame_count = period;
+    remaining_input_to_copy_frame_count_ =
+        static_cast<int>(period * (2.0f - speed_) / (speed_ - 1.0f));
+  }
+  const size_t output_size = output->size();
+  output->resize(output_size + new_frame_count * channel_count_);
+  OverlapAdd(new_frame_count, output->data() + output_size,
+             &input_[position * channel_count_],
+             &input_[(position + period) * channel_count_]);
+  return new_frame_count;
+}
+
+int SonicReference::InsertPitchPeriod(int position, int period,
+                                      std::vector<int16_t>* output) {
+  int new_frame_count;
+  if (speed_ < 0.5f) {
+    new_frame_count = static_cast<int>(period * speed_ / (1.0f - speed_));
+  } else {
+    new_frame_count = period;
+    remaining_input_to_copy_frame_count_ =
+        static_cast<int>(period * (2.0f * speed_ - 1.0f) / (1.0f - speed_));
+  }
+  output->insert(output->end(), &input_[position * channel_count_],
+                 &input_[(position + period) * channel_count_]);
+  const size_t output_size = output->size();
+  output->resize(output_size + new_frame_count * channel_count_);
+  OverlapAdd(new_frame_count, output->data() + output_size,
+             &input_[(position + period) * channel_count_],
+             &input_[position * channel_count_]);
+  return new_frame_count;
+}
+
+void SonicReference::OverlapAdd(int frame_count, int16_t* out,
+                                const int16_t* ramp_down,
+                                const int16_t* ramp_up) const {
+  for (int c = 0; c < channel_count_; c++) {
+    for (int t = 0; t < frame_count; t++) {
+      const int index = t * channel_count_ + c;
+      out[index] = static_cast<int16_t>(
+          (ramp_down[index] * (frame_count - t) + ramp_up[index] * t) /
+          frame_count);
+    }
+  }
+}
+
+}  // namespace exoplayer_jni
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_HOST_SONIC_REFERENCE_H_
+#define EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_HOST_SONIC_REFERENCE_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace exoplayer_jni {
+
+// A transcription of the speed change in library/core's Sonic.java, which is
+// what SonicAudioProcessor runs when the playback speed isn't 1, so that the
+// native TimeStretcher can be compared with it on the host. Only the speed is
+// supported, not the pitch or the sample rate.
+class SonicReference {
+ public:
+  SonicReference(int sample_rate, int channel_count, float speed);
+
+  // Queues |frame_count| interleaved input frames, and appends the output that
+  // can be produced to |output|.
+  void Process(const int16_t* input, int frame_count,
+               std::vector<int16_t>* output);
+
+ private:
+  void DownSampleInput(int position, int skip);
+  int FindPitchPeriodInRange(const int16_t* samples, int position,
+                             int channel_count, int min_period,
+                             int max_period);
+  bool PreviousPeriodBetter(int min_diff, int max_diff) const;
+  int FindPitchPeriod(int position);
+  int SkipPitchPeriod(int position, int period, std::vector<int16_t>* output);
+  int InsertPitchPeriod(int position, int period,
+                        std::vector<int16_t>* output);
+  void OverlapAdd(int frame_count, int16_t* out, const int16_t* ramp_down,
+                  const int16_t* ramp_up) const;
+
+  const int sample_rate_;
+  const int channel_count_;
+  const float speed_;
+  const int min_period_;
+  const int max_period_;
+  const int max_required_frame_count_;
+
+  std::vector<int16_t> input_;
+  std::vector<int16_t> down_sample_buffer_;
+  int remaining_input_to_copy_frame_count_;
+  int prev_period_;
+  int prev_min_diff_;
+  int min_diff_;
+  int max_diff_;
+};
+
+}  // namespace exoplayer_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_HOST_SONIC_REFERENCE_H_
@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks the RealFft against a direct DFT, checks that the SpectrumAnalyzer
+// puts a full scale sine wave at 0 dB in the band that contains it, and checks
+// that the AudioChain's spectrum tap analyzes decoded audio without changing
+// it.
+//
+// Usage: spectrum_analyzer_test
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "audio_chain.h"        // NOLINT
+#include "cpu_dispatch.h"       // NOLINT
+#include "fft.h"                // NOLINT
+#include "spectrum_analyzer.h"  // NOLINT
+
+namespace exoplayer_jni {
+namespace {
+
+const double kPi = 3.14159265358979323846;
+const int kSampleRate = 48000;
+const int kFftSize = 2048;
+const int kBandCount = 32;
+// A sine wave at the frequency of bin 43, about 1008 Hz.
+const int kSineBin = 43;
+// The tolerance of the FFT's power, relative to the largest power.
+const double kMaxPowerError = 1e-5;
+// The tolerance of the sine wave's band level.
+const double kMaxLevelErrorDb = 0.05;
+// The highest level of bands an octave or more from the sine wave.
+const double kMaxLeakageDb = -60;
+
+// Returns |frame_count| stereo frames of a full scale sine wave at bin
+// kSineBin, in both channels.
+std::vector<float> CreateSine(int frame_count) {
+  std::vector<float> samples(frame_count * 2);
+  for (int i = 0; i < frame_count; i++) {
+    const float sample =
+        static_cast<float>(std::sin(2 * kPi * kSineBin * i / kFftSize));
+    samples[2 * i] = sample;
+    samples[2 * i + 1] = sample;
+  }
+  return samples;
+}
+
+// Returns the index of the band that contains |frequency|, as SpectrumAnalyzer
+// spaces its bands.
+int GetBand(double frequency) {
+  const double ratio = kSampleRate / 2.0 / SpectrumAnalyzer::kMinFrequencyHz;
+  return static_cast<int>(
+      std::log(frequency / SpectrumAnalyzer::kMinFrequencyHz) /
+      std::log(ratio) * kBandCount);
+}
+
+bool TestFft(std::string* error) {
+  const int kSizes[] = {RealFft::kMinSize, 64, 1024, RealFft::kMaxSize};
+  for (int size : kSizes) {
+    std::vector<float> samples(size);
+    uint32_t state = size;
+    for (int i = 0; i < size; i++) {
+      state = state * 1664525 + 1013904223;
+      samples[i] = static_cast<int32_t>(state) / 2147483648.0f;
+    }
+    RealFft fft;
+    if (!fft.Configure(size)) {
+      *error = "failed to configure FFT of size " + std::to_string(size);
+      return false;
+    }
+    std::vector<float> power(size / 2 + 1);
+    fft.ComputePowerSpectrum(samples.data(), power.data());
+    // Only checks some bins of the largest size, to keep the DFT fast.
+    const int step = size > 1024 ? 97 : 1;
+    std::vector<double> expected_power;
+    double max_power = 0;
+    for (int k = 0; k <= size / 2; k += step) {
+      double real = 0;
+      double imag = 0;
+      for (int i = 0; i < size; i++) {
+        const double angle = -2 * kPi * k * i / size;
+        real += samples[i] * std::cos(angle);
+        imag += samples[i] * std::sin(angle);
+      }
+      expected_power.push_back(real * real + imag * imag);
+      max_power = std::max(max_power, expected_power.back());
+    }
+    for (size_t j = 0; j < expected_power.size(); j++) {
+      const int k = static_cast<int>(j) * step;
+      if (std::fabs(power[k] - expected_power[j]) >
+          kMaxPowerError * max_power) {
+        char message[128];
+        snprintf(message, sizeof(message),
+                 "FFT of size %d bin %d has power %g, expected %g", size, k,
+                 power[k], expected_power[j]);
+        *error = message;
+        return false;
+      }
+    }
+  }
+  RealFft fft;
+  if (fft.Configure(RealFft::kMinSize / 2) ||
+      fft.Configure(RealFft::kMaxSize * 2) || fft.Configure(1000)) {
+    *error = "FFT configured with an invalid size";
+    return false;
+  }
+  return true;
+}
+
+// Checks that |bands| have the sine wave's level in its band and little
+// leakage an octave or more away from it.
+bool CheckSineBands(const char* name, const std::vector<float>& bands,
+                    std::string* error) {
+  const double sine_frequency =
+      static_cast<double>(kSineBin) * kSampleRate / kFftSize;
+  const int sine_band = GetBand(sine_frequency);
+  const int low_band = GetBand(sine_frequency / 2);
+  const int high_band = GetBand(sine_frequency * 2);
+  for (int b = 0; b < kBandCount; b++) {
+    const bool failed =
+        b == sine_band ? std::fabs(bands[b]) > kMaxLevelErrorDb
+                       : (b <= low_band || b >= high_band) &&
+                             bands[b] > kMaxLeakageDb;
+    if (failed) {
+      char message[128];
+      snprintf(message, sizeof(message),
+               "%s band %d has level %.2f dB, sine wave is in band %d", name,
+               b, bands[b], sine_band);
+      *error = message;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool TestSine(std::string* error) {
+  SpectrumAnalyzer analyzer;
+  std::vector<float> bands(kBandCount);
+  if (analyzer.ComputeBands(bands.data(), kBandCount)) {
+    *error = "spectrum computed before the analyzer was configured";
+    return false;
+  }
+  if (!analyzer.Configure(/* channel_count= */ 2, kSampleRate, kFftSize)) {
+    *error = "failed to configure analyzer";
+    return false;
+  }
+  const std::vector<float> samples = CreateSine(kFftSize * 2);
+  analyzer.Add(samples.data(), kFftSize - 1);
+  if (analyzer.ComputeBands(bands.data(), kBandCount)) {
+    *error = "spectrum computed from fewer frames than the FFT size";
+    return false;
+  }
+  // Adds the rest in a call that wraps around the ring buffer.
+  analyzer.Add(samples.data() + (kFftSize - 1) * 2, kFftSize + 1);
+  if (!analyzer.ComputeBands(bands.data(), kBandCount) ||
+      !CheckSineBands("analyzer", bands, error)) {
+    if (error->empty()) {
+      *error = "failed to compute spectrum";
+    }
+    return false;
+  }
+  analyzer.Reset();
+  if (analyzer.ComputeBands(bands.data(), kBandCount)) {
+    *error = "spectrum computed after reset";
+    return false;
+  }
+  return true;
+}
+
+bool TestAudioChain(std::string* error) {
+  AudioChainConfig config;
+  config.spectrum_fft_size = kFftSize;
+  AudioChain chain;
+  chain.SetConfig(config);
+  if (!chain.Configure(/* channel_count= */ 2, kSampleRate,
+                       kPcmEncodingFloat) ||
+      chain.IsPassthrough()) {
+    *error = "spectrum tap configuration failed or is passthrough";
+    return false;
+  }
+  const std::vector<float> samples = CreateSine(kFftSize);
+  std::vector<float> output(chain.GetMaxOutputSize(kFftSize) / sizeof(float));
+  const int output_size =
+      chain.Process(samples.data(), kFftSize, output.data(),
+                    output.size() * sizeof(float));
+  if (output_size != static_cast<int>(samples.size() * sizeof(float)) ||
+      !std::equal(samples.begin(), samples.end(), output.begin())) {
+    *error = "the spectrum tap changed the audio";
+    return false;
+  }
+  std::vector<float> bands(kBandCount);
+  if (!chain.spectrum()->ComputeBands(bands.data(), kBandCount)) {
+    *error = "failed to compute the chain's spectrum";
+    return false;
+  }
+  return CheckSineBands("audio chain", bands, error);
+}
+
+int Main(int argc, char** argv) {
+  if (argc != 1) {
+    fprintf(stderr, "Usage: %s\n", argv[0]);
+    return 2;
+  }
+  InitCpuDispatch();
+  std::string error;
+  const bool passed =
+      TestFft(&error) && TestSine(&error) && TestAudioChain(&error);
+  if (!passed) {
+    fprintf(stderr, "FAILED: %s\n", error.c_str());
+    return 1;
+  }
+  printf("PASSED\n");
+  return 0;
+}
+
+}  // namespace
+}  // namespace exoplayer_jni
+
+int main(int argc, char** argv) { return exoplayer_jni::Main(argc, argv); }
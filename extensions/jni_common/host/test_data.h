@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_HOST_TEST_DATA_H_
+#define EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_HOST_TEST_DATA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace exoplayer_jni {
+
+// The initial value of a checksum.
+const uint64_t kChecksumInit = UINT64_C(0xcbf29ce484222325);
+
+// Returns |hash| updated with |size| bytes of |data|.
+inline uint64_t Checksum(const uint8_t* data, size_t size, uint64_t hash) {
+  // 64-bit FNV-1a.
+  for (size_t i = 0; i < size; i++) {
+    hash ^= data[i];
+    hash *= UINT64_C(0x100000001b3);
+  }
+  return hash;
+}
+
+// Generates deterministic pseudo-random numbers.
+class Random {
+ public:
+  explicit Random(uint32_t seed) : state_(seed) {}
+
+  uint32_t Next() {
+    state_ = state_ * 1664525 + 1013904223;
+    return state_ >> 8;
+  }
+
+ private:
+  uint32_t state_;
+};
+
+// A plane of samples with |stride| bytes per row.
+struct Plane {
+  int width;
+  int height;
+  int stride;
+  std::vector<uint8_t> data;
+
+  Plane(int width, int height, int bytes_per_sample, int stride_alignment)
+      : width(width),
+        height(height),
+        stride((width * bytes_per_sample + stride_alignment - 1) /
+               stride_alignment * stride_alignment),
+        data(static_cast<size_t>(stride) * height) {}
+
+  uint8_t* Row(int y) { return data.data() + static_cast<size_t>(y) * stride; }
+  const uint8_t* Row(int y) const {
+    return data.data() + static_cast<size_t>(y) * stride;
+  }
+
+  // Returns the checksum of the samples, not including padding.
+  uint64_t Checksum(int bytes_per_sample) const {
+    uint64_t hash = kChecksumInit;
+    for (int y = 0; y < height; y++) {
+      hash = exoplayer_jni::Checksum(Row(y), width * bytes_per_sample, hash);
+    }
+    return hash;
+  }
+};
+
+}  // namespace exoplayer_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_HOST_TEST_DATA_H_
@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Benchmarks the AudioChain's TimeStretcher against SonicReference, a C++
+// transcription of the Sonic code that SonicAudioProcessor runs in Java when
+// the playback speed isn't 1. Besides the throughput, each benchmark reports
+// the quality of stretching two seconds of a harmonic tone: the duration error
+// in ms, the pitch error in cents, and the envelope ripple in dB.
+
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "audio_quality.h"    // NOLINT
+#include "cpu_dispatch.h"     // NOLINT
+#include "perf_counters.h"    // NOLINT
+#include "sonic_reference.h"  // NOLINT
+#include "time_stretcher.h"   // NOLINT
+
+namespace exoplayer_jni {
+namespace {
+
+const int kSampleRate = 48000;
+// The number of frames in 20 ms of Opus.
+const int kBlockFrameCount = kSampleRate / 50;
+// The period of the test tone isn't a whole number of frames, so segments can't
+// be aligned exactly.
+const double kFrequency = 220;
+// 50 ms, which is a whole number of periods of the test tone.
+const int kRippleWindowFrameCount = kSampleRate / 20;
+
+// Adds speed, as a percentage, and channel count arguments.
+void TimeStretchArguments(benchmark::internal::Benchmark* benchmark) {
+  for (int speed : {50, 80, 125, 150, 200}) {
+    for (int channel_count : {1, 2, 6}) {
+      benchmark->Args({speed, channel_count});
+    }
+  }
+  benchmark->ArgNames({"speed", "channels"});
+}
+
+// Sets the quality counters of |state| for |output|, which is a tone of
+// kFrequency stretched from |input_frame_count| frames at |speed|.
+void SetQualityCounters(benchmark::State& state,
+                        const std::vector<float>& output, int channel_count,
+                        int input_frame_count, double speed) {
+  const int frame_count = static_cast<int>(output.size()) / channel_count;
+  const double expected_frame_count = input_frame_count / speed;
+  state.counters["duration_error_ms"] =
+      (frame_count - expected_frame_count) * 1000 / kSampleRate;
+  // Skip the start, where the output fades in.
+  const int skip_frame_count = 2 * kRippleWindowFrameCount;
+  const float* samples = &output[skip_frame_count * channel_count];
+  state.counters["pitch_error_cents"] =
+      GetCents(EstimateFrequency(samples, channel_count,
+                                 frame_count - skip_frame_count, kSampleRate),
+               kFrequency);
+  state.counters["ripple_db"] =
+      GetEnvelopeRippleDb(samples, channel_count,
+                          frame_count - skip_frame_count,
+                          kRippleWindowFrameCount);
+}
+
+// Stretches one block per iteration with the TimeStretcher, as the AudioChain
+// does when the speed isn't 1.
+void BM_TimeStretch(benchmark::State& state) {
+  InitCpuDispatch();
+  const double speed = state.range(0) / 100.0;
+  const int channel_count = static_cast<int>(state.range(1));
+  const int frame_count = 2 * kSampleRate;
+  const std::vector<float> input =
+      HarmonicTone(frame_count, channel_count, kSampleRate, kFrequency);
+  TimeStretcher stretcher;
+  stretcher.Configure(channel_count, kSampleRate, 1 / speed);
+  std::vector<float> output(
+      static_cast<size_t>(stretcher.GetMaxOutputFrameCount(frame_count)) *
+      channel_count);
+  output.resize(stretcher.Process(input.data(), frame_count, output.data()) *
+                channel_count);
+  SetQualityCounters(state, output, channel_count, frame_count, speed);
+
+  stretcher.Reset();
+  const int block_count = frame_count / kBlockFrameCount;
+  int block = 0;
+  {
+    ScopedBenchmarkPerfCounters perf_counters(
+        &state, kBlockFrameCount * channel_count * sizeof(float));
+    for (auto _ : state) {
+      const int frames = stretcher.Process(
+          &input[static_cast<size_t>(block) * kBlockFrameCount *
+                 channel_count],
+          kBlockFrameCount, output.data());
+      benchmark::DoNotOptimize(frames);
+      benchmark::ClobberMemory();
+      block = (block + 1) % block_count;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kBlockFrameCount);
+}
+BENCHMARK(BM_TimeStretch)->Apply(TimeStretchArguments);
+
+// Stretches one block per iteration with SonicReference, on 16-bit samples as
+// SonicAudioProcessor does.
+void BM_SonicReference(benchmark::State& state) {
+  const double speed = state.range(0) / 100.0;
+  const int channel_count = static_cast<int>(state.range(1));
+  const int frame_count = 2 * kSampleRate;
+  const std::vector<float> tone =
+      HarmonicTone(frame_count, channel_count, kSampleRate, kFrequency);
+  std::vector<int16_t> input(tone.size());
+  for (size_t i = 0; i < tone.size(); i++) {
+    input[i] = static_cast<int16_t>(lrint(tone[i] * 32767));
+  }
+  std::vector<int16_t> output;
+  {
+    SonicReference sonic(kSampleRate, channel_count,
+                         static_cast<float>(speed));
+    sonic.Process(input.data(), frame_count, &output);
+    std::vector<float> float_output(output.size());
+    for (size_t i = 0; i < output.size(); i++) {
+      float_output[i] = output[i] / 32767.0f;
+    }
+    SetQualityCounters(state, float_output, channel_count, frame_count,
+                       speed);
+  }
+
+  SonicReference sonic(kSampleRate, channel_count, static_cast<float>(speed));
+  const int block_count = frame_count / kBlockFrameCount;
+  int block = 0;
+  {
+    ScopedBenchmarkPerfCounters perf_counters(
+        &state, kBlockFrameCount * channel_count * sizeof(int16_t));
+    for (auto _ : state) {
+      output.clear();
+      sonic.Process(&input[static_cast<size_t>(block) * kBlockFrameCount *
+                           channel_count],
+                    kBlockFrameCount, &output);
+      benchmark::ClobberMemory();
+      block = (block + 1) % block_count;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kBlockFrameCount);
+}
+BENCHMARK(BM_SonicReference)->Apply(TimeStretchArguments);
+
+}  // namespace
+}  // namespace exoplayer_jni
@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks the TimeStretcher that the AudioChain uses to change the speed and
+// pitch: that stretched audio has the expected duration, keeps its pitch and
+// has a steady envelope, that pitch shifting through the AudioChain changes
+// the pitch but not the duration, and that the output never exceeds
+// GetMaxOutputFrameCount() however the input is split.
+//
+// Usage: time_stretcher_test
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "audio_chain.h"     // NOLINT
+#include "audio_quality.h"   // NOLINT
+#include "cpu_dispatch.h"    // NOLINT
+#include "test_data.h"       // NOLINT
+#include "time_stretcher.h"  // NOLINT
+
+namespace exoplayer_jni {
+namespace {
+
+const int kSampleRate = 48000;
+// The period of the test tone isn't a whole number of frames, so segments can't
+// be aligned exactly.
+const double kFrequency = 220;
+// 50 ms, which is a whole number of periods of the test tones.
+const int kRippleWindowFrameCount = kSampleRate / 20;
+
+// Stretches |input| in calls of pseudo-random sizes, checking that each call's
+// output fits in GetMaxOutputFrameCount(). Returns false on failure.
+bool Stretch(TimeStretcher* stretcher, const std::vector<float>& input,
+             int channel_count, uint32_t seed, std::vector<float>* output,
+             std::string* error) {
+  const int frame_count = static_cast<int>(input.size()) / channel_count;
+  Random random(seed);
+  output->clear();
+  for (int first_frame = 0; first_frame < frame_count;) {
+    const int call_frames = std::min(
+        1 + static_cast<int>(random.Next() % 2048), frame_count - first_frame);
+    const int max_frames = stretcher->GetMaxOutputFrameCount(call_frames);
+    std::vector<float> call_output(
+        static_cast<size_t>(max_frames + 1) * channel_count, 12345.0f);
+    const int frames = stretcher->Process(
+        &input[static_cast<size_t>(first_frame) * channel_count], call_frames,
+        call_output.data());
+    if (frames > max_frames ||
+        call_output[static_cast<size_t>(max_frames) * channel_count] !=
+            12345.0f) {
+      *error = "processing " + std::to_string(call_frames) + " frames output " +
+               std::to_string(frames) + ", over the maximum of " +
+               std::to_string(max_frames);
+      return false;
+    }
+    output->insert(output->end(), call_output.begin(),
+                   call_output.begin() + frames * channel_count);
+    first_frame += call_frames;
+  }
+  return true;
+}
+
+// Checks the duration, pitch and envelope of |output| for a tone of
+// |frequency| that was stretched by |factor|. Up to two and a half hops of
+// input may be held back, which is |factor| times as much output.
+bool CheckStretchedTone(const std::vector<float>& output, int channel_count,
+                        int input_frame_count, double factor, double frequency,
+                        std::string* error) {
+  const std::string name = "factor " + std::to_string(factor) + ": ";
+  const int output_frame_count =
+      static_cast<int>(output.size()) / channel_count;
+  const int expected_frame_count =
+      static_cast<int>(input_frame_count * factor);
+  const int hop = TimeStretcher::GetHopFrameCount(kSampleRate);
+  const int max_lag_frame_count =
+      static_cast<int>(2.5 * hop * std::max(1.0, factor)) + hop;
+  if (output_frame_count > expected_frame_count + hop ||
+      output_frame_count < expected_frame_count - max_lag_frame_count) {
+    *error = name + "output " + std::to_string(output_frame_count) +
+             " frames, expected " + std::to_string(expected_frame_count);
+    return false;
+  }
+  // Skip the start, where the first segment fades in from silence.
+  const int skip_frame_count = 2 * kRippleWindowFrameCount;
+  const float* samples = &output[skip_frame_count * channel_count];
+  const int frame_count = output_frame_count - skip_frame_count;
+  for (int c = 0; c < channel_count; c++) {
+    const double output_frequency =
+        EstimateFrequency(samples + c, channel_count, frame_count, kSampleRate);
+    const double cents = GetCents(output_frequency, frequency);
+    if (std::fabs(cents) > 5) {
+      *error = name + "channel " + std::to_string(c) + " has a frequency of " +
+               std::to_string(output_frequency) + " Hz, expected " +
+               std::to_string(frequency) + " Hz";
+      return false;
+    }
+  }
+  const double ripple = GetEnvelopeRippleDb(samples, channel_count,
+                                            frame_count,
+                                            kRippleWindowFrameCount);
+  if (ripple > 1) {
+    *error = name + "envelope ripple is " + std::to_string(ripple) + " dB";
+    return false;
+  }
+  return true;
+}
+
+bool TestStretchedTone(std::string* error) {
+  const int channel_count = 2;
+  const int frame_count = 2 * kSampleRate;
+  const std::vector<float> input =
+      HarmonicTone(frame_count, channel_count, kSampleRate, kFrequency);
+  for (double factor : {0.5, 0.8, 1.0 / 1.5, 1.25, 2.0}) {
+    TimeStretcher stretcher;
+    if (!stretcher.Configure(channel_count, kSampleRate, factor)) {
+      *error = "Configure with factor " + std::to_string(factor) + " failed";
+      return false;
+    }
+    std::vector<float> output;
+    if (!Stretch(&stretcher, input, channel_count, /* seed= */ 1, &output,
+                 error) ||
+        !CheckStretchedTone(output, channel_count, frame_count, factor,
+                            kFrequency, error)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool TestPitchShift(std::string* error) {
+  const int frame_count = 2 * kSampleRate;
+  const std::vector<float> input =
+      HarmonicTone(frame_count, 1, kSampleRate, kFrequency);
+  AudioChainConfig config;
+  config.pitch = 1.5f;
+  AudioChain chain;
+  chain.SetConfig(config);
+  if (!chain.Configure(1, kSampleRate, kPcmEncodingFloat)) {
+    *error = "Configure with pitch 1.5 failed";
+    return false;
+  }
+  std::vector<float> output(chain.GetMaxOutputSize(frame_count) /
+                            sizeof(float));
+  const int size = chain.Process(input.data(), frame_count, output.data(),
+                                 output.size() * sizeof(float));
+  if (size < 0) {
+    *error = "processing with pitch 1.5 failed";
+    return false;
+  }
+  output.resize(size / sizeof(float));
+  // The duration is unchanged, and the frequency is multiplied by the pitch.
+  return CheckStretchedTone(output, 1, frame_count, /* factor= */ 1,
+                            kFrequency * config.pitch, error);
+}
+
+bool TestSilence(std::string* error) {
+  const int channel_count = 6;
+  const int frame_count = kSampleRate / 2;
+  const std::vector<float> input(frame_count * channel_count);
+  TimeStretcher stretcher;
+  stretcher.Configure(channel_count, kSampleRate, 0.75);
+  std::vector<float> output;
+  if (!Stretch(&stretcher, input, channel_count, /* seed= */ 2, &output,
+               error)) {
+    return false;
+  }
+  for (float sample : output) {
+    if (sample != 0) {
+      *error = "stretched silence has a sample of " + std::to_string(sample);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool TestReset(std::string* error) {
+  const int channel_count = 2;
+  const int frame_count = kSampleRate / 2;
+  const std::vector<float> input =
+      HarmonicTone(frame_count, channel_count, kSampleRate, kFrequency);
+  TimeStretcher stretcher;
+  stretcher.Configure(channel_count, kSampleRate, 1.3);
+  std::vector<float> first_output;
+  std::vector<float> second_output;
+  if (!Stretch(&stretcher, input, channel_count, /* seed= */ 3, &first_output,
+               error)) {
+    return false;
+  }
+  stretcher.Reset();
+  if (!Stretch(&stretcher, input, channel_count, /* seed= */ 3, &second_output,
+               error)) {
+    return false;
+  }
+  if (first_output != second_output) {
+    *error = "output after Reset() doesn't match the first output";
+    return false;
+  }
+  return true;
+}
+
+int Main(int argc, char** argv) {
+  if (argc != 1) {
+    fprintf(stderr, "Usage: %s\n", argv[0]);
+    return 2;
+  }
+  InitCpuDispatch();
+  std::string error;
+  const bool passed = TestStretchedTone(&error) && TestPitchShift(&error) &&
+                      TestSilence(&error) && TestReset(&error);
+  if (!passed) {
+    fprintf(stderr, "FAILED: %s\n", error.c_str());
+    return 1;
+  }
+  printf("PASSED\n");
+  return 0;
+}
+
+}  // namespace
+}  // namespace exoplayer_jni
+
+int main(int argc, char** argv) { return exoplayer_jni::Main(argc, argv); }
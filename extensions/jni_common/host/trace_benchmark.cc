@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compiled with EXOPLAYER_JNI_TRACING. Run with EXOPLAYER_TRACE_FILE set to
+// measure the cost of recording sections, and without it to measure the cost
+// of sections that are compiled in but not being recorded.
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include "trace.h"            // NOLINT
+#include "trace_benchmark.h"  // NOLINT
+
+namespace exoplayer_jni {
+namespace {
+
+void BM_TraceSectionNotRecording(benchmark::State& state) {
+  if (IsTracingEnabled()) {
+    state.SkipWithError("EXOPLAYER_TRACE_FILE is set");
+    return;
+  }
+  std::vector<uint8_t> data(kTraceBenchmarkWorkSize, 1);
+  for (auto _ : state) {
+    EXO_TRACE_SCOPE("benchmark:work");
+    benchmark::DoNotOptimize(TraceBenchmarkWork(data.data()));
+  }
+}
+BENCHMARK(BM_TraceSectionNotRecording);
+
+void BM_TraceSectionRecording(benchmark::State& state) {
+  if (!IsTracingEnabled()) {
+    state.SkipWithError("EXOPLAYER_TRACE_FILE is not set");
+    return;
+  }
+  std::vector<uint8_t> data(kTraceBenchmarkWorkSize, 1);
+  for (auto _ : state) {
+    EXO_TRACE_SCOPE("benchmark:work");
+    benchmark::DoNotOptimize(TraceBenchmarkWork(data.data()));
+  }
+}
+// Recorded sections are kept in memory until the trace is written, so the
+// number of iterations is bounded.
+BENCHMARK(BM_TraceSectionRecording)->Iterations(100000);
+
+}  // namespace
+}  // namespace exoplayer_jni
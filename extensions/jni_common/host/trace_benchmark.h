@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_HOST_TRACE_BENCHMARK_H_
+#define EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_HOST_TRACE_BENCHMARK_H_
+
+#include <cstdint>
+
+namespace exoplayer_jni {
+
+// Size of the buffer processed by each traced section in the benchmarks.
+constexpr int kTraceBenchmarkWorkSize = 256;
+
+// Stands in for a short hot path, such as a single row conversion, so that the
+// cost of a trace section can be compared to the work it would surround.
+inline uint32_t TraceBenchmarkWork(const uint8_t* data) {
+  uint32_t sum = 0;
+  for (int i = 0; i < kTraceBenchmarkWorkSize; i++) {
+    sum = sum * 31 + data[i];
+  }
+  return sum;
+}
+
+}  // namespace exoplayer_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_HOST_TRACE_BENCHMARK_H_
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compiled without EXOPLAYER_JNI_TRACING, unlike trace_benchmark.cc.
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include "trace.h"            // NOLINT
+#include "trace_benchmark.h"  // NOLINT
+
+namespace exoplayer_jni {
+namespace {
+
+void BM_NoTraceSection(benchmark::State& state) {
+  std::vector<uint8_t> data(kTraceBenchmarkWorkSize, 1);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(TraceBenchmarkWork(data.data()));
+  }
+}
+BENCHMARK(BM_NoTraceSection);
+
+void BM_TraceSectionCompiledOut(benchmark::State& state) {
+  std::vector<uint8_t> data(kTraceBenchmarkWorkSize, 1);
+  for (auto _ : state) {
+    EXO_TRACE_SCOPE("benchmark:work");
+    benchmark::DoNotOptimize(TraceBenchmarkWork(data.data()));
+  }
+}
+BENCHMARK(BM_TraceSectionCompiledOut);
+
+}  // namespace
+}  // namespace exoplayer_jni
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks the waveform peaks that the WaveformBuilder reduces audio to against
+// a direct computation, checks that reducing a stream in ranges from earlier
+// seek points gives the same peaks as reducing it whole, and checks that the
+// AudioChain reduces decoded audio to peaks without outputting it.
+//
+// Usage: waveform_builder_test
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "audio_chain.h"       // NOLINT
+#include "cpu_dispatch.h"      // NOLINT
+#include "waveform_builder.h"  // NOLINT
+
+namespace exoplayer_jni {
+namespace {
+
+const int kChannelCount = 2;
+const int kFramesPerPeak = 441;
+const int kFrameCount = 44100;
+// The tolerance of the RMS values, which the SIMD kernels sum in float.
+const float kMaxRmsError = 1e-5f;
+
+// Returns |kFrameCount| stereo frames of a decaying, asymmetric test signal.
+std::vector<float> CreateSamples() {
+  std::vector<float> samples(kFrameCount * kChannelCount);
+  uint32_t state = 1;
+  for (size_t i = 0; i < samples.size(); i++) {
+    state = state * 1664525 + 1013904223;
+    const float noise = static_cast<int32_t>(state) / 2147483648.0f;
+    const float envelope = 1.0f - static_cast<float>(i) / samples.size();
+    samples[i] = envelope * (i % 2 == 0 ? noise : 0.5f * noise + 0.25f);
+  }
+  return samples;
+}
+
+// Returns the peaks of |samples|, computed directly.
+std::vector<float> ComputePeaks(const std::vector<float>& samples) {
+  std::vector<float> peaks;
+  for (int start = 0; start < kFrameCount; start += kFramesPerPeak) {
+    const int end = std::min(start + kFramesPerPeak, kFrameCount);
+    float min = samples[start * kChannelCount];
+    float max = min;
+    double sum_squares = 0;
+    for (int i = start * kChannelCount; i < end * kChannelCount; i++) {
+      min = std::min(min, samples[i]);
+      max = std::max(max, samples[i]);
+      sum_squares += static_cast<double>(samples[i]) * samples[i];
+    }
+    peaks.push_back(min);
+    peaks.push_back(max);
+    peaks.push_back(static_cast<float>(
+        std::sqrt(sum_squares / ((end - start) * kChannelCount))));
+  }
+  return peaks;
+}
+
+// Adds |samples| from frame |first_frame| to |builder| in calls of varying
+// sizes, and appends the peaks to |peaks|.
+void Reduce(const std::vector<float>& samples, int first_frame,
+            WaveformBuilder* builder, std::vector<float>* peaks) {
+  const int kCallSizes[] = {1, 100, 441, 1000, 4096};
+  int call = 0;
+  for (int frame = first_frame; frame < kFrameCount;) {
+    const int frame_count =
+        std::min(kCallSizes[call++ % 5], kFrameCount - frame);
+    builder->Add(&samples[frame * kChannelCount], frame_count);
+    frame += frame_count;
+  }
+  builder->Finish();
+  peaks->insert(peaks->end(), builder->peaks(),
+                builder->peaks() +
+                    builder->peak_count() * WaveformBuilder::kValuesPerPeak);
+  builder->RemovePeaks(builder->peak_count());
+}
+
+bool CheckPeaks(const char* name, const std::vector<float>& peaks,
+                const std::vector<float>& expected_peaks, std::string* error) {
+  if (peaks.size() != expected_peaks.size()) {
+    *error = std::string(name) + ": expected " +
+             std::to_string(expected_peaks.size()) + " values, got " +
+             std::to_string(peaks.size());
+    return false;
+  }
+  for (size_t i = 0; i < peaks.size(); i++) {
+    const bool is_rms = i % WaveformBuilder::kValuesPerPeak == 2;
+    if (is_rms ? std::fabs(peaks[i] - expected_peaks[i]) > kMaxRmsError
+               : peaks[i] != expected_peaks[i]) {
+      *error = std::string(name) + ": value " + std::to_string(i) +
+               " is " + std::to_string(peaks[i]) + ", expected " +
+               std::to_string(expected_peaks[i]);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool TestPeaks(std::string* error) {
+  const std::vector<float> samples = CreateSamples();
+  WaveformBuilder builder;
+  if (!builder.Configure(kChannelCount, kFramesPerPeak)) {
+    *error = "configuration failed";
+    return false;
+  }
+  std::vector<float> peaks;
+  Reduce(samples, /* first_frame= */ 0, &builder, &peaks);
+  return CheckPeaks("whole stream", peaks, ComputePeaks(samples), error);
+}
+
+bool TestRanges(std::string* error) {
+  const std::vector<float> samples = CreateSamples();
+  // Ranges start at multiples of the frames per peak, and are reduced from
+  // seek points before their start.
+  const int kRangeStarts[] = {0, 10 * kFramesPerPeak, 57 * kFramesPerPeak,
+                              kFrameCount};
+  const int kSeekPointOffsets[] = {0, 1000, 1};
+  std::vector<float> peaks;
+  for (int i = 0; i < 3; i++) {
+    WaveformBuilder builder;
+    builder.Configure(kChannelCount, kFramesPerPeak);
+    builder.SetRange(kRangeStarts[i], kRangeStarts[i + 1]);
+    const int seek_point = kRangeStarts[i] - kSeekPointOffsets[i];
+    builder.set_position(seek_point);
+    Reduce(samples, seek_point, &builder, &peaks);
+  }
+  return CheckPeaks("ranges", peaks, ComputePeaks(samples), error);
+}
+
+bool TestAudioChain(std::string* error) {
+  const std::vector<float> samples = CreateSamples();
+  AudioChainConfig config;
+  config.waveform_frames_per_peak = kFramesPerPeak;
+  AudioChain chain;
+  chain.SetConfig(config);
+  if (!chain.Configure(kChannelCount, /* sample_rate= */ 44100,
+                       kPcmEncodingFloat) ||
+      !chain.IsReducingToWaveform() || chain.IsPassthrough()) {
+    *error = "waveform configuration failed or is passthrough";
+    return false;
+  }
+  // The completed peaks are output, and the last one is completed at the end.
+  std::vector<float> peaks(chain.GetMaxOutputSize(kFrameCount) /
+                           sizeof(float));
+  const int output_size = chain.Process(samples.data(), kFrameCount,
+                                        peaks.data(),
+                                        peaks.size() * sizeof(float));
+  if (output_size < 0) {
+    *error = "waveform processing failed";
+    return false;
+  }
+  peaks.resize(output_size / sizeof(float));
+  WaveformBuilder* builder = chain.waveform();
+  builder->Finish();
+  peaks.insert(peaks.end(), builder->peaks(),
+               builder->peaks() +
+                   builder->peak_count() * WaveformBuilder::kValuesPerPeak);
+  return CheckPeaks("audio chain", peaks, ComputePeaks(samples), error);
+}
+
+int Main(int argc, char** argv) {
+  if (argc != 1) {
+    fprintf(stderr, "Usage: %s\n", argv[0]);
+    return 2;
+  }
+  InitCpuDispatch();
+  std::string error;
+  const bool passed =
+      TestPeaks(&error) && TestRanges(&error) && TestAudioChain(&error);
+  if (!passed) {
+    fprintf(stderr, "FAILED: %s\n", error.c_str());
+    return 1;
+  }
+  printf("PASSED\n");
+  return 0;
+}
+
+}  // namespace
+}  // namespace exoplayer_jni
+
+int main(int argc, char** argv) { return exoplayer_jni::Main(argc, argv); }
@@ -0,0 +1,170 @@
+#
+# Copyright (C) 2021 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# Adds the exoplayer_jni_common static library, containing the native code
+# shared by the extensions, and the cpu_features library it depends on.
+# Extensions built with CMake include this file and link against
+# exoplayer_jni_common.
+#
+# Options:
+#   EXOPLAYER_JNI_TRACING  Compiles in trace sections (see trace.h).
+#   EXOPLAYER_JNI_PGO      Set to "generate" to build with profile
+#                          instrumentation, writing profiles to the directory
+#                          EXOPLAYER_JNI_PROFILE, or to "use" to optimize using
+#                          the profile EXOPLAYER_JNI_PROFILE. With Clang this is
+#                          a .profdata file merged with llvm-profdata, and with
+#                          GCC the directory the profiles were written to.
+#   EXOPLAYER_JNI_LTO      Builds with ThinLTO, or with LTO for GCC.
+#
+# The optimization options apply to all of the targets in the including
+# directory and its subdirectories that are added after this file is included,
+# so that they also apply to the codec libraries.
+
+set(jni_common_root "${CMAKE_CURRENT_LIST_DIR}")
+
+option(EXOPLAYER_JNI_TRACING "Compile in trace sections." OFF)
+set(EXOPLAYER_JNI_PGO "" CACHE STRING
+    "Profile-guided optimization step, generate or use.")
+set(EXOPLAYER_JNI_PROFILE "" CACHE PATH
+    "Profile directory to generate, or profile to use.")
+option(EXOPLAYER_JNI_LTO "Build with link-time optimization." OFF)
+
+if(EXOPLAYER_JNI_PGO OR EXOPLAYER_JNI_LTO)
+    set(jni_common_optimization_flags "")
+    if(EXOPLAYER_JNI_PGO STREQUAL "generate")
+        list(APPEND jni_common_optimization_flags
+             "-fprofile-generate=${EXOPLAYER_JNI_PROFILE}")
+        add_definitions(-DEXOPLAYER_JNI_PGO_GENERATE)
+    elseif(EXOPLAYER_JNI_PGO STREQUAL "use")
+        list(APPEND jni_common_optimization_flags
+             "-fprofile-use=${EXOPLAYER_JNI_PROFILE}")
+        # Code that the profile doesn't cover, such as SIMD kernels for other
+        # architectures, is optimized as usual.
+        if(CMAKE_CXX_COMPILER_ID MATCHES "Clang")
+            list(APPEND jni_common_optimization_flags
+                 "-Wno-profile-instr-unprofiled"
+                 "-Wno-profile-instr-out-of-date")
+        else()
+            list(APPEND jni_common_optimization_flags
+                 "-fprofile-partial-training"
+                 "-Wno-missing-profile")
+        endif()
+    elseif(EXOPLAYER_JNI_PGO)
+        message(FATAL_ERROR
+                "EXOPLAYER_JNI_PGO must be generate or use, not "
+                "${EXOPLAYER_JNI_PGO}")
+    endif()
+    if(EXOPLAYER_JNI_LTO)
+        if(CMAKE_CXX_COMPILER_ID MATCHES "Clang")
+            list(APPEND jni_common_optimization_flags "-flto=thin")
+        else()
+            # GCC doesn't support ThinLTO. Its LTO objects must be archived
+            # with gcc-ar, so that static libraries have a symbol index.
+            list(APPEND jni_common_optimization_flags "-flto=auto")
+            set(CMAKE_AR "${CMAKE_CXX_COMPILER_AR}")
+            set(CMAKE_RANLIB "${CMAKE_CXX_COMPILER_RANLIB}")
+        endif()
+    endif()
+    add_compile_options(${jni_common_optimization_flags})
+    string(REPLACE ";" " " jni_common_optimization_link_flags
+           "${jni_common_optimization_flags}")
+    set(CMAKE_SHARED_LINKER_FLAGS
+        "${CMAKE_SHARED_LINKER_FLAGS} ${jni_common_optimization_link_flags}")
+    set(CMAKE_EXE_LINKER_FLAGS
+        "${CMAKE_EXE_LINKER_FLAGS} ${jni_common_optimization_link_flags}")
+endif()
+
+# Build cpu_features library. Host builds, which are only used for benchmarks
+# and tests, fall back to the compiler's CPU detection if it hasn't been
+# fetched.
+if(NOT TARGET cpu_features)
+    if(ANDROID OR EXISTS "${jni_common_root}/cpu_features")
+        set(CMAKE_POSITION_INDEPENDENT_CODE ON)
+        set(BUILD_TESTING OFF CACHE BOOL "" FORCE)
+        add_subdirectory("${jni_common_root}/cpu_features"
+                         "${CMAKE_CURRENT_BINARY_DIR}/cpu_features"
+                         EXCLUDE_FROM_ALL)
+    endif()
+endif()
+
+set(jni_common_sources
+    "${jni_common_root}/audio_chain.cc"
+    "${jni_common_root}/audio_kernels.cc"
+    "${jni_common_root}/cpu_dispatch.cc"
+    "${jni_common_root}/crossfade_mixer.cc"
+    "${jni_common_root}/decode_ahead.cc"
+    "${jni_common_root}/decoder_stats.cc"
+    "${jni_common_root}/fft.cc"
+    "${jni_common_root}/frame_buffer_pool.cc"
+    "${jni_common_root}/loudness_meter.cc"
+    "${jni_common_root}/session_recorder.cc"
+    "${jni_common_root}/spectrum_analyzer.cc"
+    "${jni_common_root}/spsc_ring.cc"
+    "${jni_common_root}/time_stretcher.cc"
+    "${jni_common_root}/trace.cc"
+    "${jni_common_root}/video_kernels.cc"
+    "${jni_common_root}/waveform_builder.cc")
+
+if(CMAKE_SYSTEM_PROCESSOR MATCHES "^(arm|aarch64)")
+    set(jni_common_neon_sources
+        "${jni_common_root}/audio_kernels_neon.cc"
+        "${jni_common_root}/video_kernels_neon.cc")
+    list(APPEND jni_common_sources ${jni_common_neon_sources})
+    # Kernels are selected at runtime, so NEON sources are built with NEON
+    # enabled even for armeabi-v7a, where NEON support is optional.
+    if(ANDROID_ABI MATCHES "armeabi-v7a")
+        set_source_files_properties(${jni_common_neon_sources}
+                                    PROPERTIES COMPILE_FLAGS "-mfpu=neon")
+    endif()
+elseif(CMAKE_SYSTEM_PROCESSOR MATCHES "^(i.86|x86|x86_64|AMD64)")
+    list(APPEND jni_common_sources
+         "${jni_common_root}/audio_kernels_sse2.cc"
+         "${jni_common_root}/audio_kernels_ssse3.cc"
+         "${jni_common_root}/video_kernels_avx2.cc"
+         "${jni_common_root}/video_kernels_sse2.cc")
+endif()
+
+add_library(exoplayer_jni_common
+            STATIC
+            ${jni_common_sources})
+set_target_properties(exoplayer_jni_common
+                      PROPERTIES POSITION_INDEPENDENT_CODE ON)
+target_include_directories(exoplayer_jni_common
+                           PUBLIC "${jni_common_root}")
+if(TARGET cpu_features)
+    target_link_libraries(exoplayer_jni_common
+                          PRIVATE cpu_features)
+else()
+    target_compile_definitions(exoplayer_jni_common
+                               PRIVATE EXOPLAYER_JNI_NO_CPU_FEATURES)
+endif()
+
+# The decode-ahead thread uses std::thread, which Android provides in libc.
+if(NOT ANDROID)
+    find_package(Threads REQUIRED)
+    target_link_libraries(exoplayer_jni_common
+                          PUBLIC Threads::Threads)
+endif()
+
+if(EXOPLAYER_JNI_TRACING)
+    # Public, since the trace macros are expanded in the extensions' sources.
+    target_compile_definitions(exoplayer_jni_common
+                               PUBLIC EXOPLAYER_JNI_TRACING)
+    if(ANDROID)
+        target_link_libraries(exoplayer_jni_common
+                              PRIVATE dl)
+    endif()
+endif()
@@ -0,0 +1,83 @@
+#
+# Copyright (C) 2021 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# Builds libexoplayerjnicommon.a, the native code shared by the extensions,
+# including the cpu_features library it depends on. Extensions built with
+# ndk-build include this file and add exoplayerjnicommon to their
+# LOCAL_STATIC_LIBRARIES.
+#
+# Set EXOPLAYER_JNI_TRACING=1 to compile in trace sections (see trace.h).
+
+JNI_COMMON_PATH := $(call my-dir)
+
+include $(CLEAR_VARS)
+LOCAL_PATH := $(JNI_COMMON_PATH)
+LOCAL_MODULE := exoplayerjnicommon
+LOCAL_ARM_MODE := arm
+LOCAL_CPP_EXTENSION := .cc
+LOCAL_SRC_FILES := \
+    audio_chain.cc \
+    audio_kernels.cc \
+    cpu_dispatch.cc \
+    crossfade_mixer.cc \
+    decode_ahead.cc \
+    decoder_stats.cc \
+    fft.cc \
+    frame_buffer_pool.cc \
+    loudness_meter.cc \
+    session_recorder.cc \
+    spectrum_analyzer.cc \
+    spsc_ring.cc \
+    time_stretcher.cc \
+    trace.cc \
+    video_kernels.cc \
+    waveform_builder.cc
+
+# Kernels are selected at runtime, so NEON sources are built with NEON enabled
+# even for armeabi-v7a, where NEON support is optional.
+ifeq ($(TARGET_ARCH_ABI),armeabi-v7a)
+LOCAL_SRC_FILES += \
+    audio_kernels_neon.cc.neon \
+    video_kernels_neon.cc.neon
+endif
+ifeq ($(TARGET_ARCH_ABI),arm64-v8a)
+LOCAL_SRC_FILES += \
+    audio_kernels_neon.cc \
+    video_kernels_neon.cc
+endif
+ifneq ($(filter x86 x86_64,$(TARGET_ARCH_ABI)),)
+LOCAL_SRC_FILES += \
+    audio_kernels_sse2.cc \
+    audio_kernels_ssse3.cc \
+    video_kernels_avx2.cc \
+    video_kernels_sse2.cc
+endif
+
+# cpu_features.
+LOCAL_SRC_FILES += $(patsubst $(LOCAL_PATH)/%,%, \
+                     $(wildcard $(LOCAL_PATH)/cpu_features/src/*.c))
+LOCAL_C_INCLUDES := $(LOCAL_PATH) $(LOCAL_PATH)/cpu_features/include
+LOCAL_CFLAGS := -DSTACK_LINE_READER_BUFFER_SIZE=1024 -DHAVE_DLFCN_H
+LOCAL_EXPORT_C_INCLUDES := $(LOCAL_PATH)
+LOCAL_EXPORT_LDLIBS := -ldl
+
+# The trace macros are expanded in the extensions' sources, so the definition
+# is exported.
+ifeq ($(EXOPLAYER_JNI_TRACING),1)
+LOCAL_CFLAGS += -DEXOPLAYER_JNI_TRACING
+LOCAL_EXPORT_CFLAGS := -DEXOPLAYER_JNI_TRACING
+endif
+include $(BUILD_STATIC_LIBRARY)
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_JNI_REGISTRATION_H_
+#define EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_JNI_REGISTRATION_H_
+
+#include <jni.h>
+
+// Native methods are registered with RegisterNatives() when a library is
+// loaded, rather than being looked up by their mangled names when they're
+// first called.
+//
+// Each extension can also be built into the combined extension library (see
+// combined/Android.mk), in which case EXOPLAYER_JNI_COMBINED is defined. The
+// library's only exported symbol is then its JNI_OnLoad, which calls each
+// extension's load function in turn, so the native method implementations
+// aren't exported.
+#ifdef EXOPLAYER_JNI_COMBINED
+#define EXOPLAYER_JNI_EXPORT
+#define EXOPLAYER_JNI_ONLOAD(NAME) \
+  jint exoplayer_jni::NAME(JavaVM* vm, void* reserved)
+#else
+#define EXOPLAYER_JNI_EXPORT JNIEXPORT
+#define EXOPLAYER_JNI_ONLOAD(NAME) jint JNI_OnLoad(JavaVM* vm, void* reserved)
+#endif
+
+// Defines an entry of a JNINativeMethod table for the method |NAME| with the
+// JNI type signature |SIGNATURE|, implemented by |FUNCTION|.
+#define EXOPLAYER_JNI_METHOD(NAME, SIGNATURE, FUNCTION) \
+  { NAME, SIGNATURE, reinterpret_cast<void*>(FUNCTION) }
+
+namespace exoplayer_jni {
+
+// The load functions of the extensions in the combined library.
+jint Gav1OnLoad(JavaVM* vm, void* reserved);
+jint FfmpegOnLoad(JavaVM* vm, void* reserved);
+jint FlacOnLoad(JavaVM* vm, void* reserved);
+jint OpusOnLoad(JavaVM* vm, void* reserved);
+jint VpxOnLoad(JavaVM* vm, void* reserved);
+
+// Registers the native |methods| of the class |class_name|. Returns false, with
+// an exception pending, if the class or one of the methods can't be found.
+template <int N>
+bool RegisterNatives(JNIEnv* env, const char* class_name,
+                     const JNINativeMethod (&methods)[N]) {
+  const jclass clazz = env->FindClass(class_name);
+  if (clazz == nullptr) {
+    return false;
+  }
+  const bool registered = env->RegisterNatives(clazz, methods, N) == JNI_OK;
+  env->DeleteLocalRef(clazz);
+  return registered;
+}
+
+}  // namespace exoplayer_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_JNI_REGISTRATION_H_
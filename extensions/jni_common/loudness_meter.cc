@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "loudness_meter.h"  // NOLINT
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace exoplayer_jni {
+namespace {
+
+const double kPi = 3.14159265358979323846;
+const double kAbsoluteGateLufs = -70;
+const double kRelativeGateLu = -10;
+const double kHistogramBinsPerLu = 10;
+
+// Returns the loudness in LUFS of a mean square |energy|.
+double GetLoudness(double energy) {
+  return -0.691 + 10 * std::log10(energy);
+}
+
+}  // namespace
+
+LoudnessMeter::LoudnessMeter()
+    : channel_count_(0), step_frame_count_(0), shelf_(), high_pass_() {
+  Reset();
+}
+
+bool LoudnessMeter::Configure(int channel_count, int sample_rate) {
+  if (channel_count <= 0 || channel_count > kMaxChannels || sample_rate <= 0) {
+    return false;
+  }
+  channel_count_ = channel_count;
+  step_frame_count_ = std::max(1, (sample_rate + 5) / 10);
+  for (int c = 0; c < channel_count; c++) {
+    weights_[c] = 1;
+  }
+  if (channel_count == 6 || channel_count == 8) {
+    weights_[3] = 0;
+    for (int c = 4; c < channel_count; c++) {
+      weights_[c] = 1.41;
+    }
+  }
+
+  // The K-weighting filters of BS.1770, whose coefficients are given for
+  // 48 kHz, designed for |sample_rate| from their analog prototypes as in
+  // libebur128.
+  double k = std::tan(kPi * 1681.974450955533 / sample_rate);
+  double q = 0.7071752369554196;
+  const double vh = std::pow(10.0, 3.999843853973347 / 20);
+  const double vb = std::pow(vh, 0.4996667741545416);
+  double a0 = 1 + k / q + k * k;
+  shelf_.b0 = (vh + vb * k / q + k * k) / a0;
+  shelf_.b1 = 2 * (k * k - vh) / a0;
+  shelf_.b2 = (vh - vb * k / q + k * k) / a0;
+  shelf_.a1 = 2 * (k * k - 1) / a0;
+  shelf_.a2 = (1 - k / q + k * k) / a0;
+  k = std::tan(kPi * 38.13547087602444 / sample_rate);
+  q = 0.5003270373238773;
+  a0 = 1 + k / q + k * k;
+  high_pass_.b0 = 1;
+  high_pass_.b1 = -2;
+  high_pass_.b2 = 1;
+  high_pass_.a1 = 2 * (k * k - 1) / a0;
+  high_pass_.a2 = (1 - k / q + k * k) / a0;
+  Reset();
+  return true;
+}
+
+void LoudnessMeter::Process(const float* samples, int frame_count) {
+  const int channel_count = channel_count_;
+  for (int i = 0; i < frame_count; i++) {
+    for (int c = 0; c < channel_count; c++) {
+      double* state = filter_state_[c];
+      const double x = samples[c];
+      const double shelved = shelf_.b0 * x + state[0];
+      state[0] = shelf_.b1 * x - shelf_.a1 * shelved + state[1];
+      state[1] = shelf_.b2 * x - shelf_.a2 * shelved;
+      const double y = high_pass_.b0 * shelved + state[2];
+      state[2] = high_pass_.b1 * shelved - high_pass_.a1 * y + state[3];
+      state[3] = high_pass_.b2 * shelved - high_pass_.a2 * y;
+      step_energy_ += weights_[c] * y * y;
+    }
+    samples += channel_count;
+    if (++step_frame_position_ == step_frame_count_) {
+      step_energies_[step_count_ % kStepsPerBlock] = step_energy_;
+      step_count_++;
+      step_energy_ = 0;
+      step_frame_position_ = 0;
+      if (step_count_ >= kStepsPerBlock) {
+        AddBlock();
+      }
+    }
+  }
+}
+
+void LoudnessMeter::ResetFilters() {
+  for (int c = 0; c < kMaxChannels; c++) {
+    std::fill(filter_state_[c], filter_state_[c] + 4, 0.0);
+  }
+  step_energy_ = 0;
+  step_frame_position_ = 0;
+  step_count_ = 0;
+}
+
+void LoudnessMeter::Reset() {
+  ResetFilters();
+  std::fill(bin_block_counts_, bin_block_counts_ + kHistogramBinCount, 0);
+  std::fill(bin_energies_, bin_energies_ + kHistogramBinCount, 0.0);
+  integrated_loudness_ = -std::numeric_limits<double>::infinity();
+}
+
+void LoudnessMeter::AddBlock() {
+  double block_energy = 0;
+  for (int i = 0; i < kStepsPerBlock; i++) {
+    block_energy += step_energies_[i];
+  }
+  block_energy /= static_cast<double>(kStepsPerBlock) * step_frame_count_;
+  const double block_loudness = GetLoudness(block_energy);
+  if (!(block_loudness >= kAbsoluteGateLufs)) {
+    return;
+  }
+  const int bin = std::min(
+      kHistogramBinCount - 1,
+      static_cast<int>((block_loudness - kAbsoluteGateLufs) *
+                       kHistogramBinsPerLu));
+  bin_block_counts_[bin]++;
+  bin_energies_[bin] += block_energy;
+
+  double energy = 0;
+  int64_t block_count = 0;
+  for (int i = 0; i < kHistogramBinCount; i++) {
+    energy += bin_energies_[i];
+    block_count += bin_block_counts_[i];
+  }
+  const double relative_gate = GetLoudness(energy / block_count) +
+                               kRelativeGateLu;
+  const int first_bin = std::max(
+      0, static_cast<int>((relative_gate - kAbsoluteGateLufs) *
+                          kHistogramBinsPerLu));
+  energy = 0;
+  block_count = 0;
+  for (int i = first_bin; i < kHistogramBinCount; i++) {
+    energy += bin_energies_[i];
+    block_count += bin_block_counts_[i];
+  }
+  integrated_loudness_ = GetLoudness(energy / block_count);
+}
+
+}  // namespace exoplayer_jni
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_LOUDNESS_METER_H_
+#define EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_LOUDNESS_METER_H_
+
+#include <cstdint>
+
+namespace exoplayer_jni {
+
+// Measures the integrated loudness of interleaved float audio, as defined by
+// ITU-R BS.1770-4 and EBU R 128, incrementally as the audio is decoded.
+//
+// Each channel is K-weighted by a high shelf and a high-pass biquad, and the
+// mean square of the weighted channels is taken over 400 ms blocks that
+// overlap by 75%. Blocks quieter than -70 LUFS are gated out, and the
+// integrated loudness is that of the remaining blocks that are no more than
+// 10 LU quieter than their mean. Instead of keeping every block, blocks are
+// counted in a histogram of 0.1 LU bins, as libebur128 does, so the relative
+// gate is applied with 0.1 LU resolution and the memory used is bounded.
+//
+// Channels are weighted by 1, except that for 6 and 8 channels, which are
+// assumed to be in the 5.1 and 7.1 orders used by Android, the low frequency
+// effects channel is weighted by 0 and the surround channels by 1.41. Not
+// thread-safe.
+class LoudnessMeter {
+ public:
+  static const int kMaxChannels = 8;
+
+  LoudnessMeter();
+
+  // Not copyable or movable.
+  LoudnessMeter(const LoudnessMeter&) = delete;
+  LoudnessMeter& operator=(const LoudnessMeter&) = delete;
+
+  // Configures the meter for |channel_count| channels at |sample_rate|, and
+  // resets it. Returns false if the arguments are out of range.
+  bool Configure(int channel_count, int sample_rate);
+
+  // Measures |frame_count| frames.
+  void Process(const float* samples, int frame_count);
+
+  // Resets the filters and the partial block, keeping the measured blocks.
+  // Called when the decoder is flushed, so that the filters don't ring with
+  // audio from before a seek.
+  void ResetFilters();
+
+  // Discards all measured audio.
+  void Reset();
+
+  // Returns the integrated loudness of the audio measured so far in LUFS, or
+  // -infinity if no block is louder than the absolute gate.
+  double integrated_loudness() const { return integrated_loudness_; }
+
+ private:
+  // The histogram covers -70 to +30 LUFS, and louder blocks are counted in the
+  // last bin.
+  static const int kHistogramBinCount = 1000;
+  // The number of 100 ms steps in a block.
+  static const int kStepsPerBlock = 4;
+
+  struct Biquad {
+    double b0, b1, b2, a1, a2;
+  };
+
+  // Adds the block ending with the last step to the histogram, and updates
+  // the integrated loudness.
+  void AddBlock();
+
+  int channel_count_;
+  int step_frame_count_;
+  double weights_[kMaxChannels];
+  Biquad shelf_;
+  Biquad high_pass_;
+  // The transposed direct form II state of each channel's two biquads.
+  double filter_state_[kMaxChannels][4];
+
+  // The weighted sum of squares of the current step, and of the last steps.
+  double step_energy_;
+  int step_frame_position_;
+  double step_energies_[kStepsPerBlock];
+  int step_count_;
+
+  int64_t bin_block_counts_[kHistogramBinCount];
+  double bin_energies_[kHistogramBinCount];
+  double integrated_loudness_;
+};
+
+}  // namespace exoplayer_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_LOUDNESS_METER_H_
@@ -0,0 +1,47 @@
+#
+# Copyright (C) 2021 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# Sets the flags of the profile-guided and link-time optimized build variants
+# for every module in the build, including the codec libraries. Included by the
+# extensions' Application.mk files.
+#
+#   EXOPLAYER_JNI_PGO=generate  Builds with profile instrumentation. Profiles
+#                               are written to the directory
+#                               EXOPLAYER_JNI_PROFILE on the device, which must
+#                               be writable by the app.
+#   EXOPLAYER_JNI_PGO=use       Optimizes using the profile
+#                               EXOPLAYER_JNI_PROFILE, merged from the generated
+#                               profiles with llvm-profdata.
+#   EXOPLAYER_JNI_LTO=1         Builds with ThinLTO.
+
+ifeq ($(EXOPLAYER_JNI_PGO),generate)
+APP_CFLAGS += -fprofile-generate=$(EXOPLAYER_JNI_PROFILE) \
+              -DEXOPLAYER_JNI_PGO_GENERATE
+APP_LDFLAGS += -fprofile-generate=$(EXOPLAYER_JNI_PROFILE)
+else ifeq ($(EXOPLAYER_JNI_PGO),use)
+# Code that the profile doesn't cover, such as SIMD kernels for other
+# architectures, is optimized as usual.
+APP_CFLAGS += -fprofile-use=$(EXOPLAYER_JNI_PROFILE) \
+              -Wno-profile-instr-unprofiled -Wno-profile-instr-out-of-date
+APP_LDFLAGS += -fprofile-use=$(EXOPLAYER_JNI_PROFILE)
+else ifneq ($(EXOPLAYER_JNI_PGO),)
+$(error EXOPLAYER_JNI_PGO must be generate or use)
+endif
+
+ifeq ($(EXOPLAYER_JNI_LTO),1)
+APP_CFLAGS += -flto=thin
+APP_LDFLAGS += -flto=thin
+endif
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_PROFILE_H_
+#define EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_PROFILE_H_
+
+// Support for profile-guided optimization.
+//
+// When the native code is built to generate a profile (see jni_common.cmake
+// and optimization.mk), EXOPLAYER_JNI_PGO_GENERATE is defined and the profile
+// is written when the process exits. Android apps are usually killed rather
+// than exiting, so the extensions also call FlushProfile() when a decoder is
+// released. It does nothing in other builds.
+
+#if defined(EXOPLAYER_JNI_PGO_GENERATE) && defined(__clang__)
+
+// Provided by the Clang profile runtime.
+extern "C" int __llvm_profile_write_file(void);
+extern "C" void __llvm_profile_reset_counters(void);
+
+namespace exoplayer_jni {
+
+// Merges the counters collected since the last call into the profile file, and
+// resets them so that they aren't counted again.
+inline void FlushProfile() {
+  if (__llvm_profile_write_file() == 0) {
+    __llvm_profile_reset_counters();
+  }
+}
+
+}  // namespace exoplayer_jni
+
+#else  // defined(EXOPLAYER_JNI_PGO_GENERATE) && defined(__clang__)
+
+namespace exoplayer_jni {
+
+inline void FlushProfile() {}
+
+}  // namespace exoplayer_jni
+
+#endif  // defined(EXOPLAYER_JNI_PGO_GENERATE) && defined(__clang__)
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_PROFILE_H_
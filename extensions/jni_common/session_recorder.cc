@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "session_recorder.h"  // NOLINT
+
+#include <cstring>
+
+namespace exoplayer_jni {
+
+namespace {
+
+// Records are written through a buffer of this size, so that a write to the
+// file is made every few input buffers rather than for every record.
+const size_t kFileBufferSize = 64 * 1024;
+
+}  // namespace
+
+SessionRecorder::SessionRecorder(session_format::Codec codec)
+    : codec_(codec),
+      recording_(false),
+      file_(nullptr),
+      start_time_ns_(0),
+      output_mode_(-1) {}
+
+SessionRecorder::~SessionRecorder() { Stop(); }
+
+void SessionRecorder::SetInitParameters(const int64_t* parameters,
+                                        int parameter_count,
+                                        const uint8_t* data, size_t size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  init_parameters_.assign(parameters, parameters + parameter_count);
+  init_data_.assign(data, data + size);
+}
+
+bool SessionRecorder::Start(const char* path) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  StopLocked();
+  file_ = fopen(path, "wb");
+  if (!file_) {
+    return false;
+  }
+  setvbuf(file_, nullptr, _IOFBF, kFileBufferSize);
+  session_format::FileHeader header;
+  memcpy(header.magic, session_format::kMagic, sizeof(header.magic));
+  header.version = session_format::kVersion;
+  header.codec = codec_;
+  if (fwrite(&header, sizeof(header), 1, file_) != 1) {
+    fclose(file_);
+    file_ = nullptr;
+    return false;
+  }
+  start_time_ns_ = GetMonotonicTimeNs();
+  recording_.store(true, std::memory_order_relaxed);
+
+  std::vector<uint8_t> init_record(init_parameters_.size() * sizeof(int64_t) +
+                                   init_data_.size());
+  if (!init_parameters_.empty()) {
+    memcpy(init_record.data(), init_parameters_.data(),
+           init_parameters_.size() * sizeof(int64_t));
+  }
+  if (!init_data_.empty()) {
+    memcpy(init_record.data() + init_parameters_.size() * sizeof(int64_t),
+           init_data_.data(), init_data_.size());
+  }
+  WriteRecordLocked(session_format::kRecordInit, /*time_ns=*/0,
+                    /*duration_ns=*/0, init_parameters_.size(), /*result=*/0,
+                    /*flags=*/0, init_record.data(), init_record.size());
+  if (output_mode_ != -1) {
+    WriteRecordLocked(session_format::kRecordOutputMode, /*time_ns=*/0,
+                      /*duration_ns=*/0, output_mode_, /*result=*/0,
+                      /*flags=*/0, nullptr, 0);
+  }
+  return recording_.load(std::memory_order_relaxed);
+}
+
+void SessionRecorder::Stop() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  StopLocked();
+}
+
+void SessionRecorder::Record(session_format::RecordType type,
+                             int64_t start_time_ns, int64_t argument,
+                             int32_t result, int32_t flags,
+                             const uint8_t* data, size_t size) {
+  const int64_t end_time_ns = GetMonotonicTimeNs();
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!IsRecording()) {
+    return;
+  }
+  WriteRecordLocked(type, start_time_ns - start_time_ns_,
+                    end_time_ns - start_time_ns, argument, result, flags, data,
+                    size);
+}
+
+void SessionRecorder::SetOutputMode(int64_t mode) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (mode == output_mode_) {
+    return;
+  }
+  output_mode_ = mode;
+  if (IsRecording()) {
+    WriteRecordLocked(session_format::kRecordOutputMode,
+                      GetMonotonicTimeNs() - start_time_ns_, /*duration_ns=*/0,
+                      mode, /*result=*/0, /*flags=*/0, nullptr, 0);
+  }
+}
+
+void SessionRecorder::WriteRecordLocked(session_format::RecordType type,
+                                        int64_t time_ns, int64_t duration_ns,
+                                        int64_t argument, int32_t result,
+                                        int32_t flags, const uint8_t* data,
+                                        size_t size) {
+  session_format::RecordHeader header;
+  header.type = type;
+  header.size = static_cast<uint32_t>(size);
+  header.time_ns = time_ns;
+  header.duration_ns = duration_ns;
+  header.argument = argument;
+  header.result = result;
+  header.flags = flags;
+  if (fwrite(&header, sizeof(header), 1, file_) != 1 ||
+      (size && fwrite(data, size, 1, file_) != 1)) {
+    // Most likely the storage is full. Stop rather than writing records after a
+    // partial one. A truncated last record is ignored when it's replayed.
+    StopLocked();
+  }
+}
+
+void SessionRecorder::StopLocked() {
+  recording_.store(false, std::memory_order_relaxed);
+  if (file_) {
+    fclose(file_);
+    file_ = nullptr;
+  }
+}
+
+}  // namespace exoplayer_jni
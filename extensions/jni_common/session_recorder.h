@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_SESSION_RECORDER_H_
+#define EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_SESSION_RECORDER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>  // NOLINT
+#include <vector>
+
+#include "decoder_stats.h"  // NOLINT
+
+namespace exoplayer_jni {
+
+// The format of a session recording. A recording starts with a FileHeader,
+// followed by records that each consist of a RecordHeader and |size| bytes of
+// data. Values are written in native byte order, which is little-endian on all
+// supported ABIs.
+namespace session_format {
+
+const char kMagic[8] = {'E', 'X', 'O', 'S', 'R', 'E', 'C', '\0'};
+const uint32_t kVersion = 1;
+
+enum Codec : uint32_t {
+  kCodecVp9 = 1,
+  kCodecAv1 = 2,
+  kCodecOpus = 3,
+  kCodecFlac = 4,
+  kCodecFfmpeg = 5
+};
+
+enum RecordType : uint32_t {
+  // The parameters the decoder was created with. |argument| is the number of
+  // int64_t parameters at the start of the data, which are followed by the
+  // decoder's initialization data, if any. Always the first record.
+  kRecordInit = 1,
+  // An input buffer, whose contents are the data. Decoders that read their
+  // input have no data, and the decode call's reads are recorded before it.
+  kRecordDecode = 2,
+  // A call that gets a decoded frame. |argument| is the id of the frame buffer
+  // that's output in surface mode, or -1.
+  kRecordGetFrame = 3,
+  // Rendering the frame buffer with id |argument| to a surface.
+  kRecordRender = 4,
+  // Releasing the frame buffer with id |argument|.
+  kRecordReleaseFrame = 5,
+  // Resetting the decoder. For FLAC, |argument| is the new stream position.
+  kRecordReset = 6,
+  // Flushing the decoder.
+  kRecordFlush = 7,
+  // A change of output mode to |argument|, a C.VIDEO_OUTPUT_MODE_* value for
+  // video or 1 for float audio output.
+  kRecordOutputMode = 8,
+  // Input data read by the decoder through a callback, for decoders that read
+  // their input rather than being queued input buffers.
+  kRecordRead = 9
+};
+
+// Flags of a record.
+enum RecordFlags : int32_t {
+  // The frame was decode-only.
+  kFlagDecodeOnly = 1
+};
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t codec;
+};
+
+struct RecordHeader {
+  uint32_t type;
+  // The size of the data that follows the header, in bytes.
+  uint32_t size;
+  // The time the call started, relative to the start of the recording.
+  int64_t time_ns;
+  // The time spent in the call.
+  int64_t duration_ns;
+  int64_t argument;
+  // The call's return value, or the codec library's status for kRecordDecode.
+  int32_t result;
+  int32_t flags;
+};
+
+}  // namespace session_format
+
+// Records the sequence of calls made to a native decoder, with their inputs
+// and timing, to a file that can be replayed on the host with session_replay.
+//
+// Recording is off until Start() is called, and costs a relaxed atomic load
+// per call while it's off. Start() and Stop() may be called from any thread,
+// and records are written from the decoder's threads under a lock.
+class SessionRecorder {
+ public:
+  explicit SessionRecorder(session_format::Codec codec);
+  // Stops recording.
+  ~SessionRecorder();
+
+  // Not copyable or movable.
+  SessionRecorder(const SessionRecorder&) = delete;
+  SessionRecorder& operator=(const SessionRecorder&) = delete;
+
+  // Sets the parameters and initialization data the decoder was created with,
+  // which are written at the start of each recording. Must be called before
+  // recording is started.
+  void SetInitParameters(const int64_t* parameters, int parameter_count,
+                         const uint8_t* data, size_t size);
+
+  // Starts recording to a new file at |path|, stopping any current recording.
+  // Returns false if the file can't be created.
+  bool Start(const char* path);
+
+  // Stops recording, and closes the file.
+  void Stop();
+
+  bool IsRecording() const {
+    return recording_.load(std::memory_order_relaxed);
+  }
+
+  // Writes a record of a call that started at |start_time_ns|, on the
+  // GetMonotonicTimeNs() clock, and has just returned. Does nothing if
+  // recording is off.
+  void Record(session_format::RecordType type, int64_t start_time_ns,
+              int64_t argument, int32_t result, int32_t flags,
+              const uint8_t* data, size_t size);
+
+  // Writes a kRecordOutputMode record if |mode| differs from the last mode
+  // that was set, and remembers the mode for the start of later recordings.
+  void SetOutputMode(int64_t mode);
+
+ private:
+  void WriteRecordLocked(session_format::RecordType type, int64_t time_ns,
+                         int64_t duration_ns, int64_t argument, int32_t result,
+                         int32_t flags, const uint8_t* data, size_t size);
+  void StopLocked();
+
+  const session_format::Codec codec_;
+  std::atomic<bool> recording_;
+  std::mutex mutex_;
+  FILE* file_;
+  int64_t start_time_ns_;
+  std::vector<int64_t> init_parameters_;
+  std::vector<uint8_t> init_data_;
+  int64_t output_mode_;
+};
+
+// Records a call to a decoder entry point when it goes out of scope. Should be
+// declared at the start of the entry point, and given the call's result and
+// argument before it returns.
+class ScopedSessionRecord {
+ public:
+  ScopedSessionRecord(SessionRecorder* recorder,
+                      session_format::RecordType type,
+                      const uint8_t* data = nullptr, size_t size = 0)
+      : recorder_(recorder->IsRecording() ? recorder : nullptr),
+        type_(type),
+        data_(data),
+        size_(size),
+        start_time_ns_(recorder_ ? GetMonotonicTimeNs() : 0),
+        argument_(-1),
+        result_(0),
+        flags_(0) {}
+
+  ~ScopedSessionRecord() {
+    if (recorder_) {
+      recorder_->Record(type_, start_time_ns_, argument_, result_, flags_,
+                        data_, size_);
+    }
+  }
+
+  // Not copyable or movable.
+  ScopedSessionRecord(const ScopedSessionRecord&) = delete;
+  ScopedSessionRecord& operator=(const ScopedSessionRecord&) = delete;
+
+  // Sets the data of the record, if it's only known once the call has been
+  // made. The data must remain valid until the record goes out of scope.
+  void set_data(const uint8_t* data, size_t size) {
+    data_ = data;
+    size_ = size;
+  }
+  void set_argument(int64_t argument) { argument_ = argument; }
+  void set_result(int32_t result) { result_ = result; }
+  void set_flags(int32_t flags) { flags_ = flags; }
+
+ private:
+  SessionRecorder* const recorder_;
+  const session_format::RecordType type_;
+  const uint8_t* data_;
+  size_t size_;
+  const int64_t start_time_ns_;
+  int64_t argument_;
+  int32_t result_;
+  int32_t flags_;
+};
+
+}  // namespace exoplayer_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_SESSION_RECORDER_H_
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "spectrum_analyzer.h"  // NOLINT
+
+#include <algorithm>
+#include <cmath>
+
+namespace exoplayer_jni {
+namespace {
+
+const double kPi = 3.14159265358979323846;
+const int kMaxChannels = 8;
+
+}  // namespace
+
+SpectrumAnalyzer::SpectrumAnalyzer()
+    : channel_count_(0),
+      sample_rate_(0),
+      write_position_(0),
+      filled_(false),
+      window_sum_(0) {}
+
+bool SpectrumAnalyzer::Configure(int channel_count, int sample_rate,
+                                 int fft_size) {
+  std::lock_guard<std::mutex> compute_lock(compute_mutex_);
+  std::lock_guard<std::mutex> ring_lock(ring_mutex_);
+  channel_count_ = 0;
+  if (channel_count <= 0 || channel_count > kMaxChannels || sample_rate <= 0 ||
+      !fft_.Configure(fft_size)) {
+    return false;
+  }
+  channel_count_ = channel_count;
+  sample_rate_ = sample_rate;
+  ring_.assign(fft_size, 0.0f);
+  write_position_ = 0;
+  filled_ = false;
+  window_.resize(fft_size);
+  window_sum_ = 0;
+  for (int i = 0; i < fft_size; i++) {
+    window_[i] =
+        static_cast<float>(0.5 - 0.5 * std::cos(2 * kPi * i / fft_size));
+    window_sum_ += window_[i];
+  }
+  samples_.resize(fft_size);
+  power_.resize(fft_size / 2 + 1);
+  return true;
+}
+
+void SpectrumAnalyzer::Add(const float* samples, int frame_count) {
+  std::lock_guard<std::mutex> lock(ring_mutex_);
+  if (channel_count_ == 0) {
+    return;
+  }
+  const float scale = 1.0f / channel_count_;
+  const size_t ring_size = ring_.size();
+  for (int i = 0; i < frame_count; i++) {
+    float sum = 0;
+    for (int c = 0; c < channel_count_; c++) {
+      sum += samples[i * channel_count_ + c];
+    }
+    ring_[write_position_] = sum * scale;
+    if (++write_position_ == ring_size) {
+      write_position_ = 0;
+      filled_ = true;
+    }
+  }
+}
+
+void SpectrumAnalyzer::Reset() {
+  std::lock_guard<std::mutex> lock(ring_mutex_);
+  write_position_ = 0;
+  filled_ = false;
+}
+
+bool SpectrumAnalyzer::ComputeBands(float* bands, int band_count) {
+  std::lock_guard<std::mutex> compute_lock(compute_mutex_);
+  const int fft_size = fft_.size();
+  int sample_rate;
+  {
+    std::lock_guard<std::mutex> ring_lock(ring_mutex_);
+    if (channel_count_ == 0 || !filled_ || band_count < 1 ||
+        band_count > fft_size / 2) {
+      return false;
+    }
+    sample_rate = sample_rate_;
+    // Copies the frames from the oldest to the newest.
+    std::copy(ring_.begin() + write_position_, ring_.end(), samples_.begin());
+    std::copy(ring_.begin(), ring_.begin() + write_position_,
+              samples_.end() - write_position_);
+  }
+  for (int i = 0; i < fft_size; i++) {
+    samples_[i] *= window_[i];
+  }
+  fft_.ComputePowerSpectrum(samples_.data(), power_.data());
+
+  // A full scale sine wave's bin has a magnitude of half the window's sum.
+  const double full_scale_power = window_sum_ * window_sum_ / 4;
+  const double min_power = std::pow(10.0, kMinLevelDb / 10.0);
+  const int last_bin = fft_size / 2;
+  const double bins_per_hz = static_cast<double>(fft_size) / sample_rate;
+  const double max_frequency = sample_rate / 2.0;
+  const double frequency_ratio =
+      std::max(1.0, max_frequency / kMinFrequencyHz);
+  for (int b = 0; b < band_count; b++) {
+    const double low_frequency =
+        kMinFrequencyHz * std::pow(frequency_ratio,
+                                   static_cast<double>(b) / band_count);
+    const double high_frequency =
+        kMinFrequencyHz * std::pow(frequency_ratio,
+                                   static_cast<double>(b + 1) / band_count);
+    const int low_bin =
+        static_cast<int>(std::lround(low_frequency * bins_per_hz));
+    const int high_bin =
+        static_cast<int>(std::lround(high_frequency * bins_per_hz));
+    const int first_bin = std::min(last_bin, std::max(1, low_bin));
+    const int end_bin =
+        std::min(last_bin + 1, std::max(first_bin + 1, high_bin));
+    const double power =
+        *std::max_element(power_.begin() + first_bin,
+                          power_.begin() + end_bin) /
+        full_scale_power;
+    bands[b] = static_cast<float>(10 * std::log10(std::max(power, min_power)));
+  }
+  return true;
+}
+
+}  // namespace exoplayer_jni
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_SPECTRUM_ANALYZER_H_
+#define EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_SPECTRUM_ANALYZER_H_
+
+#include <mutex>  // NOLINT
+#include <vector>
+
+#include "fft.h"  // NOLINT
+
+namespace exoplayer_jni {
+
+// Keeps the most recently decoded audio in a ring buffer, and computes its
+// spectrum on demand for audio visualizations, so that visualizers don't need
+// the decoded audio in Java.
+//
+// The channels are averaged as frames are added. The spectrum is computed from
+// the last |fft_size| frames, multiplied by a Hann window, with a RealFft, and
+// each band's level is the largest power of its bins. Bands are spaced
+// logarithmically from kMinFrequencyHz to half the sample rate, and bands
+// narrower than a bin take the nearest bin's power. Levels are in dB relative
+// to a full scale sine wave, and are at least kMinLevelDb.
+//
+// All methods are thread-safe. Frames are added by the decoding thread, which
+// only holds a lock while copying them to the ring buffer, and the spectrum is
+// computed by the thread that asks for it from a copy of the ring buffer, so
+// computing it doesn't block decoding.
+class SpectrumAnalyzer {
+ public:
+  static const int kMinFrequencyHz = 20;
+  static const int kMinLevelDb = -120;
+
+  SpectrumAnalyzer();
+
+  // Not copyable or movable.
+  SpectrumAnalyzer(const SpectrumAnalyzer&) = delete;
+  SpectrumAnalyzer& operator=(const SpectrumAnalyzer&) = delete;
+
+  // Configures the analyzer for |channel_count| channels at |sample_rate|, with
+  // an FFT of |fft_size| frames, and resets it. Returns false if the arguments
+  // are out of range or |fft_size| isn't a valid RealFft size.
+  bool Configure(int channel_count, int sample_rate, int fft_size);
+
+  // Adds |frame_count| interleaved frames.
+  void Add(const float* samples, int frame_count);
+
+  // Discards the frames that have been added. Called when the decoder is
+  // flushed, so that the spectrum doesn't show audio from before a seek.
+  void Reset();
+
+  // Computes the levels of |band_count| bands of the spectrum of the last
+  // frames, writing them to |bands| from the lowest band to the highest.
+  // Returns false if the analyzer isn't configured, |band_count| is less than
+  // 1 or more than half the FFT size, or fewer frames than the FFT size have
+  // been added since it was configured or reset.
+  bool ComputeBands(float* bands, int band_count);
+
+ private:
+  // Guards the ring buffer and the format. Acquired after |compute_mutex_|.
+  std::mutex ring_mutex_;
+  int channel_count_;
+  int sample_rate_;
+  // The averaged channels of the last frames. |write_position_| is the index
+  // that the next frame is written to, and |filled_| is whether the buffer
+  // holds a whole FFT of frames.
+  std::vector<float> ring_;
+  size_t write_position_;
+  bool filled_;
+
+  // Guards the FFT and its buffers, which are only used to compute spectra.
+  std::mutex compute_mutex_;
+  RealFft fft_;
+  std::vector<float> window_;
+  // The sum of the window, which a full scale sine wave's bin is scaled by.
+  double window_sum_;
+  std::vector<float> samples_;
+  std::vector<float> power_;
+};
+
+}  // namespace exoplayer_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_SPECTRUM_ANALYZER_H_
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "spsc_ring.h"  // NOLINT
+
+namespace exoplayer_jni {
+namespace {
+
+// Records are aligned to 8 bytes, the size of a header.
+const size_t kAlignment = 8;
+
+size_t Align(size_t size) {
+  return (size + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+}  // namespace
+
+SpscRing::SpscRing(size_t capacity)
+    : buffer_(Align(capacity) / sizeof(uint64_t)),
+      capacity_(Align(capacity)),
+      write_position_(0),
+      read_position_(0),
+      pending_position_(0),
+      pending_skip_(0) {}
+
+size_t SpscRing::GetRecordSize(size_t size) {
+  return sizeof(Header) + Align(size);
+}
+
+uint8_t* SpscRing::BeginWrite(size_t max_size) {
+  const size_t record_size = GetRecordSize(max_size);
+  const size_t write_position =
+      write_position_.load(std::memory_order_relaxed);
+  const size_t free_size =
+      capacity_ - (write_position -
+                   read_position_.load(std::memory_order_acquire));
+  const size_t offset = write_position % capacity_;
+  // Skips the rest of the buffer if the record doesn't fit before its end.
+  const size_t skip = offset + record_size > capacity_ ? capacity_ - offset : 0;
+  if (skip + record_size > free_size) {
+    return nullptr;
+  }
+  pending_position_ = write_position;
+  pending_skip_ = skip;
+  uint8_t* const data = reinterpret_cast<uint8_t*>(buffer_.data());
+  return data + (offset + skip) % capacity_ + sizeof(Header);
+}
+
+void SpscRing::EndWrite(size_t size) {
+  uint8_t* const data = reinterpret_cast<uint8_t*>(buffer_.data());
+  const size_t offset = pending_position_ % capacity_;
+  if (pending_skip_ > 0) {
+    reinterpret_cast<Header*>(data + offset)->size = kWrapMarker;
+  }
+  reinterpret_cast<Header*>(data + (offset + pending_skip_) % capacity_)
+      ->size = size;
+  write_position_.store(
+      pending_position_ + pending_skip_ + GetRecordSize(size),
+      std::memory_order_release);
+}
+
+const uint8_t* SpscRing::Peek(size_t* size) {
+  size_t read_position = read_position_.load(std::memory_order_relaxed);
+  if (read_position == write_position_.load(std::memory_order_acquire)) {
+    return nullptr;
+  }
+  const uint8_t* const data = reinterpret_cast<const uint8_t*>(buffer_.data());
+  const Header* header =
+      reinterpret_cast<const Header*>(data + read_position % capacity_);
+  if (header->size == kWrapMarker) {
+    // The producer publishes the marker together with the record after it.
+    read_position += capacity_ - read_position % capacity_;
+    read_position_.store(read_position, std::memory_order_release);
+    header = reinterpret_cast<const Header*>(data);
+  }
+  *size = header->size;
+  return reinterpret_cast<const uint8_t*>(header + 1);
+}
+
+void SpscRing::Pop() {
+  const size_t read_position = read_position_.load(std::memory_order_relaxed);
+  const uint8_t* const data = reinterpret_cast<const uint8_t*>(buffer_.data());
+  const Header* header =
+      reinterpret_cast<const Header*>(data + read_position % capacity_);
+  read_position_.store(read_position + GetRecordSize(header->size),
+                       std::memory_order_release);
+}
+
+bool SpscRing::IsEmpty() const {
+  return read_position_.load(std::memory_order_acquire) ==
+         write_position_.load(std::memory_order_acquire);
+}
+
+void SpscRing::Clear() {
+  read_position_.store(write_position_.load(std::memory_order_relaxed),
+                       std::memory_order_relaxed);
+}
+
+}  // namespace exoplayer_jni
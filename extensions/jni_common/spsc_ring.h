@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_SPSC_RING_H_
+#define EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_SPSC_RING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace exoplayer_jni {
+
+// A lock-free ring buffer of variable size records, for passing data from one
+// producer thread to one consumer thread without copying it more than once on
+// each side.
+//
+// The producer reserves contiguous space for a record with BeginWrite, writes
+// it in place and publishes it with EndWrite. The consumer reads the oldest
+// record in place with Peek and frees it with Pop. Records are 8-byte aligned,
+// and a record that doesn't fit before the end of the buffer starts at its
+// beginning, so a record can take up to twice its size. Neither side blocks;
+// threads that need to wait for space or records must arrange it themselves.
+class SpscRing {
+ public:
+  // Creates a ring with at least |capacity| bytes of space for records and
+  // their headers.
+  explicit SpscRing(size_t capacity);
+
+  // Not copyable or movable.
+  SpscRing(const SpscRing&) = delete;
+  SpscRing& operator=(const SpscRing&) = delete;
+
+  // Returns the number of bytes that a record of |size| bytes takes, including
+  // its header and padding but not space skipped at the end of the buffer.
+  static size_t GetRecordSize(size_t size);
+
+  // Producer: returns space for a record of up to |max_size| bytes, or null if
+  // there isn't room for it. The record isn't visible to the consumer until
+  // EndWrite is called.
+  uint8_t* BeginWrite(size_t max_size);
+  // Producer: publishes the first |size| bytes of the record returned by the
+  // last BeginWrite call, where |size| is at most the |max_size| passed to it.
+  void EndWrite(size_t size);
+
+  // Consumer: returns the oldest record and sets |size| to its size, or returns
+  // null if there are no records. The record remains valid until Pop is called.
+  const uint8_t* Peek(size_t* size);
+  // Consumer: frees the record returned by the last Peek call.
+  void Pop();
+
+  // Returns whether there are no records. May be called from either thread.
+  bool IsEmpty() const;
+
+  // Discards all records. Must only be called while neither thread is using
+  // the ring.
+  void Clear();
+
+ private:
+  // A record's header, which holds its size or kWrapMarker.
+  struct Header {
+    uint64_t size;
+  };
+
+  // The size of a header that marks the rest of the buffer as skipped.
+  static const uint64_t kWrapMarker = UINT64_MAX;
+
+  std::vector<uint64_t> buffer_;
+  const size_t capacity_;
+  // Monotonic byte positions, which are wrapped to the buffer's capacity when
+  // they're used.
+  std::atomic<size_t> write_position_;
+  std::atomic<size_t> read_position_;
+
+  // Producer state for the record being written.
+  size_t pending_position_;
+  size_t pending_skip_;
+};
+
+}  // namespace exoplayer_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_SPSC_RING_H_
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_STATUS_BLOCK_H_
+#define EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_STATUS_BLOCK_H_
+
+#include <jni.h>
+
+#include <cstdint>
+
+namespace exoplayer_jni {
+
+// A block of 64-bit values that a native decoder publishes its per-frame state
+// into, such as positions, format and error codes. The Java side wraps the
+// block in a direct ByteBuffer once, and then reads values from it directly
+// instead of making a JNI call per value.
+//
+// Values are written with plain stores, so they must be read on the thread
+// that wrote them, or on a thread that has synchronized with it. In practice
+// they're read on the decoding thread after the native call that published
+// them returns. Each value occupies 8 bytes at offset slot * 8, in native byte
+// order.
+template <int kSlotCount>
+class StatusBlock {
+ public:
+  StatusBlock() : slots_() {}
+
+  // Not copyable or movable, since the Java side holds a pointer to it.
+  StatusBlock(const StatusBlock&) = delete;
+  StatusBlock& operator=(const StatusBlock&) = delete;
+
+  void Set(int slot, int64_t value) { slots_[slot] = value; }
+
+  int64_t Get(int slot) const { return slots_[slot]; }
+
+  // Returns a new direct ByteBuffer that wraps the block. The buffer must not
+  // be accessed after the block is destroyed.
+  jobject NewByteBuffer(JNIEnv* env) {
+    return env->NewDirectByteBuffer(slots_, sizeof(slots_));
+  }
+
+ private:
+  alignas(8) int64_t slots_[kSlotCount];
+};
+
+}  // namespace exoplayer_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_STATUS_BLOCK_H_
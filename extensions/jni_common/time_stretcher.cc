@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "time_stretcher.h"  // NOLINT
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "cpu_dispatch.h"  // NOLINT
+
+namespace exoplayer_jni {
+
+TimeStretcher::TimeStretcher()
+    : channel_count_(0),
+      hop_frame_count_(0),
+      search_frame_count_(0),
+      analysis_hop_(0),
+      position_(0),
+      has_overlap_(false) {}
+
+int TimeStretcher::GetHopFrameCount(int sample_rate) {
+  return std::max(1, sample_rate / 100);
+}
+
+bool TimeStretcher::Configure(int channel_count, int sample_rate,
+                              double factor) {
+  if (channel_count <= 0 || sample_rate <= 0 || !(factor >= 1.0 / 64) ||
+      !(factor <= 64)) {
+    return false;
+  }
+  channel_count_ = channel_count;
+  hop_frame_count_ = GetHopFrameCount(sample_rate);
+  search_frame_count_ = hop_frame_count_ / 2;
+  analysis_hop_ = hop_frame_count_ / factor;
+  overlap_.resize(static_cast<size_t>(hop_frame_count_) * channel_count_);
+  overlap_mono_.resize(hop_frame_count_);
+  energy_sums_.resize(2 * search_frame_count_ + hop_frame_count_ + 1);
+  overlap_coarse_.resize(hop_frame_count_ / kCoarseSearchStep);
+  window_coarse_.resize(
+      (2 * search_frame_count_ + hop_frame_count_) / kCoarseSearchStep + 1);
+  Reset();
+  return true;
+}
+
+int TimeStretcher::GetMaxOutputFrameCount(int frame_count) const {
+  // Each step is taken once the buffered input extends a fixed distance past
+  // the step's ideal segment start, and advances it by the analysis hop, so
+  // at most (frame_count / analysis_hop_) + 1 steps are taken. One more frame
+  // of input is allowed for the rounding of the ideal segment start.
+  return (static_cast<int>((frame_count + 1) / analysis_hop_) + 1) *
+         hop_frame_count_;
+}
+
+int TimeStretcher::Process(const float* input, int frame_count,
+                           float* output) {
+  input_.insert(input_.end(), input, input + frame_count * channel_count_);
+  const float mono_scale = 1.0f / channel_count_;
+  for (int i = 0; i < frame_count; i++) {
+    float sum = 0;
+    for (int c = 0; c < channel_count_; c++) {
+      sum += input[c];
+    }
+    input_mono_.push_back(sum * mono_scale);
+    input += channel_count_;
+  }
+
+  const int hop_sample_count = hop_frame_count_ * channel_count_;
+  const int buffered_frame_count = static_cast<int>(input_mono_.size());
+  int output_frame_count = 0;
+  while (static_cast<int>(position_) + search_frame_count_ +
+             2 * hop_frame_count_ <=
+         buffered_frame_count) {
+    const int ideal_start = static_cast<int>(position_);
+    const int start =
+        has_overlap_ ? FindSegmentStart(ideal_start) : ideal_start;
+    const float* segment = input_.data() + start * channel_count_;
+    if (has_overlap_) {
+      const float fade_step = 1.0f / hop_frame_count_;
+      for (int i = 0; i < hop_frame_count_; i++) {
+        const float fade_in = (i + 0.5f) * fade_step;
+        for (int c = 0; c < channel_count_; c++) {
+          const int index = i * channel_count_ + c;
+          output[index] =
+              overlap_[index] + (segment[index] - overlap_[index]) * fade_in;
+        }
+      }
+    } else {
+      std::memcpy(output, segment, hop_sample_count * sizeof(float));
+    }
+    std::memcpy(overlap_.data(), segment + hop_sample_count,
+                hop_sample_count * sizeof(float));
+    std::memcpy(overlap_mono_.data(),
+                input_mono_.data() + start + hop_frame_count_,
+                hop_frame_count_ * sizeof(float));
+    has_overlap_ = true;
+    position_ += analysis_hop_;
+    output += hop_sample_count;
+    output_frame_count += hop_frame_count_;
+  }
+
+  // Discards the input before the earliest start of the next segment.
+  const int discard_frame_count =
+      std::min(buffered_frame_count,
+               std::max(0, static_cast<int>(position_) - search_frame_count_));
+  input_.erase(input_.begin(),
+               input_.begin() + discard_frame_count * channel_count_);
+  input_mono_.erase(input_mono_.begin(),
+                    input_mono_.begin() + discard_frame_count);
+  position_ -= discard_frame_count;
+  return output_frame_count;
+}
+
+void TimeStretcher::Reset() {
+  position_ = 0;
+  has_overlap_ = false;
+  input_.clear();
+  input_mono_.clear();
+}
+
+int TimeStretcher::FindSegmentStart(int ideal_start) {
+  const int first_start = std::max(0, ideal_start - search_frame_count_);
+  const int last_start = ideal_start + search_frame_count_;
+  const float* mono = input_mono_.data();
+  energy_sums_[0] = 0;
+  for (int i = first_start; i < last_start + hop_frame_count_; i++) {
+    const double sample = mono[i];
+    energy_sums_[i - first_start + 1] =
+        energy_sums_[i - first_start] + sample * sample;
+  }
+  const DotProductFunction dot_product = GetKernels().dot_product;
+  // Maximizes the cross-correlation normalized by the candidate's energy. The
+  // energy of the previous segment's overlap is the same for every candidate.
+  auto score = [&](int start) {
+    const double energy = energy_sums_[start - first_start + hop_frame_count_] -
+                          energy_sums_[start - first_start];
+    if (energy <= 0) {
+      return 0.0;
+    }
+    return dot_product(overlap_mono_.data(), mono + start, hop_frame_count_) /
+           std::sqrt(energy);
+  };
+
+  // The coarse pass correlates the downmixes decimated by kCoarseSearchStep, at
+  // every kCoarseSearchStep-th start, which is kCoarseSearchStep^2 times less
+  // work than correlating them at full rate.
+  const int coarse_length = hop_frame_count_ / kCoarseSearchStep;
+  const int coarse_count = (last_start - first_start) / kCoarseSearchStep + 1;
+  int best_start = ideal_start;
+  double best_score = score(ideal_start);
+  if (coarse_length > 0) {
+    Decimate(overlap_mono_.data(), coarse_length, overlap_coarse_.data());
+    Decimate(mono + first_start, coarse_count + coarse_length - 1,
+             window_coarse_.data());
+    for (int i = 0; i < coarse_count; i++) {
+      const int start = first_start + i * kCoarseSearchStep;
+      const double energy =
+          energy_sums_[start - first_start + hop_frame_count_] -
+          energy_sums_[start - first_start];
+      if (energy <= 0) {
+        continue;
+      }
+      const double start_score =
+          dot_product(overlap_coarse_.data(), window_coarse_.data() + i,
+                      coarse_length) *
+          kCoarseSearchStep / std::sqrt(energy);
+      if (start_score > best_score) {
+        best_start = start;
+        best_score = start_score;
+      }
+    }
+    // Rescores the best coarse start at full rate, so that the refinement
+    // compares like with like.
+    best_score = score(best_start);
+  }
+  const int coarse_start = best_start;
+  const int refine_first =
+      std::max(first_start, coarse_start - kCoarseSearchStep + 1);
+  const int refine_last =
+      std::min(last_start, coarse_start + kCoarseSearchStep - 1);
+  for (int start = refine_first; start <= refine_last; start++) {
+    const double start_score = score(start);
+    if (start_score > best_score) {
+      best_start = start;
+      best_score = start_score;
+    }
+  }
+  return best_start;
+}
+
+void TimeStretcher::Decimate(const float* input, int output_count,
+                             float* output) {
+  const float scale = 1.0f / kCoarseSearchStep;
+  for (int i = 0; i < output_count; i++) {
+    float sum = 0;
+    for (int j = 0; j < kCoarseSearchStep; j++) {
+      sum += input[j];
+    }
+    output[i] = sum * scale;
+    input += kCoarseSearchStep;
+  }
+}
+
+}  // namespace exoplayer_jni
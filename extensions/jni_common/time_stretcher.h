@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_TIME_STRETCHER_H_
+#define EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_TIME_STRETCHER_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace exoplayer_jni {
+
+// Changes the duration of interleaved float audio without changing its pitch,
+// using WSOLA (waveform similarity overlap-add).
+//
+// The output is built from segments of two hops of input, which overlap by one
+// hop and are cross-faded linearly. The segments are read from the input every
+// analysis hop, which is the hop divided by the stretch factor. Each segment's
+// start is moved by up to half a hop from its ideal position to where its first
+// hop best matches the second hop of the previous segment, as measured by the
+// normalized cross-correlation of the mono downmix, so that the overlapping
+// waveforms are in phase. The search is first done at every fourth position on
+// the downmix decimated by four, and then refined at the full rate around the
+// best match, using the dot product kernel from GetKernels().
+//
+// The output lags the input by up to two and a half hops, which is held back
+// until more input arrives. Not thread-safe.
+class TimeStretcher {
+ public:
+  TimeStretcher();
+
+  // Not copyable or movable.
+  TimeStretcher(const TimeStretcher&) = delete;
+  TimeStretcher& operator=(const TimeStretcher&) = delete;
+
+  // Returns the number of frames in a hop, which is 10 ms, for audio at
+  // |sample_rate|.
+  static int GetHopFrameCount(int sample_rate);
+
+  // Configures the stretcher for |channel_count| channels at |sample_rate|, so
+  // that it outputs |factor| frames per input frame, and resets it. Returns
+  // false if the arguments are out of range.
+  bool Configure(int channel_count, int sample_rate, double factor);
+
+  // Returns the maximum number of frames that processing |frame_count| input
+  // frames can output, whether in one call to Process() or split over several.
+  int GetMaxOutputFrameCount(int frame_count) const;
+
+  // Processes |frame_count| input frames, writing the output to |output|, which
+  // must have room for GetMaxOutputFrameCount(frame_count) frames. Returns the
+  // number of frames written.
+  int Process(const float* input, int frame_count, float* output);
+
+  // Discards the buffered input. Called when the decoder is flushed.
+  void Reset();
+
+ private:
+  // The step of the first pass of the search for a segment's start.
+  static const int kCoarseSearchStep = 4;
+
+  // Returns the start of the next segment, within |search_frame_count_| frames
+  // of |ideal_start|.
+  int FindSegmentStart(int ideal_start);
+  // Writes the averages of |output_count| consecutive groups of
+  // kCoarseSearchStep samples of |input| to |output|.
+  static void Decimate(const float* input, int output_count, float* output);
+
+  int channel_count_;
+  int hop_frame_count_;
+  int search_frame_count_;
+  double analysis_hop_;
+
+  // The ideal start of the next segment, relative to the buffered input.
+  double position_;
+  // Whether |overlap_| holds the second hop of the previous segment.
+  bool has_overlap_;
+
+  std::vector<float> input_;
+  std::vector<float> input_mono_;
+  std::vector<float> overlap_;
+  std::vector<float> overlap_mono_;
+  // Prefix sums of the squared mono samples in the search range.
+  std::vector<double> energy_sums_;
+  // The decimated downmixes of |overlap_mono_| and of the search range.
+  std::vector<float> overlap_coarse_;
+  std::vector<float> window_coarse_;
+};
+
+}  // namespace exoplayer_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_TIME_STRETCHER_H_
@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "trace.h"  // NOLINT
+
+#if defined(EXOPLAYER_JNI_TRACING)
+
+#if defined(__ANDROID__)
+
+#include <dlfcn.h>
+
+namespace exoplayer_jni {
+namespace {
+
+// The ATrace functions were added to the NDK in API level 23, so they're loaded
+// at runtime to support older devices.
+struct ATraceFunctions {
+  bool (*is_enabled)();
+  void (*begin_section)(const char* section_name);
+  void (*end_section)();
+};
+
+ATraceFunctions LoadATraceFunctions() {
+  ATraceFunctions functions = {};
+  void* library = dlopen("libandroid.so", RTLD_NOW | RTLD_LOCAL);
+  if (library == nullptr) {
+    return functions;
+  }
+  functions.is_enabled = reinterpret_cast<bool (*)()>(
+      dlsym(library, "ATrace_isEnabled"));
+  functions.begin_section = reinterpret_cast<void (*)(const char*)>(
+      dlsym(library, "ATrace_beginSection"));
+  functions.end_section =
+      reinterpret_cast<void (*)()>(dlsym(library, "ATrace_endSection"));
+  if (!functions.is_enabled || !functions.begin_section ||
+      !functions.end_section) {
+    functions = {};
+  }
+  return functions;
+}
+
+const ATraceFunctions& GetATraceFunctions() {
+  static const ATraceFunctions functions = LoadATraceFunctions();
+  return functions;
+}
+
+}  // namespace
+
+bool IsTracingEnabled() {
+  const ATraceFunctions& functions = GetATraceFunctions();
+  return functions.is_enabled && functions.is_enabled();
+}
+
+void BeginTraceSection(const char* name) {
+  GetATraceFunctions().begin_section(name);
+}
+
+void EndTraceSection() { GetATraceFunctions().end_section(); }
+
+void FlushTrace() {}
+
+}  // namespace exoplayer_jni
+
+#else  // defined(__ANDROID__)
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>  // NOLINT
+#include <vector>
+
+#include "decoder_stats.h"  // NOLINT
+
+namespace exoplayer_jni {
+namespace {
+
+struct OpenSection {
+  const char* name;
+  int64_t start_time_us;
+};
+
+struct CompleteEvent {
+  const char* name;
+  int64_t start_time_us;
+  int64_t duration_us;
+  int64_t thread_id;
+};
+
+const char* GetTraceFilePath() {
+  static const char* const path = getenv("EXOPLAYER_TRACE_FILE");
+  return path;
+}
+
+std::mutex& GetEventsMutex() {
+  static std::mutex* const mutex = new std::mutex();
+  return *mutex;
+}
+
+// Guarded by GetEventsMutex().
+std::vector<CompleteEvent>& GetEvents() {
+  static std::vector<CompleteEvent>* const events =
+      new std::vector<CompleteEvent>();
+  return *events;
+}
+
+thread_local std::vector<OpenSection> open_sections;
+
+int64_t GetThreadId() { return static_cast<int64_t>(syscall(SYS_gettid)); }
+
+void FlushTraceAtExit() { FlushTrace(); }
+
+}  // namespace
+
+bool IsTracingEnabled() {
+  static const bool enabled = [] {
+    if (GetTraceFilePath() == nullptr) {
+      return false;
+    }
+    atexit(FlushTraceAtExit);
+    return true;
+  }();
+  return enabled;
+}
+
+void BeginTraceSection(const char* name) {
+  open_sections.push_back({name, GetMonotonicTimeUs()});
+}
+
+void EndTraceSection() {
+  if (open_sections.empty()) {
+    return;
+  }
+  const OpenSection section = open_sections.back();
+  open_sections.pop_back();
+  const CompleteEvent event = {section.name, section.start_time_us,
+                               GetMonotonicTimeUs() - section.start_time_us,
+                               GetThreadId()};
+  std::lock_guard<std::mutex> lock(GetEventsMutex());
+  GetEvents().push_back(event);
+}
+
+void FlushTrace() {
+  const char* path = GetTraceFilePath();
+  if (path == nullptr) {
+    return;
+  }
+  FILE* file = fopen(path, "w");
+  if (file == nullptr) {
+    return;
+  }
+  const int64_t process_id = getpid();
+  std::lock_guard<std::mutex> lock(GetEventsMutex());
+  const std::vector<CompleteEvent>& events = GetEvents();
+  fprintf(file, "{\"traceEvents\":[");
+  for (size_t i = 0; i < events.size(); i++) {
+    const CompleteEvent& event = events[i];
+    fprintf(file,
+            "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%" PRId64
+            ",\"dur\":%" PRId64 ",\"pid\":%" PRId64 ",\"tid\":%" PRId64 "}",
+            i == 0 ? "" : ",", event.name, event.start_time_us,
+            event.duration_us, process_id, event.thread_id);
+  }
+  fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+  fclose(file);
+}
+
+}  // namespace exoplayer_jni
+
+#endif  // defined(__ANDROID__)
+
+#endif  // defined(EXOPLAYER_JNI_TRACING)
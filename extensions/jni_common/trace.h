@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_TRACE_H_
+#define EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_TRACE_H_
+
+// Trace sections for the decode hot paths.
+//
+// Tracing is compiled out unless EXOPLAYER_JNI_TRACING is defined, so that
+// EXO_TRACE_SCOPE expands to an empty statement and has no cost. When it is
+// defined, sections are emitted with ATrace on Android, so that they show up in
+// systrace and Perfetto. On other platforms they're collected in memory and
+// written as Chrome trace JSON to the file named by the EXOPLAYER_TRACE_FILE
+// environment variable when the process exits or FlushTrace() is called.
+//
+// Section names must be string literals, since they're referenced after the
+// section ends. Use the names below for the sections that are common to all
+// extensions, prefixed with the extension name, for example "vpx:decode".
+//
+//   decode         Decoding input with the codec library.
+//   convert        Converting decoded output to the output format.
+//   copy           Copying decoded output to an output buffer or surface.
+//   renderLock     Locking a native window for rendering.
+//   renderPost     Unlocking and posting a native window.
+//   bufferAcquire  Acquiring a frame buffer for the codec library.
+//   bufferRelease  Releasing a frame buffer.
+
+#if defined(EXOPLAYER_JNI_TRACING)
+
+#define EXO_TRACE_CONCAT_INNER(a, b) a##b
+#define EXO_TRACE_CONCAT(a, b) EXO_TRACE_CONCAT_INNER(a, b)
+
+// Traces the rest of the enclosing scope as a section called |name|.
+#define EXO_TRACE_SCOPE(name)   \
+  ::exoplayer_jni::ScopedTrace \
+  EXO_TRACE_CONCAT(exo_trace_scope_, __LINE__)(name)
+
+namespace exoplayer_jni {
+
+// Returns whether sections are currently being recorded.
+bool IsTracingEnabled();
+
+// Begins a section on the calling thread. Sections must be strictly nested.
+void BeginTraceSection(const char* name);
+
+// Ends the innermost section on the calling thread.
+void EndTraceSection();
+
+// Writes the sections collected so far to the trace file. Does nothing on
+// Android, where sections are recorded by the system.
+void FlushTrace();
+
+// Traces the lifetime of the object as a section.
+class ScopedTrace {
+ public:
+  explicit ScopedTrace(const char* name) : enabled_(IsTracingEnabled()) {
+    if (enabled_) {
+      BeginTraceSection(name);
+    }
+  }
+
+  ~ScopedTrace() {
+    if (enabled_) {
+      EndTraceSection();
+    }
+  }
+
+  // Not copyable or movable.
+  ScopedTrace(const ScopedTrace&) = delete;
+  ScopedTrace& operator=(const ScopedTrace&) = delete;
+
+ private:
+  const bool enabled_;
+};
+
+}  // namespace exoplayer_jni
+
+#else  // defined(EXOPLAYER_JNI_TRACING)
+
+#define EXO_TRACE_SCOPE(name) \
+  do {                        \
+  } while (0)
+
+namespace exoplayer_jni {
+
+inline void FlushTrace() {}
+
+}  // namespace exoplayer_jni
+
+#endif  // defined(EXOPLAYER_JNI_TRACING)
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_TRACE_H_
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "video_kernels.h"  // NOLINT
+
+#include <cstring>
+
+namespace exoplayer_jni {
+
+void Convert10To8PlaneC(const uint8_t* source, int source_stride,
+                        uint8_t* destination, int destination_stride,
+                        int width, int height) {
+  int sample = 0;
+  for (int i = 0; i < height; i++) {
+    const uint16_t* source_16 = reinterpret_cast<const uint16_t*>(source);
+    for (int j = 0; j < width; j++) {
+      // Lightweight dither. Carryover the remainder of each 10->8 bit
+      // conversion to the next pixel.
+      sample += source_16[j];
+      const int value = sample >> 2;
+      destination[j] = value > 255 ? 255 : value;
+      sample &= 3;  // Remainder.
+    }
+    source += source_stride;
+    destination += destination_stride;
+  }
+}
+
+void CopyPlane(const uint8_t* source, int source_stride, uint8_t* destination,
+               int destination_stride, int width, int height) {
+  while (height--) {
+    std::memcpy(destination, source, width);
+    source += source_stride;
+    destination += destination_stride;
+  }
+}
+
+}  // namespace exoplayer_jni
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_VIDEO_KERNELS_H_
+#define EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_VIDEO_KERNELS_H_
+
+#include <cstdint>
+
+namespace exoplayer_jni {
+
+// Converts a plane of |width| x |height| 10-bit samples, each stored in the
+// low bits of a uint16_t, to 8-bit samples. A lightweight dither is applied so
+// that the dropped bits don't cause banding. Strides are in bytes.
+typedef void (*Convert10To8PlaneFunction)(const uint8_t* source,
+                                          int source_stride,
+                                          uint8_t* destination,
+                                          int destination_stride, int width,
+                                          int height);
+
+// Portable implementation. Carries the remainder of each conversion over to
+// the next sample.
+void Convert10To8PlaneC(const uint8_t* source, int source_stride,
+                        uint8_t* destination, int destination_stride,
+                        int width, int height);
+
+#if defined(__arm__) || defined(__aarch64__)
+// NEON implementation. Adds a random bias before dropping the low bits.
+void Convert10To8PlaneNeon(const uint8_t* source, int source_stride,
+                           uint8_t* destination, int destination_stride,
+                           int width, int height);
+#endif  // defined(__arm__) || defined(__aarch64__)
+
+#if defined(__i386__) || defined(__x86_64__)
+// SSE2 and AVX2 implementations. Bit exact with Convert10To8PlaneC.
+void Convert10To8PlaneSse2(const uint8_t* source, int source_stride,
+                           uint8_t* destination, int destination_stride,
+                           int width, int height);
+void Convert10To8PlaneAvx2(const uint8_t* source, int source_stride,
+                           uint8_t* destination, int destination_stride,
+                           int width, int height);
+#endif  // defined(__i386__) || defined(__x86_64__)
+
+// Copies |height| rows of |width| bytes between planes with the given strides.
+void CopyPlane(const uint8_t* source, int source_stride, uint8_t* destination,
+               int destination_stride, int width, int height);
+
+}  // namespace exoplayer_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_VIDEO_KERNELS_H_
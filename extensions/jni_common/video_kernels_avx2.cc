@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "video_kernels.h"  // NOLINT
+
+#if defined(__i386__) || defined(__x86_64__)
+
+#include <immintrin.h>
+
+namespace exoplayer_jni {
+namespace {
+
+// The x86 ABIs don't guarantee AVX2, so these functions are compiled for AVX2
+// individually and must only be called if the CPU supports it.
+
+// Converts sixteen samples as Convert10To8PlaneC does. See
+// ConvertEightSamples in video_kernels_sse2.cc.
+__attribute__((target("avx2"))) inline __m256i ConvertSixteenSamples(
+    __m256i values, __m256i* carry) {
+  const __m256i remainder_mask = _mm256_set1_epi16(3);
+  const __m256i low_bits = _mm256_and_si256(values, remainder_mask);
+  // Byte shifts work within 128-bit lanes, so the prefix sum is computed in
+  // each lane, and the low lane's total is then added to the high lane.
+  __m256i prefix_sum =
+      _mm256_add_epi16(low_bits, _mm256_slli_si256(low_bits, 2));
+  prefix_sum = _mm256_add_epi16(prefix_sum, _mm256_slli_si256(prefix_sum, 4));
+  prefix_sum = _mm256_add_epi16(prefix_sum, _mm256_slli_si256(prefix_sum, 8));
+  __m256i lane_totals =
+      _mm256_shufflehi_epi16(prefix_sum, _MM_SHUFFLE(3, 3, 3, 3));
+  lane_totals = _mm256_unpackhi_epi64(lane_totals, lane_totals);
+  prefix_sum = _mm256_add_epi16(
+      prefix_sum, _mm256_permute2x128_si256(lane_totals, lane_totals, 0x08));
+  prefix_sum = _mm256_add_epi16(prefix_sum, *carry);
+  const __m256i carried_in =
+      _mm256_and_si256(_mm256_sub_epi16(prefix_sum, low_bits), remainder_mask);
+  const __m256i converted =
+      _mm256_srli_epi16(_mm256_adds_epu16(values, carried_in), 2);
+  __m256i last = _mm256_shufflehi_epi16(prefix_sum, _MM_SHUFFLE(3, 3, 3, 3));
+  last = _mm256_unpackhi_epi64(last, last);
+  *carry = _mm256_and_si256(_mm256_permute2x128_si256(last, last, 0x11),
+                            remainder_mask);
+  return converted;
+}
+
+}  // namespace
+
+__attribute__((target("avx2"))) void Convert10To8PlaneAvx2(
+    const uint8_t* source, int source_stride, uint8_t* destination,
+    int destination_stride, int width, int height) {
+  __m256i carry = _mm256_setzero_si256();
+  for (int i = 0; i < height; i++) {
+    const uint16_t* source_16 = reinterpret_cast<const uint16_t*>(source);
+
+    const int j_max = width & ~31;
+    int j;
+    for (j = 0; j < j_max; j += 32) {
+      const __m256i values_1 = ConvertSixteenSamples(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source_16 + j)),
+          &carry);
+      const __m256i values_2 = ConvertSixteenSamples(
+          _mm256_loadu_si256(
+              reinterpret_cast<const __m256i*>(source_16 + j + 16)),
+          &carry);
+      // Packing works within 128-bit lanes, so the 64-bit quarters have to be
+      // put back in order afterwards.
+      const __m256i packed = _mm256_permute4x64_epi64(
+          _mm256_packus_epi16(values_1, values_2), _MM_SHUFFLE(3, 1, 2, 0));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + j), packed);
+    }
+
+    if (j < width) {
+      int sample = _mm_cvtsi128_si32(_mm256_castsi256_si128(carry)) & 3;
+      for (; j < width; j++) {
+        sample += source_16[j];
+        const int value = sample >> 2;
+        destination[j] = value > 255 ? 255 : value;
+        sample &= 3;
+      }
+      carry = _mm256_set1_epi16(static_cast<int16_t>(sample));
+    }
+
+    source += source_stride;
+    destination += destination_stride;
+  }
+}
+
+}  // namespace exoplayer_jni
+
+#endif  // defined(__i386__) || defined(__x86_64__)
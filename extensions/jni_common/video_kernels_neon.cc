@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "video_kernels.h"  // NOLINT
+
+#if defined(__arm__) || defined(__aarch64__)
+
+#include <arm_neon.h>
+
+#include <cstdlib>
+
+namespace exoplayer_jni {
+
+void Convert10To8PlaneNeon(const uint8_t* source, int source_stride,
+                           uint8_t* destination, int destination_stride,
+                           int width, int height) {
+  uint32x2_t lcg_value = vdup_n_u32(random());
+  lcg_value = vset_lane_u32(random(), lcg_value, 1);
+  // LCG values recommended in "Numerical Recipes".
+  const uint32x2_t LCG_MULT = vdup_n_u32(1664525);
+  const uint32x2_t LCG_INCR = vdup_n_u32(1013904223);
+
+  for (int i = 0; i < height; i++) {
+    const uint16_t* source_16 = reinterpret_cast<const uint16_t*>(source);
+
+    // Each read consumes 4 2-byte samples, but to reduce branches and random
+    // steps we unroll to 4 rounds, so each loop consumes 16 samples.
+    const int j_max = width & ~15;
+    int j;
+    for (j = 0; j < j_max; j += 16) {
+      // Run a round of the RNG.
+      lcg_value = vmla_u32(LCG_INCR, lcg_value, LCG_MULT);
+
+      // Round 1.
+      // The lower two bits of this LCG parameterization are garbage, leaving
+      // streaks on the image. We access the upper bits of each 16-bit lane by
+      // shifting. (We use this both as an 8- and 16-bit vector, so the choice
+      // of which one to keep it as is arbitrary.)
+      uint8x8_t randvec =
+          vreinterpret_u8_u16(vshr_n_u16(vreinterpret_u16_u32(lcg_value), 8));
+
+      // We retrieve the values and shift them so that the bits we'll shift out
+      // (after biasing) are in the upper 8 bits of each 16-bit lane.
+      uint16x4_t values = vshl_n_u16(vld1_u16(source_16 + j), 6);
+      // We add the bias bits in the lower 8 to the shifted values to get the
+      // final values in the upper 8 bits.
+      uint16x4_t added_1 = vqadd_u16(values, vreinterpret_u16_u8(randvec));
+
+      // Round 2.
+      // Shifting the randvec bits left by 2 bits, as an 8-bit vector, should
+      // leave us with enough bias to get the needed rounding operation.
+      randvec = vshl_n_u8(randvec, 2);
+
+      // Retrieve and sum the next 4 pixels.
+      values = vshl_n_u16(vld1_u16(source_16 + j + 4), 6);
+      uint16x4_t added_2 = vqadd_u16(values, vreinterpret_u16_u8(randvec));
+
+      // Reinterpret the two added vectors as 8x8, zip them together, and
+      // discard the lower portions.
+      uint8x8_t zipped =
+          vuzp_u8(vreinterpret_u8_u16(added_1), vreinterpret_u8_u16(added_2))
+              .val[1];
+      vst1_u8(destination + j, zipped);
+
+      // Run it again with the next two rounds using the remaining entropy in
+      // randvec.
+
+      // Round 3.
+      randvec = vshl_n_u8(randvec, 2);
+      values = vshl_n_u16(vld1_u16(source_16 + j + 8), 6);
+      added_1 = vqadd_u16(values, vreinterpret_u16_u8(randvec));
+
+      // Round 4.
+      randvec = vshl_n_u8(randvec, 2);
+      values = vshl_n_u16(vld1_u16(source_16 + j + 12), 6);
+      added_2 = vqadd_u16(values, vreinterpret_u16_u8(randvec));
+
+      zipped =
+          vuzp_u8(vreinterpret_u8_u16(added_1), vreinterpret_u8_u16(added_2))
+              .val[1];
+      vst1_u8(destination + j + 8, zipped);
+    }
+
+    uint32_t randval = 0;
+    // For the remaining pixels in each row - usually none, as most standard
+    // sizes are divisible by 16 - convert them "by hand".
+    for (; j < width; j++) {
+      if (!randval) randval = random();
+      const int value = (source_16[j] + (randval & 3)) >> 2;
+      destination[j] = value > 255 ? 255 : value;
+      randval >>= 2;
+    }
+
+    source += source_stride;
+    destination += destination_stride;
+  }
+}
+
+}  // namespace exoplayer_jni
+
+#endif  // defined(__arm__) || defined(__aarch64__)
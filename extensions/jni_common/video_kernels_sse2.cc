@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "video_kernels.h"  // NOLINT
+
+#if defined(__i386__) || defined(__x86_64__)
+
+#include <emmintrin.h>
+
+namespace exoplayer_jni {
+namespace {
+
+// Converts eight samples as Convert10To8PlaneC does, given the remainder
+// carried over from the previous sample in every lane of |carry|, and updates
+// |carry| to the remainder after the last sample. Returns the converted samples
+// in 16-bit lanes, which may exceed 255.
+inline __m128i ConvertEightSamples(__m128i values, __m128i* carry) {
+  const __m128i remainder_mask = _mm_set1_epi16(3);
+  // The remainder after each sample is the carry plus the sum of the low two
+  // bits of the samples up to and including it, modulo 4, so the carry chain
+  // is a prefix sum.
+  const __m128i low_bits = _mm_and_si128(values, remainder_mask);
+  __m128i prefix_sum = _mm_add_epi16(low_bits, _mm_slli_si128(low_bits, 2));
+  prefix_sum = _mm_add_epi16(prefix_sum, _mm_slli_si128(prefix_sum, 4));
+  prefix_sum = _mm_add_epi16(prefix_sum, _mm_slli_si128(prefix_sum, 8));
+  prefix_sum = _mm_add_epi16(prefix_sum, *carry);
+  const __m128i carried_in =
+      _mm_and_si128(_mm_sub_epi16(prefix_sum, low_bits), remainder_mask);
+  // Saturating, so that samples with bits set above the tenth still convert
+  // to at least 255.
+  const __m128i converted =
+      _mm_srli_epi16(_mm_adds_epu16(values, carried_in), 2);
+  const __m128i last =
+      _mm_shufflehi_epi16(prefix_sum, _MM_SHUFFLE(3, 3, 3, 3));
+  *carry = _mm_and_si128(_mm_unpackhi_epi64(last, last), remainder_mask);
+  return converted;
+}
+
+}  // namespace
+
+void Convert10To8PlaneSse2(const uint8_t* source, int source_stride,
+                           uint8_t* destination, int destination_stride,
+                           int width, int height) {
+  // The remainder is carried over between rows, as it is by the portable
+  // implementation.
+  __m128i carry = _mm_setzero_si128();
+  for (int i = 0; i < height; i++) {
+    const uint16_t* source_16 = reinterpret_cast<const uint16_t*>(source);
+
+    const int j_max = width & ~15;
+    int j;
+    for (j = 0; j < j_max; j += 16) {
+      const __m128i values_1 = ConvertEightSamples(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(source_16 + j)),
+          &carry);
+      const __m128i values_2 = ConvertEightSamples(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(source_16 + j + 8)),
+          &carry);
+      // Packing saturates the values to 255.
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + j),
+                       _mm_packus_epi16(values_1, values_2));
+    }
+
+    if (j < width) {
+      int sample = _mm_cvtsi128_si32(carry) & 3;
+      for (; j < width; j++) {
+        sample += source_16[j];
+        const int value = sample >> 2;
+        destination[j] = value > 255 ? 255 : value;
+        sample &= 3;
+      }
+      carry = _mm_set1_epi16(static_cast<int16_t>(sample));
+    }
+
+    source += source_stride;
+    destination += destination_stride;
+  }
+}
+
+}  // namespace exoplayer_jni
+
+#endif  // defined(__i386__) || defined(__x86_64__)
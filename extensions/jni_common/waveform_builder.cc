@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "waveform_builder.h"  // NOLINT
+
+#include <algorithm>
+#include <cmath>
+
+#include "cpu_dispatch.h"  // NOLINT
+
+namespace exoplayer_jni {
+
+WaveformBuilder::WaveformBuilder()
+    : channel_count_(0),
+      frames_per_peak_(0),
+      start_frame_(0),
+      end_frame_(INT64_MAX),
+      position_(0),
+      peak_frame_count_(0),
+      peak_min_(0),
+      peak_max_(0),
+      peak_sum_squares_(0) {}
+
+bool WaveformBuilder::Configure(int channel_count, int frames_per_peak) {
+  if (channel_count < 1 || frames_per_peak < 1) {
+    return false;
+  }
+  channel_count_ = channel_count;
+  frames_per_peak_ = frames_per_peak;
+  SetRange(0, INT64_MAX);
+  return true;
+}
+
+void WaveformBuilder::SetRange(int64_t start_frame, int64_t end_frame) {
+  start_frame_ = start_frame;
+  end_frame_ = end_frame;
+  position_ = start_frame;
+  peak_frame_count_ = 0;
+  peaks_.clear();
+}
+
+void WaveformBuilder::Add(const float* samples, int frame_count) {
+  const SummarizeSamplesFunction summarize_samples =
+      GetKernels().summarize_samples;
+  const int64_t end_position = position_ + frame_count;
+  // Skips the frames before the range.
+  if (position_ < start_frame_) {
+    const int64_t skipped_frames =
+        std::min<int64_t>(start_frame_ - position_, frame_count);
+    samples += skipped_frames * channel_count_;
+    position_ += skipped_frames;
+  }
+  const int64_t last_position = std::min(end_position, end_frame_);
+  while (position_ < last_position) {
+    // Summarizes the frames up to the end of the current peak.
+    const int64_t peak_end_position =
+        (position_ / frames_per_peak_ + 1) * frames_per_peak_;
+    const int run_frames = static_cast<int>(
+        std::min(peak_end_position, last_position) - position_);
+    const SampleSummary summary =
+        summarize_samples(samples, run_frames * channel_count_);
+    if (peak_frame_count_ == 0) {
+      peak_min_ = summary.min;
+      peak_max_ = summary.max;
+      peak_sum_squares_ = 0;
+    } else {
+      peak_min_ = std::min(peak_min_, summary.min);
+      peak_max_ = std::max(peak_max_, summary.max);
+    }
+    peak_sum_squares_ += summary.sum_squares;
+    peak_frame_count_ += run_frames;
+    samples += run_frames * channel_count_;
+    position_ += run_frames;
+    if (position_ == peak_end_position) {
+      AddPeak();
+    }
+  }
+  position_ = end_position;
+}
+
+void WaveformBuilder::Finish() {
+  if (peak_frame_count_ > 0) {
+    AddPeak();
+  }
+}
+
+void WaveformBuilder::RemovePeaks(int count) {
+  peaks_.erase(peaks_.begin(),
+               peaks_.begin() + std::min(count, peak_count()) * kValuesPerPeak);
+}
+
+void WaveformBuilder::AddPeak() {
+  peaks_.push_back(peak_min_);
+  peaks_.push_back(peak_max_);
+  peaks_.push_back(static_cast<float>(std::sqrt(
+      peak_sum_squares_ / (static_cast<double>(peak_frame_count_) *
+                           channel_count_))));
+  peak_frame_count_ = 0;
+}
+
+}  // namespace exoplayer_jni
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_WAVEFORM_BUILDER_H_
+#define EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_WAVEFORM_BUILDER_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace exoplayer_jni {
+
+// Reduces interleaved float audio to waveform peaks, as drawn by waveform views
+// and scrub bars: the minimum, maximum and RMS of the samples of all channels
+// in each run of |frames_per_peak| frames. Frames are summarized with
+// GetKernels().summarize_samples as they're added, so the audio itself is
+// never kept.
+//
+// Peaks are aligned to multiples of |frames_per_peak| from the start of the
+// stream, and frames outside the range passed to SetRange() are ignored, so a
+// stream can be split into ranges that start at multiples of
+// |frames_per_peak|, each reduced by its own builder from a seek point before
+// its start, and the ranges' peaks concatenated. Not thread-safe.
+class WaveformBuilder {
+ public:
+  // The number of values per peak: the minimum, the maximum and the RMS.
+  static const int kValuesPerPeak = 3;
+
+  WaveformBuilder();
+
+  // Not copyable or movable.
+  WaveformBuilder(const WaveformBuilder&) = delete;
+  WaveformBuilder& operator=(const WaveformBuilder&) = delete;
+
+  // Configures the builder for |channel_count| channels and |frames_per_peak|
+  // frames per peak, and resets it to reduce the whole stream from frame 0.
+  // Returns false if either is less than 1.
+  bool Configure(int channel_count, int frames_per_peak);
+
+  // Restricts the peaks to frames with indices in [start_frame, end_frame),
+  // and discards the peaks that haven't been taken. The next frame added is
+  // frame |start_frame| unless set_position() is called.
+  void SetRange(int64_t start_frame, int64_t end_frame);
+
+  // Sets the index of the next frame that's added. Decoders that know the
+  // index of each decoded frame, such as FLAC's, call this before adding
+  // frames, so that peaks stay aligned after seeks.
+  void set_position(int64_t position) { position_ = position; }
+
+  // Returns the index of the next frame that's added.
+  int64_t position() const { return position_; }
+
+  // Returns whether the frames up to the end of the range have been added.
+  bool reached_range_end() const { return position_ >= end_frame_; }
+
+  // Adds |frame_count| frames.
+  void Add(const float* samples, int frame_count);
+
+  // Completes the peak of the frames added since the last complete peak, if
+  // any. Called at the end of the stream or range.
+  void Finish();
+
+  // Returns the completed peaks that haven't been taken, as kValuesPerPeak
+  // values each.
+  const float* peaks() const { return peaks_.data(); }
+  int peak_count() const {
+    return static_cast<int>(peaks_.size()) / kValuesPerPeak;
+  }
+
+  // Discards the first |count| completed peaks, once they've been copied.
+  void RemovePeaks(int count);
+
+ private:
+  // Appends the peak of the frames summarized since the last peak.
+  void AddPeak();
+
+  int channel_count_;
+  int frames_per_peak_;
+  int64_t start_frame_;
+  int64_t end_frame_;
+  int64_t position_;
+
+  // The summary of the current peak's frames.
+  int peak_frame_count_;
+  float peak_min_;
+  float peak_max_;
+  double peak_sum_squares_;
+
+  std::vector<float> peaks_;
+};
+
+}  // namespace exoplayer_jni
+
+#endif  // EXOPLAYER_V2_EXTENSIONS_JNI_COMMON_WAVEFORM_BUILDER_H_
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.google.android.exoplayer2.ext.opus;
+
+import static com.google.common.truth.Truth.assertThat;
+import static org.junit.Assert.fail;
+
+import androidx.test.core.app.ApplicationProvider;
+import androidx.test.ext.junit.runners.AndroidJUnit4;
+import com.google.android.exoplayer2.Format;
+import com.google.android.exoplayer2.decoder.DecoderInputBuffer;
+import com.google.android.exoplayer2.decoder.NativeDecoderStats;
+import com.google.android.exoplayer2.decoder.SimpleOutputBuffer;
+import com.google.android.exoplayer2.extractor.mkv.MatroskaExtractor;
+import com.google.android.exoplayer2.testutil.FakeExtractorOutput;
+import com.google.android.exoplayer2.testutil.FakeTrackOutput;
+import com.google.android.exoplayer2.testutil.TestUtil;
+import com.google.android.exoplayer2.util.Assertions;
+import com.google.android.exoplayer2.util.Log;
+import org.junit.Before;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+
+/**
+ * Measures the cost of the JNI boundary when decoding small Opus packets with {@link
+ * OpusDecoder}.
+ *
+ * <p>Each decode call is timed in Java, and split into the time spent in native code, excluding
+ * upcalls, the time spent in upcalls to {@link SimpleOutputBuffer#init}, and the remainder, which
+ * is the cost of the transitions into and out of native code plus the Java side of the call.
+ */
+@RunWith(AndroidJUnit4.class)
+public final class OpusJniBoundaryBenchmarkTest {
+
+  private static final String TAG = "OpusJniBoundaryBench";
+  private static final String TEST_FILE = "media/mka/bear-opus.mka";
+  private static final int WARM_UP_PASS_COUNT = 2;
+  private static final int PASS_COUNT = 10;
+
+  @Before
+  public void setUp() {
+    if (!OpusLibrary.isAvailable()) {
+      fail("Opus library not available.");
+    }
+  }
+
+  @Test
+  public void decodePackets_reportsBoundaryCostPerCall() throws Exception {
+    FakeExtractorOutput extractorOutput =
+        TestUtil.extractAllSamplesFromFile(
+            new MatroskaExtractor(), ApplicationProvider.getApplicationContext(), TEST_FILE);
+    FakeTrackOutput trackOutput = extractorOutput.trackOutputs.valueAt(0);
+    Format format = Assertions.checkNotNull(trackOutput.lastFormat);
+    OpusDecoder decoder =
+        new OpusDecoder(
+            /* numInputBuffers= */ 1,
+            /* numOutputBuffers= */ 1,
+            format.maxInputSize,
+            format.initializationData,
+            /* exoMediaCrypto= */ null,
+            /* outputFloat= */ false);
+    DecoderInputBuffer inputBuffer = decoder.createInputBuffer();
+    SimpleOutputBuffer outputBuffer = decoder.createOutputBuffer();
+
+    for (int i = 0; i < WARM_UP_PASS_COUNT; i++) {
+      decodeAllSamples(decoder, trackOutput, inputBuffer, outputBuffer);
+    }
+    NativeDecoderStats statsBefore = decoder.getNativeStats();
+    long javaTimeNs = 0;
+    for (int i = 0; i < PASS_COUNT; i++) {
+      javaTimeNs += decodeAllSamples(decoder, trackOutput, inputBuffer, outputBuffer);
+    }
+    NativeDecoderStats statsAfter = decoder.getNativeStats();
+    decoder.release();
+
+    long decodeCount = (long) PASS_COUNT * trackOutput.getSampleCount();
+    long nativeCallCount = statsAfter.nativeCallCount - statsBefore.nativeCallCount;
+    long nativeTimeNs = statsAfter.nativeCallTimeNs - statsBefore.nativeCallTimeNs;
+    long upcallCount = statsAfter.upcallCount - statsBefore.upcallCount;
+    long upcallTimeNs = statsAfter.upcallTimeNs - statsBefore.upcallTimeNs;
+    Log.i(
+        TAG,
+        "Per decode call: total "
+            + javaTimeNs / decodeCount
+            + " ns, native work "
+            + (nativeTimeNs - upcallTimeNs) / decodeCount
+            + " ns, "
+            + upcallCount / (double) decodeCount
+            + " upcalls "
+            + upcallTimeNs / decodeCount
+            + " ns, transitions and Java "
+            + (javaTimeNs - nativeTimeNs) / decodeCount
+            + " ns, over "
+            + nativeCallCount
+            + " native calls");
+    // Each pass starts with a reset, which is a separate native call.
+    assertThat(nativeCallCount).isEqualTo(decodeCount + PASS_COUNT);
+    assertThat(upcallCount).isAtLeast(decodeCount);
+    assertThat(nativeTimeNs).isAtMost(javaTimeNs);
+  }
+
+  /** Decodes all samples of {@code trackOutput}, returning the time spent in decode calls. */
+  private static long decodeAllSamples(
+      OpusDecoder decoder,
+      FakeTrackOutput trackOutput,
+      DecoderInputBuffer inputBuffer,
+      SimpleOutputBuffer outputBuffer) {
+    long decodeTimeNs = 0;
+    for (int i = 0; i < trackOutput.getSampleCount(); i++) {
+      byte[] sampleData = trackOutput.getSampleData(i);
+      inputBuffer.clear();
+      inputBuffer.ensureSpaceForWrite(sampleData.length);
+      Assertions.checkNotNull(inputBuffer.data).put(sampleData);
+      inputBuffer.flip();
+      inputBuffer.timeUs = trackOutput.getSampleTimeUs(i);
+      long startTimeNs = System.nanoTime();
+      OpusDecoderException exception =
+          decoder.decode(inputBuffer, outputBuffer, /* reset= */ i == 0);
+      decodeTimeNs += System.nanoTime() - startTimeNs;
+      assertThat(exception).isNull();
+    }
+    return decodeTimeNs;
+  }
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.google.android.exoplayer2.ext.opus;
+
+import static com.google.common.truth.Truth.assertThat;
+import static org.junit.Assert.fail;
+
+import androidx.test.core.app.ApplicationProvider;
+import androidx.test.ext.junit.runners.AndroidJUnit4;
+import com.google.android.exoplayer2.Format;
+import com.google.android.exoplayer2.decoder.DecoderInputBuffer;
+import com.google.android.exoplayer2.decoder.SimpleOutputBuffer;
+import com.google.android.exoplayer2.extractor.mkv.MatroskaExtractor;
+import com.google.android.exoplayer2.testutil.FakeTrackOutput;
+import com.google.android.exoplayer2.testutil.TestUtil;
+import com.google.android.exoplayer2.util.Assertions;
+import com.google.android.exoplayer2.util.Log;
+import java.util.Arrays;
+import java.util.Random;
+import org.junit.Before;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+
+/**
+ * Measures the time from a seek to the first output sample with {@link OpusDecoder}, for a sequence
+ * of seeks to random positions.
+ *
+ * <p>After a seek, the decoder is reset and discards its seek pre-roll, so the time is split into
+ * the decode of the first packet after the reset, and the decode of the following packets until
+ * the first sample is output. The test file has no cues, so packets are taken from the samples
+ * extracted from it rather than by seeking the extractor.
+ */
+@RunWith(AndroidJUnit4.class)
+public final class OpusSeekBenchmarkTest {
+
+  private static final String TAG = "OpusSeekBenchmark";
+  private static final String TEST_FILE = "media/mka/bear-opus.mka";
+  private static final int SEEK_COUNT = 100;
+
+  @Before
+  public void setUp() {
+    if (!OpusLibrary.isAvailable()) {
+      fail("Opus library not available.");
+    }
+  }
+
+  @Test
+  public void randomSeeks_reportsTimeToFirstSample() throws Exception {
+    FakeTrackOutput trackOutput =
+        TestUtil.extractAllSamplesFromFile(
+                new MatroskaExtractor(), ApplicationProvider.getApplicationContext(), TEST_FILE)
+            .trackOutputs
+            .valueAt(0);
+    Format format = Assertions.checkNotNull(trackOutput.lastFormat);
+    OpusDecoder decoder =
+        new OpusDecoder(
+            /* numInputBuffers= */ 1,
+            /* numOutputBuffers= */ 1,
+            format.maxInputSize,
+            format.initializationData,
+            /* exoMediaCrypto= */ null,
+            /* outputFloat= */ false);
+    DecoderInputBuffer inputBuffer = decoder.createInputBuffer();
+    SimpleOutputBuffer outputBuffer = decoder.createOutputBuffer();
+
+    Random random = new Random(/* seed= */ 0);
+    long[] resetTimesNs = new long[SEEK_COUNT];
+    long[] preRollTimesNs = new long[SEEK_COUNT];
+    long[] totalTimesNs = new long[SEEK_COUNT];
+    long preRollPacketCount = 0;
+    for (int i = 0; i < SEEK_COUNT; i++) {
+      // Packets near the end may not produce any output once the pre-roll is discarded, so
+      // seeks are made to positions in the first half of the file.
+      int index = random.nextInt(trackOutput.getSampleCount() / 2) + 1;
+      long startTimeNs = System.nanoTime();
+      boolean hasOutput =
+          decodeSample(
+              decoder, trackOutput, index, /* reset= */ true, inputBuffer, outputBuffer);
+      long resetEndTimeNs = System.nanoTime();
+      int preRollIndex = index;
+      while (!hasOutput) {
+        preRollIndex++;
+        hasOutput =
+            decodeSample(
+                decoder, trackOutput, preRollIndex, /* reset= */ false, inputBuffer, outputBuffer);
+      }
+      long endTimeNs = System.nanoTime();
+
+      resetTimesNs[i] = resetEndTimeNs - startTimeNs;
+      preRollTimesNs[i] = endTimeNs - resetEndTimeNs;
+      totalTimesNs[i] = endTimeNs - startTimeNs;
+      preRollPacketCount += preRollIndex - index;
+    }
+    decoder.release();
+
+    Log.i(
+        TAG,
+        TEST_FILE
+            + ": time to first sample p50 "
+            + getPercentileUs(totalTimesNs, 50)
+            + " us, p90 "
+            + getPercentileUs(totalTimesNs, 90)
+            + " us; reset and first decode p50 "
+            + getPercentileUs(resetTimesNs, 50)
+            + " us, pre-roll p50 "
+            + getPercentileUs(preRollTimesNs, 50)
+            + " us over "
+            + preRollPacketCount / (double) SEEK_COUNT
+            + " packets");
+  }
+
+  /**
+   * Decodes the sample at {@code index}, resetting the decoder first if {@code reset} is true.
+   * Returns whether any samples were output.
+   */
+  private static boolean decodeSample(
+      OpusDecoder decoder,
+      FakeTrackOutput trackOutput,
+      int index,
+      boolean reset,
+      DecoderInputBuffer inputBuffer,
+      SimpleOutputBuffer outputBuffer) {
+    byte[] sampleData = trackOutput.getSampleData(index);
+    inputBuffer.clear();
+    inputBuffer.ensureSpaceForWrite(sampleData.length);
+    Assertions.checkNotNull(inputBuffer.data).put(sampleData);
+    inputBuffer.flip();
+    inputBuffer.timeUs = trackOutput.getSampleTimeUs(index);
+    assertThat(decoder.decode(inputBuffer, outputBuffer, reset)).isNull();
+    return Assertions.checkNotNull(outputBuffer.data).hasRemaining();
+  }
+
+  private static long getPercentileUs(long[] timesNs, int percentile) {
+    long[] sortedTimesNs = Arrays.copyOf(timesNs, timesNs.length);
+    Arrays.sort(sortedTimesNs);
+    return sortedTimesNs[(sortedTimesNs.length - 1) * percentile / 100] / 1000;
+  }
+}
@@ -18,14 +18,19 @@ package com.google.android.exoplayer2.ext.opus;
 import android.os.Handler;
 import androidx.annotation.Nullable;
 import com.google.android.exoplayer2.C;
+import com.google.android.exoplayer2.ExoPlaybackException;
 import com.google.android.exoplayer2.Format;
+import com.google.android.exoplayer2.audio.AudioChainConfig;
 import com.google.android.exoplayer2.audio.AudioProcessor;
 import com.google.android.exoplayer2.audio.AudioRendererEventListener;
 import com.google.android.exoplayer2.audio.AudioSink;
 import com.google.android.exoplayer2.audio.AudioSink.SinkFormatSupport;
 import com.google.android.exoplayer2.audio.DecoderAudioRenderer;
-import com.google.android.exoplayer2.audio.OpusUtil;
+import com.google.android.exoplayer2.audio.DecoderCrossfade;
+import com.google.android.exoplayer2.decoder.DecoderPrewarmer;
+import com.google.android.exoplayer2.decoder.DecoderReuseEvaluation;
 import com.google.android.exoplayer2.drm.ExoMediaCrypto;
+import com.google.android.exoplayer2.util.Assertions;
 import com.google.android.exoplayer2.util.MimeTypes;
 import com.google.android.exoplayer2.util.TraceUtil;
 import com.google.android.exoplayer2.util.Util;
@@ -39,6 +44,16 @@ public class LibopusAudioRenderer extends DecoderAudioRenderer<OpusDecoder> {
   /** The default input buffer size. */
   private static final int DEFAULT_INPUT_BUFFER_SIZE = 960 * 6;
 
+  private final DecoderPrewarmer<OpusDecoder> decoderPrewarmer = new DecoderPrewarmer<>();
+
+  @Nullable private volatile AudioChainConfig audioChainConfig;
+  private volatile int decodeAheadMs;
+  private volatile int crossfadeDurationMs;
+  @DecoderCrossfade.Curve private volatile int crossfadeCurve;
+  @Nullable private volatile OpusDecoder currentDecoder;
+  private boolean streamChanged;
+  private boolean crossfadeIntoNextDecoder;
+
   public LibopusAudioRenderer() {
     this(/* eventHandler= */ null, /* eventListener= */ null);
   }
@@ -78,6 +93,72 @@ public class LibopusAudioRenderer extends DecoderAudioRenderer<OpusDecoder> {
     return TAG;
   }
 
+  /**
+   * Creates a decoder for {@code format} on a background thread, so that the decoder is ready when
+   * playback starts. The decoder is used if the renderer's next decoder is for a compatible format
+   * and has the same output encoding, and is released otherwise, or when the renderer is reset.
+   *
+   * @param format The anticipated format.
+   */
+  public void prewarmDecoder(Format format) {
+    boolean outputFloat = shouldOutputFloat(format);
+    decoderPrewarmer.prewarm(
+        format, prewarmFormat -> newDecoder(prewarmFormat, /* mediaCrypto= */ null, outputFloat));
+  }
+
+  /**
+   * Sets the processing that the native decoder applies to its output before it's passed to the
+   * audio sink, replacing the equivalent {@link AudioProcessor AudioProcessors}. Applies to
+   * decoders created after the call. The gain in each format's loudness tags is applied as
+   * described by {@link AudioChainConfig#forMetadata}.
+   *
+   * @param audioChainConfig The configuration, or null to output the decoded samples unchanged.
+   */
+  public void setAudioChainConfig(@Nullable AudioChainConfig audioChainConfig) {
+    this.audioChainConfig = audioChainConfig;
+  }
+
+  /**
+   * Sets the duration of output that the native decoder decodes ahead on a background thread, or 0
+   * to decode on the decoder's thread. Applies to decoders created after the call, other than for
+   * encrypted content. See {@link OpusDecoder#setDecodeAheadMs(int)}.
+   *
+   * @param decodeAheadMs The duration of output to decode ahead, in milliseconds, or 0.
+   */
+  public void setDecodeAheadMs(int decodeAheadMs) {
+    Assertions.checkArgument(decodeAheadMs >= 0);
+    this.decodeAheadMs = decodeAheadMs;
+  }
+
+  /**
+   * Sets the duration of the {@link DecoderCrossfade crossfades} that the native decoders mix
+   * between consecutive streams, or 0 to play them one after the other. Applies to decoders created
+   * after the call. Streams are crossfaded if they have the same channel count and sample rate.
+   *
+   * @param crossfadeDurationMs The duration of the crossfades, in milliseconds, or 0.
+   * @param crossfadeCurve The shape of the crossfades.
+   */
+  public void setCrossfade(int crossfadeDurationMs, @DecoderCrossfade.Curve int crossfadeCurve) {
+    Assertions.checkArgument(crossfadeDurationMs >= 0);
+    this.crossfadeCurve = crossfadeCurve;
+    this.crossfadeDurationMs = crossfadeDurationMs;
+  }
+
+  /**
+   * Computes the levels of the frequency bands of the audio most recently decoded by the renderer's
+   * current decoder. See {@link OpusDecoder#getSpectrum(float[])}. May be called from any thread,
+   * for example once per display frame by a visualizer, including while the renderer replaces or
+   * releases its decoder.
+   *
+   * @param bands The array to write the level of each band to.
+   * @return Whether the levels were written, which they aren't if the renderer has no decoder or
+   *     the decoder didn't write them.
+   */
+  public boolean getSpectrum(float[] bands) {
+    @Nullable OpusDecoder currentDecoder = this.currentDecoder;
+    return currentDecoder != null && currentDecoder.getSpectrum(bands);
+  }
+
   @Override
   @C.FormatSupport
   protected int supportsFormatInternal(Format format) {
@@ -101,31 +182,122 @@ public class LibopusAudioRenderer extends DecoderAudioRenderer<OpusDecoder> {
   protected OpusDecoder createDecoder(Format format, @Nullable ExoMediaCrypto mediaCrypto)
       throws OpusDecoderException {
     TraceUtil.beginSection("createOpusDecoder");
+    boolean outputFloat = shouldOutputFloat(format);
+    @Nullable OpusDecoder decoder = decoderPrewarmer.takeDecoder(format);
+    if (decoder != null && decoder.outputFloat != outputFloat) {
+      decoder.release();
+      decoder = null;
+    }
+    if (decoder == null) {
+      decoder = newDecoder(format, mediaCrypto, outputFloat);
+    }
+    try {
+      decoder.setAudioChainConfig(
+          audioChainConfig != null ? audioChainConfig.forMetadata(format.metadata) : null);
+      int decodeAheadMs = this.decodeAheadMs;
+      if (decodeAheadMs > 0 && mediaCrypto == null) {
+        decoder.setDecodeAheadMs(decodeAheadMs);
+      }
+      // The previous decoder holds the end of its stream if it's crossfaded into this one.
+      @Nullable OpusDecoder previousDecoder = currentDecoder;
+      int crossfadeDurationMs = this.crossfadeDurationMs;
+      if (crossfadeDurationMs > 0) {
+        decoder.setCrossfade(
+            crossfadeDurationMs * 1000L,
+            crossfadeCurve,
+            crossfadeIntoNextDecoder ? previousDecoder : null);
+      }
+      if (previousDecoder != null) {
+        previousDecoder.releaseCrossfade();
+      }
+    } catch (OpusDecoderException e) {
+      decoder.release();
+      throw e;
+    }
+    currentDecoder = decoder;
+    streamChanged = false;
+    crossfadeIntoNextDecoder = false;
+    TraceUtil.endSection();
+    return decoder;
+  }
+
+  @Override
+  protected void onReset() {
+    super.onReset();
+    decoderPrewarmer.release();
+  }
+
+  @Override
+  protected void onStreamChanged(Format[] formats, long startPositionUs, long offsetUs)
+      throws ExoPlaybackException {
+    super.onStreamChanged(formats, startPositionUs, offsetUs);
+    streamChanged = true;
+  }
+
+  @Override
+  protected DecoderReuseEvaluation canReuseDecoder(
+      String decoderName, Format oldFormat, Format newFormat) {
+    @Nullable OpusDecoder currentDecoder = this.currentDecoder;
+    if (streamChanged
+        && currentDecoder != null
+        && crossfadeDurationMs > 0
+        && oldFormat.channelCount == newFormat.channelCount
+        && oldFormat.sampleRate == newFormat.sampleRate) {
+      // The decoder is released at the end of its stream, and the end of its output is mixed into
+      // the start of the next decoder's.
+      currentDecoder.crossfadeIntoNextStream();
+      crossfadeIntoNextDecoder = true;
+    }
+    streamChanged = false;
+    return super.canReuseDecoder(decoderName, oldFormat, newFormat);
+  }
+
+  @Override
+  protected void onPositionReset(long positionUs, boolean joining) throws ExoPlaybackException {
+    // A stream isn't crossfaded into the stream that plays after a seek.
+    crossfadeIntoNextDecoder = false;
+    super.onPositionReset(positionUs, joining);
+  }
+
+  @Override
+  protected void onDisabled() {
+    @Nullable OpusDecoder currentDecoder = this.currentDecoder;
+    this.currentDecoder = null;
+    super.onDisabled();
+    if (currentDecoder != null) {
+      currentDecoder.releaseCrossfade();
+    }
+  }
+
+  @Override
+  protected Format getOutputFormat(OpusDecoder decoder) {
+    return decoder.getOutputFormat();
+  }
+
+  @Override
+  protected float getOutputSpeed(OpusDecoder decoder) {
+    return decoder.getOutputSpeed();
+  }
+
+  private boolean shouldOutputFloat(Format format) {
     @SinkFormatSupport
     int formatSupport =
         getSinkFormatSupport(
             Util.getPcmFormat(C.ENCODING_PCM_FLOAT, format.channelCount, format.sampleRate));
-    boolean outputFloat = formatSupport == AudioSink.SINK_FORMAT_SUPPORTED_DIRECTLY;
+    return formatSupport == AudioSink.SINK_FORMAT_SUPPORTED_DIRECTLY;
+  }
 
+  private static OpusDecoder newDecoder(
+      Format format, @Nullable ExoMediaCrypto mediaCrypto, boolean outputFloat)
+      throws OpusDecoderException {
     int initialInputBufferSize =
         format.maxInputSize != Format.NO_VALUE ? format.maxInputSize : DEFAULT_INPUT_BUFFER_SIZE;
-    OpusDecoder decoder =
-        new OpusDecoder(
-            NUM_BUFFERS,
-            NUM_BUFFERS,
-            initialInputBufferSize,
-            format.initializationData,
-            mediaCrypto,
-            outputFloat);
-
-    TraceUtil.endSection();
-    return decoder;
-  }
-
-  @Override
-  protected Format getOutputFormat(OpusDecoder decoder) {
-    @C.PcmEncoding
-    int pcmEncoding = decoder.outputFloat ? C.ENCODING_PCM_FLOAT : C.ENCODING_PCM_16BIT;
-    return Util.getPcmFormat(pcmEncoding, decoder.channelCount, OpusUtil.SAMPLE_RATE);
+    return new OpusDecoder(
+        NUM_BUFFERS,
+        NUM_BUFFERS,
+        initialInputBufferSize,
+        format.initializationData,
+        mediaCrypto,
+        outputFloat);
   }
 }
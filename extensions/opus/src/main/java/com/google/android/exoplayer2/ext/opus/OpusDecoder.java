@@ -17,12 +17,18 @@ package com.google.android.exoplayer2.ext.opus;
 
 import static androidx.annotation.VisibleForTesting.PACKAGE_PRIVATE;
 
+import androidx.annotation.GuardedBy;
 import androidx.annotation.Nullable;
 import androidx.annotation.VisibleForTesting;
 import com.google.android.exoplayer2.C;
+import com.google.android.exoplayer2.Format;
+import com.google.android.exoplayer2.audio.AudioChainConfig;
+import com.google.android.exoplayer2.audio.DecoderCrossfade;
 import com.google.android.exoplayer2.audio.OpusUtil;
 import com.google.android.exoplayer2.decoder.CryptoInfo;
 import com.google.android.exoplayer2.decoder.DecoderInputBuffer;
+import com.google.android.exoplayer2.decoder.NativeDecoder;
+import com.google.android.exoplayer2.decoder.NativeDecoderStats;
 import com.google.android.exoplayer2.decoder.SimpleDecoder;
 import com.google.android.exoplayer2.decoder.SimpleOutputBuffer;
 import com.google.android.exoplayer2.drm.DecryptionException;
@@ -30,16 +36,29 @@ import com.google.android.exoplayer2.drm.ExoMediaCrypto;
 import com.google.android.exoplayer2.util.Assertions;
 import com.google.android.exoplayer2.util.Util;
 import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
 import java.util.List;
 
 /** Opus decoder. */
 @VisibleForTesting(otherwise = PACKAGE_PRIVATE)
 public final class OpusDecoder
-    extends SimpleDecoder<DecoderInputBuffer, SimpleOutputBuffer, OpusDecoderException> {
+    extends SimpleDecoder<DecoderInputBuffer, SimpleOutputBuffer, OpusDecoderException>
+    implements NativeDecoder {
 
   private static final int NO_ERROR = 0;
   private static final int DECODE_ERROR = -1;
   private static final int DRM_ERROR = -2;
+  // LINT.IfChange
+  private static final int NO_DECODE_AHEAD_OUTPUT = -100;
+  // LINT.ThenChange(../../../../../../../jni/opus_jni.cc)
+
+  // Slots of the status block that is published by the native decoder.
+  // LINT.IfChange
+  private static final int STATUS_ERROR_CODE = 0;
+  private static final int STATUS_SKIPPED_SILENCE_FRAME_COUNT = 1;
+  private static final int STATUS_INTEGRATED_LOUDNESS = 2;
+  private static final int STATUS_DECODE_ONLY = 3;
+  // LINT.ThenChange(../../../../../../../jni/opus_jni.cc)
 
   public final boolean outputFloat;
   public final int channelCount;
@@ -48,8 +67,20 @@ public final class OpusDecoder
   private final int preSkipSamples;
   private final int seekPreRollSamples;
   private final long nativeDecoderContext;
+  private final ByteBuffer statusBuffer;
+  private final Object releaseLock;
 
+  @Nullable private AudioChainConfig audioChainConfig;
+  private int outputFrameSize;
+  private int outputSampleRate;
   private int skipSamples;
+  private boolean decodingAhead;
+  @Nullable private DecoderCrossfade crossfade;
+  private int outputChannelCount;
+  @C.PcmEncoding private int outputEncoding;
+
+  @GuardedBy("releaseLock")
+  private boolean released;
 
   /**
    * Creates an Opus decoder.
@@ -128,11 +159,175 @@ public final class OpusDecoder
     if (nativeDecoderContext == 0) {
       throw new OpusDecoderException("Failed to initialize decoder");
     }
+    statusBuffer = opusGetStatusBuffer(nativeDecoderContext).order(ByteOrder.nativeOrder());
+    releaseLock = new Object();
     setInitialInputBufferSize(initialInputBufferSize);
 
     this.outputFloat = outputFloat;
     if (outputFloat) {
-      opusSetFloatOutput();
+      opusSetFloatOutput(nativeDecoderContext);
+    }
+    outputFrameSize = Util.getPcmFrameSize(getDecodedEncoding(outputFloat), channelCount);
+    outputSampleRate = OpusUtil.SAMPLE_RATE;
+    outputChannelCount = channelCount;
+    outputEncoding = getDecodedEncoding(outputFloat);
+  }
+
+  /**
+   * Sets the processing that the native decoder applies to its output. May only be called once,
+   * before the first input buffer is queued.
+   *
+   * @param audioChainConfig The configuration, or null to output the decoded samples unchanged.
+   * @throws OpusDecoderException If the configuration isn't supported for the stream.
+   */
+  public void setAudioChainConfig(@Nullable AudioChainConfig audioChainConfig)
+      throws OpusDecoderException {
+    Assertions.checkState(this.audioChainConfig == null && !decodingAhead);
+    if (audioChainConfig == null) {
+      return;
+    }
+    if (!audioChainConfig.isApplicableTo(channelCount)
+        || !opusSetAudioChainConfig(
+            nativeDecoderContext,
+            audioChainConfig.getChannelMap(),
+            audioChainConfig.gain,
+            audioChainConfig.speed,
+            audioChainConfig.pitch,
+            audioChainConfig.isSkippingSilence() ? audioChainConfig.minimumSilenceDurationUs : 0,
+            audioChainConfig.paddingSilenceUs,
+            audioChainConfig.getSilenceThreshold(),
+            audioChainConfig.measureLoudness,
+            audioChainConfig.waveformFramesPerPeak,
+            audioChainConfig.spectrumFftSize,
+            audioChainConfig.outputSampleRate,
+            audioChainConfig.outputEncoding)) {
+      throw new OpusDecoderException("Unsupported audio chain configuration");
+    }
+    this.audioChainConfig = audioChainConfig;
+    Format outputFormat = getOutputFormat();
+    outputFrameSize = Util.getPcmFrameSize(outputFormat.pcmEncoding, outputFormat.channelCount);
+    outputSampleRate = outputFormat.sampleRate;
+    outputChannelCount = outputFormat.channelCount;
+    outputEncoding = outputFormat.pcmEncoding;
+  }
+
+  /**
+   * Crossfades the decoder's stream with the adjacent streams, as described in {@link
+   * DecoderCrossfade}. May only be called once, after {@link
+   * #setAudioChainConfig(AudioChainConfig)} and before the first input buffer is queued.
+   *
+   * @param durationUs The duration of the crossfade, in microseconds.
+   * @param curve The shape of the crossfade into this decoder's stream.
+   * @param previousDecoder The released decoder of the previous stream, whose held back output is
+   *     crossfaded into the start of this decoder's stream if it ended by crossfading into the next
+   *     stream, or null.
+   * @throws OpusDecoderException If the crossfade isn't supported.
+   */
+  public void setCrossfade(
+      long durationUs, @DecoderCrossfade.Curve int curve, @Nullable OpusDecoder previousDecoder)
+      throws OpusDecoderException {
+    Assertions.checkState(crossfade == null);
+    crossfade =
+        DecoderCrossfade.create(
+            new CrossfadeMixer(),
+            durationUs,
+            curve,
+            getOutputSpeed(),
+            previousDecoder != null ? previousDecoder.crossfade : null);
+    if (crossfade == null) {
+      throw new OpusDecoderException("Unsupported crossfade");
+    }
+  }
+
+  /**
+   * Keeps the output that's held back at the end of the stream for the next decoder. See {@link
+   * DecoderCrossfade#crossfadeIntoNextStream()}.
+   */
+  public void crossfadeIntoNextStream() {
+    if (crossfade != null) {
+      crossfade.crossfadeIntoNextStream();
+    }
+  }
+
+  /**
+   * Releases the output that's held back for the next decoder, if it wasn't passed on to it. See
+   * {@link DecoderCrossfade#releaseHeldOutput()}.
+   */
+  public void releaseCrossfade() {
+    if (crossfade != null) {
+      crossfade.releaseHeldOutput();
+    }
+  }
+
+  /**
+   * Starts decoding on a native background thread, keeping {@code decodeAheadMs} of output
+   * decoded ahead of the output buffers that are dequeued, so that delays on the decode thread
+   * don't delay decoding. Output buffers are dequeued once enough output has been decoded, and the
+   * remaining output is drained at the end of the stream. May only be called once, after {@link
+   * #setAudioChainConfig(AudioChainConfig)} and before the first input buffer is queued. Not
+   * supported for encrypted content.
+   *
+   * @param decodeAheadMs The duration of output to decode ahead, in milliseconds.
+   * @throws OpusDecoderException If decoding ahead couldn't be started.
+   */
+  public void setDecodeAheadMs(int decodeAheadMs) throws OpusDecoderException {
+    Assertions.checkArgument(decodeAheadMs > 0);
+    Assertions.checkState(!decodingAhead);
+    if (exoMediaCrypto != null) {
+      throw new OpusDecoderException("Decoding ahead is not supported for encrypted content");
+    }
+    long aheadSize = (long) decodeAheadMs * outputSampleRate / 1000 * outputFrameSize;
+    if (aheadSize > Integer.MAX_VALUE
+        || !opusStartDecodeAhead(nativeDecoderContext, (int) aheadSize)) {
+      throw new OpusDecoderException("Failed to start decoding ahead");
+    }
+    decodingAhead = true;
+  }
+
+  /** Returns the format of the decoder's output. */
+  public Format getOutputFormat() {
+    @C.PcmEncoding int encoding = getDecodedEncoding(outputFloat);
+    return audioChainConfig != null
+        ? audioChainConfig.getOutputFormat(encoding, channelCount, OpusUtil.SAMPLE_RATE)
+        : Util.getPcmFormat(encoding, channelCount, OpusUtil.SAMPLE_RATE);
+  }
+
+  /** Returns the factor by which the decoder's output is sped up relative to its input. */
+  public float getOutputSpeed() {
+    return audioChainConfig != null ? audioChainConfig.speed : 1f;
+  }
+
+  /**
+   * Returns the integrated loudness of the audio decoded so far, in LUFS. See {@link
+   * AudioChainConfig.Builder#setLoudnessMeasurementEnabled(boolean)}.
+   */
+  public double getIntegratedLoudnessLufs() {
+    long loudness = statusBuffer.getLong(STATUS_INTEGRATED_LOUDNESS * 8);
+    return loudness == Long.MIN_VALUE ? Double.NEGATIVE_INFINITY : loudness / 1000.0;
+  }
+
+  /**
+   * Completes the last waveform peak at the end of the stream, if the decoder is reducing its
+   * output to a waveform. See {@link AudioChainConfig.Builder#setWaveformFramesPerPeak(int)}.
+   *
+   * @param peaks The array to write the remaining peaks to.
+   * @return The number of peaks written.
+   */
+  public int finishWaveform(float[] peaks) {
+    Assertions.checkState(isReducingToWaveform());
+    return opusFinishWaveform(nativeDecoderContext, peaks);
+  }
+
+  /**
+   * Computes the levels of the frequency bands of the most recently decoded audio. See {@link
+   * AudioChainConfig.Builder#setSpectrumFftSize(int)}.
+   *
+   * @param bands The array to write the level of each band to.
+   * @return Whether the levels were written.
+   */
+  public boolean getSpectrum(float[] bands) {
+    synchronized (releaseLock) {
+      return !released && opusGetSpectrum(nativeDecoderContext, bands);
     }
   }
 
@@ -164,9 +359,27 @@ public final class OpusDecoder
       opusReset(nativeDecoderContext);
       // When seeking to 0, skip number of samples as specified in opus header. When seeking to
       // any other time, skip number of samples as specified by seek preroll.
-      skipSamples = (inputBuffer.timeUs == 0) ? preSkipSamples : seekPreRollSamples;
+      int skipDecodedSamples = (inputBuffer.timeUs == 0) ? preSkipSamples : seekPreRollSamples;
+      // The samples are skipped after any speed change and sample rate conversion.
+      double skipRatio = (double) outputSampleRate / OpusUtil.SAMPLE_RATE / getOutputSpeed();
+      // Waveform peaks aren't trimmed, so that they stay aligned to the decoded samples.
+      skipSamples = isReducingToWaveform() ? 0 : (int) (skipDecodedSamples * skipRatio);
+      if (crossfade != null) {
+        crossfade.flush();
+      }
     }
     ByteBuffer inputData = Util.castNonNull(inputBuffer.data);
+    if (decodingAhead) {
+      int result =
+          opusDecodeAhead(
+              nativeDecoderContext,
+              inputBuffer.timeUs,
+              inputBuffer.isDecodeOnly(),
+              inputData,
+              inputData.limit(),
+              outputBuffer);
+      return processOutput(result, outputBuffer);
+    }
     CryptoInfo cryptoInfo = inputBuffer.cryptoInfo;
     int result =
         inputBuffer.isEncrypted()
@@ -190,25 +403,73 @@ public final class OpusDecoder
                 inputData,
                 inputData.limit(),
                 outputBuffer);
+    return processOutput(result, outputBuffer);
+  }
+
+  @Override
+  protected boolean hasPendingOutput() {
+    if (decodingAhead && opusHasDecodeAheadOutput(nativeDecoderContext)) {
+      return true;
+    }
+    return crossfade != null && crossfade.hasPendingOutput();
+  }
+
+  @Override
+  @Nullable
+  protected OpusDecoderException decodePendingOutput(SimpleOutputBuffer outputBuffer) {
+    if (decodingAhead && opusHasDecodeAheadOutput(nativeDecoderContext)) {
+      int result = opusDrainDecodeAhead(nativeDecoderContext, outputBuffer);
+      return processOutput(result, outputBuffer);
+    }
+    Util.castNonNull(crossfade).drain(outputBuffer);
+    return null;
+  }
+
+  /**
+   * Trims the samples to skip from the output of a native decode call, and passes the output
+   * through the crossfade mixer.
+   *
+   * @param result The result of the call, which is the size of the output or an error code.
+   * @param outputBuffer The output buffer that the call decoded into.
+   * @return A decoder exception if an error occurred, or null otherwise.
+   */
+  @Nullable
+  private OpusDecoderException processOutput(int result, SimpleOutputBuffer outputBuffer) {
+    if (result == NO_DECODE_AHEAD_OUTPUT) {
+      setNoOutput();
+      return null;
+    }
     if (result < 0) {
       if (result == DRM_ERROR) {
         String message = "Drm error: " + opusGetErrorMessage(nativeDecoderContext);
         DecryptionException cause =
-            new DecryptionException(opusGetErrorCode(nativeDecoderContext), message);
+            new DecryptionException((int) statusBuffer.getLong(STATUS_ERROR_CODE * 8), message);
         return new OpusDecoderException(message, cause);
       } else {
-        return new OpusDecoderException("Decode error: " + opusGetErrorMessage(result));
+        return new OpusDecoderException(
+            "Decode error: " + opusGetErrorMessage(nativeDecoderContext));
+      }
+    }
+    if (decodingAhead) {
+      // The output is of an earlier input buffer, which may have been decode-only.
+      if (statusBuffer.getLong(STATUS_DECODE_ONLY * 8) != 0) {
+        outputBuffer.addFlag(C.BUFFER_FLAG_DECODE_ONLY);
+      } else {
+        outputBuffer.clearFlag(C.BUFFER_FLAG_DECODE_ONLY);
       }
     }
 
     ByteBuffer outputData = Util.castNonNull(outputBuffer.data);
     outputData.position(0);
     outputData.limit(result);
+    outputBuffer.skippedSilenceDurationUs =
+        statusBuffer.getLong(STATUS_SKIPPED_SILENCE_FRAME_COUNT * 8)
+            * C.MICROS_PER_SECOND
+            / outputSampleRate;
     if (skipSamples > 0) {
-      int bytesPerSample = channelCount * 2;
-      int skipBytes = skipSamples * bytesPerSample;
+      int skipBytes = skipSamples * outputFrameSize;
       if (result <= skipBytes) {
-        skipSamples -= result / bytesPerSample;
+        skipSamples -= result / outputFrameSize;
         outputBuffer.addFlag(C.BUFFER_FLAG_DECODE_ONLY);
         outputData.position(result);
       } else {
@@ -216,13 +477,100 @@ public final class OpusDecoder
         outputData.position(skipBytes);
       }
     }
+    if (crossfade != null && !outputBuffer.isDecodeOnly()) {
+      int mixedSize =
+          crossfade.apply(outputBuffer, outputChannelCount, outputSampleRate, outputEncoding);
+      if (mixedSize < 0) {
+        return new OpusDecoderException("Crossfade error");
+      } else if (mixedSize == 0) {
+        setNoOutput();
+      }
+    }
     return null;
   }
 
   @Override
   public void release() {
     super.release();
+    synchronized (releaseLock) {
+      released = true;
+    }
     opusClose(nativeDecoderContext);
+    if (crossfade != null) {
+      crossfade.release();
+    }
+  }
+
+  @Override
+  public NativeDecoderStats getNativeStats() {
+    long[] snapshot = new long[NativeDecoderStats.SNAPSHOT_LENGTH];
+    opusGetStats(nativeDecoderContext, snapshot);
+    return new NativeDecoderStats(snapshot);
+  }
+
+  @Override
+  public boolean startSessionRecording(String path) {
+    return opusStartSessionRecording(nativeDecoderContext, path);
+  }
+
+  @Override
+  public void stopSessionRecording() {
+    opusStopSessionRecording(nativeDecoderContext);
+  }
+
+  /** The crossfade mixer functions of the Opus extension. */
+  private final class CrossfadeMixer implements DecoderCrossfade.NativeMixer {
+
+    @Override
+    public long setCrossfade(long mixer, long durationUs, @DecoderCrossfade.Curve int curve) {
+      return opusSetCrossfade(mixer, durationUs, curve);
+    }
+
+    @Override
+    public int crossfade(
+        long mixer,
+        ByteBuffer data,
+        int offset,
+        int size,
+        int channelCount,
+        int sampleRate,
+        @C.PcmEncoding int encoding) {
+      return opusCrossfade(mixer, data, offset, size, channelCount, sampleRate, encoding);
+    }
+
+    @Override
+    public int getCrossfadeDrainSize(long mixer) {
+      return opusGetCrossfadeDrainSize(mixer);
+    }
+
+    @Override
+    public int drainCrossfade(long mixer, ByteBuffer output, int capacity) {
+      return opusDrainCrossfade(mixer, output, capacity);
+    }
+
+    @Override
+    public void endCrossfadeStream(long mixer) {
+      opusEndCrossfadeStream(mixer);
+    }
+
+    @Override
+    public void flushCrossfade(long mixer) {
+      opusFlushCrossfade(mixer);
+    }
+
+    @Override
+    public void releaseCrossfade(long mixer) {
+      opusReleaseCrossfade(mixer);
+    }
+  }
+
+  private boolean isReducingToWaveform() {
+    return audioChainConfig != null && audioChainConfig.isReducingToWaveform();
+  }
+
+  @C.PcmEncoding
+  private static int getDecodedEncoding(boolean outputFloat) {
+    return outputFloat ? C.ENCODING_PCM_FLOAT : C.ENCODING_PCM_16BIT;
   }
 
   private static int readSignedLittleEndian16(byte[] input, int offset) {
@@ -241,6 +589,20 @@ public final class OpusDecoder
       int inputSize,
       SimpleOutputBuffer outputBuffer);
 
+  private native boolean opusStartDecodeAhead(long decoder, int aheadSize);
+
+  private native int opusDecodeAhead(
+      long decoder,
+      long timeUs,
+      boolean decodeOnly,
+      ByteBuffer inputBuffer,
+      int inputSize,
+      SimpleOutputBuffer outputBuffer);
+
+  private native boolean opusHasDecodeAheadOutput(long decoder);
+
+  private native int opusDrainDecodeAhead(long decoder, SimpleOutputBuffer outputBuffer);
+
   private native int opusSecureDecode(
       long decoder,
       long timeUs,
@@ -260,9 +622,55 @@ public final class OpusDecoder
 
   private native void opusReset(long decoder);
 
-  private native int opusGetErrorCode(long decoder);
+  private native ByteBuffer opusGetStatusBuffer(long decoder);
 
   private native String opusGetErrorMessage(long decoder);
 
-  private native void opusSetFloatOutput();
+  private native void opusSetFloatOutput(long decoder);
+
+  private native boolean opusSetAudioChainConfig(
+      long decoder,
+      @Nullable int[] channelMap,
+      float gain,
+      float speed,
+      float pitch,
+      long minimumSilenceDurationUs,
+      long paddingSilenceUs,
+      float silenceThreshold,
+      boolean measureLoudness,
+      int waveformFramesPerPeak,
+      int spectrumFftSize,
+      int outputSampleRate,
+      @C.PcmEncoding int outputEncoding);
+
+  private native int opusFinishWaveform(long decoder, float[] peaks);
+
+  private native boolean opusGetSpectrum(long decoder, float[] bands);
+
+  private native void opusGetStats(long decoder, long[] stats);
+
+  private native boolean opusStartSessionRecording(long decoder, String path);
+
+  private native void opusStopSessionRecording(long decoder);
+
+  private native long opusSetCrossfade(long mixer, long durationUs, int curve);
+
+  private native int opusCrossfade(
+      long mixer,
+      ByteBuffer data,
+      int offset,
+      int size,
+      int channelCount,
+      int sampleRate,
+      @C.PcmEncoding int encoding);
+
+  private native int opusGetCrossfadeDrainSize(long mixer);
+
+  private native int opusDrainCrossfade(long mixer, ByteBuffer output, int capacity);
+
+  private native void opusEndCrossfadeStream(long mixer);
+
+  private native void opusFlushCrossfade(long mixer);
+
+  private native void opusReleaseCrossfade(long mixer);
 }
@@ -21,6 +21,9 @@ include $(CLEAR_VARS)
 LOCAL_PATH := $(WORKING_DIR)
 include libopus.mk
 
+# build libexoplayerjnicommon.a
+include $(WORKING_DIR)/../../../../jni_common/jni_common.mk
+
 # build libopusV2JNI.so
 include $(CLEAR_VARS)
 LOCAL_PATH := $(WORKING_DIR)
@@ -29,5 +32,5 @@ LOCAL_ARM_MODE := arm
 LOCAL_CPP_EXTENSION := .cc
 LOCAL_SRC_FILES := opus_jni.cc
 LOCAL_LDLIBS := -llog -lz -lm
-LOCAL_STATIC_LIBRARIES := libopus
+LOCAL_STATIC_LIBRARIES := libopus exoplayerjnicommon
 include $(BUILD_SHARED_LIBRARY)
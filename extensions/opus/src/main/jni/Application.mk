@@ -18,3 +18,4 @@ APP_OPTIM := release
 APP_STL := c++_static
 APP_CPPFLAGS := -frtti
 APP_PLATFORM := android-9
+include $(call my-dir)/../../../../jni_common/optimization.mk
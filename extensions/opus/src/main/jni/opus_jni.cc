@@ -19,9 +19,21 @@
 #include <android/log.h>
 
 #include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
 
+#include "audio_chain_jni.h"  // NOLINT
+#include "cpu_dispatch.h"  // NOLINT
+#include "decode_ahead.h"  // NOLINT
+#include "decoder_stats_jni.h"  // NOLINT
+#include "jni_registration.h"  // NOLINT
 #include "opus.h"  // NOLINT
 #include "opus_multistream.h"  // NOLINT
+#include "profile.h"  // NOLINT
+#include "session_recorder.h"  // NOLINT
+#include "status_block.h"  // NOLINT
+#include "trace.h"  // NOLINT
 
 #define LOG_TAG "opus_jni"
 #define LOGE(...) ((void)__android_log_print(ANDROID_LOG_ERROR, LOG_TAG, \
@@ -29,51 +41,212 @@
 
 #define DECODER_FUNC(RETURN_TYPE, NAME, ...) \
   extern "C" { \
-  JNIEXPORT RETURN_TYPE \
+  EXOPLAYER_JNI_EXPORT RETURN_TYPE \
     Java_com_google_android_exoplayer2_ext_opus_OpusDecoder_ ## NAME \
       (JNIEnv* env, jobject thiz, ##__VA_ARGS__);\
   } \
-  JNIEXPORT RETURN_TYPE \
+  EXOPLAYER_JNI_EXPORT RETURN_TYPE \
     Java_com_google_android_exoplayer2_ext_opus_OpusDecoder_ ## NAME \
       (JNIEnv* env, jobject thiz, ##__VA_ARGS__)\
 
 #define LIBRARY_FUNC(RETURN_TYPE, NAME, ...) \
   extern "C" { \
-  JNIEXPORT RETURN_TYPE \
+  EXOPLAYER_JNI_EXPORT RETURN_TYPE \
     Java_com_google_android_exoplayer2_ext_opus_OpusLibrary_ ## NAME \
       (JNIEnv* env, jobject thiz, ##__VA_ARGS__);\
   } \
-  JNIEXPORT RETURN_TYPE \
+  EXOPLAYER_JNI_EXPORT RETURN_TYPE \
     Java_com_google_android_exoplayer2_ext_opus_OpusLibrary_ ## NAME \
       (JNIEnv* env, jobject thiz, ##__VA_ARGS__)\
 
 // JNI references for SimpleOutputBuffer class.
 static jmethodID outputBufferInit;
 
-jint JNI_OnLoad(JavaVM* vm, void* reserved) {
+static bool registerNativeMethods(JNIEnv* env);
+
+EXOPLAYER_JNI_ONLOAD(OpusOnLoad) {
   JNIEnv* env;
   if (vm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_6) != JNI_OK) {
     return -1;
   }
+  if (!registerNativeMethods(env)) {
+    return -1;
+  }
+  exoplayer_jni::InitCpuDispatch();
+  // Populate JNI References. They're shared by all decoder instances, so
+  // they're only written here, before any decoder can be running.
+  const jclass outputBufferClass = env->FindClass(
+      "com/google/android/exoplayer2/decoder/SimpleOutputBuffer");
+  outputBufferInit = env->GetMethodID(outputBufferClass, "init",
+      "(JI)Ljava/nio/ByteBuffer;");
   return JNI_VERSION_1_6;
 }
 
 static const int kBytesPerIntPcmSample = 2;
 static const int kBytesPerFloatSample = 4;
 static const int kMaxOpusOutputPacketSizeSamples = 960 * 6;
-static int channelCount;
-static int errorCode;
-static bool outputFloat = false;
+// The size of the ring that input is queued in when decoding ahead, which holds
+// a few seconds of packets at the highest bitrates.
+static const size_t kDecodeAheadInputCapacity = 256 * 1024;
+// Returned by the decode-ahead methods when no output is ready.
+// LINT.IfChange
+static const int kNoDecodeAheadOutput = -100;
+// LINT.ThenChange(../java/com/google/android/exoplayer2/ext/opus/OpusDecoder.java)
+// The flag that input is queued with when it's decode-only.
+static const int32_t kDecodeAheadFlagDecodeOnly = 1;
+
+// Slots of the status block that is shared with OpusDecoder.
+// LINT.IfChange
+enum StatusSlot {
+  kStatusErrorCode = 0,
+  kStatusSkippedSilenceFrameCount = 1,
+  kStatusIntegratedLoudness = 2,
+  kStatusDecodeOnly = 3,
+  kStatusSlotCount = 4
+};
+// LINT.ThenChange(../java/com/google/android/exoplayer2/ext/opus/OpusDecoder.java)
+
+// In an unnamed namespace, since other extensions' contexts are linked into the
+// same library when it's combined.
+namespace {
+
+struct JniContext {
+  JniContext() : recorder(exoplayer_jni::session_format::kCodecOpus) {}
+
+  OpusMSDecoder* decoder = NULL;
+  int channelCount = 0;
+  int sampleRate = 0;
+  bool outputFloat = false;
+  // Processes the decoded samples if an AudioChainConfig has been set and
+  // changes them, in which case they're decoded into |chainInput| first.
+  exoplayer_jni::AudioChain audioChain;
+  std::vector<uint8_t> chainInput;
+  exoplayer_jni::DecoderStats stats;
+  exoplayer_jni::SessionRecorder recorder;
+  exoplayer_jni::StatusBlock<kStatusSlotCount> status;
+  // Decodes on a background thread if decoding ahead has been started, in
+  // which case it's the only thread that uses |decoder| and |audioChain| other
+  // than while it's flushed. Destroyed first, since it uses the other members.
+  std::unique_ptr<exoplayer_jni::DecodeAheadThread> decodeAhead;
+};
+
+}  // namespace
+
+static int getMaxOutputSize(const JniContext* context) {
+  const int byteSizePerSample = context->outputFloat ?
+      kBytesPerFloatSample : kBytesPerIntPcmSample;
+  return context->audioChain.IsPassthrough() ?
+      kMaxOpusOutputPacketSizeSamples * byteSizePerSample *
+          context->channelCount :
+      context->audioChain.GetMaxOutputSize(kMaxOpusOutputPacketSizeSamples);
+}
+
+// Decodes a packet into |outputBuffer|, which must have space for
+// getMaxOutputSize() bytes, and writes the values of the status slots before
+// kStatusDecodeOnly to |status|. Returns the number of bytes of output, or an
+// Opus error code.
+static int decodePacket(JniContext* context, const uint8_t* inputBuffer,
+                        int inputSize, uint8_t* outputBuffer,
+                        int64_t* status) {
+  exoplayer_jni::ScopedSessionRecord record(
+      &context->recorder, exoplayer_jni::session_format::kRecordDecode,
+      inputBuffer, inputSize);
+  const int byteSizePerSample = context->outputFloat ?
+      kBytesPerFloatSample : kBytesPerIntPcmSample;
+  const bool useAudioChain = !context->audioChain.IsPassthrough();
+
+  context->stats.Increment(exoplayer_jni::DecoderStats::kInputBufferCount);
+  context->stats.Increment(exoplayer_jni::DecoderStats::kInputByteCount,
+                           inputSize);
+  const int64_t startTimeUs = exoplayer_jni::GetMonotonicTimeUs();
+  uint8_t* const decodeBufferData =
+      useAudioChain ? context->chainInput.data() : outputBuffer;
+  int sampleCount;
+  if (context->outputFloat) {
+    EXO_TRACE_SCOPE("opus:decode");
+    sampleCount = opus_multistream_decode_float(context->decoder, inputBuffer,
+      inputSize, reinterpret_cast<float*>(decodeBufferData),
+      kMaxOpusOutputPacketSizeSamples, 0);
+  } else {
+    EXO_TRACE_SCOPE("opus:decode");
+    sampleCount = opus_multistream_decode(context->decoder, inputBuffer,
+      inputSize, reinterpret_cast<int16_t*>(decodeBufferData),
+      kMaxOpusOutputPacketSizeSamples, 0);
+  }
+  int outputByteCount = sampleCount * byteSizePerSample * context->channelCount;
+  if (sampleCount > 0 && useAudioChain) {
+    EXO_TRACE_SCOPE("opus:audioChain");
+    outputByteCount = context->audioChain.Process(
+        decodeBufferData, sampleCount, outputBuffer,
+        getMaxOutputSize(context));
+  }
+  context->stats.RecordLatency(
+      exoplayer_jni::DecoderStats::kDecodeTime,
+      exoplayer_jni::GetMonotonicTimeUs() - startTimeUs);
+
+  // record error code
+  status[kStatusErrorCode] = (sampleCount < 0) ? sampleCount : 0;
+  status[kStatusSkippedSilenceFrameCount] =
+      sampleCount > 0 && useAudioChain ?
+          context->audioChain.skipped_frame_count() : 0;
+  status[kStatusIntegratedLoudness] =
+      exoplayer_jni::GetLoudnessStatus(context->audioChain);
+  record.set_result(sampleCount);
+  if (sampleCount < 0) {
+    context->stats.Increment(exoplayer_jni::DecoderStats::kDecodeErrorCount);
+    return sampleCount;
+  }
+  context->stats.Increment(exoplayer_jni::DecoderStats::kOutputBufferCount);
+  context->stats.Increment(exoplayer_jni::DecoderStats::kOutputByteCount,
+                           outputByteCount);
+  return outputByteCount;
+}
+
+// Copies the oldest block decoded ahead into |jOutputBuffer| and publishes its
+// status values, if a block is ready or |drain| is true and any block has been
+// decoded. Returns the number of bytes of output, an Opus error code,
+// kNoDecodeAheadOutput if there's no block, or -1 if an exception is pending.
+static jint takeDecodeAheadBlock(JNIEnv* env, JniContext* context,
+                                 jobject jOutputBuffer, bool drain) {
+  const exoplayer_jni::DecodeAheadBlock* block =
+      context->decodeAhead->Peek(drain);
+  if (block == NULL) {
+    return kNoDecodeAheadOutput;
+  }
+  for (int i = 0; i < kStatusDecodeOnly; i++) {
+    context->status.Set(i, block->status[i]);
+  }
+  context->status.Set(kStatusDecodeOnly,
+                      (block->flags & kDecodeAheadFlagDecodeOnly) != 0);
+  jint result = block->result;
+  if (result >= 0) {
+    jobject jOutputBufferData;
+    {
+      exoplayer_jni::ScopedUpcallTimer upcallTimer(&context->stats);
+      jOutputBufferData = env->CallObjectMethod(
+          jOutputBuffer, outputBufferInit, block->time_us, result);
+    }
+    if (env->ExceptionCheck()) {
+      // Exception is thrown in Java when returning from the native call.
+      result = -1;
+    } else {
+      memcpy(env->GetDirectBufferAddress(jOutputBufferData), block->data(),
+             result);
+    }
+  }
+  context->decodeAhead->Pop();
+  return result;
+}
 
 DECODER_FUNC(jlong, opusInit, jint sampleRate, jint channelCount,
      jint numStreams, jint numCoupled, jint gain, jbyteArray jStreamMap) {
   int status = OPUS_INVALID_STATE;
-  ::channelCount = channelCount;
-  errorCode = 0;
   jbyte* streamMapBytes = env->GetByteArrayElements(jStreamMap, 0);
   uint8_t* streamMap = reinterpret_cast<uint8_t*>(streamMapBytes);
   OpusMSDecoder* decoder = opus_multistream_decoder_create(
       sampleRate, channelCount, numStreams, numCoupled, streamMap, &status);
+  const std::vector<uint8_t> streamMapCopy(streamMap,
+                                           streamMap + channelCount);
   env->ReleaseByteArrayElements(jStreamMap, streamMapBytes, 0);
   if (!decoder || status != OPUS_OK) {
     LOGE("Failed to create Opus Decoder; status=%s", opus_strerror(status));
@@ -82,62 +255,114 @@ DECODER_FUNC(jlong, opusInit, jint sampleRate, jint channelCount,
   status = opus_multistream_decoder_ctl(decoder, OPUS_SET_GAIN(gain));
   if (status != OPUS_OK) {
     LOGE("Failed to set Opus header gain; status=%s", opus_strerror(status));
+    opus_multistream_decoder_destroy(decoder);
     return 0;
   }
 
-  // Populate JNI References.
-  const jclass outputBufferClass = env->FindClass(
-      "com/google/android/exoplayer2/decoder/SimpleOutputBuffer");
-  outputBufferInit = env->GetMethodID(outputBufferClass, "init",
-      "(JI)Ljava/nio/ByteBuffer;");
-
-  return reinterpret_cast<intptr_t>(decoder);
+  JniContext* context = new JniContext();
+  context->decoder = decoder;
+  context->channelCount = channelCount;
+  context->sampleRate = sampleRate;
+  const int64_t parameters[] = {sampleRate, channelCount, numStreams,
+                                numCoupled, gain};
+  context->recorder.SetInitParameters(parameters, 5, streamMapCopy.data(),
+                                      streamMapCopy.size());
+  return reinterpret_cast<intptr_t>(context);
 }
 
-DECODER_FUNC(jint, opusDecode, jlong jDecoder, jlong jTimeUs,
+DECODER_FUNC(jint, opusDecode, jlong jContext, jlong jTimeUs,
      jobject jInputBuffer, jint inputSize, jobject jOutputBuffer) {
-  OpusMSDecoder* decoder = reinterpret_cast<OpusMSDecoder*>(jDecoder);
+  JniContext* context = reinterpret_cast<JniContext*>(jContext);
+  exoplayer_jni::ScopedNativeCallTimer callTimer(&context->stats);
   const uint8_t* inputBuffer =
       reinterpret_cast<const uint8_t*>(
           env->GetDirectBufferAddress(jInputBuffer));
+  const jint outputSize = getMaxOutputSize(context);
 
-  const int byteSizePerSample = outputFloat ?
-      kBytesPerFloatSample : kBytesPerIntPcmSample;
-  const jint outputSize =
-      kMaxOpusOutputPacketSizeSamples * byteSizePerSample * channelCount;
-
-  env->CallObjectMethod(jOutputBuffer, outputBufferInit, jTimeUs, outputSize);
+  {
+    exoplayer_jni::ScopedUpcallTimer upcallTimer(&context->stats);
+    env->CallObjectMethod(jOutputBuffer, outputBufferInit, jTimeUs,
+                          outputSize);
+  }
   if (env->ExceptionCheck()) {
     // Exception is thrown in Java when returning from the native call.
     return -1;
   }
-  const jobject jOutputBufferData = env->CallObjectMethod(jOutputBuffer,
-      outputBufferInit, jTimeUs, outputSize);
+  jobject jOutputBufferData;
+  {
+    exoplayer_jni::ScopedUpcallTimer upcallTimer(&context->stats);
+    jOutputBufferData = env->CallObjectMethod(jOutputBuffer, outputBufferInit,
+                                              jTimeUs, outputSize);
+  }
   if (env->ExceptionCheck()) {
     // Exception is thrown in Java when returning from the native call.
     return -1;
   }
 
-  int sampleCount;
-  if (outputFloat) {
-    float* outputBufferData = reinterpret_cast<float*>(
-        env->GetDirectBufferAddress(jOutputBufferData));
-    sampleCount = opus_multistream_decode_float(decoder, inputBuffer, inputSize,
-      outputBufferData, kMaxOpusOutputPacketSizeSamples, 0);
-  } else {
-    int16_t* outputBufferData = reinterpret_cast<int16_t*>(
-        env->GetDirectBufferAddress(jOutputBufferData));
-    sampleCount = opus_multistream_decode(decoder, inputBuffer, inputSize,
-      outputBufferData, kMaxOpusOutputPacketSizeSamples, 0);
+  uint8_t* const outputBufferData = reinterpret_cast<uint8_t*>(
+      env->GetDirectBufferAddress(jOutputBufferData));
+  int64_t status[kStatusDecodeOnly];
+  const int result = decodePacket(context, inputBuffer, inputSize,
+                                  outputBufferData, status);
+  for (int i = 0; i < kStatusDecodeOnly; i++) {
+    context->status.Set(i, status[i]);
   }
+  return result;
+}
 
-  // record error code
-  errorCode = (sampleCount < 0) ? sampleCount : 0;
-  return (sampleCount < 0) ? sampleCount
-      : sampleCount * byteSizePerSample * channelCount;
+DECODER_FUNC(jboolean, opusStartDecodeAhead, jlong jContext, jint aheadSize) {
+  JniContext* context = reinterpret_cast<JniContext*>(jContext);
+  if (context->decodeAhead || aheadSize <= 0) {
+    return false;
+  }
+  static_assert(
+      kStatusSlotCount <= exoplayer_jni::DecodeAheadBlock::kMaxStatusCount,
+      "Too many status slots to decode ahead");
+  context->decodeAhead.reset(new exoplayer_jni::DecodeAheadThread(
+      [context](const uint8_t* input, size_t inputSize, uint8_t* output,
+                int64_t* status) {
+        return decodePacket(context, input, static_cast<int>(inputSize),
+                            output, status);
+      },
+      getMaxOutputSize(context), aheadSize, kDecodeAheadInputCapacity));
+  return true;
+}
+
+DECODER_FUNC(jint, opusDecodeAhead, jlong jContext, jlong jTimeUs,
+     jboolean decodeOnly, jobject jInputBuffer, jint inputSize,
+     jobject jOutputBuffer) {
+  JniContext* context = reinterpret_cast<JniContext*>(jContext);
+  exoplayer_jni::ScopedNativeCallTimer callTimer(&context->stats);
+  const uint8_t* inputBuffer =
+      reinterpret_cast<const uint8_t*>(
+          env->GetDirectBufferAddress(jInputBuffer));
+  // Output is taken first, so that the worker can make space for the input if
+  // it's waiting for output to be taken.
+  const jint result =
+      takeDecodeAheadBlock(env, context, jOutputBuffer, /* drain= */ false);
+  if (!context->decodeAhead->Queue(
+          jTimeUs, decodeOnly ? kDecodeAheadFlagDecodeOnly : 0, inputBuffer,
+          inputSize)) {
+    LOGE("Failed to queue input to decode ahead");
+    context->status.Set(kStatusErrorCode, OPUS_INTERNAL_ERROR);
+    return OPUS_INTERNAL_ERROR;
+  }
+  return result;
+}
+
+DECODER_FUNC(jboolean, opusHasDecodeAheadOutput, jlong jContext) {
+  JniContext* context = reinterpret_cast<JniContext*>(jContext);
+  return context->decodeAhead->WaitForOutput();
+}
+
+DECODER_FUNC(jint, opusDrainDecodeAhead, jlong jContext,
+     jobject jOutputBuffer) {
+  JniContext* context = reinterpret_cast<JniContext*>(jContext);
+  exoplayer_jni::ScopedNativeCallTimer callTimer(&context->stats);
+  return takeDecodeAheadBlock(env, context, jOutputBuffer, /* drain= */ true);
 }
 
-DECODER_FUNC(jint, opusSecureDecode, jlong jDecoder, jlong jTimeUs,
+DECODER_FUNC(jint, opusSecureDecode, jlong jContext, jlong jTimeUs,
      jobject jInputBuffer, jint inputSize, jobject jOutputBuffer,
      jint sampleRate, jobject mediaCrypto, jint inputMode, jbyteArray key,
      jbyteArray javaIv, jint inputNumSubSamples, jintArray numBytesOfClearData,
@@ -149,26 +374,136 @@ DECODER_FUNC(jint, opusSecureDecode, jlong jDecoder, jlong jTimeUs,
   return -2;
 }
 
-DECODER_FUNC(void, opusClose, jlong jDecoder) {
-  OpusMSDecoder* decoder = reinterpret_cast<OpusMSDecoder*>(jDecoder);
-  opus_multistream_decoder_destroy(decoder);
+DECODER_FUNC(void, opusClose, jlong jContext) {
+  JniContext* context = reinterpret_cast<JniContext*>(jContext);
+  context->decodeAhead.reset();
+  opus_multistream_decoder_destroy(context->decoder);
+  delete context;
+  exoplayer_jni::FlushProfile();
 }
 
-DECODER_FUNC(void, opusReset, jlong jDecoder) {
-  OpusMSDecoder* decoder = reinterpret_cast<OpusMSDecoder*>(jDecoder);
-  opus_multistream_decoder_ctl(decoder, OPUS_RESET_STATE);
+DECODER_FUNC(void, opusReset, jlong jContext) {
+  JniContext* context = reinterpret_cast<JniContext*>(jContext);
+  exoplayer_jni::ScopedNativeCallTimer callTimer(&context->stats);
+  // Stop the decode-ahead thread first, so that the reset is recorded after
+  // the decodes it made, as it would be when decoding on the caller's thread.
+  if (context->decodeAhead) {
+    context->decodeAhead->Flush();
+  }
+  exoplayer_jni::ScopedSessionRecord record(
+      &context->recorder, exoplayer_jni::session_format::kRecordReset);
+  opus_multistream_decoder_ctl(context->decoder, OPUS_RESET_STATE);
+  context->audioChain.Reset();
 }
 
 DECODER_FUNC(jstring, opusGetErrorMessage, jlong jContext) {
-  return env->NewStringUTF(opus_strerror(errorCode));
+  JniContext* context = reinterpret_cast<JniContext*>(jContext);
+  return env->NewStringUTF(
+      opus_strerror(context->status.Get(kStatusErrorCode)));
+}
+
+DECODER_FUNC(jobject, opusGetStatusBuffer, jlong jContext) {
+  JniContext* context = reinterpret_cast<JniContext*>(jContext);
+  return context->status.NewByteBuffer(env);
+}
+
+DECODER_FUNC(void, opusSetFloatOutput, jlong jContext) {
+  JniContext* context = reinterpret_cast<JniContext*>(jContext);
+  context->outputFloat = true;
+  context->recorder.SetOutputMode(1);
+}
+
+DECODER_FUNC(jboolean, opusSetAudioChainConfig, jlong jContext,
+     jintArray jChannelMap, jfloat gain, jfloat speed, jfloat pitch,
+     jlong minSilenceUs, jlong silencePaddingUs, jfloat silenceThreshold,
+     jboolean measureLoudness, jint waveformFramesPerPeak,
+     jint spectrumFftSize, jint outputSampleRate, jint outputEncoding) {
+  JniContext* context = reinterpret_cast<JniContext*>(jContext);
+  const exoplayer_jni::PcmEncoding encoding = context->outputFloat ?
+      exoplayer_jni::kPcmEncodingFloat : exoplayer_jni::kPcmEncoding16Bit;
+  if (!exoplayer_jni::SetAudioChainConfig(env, jChannelMap, gain, speed, pitch,
+                                          minSilenceUs, silencePaddingUs,
+                                          silenceThreshold, measureLoudness,
+                                          waveformFramesPerPeak,
+                                          spectrumFftSize, outputSampleRate,
+                                          outputEncoding,
+                                          &context->audioChain) ||
+      !context->audioChain.Configure(context->channelCount,
+                                     context->sampleRate, encoding)) {
+    LOGE("Unsupported audio chain configuration");
+    return false;
+  }
+  context->chainInput.resize(kMaxOpusOutputPacketSizeSamples *
+                             context->channelCount *
+                             exoplayer_jni::GetBytesPerSample(encoding));
+  return true;
+}
+
+DECODER_FUNC(void, opusGetStats, jlong jContext, jlongArray jStats) {
+  JniContext* context = reinterpret_cast<JniContext*>(jContext);
+  exoplayer_jni::GetStatsSnapshot(env, context->stats, jStats);
+}
+
+DECODER_FUNC(jint, opusFinishWaveform, jlong jContext, jfloatArray jPeaks) {
+  JniContext* context = reinterpret_cast<JniContext*>(jContext);
+  return exoplayer_jni::FinishWaveform(env, context->audioChain.waveform(),
+                                       jPeaks);
+}
+
+DECODER_FUNC(jboolean, opusGetSpectrum, jlong jContext, jfloatArray jBands) {
+  JniContext* context = reinterpret_cast<JniContext*>(jContext);
+  return exoplayer_jni::GetSpectrum(env, context->audioChain.spectrum(),
+                                    jBands);
+}
+
+DECODER_FUNC(jboolean, opusStartSessionRecording, jlong jContext,
+     jstring jPath) {
+  JniContext* context = reinterpret_cast<JniContext*>(jContext);
+  const char* path = env->GetStringUTFChars(jPath, NULL);
+  const bool started = context->recorder.Start(path);
+  if (!started) {
+    LOGE("Failed to start session recording to %s", path);
+  }
+  env->ReleaseStringUTFChars(jPath, path);
+  return started;
+}
+
+DECODER_FUNC(void, opusStopSessionRecording, jlong jContext) {
+  JniContext* context = reinterpret_cast<JniContext*>(jContext);
+  context->recorder.Stop();
+}
+
+DECODER_FUNC(jlong, opusSetCrossfade, jlong jMixer, jlong durationUs,
+     jint curve) {
+  return exoplayer_jni::SetCrossfade(jMixer, durationUs, curve);
+}
+
+DECODER_FUNC(jint, opusCrossfade, jlong jMixer, jobject jData, jint offset,
+     jint size, jint channelCount, jint sampleRate, jint encoding) {
+  return exoplayer_jni::Crossfade(env, jMixer, jData, offset, size,
+                                  channelCount, sampleRate, encoding);
+}
+
+DECODER_FUNC(jint, opusGetCrossfadeDrainSize, jlong jMixer) {
+  return reinterpret_cast<exoplayer_jni::CrossfadeMixer*>(jMixer)
+      ->GetDrainSize();
 }
 
-DECODER_FUNC(jint, opusGetErrorCode, jlong jContext) {
-  return errorCode;
+DECODER_FUNC(jint, opusDrainCrossfade, jlong jMixer, jobject jOutput,
+     jint capacity) {
+  return exoplayer_jni::DrainCrossfade(env, jMixer, jOutput, capacity);
 }
 
-DECODER_FUNC(void, opusSetFloatOutput) {
-  outputFloat = true;
+DECODER_FUNC(void, opusEndCrossfadeStream, jlong jMixer) {
+  reinterpret_cast<exoplayer_jni::CrossfadeMixer*>(jMixer)->EndStream();
+}
+
+DECODER_FUNC(void, opusFlushCrossfade, jlong jMixer) {
+  reinterpret_cast<exoplayer_jni::CrossfadeMixer*>(jMixer)->Flush();
+}
+
+DECODER_FUNC(void, opusReleaseCrossfade, jlong jMixer) {
+  delete reinterpret_cast<exoplayer_jni::CrossfadeMixer*>(jMixer);
 }
 
 LIBRARY_FUNC(jstring, opusIsSecureDecodeSupported) {
@@ -179,3 +514,54 @@ LIBRARY_FUNC(jstring, opusIsSecureDecodeSupported) {
 LIBRARY_FUNC(jstring, opusGetVersion) {
   return env->NewStringUTF(opus_get_version_string());
 }
+
+#define DECODER_METHOD(NAME, SIGNATURE) \
+  EXOPLAYER_JNI_METHOD(#NAME, SIGNATURE, \
+      Java_com_google_android_exoplayer2_ext_opus_OpusDecoder_ ## NAME)
+
+#define LIBRARY_METHOD(NAME, SIGNATURE) \
+  EXOPLAYER_JNI_METHOD(#NAME, SIGNATURE, \
+      Java_com_google_android_exoplayer2_ext_opus_OpusLibrary_ ## NAME)
+
+static bool registerNativeMethods(JNIEnv* env) {
+  static const JNINativeMethod decoderMethods[] = {
+      DECODER_METHOD(opusInit, "(IIIII[B)J"),
+      DECODER_METHOD(opusDecode, "(JJLjava/nio/ByteBuffer;I"
+          "Lcom/google/android/exoplayer2/decoder/SimpleOutputBuffer;)I"),
+      DECODER_METHOD(opusStartDecodeAhead, "(JI)Z"),
+      DECODER_METHOD(opusDecodeAhead, "(JJZLjava/nio/ByteBuffer;I"
+          "Lcom/google/android/exoplayer2/decoder/SimpleOutputBuffer;)I"),
+      DECODER_METHOD(opusHasDecodeAheadOutput, "(J)Z"),
+      DECODER_METHOD(opusDrainDecodeAhead,
+          "(JLcom/google/android/exoplayer2/decoder/SimpleOutputBuffer;)I"),
+      DECODER_METHOD(opusSecureDecode, "(JJLjava/nio/ByteBuffer;I"
+          "Lcom/google/android/exoplayer2/decoder/SimpleOutputBuffer;I"
+          "Lcom/google/android/exoplayer2/drm/ExoMediaCrypto;I[B[BI[I[I)I"),
+      DECODER_METHOD(opusClose, "(J)V"),
+      DECODER_METHOD(opusReset, "(J)V"),
+      DECODER_METHOD(opusGetStatusBuffer, "(J)Ljava/nio/ByteBuffer;"),
+      DECODER_METHOD(opusGetErrorMessage, "(J)Ljava/lang/String;"),
+      DECODER_METHOD(opusSetFloatOutput, "(J)V"),
+      DECODER_METHOD(opusSetAudioChainConfig, "(J[IFFFJJFZIIII)Z"),
+      DECODER_METHOD(opusFinishWaveform, "(J[F)I"),
+      DECODER_METHOD(opusGetSpectrum, "(J[F)Z"),
+      DECODER_METHOD(opusGetStats, "(J[J)V"),
+      DECODER_METHOD(opusStartSessionRecording, "(JLjava/lang/String;)Z"),
+      DECODER_METHOD(opusStopSessionRecording, "(J)V"),
+      DECODER_METHOD(opusSetCrossfade, "(JJI)J"),
+      DECODER_METHOD(opusCrossfade, "(JLjava/nio/ByteBuffer;IIIII)I"),
+      DECODER_METHOD(opusGetCrossfadeDrainSize, "(J)I"),
+      DECODER_METHOD(opusDrainCrossfade, "(JLjava/nio/ByteBuffer;I)I"),
+      DECODER_METHOD(opusEndCrossfadeStream, "(J)V"),
+      DECODER_METHOD(opusFlushCrossfade, "(J)V"),
+      DECODER_METHOD(opusReleaseCrossfade, "(J)V")};
+  static const JNINativeMethod libraryMethods[] = {
+      LIBRARY_METHOD(opusGetVersion, "()Ljava/lang/String;"),
+      LIBRARY_METHOD(opusIsSecureDecodeSupported, "()Z")};
+  return exoplayer_jni::RegisterNatives(env,
+             "com/google/android/exoplayer2/ext/opus/OpusDecoder",
+             decoderMethods) &&
+         exoplayer_jni::RegisterNatives(env,
+             "com/google/android/exoplayer2/ext/opus/OpusLibrary",
+             libraryMethods);
+}
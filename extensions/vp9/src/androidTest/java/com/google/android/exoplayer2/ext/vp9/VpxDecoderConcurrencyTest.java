@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.google.android.exoplayer2.ext.vp9;
+
+import static com.google.common.truth.Truth.assertWithMessage;
+import static org.junit.Assert.fail;
+
+import androidx.annotation.Nullable;
+import androidx.test.core.app.ApplicationProvider;
+import androidx.test.ext.junit.runners.AndroidJUnit4;
+import com.google.android.exoplayer2.C;
+import com.google.android.exoplayer2.extractor.mkv.MatroskaExtractor;
+import com.google.android.exoplayer2.testutil.FakeExtractorOutput;
+import com.google.android.exoplayer2.testutil.FakeTrackOutput;
+import com.google.android.exoplayer2.testutil.TestUtil;
+import com.google.android.exoplayer2.util.Assertions;
+import com.google.android.exoplayer2.util.Log;
+import com.google.android.exoplayer2.video.VideoDecoderInputBuffer;
+import com.google.android.exoplayer2.video.VideoDecoderOutputBuffer;
+import java.nio.ByteBuffer;
+import java.util.ArrayList;
+import java.util.Arrays;
+import java.util.List;
+import java.util.concurrent.Callable;
+import java.util.concurrent.CountDownLatch;
+import java.util.concurrent.ExecutorService;
+import java.util.concurrent.Executors;
+import java.util.concurrent.Future;
+import java.util.zip.CRC32;
+import org.junit.Before;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+
+/**
+ * Decodes the same stream with several {@link VpxDecoder} instances at once, each on its own
+ * thread, and checks that every instance outputs the same frames as a single instance.
+ *
+ * <p>The aggregate throughput and per-frame latency for each instance count are logged, to show
+ * how decoding scales when several streams are played at once.
+ */
+@RunWith(AndroidJUnit4.class)
+public final class VpxDecoderConcurrencyTest {
+
+  private static final String TAG = "VpxConcurrencyTest";
+  private static final String TEST_FILE = "media/vp9/bear-vp9.webm";
+  private static final int INPUT_BUFFER_SIZE = 768 * 1024;
+  private static final int[] INSTANCE_COUNTS = new int[] {1, 2, 4, 8, 16};
+
+  @Before
+  public void setUp() {
+    if (!VpxLibrary.isAvailable()) {
+      fail("Vpx library not available.");
+    }
+  }
+
+  @Test
+  public void decodeConcurrently_outputsSameFramesAsSingleInstance() throws Exception {
+    FakeExtractorOutput extractorOutput =
+        TestUtil.extractAllSamplesFromFile(
+            new MatroskaExtractor(), ApplicationProvider.getApplicationContext(), TEST_FILE);
+    FakeTrackOutput trackOutput = extractorOutput.trackOutputs.valueAt(0);
+    long[] expectedChecksums = decodeAllSamples(trackOutput, /* frameTimesNs= */ null);
+
+    for (int instanceCount : INSTANCE_COUNTS) {
+      ExecutorService executor = Executors.newFixedThreadPool(instanceCount);
+      CountDownLatch startLatch = new CountDownLatch(1);
+      List<Future<long[]>> results = new ArrayList<>();
+      long[][] frameTimesNs = new long[instanceCount][trackOutput.getSampleCount()];
+      for (int i = 0; i < instanceCount; i++) {
+        long[] instanceFrameTimesNs = frameTimesNs[i];
+        Callable<long[]> task =
+            () -> {
+              startLatch.await();
+              return decodeAllSamples(trackOutput, instanceFrameTimesNs);
+            };
+        results.add(executor.submit(task));
+      }
+      long startTimeNs = System.nanoTime();
+      startLatch.countDown();
+      for (int i = 0; i < instanceCount; i++) {
+        long[] checksums = results.get(i).get();
+        for (int frame = 0; frame < checksums.length; frame++) {
+          assertWithMessage(
+                  "Instance " + i + " of " + instanceCount + ", frame " + frame + " checksum")
+              .that(checksums[frame])
+              .isEqualTo(expectedChecksums[frame]);
+        }
+      }
+      long elapsedTimeNs = System.nanoTime() - startTimeNs;
+      executor.shutdown();
+
+      long[] allFrameTimesNs = new long[instanceCount * trackOutput.getSampleCount()];
+      for (int i = 0; i < instanceCount; i++) {
+        System.arraycopy(
+            frameTimesNs[i],
+            0,
+            allFrameTimesNs,
+            i * trackOutput.getSampleCount(),
+            trackOutput.getSampleCount());
+      }
+      Arrays.sort(allFrameTimesNs);
+      Log.i(
+          TAG,
+          instanceCount
+              + " instances: "
+              + allFrameTimesNs.length * 1_000_000_000L / elapsedTimeNs
+              + " frames/s, p50 "
+              + allFrameTimesNs[(allFrameTimesNs.length - 1) / 2] / 1000
+              + " us, p99 "
+              + allFrameTimesNs[(allFrameTimesNs.length - 1) * 99 / 100] / 1000
+              + " us");
+    }
+  }
+
+  /**
+   * Decodes all samples of {@code trackOutput} to YUV buffers with a new decoder, returning the
+   * checksum of each decoded frame, or zero for samples that didn't output a frame. If {@code
+   * frameTimesNs} is not null, the time taken to decode each frame is written to it.
+   */
+  private static long[] decodeAllSamples(
+      FakeTrackOutput trackOutput, @Nullable long[] frameTimesNs) throws VpxDecoderException {
+    VpxDecoder decoder =
+        new VpxDecoder(
+            /* numInputBuffers= */ 1,
+            /* numOutputBuffers= */ 1,
+            INPUT_BUFFER_SIZE,
+            /* exoMediaCrypto= */ null,
+            /* threads= */ 1);
+    decoder.setOutputMode(C.VIDEO_OUTPUT_MODE_YUV);
+    VideoDecoderInputBuffer inputBuffer = decoder.createInputBuffer();
+    VideoDecoderOutputBuffer outputBuffer = decoder.createOutputBuffer();
+    long[] checksums = new long[trackOutput.getSampleCount()];
+    CRC32 crc = new CRC32();
+    for (int i = 0; i < trackOutput.getSampleCount(); i++) {
+      byte[] sampleData = trackOutput.getSampleData(i);
+      inputBuffer.clear();
+      inputBuffer.ensureSpaceForWrite(sampleData.length);
+      Assertions.checkNotNull(inputBuffer.data).put(sampleData);
+      inputBuffer.flip();
+      inputBuffer.timeUs = trackOutput.getSampleTimeUs(i);
+      outputBuffer.clear();
+      long startTimeNs = System.nanoTime();
+      VpxDecoderException exception =
+          decoder.decode(inputBuffer, outputBuffer, /* reset= */ i == 0);
+      if (frameTimesNs != null) {
+        frameTimesNs[i] = System.nanoTime() - startTimeNs;
+      }
+      if (exception != null) {
+        decoder.release();
+        throw exception;
+      }
+      if (outputBuffer.isDecodeOnly()) {
+        continue;
+      }
+      ByteBuffer outputData = Assertions.checkNotNull(outputBuffer.data);
+      byte[] output = new byte[outputData.limit()];
+      outputData.position(0);
+      outputData.get(output);
+      crc.reset();
+      crc.update(output);
+      checksums[i] = crc.getValue();
+    }
+    decoder.release();
+    return checksums;
+  }
+}
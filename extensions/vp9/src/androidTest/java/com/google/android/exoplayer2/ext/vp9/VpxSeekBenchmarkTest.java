@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.google.android.exoplayer2.ext.vp9;
+
+import static com.google.common.truth.Truth.assertThat;
+import static org.junit.Assert.fail;
+
+import android.content.Context;
+import android.net.Uri;
+import androidx.test.core.app.ApplicationProvider;
+import androidx.test.ext.junit.runners.AndroidJUnit4;
+import com.google.android.exoplayer2.C;
+import com.google.android.exoplayer2.extractor.SeekMap;
+import com.google.android.exoplayer2.extractor.mkv.MatroskaExtractor;
+import com.google.android.exoplayer2.testutil.FakeExtractorOutput;
+import com.google.android.exoplayer2.testutil.FakeTrackOutput;
+import com.google.android.exoplayer2.testutil.TestUtil;
+import com.google.android.exoplayer2.upstream.DefaultDataSourceFactory;
+import com.google.android.exoplayer2.upstream.StatsDataSource;
+import com.google.android.exoplayer2.util.Assertions;
+import com.google.android.exoplayer2.util.Log;
+import com.google.android.exoplayer2.video.VideoDecoderInputBuffer;
+import com.google.android.exoplayer2.video.VideoDecoderOutputBuffer;
+import java.util.Arrays;
+import java.util.Random;
+import org.junit.Before;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+
+/**
+ * Measures the time from a seek to the first output frame with {@link VpxDecoder}, for a sequence
+ * of seeks to random positions.
+ *
+ * <p>The time is split into the extractor seek, which finds the keyframe at or before the seek
+ * position and reads it, the decode of that keyframe after the decoder is reset, and the pre-roll,
+ * which decodes the frames between the keyframe and the frame at the seek position.
+ */
+@RunWith(AndroidJUnit4.class)
+public final class VpxSeekBenchmarkTest {
+
+  private static final String TAG = "VpxSeekBenchmark";
+  private static final String TEST_FILE = "media/vp9/bear-vp9.webm";
+  private static final int INPUT_BUFFER_SIZE = 768 * 1024;
+  private static final int SEEK_COUNT = 50;
+
+  @Before
+  public void setUp() {
+    if (!VpxLibrary.isAvailable()) {
+      fail("Vpx library not available.");
+    }
+  }
+
+  @Test
+  public void randomSeeks_reportsTimeToFirstFrame() throws Exception {
+    Context context = ApplicationProvider.getApplicationContext();
+    FakeTrackOutput expectedTrackOutput =
+        TestUtil.extractAllSamplesFromFile(new MatroskaExtractor(), context, TEST_FILE)
+            .trackOutputs
+            .valueAt(0);
+    Uri fileUri = TestUtil.buildAssetUri(TEST_FILE);
+    MatroskaExtractor extractor = new MatroskaExtractor();
+    FakeExtractorOutput extractorOutput = new FakeExtractorOutput();
+    StatsDataSource dataSource =
+        new StatsDataSource(new DefaultDataSourceFactory(context).createDataSource());
+    SeekMap seekMap = TestUtil.extractSeekMap(extractor, extractorOutput, dataSource, fileUri);
+    assertThat(seekMap.isSeekable()).isTrue();
+    FakeTrackOutput trackOutput = extractorOutput.trackOutputs.valueAt(0);
+    VpxDecoder decoder =
+        new VpxDecoder(
+            /* numInputBuffers= */ 1,
+            /* numOutputBuffers= */ 1,
+            INPUT_BUFFER_SIZE,
+            /* exoMediaCrypto= */ null,
+            /* threads= */ 1);
+    decoder.setOutputMode(C.VIDEO_OUTPUT_MODE_YUV);
+    VideoDecoderInputBuffer inputBuffer = decoder.createInputBuffer();
+    VideoDecoderOutputBuffer outputBuffer = decoder.createOutputBuffer();
+
+    Random random = new Random(/* seed= */ 0);
+    long[] seekTimesNs = new long[SEEK_COUNT];
+    long[] resetTimesNs = new long[SEEK_COUNT];
+    long[] preRollTimesNs = new long[SEEK_COUNT];
+    long[] totalTimesNs = new long[SEEK_COUNT];
+    long preRollFrameCount = 0;
+    dataSource.resetBytesRead();
+    for (int i = 0; i < SEEK_COUNT; i++) {
+      long seekTimeUs = (long) (random.nextDouble() * seekMap.getDurationUs());
+      long startTimeNs = System.nanoTime();
+      int sampleIndex =
+          TestUtil.seekToTimeUs(extractor, seekMap, seekTimeUs, dataSource, trackOutput, fileUri);
+      long seekEndTimeNs = System.nanoTime();
+      assertThat(sampleIndex).isNotEqualTo(C.INDEX_UNSET);
+      int keyframeIndex =
+          getSampleIndex(expectedTrackOutput, trackOutput.getSampleTimeUs(sampleIndex));
+      int targetIndex = Math.max(keyframeIndex, getSampleIndex(expectedTrackOutput, seekTimeUs));
+
+      decodeSample(
+          decoder,
+          expectedTrackOutput,
+          keyframeIndex,
+          targetIndex,
+          /* reset= */ true,
+          inputBuffer,
+          outputBuffer);
+      long resetEndTimeNs = System.nanoTime();
+      for (int j = keyframeIndex + 1; j <= targetIndex; j++) {
+        decodeSample(
+            decoder,
+            expectedTrackOutput,
+            j,
+            targetIndex,
+            /* reset= */ false,
+            inputBuffer,
+            outputBuffer);
+      }
+      long endTimeNs = System.nanoTime();
+      assertThat(outputBuffer.timeUs).isEqualTo(expectedTrackOutput.getSampleTimeUs(targetIndex));
+
+      seekTimesNs[i] = seekEndTimeNs - startTimeNs;
+      resetTimesNs[i] = resetEndTimeNs - seekEndTimeNs;
+      preRollTimesNs[i] = endTimeNs - resetEndTimeNs;
+      totalTimesNs[i] = endTimeNs - startTimeNs;
+      preRollFrameCount += targetIndex - keyframeIndex;
+    }
+    decoder.release();
+
+    Log.i(
+        TAG,
+        TEST_FILE
+            + ": time to first frame p50 "
+            + getPercentileUs(totalTimesNs, 50)
+            + " us, p90 "
+            + getPercentileUs(totalTimesNs, 90)
+            + " us; seek p50 "
+            + getPercentileUs(seekTimesNs, 50)
+            + " us, reset and keyframe decode p50 "
+            + getPercentileUs(resetTimesNs, 50)
+            + " us, pre-roll p50 "
+            + getPercentileUs(preRollTimesNs, 50)
+            + " us over "
+            + preRollFrameCount / (double) SEEK_COUNT
+            + " frames; "
+            + dataSource.getBytesRead() / SEEK_COUNT
+            + " bytes read per seek");
+  }
+
+  /**
+   * Decodes the sample at {@code index}, resetting the decoder first if {@code reset} is true.
+   * Samples before {@code targetIndex} are decoded as decode-only.
+   */
+  private static void decodeSample(
+      VpxDecoder decoder,
+      FakeTrackOutput trackOutput,
+      int index,
+      int targetIndex,
+      boolean reset,
+      VideoDecoderInputBuffer inputBuffer,
+      VideoDecoderOutputBuffer outputBuffer) {
+    byte[] sampleData = trackOutput.getSampleData(index);
+    inputBuffer.clear();
+    inputBuffer.ensureSpaceForWrite(sampleData.length);
+    Assertions.checkNotNull(inputBuffer.data).put(sampleData);
+    inputBuffer.flip();
+    inputBuffer.timeUs = trackOutput.getSampleTimeUs(index);
+    if (index < targetIndex) {
+      inputBuffer.addFlag(C.BUFFER_FLAG_DECODE_ONLY);
+    }
+    outputBuffer.clear();
+    assertThat(decoder.decode(inputBuffer, outputBuffer, reset)).isNull();
+  }
+
+  /** Returns the index of the last sample at or before {@code timeUs}, or 0 if there's none. */
+  private static int getSampleIndex(FakeTrackOutput trackOutput, long timeUs) {
+    int index = 0;
+    while (index + 1 < trackOutput.getSampleCount()
+        && trackOutput.getSampleTimeUs(index + 1) <= timeUs) {
+      index++;
+    }
+    return index;
+  }
+
+  private static long getPercentileUs(long[] timesNs, int percentile) {
+    long[] sortedTimesNs = Arrays.copyOf(timesNs, timesNs.length);
+    Arrays.sort(sortedTimesNs);
+    return sortedTimesNs[(sortedTimesNs.length - 1) * percentile / 100] / 1000;
+  }
+}
@@ -24,6 +24,7 @@ import androidx.annotation.Nullable;
 import com.google.android.exoplayer2.C;
 import com.google.android.exoplayer2.Format;
 import com.google.android.exoplayer2.RendererCapabilities;
+import com.google.android.exoplayer2.decoder.DecoderPrewarmer;
 import com.google.android.exoplayer2.decoder.DecoderReuseEvaluation;
 import com.google.android.exoplayer2.drm.ExoMediaCrypto;
 import com.google.android.exoplayer2.util.MimeTypes;
@@ -51,6 +52,7 @@ public class LibvpxVideoRenderer extends DecoderVideoRenderer {
   private static final int DEFAULT_INPUT_BUFFER_SIZE = 768 * 1024;
 
   private final int threads;
+  private final DecoderPrewarmer<VpxDecoder> decoderPrewarmer;
 
   @Nullable private VpxDecoder decoder;
 
@@ -116,6 +118,27 @@ public class LibvpxVideoRenderer extends DecoderVideoRenderer {
     this.threads = threads;
     this.numInputBuffers = numInputBuffers;
     this.numOutputBuffers = numOutputBuffers;
+    decoderPrewarmer = new DecoderPrewarmer<>();
+  }
+
+  /**
+   * Creates a decoder for {@code format} on a background thread, and allocates its frame buffers
+   * if the format's dimensions are known, so that the decoder is ready when playback starts. The
+   * decoder is used if the renderer's next decoder is for a compatible format, and is released
+   * otherwise, or when the renderer is reset. May be called from any thread.
+   *
+   * @param format The anticipated format.
+   */
+  public void prewarmDecoder(Format format) {
+    decoderPrewarmer.prewarm(
+        format,
+        prewarmFormat -> {
+          VpxDecoder decoder = newDecoder(prewarmFormat, /* mediaCrypto= */ null);
+          if (prewarmFormat.width != Format.NO_VALUE && prewarmFormat.height != Format.NO_VALUE) {
+            decoder.reserveFrameBuffers(prewarmFormat.width, prewarmFormat.height);
+          }
+          return decoder;
+        });
   }
 
   @Override
@@ -143,16 +166,21 @@ public class LibvpxVideoRenderer extends DecoderVideoRenderer {
   protected VpxDecoder createDecoder(Format format, @Nullable ExoMediaCrypto mediaCrypto)
       throws VpxDecoderException {
     TraceUtil.beginSection("createVpxDecoder");
-    int initialInputBufferSize =
-        format.maxInputSize != Format.NO_VALUE ? format.maxInputSize : DEFAULT_INPUT_BUFFER_SIZE;
-    VpxDecoder decoder =
-        new VpxDecoder(
-            numInputBuffers, numOutputBuffers, initialInputBufferSize, mediaCrypto, threads);
+    @Nullable VpxDecoder decoder = decoderPrewarmer.takeDecoder(format);
+    if (decoder == null) {
+      decoder = newDecoder(format, mediaCrypto);
+    }
     this.decoder = decoder;
     TraceUtil.endSection();
     return decoder;
   }
 
+  @Override
+  protected void onReset() {
+    super.onReset();
+    decoderPrewarmer.release();
+  }
+
   @Override
   protected void renderOutputBufferToSurface(VideoDecoderOutputBuffer outputBuffer, Surface surface)
       throws VpxDecoderException {
@@ -181,4 +209,12 @@ public class LibvpxVideoRenderer extends DecoderVideoRenderer {
         REUSE_RESULT_YES_WITHOUT_RECONFIGURATION,
         /* discardReasons= */ 0);
   }
+
+  private VpxDecoder newDecoder(Format format, @Nullable ExoMediaCrypto mediaCrypto)
+      throws VpxDecoderException {
+    int initialInputBufferSize =
+        format.maxInputSize != Format.NO_VALUE ? format.maxInputSize : DEFAULT_INPUT_BUFFER_SIZE;
+    return new VpxDecoder(
+        numInputBuffers, numOutputBuffers, initialInputBufferSize, mediaCrypto, threads);
+  }
 }
@@ -23,6 +23,8 @@ import androidx.annotation.VisibleForTesting;
 import com.google.android.exoplayer2.C;
 import com.google.android.exoplayer2.decoder.CryptoInfo;
 import com.google.android.exoplayer2.decoder.DecoderInputBuffer;
+import com.google.android.exoplayer2.decoder.NativeDecoder;
+import com.google.android.exoplayer2.decoder.NativeDecoderStats;
 import com.google.android.exoplayer2.decoder.SimpleDecoder;
 import com.google.android.exoplayer2.drm.DecryptionException;
 import com.google.android.exoplayer2.drm.ExoMediaCrypto;
@@ -35,15 +37,20 @@ import java.nio.ByteBuffer;
 /** Vpx decoder. */
 @VisibleForTesting(otherwise = PACKAGE_PRIVATE)
 public final class VpxDecoder
-    extends SimpleDecoder<VideoDecoderInputBuffer, VideoDecoderOutputBuffer, VpxDecoderException> {
+    extends SimpleDecoder<VideoDecoderInputBuffer, VideoDecoderOutputBuffer, VpxDecoderException>
+    implements NativeDecoder {
 
   // These constants should match the codes returned from vpxDecode and vpxSecureDecode functions in
   // https://github.com/google/ExoPlayer/blob/release-v2/extensions/vp9/src/main/jni/vpx_jni.cc.
   private static final int NO_ERROR = 0;
   private static final int DECODE_ERROR = -1;
   private static final int DRM_ERROR = -2;
+  // The number of frame buffers libvpx is expected to reference while decoding, in addition to the
+  // buffers of queued output frames.
+  private static final int REFERENCE_FRAME_BUFFER_COUNT = 4;
 
   @Nullable private final ExoMediaCrypto exoMediaCrypto;
+  private final int numOutputBuffers;
   private final long vpxDecContext;
 
   @Nullable private ByteBuffer lastSupplementalData;
@@ -75,6 +82,7 @@ public final class VpxDecoder
       throw new VpxDecoderException("Failed to load decoder native libraries.");
     }
     this.exoMediaCrypto = exoMediaCrypto;
+    this.numOutputBuffers = numOutputBuffers;
     if (exoMediaCrypto != null && !VpxLibrary.vpxIsSecureDecodeSupported()) {
       throw new VpxDecoderException("Vpx decoder does not support secure decode.");
     }
@@ -205,6 +213,36 @@ public final class VpxDecoder
     }
   }
 
+  /**
+   * Allocates the frame buffers that the decoder is expected to need for frames of the given size,
+   * so that they're not allocated while the first frames are being decoded. May be called from any
+   * thread, but must not be called after {@link #release()}.
+   *
+   * @param width The expected frame width.
+   * @param height The expected frame height.
+   */
+  public void reserveFrameBuffers(int width, int height) {
+    vpxReserveFrameBuffers(
+        vpxDecContext, numOutputBuffers + REFERENCE_FRAME_BUFFER_COUNT, width, height);
+  }
+
+  @Override
+  public NativeDecoderStats getNativeStats() {
+    long[] snapshot = new long[NativeDecoderStats.SNAPSHOT_LENGTH];
+    vpxGetStats(vpxDecContext, snapshot);
+    return new NativeDecoderStats(snapshot);
+  }
+
+  @Override
+  public boolean startSessionRecording(String path) {
+    return vpxStartSessionRecording(vpxDecContext, path);
+  }
+
+  @Override
+  public void stopSessionRecording() {
+    vpxStopSessionRecording(vpxDecContext);
+  }
+
   private native long vpxInit(
       boolean disableLoopFilter, boolean enableRowMultiThreadMode, int threads);
 
@@ -240,5 +278,10 @@ public final class VpxDecoder
 
   private native int vpxGetErrorCode(long context);
   private native String vpxGetErrorMessage(long context);
+  private native int vpxReserveFrameBuffers(long context, int count, int width, int height);
+
+  private native void vpxGetStats(long context, long[] stats);
+  private native boolean vpxStartSessionRecording(long context, String path);
+  private native void vpxStopSessionRecording(long context);
 
 }
@@ -22,6 +22,9 @@ LIBVPX_ROOT := $(WORKING_DIR)/libvpx
 LOCAL_PATH := $(WORKING_DIR)
 include libvpx.mk
 
+# build libexoplayerjnicommon.a
+include $(WORKING_DIR)/../../../../jni_common/jni_common.mk
+
 # build libvpxV2JNI.so
 include $(CLEAR_VARS)
 LOCAL_PATH := $(WORKING_DIR)
@@ -31,7 +34,5 @@ LOCAL_CPP_EXTENSION := .cc
 LOCAL_SRC_FILES := vpx_jni.cc
 LOCAL_LDLIBS := -llog -lz -lm -landroid
 LOCAL_SHARED_LIBRARIES := libvpx
-LOCAL_STATIC_LIBRARIES := cpufeatures
+LOCAL_STATIC_LIBRARIES := exoplayerjnicommon
 include $(BUILD_SHARED_LIBRARY)
-
-$(call import-module,android/cpufeatures)
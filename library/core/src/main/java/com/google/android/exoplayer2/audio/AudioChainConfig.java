@@ -0,0 +1,650 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.google.android.exoplayer2.audio;
+
+import static java.lang.Math.max;
+import static java.lang.Math.min;
+
+import androidx.annotation.IntDef;
+import androidx.annotation.Nullable;
+import com.google.android.exoplayer2.C;
+import com.google.android.exoplayer2.Format;
+import com.google.android.exoplayer2.metadata.Metadata;
+import com.google.android.exoplayer2.metadata.flac.VorbisComment;
+import com.google.android.exoplayer2.util.Assertions;
+import com.google.android.exoplayer2.util.Util;
+import com.google.common.base.Ascii;
+import java.lang.annotation.Documented;
+import java.lang.annotation.Retention;
+import java.lang.annotation.RetentionPolicy;
+
+/**
+ * Configuration of the processing that the native audio decoders in the FFmpeg, Opus and FLAC
+ * extensions apply to their output before returning it: channel mapping, gain, speed and pitch
+ * changes, sample rate conversion and sample format conversion.
+ *
+ * <p>The stages run in a single pass over each decoded buffer in native code, instead of each
+ * needing a pass in an {@link AudioProcessor}. Sample rates are converted by linear interpolation,
+ * as in {@link SonicAudioProcessor}. The speed is changed without changing the pitch by a WSOLA
+ * time stretcher, and the pitch is changed by stretching the audio and resampling it back to its
+ * duration. Silence can be skipped as in {@link SilenceSkippingAudioProcessor}, with the peak of
+ * each block measured by SIMD code as it's written, rather than in another pass over the output.
+ * Loudness is normalized by folding the gain from a stream's ReplayGain or R128 tags into the gain
+ * stage, and the integrated loudness of the decoded audio can be measured as specified by EBU R128
+ * while it's decoded, without an analysis pass. For drawing waveforms, the decoded audio can
+ * instead be reduced to the minimum, maximum and RMS of each run of frames, which the decoders
+ * output in place of the audio. For visualizations, a spectrum tap can keep the most recent
+ * decoded audio and compute the levels of its frequency bands with a SIMD FFT on demand.
+ *
+ * <p>The speed and pitch are fixed for the lifetime of a decoder. {@link DecoderAudioRenderer} maps
+ * the timestamps of sped up output to and from the audio sink's timeline, so the sink itself must
+ * play at normal speed.
+ */
+public final class AudioChainConfig {
+
+  /** The maximum number of input and output channels. */
+  public static final int MAX_CHANNEL_COUNT = 8;
+  /** The minimum speed and pitch. */
+  public static final float MIN_SPEED_OR_PITCH = 0.125f;
+  /** The maximum speed and pitch. */
+  public static final float MAX_SPEED_OR_PITCH = 8f;
+  /**
+   * The number of float values in each waveform peak output when {@link #isReducingToWaveform()}:
+   * the minimum sample, the maximum sample and the RMS of the samples of all channels.
+   */
+  public static final int WAVEFORM_VALUES_PER_PEAK = 3;
+  /** The minimum FFT size of the spectrum tap. */
+  public static final int MIN_SPECTRUM_FFT_SIZE = 16;
+  /** The maximum FFT size of the spectrum tap. */
+  public static final int MAX_SPECTRUM_FFT_SIZE = 16384;
+
+  /**
+   * How the loudness normalization gain in a stream's tags is applied. One of {@link
+   * #REPLAY_GAIN_MODE_OFF}, {@link #REPLAY_GAIN_MODE_TRACK} or {@link #REPLAY_GAIN_MODE_ALBUM}.
+   */
+  @Documented
+  @Retention(RetentionPolicy.SOURCE)
+  @IntDef({REPLAY_GAIN_MODE_OFF, REPLAY_GAIN_MODE_TRACK, REPLAY_GAIN_MODE_ALBUM})
+  public @interface ReplayGainMode {}
+  /** Loudness normalization tags are ignored. */
+  public static final int REPLAY_GAIN_MODE_OFF = 0;
+  /** The track gain is applied, or the album gain if the stream has no track gain. */
+  public static final int REPLAY_GAIN_MODE_TRACK = 1;
+  /** The album gain is applied, or the track gain if the stream has no album gain. */
+  public static final int REPLAY_GAIN_MODE_ALBUM = 2;
+
+  /**
+   * The difference between the ReplayGain 2.0 reference level of -18 LUFS and the -23 LUFS that
+   * R128 gain tags are relative to, in dB.
+   */
+  private static final float R128_TO_REPLAY_GAIN_DB = 5f;
+
+  /** Builder for {@link AudioChainConfig}. */
+  public static final class Builder {
+
+    @Nullable private int[] channelMap;
+    private float gain;
+    private float speed;
+    private float pitch;
+    private long minimumSilenceDurationUs;
+    private long paddingSilenceUs;
+    private short silenceThresholdLevel;
+    @ReplayGainMode private int replayGainMode;
+    private float replayGainPreampDb;
+    private boolean measureLoudness;
+    private int waveformFramesPerPeak;
+    private int spectrumFftSize;
+    private int outputSampleRate;
+    @C.PcmEncoding private int outputEncoding;
+
+    /**
+     * Creates a new builder. By default the input channels, sample rate and encoding are kept, the
+     * gain, speed and pitch are 1, silence isn't skipped, loudness tags are ignored, loudness
+     * isn't measured, audio is output rather than waveform peaks and the spectrum tap is
+     * disabled.
+     */
+    public Builder() {
+      gain = 1f;
+      speed = 1f;
+      pitch = 1f;
+      minimumSilenceDurationUs = C.TIME_UNSET;
+      replayGainMode = REPLAY_GAIN_MODE_OFF;
+      outputSampleRate = Format.NO_VALUE;
+      outputEncoding = C.ENCODING_INVALID;
+    }
+
+    /**
+     * Sets the channel map, or null to output the input channels unchanged.
+     *
+     * @param channelMap For each output channel, the index of the input channel it's read from.
+     *     Input channels may be dropped or duplicated.
+     * @return This builder.
+     */
+    public Builder setChannelMap(@Nullable int[] channelMap) {
+      if (channelMap != null) {
+        Assertions.checkArgument(
+            channelMap.length > 0 && channelMap.length <= MAX_CHANNEL_COUNT);
+        for (int channel : channelMap) {
+          Assertions.checkArgument(channel >= 0 && channel < MAX_CHANNEL_COUNT);
+        }
+      }
+      this.channelMap = channelMap == null ? null : channelMap.clone();
+      return this;
+    }
+
+    /**
+     * Sets the gain applied to every sample.
+     *
+     * @param gain The gain, as a linear factor.
+     * @return This builder.
+     */
+    public Builder setGain(float gain) {
+      Assertions.checkArgument(gain >= 0f);
+      this.gain = gain;
+      return this;
+    }
+
+    /**
+     * Sets the factor by which playback is sped up, without changing the pitch.
+     *
+     * @param speed The speed, between {@link #MIN_SPEED_OR_PITCH} and {@link #MAX_SPEED_OR_PITCH}.
+     * @return This builder.
+     */
+    public Builder setSpeed(float speed) {
+      Assertions.checkArgument(speed >= MIN_SPEED_OR_PITCH && speed <= MAX_SPEED_OR_PITCH);
+      this.speed = speed;
+      return this;
+    }
+
+    /**
+     * Sets the factor by which the pitch is raised, without changing the duration.
+     *
+     * @param pitch The pitch, between {@link #MIN_SPEED_OR_PITCH} and {@link #MAX_SPEED_OR_PITCH}.
+     * @return This builder.
+     */
+    public Builder setPitch(float pitch) {
+      Assertions.checkArgument(pitch >= MIN_SPEED_OR_PITCH && pitch <= MAX_SPEED_OR_PITCH);
+      this.pitch = pitch;
+      return this;
+    }
+
+    /**
+     * Enables skipping silence, which has the same meaning as in {@link
+     * SilenceSkippingAudioProcessor}. Silence is detected in blocks of output frames, so silence is
+     * only skipped in blocks whose samples are all at or below the threshold.
+     *
+     * <p>Up to {@code minimumSilenceDurationUs} of silence is held back by the native decoder until
+     * it's known whether it will be skipped, so silence at the end of the stream is dropped.
+     *
+     * @param minimumSilenceDurationUs The duration of silence after which the rest of the silence
+     *     is skipped, in microseconds.
+     * @param paddingSilenceUs The duration of silence kept at each end of a skipped run of silence,
+     *     in microseconds. At most {@code minimumSilenceDurationUs}.
+     * @param silenceThresholdLevel The magnitude of 16-bit samples at or below which they're
+     *     silent. Samples in other encodings are compared at the same level.
+     * @return This builder.
+     */
+    public Builder setSilenceSkipping(
+        long minimumSilenceDurationUs, long paddingSilenceUs, short silenceThresholdLevel) {
+      Assertions.checkArgument(
+          minimumSilenceDurationUs > 0
+              && paddingSilenceUs >= 0
+              && paddingSilenceUs <= minimumSilenceDurationUs
+              && silenceThresholdLevel >= 0);
+      this.minimumSilenceDurationUs = minimumSilenceDurationUs;
+      this.paddingSilenceUs = paddingSilenceUs;
+      this.silenceThresholdLevel = silenceThresholdLevel;
+      return this;
+    }
+
+    /**
+     * Sets how the loudness normalization gain in a stream's ReplayGain or R128 tags is applied.
+     * The gain is read from the stream's {@link VorbisComment VorbisComments} by {@link
+     * #forMetadata(Metadata)}, and applied on top of the gain set by {@link #setGain(float)} in
+     * the same pass. The gain is reduced if the tagged peak would otherwise clip. Streams without
+     * tags are output at the set gain.
+     *
+     * @param replayGainMode The {@link ReplayGainMode}.
+     * @param preampDb The gain added to the tagged gain, in dB.
+     * @return This builder.
+     */
+    public Builder setReplayGain(@ReplayGainMode int replayGainMode, float preampDb) {
+      this.replayGainMode = replayGainMode;
+      this.replayGainPreampDb = preampDb;
+      return this;
+    }
+
+    /**
+     * Sets whether the integrated loudness of the decoded audio is measured as specified by EBU
+     * R128, with K-weighting and gating, while it's decoded. The measurement is of the audio
+     * before the gain is applied, so it can be used to normalize later playbacks. The native
+     * decoders' {@code getIntegratedLoudnessLufs} methods return the loudness of the audio decoded
+     * so far in LUFS, or {@link Double#NEGATIVE_INFINITY} if loudness isn't measured or no audio
+     * was loud enough to be measured.
+     *
+     * @param measureLoudness Whether loudness is measured.
+     * @return This builder.
+     */
+    public Builder setLoudnessMeasurementEnabled(boolean measureLoudness) {
+      this.measureLoudness = measureLoudness;
+      return this;
+    }
+
+    /**
+     * Sets the number of frames per waveform peak, or 0 to output audio. If non-zero, the decoders
+     * reduce the decoded audio to {@link #WAVEFORM_VALUES_PER_PEAK} floats per run of {@code
+     * waveformFramesPerPeak} frames, in native byte order, and output the peaks that each buffer
+     * completes instead of the audio. Peaks are aligned to the start of the stream.
+     *
+     * <p>The last peak is completed at the end of the stream by the decoders' {@code
+     * finishWaveform(float[])} methods, which must only be called once the end of stream output
+     * buffer has been dequeued. They write the remaining peaks to an array that must hold at least
+     * {@link #WAVEFORM_VALUES_PER_PEAK} values, and return the number of peaks written.
+     *
+     * <p>The channel map and gain apply to the peaks. The speed, pitch, silence skipping, output
+     * sample rate and output encoding don't. The output isn't audio, so it mustn't be played.
+     *
+     * @param waveformFramesPerPeak The number of frames per peak, or 0 to output audio.
+     * @return This builder.
+     */
+    public Builder setWaveformFramesPerPeak(int waveformFramesPerPeak) {
+      Assertions.checkArgument(waveformFramesPerPeak >= 0);
+      this.waveformFramesPerPeak = waveformFramesPerPeak;
+      return this;
+    }
+
+    /**
+     * Sets the FFT size of the spectrum tap, or 0 to disable it. If non-zero, the decoders keep the
+     * last {@code spectrumFftSize} decoded frames, after the channel map and gain, and compute the
+     * levels of logarithmically spaced frequency bands, from 20 Hz to half the sample rate, from
+     * them when their {@code getSpectrum(float[])} methods are called. The audio is output
+     * unchanged.
+     *
+     * <p>{@code getSpectrum} writes the level of each band to an array whose length is the number
+     * of bands, which must be between 1 and half the FFT size, in dB relative to a full scale sine
+     * wave. It returns whether the levels were written, which they aren't if the spectrum tap is
+     * disabled, or less audio than the FFT size has been decoded since the decoder was created or
+     * flushed, or the decoder has been released. It may be called from any thread, including while
+     * or after the decoder is released.
+     *
+     * <p>The frames are analyzed when they're decoded, so the spectrum leads the audio that's
+     * being played by the duration of the audio sink's buffer.
+     *
+     * @param spectrumFftSize A power of two between {@link #MIN_SPECTRUM_FFT_SIZE} and {@link
+     *     #MAX_SPECTRUM_FFT_SIZE}, or 0 to disable the spectrum tap.
+     * @return This builder.
+     */
+    public Builder setSpectrumFftSize(int spectrumFftSize) {
+      Assertions.checkArgument(
+          spectrumFftSize == 0
+              || (spectrumFftSize >= MIN_SPECTRUM_FFT_SIZE
+                  && spectrumFftSize <= MAX_SPECTRUM_FFT_SIZE
+                  && Integer.bitCount(spectrumFftSize) == 1));
+      this.spectrumFftSize = spectrumFftSize;
+      return this;
+    }
+
+    /**
+     * Sets the output sample rate, or {@link Format#NO_VALUE} to keep the input sample rate.
+     *
+     * @param outputSampleRate The output sample rate in Hz.
+     * @return This builder.
+     */
+    public Builder setOutputSampleRate(int outputSampleRate) {
+      Assertions.checkArgument(outputSampleRate > 0 || outputSampleRate == Format.NO_VALUE);
+      this.outputSampleRate = outputSampleRate;
+      return this;
+    }
+
+    /**
+     * Sets the output encoding, or {@link C#ENCODING_INVALID} to keep the input encoding.
+     *
+     * @param outputEncoding One of {@link C#ENCODING_PCM_16BIT}, {@link C#ENCODING_PCM_24BIT},
+     *     {@link C#ENCODING_PCM_32BIT}, {@link C#ENCODING_PCM_FLOAT} or {@link
+     *     C#ENCODING_INVALID}.
+     * @return This builder.
+     */
+    public Builder setOutputEncoding(@C.PcmEncoding int outputEncoding) {
+      Assertions.checkArgument(
+          outputEncoding == C.ENCODING_INVALID
+              || outputEncoding == C.ENCODING_PCM_16BIT
+              || outputEncoding == C.ENCODING_PCM_24BIT
+              || outputEncoding == C.ENCODING_PCM_32BIT
+              || outputEncoding == C.ENCODING_PCM_FLOAT);
+      this.outputEncoding = outputEncoding;
+      return this;
+    }
+
+    /** Builds an {@link AudioChainConfig}. */
+    public AudioChainConfig build() {
+      return new AudioChainConfig(
+          channelMap,
+          gain,
+          speed,
+          pitch,
+          minimumSilenceDurationUs,
+          paddingSilenceUs,
+          silenceThresholdLevel,
+          replayGainMode,
+          replayGainPreampDb,
+          measureLoudness,
+          waveformFramesPerPeak,
+          spectrumFftSize,
+          outputSampleRate,
+          outputEncoding);
+    }
+  }
+
+  /** The gain applied to every sample, as a linear factor. */
+  public final float gain;
+  /** The factor by which playback is sped up, without changing the pitch. */
+  public final float speed;
+  /** The factor by which the pitch is raised, without changing the duration. */
+  public final float pitch;
+  /**
+   * The duration of silence after which the rest of the silence is skipped, in microseconds, or
+   * {@link C#TIME_UNSET} if silence isn't skipped.
+   */
+  public final long minimumSilenceDurationUs;
+  /** The duration of silence kept at each end of a skipped run of silence, in microseconds. */
+  public final long paddingSilenceUs;
+  /** The magnitude of 16-bit samples at or below which they're silent. */
+  public final short silenceThresholdLevel;
+  /** How the loudness normalization gain in a stream's tags is applied. */
+  @ReplayGainMode public final int replayGainMode;
+  /** The gain added to the tagged loudness normalization gain, in dB. */
+  public final float replayGainPreampDb;
+  /** Whether the integrated loudness of the decoded audio is measured. */
+  public final boolean measureLoudness;
+  /** The number of frames per waveform peak, or 0 if audio is output. */
+  public final int waveformFramesPerPeak;
+  /** The FFT size of the spectrum tap, or 0 if it's disabled. */
+  public final int spectrumFftSize;
+  /** The output sample rate, or {@link Format#NO_VALUE} to keep the input sample rate. */
+  public final int outputSampleRate;
+  /** The output encoding, or {@link C#ENCODING_INVALID} to keep the input encoding. */
+  @C.PcmEncoding public final int outputEncoding;
+
+  @Nullable private final int[] channelMap;
+
+  private AudioChainConfig(
+      @Nullable int[] channelMap,
+      float gain,
+      float speed,
+      float pitch,
+      long minimumSilenceDurationUs,
+      long paddingSilenceUs,
+      short silenceThresholdLevel,
+      @ReplayGainMode int replayGainMode,
+      float replayGainPreampDb,
+      boolean measureLoudness,
+      int waveformFramesPerPeak,
+      int spectrumFftSize,
+      int outputSampleRate,
+      @C.PcmEncoding int outputEncoding) {
+    this.channelMap = channelMap;
+    this.gain = gain;
+    this.speed = speed;
+    this.pitch = pitch;
+    this.minimumSilenceDurationUs = minimumSilenceDurationUs;
+    this.paddingSilenceUs = paddingSilenceUs;
+    this.silenceThresholdLevel = silenceThresholdLevel;
+    this.replayGainMode = replayGainMode;
+    this.replayGainPreampDb = replayGainPreampDb;
+    this.measureLoudness = measureLoudness;
+    this.waveformFramesPerPeak = waveformFramesPerPeak;
+    this.spectrumFftSize = spectrumFftSize;
+    this.outputSampleRate = outputSampleRate;
+    this.outputEncoding = outputEncoding;
+  }
+
+  /**
+   * Returns a copy of the channel map, or null if the input channels are output unchanged. For each
+   * output channel, the map contains the index of the input channel it's read from.
+   */
+  @Nullable
+  public int[] getChannelMap() {
+    return channelMap == null ? null : channelMap.clone();
+  }
+
+  /**
+   * Returns whether the configuration can be applied to input with {@code channelCount} channels,
+   * which is the case if the channel map only refers to channels that the input has.
+   */
+  public boolean isApplicableTo(int channelCount) {
+    if (channelCount <= 0 || channelCount > MAX_CHANNEL_COUNT) {
+      return false;
+    }
+    if (channelMap != null) {
+      for (int channel : channelMap) {
+        if (channel >= channelCount) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  /** Returns whether silence is skipped. */
+  public boolean isSkippingSilence() {
+    return minimumSilenceDurationUs != C.TIME_UNSET;
+  }
+
+  /** Returns whether the decoded audio is reduced to waveform peaks rather than output. */
+  public boolean isReducingToWaveform() {
+    return waveformFramesPerPeak > 0;
+  }
+
+  /**
+   * Returns the level at or below which samples are silent, as a linear magnitude relative to full
+   * scale. This is the threshold passed to the native decoders.
+   */
+  public float getSilenceThreshold() {
+    return silenceThresholdLevel / 32768f;
+  }
+
+  /**
+   * Returns the configuration for a stream with {@code metadata}, with the loudness normalization
+   * gain from the stream's ReplayGain or R128 {@link VorbisComment VorbisComments} applied to
+   * {@link #gain} according to the {@link #replayGainMode}. The returned configuration doesn't
+   * apply tags again. Returns this configuration if tags are ignored or the stream has none.
+   *
+   * @param metadata The stream's {@link Format#metadata}.
+   * @return The configuration for the stream.
+   */
+  public AudioChainConfig forMetadata(@Nullable Metadata metadata) {
+    if (replayGainMode == REPLAY_GAIN_MODE_OFF || metadata == null) {
+      return this;
+    }
+    float trackGainDb = Float.NaN;
+    float albumGainDb = Float.NaN;
+    float r128TrackGainDb = Float.NaN;
+    float r128AlbumGainDb = Float.NaN;
+    float trackPeak = Float.NaN;
+    float albumPeak = Float.NaN;
+    for (int i = 0; i < metadata.length(); i++) {
+      Metadata.Entry entry = metadata.get(i);
+      if (!(entry instanceof VorbisComment)) {
+        continue;
+      }
+      String value = ((VorbisComment) entry).value;
+      switch (Ascii.toUpperCase(((VorbisComment) entry).key)) {
+        case "REPLAYGAIN_TRACK_GAIN":
+          trackGainDb = parseReplayGainDb(value);
+          break;
+        case "REPLAYGAIN_ALBUM_GAIN":
+          albumGainDb = parseReplayGainDb(value);
+          break;
+        case "REPLAYGAIN_TRACK_PEAK":
+          trackPeak = parseFloat(value);
+          break;
+        case "REPLAYGAIN_ALBUM_PEAK":
+          albumPeak = parseFloat(value);
+          break;
+        case "R128_TRACK_GAIN":
+          r128TrackGainDb = parseR128GainDb(value);
+          break;
+        case "R128_ALBUM_GAIN":
+          r128AlbumGainDb = parseR128GainDb(value);
+          break;
+        default:
+          break;
+      }
+    }
+    // ReplayGain tags take precedence over R128 tags, which have no peaks.
+    if (Float.isNaN(trackGainDb)) {
+      trackGainDb = r128TrackGainDb;
+      trackPeak = Float.NaN;
+    }
+    if (Float.isNaN(albumGainDb)) {
+      albumGainDb = r128AlbumGainDb;
+      albumPeak = Float.NaN;
+    }
+    boolean useAlbumGain =
+        Float.isNaN(trackGainDb)
+            || (replayGainMode == REPLAY_GAIN_MODE_ALBUM && !Float.isNaN(albumGainDb));
+    float gainDb = useAlbumGain ? albumGainDb : trackGainDb;
+    float peak = useAlbumGain ? albumPeak : trackPeak;
+    if (Float.isNaN(gainDb)) {
+      return this;
+    }
+    float normalizationGain = (float) Math.pow(10, (gainDb + replayGainPreampDb) / 20);
+    if (peak > 0f) {
+      normalizationGain = min(normalizationGain, 1f / peak);
+    }
+    return new AudioChainConfig(
+        channelMap,
+        gain * normalizationGain,
+        speed,
+        pitch,
+        minimumSilenceDurationUs,
+        paddingSilenceUs,
+        silenceThresholdLevel,
+        REPLAY_GAIN_MODE_OFF,
+        /* replayGainPreampDb= */ 0f,
+        measureLoudness,
+        waveformFramesPerPeak,
+        spectrumFftSize,
+        outputSampleRate,
+        outputEncoding);
+  }
+
+  /** Returns the number of output channels for input with {@code channelCount} channels. */
+  public int getOutputChannelCount(int channelCount) {
+    return channelMap != null ? channelMap.length : channelCount;
+  }
+
+  /** Returns the output sample rate for input at {@code sampleRate}. */
+  public int getOutputSampleRate(int sampleRate) {
+    return outputSampleRate != Format.NO_VALUE ? outputSampleRate : sampleRate;
+  }
+
+  /** Returns the output encoding for input in {@code encoding}. */
+  @C.PcmEncoding
+  public int getOutputEncoding(@C.PcmEncoding int encoding) {
+    return outputEncoding != C.ENCODING_INVALID ? outputEncoding : encoding;
+  }
+
+  /**
+   * Returns the format of the output for PCM input in the given format.
+   *
+   * @param encoding The input encoding.
+   * @param channelCount The number of input channels.
+   * @param sampleRate The input sample rate.
+   * @return The output format.
+   */
+  public Format getOutputFormat(@C.PcmEncoding int encoding, int channelCount, int sampleRate) {
+    return Util.getPcmFormat(
+        getOutputEncoding(encoding),
+        getOutputChannelCount(channelCount),
+        getOutputSampleRate(sampleRate));
+  }
+
+  /**
+   * Returns the maximum size of the output for {@code frameCount} input frames, in bytes. Output
+   * buffers that the native decoders process into must be at least this big. Matches {@code
+   * AudioChain::GetMaxOutputSize} in {@code extensions/jni_common/audio_chain.cc}.
+   *
+   * @param frameCount The number of input frames.
+   * @param encoding The input encoding.
+   * @param channelCount The number of input channels.
+   * @param sampleRate The input sample rate.
+   * @return The maximum output size in bytes.
+   */
+  public int getMaxOutputSize(
+      int frameCount, @C.PcmEncoding int encoding, int channelCount, int sampleRate) {
+    if (isReducingToWaveform()) {
+      // The frames complete at most one more peak than they hold, together with the frames of the
+      // incomplete peak.
+      return (frameCount / waveformFramesPerPeak + 1) * WAVEFORM_VALUES_PER_PEAK * 4;
+    }
+    long outputFrameCount = frameCount;
+    if (speed != 1f || pitch != 1f) {
+      // The time stretcher outputs a 10 ms hop for each analysis hop of input, with one more hop
+      // and one more input frame allowed for the rounding of its position.
+      int hopFrameCount = max(1, sampleRate / 100);
+      double analysisHop = hopFrameCount / ((double) pitch / speed);
+      outputFrameCount = ((long) ((frameCount + 1) / analysisHop) + 1) * hopFrameCount;
+    }
+    int outputSampleRate = getOutputSampleRate(sampleRate);
+    if (pitch != 1f) {
+      // The stretched audio is resampled back to its duration, with one more frame allowed for
+      // the rounding of the pitch.
+      double ratio = (double) outputSampleRate / ((double) sampleRate * pitch);
+      outputFrameCount = (long) Math.ceil(outputFrameCount * ratio) + 3;
+    } else if (outputSampleRate != sampleRate) {
+      // The resampler outputs at most one frame more than the sample rate ratio implies, plus one
+      // for the rounding of its fixed point step.
+      outputFrameCount = Util.ceilDivide(outputFrameCount * outputSampleRate, sampleRate) + 2;
+    }
+    if (isSkippingSilence()) {
+      // Up to the minimum silence duration of silence held back by previous calls.
+      outputFrameCount += minimumSilenceDurationUs * outputSampleRate / C.MICROS_PER_SECOND;
+    }
+    int frameSize =
+        Util.getPcmFrameSize(getOutputEncoding(encoding), getOutputChannelCount(channelCount));
+    return (int) (outputFrameCount * frameSize);
+  }
+
+  /** Parses a ReplayGain gain such as "-6.50 dB", returning NaN if it's malformed. */
+  private static float parseReplayGainDb(String value) {
+    value = value.trim();
+    if (Ascii.toUpperCase(value).endsWith("DB")) {
+      value = value.substring(0, value.length() - 2);
+    }
+    return parseFloat(value);
+  }
+
+  /**
+   * Parses an R128 gain, which is in Q7.8 fixed point dB relative to -23 LUFS, as a gain relative
+   * to the ReplayGain reference level, returning NaN if it's malformed.
+   */
+  private static float parseR128GainDb(String value) {
+    try {
+      return Integer.parseInt(value.trim()) / 256f + R128_TO_REPLAY_GAIN_DB;
+    } catch (NumberFormatException e) {
+      return Float.NaN;
+    }
+  }
+
+  private static float parseFloat(String value) {
+    try {
+      return Float.parseFloat(value.trim());
+    } catch (NumberFormatException e) {
+      return Float.NaN;
+    }
+  }
+}
@@ -56,6 +56,7 @@ import com.google.android.exoplayer2.util.Util;
 import java.lang.annotation.Documented;
 import java.lang.annotation.Retention;
 import java.lang.annotation.RetentionPolicy;
+import java.util.ArrayDeque;
 
 /**
  * Decodes and renders audio using a {@link Decoder}.
@@ -134,6 +135,12 @@ public abstract class DecoderAudioRenderer<
   private boolean audioTrackNeedsConfigure;
 
   private long currentPositionUs;
+  private float outputSpeed;
+  private long outputSpeedAnchorMediaTimeUs;
+  private long outputSpeedAnchorSinkTimeUs;
+  private final ArrayDeque<SkippedSilenceCheckpoint> skippedSilenceCheckpoints;
+  private long skippedSilenceUs;
+  private long playedSkippedSilenceUs;
   private boolean allowFirstBufferPositionDiscontinuity;
   private boolean allowPositionDiscontinuity;
   private boolean inputStreamEnded;
@@ -193,6 +200,9 @@ public abstract class DecoderAudioRenderer<
     flagsOnlyBuffer = DecoderInputBuffer.newNoDataInstance();
     decoderReinitializationState = REINITIALIZATION_STATE_NONE;
     audioTrackNeedsConfigure = true;
+    outputSpeed = 1f;
+    outputSpeedAnchorMediaTimeUs = C.TIME_UNSET;
+    skippedSilenceCheckpoints = new ArrayDeque<>();
   }
 
   /**
@@ -345,6 +355,20 @@ public abstract class DecoderAudioRenderer<
    */
   protected abstract Format getOutputFormat(T decoder);
 
+  /**
+   * Returns the factor by which the decoder speeds up its output, for decoders that change the
+   * duration of the audio they decode. Output timestamps are mapped to the audio sink's timeline
+   * by dividing the media time that has elapsed since the last position reset or speed change by
+   * this factor, and the sink's position is mapped back.
+   *
+   * <p>The default implementation returns 1.
+   *
+   * @param decoder The decoder.
+   */
+  protected float getOutputSpeed(T decoder) {
+    return 1f;
+  }
+
   /**
    * Evaluates whether the existing decoder can be reused for a new {@link Format}.
    *
@@ -405,8 +429,15 @@ public abstract class DecoderAudioRenderer<
       audioTrackNeedsConfigure = false;
     }
 
-    if (audioSink.handleBuffer(
-        outputBuffer.data, outputBuffer.timeUs, /* encodedAccessUnitCount= */ 1)) {
+    // Silence skipped by the decoder shifts the output that follows it earlier on the sink's
+    // timeline.
+    long sinkTimeUs =
+        getSinkTimeUs(outputBuffer.timeUs, getOutputSpeed(decoder)) - skippedSilenceUs;
+    if (audioSink.handleBuffer(outputBuffer.data, sinkTimeUs, /* encodedAccessUnitCount= */ 1)) {
+      if (outputBuffer.skippedSilenceDurationUs > 0) {
+        skippedSilenceUs += outputBuffer.skippedSilenceDurationUs;
+        skippedSilenceCheckpoints.add(new SkippedSilenceCheckpoint(sinkTimeUs, skippedSilenceUs));
+      }
       decoderCounters.renderedOutputBufferCount++;
       outputBuffer.release();
       outputBuffer = null;
@@ -534,6 +565,10 @@ public abstract class DecoderAudioRenderer<
     }
 
     currentPositionUs = positionUs;
+    outputSpeedAnchorMediaTimeUs = C.TIME_UNSET;
+    skippedSilenceCheckpoints.clear();
+    skippedSilenceUs = 0;
+    playedSkippedSilenceUs = 0;
     allowFirstBufferPositionDiscontinuity = true;
     allowPositionDiscontinuity = true;
     inputStreamEnded = false;
@@ -710,9 +745,47 @@ public abstract class DecoderAudioRenderer<
     }
   }
 
+  /**
+   * Returns the audio sink timestamp of output at {@code mediaTimeUs}, for output sped up by {@code
+   * speed}. Anchors the mapping at {@code mediaTimeUs} if the speed has changed, or if this is the
+   * first output since the position was reset.
+   */
+  private long getSinkTimeUs(long mediaTimeUs, float speed) {
+    if (outputSpeedAnchorMediaTimeUs == C.TIME_UNSET) {
+      outputSpeedAnchorMediaTimeUs = mediaTimeUs;
+      outputSpeedAnchorSinkTimeUs = mediaTimeUs;
+      outputSpeed = speed;
+    } else if (speed != outputSpeed) {
+      outputSpeedAnchorSinkTimeUs = getSinkTimeUs(mediaTimeUs, outputSpeed);
+      outputSpeedAnchorMediaTimeUs = mediaTimeUs;
+      outputSpeed = speed;
+    }
+    return outputSpeedAnchorSinkTimeUs
+        + (long) ((mediaTimeUs - outputSpeedAnchorMediaTimeUs) / (double) outputSpeed);
+  }
+
+  /**
+   * Returns the media time of the audio sink position {@code sinkTimeUs}, adding back the silence
+   * that was skipped before it. The silence skipped in a buffer is counted from the start of the
+   * buffer.
+   */
+  private long getMediaTimeUs(long sinkTimeUs) {
+    while (!skippedSilenceCheckpoints.isEmpty()
+        && sinkTimeUs >= skippedSilenceCheckpoints.peek().sinkTimeUs) {
+      playedSkippedSilenceUs = skippedSilenceCheckpoints.remove().skippedSilenceUs;
+    }
+    sinkTimeUs += playedSkippedSilenceUs;
+    if (outputSpeedAnchorMediaTimeUs == C.TIME_UNSET) {
+      return sinkTimeUs;
+    }
+    return outputSpeedAnchorMediaTimeUs
+        + (long) ((sinkTimeUs - outputSpeedAnchorSinkTimeUs) * (double) outputSpeed);
+  }
+
   private void updateCurrentPosition() {
     long newCurrentPositionUs = audioSink.getCurrentPositionUs(isEnded());
     if (newCurrentPositionUs != AudioSink.CURRENT_POSITION_NOT_SET) {
+      newCurrentPositionUs = getMediaTimeUs(newCurrentPositionUs);
       currentPositionUs =
           allowPositionDiscontinuity
               ? newCurrentPositionUs
@@ -721,6 +794,20 @@ public abstract class DecoderAudioRenderer<
     }
   }
 
+  /** The total duration of silence skipped by the decoder up to a point on the sink's timeline. */
+  private static final class SkippedSilenceCheckpoint {
+
+    /** The audio sink timestamp of the buffer in which the silence was skipped. */
+    public final long sinkTimeUs;
+    /** The total duration of silence skipped up to the end of the buffer, in microseconds. */
+    public final long skippedSilenceUs;
+
+    public SkippedSilenceCheckpoint(long sinkTimeUs, long skippedSilenceUs) {
+      this.sinkTimeUs = sinkTimeUs;
+      this.skippedSilenceUs = skippedSilenceUs;
+    }
+  }
+
   private final class AudioSinkListener implements AudioSink.Listener {
 
     @Override
@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.google.android.exoplayer2.audio;
+
+import androidx.annotation.IntDef;
+import androidx.annotation.Nullable;
+import com.google.android.exoplayer2.C;
+import com.google.android.exoplayer2.decoder.SimpleDecoder;
+import com.google.android.exoplayer2.decoder.SimpleOutputBuffer;
+import com.google.android.exoplayer2.util.Util;
+import java.lang.annotation.Documented;
+import java.lang.annotation.Retention;
+import java.lang.annotation.RetentionPolicy;
+import java.nio.ByteBuffer;
+
+/**
+ * Crossfades consecutive streams, such as the items of a playlist, that are decoded by the native
+ * audio decoders in the FFmpeg, Opus and FLAC extensions, which decode one stream each.
+ *
+ * <p>A native mixer holds back the last part of a decoder's output, so that it can be crossfaded
+ * into the start of the next decoder's stream if {@link #crossfadeIntoNextStream()} is called,
+ * and is otherwise output at the end of the stream. The decoder's output is delayed by the
+ * duration of the crossfade, and its timestamps are adjusted for the delay. When a stream is
+ * crossfaded into the next one, its decoder's mixer is passed on to the next decoder's crossfade,
+ * which mixes the held back output into its own output buffers in place.
+ *
+ * <p>A decoder creates its crossfade with {@link #create(NativeMixer, long, int, float,
+ * DecoderCrossfade)} before its first input buffer is queued, and on its decode thread passes each
+ * output buffer through {@link #apply(SimpleOutputBuffer, int, int, int)}, calls {@link #flush()}
+ * when it's reset, and drains the held back output through {@link #hasPendingOutput()} and {@link
+ * #drain(SimpleOutputBuffer)}, which implement {@link SimpleDecoder}'s methods of the same names.
+ */
+public final class DecoderCrossfade {
+
+  /**
+   * The native crossfade mixer functions of an extension. Mixers are independent of decoders, so
+   * they may be used after the decoder that created them is released.
+   */
+  public interface NativeMixer {
+
+    /**
+     * Sets the duration and curve of a native crossfade mixer, creating it if {@code mixer} is 0.
+     *
+     * @param mixer The mixer, or 0 to create one.
+     * @param durationUs The duration of the output that the mixer holds back, in microseconds.
+     * @param curve The shape of crossfades into streams that start after the call.
+     * @return The mixer, or 0 if the arguments are invalid.
+     */
+    long setCrossfade(long mixer, long durationUs, @Curve int curve);
+
+    /**
+     * Passes {@code size} bytes of output from {@code offset} in {@code data} through a mixer,
+     * which holds back their end and writes output that it held back earlier in their place.
+     *
+     * @return The size of the output written from {@code offset}, or -1 if the format isn't
+     *     supported.
+     */
+    int crossfade(
+        long mixer,
+        ByteBuffer data,
+        int offset,
+        int size,
+        int channelCount,
+        int sampleRate,
+        @C.PcmEncoding int encoding);
+
+    /** Returns the size of the output that a mixer holds back at the end of a stream. */
+    int getCrossfadeDrainSize(long mixer);
+
+    /**
+     * Writes up to {@code capacity} bytes of the output that a mixer holds back at the end of a
+     * stream to {@code output}, and returns their size.
+     */
+    int drainCrossfade(long mixer, ByteBuffer output, int capacity);
+
+    /**
+     * Ends a mixer's stream, keeping the output that it holds back to mix into the start of the
+     * next stream.
+     */
+    void endCrossfadeStream(long mixer);
+
+    /** Discards the output that a mixer holds back, after a seek. */
+    void flushCrossfade(long mixer);
+
+    /** Releases a mixer. */
+    void releaseCrossfade(long mixer);
+  }
+
+  /**
+   * The shape of a crossfade. One of {@link #CURVE_LINEAR} or {@link #CURVE_EQUAL_POWER}.
+   */
+  @Documented
+  @Retention(RetentionPolicy.SOURCE)
+  @IntDef({CURVE_LINEAR, CURVE_EQUAL_POWER})
+  public @interface Curve {}
+  /**
+   * Crossfade curve whose gains sum to one, which suits correlated audio, such as gapless tracks
+   * that continue each other.
+   */
+  public static final int CURVE_LINEAR = 0;
+  /**
+   * Crossfade curve whose gains' squares sum to one, which keeps the loudness of uncorrelated audio
+   * constant.
+   */
+  public static final int CURVE_EQUAL_POWER = 1;
+
+  private final NativeMixer nativeMixer;
+  private final float speed;
+
+  private long mixer;
+  private volatile boolean intoNextStream;
+  private boolean streamEnded;
+  private int sampleRate;
+  private int heldFrameCount;
+  private long heldTimeUs;
+
+  /**
+   * Creates the crossfade of a decoder's stream.
+   *
+   * @param nativeMixer The native mixer functions of the decoder's extension.
+   * @param durationUs The duration of the crossfade, in microseconds.
+   * @param curve The shape of the crossfade into the decoder's stream.
+   * @param speed The speed of the decoder's output, relative to its input.
+   * @param previous The crossfade of the released decoder of the previous stream, whose held back
+   *     output is crossfaded into the start of the decoder's stream if it ended by crossfading into
+   *     the next stream, or null.
+   * @return The crossfade, or null if the arguments aren't supported.
+   */
+  @Nullable
+  public static DecoderCrossfade create(
+      NativeMixer nativeMixer,
+      long durationUs,
+      @Curve int curve,
+      float speed,
+      @Nullable DecoderCrossfade previous) {
+    long previousMixer = previous != null ? previous.takeMixer() : 0;
+    long mixer = nativeMixer.setCrossfade(previousMixer, durationUs, curve);
+    if (mixer == 0) {
+      if (previousMixer != 0) {
+        nativeMixer.releaseCrossfade(previousMixer);
+      }
+      return null;
+    }
+    return new DecoderCrossfade(nativeMixer, mixer, speed);
+  }
+
+  private DecoderCrossfade(NativeMixer nativeMixer, long mixer, float speed) {
+    this.nativeMixer = nativeMixer;
+    this.mixer = mixer;
+    this.speed = speed;
+  }
+
+  /**
+   * Keeps the output that's held back at the end of the stream to crossfade it into the start of
+   * the next decoder's stream, instead of outputting it. May be called from any thread, but must
+   * be called before the end of stream input buffer is queued.
+   */
+  public void crossfadeIntoNextStream() {
+    intoNextStream = true;
+  }
+
+  /**
+   * Passes the decoded output in {@code outputBuffer} through the mixer, which holds back its end
+   * and replaces it in place with output that it held back earlier, whose timestamp is earlier by
+   * the delay. The buffer's data is limited to the output that's written.
+   *
+   * @param outputBuffer The output buffer, whose data is the decoded output from its position.
+   * @param channelCount The output channel count.
+   * @param sampleRate The output sample rate, in hertz.
+   * @param encoding The output encoding.
+   * @return The size of the output that's written, which is 0 if the mixer held back all of it, or
+   *     -1 if the format isn't supported.
+   */
+  public int apply(
+      SimpleOutputBuffer outputBuffer,
+      int channelCount,
+      int sampleRate,
+      @C.PcmEncoding int encoding) {
+    ByteBuffer outputData = Util.castNonNull(outputBuffer.data);
+    int size = outputData.remaining();
+    int mixedSize =
+        nativeMixer.crossfade(
+            mixer, outputData, outputData.position(), size, channelCount, sampleRate, encoding);
+    if (mixedSize < 0) {
+      return mixedSize;
+    }
+    this.sampleRate = sampleRate;
+    int frameSize = Util.getPcmFrameSize(encoding, channelCount);
+    outputBuffer.timeUs -= getMediaDurationUs(heldFrameCount);
+    heldFrameCount += (size - mixedSize) / frameSize;
+    heldTimeUs = outputBuffer.timeUs + getMediaDurationUs(mixedSize / frameSize);
+    outputData.limit(outputData.position() + mixedSize);
+    return mixedSize;
+  }
+
+  /**
+   * Returns whether there's held back output to write at the end of the stream. If the stream is
+   * crossfaded into the next stream, ends the mixer's stream instead, keeping the held back output
+   * for the next decoder.
+   */
+  public boolean hasPendingOutput() {
+    if (mixer == 0 || streamEnded) {
+      return false;
+    }
+    if (intoNextStream) {
+      nativeMixer.endCrossfadeStream(mixer);
+      streamEnded = true;
+      return false;
+    }
+    return nativeMixer.getCrossfadeDrainSize(mixer) > 0;
+  }
+
+  /**
+   * Writes the output that's held back at the end of the stream to {@code outputBuffer}. Must only
+   * be called after {@link #hasPendingOutput()} returns true.
+   */
+  public void drain(SimpleOutputBuffer outputBuffer) {
+    int size = nativeMixer.getCrossfadeDrainSize(mixer);
+    ByteBuffer outputData = outputBuffer.init(heldTimeUs, size);
+    outputData.limit(nativeMixer.drainCrossfade(mixer, outputData, size));
+    heldFrameCount = 0;
+  }
+
+  /** Discards the held back output, when the decoder is reset to decode from a new position. */
+  public void flush() {
+    nativeMixer.flushCrossfade(mixer);
+    streamEnded = false;
+    heldFrameCount = 0;
+  }
+
+  /**
+   * Releases the mixer when the decoder is released, unless the stream was crossfaded into the
+   * next stream, in which case the mixer is kept for the next decoder's crossfade.
+   */
+  public void release() {
+    if (!streamEnded) {
+      releaseHeldOutput();
+    }
+  }
+
+  /**
+   * Releases the output that's held back for a crossfade into the next stream, if it wasn't passed
+   * on to the next decoder's crossfade. Must only be called after the decoder is released.
+   */
+  public void releaseHeldOutput() {
+    if (mixer != 0) {
+      nativeMixer.releaseCrossfade(mixer);
+      mixer = 0;
+    }
+  }
+
+  /**
+   * Returns the mixer if it holds the end of the stream to crossfade into the next stream, or
+   * releases it and returns 0 otherwise.
+   */
+  private long takeMixer() {
+    long mixer = this.mixer;
+    this.mixer = 0;
+    if (mixer != 0 && !streamEnded) {
+      nativeMixer.releaseCrossfade(mixer);
+      return 0;
+    }
+    return mixer;
+  }
+
+  /** Returns the duration of the input that {@code frameCount} output frames were decoded from. */
+  private long getMediaDurationUs(int frameCount) {
+    return (long) ((double) frameCount * C.MICROS_PER_SECOND * speed / sampleRate);
+  }
+}
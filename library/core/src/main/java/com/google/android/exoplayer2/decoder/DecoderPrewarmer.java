@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.google.android.exoplayer2.decoder;
+
+import androidx.annotation.GuardedBy;
+import androidx.annotation.Nullable;
+import com.google.android.exoplayer2.Format;
+import com.google.android.exoplayer2.util.ConditionVariable;
+import com.google.android.exoplayer2.util.Log;
+import com.google.android.exoplayer2.util.Util;
+
+/**
+ * Creates a decoder for an anticipated format on a background thread, so that the cost of creating
+ * it, such as opening the codec, starting its threads and allocating its buffers, is paid before
+ * playback starts rather than before the first frame is output.
+ *
+ * <p>A renderer calls {@link #takeDecoder(Format)} when it needs a decoder, and uses the
+ * prewarmed decoder if it was created for a compatible format. Decoders are created without DRM,
+ * so they're not used for formats with {@link Format#drmInitData}. All methods are thread-safe.
+ *
+ * @param <T> The type of decoder.
+ */
+public final class DecoderPrewarmer<T extends Decoder<?, ?, ?>> {
+
+  /** Creates decoders for the prewarmer. */
+  public interface DecoderFactory<T> {
+
+    /**
+     * Creates and prepares a decoder for {@code format}. Called on the prewarming thread.
+     *
+     * @param format The anticipated format.
+     * @return The decoder.
+     * @throws DecoderException If the decoder couldn't be created.
+     */
+    T createDecoder(Format format) throws DecoderException;
+  }
+
+  private static final String TAG = "DecoderPrewarmer";
+
+  @GuardedBy("this")
+  @Nullable
+  private PrewarmTask<T> task;
+
+  /**
+   * Starts creating a decoder for {@code format} on a background thread. A decoder that was
+   * previously prewarmed and hasn't been taken is released.
+   *
+   * @param format The anticipated format.
+   * @param decoderFactory Creates the decoder.
+   */
+  public synchronized void prewarm(Format format, DecoderFactory<T> decoderFactory) {
+    if (task != null) {
+      task.discard();
+    }
+    task = new PrewarmTask<>(format, decoderFactory);
+    new Thread(task, "ExoPlayer:DecoderPrewarmer").start();
+  }
+
+  /**
+   * Returns the prewarmed decoder if it was created for a format that's compatible with {@code
+   * format}, waiting for it to be created if necessary. Otherwise, releases the prewarmed decoder,
+   * if any, and returns null. A decoder is only returned once.
+   *
+   * @param format The format to decode.
+   * @return The prewarmed decoder, or null if there isn't a compatible one.
+   */
+  @Nullable
+  public T takeDecoder(Format format) {
+    @Nullable PrewarmTask<T> task;
+    synchronized (this) {
+      task = this.task;
+      this.task = null;
+    }
+    if (task == null) {
+      return null;
+    }
+    if (!isCompatible(task.format, format)) {
+      task.discard();
+      return null;
+    }
+    return task.take();
+  }
+
+  /** Releases the prewarmed decoder, if it hasn't been taken. */
+  public synchronized void release() {
+    if (task != null) {
+      task.discard();
+      task = null;
+    }
+  }
+
+  /**
+   * Returns whether a decoder created for {@code prewarmedFormat} can decode {@code format}. The
+   * formats may differ in their dimensions, which only affect the buffers that are allocated in
+   * advance.
+   */
+  private static boolean isCompatible(Format prewarmedFormat, Format format) {
+    return prewarmedFormat.drmInitData == null
+        && format.drmInitData == null
+        && Util.areEqual(prewarmedFormat.sampleMimeType, format.sampleMimeType)
+        && prewarmedFormat.maxInputSize == format.maxInputSize
+        && prewarmedFormat.channelCount == format.channelCount
+        && prewarmedFormat.sampleRate == format.sampleRate
+        && prewarmedFormat.pcmEncoding == format.pcmEncoding
+        && prewarmedFormat.initializationDataEquals(format);
+  }
+
+  private static final class PrewarmTask<T extends Decoder<?, ?, ?>> implements Runnable {
+
+    public final Format format;
+
+    private final DecoderFactory<T> decoderFactory;
+    private final ConditionVariable created;
+
+    @GuardedBy("this")
+    @Nullable
+    private T decoder;
+
+    @GuardedBy("this")
+    private boolean discarded;
+
+    public PrewarmTask(Format format, DecoderFactory<T> decoderFactory) {
+      this.format = format;
+      this.decoderFactory = decoderFactory;
+      created = new ConditionVariable();
+    }
+
+    @Override
+    public void run() {
+      @Nullable T decoder = null;
+      try {
+        decoder = decoderFactory.createDecoder(format);
+      } catch (DecoderException e) {
+        Log.w(TAG, "Failed to prewarm decoder", e);
+      }
+      synchronized (this) {
+        if (discarded) {
+          if (decoder != null) {
+            decoder.release();
+          }
+        } else {
+          this.decoder = decoder;
+        }
+      }
+      created.open();
+    }
+
+    /** Waits for the decoder to be created, and returns it, or null if creating it failed. */
+    @Nullable
+    public T take() {
+      created.blockUninterruptible();
+      synchronized (this) {
+        @Nullable T decoder = this.decoder;
+        this.decoder = null;
+        discarded = true;
+        return decoder;
+      }
+    }
+
+    /** Releases the decoder, once it's been created if it's still being created. */
+    public synchronized void discard() {
+      discarded = true;
+      if (decoder != null) {
+        decoder.release();
+        decoder = null;
+      }
+    }
+  }
+}
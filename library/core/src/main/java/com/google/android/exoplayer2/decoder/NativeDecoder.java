@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.google.android.exoplayer2.decoder;
+
+/**
+ * A {@link Decoder} that decodes in a native library, which collects statistics about its
+ * decoding and can record its calls for replay on a workstation.
+ */
+public interface NativeDecoder {
+
+  /**
+   * Returns a snapshot of the statistics collected by the native decoder. May be called from any
+   * thread, but must not be called after the decoder is {@link Decoder#release() released}.
+   */
+  NativeDecoderStats getNativeStats();
+
+  /**
+   * Starts recording the calls made to the native decoder, with their input and timing, to a new
+   * file, replacing any recording in progress. Recordings can be inspected and replayed on a
+   * workstation with the {@code session_replay} tool in {@code extensions/jni_common/host}, to
+   * reproduce the decoder's performance on the recorded input. May be called from any thread, but
+   * must not be called after the decoder is released.
+   *
+   * @param path The path of the file to record to.
+   * @return Whether recording was started.
+   */
+  boolean startSessionRecording(String path);
+
+  /**
+   * Stops a recording started by {@link #startSessionRecording(String)}. May be called from any
+   * thread, but must not be called after the decoder is released, which also stops recording.
+   */
+  void stopSessionRecording();
+}
@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.google.android.exoplayer2.decoder;
+
+import static com.google.android.exoplayer2.util.Assertions.checkArgument;
+
+import com.google.android.exoplayer2.C;
+
+/**
+ * A snapshot of the statistics collected by a native decoder, for attributing dropped frames to
+ * decoding, conversion or rendering, as returned by {@link NativeDecoder#getNativeStats()}.
+ *
+ * <p>Snapshots are taken in a single native call, and the statistics are updated without locking,
+ * so taking a snapshot doesn't block decoding. Each value in a snapshot is accurate, but values
+ * may be updated while the snapshot is being taken, so they are not guaranteed to be consistent
+ * with each other.
+ */
+public final class NativeDecoderStats {
+
+  /**
+   * A histogram of latencies in microseconds.
+   *
+   * <p>Buckets cover power of two ranges, each split into {@link #SUB_BUCKET_COUNT} linear
+   * sub-buckets, in the style of HdrHistogram. Values below {@link #SUB_BUCKET_COUNT} have their
+   * own bucket, and larger values are recorded with a relative error of at most 1 / {@link
+   * #SUB_BUCKET_COUNT}. Values of 2^{@link #MAX_VALUE_BITS} microseconds or more are recorded in
+   * the last bucket.
+   */
+  public static final class LatencyHistogram {
+
+    // LINT.IfChange
+    private static final int SUB_BUCKET_BITS = 3;
+    /** The number of linear sub-buckets each power of two range is split into. */
+    public static final int SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+    /** The number of bits of the smallest value recorded in the last bucket. */
+    public static final int MAX_VALUE_BITS = 27;
+    /** The number of buckets. */
+    public static final int BUCKET_COUNT =
+        (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+    // LINT.ThenChange(../../../../../../../../../../extensions/jni_common/decoder_stats.h)
+
+    private final long[] counts;
+    private final long totalCount;
+
+    private LatencyHistogram(long[] snapshot, int offset) {
+      counts = new long[BUCKET_COUNT];
+      System.arraycopy(snapshot, offset, counts, 0, BUCKET_COUNT);
+      long totalCount = 0;
+      for (long count : counts) {
+        totalCount += count;
+      }
+      this.totalCount = totalCount;
+    }
+
+    /** Returns the number of recorded values. */
+    public long getTotalCount() {
+      return totalCount;
+    }
+
+    /**
+     * Returns the number of values recorded in a bucket.
+     *
+     * @param bucketIndex The index of the bucket, between 0 and {@link #BUCKET_COUNT} - 1.
+     * @return The number of values recorded in the bucket.
+     */
+    public long getCount(int bucketIndex) {
+      return counts[bucketIndex];
+    }
+
+    /**
+     * Returns the largest value that is equivalent to the value at a percentile, in microseconds,
+     * or {@link C#TIME_UNSET} if no values have been recorded.
+     *
+     * @param percentile The percentile, between 0 and 100.
+     * @return The value at the percentile, in microseconds, or {@link C#TIME_UNSET}.
+     */
+    public long getPercentileUs(double percentile) {
+      checkArgument(percentile >= 0 && percentile <= 100);
+      if (totalCount == 0) {
+        return C.TIME_UNSET;
+      }
+      long targetCount = Math.max(1, (long) Math.ceil(percentile * totalCount / 100));
+      long cumulativeCount = 0;
+      int bucketIndex = 0;
+      for (; bucketIndex < BUCKET_COUNT - 1; bucketIndex++) {
+        cumulativeCount += counts[bucketIndex];
+        if (cumulativeCount >= targetCount) {
+          return getBucketLowerBoundUs(bucketIndex + 1) - 1;
+        }
+      }
+      return getBucketLowerBoundUs(bucketIndex);
+    }
+
+    /**
+     * Returns the approximate mean of the recorded values, in microseconds, or {@link
+     * C#TIME_UNSET} if no values have been recorded. Each value is assumed to be in the middle of
+     * its bucket.
+     */
+    public long getMeanUs() {
+      if (totalCount == 0) {
+        return C.TIME_UNSET;
+      }
+      double sum = 0;
+      for (int i = 0; i < BUCKET_COUNT - 1; i++) {
+        long lowerBoundUs = getBucketLowerBoundUs(i);
+        long upperBoundUs = getBucketLowerBoundUs(i + 1) - 1;
+        sum += counts[i] * (lowerBoundUs + upperBoundUs) / 2.0;
+      }
+      sum += counts[BUCKET_COUNT - 1] * (double) getBucketLowerBoundUs(BUCKET_COUNT - 1);
+      return Math.round(sum / totalCount);
+    }
+
+    /** Returns the index of the bucket that a value in microseconds is recorded in. */
+    public static int getBucketIndex(long valueUs) {
+      if (valueUs < SUB_BUCKET_COUNT) {
+        return valueUs < 0 ? 0 : (int) valueUs;
+      }
+      if (valueUs >= 1L << MAX_VALUE_BITS) {
+        return BUCKET_COUNT - 1;
+      }
+      int shift = 63 - Long.numberOfLeadingZeros(valueUs) - SUB_BUCKET_BITS;
+      return (shift + 1) * SUB_BUCKET_COUNT + (int) ((valueUs >> shift) - SUB_BUCKET_COUNT);
+    }
+
+    /** Returns the smallest value in microseconds that is recorded in a bucket. */
+    public static long getBucketLowerBoundUs(int bucketIndex) {
+      if (bucketIndex < SUB_BUCKET_COUNT) {
+        return bucketIndex;
+      }
+      int shift = bucketIndex / SUB_BUCKET_COUNT - 1;
+      return (long) (SUB_BUCKET_COUNT + bucketIndex % SUB_BUCKET_COUNT) << shift;
+    }
+  }
+
+  // LINT.IfChange
+  private static final int COUNTER_COUNT = 14;
+  private static final int HISTOGRAM_COUNT = 3;
+  /** The length of a snapshot passed to {@link #NativeDecoderStats(long[])}. */
+  public static final int SNAPSHOT_LENGTH =
+      COUNTER_COUNT + HISTOGRAM_COUNT * LatencyHistogram.BUCKET_COUNT;
+  // LINT.ThenChange(../../../../../../../../../../extensions/jni_common/decoder_stats.h)
+
+  /** The number of input buffers queued to the decoder. */
+  public final long inputBufferCount;
+  /** The number of bytes of encoded input queued to the decoder. */
+  public final long inputByteCount;
+  /** The number of decoded output buffers. */
+  public final long outputBufferCount;
+  /** The number of bytes of decoded output, after any conversion. */
+  public final long outputByteCount;
+  /** The number of decoded output buffers that were not output because they were decode-only. */
+  public final long skippedOutputBufferCount;
+  /** The number of failed decode calls. */
+  public final long decodeErrorCount;
+  /** The number of frame buffers referenced by the decoder or the application. */
+  public final long frameBuffersInUse;
+  /** The peak value of {@link #frameBuffersInUse}. */
+  public final long peakFrameBuffersInUse;
+  /** The number of native allocations made for frame buffers. */
+  public final long frameBufferAllocationCount;
+  /**
+   * The number of calls to the decoder's per-buffer native methods, such as decode, get frame,
+   * render and reset calls.
+   */
+  public final long nativeCallCount;
+  /**
+   * Time spent in the decoder's per-buffer native methods, in nanoseconds. This includes {@link
+   * #upcallTimeNs upcalls}, but not the transitions into and out of native code, so the cost of
+   * the transitions is the time measured around the calls in Java minus this value.
+   */
+  public final long nativeCallTimeNs;
+  /** The number of calls from the decoder's native code to Java methods. */
+  public final long upcallCount;
+  /** Time spent in calls from the decoder's native code to Java methods, in nanoseconds. */
+  public final long upcallTimeNs;
+  /** The number of bytes allocated for frame buffers, whether or not they're in use. */
+  public final long frameBufferBytes;
+  /** Time spent in the codec library decoding input buffers. */
+  public final LatencyHistogram decodeTimeHistogram;
+  /** Time spent converting or copying decoded output into output buffers. */
+  public final LatencyHistogram convertTimeHistogram;
+  /** Time spent rendering decoded output to a surface. */
+  public final LatencyHistogram renderTimeHistogram;
+
+  /**
+   * Creates an instance from a snapshot taken by a native decoder.
+   *
+   * @param snapshot The snapshot, with a length of at least {@link #SNAPSHOT_LENGTH}.
+   */
+  public NativeDecoderStats(long[] snapshot) {
+    checkArgument(snapshot.length >= SNAPSHOT_LENGTH);
+    inputBufferCount = snapshot[0];
+    inputByteCount = snapshot[1];
+    outputBufferCount = snapshot[2];
+    outputByteCount = snapshot[3];
+    skippedOutputBufferCount = snapshot[4];
+    decodeErrorCount = snapshot[5];
+    frameBuffersInUse = snapshot[6];
+    peakFrameBuffersInUse = snapshot[7];
+    frameBufferAllocationCount = snapshot[8];
+    nativeCallCount = snapshot[9];
+    nativeCallTimeNs = snapshot[10];
+    upcallCount = snapshot[11];
+    upcallTimeNs = snapshot[12];
+    frameBufferBytes = snapshot[13];
+    decodeTimeHistogram = new LatencyHistogram(snapshot, COUNTER_COUNT);
+    convertTimeHistogram =
+        new LatencyHistogram(snapshot, COUNTER_COUNT + LatencyHistogram.BUCKET_COUNT);
+    renderTimeHistogram =
+        new LatencyHistogram(snapshot, COUNTER_COUNT + 2 * LatencyHistogram.BUCKET_COUNT);
+  }
+}
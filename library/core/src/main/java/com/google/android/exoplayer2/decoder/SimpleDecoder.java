@@ -46,6 +46,8 @@ public abstract class SimpleDecoder<
   private boolean flushed;
   private boolean released;
   private int skippedOutputBufferCount;
+  // Only accessed on the decode thread.
+  private boolean noOutput;
 
   /**
    * @param inputBuffers An array of nulls that will be used to store references to input buffers.
@@ -223,7 +225,12 @@ public abstract class SimpleDecoder<
       flushed = false;
     }
 
-    if (inputBuffer.isEndOfStream()) {
+    // Output that the subclass hasn't written yet is output before the end of stream. The end of
+    // stream input buffer is decoded again once it's been written.
+    boolean decodePendingOutput =
+        inputBuffer.isEndOfStream() && !resetDecoder && hasPendingOutput();
+    noOutput = false;
+    if (inputBuffer.isEndOfStream() && !decodePendingOutput) {
       outputBuffer.addFlag(C.BUFFER_FLAG_END_OF_STREAM);
     } else {
       if (inputBuffer.isDecodeOnly()) {
@@ -231,7 +238,10 @@ public abstract class SimpleDecoder<
       }
       @Nullable E exception;
       try {
-        exception = decode(inputBuffer, outputBuffer, resetDecoder);
+        exception =
+            decodePendingOutput
+                ? decodePendingOutput(outputBuffer)
+                : decode(inputBuffer, outputBuffer, resetDecoder);
       } catch (RuntimeException e) {
         // This can occur if a sample is malformed in a way that the decoder is not robust against.
         // We don't want the process to die in this case, but we do want to propagate the error.
@@ -251,7 +261,7 @@ public abstract class SimpleDecoder<
     }
 
     synchronized (lock) {
-      if (flushed) {
+      if (flushed || noOutput) {
         outputBuffer.release();
       } else if (outputBuffer.isDecodeOnly()) {
         skippedOutputBufferCount++;
@@ -261,8 +271,12 @@ public abstract class SimpleDecoder<
         skippedOutputBufferCount = 0;
         queuedOutputBuffers.addLast(outputBuffer);
       }
-      // Make the input buffer available again.
-      releaseInputBufferInternal(inputBuffer);
+      if (decodePendingOutput && !flushed) {
+        queuedInputBuffers.addFirst(inputBuffer);
+      } else {
+        // Make the input buffer available again.
+        releaseInputBufferInternal(inputBuffer);
+      }
     }
 
     return true;
@@ -314,4 +328,45 @@ public abstract class SimpleDecoder<
    */
   @Nullable
   protected abstract E decode(I inputBuffer, O outputBuffer, boolean reset);
+
+  /**
+   * Indicates that the current call to {@link #decode(DecoderInputBuffer, OutputBuffer, boolean)}
+   * or {@link #decodePendingOutput(OutputBuffer)} consumed its input without writing any output,
+   * for example because the output is decoded ahead on another thread and isn't ready yet. The
+   * output buffer is made available again without being output, and without being counted as a
+   * skipped output buffer as it would be if {@link C#BUFFER_FLAG_DECODE_ONLY} were set.
+   *
+   * <p>Must only be called on the decode thread, from one of those methods.
+   */
+  protected final void setNoOutput() {
+    noOutput = true;
+  }
+
+  /**
+   * Returns whether the decoder has output that it hasn't written to an output buffer yet, for
+   * example because it holds back the end of its output to mix it into the next stream. Called on
+   * the decode thread when the end of stream input buffer is reached, which is only output once
+   * this method returns false. If {@link #decodePendingOutput(OutputBuffer)} returns an error,
+   * the error is propagated as for {@link #decode(DecoderInputBuffer, OutputBuffer, boolean)}, and
+   * neither method is called again. The default implementation returns false.
+   */
+  protected boolean hasPendingOutput() {
+    return false;
+  }
+
+  /**
+   * Writes the oldest output that the decoder hasn't written yet to {@code outputBuffer}. Called
+   * on the decode thread after {@link #hasPendingOutput()} returns true. Each call must consume
+   * some of the pending output, even if it writes none and calls {@link #setNoOutput()}, so that
+   * {@link #hasPendingOutput()} eventually returns false.
+   *
+   * @param outputBuffer The output buffer to store the output. The flag {@link
+   *     C#BUFFER_FLAG_DECODE_ONLY} may be set as for {@link #decode(DecoderInputBuffer,
+   *     OutputBuffer, boolean)}.
+   * @return A decoder exception if an error occurred, or null if the output was written.
+   */
+  @Nullable
+  protected E decodePendingOutput(O outputBuffer) {
+    throw new IllegalStateException();
+  }
 }
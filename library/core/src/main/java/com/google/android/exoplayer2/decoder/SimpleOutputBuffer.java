@@ -26,6 +26,12 @@ public class SimpleOutputBuffer extends OutputBuffer {
 
   @Nullable public ByteBuffer data;
 
+  /**
+   * The duration of silence that the decoder skipped while producing this buffer, in microseconds
+   * at the output's speed. The skipped silence preceded the end of the buffer's data.
+   */
+  public long skippedSilenceDurationUs;
+
   public SimpleOutputBuffer(Owner<SimpleOutputBuffer> owner) {
     this.owner = owner;
   }
@@ -39,6 +45,7 @@ public class SimpleOutputBuffer extends OutputBuffer {
    */
   public ByteBuffer init(long timeUs, int size) {
     this.timeUs = timeUs;
+    skippedSilenceDurationUs = 0;
     if (data == null || data.capacity() < size) {
       data = ByteBuffer.allocateDirect(size).order(ByteOrder.nativeOrder());
     }
@@ -50,6 +57,7 @@ public class SimpleOutputBuffer extends OutputBuffer {
   @Override
   public void clear() {
     super.clear();
+    skippedSilenceDurationUs = 0;
     if (data != null) {
       data.clear();
     }
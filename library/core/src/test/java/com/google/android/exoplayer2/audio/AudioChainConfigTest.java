@@ -0,0 +1,306 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.google.android.exoplayer2.audio;
+
+import static com.google.common.truth.Truth.assertThat;
+import static org.junit.Assert.assertThrows;
+
+import androidx.test.ext.junit.runners.AndroidJUnit4;
+import com.google.android.exoplayer2.C;
+import com.google.android.exoplayer2.Format;
+import com.google.android.exoplayer2.metadata.Metadata;
+import com.google.android.exoplayer2.metadata.flac.VorbisComment;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+
+/** Unit tests for {@link AudioChainConfig}. */
+@RunWith(AndroidJUnit4.class)
+public final class AudioChainConfigTest {
+
+  @Test
+  public void getOutputFormat_withDefaultConfig_returnsInputFormat() {
+    AudioChainConfig config = new AudioChainConfig.Builder().build();
+
+    Format outputFormat =
+        config.getOutputFormat(
+            C.ENCODING_PCM_16BIT, /* channelCount= */ 6, /* sampleRate= */ 44100);
+
+    assertThat(outputFormat.pcmEncoding).isEqualTo(C.ENCODING_PCM_16BIT);
+    assertThat(outputFormat.channelCount).isEqualTo(6);
+    assertThat(outputFormat.sampleRate).isEqualTo(44100);
+  }
+
+  @Test
+  public void getOutputFormat_withChannelMapRateAndEncoding_returnsConvertedFormat() {
+    AudioChainConfig config =
+        new AudioChainConfig.Builder()
+            .setChannelMap(new int[] {1, 0})
+            .setOutputSampleRate(48000)
+            .setOutputEncoding(C.ENCODING_PCM_FLOAT)
+            .build();
+
+    Format outputFormat =
+        config.getOutputFormat(
+            C.ENCODING_PCM_16BIT, /* channelCount= */ 6, /* sampleRate= */ 44100);
+
+    assertThat(outputFormat.pcmEncoding).isEqualTo(C.ENCODING_PCM_FLOAT);
+    assertThat(outputFormat.channelCount).isEqualTo(2);
+    assertThat(outputFormat.sampleRate).isEqualTo(48000);
+  }
+
+  @Test
+  public void isApplicableTo_withChannelMissingFromInput_returnsFalse() {
+    AudioChainConfig config =
+        new AudioChainConfig.Builder().setChannelMap(new int[] {0, 2}).build();
+
+    assertThat(config.isApplicableTo(/* channelCount= */ 3)).isTrue();
+    assertThat(config.isApplicableTo(/* channelCount= */ 2)).isFalse();
+  }
+
+  @Test
+  public void getChannelMap_returnsCopy() {
+    int[] channelMap = new int[] {0, 1};
+    AudioChainConfig config = new AudioChainConfig.Builder().setChannelMap(channelMap).build();
+
+    channelMap[0] = 1;
+    config.getChannelMap()[1] = 0;
+
+    assertThat(config.getChannelMap()).isEqualTo(new int[] {0, 1});
+  }
+
+  @Test
+  public void getMaxOutputSize_withoutResampling_returnsOutputFrameSizeMultiple() {
+    AudioChainConfig config =
+        new AudioChainConfig.Builder().setOutputEncoding(C.ENCODING_PCM_24BIT).build();
+
+    int maxOutputSize =
+        config.getMaxOutputSize(
+            /* frameCount= */ 1024,
+            C.ENCODING_PCM_16BIT,
+            /* channelCount= */ 2,
+            /* sampleRate= */ 44100);
+
+    assertThat(maxOutputSize).isEqualTo(1024 * 2 * 3);
+  }
+
+  @Test
+  public void getMaxOutputSize_withResampling_includesInterpolationMargin() {
+    AudioChainConfig config = new AudioChainConfig.Builder().setOutputSampleRate(48000).build();
+
+    int maxOutputSize =
+        config.getMaxOutputSize(
+            /* frameCount= */ 1024,
+            C.ENCODING_PCM_16BIT,
+            /* channelCount= */ 2,
+            /* sampleRate= */ 44100);
+
+    // ceil(1024 * 48000 / 44100) = 1115 frames, plus two.
+    assertThat(maxOutputSize).isEqualTo(1117 * 2 * 2);
+  }
+
+  @Test
+  public void getMaxOutputSize_withSpeed_includesTimeStretchMargin() {
+    AudioChainConfig config = new AudioChainConfig.Builder().setSpeed(2f).build();
+
+    int maxOutputSize =
+        config.getMaxOutputSize(
+            /* frameCount= */ 960,
+            C.ENCODING_PCM_16BIT,
+            /* channelCount= */ 2,
+            /* sampleRate= */ 48000);
+
+    // The analysis hop is 960 frames, so at most two 480 frame hops are output.
+    assertThat(maxOutputSize).isEqualTo(960 * 2 * 2);
+  }
+
+  @Test
+  public void getMaxOutputSize_withPitch_includesTimeStretchAndInterpolationMargins() {
+    AudioChainConfig config = new AudioChainConfig.Builder().setPitch(2f).build();
+
+    int maxOutputSize =
+        config.getMaxOutputSize(
+            /* frameCount= */ 960,
+            C.ENCODING_PCM_16BIT,
+            /* channelCount= */ 2,
+            /* sampleRate= */ 48000);
+
+    // The analysis hop is 240 frames, so at most five 480 frame hops are output, which are
+    // resampled to 1200 frames, plus three.
+    assertThat(maxOutputSize).isEqualTo(1203 * 2 * 2);
+  }
+
+  @Test
+  public void getMaxOutputSize_withSilenceSkipping_includesHeldBackSilence() {
+    AudioChainConfig config =
+        new AudioChainConfig.Builder()
+            .setSilenceSkipping(
+                /* minimumSilenceDurationUs= */ 150_000,
+                /* paddingSilenceUs= */ 20_000,
+                /* silenceThresholdLevel= */ (short) 1024)
+            .build();
+
+    int maxOutputSize =
+        config.getMaxOutputSize(
+            /* frameCount= */ 960,
+            C.ENCODING_PCM_16BIT,
+            /* channelCount= */ 2,
+            /* sampleRate= */ 48000);
+
+    // Up to 150 ms of silence from previous buffers is output with the 960 input frames.
+    assertThat(config.isSkippingSilence()).isTrue();
+    assertThat(config.getSilenceThreshold()).isEqualTo(1024 / 32768f);
+    assertThat(maxOutputSize).isEqualTo((960 + 7200) * 2 * 2);
+  }
+
+  @Test
+  public void getMaxOutputSize_withWaveform_returnsPeakSizeMultiple() {
+    AudioChainConfig config =
+        new AudioChainConfig.Builder()
+            .setWaveformFramesPerPeak(256)
+            .setSpeed(2f)
+            .setOutputSampleRate(48000)
+            .build();
+
+    int maxOutputSize =
+        config.getMaxOutputSize(
+            /* frameCount= */ 1152,
+            C.ENCODING_PCM_16BIT,
+            /* channelCount= */ 2,
+            /* sampleRate= */ 44100);
+
+    // The 1152 frames complete 4 peaks, or 5 with the frames of a previous incomplete peak. The
+    // speed and sample rate don't apply.
+    assertThat(config.isReducingToWaveform()).isTrue();
+    assertThat(maxOutputSize).isEqualTo(5 * AudioChainConfig.WAVEFORM_VALUES_PER_PEAK * 4);
+  }
+
+  @Test
+  public void setSilenceSkipping_withPaddingLongerThanMinimumSilence_throws() {
+    AudioChainConfig.Builder builder = new AudioChainConfig.Builder();
+
+    assertThrows(
+        IllegalArgumentException.class,
+        () ->
+            builder.setSilenceSkipping(
+                /* minimumSilenceDurationUs= */ 100_000,
+                /* paddingSilenceUs= */ 200_000,
+                /* silenceThresholdLevel= */ (short) 1024));
+  }
+
+  @Test
+  public void forMetadata_withTrackMode_appliesTrackGainAndPreamp() {
+    AudioChainConfig config =
+        new AudioChainConfig.Builder()
+            .setGain(0.5f)
+            .setReplayGain(AudioChainConfig.REPLAY_GAIN_MODE_TRACK, /* preampDb= */ 2f)
+            .build();
+    Metadata metadata =
+        new Metadata(
+            new VorbisComment("replaygain_track_gain", "-8.00 dB"),
+            new VorbisComment("REPLAYGAIN_ALBUM_GAIN", "-4.00 dB"));
+
+    AudioChainConfig streamConfig = config.forMetadata(metadata);
+
+    // -8 dB + 2 dB = -6 dB, which halves the amplitude.
+    assertThat(streamConfig.gain).isWithin(1e-3f).of(0.5f * 0.501f);
+    assertThat(streamConfig.replayGainMode).isEqualTo(AudioChainConfig.REPLAY_GAIN_MODE_OFF);
+    assertThat(streamConfig.forMetadata(metadata)).isSameInstanceAs(streamConfig);
+  }
+
+  @Test
+  public void forMetadata_withAlbumModeAndR128Tags_appliesAlbumGainRelativeToReplayGainLevel() {
+    AudioChainConfig config =
+        new AudioChainConfig.Builder()
+            .setReplayGain(AudioChainConfig.REPLAY_GAIN_MODE_ALBUM, /* preampDb= */ 0f)
+            .build();
+    // R128 gains are in Q7.8 dB relative to -23 LUFS: -11 dB becomes -6 dB.
+    Metadata metadata =
+        new Metadata(
+            new VorbisComment("R128_TRACK_GAIN", "0"),
+            new VorbisComment("R128_ALBUM_GAIN", "-2816"));
+
+    AudioChainConfig streamConfig = config.forMetadata(metadata);
+
+    assertThat(streamConfig.gain).isWithin(1e-3f).of(0.501f);
+  }
+
+  @Test
+  public void forMetadata_withPeak_limitsGainToAvoidClipping() {
+    AudioChainConfig config =
+        new AudioChainConfig.Builder()
+            .setReplayGain(AudioChainConfig.REPLAY_GAIN_MODE_TRACK, /* preampDb= */ 0f)
+            .build();
+    Metadata metadata =
+        new Metadata(
+            new VorbisComment("REPLAYGAIN_TRACK_GAIN", "+6.02 dB"),
+            new VorbisComment("REPLAYGAIN_TRACK_PEAK", "0.8"));
+
+    AudioChainConfig streamConfig = config.forMetadata(metadata);
+
+    assertThat(streamConfig.gain).isWithin(1e-6f).of(1.25f);
+  }
+
+  @Test
+  public void forMetadata_withoutTagsOrWhenOff_returnsSameConfig() {
+    AudioChainConfig offConfig = new AudioChainConfig.Builder().build();
+    AudioChainConfig trackConfig =
+        new AudioChainConfig.Builder()
+            .setReplayGain(AudioChainConfig.REPLAY_GAIN_MODE_TRACK, /* preampDb= */ 0f)
+            .build();
+    Metadata taggedMetadata = new Metadata(new VorbisComment("REPLAYGAIN_TRACK_GAIN", "-3 dB"));
+    Metadata untaggedMetadata =
+        new Metadata(
+            new VorbisComment("ARTIST", "Artist"),
+            new VorbisComment("REPLAYGAIN_TRACK_GAIN", "loud"));
+
+    assertThat(offConfig.forMetadata(taggedMetadata)).isSameInstanceAs(offConfig);
+    assertThat(trackConfig.forMetadata(untaggedMetadata)).isSameInstanceAs(trackConfig);
+    assertThat(trackConfig.forMetadata(null)).isSameInstanceAs(trackConfig);
+  }
+
+  @Test
+  public void setSpeed_outOfRange_throws() {
+    AudioChainConfig.Builder builder = new AudioChainConfig.Builder();
+
+    assertThrows(IllegalArgumentException.class, () -> builder.setSpeed(0f));
+    assertThrows(IllegalArgumentException.class, () -> builder.setSpeed(16f));
+  }
+
+  @Test
+  public void setOutputEncoding_withUnsupportedEncoding_throws() {
+    AudioChainConfig.Builder builder = new AudioChainConfig.Builder();
+
+    assertThrows(
+        IllegalArgumentException.class, () -> builder.setOutputEncoding(C.ENCODING_PCM_8BIT));
+  }
+
+  @Test
+  public void setSpectrumFftSize_withInvalidSize_throws() {
+    AudioChainConfig.Builder builder = new AudioChainConfig.Builder();
+
+    assertThrows(IllegalArgumentException.class, () -> builder.setSpectrumFftSize(1000));
+    assertThrows(IllegalArgumentException.class, () -> builder.setSpectrumFftSize(8));
+    assertThrows(IllegalArgumentException.class, () -> builder.setSpectrumFftSize(32768));
+    assertThat(builder.setSpectrumFftSize(2048).build().spectrumFftSize).isEqualTo(2048);
+  }
+
+  @Test
+  public void setChannelMap_withTooManyChannels_throws() {
+    AudioChainConfig.Builder builder = new AudioChainConfig.Builder();
+
+    assertThrows(IllegalArgumentException.class, () -> builder.setChannelMap(new int[9]));
+  }
+}
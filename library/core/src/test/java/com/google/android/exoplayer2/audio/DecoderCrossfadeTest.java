@@ -0,0 +1,322 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.google.android.exoplayer2.audio;
+
+import static com.google.common.truth.Truth.assertThat;
+
+import androidx.test.ext.junit.runners.AndroidJUnit4;
+import com.google.android.exoplayer2.C;
+import com.google.android.exoplayer2.decoder.SimpleOutputBuffer;
+import com.google.android.exoplayer2.util.Assertions;
+import com.google.android.exoplayer2.util.Util;
+import java.nio.ByteBuffer;
+import java.util.ArrayDeque;
+import java.util.ArrayList;
+import java.util.HashMap;
+import java.util.List;
+import java.util.Map;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+
+/** Unit tests for {@link DecoderCrossfade}. */
+@RunWith(AndroidJUnit4.class)
+public final class DecoderCrossfadeTest {
+
+  private static final int CHANNEL_COUNT = 1;
+  private static final int SAMPLE_RATE = 1000;
+  private static final int ENCODING = C.ENCODING_PCM_16BIT;
+  private static final int FRAME_SIZE = 2;
+  private static final long DURATION_US = 10_000;
+
+  @Test
+  public void apply_holdsBackEndOfOutputAndDelaysTimestamps() {
+    FakeNativeMixer nativeMixer = new FakeNativeMixer();
+    DecoderCrossfade crossfade =
+        DecoderCrossfade.create(
+            nativeMixer,
+            DURATION_US,
+            DecoderCrossfade.CURVE_LINEAR,
+            /* speed= */ 1f,
+            /* previous= */ null);
+    SimpleOutputBuffer outputBuffer = new SimpleOutputBuffer(buffer -> {});
+
+    int mixedSize =
+        applyFrames(crossfade, outputBuffer, /* timeUs= */ 0, /* firstFrame= */ 0, /* count= */ 8);
+    assertThat(mixedSize).isEqualTo(0);
+    mixedSize =
+        applyFrames(
+            crossfade, outputBuffer, /* timeUs= */ 8_000, /* firstFrame= */ 8, /* count= */ 8);
+
+    assertThat(mixedSize).isEqualTo(6 * FRAME_SIZE);
+    assertThat(outputBuffer.timeUs).isEqualTo(0);
+    assertThat(getFrames(outputBuffer)).isEqualTo(new short[] {0, 1, 2, 3, 4, 5});
+  }
+
+  @Test
+  public void drain_writesHeldBackOutputAtEndOfStream() {
+    FakeNativeMixer nativeMixer = new FakeNativeMixer();
+    DecoderCrossfade crossfade =
+        DecoderCrossfade.create(
+            nativeMixer,
+            DURATION_US,
+            DecoderCrossfade.CURVE_LINEAR,
+            /* speed= */ 1f,
+            /* previous= */ null);
+    SimpleOutputBuffer outputBuffer = new SimpleOutputBuffer(buffer -> {});
+    applyFrames(crossfade, outputBuffer, /* timeUs= */ 0, /* firstFrame= */ 0, /* count= */ 16);
+
+    assertThat(crossfade.hasPendingOutput()).isTrue();
+    crossfade.drain(outputBuffer);
+
+    assertThat(outputBuffer.timeUs).isEqualTo(6_000);
+    assertThat(getFrames(outputBuffer)).isEqualTo(new short[] {6, 7, 8, 9, 10, 11, 12, 13, 14, 15});
+    assertThat(crossfade.hasPendingOutput()).isFalse();
+  }
+
+  @Test
+  public void apply_withSpeed_delaysTimestampsByMediaDuration() {
+    FakeNativeMixer nativeMixer = new FakeNativeMixer();
+    DecoderCrossfade crossfade =
+        DecoderCrossfade.create(
+            nativeMixer,
+            DURATION_US,
+            DecoderCrossfade.CURVE_LINEAR,
+            /* speed= */ 2f,
+            /* previous= */ null);
+    SimpleOutputBuffer outputBuffer = new SimpleOutputBuffer(buffer -> {});
+
+    applyFrames(crossfade, outputBuffer, /* timeUs= */ 0, /* firstFrame= */ 0, /* count= */ 10);
+    applyFrames(
+        crossfade, outputBuffer, /* timeUs= */ 20_000, /* firstFrame= */ 10, /* count= */ 10);
+
+    assertThat(outputBuffer.timeUs).isEqualTo(0);
+  }
+
+  @Test
+  public void flush_discardsHeldBackOutput() {
+    FakeNativeMixer nativeMixer = new FakeNativeMixer();
+    DecoderCrossfade crossfade =
+        DecoderCrossfade.create(
+            nativeMixer,
+            DURATION_US,
+            DecoderCrossfade.CURVE_LINEAR,
+            /* speed= */ 1f,
+            /* previous= */ null);
+    SimpleOutputBuffer outputBuffer = new SimpleOutputBuffer(buffer -> {});
+    applyFrames(crossfade, outputBuffer, /* timeUs= */ 0, /* firstFrame= */ 0, /* count= */ 8);
+
+    crossfade.flush();
+    applyFrames(
+        crossfade, outputBuffer, /* timeUs= */ 50_000, /* firstFrame= */ 50, /* count= */ 12);
+
+    assertThat(outputBuffer.timeUs).isEqualTo(50_000);
+    assertThat(getFrames(outputBuffer)).isEqualTo(new short[] {50, 51});
+  }
+
+  @Test
+  public void crossfadeIntoNextStream_passesHeldBackOutputToNextCrossfade() {
+    FakeNativeMixer nativeMixer = new FakeNativeMixer();
+    DecoderCrossfade previous =
+        DecoderCrossfade.create(
+            nativeMixer,
+            DURATION_US,
+            DecoderCrossfade.CURVE_LINEAR,
+            /* speed= */ 1f,
+            /* previous= */ null);
+    SimpleOutputBuffer outputBuffer = new SimpleOutputBuffer(buffer -> {});
+    applyFrames(previous, outputBuffer, /* timeUs= */ 0, /* firstFrame= */ 0, /* count= */ 16);
+
+    previous.crossfadeIntoNextStream();
+    assertThat(previous.hasPendingOutput()).isFalse();
+    previous.release();
+    DecoderCrossfade next =
+        DecoderCrossfade.create(
+            nativeMixer,
+            DURATION_US,
+            DecoderCrossfade.CURVE_EQUAL_POWER,
+            /* speed= */ 1f,
+            previous);
+    previous.releaseHeldOutput();
+
+    assertThat(nativeMixer.endedMixers).containsExactly(1L);
+    assertThat(nativeMixer.releasedMixers).isEmpty();
+    assertThat(nativeMixer.createdMixerCount).isEqualTo(1);
+    next.release();
+    assertThat(nativeMixer.releasedMixers).containsExactly(1L);
+  }
+
+  @Test
+  public void create_afterStreamThatWasNotCrossfadedIntoNext_releasesPreviousMixer() {
+    FakeNativeMixer nativeMixer = new FakeNativeMixer();
+    DecoderCrossfade previous =
+        DecoderCrossfade.create(
+            nativeMixer,
+            DURATION_US,
+            DecoderCrossfade.CURVE_LINEAR,
+            /* speed= */ 1f,
+            /* previous= */ null);
+    previous.release();
+
+    DecoderCrossfade.create(
+        nativeMixer, DURATION_US, DecoderCrossfade.CURVE_LINEAR, /* speed= */ 1f, previous);
+
+    assertThat(nativeMixer.releasedMixers).containsExactly(1L);
+    assertThat(nativeMixer.createdMixerCount).isEqualTo(2);
+  }
+
+  @Test
+  public void create_withUnsupportedDuration_releasesPreviousMixerAndReturnsNull() {
+    FakeNativeMixer nativeMixer = new FakeNativeMixer();
+    DecoderCrossfade previous =
+        DecoderCrossfade.create(
+            nativeMixer,
+            DURATION_US,
+            DecoderCrossfade.CURVE_LINEAR,
+            /* speed= */ 1f,
+            /* previous= */ null);
+    previous.crossfadeIntoNextStream();
+    previous.hasPendingOutput();
+    previous.release();
+
+    DecoderCrossfade crossfade =
+        DecoderCrossfade.create(
+            nativeMixer,
+            /* durationUs= */ 0,
+            DecoderCrossfade.CURVE_LINEAR,
+            /* speed= */ 1f,
+            previous);
+
+    assertThat(crossfade).isNull();
+    assertThat(nativeMixer.releasedMixers).containsExactly(1L);
+  }
+
+  private static int applyFrames(
+      DecoderCrossfade crossfade,
+      SimpleOutputBuffer outputBuffer,
+      long timeUs,
+      int firstFrame,
+      int count) {
+    ByteBuffer data = outputBuffer.init(timeUs, count * FRAME_SIZE);
+    for (int i = 0; i < count; i++) {
+      data.putShort((short) (firstFrame + i));
+    }
+    data.flip();
+    return crossfade.apply(outputBuffer, CHANNEL_COUNT, SAMPLE_RATE, ENCODING);
+  }
+
+  private static short[] getFrames(SimpleOutputBuffer outputBuffer) {
+    ByteBuffer data = Util.castNonNull(outputBuffer.data);
+    short[] frames = new short[data.remaining() / FRAME_SIZE];
+    for (int i = 0; i < frames.length; i++) {
+      frames[i] = data.getShort(data.position() + i * FRAME_SIZE);
+    }
+    return frames;
+  }
+
+  /** A native mixer that delays its input by the crossfade duration, without mixing. */
+  private static final class FakeNativeMixer implements DecoderCrossfade.NativeMixer {
+
+    public final List<Long> endedMixers;
+    public final List<Long> releasedMixers;
+    public int createdMixerCount;
+
+    private final Map<Long, Long> durationsUs;
+    private final Map<Long, ArrayDeque<Byte>> heldOutputs;
+
+    public FakeNativeMixer() {
+      endedMixers = new ArrayList<>();
+      releasedMixers = new ArrayList<>();
+      durationsUs = new HashMap<>();
+      heldOutputs = new HashMap<>();
+    }
+
+    @Override
+    public long setCrossfade(long mixer, long durationUs, @DecoderCrossfade.Curve int curve) {
+      if (durationUs <= 0) {
+        return 0;
+      }
+      if (mixer == 0) {
+        mixer = ++createdMixerCount;
+        heldOutputs.put(mixer, new ArrayDeque<>());
+      }
+      durationsUs.put(mixer, durationUs);
+      return mixer;
+    }
+
+    @Override
+    public int crossfade(
+        long mixer,
+        ByteBuffer data,
+        int offset,
+        int size,
+        int channelCount,
+        int sampleRate,
+        @C.PcmEncoding int encoding) {
+      if (encoding != C.ENCODING_PCM_16BIT) {
+        return -1;
+      }
+      ArrayDeque<Byte> heldOutput = getHeldOutput(mixer);
+      for (int i = 0; i < size; i++) {
+        heldOutput.add(data.get(offset + i));
+      }
+      long delaySize =
+          Assertions.checkNotNull(durationsUs.get(mixer))
+              * sampleRate
+              / C.MICROS_PER_SECOND
+              * Util.getPcmFrameSize(encoding, channelCount);
+      int mixedSize = (int) Math.max(0, heldOutput.size() - delaySize);
+      for (int i = 0; i < mixedSize; i++) {
+        data.put(offset + i, heldOutput.remove());
+      }
+      return mixedSize;
+    }
+
+    @Override
+    public int getCrossfadeDrainSize(long mixer) {
+      return getHeldOutput(mixer).size();
+    }
+
+    @Override
+    public int drainCrossfade(long mixer, ByteBuffer output, int capacity) {
+      ArrayDeque<Byte> heldOutput = getHeldOutput(mixer);
+      int size = Math.min(capacity, heldOutput.size());
+      for (int i = 0; i < size; i++) {
+        output.put(i, heldOutput.remove());
+      }
+      return size;
+    }
+
+    @Override
+    public void endCrossfadeStream(long mixer) {
+      endedMixers.add(mixer);
+    }
+
+    @Override
+    public void flushCrossfade(long mixer) {
+      getHeldOutput(mixer).clear();
+    }
+
+    @Override
+    public void releaseCrossfade(long mixer) {
+      Assertions.checkState(heldOutputs.remove(mixer) != null);
+      releasedMixers.add(mixer);
+    }
+
+    private ArrayDeque<Byte> getHeldOutput(long mixer) {
+      return Assertions.checkNotNull(heldOutputs.get(mixer));
+    }
+  }
+}
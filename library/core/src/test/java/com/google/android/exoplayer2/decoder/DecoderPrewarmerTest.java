@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.google.android.exoplayer2.decoder;
+
+import static com.google.common.truth.Truth.assertThat;
+
+import androidx.annotation.Nullable;
+import androidx.test.ext.junit.runners.AndroidJUnit4;
+import com.google.android.exoplayer2.Format;
+import com.google.android.exoplayer2.drm.DrmInitData;
+import com.google.android.exoplayer2.util.ConditionVariable;
+import com.google.android.exoplayer2.util.MimeTypes;
+import java.util.ArrayList;
+import java.util.Collections;
+import java.util.List;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+
+/** Unit tests for {@link DecoderPrewarmer}. */
+@RunWith(AndroidJUnit4.class)
+public final class DecoderPrewarmerTest {
+
+  private static final long TIMEOUT_MS = 10_000;
+
+  private static final Format FORMAT =
+      new Format.Builder()
+          .setSampleMimeType(MimeTypes.VIDEO_VP9)
+          .setWidth(1920)
+          .setHeight(1080)
+          .build();
+
+  @Test
+  public void takeDecoder_withoutPrewarm_returnsNull() {
+    DecoderPrewarmer<FakeDecoder> prewarmer = new DecoderPrewarmer<>();
+
+    assertThat(prewarmer.takeDecoder(FORMAT)).isNull();
+  }
+
+  @Test
+  public void takeDecoder_withSameFormat_returnsPrewarmedDecoderOnce() {
+    FakeDecoderFactory factory = new FakeDecoderFactory();
+    DecoderPrewarmer<FakeDecoder> prewarmer = new DecoderPrewarmer<>();
+
+    prewarmer.prewarm(FORMAT, factory);
+    @Nullable FakeDecoder decoder = prewarmer.takeDecoder(FORMAT);
+
+    assertThat(decoder).isNotNull();
+    assertThat(decoder.format).isEqualTo(FORMAT);
+    assertThat(decoder.released.isOpen()).isFalse();
+    assertThat(prewarmer.takeDecoder(FORMAT)).isNull();
+    assertThat(factory.createdDecoders).containsExactly(decoder);
+  }
+
+  @Test
+  public void takeDecoder_withDifferentDimensions_returnsPrewarmedDecoder() {
+    FakeDecoderFactory factory = new FakeDecoderFactory();
+    DecoderPrewarmer<FakeDecoder> prewarmer = new DecoderPrewarmer<>();
+    Format smallerFormat = FORMAT.buildUpon().setWidth(1280).setHeight(720).build();
+
+    prewarmer.prewarm(FORMAT, factory);
+    @Nullable FakeDecoder decoder = prewarmer.takeDecoder(smallerFormat);
+
+    assertThat(decoder).isNotNull();
+  }
+
+  @Test
+  public void takeDecoder_withIncompatibleFormat_releasesPrewarmedDecoder() {
+    FakeDecoderFactory factory = new FakeDecoderFactory();
+    DecoderPrewarmer<FakeDecoder> prewarmer = new DecoderPrewarmer<>();
+    Format av1Format = FORMAT.buildUpon().setSampleMimeType(MimeTypes.VIDEO_AV1).build();
+
+    prewarmer.prewarm(FORMAT, factory);
+    @Nullable FakeDecoder decoder = prewarmer.takeDecoder(av1Format);
+
+    assertThat(decoder).isNull();
+    assertThat(factory.awaitCreatedDecoder().awaitRelease()).isTrue();
+  }
+
+  @Test
+  public void takeDecoder_withDrmInitData_releasesPrewarmedDecoder() {
+    FakeDecoderFactory factory = new FakeDecoderFactory();
+    DecoderPrewarmer<FakeDecoder> prewarmer = new DecoderPrewarmer<>();
+    Format drmFormat = FORMAT.buildUpon().setDrmInitData(new DrmInitData()).build();
+
+    prewarmer.prewarm(FORMAT, factory);
+    @Nullable FakeDecoder decoder = prewarmer.takeDecoder(drmFormat);
+
+    assertThat(decoder).isNull();
+    assertThat(factory.awaitCreatedDecoder().awaitRelease()).isTrue();
+  }
+
+  @Test
+  public void takeDecoder_afterFailedCreation_returnsNull() {
+    FakeDecoderFactory factory = new FakeDecoderFactory();
+    factory.fail = true;
+    DecoderPrewarmer<FakeDecoder> prewarmer = new DecoderPrewarmer<>();
+
+    prewarmer.prewarm(FORMAT, factory);
+
+    assertThat(prewarmer.takeDecoder(FORMAT)).isNull();
+  }
+
+  @Test
+  public void prewarm_twice_releasesFirstDecoder() {
+    FakeDecoderFactory factory = new FakeDecoderFactory();
+    DecoderPrewarmer<FakeDecoder> prewarmer = new DecoderPrewarmer<>();
+    Format otherFormat = FORMAT.buildUpon().setMaxInputSize(1024).build();
+
+    prewarmer.prewarm(FORMAT, factory);
+    FakeDecoder firstDecoder = factory.awaitCreatedDecoder();
+    prewarmer.prewarm(otherFormat, factory);
+    @Nullable FakeDecoder secondDecoder = prewarmer.takeDecoder(otherFormat);
+
+    assertThat(firstDecoder.awaitRelease()).isTrue();
+    assertThat(secondDecoder).isNotNull();
+    assertThat(secondDecoder.format).isEqualTo(otherFormat);
+    assertThat(secondDecoder.released.isOpen()).isFalse();
+  }
+
+  @Test
+  public void release_releasesPrewarmedDecoder() {
+    FakeDecoderFactory factory = new FakeDecoderFactory();
+    DecoderPrewarmer<FakeDecoder> prewarmer = new DecoderPrewarmer<>();
+
+    prewarmer.prewarm(FORMAT, factory);
+    prewarmer.release();
+
+    assertThat(factory.awaitCreatedDecoder().awaitRelease()).isTrue();
+    assertThat(prewarmer.takeDecoder(FORMAT)).isNull();
+  }
+
+  private static final class FakeDecoderFactory
+      implements DecoderPrewarmer.DecoderFactory<FakeDecoder> {
+
+    public final List<FakeDecoder> createdDecoders;
+    public volatile boolean fail;
+
+    private final ConditionVariable decoderCreated;
+
+    public FakeDecoderFactory() {
+      createdDecoders = Collections.synchronizedList(new ArrayList<>());
+      decoderCreated = new ConditionVariable();
+    }
+
+    @Override
+    public FakeDecoder createDecoder(Format format) throws DecoderException {
+      if (fail) {
+        throw new DecoderException("Failed to create decoder");
+      }
+      FakeDecoder decoder = new FakeDecoder(format);
+      createdDecoders.add(decoder);
+      decoderCreated.open();
+      return decoder;
+    }
+
+    /** Waits for the first decoder to be created, and returns it. */
+    public FakeDecoder awaitCreatedDecoder() {
+      decoderCreated.blockUninterruptible();
+      return createdDecoders.get(0);
+    }
+  }
+
+  private static final class FakeDecoder
+      implements Decoder<DecoderInputBuffer, SimpleOutputBuffer, DecoderException> {
+
+    public final Format format;
+    public final ConditionVariable released;
+
+    public FakeDecoder(Format format) {
+      this.format = format;
+      released = new ConditionVariable();
+    }
+
+    /** Waits for the decoder to be released, returning whether it was released in time. */
+    public boolean awaitRelease() {
+      try {
+        return released.block(TIMEOUT_MS);
+      } catch (InterruptedException e) {
+        Thread.currentThread().interrupt();
+        return false;
+      }
+    }
+
+    @Override
+    public String getName() {
+      return "FakeDecoder";
+    }
+
+    @Override
+    @Nullable
+    public DecoderInputBuffer dequeueInputBuffer() {
+      return null;
+    }
+
+    @Override
+    public void queueInputBuffer(DecoderInputBuffer inputBuffer) {}
+
+    @Override
+    @Nullable
+    public SimpleOutputBuffer dequeueOutputBuffer() {
+      return null;
+    }
+
+    @Override
+    public void flush() {}
+
+    @Override
+    public void release() {
+      released.open();
+    }
+  }
+}
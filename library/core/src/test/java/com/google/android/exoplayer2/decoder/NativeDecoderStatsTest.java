@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.google.android.exoplayer2.decoder;
+
+import static com.google.common.truth.Truth.assertThat;
+import static org.junit.Assert.assertThrows;
+
+import androidx.test.ext.junit.runners.AndroidJUnit4;
+import com.google.android.exoplayer2.C;
+import com.google.android.exoplayer2.decoder.NativeDecoderStats.LatencyHistogram;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+
+/** Unit tests for {@link NativeDecoderStats}. */
+@RunWith(AndroidJUnit4.class)
+public final class NativeDecoderStatsTest {
+
+  private static final int HISTOGRAMS_OFFSET = 14;
+
+  @Test
+  public void constructor_readsCounters() {
+    long[] snapshot = new long[NativeDecoderStats.SNAPSHOT_LENGTH];
+    for (int i = 0; i < HISTOGRAMS_OFFSET; i++) {
+      snapshot[i] = i + 1;
+    }
+
+    NativeDecoderStats stats = new NativeDecoderStats(snapshot);
+
+    assertThat(stats.inputBufferCount).isEqualTo(1);
+    assertThat(stats.inputByteCount).isEqualTo(2);
+    assertThat(stats.outputBufferCount).isEqualTo(3);
+    assertThat(stats.outputByteCount).isEqualTo(4);
+    assertThat(stats.skippedOutputBufferCount).isEqualTo(5);
+    assertThat(stats.decodeErrorCount).isEqualTo(6);
+    assertThat(stats.frameBuffersInUse).isEqualTo(7);
+    assertThat(stats.peakFrameBuffersInUse).isEqualTo(8);
+    assertThat(stats.frameBufferAllocationCount).isEqualTo(9);
+    assertThat(stats.nativeCallCount).isEqualTo(10);
+    assertThat(stats.nativeCallTimeNs).isEqualTo(11);
+    assertThat(stats.upcallCount).isEqualTo(12);
+    assertThat(stats.upcallTimeNs).isEqualTo(13);
+    assertThat(stats.frameBufferBytes).isEqualTo(14);
+  }
+
+  @Test
+  public void constructor_readsHistograms() {
+    long[] snapshot = new long[NativeDecoderStats.SNAPSHOT_LENGTH];
+    snapshot[HISTOGRAMS_OFFSET] = 1;
+    snapshot[HISTOGRAMS_OFFSET + LatencyHistogram.BUCKET_COUNT + 1] = 2;
+    snapshot[NativeDecoderStats.SNAPSHOT_LENGTH - 1] = 3;
+
+    NativeDecoderStats stats = new NativeDecoderStats(snapshot);
+
+    assertThat(stats.decodeTimeHistogram.getTotalCount()).isEqualTo(1);
+    assertThat(stats.decodeTimeHistogram.getCount(0)).isEqualTo(1);
+    assertThat(stats.convertTimeHistogram.getTotalCount()).isEqualTo(2);
+    assertThat(stats.convertTimeHistogram.getCount(1)).isEqualTo(2);
+    assertThat(stats.renderTimeHistogram.getTotalCount()).isEqualTo(3);
+    assertThat(stats.renderTimeHistogram.getCount(LatencyHistogram.BUCKET_COUNT - 1))
+        .isEqualTo(3);
+  }
+
+  @Test
+  public void constructor_withShortSnapshot_throws() {
+    assertThrows(
+        IllegalArgumentException.class,
+        () -> new NativeDecoderStats(new long[NativeDecoderStats.SNAPSHOT_LENGTH - 1]));
+  }
+
+  @Test
+  public void getBucketIndex_smallValues_haveOwnBuckets() {
+    for (int i = 0; i < 2 * LatencyHistogram.SUB_BUCKET_COUNT; i++) {
+      assertThat(LatencyHistogram.getBucketIndex(i)).isEqualTo(i);
+      assertThat(LatencyHistogram.getBucketLowerBoundUs(i)).isEqualTo(i);
+    }
+    assertThat(LatencyHistogram.getBucketIndex(-1)).isEqualTo(0);
+  }
+
+  @Test
+  public void getBucketIndex_isConsistentWithLowerBounds() {
+    for (int i = 0; i < LatencyHistogram.BUCKET_COUNT - 1; i++) {
+      long lowerBoundUs = LatencyHistogram.getBucketLowerBoundUs(i);
+      long nextLowerBoundUs = LatencyHistogram.getBucketLowerBoundUs(i + 1);
+      assertThat(nextLowerBoundUs).isGreaterThan(lowerBoundUs);
+      assertThat(LatencyHistogram.getBucketIndex(lowerBoundUs)).isEqualTo(i);
+      assertThat(LatencyHistogram.getBucketIndex(nextLowerBoundUs - 1)).isEqualTo(i);
+    }
+  }
+
+  @Test
+  public void getBucketIndex_largeValues_areRecordedInLastBucket() {
+    long maxValueUs = 1L << LatencyHistogram.MAX_VALUE_BITS;
+
+    assertThat(LatencyHistogram.getBucketIndex(maxValueUs - 1))
+        .isEqualTo(LatencyHistogram.BUCKET_COUNT - 1);
+    assertThat(LatencyHistogram.getBucketIndex(maxValueUs))
+        .isEqualTo(LatencyHistogram.BUCKET_COUNT - 1);
+    assertThat(LatencyHistogram.getBucketIndex(Long.MAX_VALUE))
+        .isEqualTo(LatencyHistogram.BUCKET_COUNT - 1);
+  }
+
+  @Test
+  public void getPercentileUs_returnsLargestEquivalentValue() {
+    long[] snapshot = new long[NativeDecoderStats.SNAPSHOT_LENGTH];
+    // 90 values of 5us, 9 values of 1000us and 1 value of 20000us.
+    snapshot[HISTOGRAMS_OFFSET + LatencyHistogram.getBucketIndex(5)] = 90;
+    snapshot[HISTOGRAMS_OFFSET + LatencyHistogram.getBucketIndex(1000)] = 9;
+    snapshot[HISTOGRAMS_OFFSET + LatencyHistogram.getBucketIndex(20000)] = 1;
+    LatencyHistogram histogram = new NativeDecoderStats(snapshot).decodeTimeHistogram;
+
+    assertThat(histogram.getPercentileUs(0)).isEqualTo(5);
+    assertThat(histogram.getPercentileUs(50)).isEqualTo(5);
+    assertThat(histogram.getPercentileUs(90)).isEqualTo(5);
+    // 1000us is in the bucket [960, 1024).
+    assertThat(histogram.getPercentileUs(95)).isEqualTo(1023);
+    assertThat(histogram.getPercentileUs(99)).isEqualTo(1023);
+    // 20000us is in the bucket [18432, 20480).
+    assertThat(histogram.getPercentileUs(100)).isEqualTo(20479);
+  }
+
+  @Test
+  public void getMeanUs_returnsMeanOfBucketMidpoints() {
+    long[] snapshot = new long[NativeDecoderStats.SNAPSHOT_LENGTH];
+    snapshot[HISTOGRAMS_OFFSET + LatencyHistogram.getBucketIndex(4)] = 1;
+    // 64us is in the bucket [64, 72).
+    snapshot[HISTOGRAMS_OFFSET + LatencyHistogram.getBucketIndex(64)] = 1;
+    LatencyHistogram histogram = new NativeDecoderStats(snapshot).decodeTimeHistogram;
+
+    assertThat(histogram.getMeanUs()).isEqualTo(Math.round((4 + 67.5) / 2));
+  }
+
+  @Test
+  public void emptyHistogram_returnsTimeUnset() {
+    LatencyHistogram histogram =
+        new NativeDecoderStats(new long[NativeDecoderStats.SNAPSHOT_LENGTH]).decodeTimeHistogram;
+
+    assertThat(histogram.getTotalCount()).isEqualTo(0);
+    assertThat(histogram.getPercentileUs(50)).isEqualTo(C.TIME_UNSET);
+    assertThat(histogram.getMeanUs()).isEqualTo(C.TIME_UNSET);
+  }
+}
@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.google.android.exoplayer2.decoder;
+
+import static com.google.common.truth.Truth.assertThat;
+import static org.junit.Assert.assertThrows;
+
+import androidx.annotation.Nullable;
+import androidx.test.ext.junit.runners.AndroidJUnit4;
+import com.google.android.exoplayer2.C;
+import java.util.ArrayDeque;
+import java.util.ArrayList;
+import java.util.List;
+import java.util.concurrent.TimeoutException;
+import org.junit.Test;
+import org.junit.runner.RunWith;
+
+/** Unit tests for {@link SimpleDecoder}. */
+@RunWith(AndroidJUnit4.class)
+public final class SimpleDecoderTest {
+
+  private static final long TIMEOUT_MS = 10_000;
+
+  @Test
+  public void decode_withoutPendingOutput_outputsEndOfStreamAfterInput() throws Exception {
+    FakeDecoder decoder = new FakeDecoder(/* delay= */ 0);
+
+    List<Long> outputTimesUs = decodeToEndOfStream(decoder, /* inputCount= */ 5);
+
+    assertThat(outputTimesUs).containsExactly(0L, 1L, 2L, 3L, 4L).inOrder();
+    decoder.release();
+  }
+
+  @Test
+  public void decode_withPendingOutput_outputsPendingOutputBeforeEndOfStream() throws Exception {
+    FakeDecoder decoder = new FakeDecoder(/* delay= */ 3);
+
+    List<Long> outputTimesUs = decodeToEndOfStream(decoder, /* inputCount= */ 5);
+
+    assertThat(outputTimesUs).containsExactly(0L, 1L, 2L, 3L, 4L).inOrder();
+    decoder.release();
+  }
+
+  @Test
+  public void decode_withMoreDelayThanInput_outputsAllInputBeforeEndOfStream() throws Exception {
+    FakeDecoder decoder = new FakeDecoder(/* delay= */ 10);
+
+    List<Long> outputTimesUs = decodeToEndOfStream(decoder, /* inputCount= */ 5);
+
+    assertThat(outputTimesUs).containsExactly(0L, 1L, 2L, 3L, 4L).inOrder();
+    decoder.release();
+  }
+
+  @Test
+  public void decode_withPendingOutput_doesNotCountHeldBackOutputAsSkipped() throws Exception {
+    FakeDecoder decoder = new FakeDecoder(/* delay= */ 3);
+
+    decodeToEndOfStream(decoder, /* inputCount= */ 5);
+
+    assertThat(decoder.outputSkippedOutputBufferCounts).containsExactly(0, 0, 0, 0, 0, 0);
+    decoder.release();
+  }
+
+  @Test
+  public void decode_withPendingOutputThatIsNotWritten_skipsItBeforeEndOfStream()
+      throws Exception {
+    FakeDecoder decoder = new FakeDecoder(/* delay= */ 3);
+    decoder.skippedPendingTimeUs = 3;
+
+    List<Long> outputTimesUs = decodeToEndOfStream(decoder, /* inputCount= */ 5);
+
+    assertThat(outputTimesUs).containsExactly(0L, 1L, 2L, 4L).inOrder();
+    assertThat(decoder.outputSkippedOutputBufferCounts).containsExactly(0, 0, 0, 0, 0);
+    decoder.release();
+  }
+
+  @Test
+  public void decode_withPendingOutputError_throwsError() throws Exception {
+    FakeDecoder decoder = new FakeDecoder(/* delay= */ 3);
+    decoder.pendingOutputError = new DecoderException("Pending output error");
+
+    DecoderException exception =
+        assertThrows(
+            DecoderException.class, () -> decodeToEndOfStream(decoder, /* inputCount= */ 5));
+
+    assertThat(exception).isSameInstanceAs(decoder.pendingOutputError);
+    decoder.release();
+  }
+
+  /**
+   * Queues {@code inputCount} input buffers, with their indices as timestamps, followed by the end
+   * of stream, and returns the timestamps of the output buffers until the end of stream is output.
+   */
+  private static List<Long> decodeToEndOfStream(FakeDecoder decoder, int inputCount)
+      throws DecoderException, TimeoutException {
+    List<Long> outputTimesUs = new ArrayList<>();
+    int queuedInputCount = 0;
+    long deadlineMs = System.currentTimeMillis() + TIMEOUT_MS;
+    while (System.currentTimeMillis() < deadlineMs) {
+      if (queuedInputCount <= inputCount) {
+        @Nullable DecoderInputBuffer inputBuffer = decoder.dequeueInputBuffer();
+        if (inputBuffer != null) {
+          if (queuedInputCount == inputCount) {
+            inputBuffer.setFlags(C.BUFFER_FLAG_END_OF_STREAM);
+          } else {
+            inputBuffer.timeUs = queuedInputCount;
+          }
+          decoder.queueInputBuffer(inputBuffer);
+          queuedInputCount++;
+        }
+      }
+      @Nullable SimpleOutputBuffer outputBuffer = decoder.dequeueOutputBuffer();
+      if (outputBuffer != null) {
+        decoder.outputSkippedOutputBufferCounts.add(outputBuffer.skippedOutputBufferCount);
+        boolean endOfStream = outputBuffer.isEndOfStream();
+        if (!endOfStream) {
+          outputTimesUs.add(outputBuffer.timeUs);
+        }
+        outputBuffer.release();
+        if (endOfStream) {
+          return outputTimesUs;
+        }
+      }
+    }
+    throw new TimeoutException();
+  }
+
+  /**
+   * A decoder that outputs the timestamp of each input buffer once {@code delay} more input
+   * buffers have been decoded, like a decoder that holds back the end of its output.
+   *
+   * <p>The held back output is written before the end of stream, other than the output with
+   * timestamp {@link #skippedPendingTimeUs}, or fails with {@link #pendingOutputError} if it's
+   * set.
+   */
+  private static final class FakeDecoder
+      extends SimpleDecoder<DecoderInputBuffer, SimpleOutputBuffer, DecoderException> {
+
+    private final int delay;
+    private final ArrayDeque<Long> pendingTimesUs;
+    private final List<Integer> outputSkippedOutputBufferCounts;
+
+    public volatile long skippedPendingTimeUs;
+    @Nullable public volatile DecoderException pendingOutputError;
+
+    public FakeDecoder(int delay) {
+      super(new DecoderInputBuffer[2], new SimpleOutputBuffer[2]);
+      this.delay = delay;
+      pendingTimesUs = new ArrayDeque<>();
+      outputSkippedOutputBufferCounts = new ArrayList<>();
+      skippedPendingTimeUs = C.TIME_UNSET;
+    }
+
+    @Override
+    public String getName() {
+      return "FakeDecoder";
+    }
+
+    @Override
+    protected DecoderInputBuffer createInputBuffer() {
+      return new DecoderInputBuffer(DecoderInputBuffer.BUFFER_REPLACEMENT_MODE_NORMAL);
+    }
+
+    @Override
+    protected SimpleOutputBuffer createOutputBuffer() {
+      return new SimpleOutputBuffer(this::releaseOutputBuffer);
+    }
+
+    @Override
+    protected DecoderException createUnexpectedDecodeException(Throwable error) {
+      return new DecoderException("Unexpected decode error", error);
+    }
+
+    @Override
+    @Nullable
+    protected DecoderException decode(
+        DecoderInputBuffer inputBuffer, SimpleOutputBuffer outputBuffer, boolean reset) {
+      if (reset) {
+        pendingTimesUs.clear();
+      }
+      pendingTimesUs.add(inputBuffer.timeUs);
+      if (pendingTimesUs.size() > delay) {
+        outputBuffer.init(pendingTimesUs.remove(), /* size= */ 0);
+      } else {
+        setNoOutput();
+      }
+      return null;
+    }
+
+    @Override
+    protected boolean hasPendingOutput() {
+      return !pendingTimesUs.isEmpty();
+    }
+
+    @Override
+    @Nullable
+    protected DecoderException decodePendingOutput(SimpleOutputBuffer outputBuffer) {
+      if (pendingOutputError != null) {
+        return pendingOutputError;
+      }
+      long timeUs = pendingTimesUs.remove();
+      if (timeUs == skippedPendingTimeUs) {
+        setNoOutput();
+      } else {
+        outputBuffer.init(timeUs, /* size= */ 0);
+      }
+      return null;
+    }
+  }
+}